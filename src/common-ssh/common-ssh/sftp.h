@@ -20,6 +20,7 @@
 #ifndef GUAC_COMMON_SSH_SFTP_H
 #define GUAC_COMMON_SSH_SFTP_H
 
+#include "common/download.h"
 #include "common/json.h"
 #include "ssh.h"
 
@@ -110,6 +111,32 @@ typedef struct guac_common_ssh_sftp_ls_state {
 
 } guac_common_ssh_sftp_ls_state;
 
+/**
+ * The current state of a file download operation.
+ */
+typedef struct guac_common_ssh_sftp_download_state {
+
+    /**
+     * Reference to the file currently being downloaded over SFTP. This file
+     * must already be open from a call to libssh2_sftp_open().
+     */
+    LIBSSH2_SFTP_HANDLE* file;
+
+    /**
+     * The blobs of the download that have been sent but not yet
+     * acknowledged.
+     */
+    guac_common_download_window window;
+
+    /**
+     * Buffer receiving file data read over SFTP. Reads into this buffer are
+     * large enough that libssh2 will pipeline several SFTP read requests
+     * rather than waiting for each to complete in turn.
+     */
+    char buffer[GUAC_COMMON_DOWNLOAD_BUFFER_SIZE];
+
+} guac_common_ssh_sftp_download_state;
+
 /**
  * Creates a new Guacamole filesystem object which provides access to files
  * and directories via SFTP using the given SSH session. When the filesystem
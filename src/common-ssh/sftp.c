@@ -30,6 +30,7 @@
 #include <libssh2.h>
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <stdlib.h>
 #include <string.h>
@@ -443,8 +444,9 @@ int guac_common_ssh_sftp_handle_file_stream(
 /**
  * Handler for ack messages which continue an outbound SFTP data transfer
  * (download), signaling the current status and requesting additional data.
- * The data associated with the given stream is expected to be a pointer to an
- * open LIBSSH2_SFTP_HANDLE for the file from which the data is to be read.
+ * The data associated with the given stream is expected to be a pointer to a
+ * guac_common_ssh_sftp_download_state for the file from which the data is to
+ * be read. As many blobs are sent as the download window allows.
  *
  * @param user
  *     The user receiving the ack message.
@@ -466,62 +468,104 @@ int guac_common_ssh_sftp_handle_file_stream(
 static int guac_common_ssh_sftp_ack_handler(guac_user* user,
         guac_stream* stream, char* message, guac_protocol_status status) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    /* Pull download state from stream */
+    guac_common_ssh_sftp_download_state* download =
+        (guac_common_ssh_sftp_download_state*) stream->data;
+
+    guac_common_download_window* window = &download->window;
 
     /* If successful, read data */
     if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
 
-        /* Attempt read into buffer */
-        char buffer[4096];
-        int bytes_read = libssh2_sftp_read(file, buffer, sizeof(buffer)); 
+        guac_common_download_window_ack(window);
+
+        /* Fill the download window with as much data as it allows */
+        int available;
+        while ((available = guac_common_download_window_available(window,
+                        sizeof(download->buffer))) > 0) {
+
+            int bytes_read = libssh2_sftp_read(download->file,
+                    download->buffer, available);
+
+            /* Stop at EOF or error, waiting for any blobs already sent to
+             * be acknowledged in either case */
+            if (bytes_read < 0) {
+                guac_user_log(user, GUAC_LOG_INFO, "Error reading file");
+                guac_common_download_window_fail(window);
+                break;
+            }
 
-        /* If bytes read, send as blob */
-        if (bytes_read > 0) {
-            guac_protocol_send_blob(user->socket, stream,
-                    buffer, bytes_read);
+            if (bytes_read > 0)
+                guac_protocol_send_blobs(user->socket, stream,
+                        download->buffer, bytes_read);
 
-            guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes sent to user",
-                    bytes_read);
+            guac_common_download_window_sent(window, bytes_read);
 
         }
 
-        /* If bytes could not be read, handle EOF or error condition */
-        else {
+        /* End stream only after all data has been acknowledged */
+        if (guac_common_download_window_complete(window)) {
 
-            /* If EOF, send end */
-            if (bytes_read == 0) {
-                guac_user_log(user, GUAC_LOG_DEBUG, "File sent");
-                guac_protocol_send_end(user->socket, stream);
-                guac_user_free_stream(user, stream);
-            }
+            if (window->failed)
+                guac_user_log(user, GUAC_LOG_DEBUG, "File download aborted "
+                        "after %" PRId64 " bytes", window->bytes_sent);
+            else
+                guac_user_log(user, GUAC_LOG_DEBUG, "File sent (%" PRId64
+                        " bytes)", window->bytes_sent);
 
-            /* Otherwise, fail stream */
-            else {
-                guac_user_log(user, GUAC_LOG_INFO, "Error reading file");
-                guac_protocol_send_end(user->socket, stream);
-                guac_user_free_stream(user, stream);
-            }
+            guac_protocol_send_end(user->socket, stream);
+            guac_user_free_stream(user, stream);
 
             /* Close file */
-            if (libssh2_sftp_close(file) == 0)
+            if (libssh2_sftp_close(download->file) == 0)
                 guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
             else
                 guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
 
+            guac_mem_free(download);
+
         }
 
         guac_socket_flush(user->socket);
 
     }
 
-    /* Otherwise, return stream to user */
-    else
+    /* Otherwise, abandon download and return stream to user */
+    else {
+        libssh2_sftp_close(download->file);
+        guac_mem_free(download);
         guac_user_free_stream(user, stream);
+    }
 
     return 0;
 }
 
+/**
+ * Allocates the state of a new download of the given file, which must already
+ * be open, to be associated with the stream through which that file will be
+ * sent.
+ *
+ * @param file
+ *     The file being downloaded.
+ *
+ * @return
+ *     Newly-allocated download state, which will automatically be freed when
+ *     the download completes.
+ */
+static guac_common_ssh_sftp_download_state* guac_common_ssh_sftp_download_alloc(
+        LIBSSH2_SFTP_HANDLE* file) {
+
+    guac_common_ssh_sftp_download_state* download =
+        guac_mem_alloc(sizeof(guac_common_ssh_sftp_download_state));
+
+    download->file = file;
+    guac_common_download_window_init(&download->window,
+            GUAC_COMMON_DOWNLOAD_DEFAULT_WINDOW);
+
+    return download;
+
+}
+
 guac_stream* guac_common_ssh_sftp_download_file(
         guac_common_ssh_sftp_filesystem* filesystem, guac_user* user,
         char* filename) {
@@ -550,7 +594,7 @@ guac_stream* guac_common_ssh_sftp_download_file(
     /* Allocate stream */
     stream = guac_user_alloc_stream(user);
     stream->ack_handler = guac_common_ssh_sftp_ack_handler;
-    stream->data = file;
+    stream->data = guac_common_ssh_sftp_download_alloc(file);
 
     /* Send stream start, strip name */
     filename = basename(filename);
@@ -828,7 +872,7 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
         stream->ack_handler = guac_common_ssh_sftp_ack_handler;
-        stream->data = file;
+        stream->data = guac_common_ssh_sftp_download_alloc(file);
 
         /* Associate new stream with get request */
         guac_protocol_send_body(user->socket, object, stream,
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#ifndef GUAC_COMMON_DOWNLOAD_H
+#define GUAC_COMMON_DOWNLOAD_H
+
+#include "config.h"
+
+#include <guacamole/protocol-constants.h>
+
+#include <stdint.h>
+
+/**
+ * The default maximum number of bytes of file data that may be sent to a
+ * user as blobs that have not yet been acknowledged. Downloads are limited to
+ * roughly this many bytes per round trip.
+ */
+#define GUAC_COMMON_DOWNLOAD_DEFAULT_WINDOW 262144
+
+/**
+ * The size of the buffer that should be used when reading file data for a
+ * download, in bytes. Reads should request as much of this buffer as the
+ * current window allows, such that a single read may result in many blobs.
+ */
+#define GUAC_COMMON_DOWNLOAD_BUFFER_SIZE (GUAC_PROTOCOL_BLOB_MAX_LENGTH * 16)
+
+/**
+ * Sliding window tracking the blobs of an outbound file transfer that have
+ * been sent but not yet acknowledged. Rather than sending a single blob in
+ * response to each "ack", as many blobs are sent as the window allows,
+ * keeping the connection busy despite the latency of each round trip.
+ */
+typedef struct guac_common_download_window {
+
+    /**
+     * The maximum number of blobs that may be unacknowledged at any one time.
+     */
+    int max_blobs;
+
+    /**
+     * The number of blobs sent that have not yet been acknowledged.
+     */
+    int blobs_in_flight;
+
+    /**
+     * The total number of bytes sent thus far.
+     */
+    int64_t bytes_sent;
+
+    /**
+     * Non-zero if the end of the file has been reached and no further data
+     * will be sent, zero otherwise.
+     */
+    int eof;
+
+    /**
+     * Non-zero if reading the file failed and no further data will be sent,
+     * zero otherwise. A failed download is still only complete once all blobs
+     * already sent have been acknowledged.
+     */
+    int failed;
+
+} guac_common_download_window;
+
+/**
+ * Initializes the given download window such that roughly the given number
+ * of bytes may be unacknowledged at any one time. At least one blob will
+ * always be allowed, regardless of the size requested.
+ *
+ * @param window
+ *     The download window to initialize.
+ *
+ * @param size
+ *     The maximum number of bytes that should be sent without being
+ *     acknowledged.
+ */
+void guac_common_download_window_init(guac_common_download_window* window,
+        int size);
+
+/**
+ * Updates the given download window to reflect receipt of an "ack". The
+ * first "ack" of a download acknowledges the creation of the stream itself,
+ * while each subsequent "ack" acknowledges a single blob.
+ *
+ * @param window
+ *     The download window receiving the "ack".
+ */
+void guac_common_download_window_ack(guac_common_download_window* window);
+
+/**
+ * Returns the number of bytes that may be sent right now without exceeding
+ * the given window, limited to the given buffer size. If the end of the file
+ * has been reached, this will always be zero.
+ *
+ * @param window
+ *     The download window to check.
+ *
+ * @param buffer_size
+ *     The size of the buffer that will receive file data.
+ *
+ * @return
+ *     The number of bytes that may be read and sent.
+ */
+int guac_common_download_window_available(
+        const guac_common_download_window* window, int buffer_size);
+
+/**
+ * Updates the given download window to reflect that the given number of bytes
+ * were sent using guac_protocol_send_blobs(). If zero bytes were sent, the
+ * end of the file is considered to have been reached.
+ *
+ * @param window
+ *     The download window to update.
+ *
+ * @param length
+ *     The number of bytes sent, which must not exceed the value most
+ *     recently returned by guac_common_download_window_available().
+ */
+void guac_common_download_window_sent(guac_common_download_window* window,
+        int length);
+
+/**
+ * Updates the given download window to reflect that reading the file has
+ * failed. No further data will be sent, but, as with reaching the end of the
+ * file, the download is not complete until all blobs already sent have been
+ * acknowledged. The stream must not be ended and freed before then, as the
+ * "ack" of any blob still in flight could otherwise be received for an
+ * unrelated stream that has reused the same index.
+ *
+ * @param window
+ *     The download window to update.
+ */
+void guac_common_download_window_fail(guac_common_download_window* window);
+
+/**
+ * Returns whether the download tracked by the given window is complete, in
+ * which case the stream should be ended. A download is complete only after
+ * the end of the file has been reached and all blobs have been acknowledged,
+ * such that no "ack" can arrive for a stream that has already been freed.
+ *
+ * @param window
+ *     The download window to check.
+ *
+ * @return
+ *     Non-zero if the download is complete, zero otherwise.
+ */
+int guac_common_download_window_complete(
+        const guac_common_download_window* window);
+
+#endif
+
@@ -0,0 +1,241 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_COMMON_INPUT_COALESCER_H
+#define GUAC_COMMON_INPUT_COALESCER_H
+
+#include "config.h"
+
+#include <guacamole/user.h>
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Handler which is invoked by a guac_common_input_coalescer for each input
+ * event that must actually be sent to the remote desktop server.
+ *
+ * @param event
+ *     The protocol-specific input event to send.
+ *
+ * @param data
+ *     The arbitrary data provided when the guac_common_input_coalescer was
+ *     allocated.
+ */
+typedef void guac_common_input_coalescer_handler(const void* event,
+        void* data);
+
+/**
+ * Statistics describing the mouse events processed by a
+ * guac_common_input_coalescer.
+ */
+typedef struct guac_common_input_coalescer_stats {
+
+    /**
+     * The total number of mouse events received.
+     */
+    uint64_t mouse_events_received;
+
+    /**
+     * The number of mouse events received that were never sent, having been
+     * superseded by later mouse motion from the same user before they could
+     * be sent.
+     */
+    uint64_t mouse_events_coalesced;
+
+} guac_common_input_coalescer_stats;
+
+/**
+ * Collapses runs of queued mouse motion into their final position while
+ * preserving the relative order of all other input events. Protocol-specific
+ * input events are opaque to the coalescer, which copies them by value and
+ * passes them back to a handler when they must be sent.
+ *
+ * Mouse events which merely move the mouse are held back until the next
+ * event is known. If that event is further motion from the same user, it
+ * replaces the held event, which is never sent. Events which change the
+ * button mask are always sent immediately and at their own coordinates, and
+ * any other event (keys, touches, etc.) causes held motion to be sent first.
+ *
+ * The button mask against which motion is judged is shared by all users
+ * rather than tracked per user. This is deliberate: the remote desktop
+ * server has only one pointer, and whether an event is a button transition
+ * depends on the button state of that pointer, regardless of which user last
+ * changed it.
+ *
+ * A coalescer is not threadsafe and must only be used by the single thread
+ * that sends input events, with the exception of
+ * guac_common_input_coalescer_get_stats(), which may be called from any
+ * thread.
+ */
+typedef struct guac_common_input_coalescer {
+
+    /**
+     * The size of each input event, in bytes.
+     */
+    size_t event_size;
+
+    /**
+     * The handler to invoke for each input event that must be sent.
+     */
+    guac_common_input_coalescer_handler* handler;
+
+    /**
+     * The arbitrary data to pass to the handler.
+     */
+    void* data;
+
+    /**
+     * Copy of the mouse motion event that is being held back, if any. The
+     * contents of this buffer are meaningful only if pending is non-zero.
+     */
+    void* pending_event;
+
+    /**
+     * Non-zero if pending_event contains mouse motion that has not yet been
+     * sent, zero otherwise.
+     */
+    int pending;
+
+    /**
+     * The user that produced the mouse motion in pending_event.
+     */
+    const guac_user* pending_user;
+
+    /**
+     * The button mask of the most recent mouse event received from any user.
+     */
+    int last_mask;
+
+    /**
+     * Statistics accumulated since they were last published by
+     * guac_common_input_coalescer_flush(). This structure is only accessed
+     * by the thread using the coalescer.
+     */
+    guac_common_input_coalescer_stats unpublished;
+
+    /**
+     * Statistics as of the most recent call to
+     * guac_common_input_coalescer_flush(). Access to this structure is
+     * guarded by stats_lock.
+     */
+    guac_common_input_coalescer_stats stats;
+
+    /**
+     * Lock which guards access to stats.
+     */
+    pthread_mutex_t stats_lock;
+
+} guac_common_input_coalescer;
+
+/**
+ * Allocates a new guac_common_input_coalescer which passes each input event
+ * that must be sent to the given handler. The button mask of the remote
+ * pointer is initially assumed to be zero (no buttons pressed).
+ *
+ * @param event_size
+ *     The size of each protocol-specific input event, in bytes.
+ *
+ * @param handler
+ *     The handler to invoke for each input event that must be sent.
+ *
+ * @param data
+ *     Arbitrary data to pass to the handler.
+ *
+ * @return
+ *     A newly-allocated guac_common_input_coalescer, which must eventually be
+ *     freed with guac_common_input_coalescer_free().
+ */
+guac_common_input_coalescer* guac_common_input_coalescer_alloc(
+        size_t event_size, guac_common_input_coalescer_handler* handler,
+        void* data);
+
+/**
+ * Frees the given guac_common_input_coalescer. Any held mouse motion is
+ * discarded without being sent.
+ *
+ * @param coalescer
+ *     The guac_common_input_coalescer to free.
+ */
+void guac_common_input_coalescer_free(guac_common_input_coalescer* coalescer);
+
+/**
+ * Submits a mouse event to the given coalescer. The event is either held
+ * back, replacing any held motion that it supersedes, or sent immediately
+ * after any held motion has been sent.
+ *
+ * @param coalescer
+ *     The guac_common_input_coalescer to submit the event to.
+ *
+ * @param event
+ *     The protocol-specific mouse event. This event is copied and need not
+ *     remain valid after this function returns.
+ *
+ * @param user
+ *     The user that produced the mouse event.
+ *
+ * @param mask
+ *     The button mask of the mouse event.
+ */
+void guac_common_input_coalescer_mouse(guac_common_input_coalescer* coalescer,
+        const void* event, const guac_user* user, int mask);
+
+/**
+ * Submits any input event other than a mouse event to the given coalescer.
+ * Any held mouse motion is sent first, followed by the given event.
+ *
+ * @param coalescer
+ *     The guac_common_input_coalescer to submit the event to.
+ *
+ * @param event
+ *     The protocol-specific input event.
+ */
+void guac_common_input_coalescer_event(guac_common_input_coalescer* coalescer,
+        const void* event);
+
+/**
+ * Sends any held mouse motion and publishes the statistics accumulated
+ * since the last flush, such that they are visible to
+ * guac_common_input_coalescer_get_stats(). This function should be called
+ * whenever no further input events are immediately available.
+ *
+ * @param coalescer
+ *     The guac_common_input_coalescer to flush.
+ */
+void guac_common_input_coalescer_flush(guac_common_input_coalescer* coalescer);
+
+/**
+ * Retrieves the statistics of the given coalescer as of its most recent
+ * flush. Unlike the other functions of a guac_common_input_coalescer, this
+ * function may safely be called from any thread.
+ *
+ * @param coalescer
+ *     The guac_common_input_coalescer to retrieve the statistics of.
+ *
+ * @param stats
+ *     The guac_common_input_coalescer_stats structure that should receive
+ *     the statistics.
+ */
+void guac_common_input_coalescer_get_stats(
+        guac_common_input_coalescer* coalescer,
+        guac_common_input_coalescer_stats* stats);
+
+#endif
+
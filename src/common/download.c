@@ -0,0 +1,89 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "common/download.h"
+
+#include <guacamole/protocol-constants.h>
+
+#include <string.h>
+
+void guac_common_download_window_init(guac_common_download_window* window,
+        int size) {
+
+    memset(window, 0, sizeof(guac_common_download_window));
+
+    window->max_blobs = size / GUAC_PROTOCOL_BLOB_MAX_LENGTH;
+    if (window->max_blobs < 1)
+        window->max_blobs = 1;
+
+}
+
+void guac_common_download_window_ack(guac_common_download_window* window) {
+
+    /* The "ack" for the stream itself arrives while no blobs are in flight */
+    if (window->blobs_in_flight > 0)
+        window->blobs_in_flight--;
+
+}
+
+int guac_common_download_window_available(
+        const guac_common_download_window* window, int buffer_size) {
+
+    if (window->eof)
+        return 0;
+
+    int available = (window->max_blobs - window->blobs_in_flight)
+        * GUAC_PROTOCOL_BLOB_MAX_LENGTH;
+
+    if (available > buffer_size)
+        available = buffer_size;
+
+    return available;
+
+}
+
+void guac_common_download_window_sent(guac_common_download_window* window,
+        int length) {
+
+    if (length <= 0) {
+        window->eof = 1;
+        return;
+    }
+
+    /* guac_protocol_send_blobs() splits data into blobs no larger than
+     * GUAC_PROTOCOL_BLOB_MAX_LENGTH, each of which will be acknowledged */
+    window->blobs_in_flight += (length + GUAC_PROTOCOL_BLOB_MAX_LENGTH - 1)
+        / GUAC_PROTOCOL_BLOB_MAX_LENGTH;
+
+    window->bytes_sent += length;
+
+}
+
+void guac_common_download_window_fail(guac_common_download_window* window) {
+    window->eof = 1;
+    window->failed = 1;
+}
+
+int guac_common_download_window_complete(
+        const guac_common_download_window* window) {
+    return window->eof && window->blobs_in_flight == 0;
+}
+
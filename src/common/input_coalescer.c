@@ -0,0 +1,130 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "common/input_coalescer.h"
+
+#include <guacamole/mem.h>
+#include <guacamole/user.h>
+
+#include <pthread.h>
+#include <string.h>
+
+guac_common_input_coalescer* guac_common_input_coalescer_alloc(
+        size_t event_size, guac_common_input_coalescer_handler* handler,
+        void* data) {
+
+    guac_common_input_coalescer* coalescer =
+        guac_mem_zalloc(sizeof(guac_common_input_coalescer));
+
+    coalescer->event_size = event_size;
+    coalescer->handler = handler;
+    coalescer->data = data;
+    coalescer->pending_event = guac_mem_alloc(event_size);
+
+    pthread_mutex_init(&(coalescer->stats_lock), NULL);
+
+    return coalescer;
+
+}
+
+void guac_common_input_coalescer_free(guac_common_input_coalescer* coalescer) {
+
+    pthread_mutex_destroy(&(coalescer->stats_lock));
+
+    guac_mem_free(coalescer->pending_event);
+    guac_mem_free(coalescer);
+
+}
+
+/**
+ * Sends any mouse motion held by the given coalescer.
+ *
+ * @param coalescer
+ *     The guac_common_input_coalescer whose held motion should be sent.
+ */
+static void guac_common_input_coalescer_send_pending(
+        guac_common_input_coalescer* coalescer) {
+
+    if (coalescer->pending) {
+        coalescer->pending = 0;
+        coalescer->handler(coalescer->pending_event, coalescer->data);
+    }
+
+}
+
+void guac_common_input_coalescer_mouse(guac_common_input_coalescer* coalescer,
+        const void* event, const guac_user* user, int mask) {
+
+    coalescer->unpublished.mouse_events_received++;
+
+    /* Motion from the same user supersedes any held motion */
+    if (coalescer->pending && coalescer->pending_user == user
+            && mask == coalescer->last_mask) {
+        memcpy(coalescer->pending_event, event, coalescer->event_size);
+        coalescer->unpublished.mouse_events_coalesced++;
+        return;
+    }
+
+    /* All other events must be sent strictly after any held motion */
+    guac_common_input_coalescer_send_pending(coalescer);
+
+    /* Hold back motion until the next event is known */
+    if (mask == coalescer->last_mask) {
+        memcpy(coalescer->pending_event, event, coalescer->event_size);
+        coalescer->pending_user = user;
+        coalescer->pending = 1;
+        return;
+    }
+
+    /* Button transitions are sent immediately at their own coordinates */
+    coalescer->last_mask = mask;
+    coalescer->handler(event, coalescer->data);
+
+}
+
+void guac_common_input_coalescer_event(guac_common_input_coalescer* coalescer,
+        const void* event) {
+
+    guac_common_input_coalescer_send_pending(coalescer);
+    coalescer->handler(event, coalescer->data);
+
+}
+
+void guac_common_input_coalescer_flush(guac_common_input_coalescer* coalescer) {
+
+    guac_common_input_coalescer_send_pending(coalescer);
+
+    /* Publish statistics once per flush rather than once per event */
+    pthread_mutex_lock(&(coalescer->stats_lock));
+    coalescer->stats = coalescer->unpublished;
+    pthread_mutex_unlock(&(coalescer->stats_lock));
+
+}
+
+void guac_common_input_coalescer_get_stats(
+        guac_common_input_coalescer* coalescer,
+        guac_common_input_coalescer_stats* stats) {
+
+    pthread_mutex_lock(&(coalescer->stats_lock));
+    *stats = coalescer->stats;
+    pthread_mutex_unlock(&(coalescer->stats_lock));
+
+}
+
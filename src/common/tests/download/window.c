@@ -0,0 +1,213 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "common/download.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/protocol-constants.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The size of the simulated file being downloaded, in bytes.
+ */
+#define TEST_FILE_SIZE (16 * 1024 * 1024)
+
+/**
+ * The simulated round-trip time between guacd and the client, in
+ * milliseconds.
+ */
+#define TEST_RTT 10
+
+/**
+ * Simulates downloading a file of TEST_FILE_SIZE bytes through a download
+ * window of the given size, where every blob sent is acknowledged exactly one
+ * round trip later, verifying that the window is never exceeded and that the
+ * download completes only once all blobs have been acknowledged.
+ *
+ * @param size
+ *     The size of the download window, in bytes.
+ *
+ * @param buffer_size
+ *     The size of each read, in bytes.
+ *
+ * @return
+ *     The number of round trips required to complete the download.
+ */
+static int simulate_download(int size, int buffer_size) {
+
+    guac_common_download_window window;
+    guac_common_download_window_init(&window, size);
+
+    int64_t remaining = TEST_FILE_SIZE;
+    int round_trips = 0;
+
+    /* The first "ack" acknowledges the stream itself */
+    int acks = 1;
+
+    while (!guac_common_download_window_complete(&window)) {
+
+        CU_ASSERT_FATAL(acks > 0);
+
+        /* Handle all acks received during this round trip */
+        int pending_acks = acks;
+        acks = 0;
+
+        for (int i = 0; i < pending_acks; i++) {
+
+            guac_common_download_window_ack(&window);
+
+            int available;
+            while ((available = guac_common_download_window_available(&window,
+                            buffer_size)) > 0) {
+
+                int length = available;
+                if (length > remaining)
+                    length = remaining;
+
+                remaining -= length;
+                guac_common_download_window_sent(&window, length);
+
+                /* Each blob sent will be acknowledged next round trip */
+                acks += (length + GUAC_PROTOCOL_BLOB_MAX_LENGTH - 1)
+                    / GUAC_PROTOCOL_BLOB_MAX_LENGTH;
+
+                CU_ASSERT(window.blobs_in_flight <= window.max_blobs);
+
+            }
+
+        }
+
+        round_trips++;
+
+    }
+
+    CU_ASSERT_EQUAL(window.bytes_sent, TEST_FILE_SIZE);
+    CU_ASSERT_EQUAL(window.blobs_in_flight, 0);
+    CU_ASSERT_EQUAL(acks, 0);
+
+    return round_trips;
+
+}
+
+/**
+ * Verifies that a window smaller than a single blob still allows exactly one
+ * blob to be in flight, and that completion waits for that blob to be
+ * acknowledged.
+ */
+void test_download__window_minimum() {
+
+    guac_common_download_window window;
+    guac_common_download_window_init(&window, 1);
+    CU_ASSERT_EQUAL(window.max_blobs, 1);
+
+    /* Acknowledgement of stream creation allows a single blob */
+    guac_common_download_window_ack(&window);
+    CU_ASSERT_EQUAL(guac_common_download_window_available(&window, 65536),
+            GUAC_PROTOCOL_BLOB_MAX_LENGTH);
+
+    guac_common_download_window_sent(&window, 100);
+    CU_ASSERT_EQUAL(guac_common_download_window_available(&window, 65536), 0);
+
+    /* Once that blob is acknowledged, reaching EOF completes the download */
+    guac_common_download_window_ack(&window);
+    guac_common_download_window_sent(&window, 0);
+    CU_ASSERT_TRUE(guac_common_download_window_complete(&window));
+    CU_ASSERT_EQUAL(guac_common_download_window_available(&window, 65536), 0);
+
+}
+
+/**
+ * Verifies that the end of a download is deferred until every blob sent has
+ * been acknowledged.
+ */
+void test_download__window_complete() {
+
+    guac_common_download_window window;
+    guac_common_download_window_init(&window, GUAC_COMMON_DOWNLOAD_DEFAULT_WINDOW);
+
+    guac_common_download_window_ack(&window);
+    guac_common_download_window_sent(&window, GUAC_PROTOCOL_BLOB_MAX_LENGTH * 3);
+    guac_common_download_window_sent(&window, 0);
+
+    CU_ASSERT_EQUAL(window.blobs_in_flight, 3);
+    CU_ASSERT_FALSE(guac_common_download_window_complete(&window));
+
+    guac_common_download_window_ack(&window);
+    guac_common_download_window_ack(&window);
+    CU_ASSERT_FALSE(guac_common_download_window_complete(&window));
+
+    guac_common_download_window_ack(&window);
+    CU_ASSERT_TRUE(guac_common_download_window_complete(&window));
+
+}
+
+/**
+ * Verifies that a failed download sends no further data, yet is not complete
+ * until every blob already sent has been acknowledged.
+ */
+void test_download__window_fail() {
+
+    guac_common_download_window window;
+    guac_common_download_window_init(&window, GUAC_COMMON_DOWNLOAD_DEFAULT_WINDOW);
+
+    guac_common_download_window_ack(&window);
+    guac_common_download_window_sent(&window, GUAC_PROTOCOL_BLOB_MAX_LENGTH * 2);
+    guac_common_download_window_fail(&window);
+
+    CU_ASSERT_TRUE(window.failed);
+    CU_ASSERT_EQUAL(guac_common_download_window_available(&window, 65536), 0);
+    CU_ASSERT_FALSE(guac_common_download_window_complete(&window));
+
+    guac_common_download_window_ack(&window);
+    CU_ASSERT_FALSE(guac_common_download_window_complete(&window));
+    CU_ASSERT_EQUAL(guac_common_download_window_available(&window, 65536), 0);
+
+    guac_common_download_window_ack(&window);
+    CU_ASSERT_TRUE(guac_common_download_window_complete(&window));
+
+}
+
+/**
+ * Compares the throughput of a simulated download using a single 4096-byte
+ * blob per "ack" against the default download window, verifying that the
+ * window allows far more data to be sent per round trip.
+ */
+void test_download__window_throughput() {
+
+    int single = simulate_download(4096, 4096);
+    int windowed = simulate_download(GUAC_COMMON_DOWNLOAD_DEFAULT_WINDOW,
+            GUAC_COMMON_DOWNLOAD_BUFFER_SIZE);
+
+    double single_rate = (double) TEST_FILE_SIZE / (single * TEST_RTT);
+    double windowed_rate = (double) TEST_FILE_SIZE / (windowed * TEST_RTT);
+
+    printf("-------- %s() --------\n", __func__);
+    printf("Transfer  | Round trips | Throughput at %i ms RTT (KB/s)\n", TEST_RTT);
+    printf("Single    | %11i | %10.1f\n", single, single_rate);
+    printf("Windowed  | %11i | %10.1f\n", windowed, windowed_rate);
+
+    /* Each round trip should carry (nearly) a full window of data */
+    int window_bytes = (GUAC_COMMON_DOWNLOAD_DEFAULT_WINDOW / GUAC_PROTOCOL_BLOB_MAX_LENGTH)
+        * GUAC_PROTOCOL_BLOB_MAX_LENGTH;
+    CU_ASSERT(windowed <= TEST_FILE_SIZE / window_bytes + 2);
+    CU_ASSERT(windowed * 32 < single);
+
+}
+
@@ -0,0 +1,286 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "common/input_coalescer.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/user.h>
+
+/**
+ * The maximum number of events that may be recorded by a single test.
+ */
+#define TEST_MAX_EVENTS 64
+
+/**
+ * The types of input event used by these tests.
+ */
+typedef enum test_event_type {
+
+    /**
+     * A mouse event.
+     */
+    TEST_EVENT_MOUSE,
+
+    /**
+     * A key event.
+     */
+    TEST_EVENT_KEY,
+
+    /**
+     * A touch event.
+     */
+    TEST_EVENT_TOUCH
+
+} test_event_type;
+
+/**
+ * Minimal input event, analogous to the protocol-specific input events of
+ * RDP and VNC.
+ */
+typedef struct test_event {
+
+    /**
+     * The type of this event.
+     */
+    test_event_type type;
+
+    /**
+     * The user that produced this event.
+     */
+    const guac_user* user;
+
+    /**
+     * The X coordinate of this event, or the keysym of a key event.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of this event.
+     */
+    int y;
+
+    /**
+     * The button mask of this event, if it is a mouse event.
+     */
+    int mask;
+
+} test_event;
+
+/**
+ * All events sent by the coalescer under test, in the order sent.
+ */
+static test_event sent[TEST_MAX_EVENTS];
+
+/**
+ * The number of events in the sent array.
+ */
+static int sent_count;
+
+/**
+ * Two distinct users producing input.
+ */
+static guac_user user_a, user_b;
+
+/**
+ * guac_common_input_coalescer_handler which records each event sent within
+ * the sent array. The data parameter is unused.
+ */
+static void test_record_event(const void* event, void* data) {
+
+    CU_ASSERT_FATAL(sent_count < TEST_MAX_EVENTS);
+    sent[sent_count++] = *((const test_event*) event);
+
+}
+
+/**
+ * Submits each of the given events to a new coalescer, in order, and then
+ * flushes the coalescer, recording all events sent within the sent array.
+ *
+ * @param events
+ *     The events to submit.
+ *
+ * @param count
+ *     The number of events to submit.
+ *
+ * @param stats
+ *     The guac_common_input_coalescer_stats structure that should receive
+ *     the statistics of the coalescer after it has been flushed.
+ */
+static void test_coalesce(const test_event* events, int count,
+        guac_common_input_coalescer_stats* stats) {
+
+    sent_count = 0;
+
+    guac_common_input_coalescer* coalescer = guac_common_input_coalescer_alloc(
+            sizeof(test_event), test_record_event, NULL);
+
+    for (int i = 0; i < count; i++) {
+        if (events[i].type == TEST_EVENT_MOUSE)
+            guac_common_input_coalescer_mouse(coalescer, &events[i],
+                    events[i].user, events[i].mask);
+        else
+            guac_common_input_coalescer_event(coalescer, &events[i]);
+    }
+
+    guac_common_input_coalescer_flush(coalescer);
+    guac_common_input_coalescer_get_stats(coalescer, stats);
+    guac_common_input_coalescer_free(coalescer);
+
+}
+
+/**
+ * Verifies that the given event was sent at the given position.
+ *
+ * @param index
+ *     The index of the event within the sent array.
+ *
+ * @param expected
+ *     The event that should have been sent at that index.
+ */
+static void test_assert_sent(int index, const test_event* expected) {
+
+    CU_ASSERT_FATAL(index < sent_count);
+    CU_ASSERT_EQUAL(sent[index].type, expected->type);
+    CU_ASSERT_PTR_EQUAL(sent[index].user, expected->user);
+    CU_ASSERT_EQUAL(sent[index].x, expected->x);
+    CU_ASSERT_EQUAL(sent[index].y, expected->y);
+    CU_ASSERT_EQUAL(sent[index].mask, expected->mask);
+
+}
+
+/**
+ * Verifies that a run of motion from a single user is sent only as its final
+ * position, and that the statistics account for every superseded event.
+ */
+void test_input__coalesce_motion() {
+
+    test_event events[] = {
+        { TEST_EVENT_MOUSE, &user_a, 1, 1, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 2, 2, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 3, 3, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 4, 4, 0 }
+    };
+
+    guac_common_input_coalescer_stats stats;
+    test_coalesce(events, 4, &stats);
+
+    CU_ASSERT_EQUAL(sent_count, 1);
+    test_assert_sent(0, &events[3]);
+
+    CU_ASSERT_EQUAL(stats.mouse_events_received, 4);
+    CU_ASSERT_EQUAL(stats.mouse_events_coalesced, 3);
+
+}
+
+/**
+ * Verifies that button transitions are never coalesced, are sent at their
+ * own coordinates, and cause any preceding motion to be sent first.
+ */
+void test_input__coalesce_buttons() {
+
+    test_event events[] = {
+        { TEST_EVENT_MOUSE, &user_a, 1, 1, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 2, 2, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 3, 3, 1 }, /* Press */
+        { TEST_EVENT_MOUSE, &user_a, 4, 4, 1 },
+        { TEST_EVENT_MOUSE, &user_a, 5, 5, 1 },
+        { TEST_EVENT_MOUSE, &user_a, 6, 6, 0 }, /* Release */
+        { TEST_EVENT_MOUSE, &user_a, 7, 7, 0 }
+    };
+
+    guac_common_input_coalescer_stats stats;
+    test_coalesce(events, 7, &stats);
+
+    CU_ASSERT_EQUAL(sent_count, 5);
+    test_assert_sent(0, &events[1]);
+    test_assert_sent(1, &events[2]);
+    test_assert_sent(2, &events[4]);
+    test_assert_sent(3, &events[5]);
+    test_assert_sent(4, &events[6]);
+
+    CU_ASSERT_EQUAL(stats.mouse_events_received, 7);
+    CU_ASSERT_EQUAL(stats.mouse_events_coalesced, 2);
+
+}
+
+/**
+ * Verifies that key and touch events are never reordered relative to mouse
+ * events, such that motion preceding a key or touch is sent before it and
+ * motion following it is never merged with motion preceding it.
+ */
+void test_input__coalesce_mixed() {
+
+    test_event events[] = {
+        { TEST_EVENT_MOUSE, &user_a, 1, 1, 0 },
+        { TEST_EVENT_KEY,   &user_a, 0xFFE3, 0, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 2, 2, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 3, 3, 0 },
+        { TEST_EVENT_TOUCH, &user_a, 10, 10, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 4, 4, 1 }, /* Press */
+        { TEST_EVENT_KEY,   &user_a, 0xFFE3, 1, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 5, 5, 1 }
+    };
+
+    guac_common_input_coalescer_stats stats;
+    test_coalesce(events, 8, &stats);
+
+    CU_ASSERT_EQUAL(sent_count, 7);
+    test_assert_sent(0, &events[0]);
+    test_assert_sent(1, &events[1]);
+    test_assert_sent(2, &events[3]);
+    test_assert_sent(3, &events[4]);
+    test_assert_sent(4, &events[5]);
+    test_assert_sent(5, &events[6]);
+    test_assert_sent(6, &events[7]);
+
+    CU_ASSERT_EQUAL(stats.mouse_events_received, 5);
+    CU_ASSERT_EQUAL(stats.mouse_events_coalesced, 1);
+
+}
+
+/**
+ * Verifies that motion from different users is never merged, while button
+ * transitions are judged against the button state shared by all users.
+ */
+void test_input__coalesce_users() {
+
+    test_event events[] = {
+        { TEST_EVENT_MOUSE, &user_a, 1, 1, 0 },
+        { TEST_EVENT_MOUSE, &user_b, 2, 2, 0 },
+        { TEST_EVENT_MOUSE, &user_a, 3, 3, 0 },
+        { TEST_EVENT_MOUSE, &user_b, 4, 4, 1 }, /* Press by B */
+        { TEST_EVENT_MOUSE, &user_a, 5, 5, 1 }, /* Motion given B's press */
+        { TEST_EVENT_MOUSE, &user_a, 6, 6, 1 }
+    };
+
+    guac_common_input_coalescer_stats stats;
+    test_coalesce(events, 6, &stats);
+
+    CU_ASSERT_EQUAL(sent_count, 5);
+    test_assert_sent(0, &events[0]);
+    test_assert_sent(1, &events[1]);
+    test_assert_sent(2, &events[2]);
+    test_assert_sent(3, &events[3]);
+    test_assert_sent(4, &events[5]);
+
+    CU_ASSERT_EQUAL(stats.mouse_events_received, 6);
+    CU_ASSERT_EQUAL(stats.mouse_events_coalesced, 1);
+
+}
+
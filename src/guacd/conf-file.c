@@ -28,6 +28,7 @@
 #include <guacamole/string.h>
 
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -91,6 +92,91 @@ static int guacd_conf_callback(const char* section, const char* param, const cha
 
         }
 
+        /* Max number of image encoding threads per connection */
+        else if (strcmp(param, "max_worker_threads") == 0) {
+
+            char* end;
+            long threads = strtol(value, &end, 10);
+
+            /* Invalid thread count */
+            if (*value == '\0' || *end != '\0' || threads < 0 || threads > INT_MAX) {
+                guacd_conf_parse_error = "Invalid number of worker threads. The number of worker threads must be a non-negative integer, where 0 means the number of threads is determined automatically.";
+                return 1;
+            }
+
+            /* Valid thread count */
+            config->max_worker_threads = (int) threads;
+            return 0;
+
+        }
+
+        /* Handling of user I/O */
+        else if (strcmp(param, "user_io") == 0) {
+
+            if (strcmp(value, "direct") == 0)
+                config->proxy_user_io = 0;
+
+            else if (strcmp(value, "proxy") == 0)
+                config->proxy_user_io = 1;
+
+            /* Invalid I/O handling */
+            else {
+                guacd_conf_parse_error = "Invalid user I/O handling. Valid values are: \"direct\" and \"proxy\".";
+                return 1;
+            }
+
+            return 0;
+
+        }
+
+    }
+
+    /* Options related to idle connection processes */
+    else if (strcmp(section, "pool") == 0) {
+
+        /* Protocols to start processes for in advance */
+        if (strcmp(param, "protocols") == 0) {
+            guac_mem_free(config->pool_protocols);
+            config->pool_protocols = guac_strdup(value);
+            return 0;
+        }
+
+        /* Number of idle processes per protocol */
+        else if (strcmp(param, "size") == 0) {
+
+            char* end;
+            long size = strtol(value, &end, 10);
+
+            /* Invalid pool size */
+            if (*value == '\0' || *end != '\0' || size < 0 || size > INT_MAX) {
+                guacd_conf_parse_error = "Invalid pool size. The number of idle processes must be a non-negative integer.";
+                return 1;
+            }
+
+            /* Valid pool size */
+            config->pool_size = (int) size;
+            return 0;
+
+        }
+
+        /* Memory limit for all idle processes */
+        else if (strcmp(param, "max_memory") == 0) {
+
+            char* end;
+            long memory = strtol(value, &end, 10);
+
+            /* Invalid memory limit */
+            if (*value == '\0' || *end != '\0' || memory < 0 || memory > INT_MAX) {
+                guacd_conf_parse_error = "Invalid memory limit. The memory limit must be a non-negative integer number of megabytes, where 0 means no limit.";
+                return 1;
+            }
+
+            /* Valid memory limit */
+            config->pool_max_memory = (int) memory;
+            return 0;
+
+        }
+
     }
 
     /* SSL-specific options */
@@ -184,6 +270,11 @@ guacd_config* guacd_conf_load() {
     conf->foreground = 0;
     conf->print_version = 0;
     conf->max_log_level = GUAC_LOG_INFO;
+    conf->max_worker_threads = 0;
+    conf->proxy_user_io = 0;
+    conf->pool_protocols = NULL;
+    conf->pool_size = 1;
+    conf->pool_max_memory = 0;
 
 #ifdef ENABLE_SSL
     conf->cert_file = NULL;
@@ -83,6 +83,39 @@ typedef struct guacd_config {
      */
     guac_client_log_level max_log_level;
 
+    /**
+     * The maximum number of threads each connection process may use to
+     * encode graphical updates, or zero if the number of threads should be
+     * determined automatically from the number of available processors.
+     */
+    int max_worker_threads;
+
+    /**
+     * Whether all user I/O should be proxied through the main guacd process,
+     * even for users whose connections could instead be handed directly to
+     * the connection-specific process.
+     */
+    int proxy_user_io;
+
+    /**
+     * Comma-separated list of the protocols for which idle connection
+     * processes should be started in advance, or NULL if no processes should
+     * be started in advance.
+     */
+    char* pool_protocols;
+
+    /**
+     * The number of idle connection processes to maintain for each protocol
+     * within pool_protocols.
+     */
+    int pool_size;
+
+    /**
+     * The maximum total resident memory of all idle connection processes, in
+     * mebibytes, or zero if no limit applies.
+     */
+    int pool_max_memory;
+
 } guacd_config;
 
 #endif
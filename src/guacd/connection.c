@@ -24,6 +24,7 @@
 #include "move-fd.h"
 #include "proc.h"
 #include "proc-map.h"
+#include "proxy.h"
 
 #include <guacamole/client.h>
 #include <guacamole/error.h>
@@ -32,6 +33,7 @@
 #include <guacamole/plugin.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 
 #ifdef ENABLE_SSL
@@ -159,14 +161,24 @@ void* guacd_connection_io_thread(void* data) {
 }
 
 /**
- * Adds the given socket as a new user to the given process, automatically
- * reading/writing from the socket via read/write threads. The given socket,
- * parser, and any associated resources will be freed unless the user is not
- * added successfully.
+ * Adds the given socket as a new user to the given process. If the user's
+ * connection is not encrypted and no data remains buffered from the
+ * handshake, the connection's own file descriptor is passed directly to the
+ * process, such that guacd no longer takes part in the user's I/O. Otherwise,
+ * or if all user I/O must be proxied, the process is given one end of a new
+ * socket pair, and data is transferred between that socket pair and the
+ * user's connection by the event-driven proxy (see guacd_proxy_add()),
+ * falling back to dedicated read/write threads if that proxy is unavailable.
+ * The given socket, parser, and any associated resources will be freed unless
+ * the user is not added successfully.
  *
  * If adding the user fails for any reason, non-zero is returned. Zero is
  * returned upon success.
  *
+ * @param params
+ *     The parameters of the connection thread handling the user's
+ *     connection.
+ *
  * @param proc
  *     The existing process to add the user to.
  *
@@ -181,10 +193,36 @@ void* guacd_connection_io_thread(void* data) {
  * @return
  *     Zero if the user was added successfully, non-zero if an error occurred.
  */
-static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* socket) {
+static int guacd_add_user(guacd_connection_thread_params* params,
+        guacd_proc* proc, guac_parser* parser, guac_socket* socket) {
 
     int sockets[2];
 
+#ifdef ENABLE_SSL
+    SSL* ssl = NULL;
+    if (params->ssl_context != NULL)
+        ssl = ((guac_socket_ssl_data*) socket->data)->ssl;
+    int secure = (ssl != NULL);
+#else
+    int secure = 0;
+#endif
+
+    /* Hand the user's connection directly to the process if guacd has
+     * nothing further to do with its data */
+    if (!params->proxy_user_io && !secure && guac_parser_length(parser) == 0) {
+
+        if (!guacd_send_fd(proc->fd_socket, params->connected_socket_fd)) {
+            guacd_log(GUAC_LOG_ERROR, "Unable to add user.");
+            return 1;
+        }
+
+        /* The process now has its own copy of the file descriptor */
+        guac_parser_free(parser);
+        guac_socket_free(socket);
+        return 0;
+
+    }
+
     /* Set up socket pair */
     if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) < 0) {
         guacd_log(GUAC_LOG_ERROR, "Unable to allocate file descriptors for I/O transfer: %s", strerror(errno));
@@ -197,26 +235,59 @@ static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* so
     /* Send user file descriptor to process */
     if (!guacd_send_fd(proc->fd_socket, proc_fd)) {
         guacd_log(GUAC_LOG_ERROR, "Unable to add user.");
+        close(user_fd);
+        close(proc_fd);
         return 1;
     }
 
     /* Close our end of the process file descriptor */
     close(proc_fd);
 
-    guacd_connection_io_thread_params* params = guac_mem_alloc(sizeof(guacd_connection_io_thread_params));
-    params->parser = parser;
-    params->socket = socket;
-    params->fd = user_fd;
+    guacd_connection_io_thread_params* io_params = guac_mem_alloc(sizeof(guacd_connection_io_thread_params));
+    io_params->parser = parser;
+    io_params->socket = socket;
+    io_params->socket_fd = params->connected_socket_fd;
+#ifdef ENABLE_SSL
+    io_params->ssl = ssl;
+#endif
+    io_params->fd = user_fd;
+
+    /* Transfer data using the shared proxy thread, if possible */
+    if (!guacd_proxy_add(io_params))
+        return 0;
 
-    /* Start I/O thread */
+    /* Otherwise, start dedicated I/O thread */
     pthread_t io_thread;
-    pthread_create(&io_thread,  NULL, guacd_connection_io_thread,  params);
+    pthread_create(&io_thread,  NULL, guacd_connection_io_thread,  io_params);
     pthread_detach(io_thread);
 
     return 0;
 
 }
 
+/**
+ * Creates a new process for the given protocol, waiting for that process to
+ * load the protocol's client plugin such that it can accept its first user.
+ *
+ * @param protocol
+ *     The name of the protocol to create the process for.
+ *
+ * @return
+ *     The newly-created process, or NULL if the process could not be created
+ *     or its client plugin could not be loaded.
+ */
+static guacd_proc* guacd_start_proc(const char* protocol) {
+
+    guacd_proc* proc = guacd_create_proc(protocol);
+    if (proc != NULL && guacd_proc_wait_ready(proc, GUACD_TIMEOUT)) {
+        guacd_proc_free(proc);
+        return NULL;
+    }
+
+    return proc;
+
+}
+
 /**
  * Routes the connection on the given socket according to the Guacamole
  * protocol, adding new users and creating new client processes as needed. If a
@@ -226,8 +297,9 @@ static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* so
  * The socket provided will be automatically freed when the connection
  * terminates unless routing fails, in which case non-zero is returned.
  *
- * @param map
- *     The map of existing client processes.
+ * @param params
+ *     The parameters of the connection thread handling the new connection,
+ *     including the map of existing client processes.
  *
  * @param socket
  *     The socket associated with the new connection that must be routed to
@@ -237,8 +309,10 @@ static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* so
  *     Zero if the connection was successfully routed, non-zero if routing has
  *     failed.
  */
-static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
+static int guacd_route_connection(guacd_connection_thread_params* params,
+        guac_socket* socket) {
 
+    guacd_proc_map* map = params->map;
     guac_parser* parser = guac_parser_alloc();
 
     /* Reset guac_error */
@@ -271,6 +345,10 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
 
     guacd_proc* proc;
     int new_process;
+    int pooled = 0;
+
+    /* Startup latency is measured from receipt of "select" */
+    guac_timestamp started = guac_timestamp_current();
 
     const char* identifier = parser->argv[0];
 
@@ -299,8 +377,19 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
         guacd_log(GUAC_LOG_INFO, "Creating new client for protocol \"%s\"",
                 identifier);
 
-        /* Create new process */
-        proc = guacd_create_proc(identifier);
+        /* Use an idle process that has already loaded the protocol's
+         * plugin, if available */
+        proc = guacd_pool_claim(params->pool, identifier);
+        if (proc != NULL) {
+            guacd_log(GUAC_LOG_DEBUG, "Using idle process for protocol "
+                    "\"%s\"", identifier);
+            pooled = 1;
+        }
+
+        /* Otherwise, create new process */
+        else
+            proc = guacd_start_proc(identifier);
+
         new_process = 1;
 
     }
@@ -313,7 +402,29 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
     }
 
     /* Add new user (in the case of a new process, this will be the owner */
-    int add_user_failed = guacd_add_user(proc, parser, socket);
+    int add_user_failed = guacd_add_user(params, proc, parser, socket);
+
+    /* An idle process may have terminated after it was claimed, in which
+     * case the user is added to a newly-created process instead */
+    if (add_user_failed && pooled) {
+
+        guacd_log(GUAC_LOG_WARNING, "Idle process for protocol \"%s\" "
+                "could not accept its first user. Creating new process.",
+                identifier);
+
+        guacd_proc_free(proc);
+        pooled = 0;
+
+        proc = guacd_start_proc(identifier);
+        if (proc == NULL) {
+            guacd_log_guac_error(GUAC_LOG_INFO, "Connection did not succeed");
+            guac_parser_free(parser);
+            return 1;
+        }
+
+        add_user_failed = guacd_add_user(params, proc, parser, socket);
+
+    }
 
     /* If new process was created, manage that process */
     if (new_process) {
@@ -321,6 +432,8 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
         /* The new process will only be active if the user was added */
         if (!add_user_failed) {
 
+            guacd_pool_record_startup(params->pool, pooled, started);
+
             /* Log connection ID */
             guacd_log(GUAC_LOG_INFO, "Connection ID is \"%s\"",
                     proc->client->connection_id);
@@ -347,14 +460,7 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
             guac_parser_free(parser);
 
         /* Force process to stop and clean up */
-        guacd_proc_stop(proc);
-
-        /* Free skeleton client */
-        guac_client_free(proc->client);
-
-        /* Clean up */
-        close(proc->fd_socket);
-        guac_mem_free(proc);
+        guacd_proc_free(proc);
 
     }
 
@@ -367,7 +473,6 @@ void* guacd_connection_thread(void* data) {
 
     guacd_connection_thread_params* params = (guacd_connection_thread_params*) data;
 
-    guacd_proc_map* map = params->map;
     int connected_socket_fd = params->connected_socket_fd;
 
     guac_socket* socket;
@@ -376,8 +481,12 @@ void* guacd_connection_thread(void* data) {
 
     SSL_CTX* ssl_context = params->ssl_context;
 
-    /* If SSL chosen, use it */
-    if (ssl_context != NULL) {
+    /* Use existing SSL connection if the handshake was already performed */
+    if (params->ssl != NULL)
+        socket = guac_socket_open_ssl(params->ssl);
+
+    /* Otherwise, if SSL chosen, use it */
+    else if (ssl_context != NULL) {
         socket = guac_socket_open_secure(ssl_context, connected_socket_fd);
         if (socket == NULL) {
             guacd_log_guac_error(GUAC_LOG_ERROR, "Unable to set up SSL/TLS");
@@ -395,7 +504,7 @@ void* guacd_connection_thread(void* data) {
 #endif
 
     /* Route connection according to Guacamole, creating a new process if needed */
-    if (guacd_route_connection(map, socket))
+    if (guacd_route_connection(params, socket))
         guac_socket_free(socket);
 
     guac_mem_free(params);
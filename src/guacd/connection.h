@@ -22,6 +22,7 @@
 
 #include "config.h"
 
+#include "pool.h"
 #include "proc-map.h"
 
 #ifdef ENABLE_SSL
@@ -38,12 +39,26 @@ typedef struct guacd_connection_thread_params {
      */
     guacd_proc_map* map;
 
+    /**
+     * The shared pool of idle connection processes, which also tracks the
+     * startup latency of new connections.
+     */
+    guacd_pool* pool;
+
 #ifdef ENABLE_SSL
     /**
      * SSL context for encrypted connections to guacd. If SSL is not active,
      * this will be NULL.
      */
     SSL_CTX* ssl_context;
+
+    /**
+     * The SSL connection of the newly-accepted connection, if the SSL
+     * handshake has already been performed. If SSL is not active, or the
+     * handshake must still be performed using ssl_context, this will be
+     * NULL.
+     */
+    SSL* ssl;
 #endif
 
     /**
@@ -51,6 +66,13 @@ typedef struct guacd_connection_thread_params {
      */
     int connected_socket_fd;
 
+    /**
+     * Whether all user I/O must be proxied through the main guacd process,
+     * even for users whose connections could otherwise be handed directly to
+     * the connection-specific process.
+     */
+    int proxy_user_io;
+
 } guacd_connection_thread_params;
 
 /**
@@ -92,6 +114,21 @@ typedef struct guacd_connection_io_thread_params {
      */
     guac_socket* socket;
 
+    /**
+     * The file descriptor underlying the guac_socket which is directly
+     * handling I/O from a user's connection to guacd.
+     */
+    int socket_fd;
+
+#ifdef ENABLE_SSL
+    /**
+     * The SSL session of the guac_socket which is directly handling I/O from
+     * a user's connection to guacd, or NULL if that connection is not
+     * encrypted.
+     */
+    SSL* ssl;
+#endif
+
     /**
      * The file descriptor which is being handled by a guac_socket within the
      * connection-specific process.
@@ -23,9 +23,12 @@
 #include "conf-args.h"
 #include "conf-file.h"
 #include "connection.h"
+#include "listener.h"
 #include "log.h"
+#include "pool.h"
 #include "proc-map.h"
 
+#include <guacamole/display.h>
 #include <guacamole/mem.h>
 
 #ifdef ENABLE_SSL
@@ -308,11 +311,6 @@ int main(int argc, char* argv[]) {
         .ai_protocol = IPPROTO_TCP
     };
 
-    /* Client */
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len;
-    int connected_socket_fd;
-
 #ifdef ENABLE_SSL
     SSL_CTX* ssl_context = NULL;
 #endif
@@ -349,6 +347,15 @@ int main(int argc, char* argv[]) {
     /* Log start */
     guacd_log(GUAC_LOG_INFO, "Guacamole proxy daemon (guacd) version " VERSION " started");
 
+    /* Limit the number of threads each connection process may use for
+     * encoding graphical updates (inherited by each forked process) */
+    if (config->max_worker_threads > 0) {
+        guacd_log(GUAC_LOG_INFO, "Connections will use at most %i worker "
+                "thread(s) to encode graphical updates",
+                config->max_worker_threads);
+        guac_display_set_max_worker_threads(config->max_worker_threads);
+    }
+
     /* Get addresses for binding */
     if ((retval = getaddrinfo(config->bind_host, config->bind_port,
                     &hints, &addresses))) {
@@ -517,6 +524,17 @@ int main(int argc, char* argv[]) {
     sigaction(SIGINT, &signal_stop_action, NULL);
     sigaction(SIGTERM, &signal_stop_action, NULL);
 
+    /* Start idle connection processes in advance, if requested (this must
+     * happen after SIGCHLD is ignored, as terminated idle processes are
+     * detected by their being reaped automatically) */
+    guacd_pool* pool = guacd_pool_alloc(config->pool_protocols,
+            config->pool_size, (long) config->pool_max_memory * 1024 * 1024);
+
+    if (pool == NULL) {
+        guacd_log(GUAC_LOG_ERROR, "Could not allocate pool of idle connection processes.");
+        exit(EXIT_FAILURE);
+    }
+
     /* Log listening status */
     guacd_log(GUAC_LOG_INFO, "Listening on host %s, port %s", bound_address, bound_port);
 
@@ -524,54 +542,28 @@ int main(int argc, char* argv[]) {
     freeaddrinfo(addresses);
 
     /* Listen for connections */
-    if (listen(socket_fd, 5) < 0) {
+    if (listen(socket_fd, SOMAXCONN) < 0) {
         guacd_log(GUAC_LOG_ERROR, "Could not listen on socket: %s", strerror(errno));
         return 3;
     }
 
-    /* Daemon loop */
-    while (!stop_everything) {
-
-        pthread_t child_thread;
-
-        /* Accept connection */
-        client_addr_len = sizeof(client_addr);
-        connected_socket_fd = accept(socket_fd,
-                (struct sockaddr*) &client_addr, &client_addr_len);
-
-        if (connected_socket_fd < 0) {
-            if (errno == EINTR)
-                guacd_log(GUAC_LOG_DEBUG, "Accepting of further client connection(s) interrupted by signal.");
-            else
-                guacd_log(GUAC_LOG_ERROR, "Could not accept client connection: %s", strerror(errno));
-            continue;
-        }
-
-        /* Set TCP_NODELAY to avoid any latency that would otherwise be added by the OS'
-         * networking stack and Nagle's algorithm */
-        const int SO_TRUE = 1;
-        setsockopt(connected_socket_fd, IPPROTO_TCP, TCP_NODELAY,
-                (const void*) &SO_TRUE, sizeof(SO_TRUE));
-
-        /* Create parameters for connection thread */
-        guacd_connection_thread_params* params = guac_mem_alloc(sizeof(guacd_connection_thread_params));
-        if (params == NULL) {
-            guacd_log(GUAC_LOG_ERROR, "Could not create connection thread: %s", strerror(errno));
-            continue;
-        }
-
-        params->map = map;
-        params->connected_socket_fd = connected_socket_fd;
-
+    /* Parameters shared by all connection threads */
+    guacd_connection_thread_params connection_defaults = {
+        .map = map,
+        .pool = pool,
+        .proxy_user_io = config->proxy_user_io,
 #ifdef ENABLE_SSL
-        params->ssl_context = ssl_context;
+        .ssl_context = ssl_context,
 #endif
+        .connected_socket_fd = -1
+    };
 
-        /* Spawn thread to handle connection */
-        pthread_create(&child_thread, NULL, guacd_connection_thread, params);
-        pthread_detach(child_thread);
+    /* Daemon loop */
+    if (guacd_listen(socket_fd, &connection_defaults, &stop_everything))
+        guacd_log(GUAC_LOG_ERROR, "No further connections can be accepted.");
 
-    }
+    /* Stop all idle connection processes */
+    guacd_pool_stop(pool);
 
     /* Stop all connections */
     if (map != NULL) {
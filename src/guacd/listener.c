@@ -0,0 +1,739 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "connection.h"
+#include "listener.h"
+#include "log.h"
+#include "proc.h"
+
+#include <guacamole/error.h>
+#include <guacamole/mem.h>
+#include <guacamole/parser-constants.h>
+#include <guacamole/timestamp.h>
+
+#ifdef ENABLE_SSL
+#include <openssl/ssl.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+/**
+ * Prepares a newly-accepted connection for use, disabling Nagle's algorithm
+ * to avoid any latency that would otherwise be added by the OS' networking
+ * stack.
+ *
+ * @param fd
+ *     The file descriptor of the newly-accepted connection.
+ */
+static void guacd_listener_init_connection(int fd) {
+    const int SO_TRUE = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+            (const void*) &SO_TRUE, sizeof(SO_TRUE));
+}
+
+/**
+ * Allocates the parameters of a new connection thread for the given
+ * connection, copying all shared parameters from the given defaults.
+ *
+ * @param defaults
+ *     The parameters shared by all connection threads.
+ *
+ * @param fd
+ *     The file descriptor of the connection being handed to the thread.
+ *
+ * @return
+ *     The newly-allocated connection thread parameters, or NULL if
+ *     allocation fails.
+ */
+static guacd_connection_thread_params* guacd_listener_alloc_params(
+        const guacd_connection_thread_params* defaults, int fd) {
+
+    guacd_connection_thread_params* params = guac_mem_alloc(sizeof(guacd_connection_thread_params));
+    if (params == NULL)
+        return NULL;
+
+    *params = *defaults;
+    params->connected_socket_fd = fd;
+
+#ifdef ENABLE_SSL
+    params->ssl = NULL;
+#endif
+
+    return params;
+
+}
+
+/**
+ * Starts a new, detached connection thread which will route the connection
+ * described by the given parameters.
+ *
+ * @param params
+ *     The parameters of the connection thread, which will be freed by that
+ *     thread.
+ */
+static void guacd_listener_start_thread(guacd_connection_thread_params* params) {
+    pthread_t connection_thread;
+    pthread_create(&connection_thread, NULL, guacd_connection_thread, params);
+    pthread_detach(connection_thread);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+/**
+ * The state of a handshake that has not yet progressed far enough for its
+ * connection to be routed.
+ */
+typedef enum guacd_listener_status {
+
+    /**
+     * Further data must be received or sent before the connection can be
+     * routed.
+     */
+    GUACD_LISTENER_WAIT,
+
+    /**
+     * The connection can now be routed by a connection thread.
+     */
+    GUACD_LISTENER_READY,
+
+    /**
+     * The handshake has failed, and the connection must be closed.
+     */
+    GUACD_LISTENER_FAILED
+
+} guacd_listener_status;
+
+/**
+ * A connection that has been accepted but cannot yet be routed.
+ */
+typedef struct guacd_listener_pending {
+
+    /**
+     * The file descriptor of the connection.
+     */
+    int fd;
+
+#ifdef ENABLE_SSL
+    /**
+     * The SSL connection being established over the connection, or NULL if
+     * SSL is not active.
+     */
+    SSL* ssl;
+
+    /**
+     * Whether the SSL handshake has completed.
+     */
+    int ssl_established;
+#endif
+
+    /**
+     * The time by which the connection must be ready for routing, after
+     * which the connection is closed.
+     */
+    guac_timestamp deadline;
+
+    /**
+     * The previous pending connection, in order of deadline, or NULL if this
+     * connection has the earliest deadline.
+     */
+    struct guacd_listener_pending* prev;
+
+    /**
+     * The next pending connection, in order of deadline, or NULL if this
+     * connection has the latest deadline.
+     */
+    struct guacd_listener_pending* next;
+
+} guacd_listener_pending;
+
+/**
+ * All connections which have been accepted but cannot yet be routed. As every
+ * connection is given the same amount of time to complete its handshake, the
+ * connections are ordered by deadline simply by appending each new
+ * connection.
+ */
+typedef struct guacd_listener {
+
+    /**
+     * The epoll instance monitoring the listening socket and all pending
+     * connections.
+     */
+    int epoll_fd;
+
+    /**
+     * The parameters shared by all connection threads.
+     */
+    const guacd_connection_thread_params* defaults;
+
+    /**
+     * The pending connection with the earliest deadline, or NULL if there
+     * are no pending connections.
+     */
+    guacd_listener_pending* head;
+
+    /**
+     * The pending connection with the latest deadline, or NULL if there are
+     * no pending connections.
+     */
+    guacd_listener_pending* tail;
+
+} guacd_listener;
+
+/**
+ * Sets or clears the O_NONBLOCK flag of the given file descriptor.
+ *
+ * @param fd
+ *     The file descriptor to modify.
+ *
+ * @param nonblocking
+ *     Non-zero if O_NONBLOCK should be set, zero if it should be cleared.
+ *
+ * @return
+ *     Zero on success, non-zero if the flag could not be modified.
+ */
+static int guacd_listener_set_nonblocking(int fd, int nonblocking) {
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0)
+        return 1;
+
+    if (nonblocking)
+        flags |= O_NONBLOCK;
+    else
+        flags &= ~O_NONBLOCK;
+
+    return fcntl(fd, F_SETFL, flags) < 0;
+
+}
+
+/**
+ * Returns whether the given data begins with a complete Guacamole
+ * instruction. Data which cannot possibly be a valid instruction is also
+ * considered complete, such that the usual handshake failure is reported
+ * once the connection is routed.
+ *
+ * @param buffer
+ *     The data received thus far.
+ *
+ * @param length
+ *     The number of bytes of data received.
+ *
+ * @return
+ *     Non-zero if the data contains a complete (or invalid) instruction,
+ *     zero if further data is required.
+ */
+static int guacd_listener_instruction_complete(const char* buffer, int length) {
+
+    const char* current = buffer;
+    const char* end = buffer + length;
+
+    for (;;) {
+
+        /* Parse element length */
+        int element_length = 0;
+        while (current < end && *current >= '0' && *current <= '9') {
+            element_length = element_length * 10 + *(current++) - '0';
+            if (element_length > GUAC_INSTRUCTION_MAX_LENGTH)
+                return 1;
+        }
+
+        if (current == end)
+            return 0;
+
+        if (*(current++) != '.')
+            return 1;
+
+        /* Skip element content, where the length is in characters, not
+         * bytes */
+        for (; current < end; current++) {
+
+            /* Continuation bytes never start a character */
+            if (((unsigned char) *current & 0xC0) == 0x80)
+                continue;
+
+            if (element_length == 0)
+                break;
+
+            element_length--;
+
+        }
+
+        if (current == end)
+            return 0;
+
+        /* Instruction ends with a semicolon, while elements are separated by
+         * commas */
+        if (*current != ',')
+            return 1;
+
+        current++;
+
+    }
+
+}
+
+/**
+ * Advances the handshake of the given pending connection as far as is
+ * possible without blocking.
+ *
+ * @param pending
+ *     The pending connection whose handshake should be advanced.
+ *
+ * @return
+ *     The state of the handshake.
+ */
+static guacd_listener_status guacd_listener_advance(
+        guacd_listener_pending* pending) {
+
+    char buffer[GUACD_LISTENER_PEEK_SIZE];
+    int length;
+
+#ifdef ENABLE_SSL
+    if (pending->ssl != NULL) {
+
+        /* Complete SSL handshake before any data can be inspected */
+        if (!pending->ssl_established) {
+
+            int result = SSL_accept(pending->ssl);
+            if (result <= 0) {
+
+                int error = SSL_get_error(pending->ssl, result);
+                if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+                    return GUACD_LISTENER_WAIT;
+
+                guac_error = GUAC_STATUS_INTERNAL_ERROR;
+                guac_error_message = "SSL accept failed";
+                guacd_log_guac_error(GUAC_LOG_ERROR, "Unable to set up SSL/TLS");
+                return GUACD_LISTENER_FAILED;
+
+            }
+
+            pending->ssl_established = 1;
+
+        }
+
+        length = SSL_peek(pending->ssl, buffer, sizeof(buffer));
+        if (length <= 0) {
+
+            int error = SSL_get_error(pending->ssl, length);
+            if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+                return GUACD_LISTENER_WAIT;
+
+            guac_error = GUAC_STATUS_CLOSED;
+            guacd_log_handshake_failure();
+            return GUACD_LISTENER_FAILED;
+
+        }
+
+        if (guacd_listener_instruction_complete(buffer, length)
+                || length == sizeof(buffer))
+            return GUACD_LISTENER_READY;
+
+        /* SSL_peek() provides the contents of only one SSL record at a time,
+         * so any further data already received cannot be inspected without
+         * consuming that record. Leave that data to the connection thread. */
+        char next;
+        if (recv(pending->fd, &next, sizeof(next), MSG_PEEK | MSG_DONTWAIT) > 0)
+            return GUACD_LISTENER_READY;
+
+        return GUACD_LISTENER_WAIT;
+
+    }
+#endif
+
+    do {
+        length = recv(pending->fd, buffer, sizeof(buffer), MSG_PEEK);
+    } while (length < 0 && errno == EINTR);
+
+    if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return GUACD_LISTENER_WAIT;
+
+    if (length <= 0) {
+        guac_error = GUAC_STATUS_CLOSED;
+        guacd_log_handshake_failure();
+        return GUACD_LISTENER_FAILED;
+    }
+
+    if (guacd_listener_instruction_complete(buffer, length)
+            || length == sizeof(buffer))
+        return GUACD_LISTENER_READY;
+
+    return GUACD_LISTENER_WAIT;
+
+}
+
+/**
+ * Stops monitoring the given pending connection and removes it from the list
+ * of pending connections, without closing or freeing the connection.
+ *
+ * @param listener
+ *     The listener containing the pending connection.
+ *
+ * @param pending
+ *     The pending connection to remove.
+ */
+static void guacd_listener_remove(guacd_listener* listener,
+        guacd_listener_pending* pending) {
+
+    epoll_ctl(listener->epoll_fd, EPOLL_CTL_DEL, pending->fd, NULL);
+
+    if (pending->prev != NULL)
+        pending->prev->next = pending->next;
+    else
+        listener->head = pending->next;
+
+    if (pending->next != NULL)
+        pending->next->prev = pending->prev;
+    else
+        listener->tail = pending->prev;
+
+}
+
+/**
+ * Closes and frees the given pending connection.
+ *
+ * @param listener
+ *     The listener containing the pending connection.
+ *
+ * @param pending
+ *     The pending connection to close.
+ */
+static void guacd_listener_close(guacd_listener* listener,
+        guacd_listener_pending* pending) {
+
+    guacd_listener_remove(listener, pending);
+
+#ifdef ENABLE_SSL
+    if (pending->ssl != NULL)
+        SSL_free(pending->ssl);
+#endif
+
+    close(pending->fd);
+    guac_mem_free(pending);
+
+}
+
+/**
+ * Hands the given pending connection to a new connection thread for routing,
+ * freeing the pending connection.
+ *
+ * @param listener
+ *     The listener containing the pending connection.
+ *
+ * @param pending
+ *     The pending connection to route.
+ */
+static void guacd_listener_route(guacd_listener* listener,
+        guacd_listener_pending* pending) {
+
+    /* Connection threads use blocking I/O */
+    if (guacd_listener_set_nonblocking(pending->fd, 0)) {
+        guacd_log(GUAC_LOG_ERROR, "Could not prepare connection for "
+                "routing: %s", strerror(errno));
+        guacd_listener_close(listener, pending);
+        return;
+    }
+
+    guacd_connection_thread_params* params =
+        guacd_listener_alloc_params(listener->defaults, pending->fd);
+
+    if (params == NULL) {
+        guacd_log(GUAC_LOG_ERROR, "Could not create connection thread: %s", strerror(errno));
+        guacd_listener_close(listener, pending);
+        return;
+    }
+
+#ifdef ENABLE_SSL
+    params->ssl = pending->ssl;
+#endif
+
+    guacd_listener_remove(listener, pending);
+    guac_mem_free(pending);
+
+    guacd_listener_start_thread(params);
+
+}
+
+/**
+ * Advances the handshake of the given pending connection, routing or closing
+ * the connection as appropriate.
+ *
+ * @param listener
+ *     The listener containing the pending connection.
+ *
+ * @param pending
+ *     The pending connection to handle.
+ */
+static void guacd_listener_handle(guacd_listener* listener,
+        guacd_listener_pending* pending) {
+
+    switch (guacd_listener_advance(pending)) {
+
+        case GUACD_LISTENER_READY:
+            guacd_listener_route(listener, pending);
+            break;
+
+        case GUACD_LISTENER_FAILED:
+            guacd_listener_close(listener, pending);
+            break;
+
+        case GUACD_LISTENER_WAIT:
+            break;
+
+    }
+
+}
+
+/**
+ * Accepts all connections currently waiting on the given listening socket,
+ * adding each as a new pending connection.
+ *
+ * @param listener
+ *     The listener to add the new connections to.
+ *
+ * @param socket_fd
+ *     The file descriptor of the listening socket.
+ */
+static void guacd_listener_accept(guacd_listener* listener, int socket_fd) {
+
+    for (;;) {
+
+        int fd = accept(socket_fd, NULL, NULL);
+        if (fd < 0) {
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                guacd_log(GUAC_LOG_ERROR, "Could not accept client connection: %s", strerror(errno));
+
+            return;
+
+        }
+
+        guacd_listener_init_connection(fd);
+
+        guacd_listener_pending* pending = guac_mem_zalloc(sizeof(guacd_listener_pending));
+        pending->fd = fd;
+        pending->deadline = guac_timestamp_current() + GUACD_TIMEOUT;
+
+#ifdef ENABLE_SSL
+        SSL_CTX* ssl_context = listener->defaults->ssl_context;
+        if (ssl_context != NULL) {
+
+            pending->ssl = SSL_new(ssl_context);
+            if (pending->ssl == NULL) {
+                guacd_log(GUAC_LOG_ERROR, "Unable to set up SSL/TLS");
+                close(fd);
+                guac_mem_free(pending);
+                continue;
+            }
+
+            SSL_set_fd(pending->ssl, fd);
+
+        }
+#endif
+
+        /* Append to list (deadlines are always increasing) */
+        pending->prev = listener->tail;
+        if (listener->tail != NULL)
+            listener->tail->next = pending;
+        else
+            listener->head = pending;
+        listener->tail = pending;
+
+        /* Monitor connection for all further data (edge-triggered, as data
+         * is only ever peeked at and never consumed) */
+        struct epoll_event event = {
+            .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            .data.ptr = pending
+        };
+
+        if (guacd_listener_set_nonblocking(fd, 1)
+                || epoll_ctl(listener->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+            guacd_log(GUAC_LOG_ERROR, "Could not monitor client connection: %s", strerror(errno));
+            guacd_listener_close(listener, pending);
+            continue;
+        }
+
+    }
+
+}
+
+/**
+ * Closes all pending connections whose handshakes have not completed in
+ * time.
+ *
+ * @param listener
+ *     The listener containing the pending connections.
+ */
+static void guacd_listener_expire(guacd_listener* listener) {
+
+    guac_timestamp now = guac_timestamp_current();
+
+    while (listener->head != NULL && listener->head->deadline <= now) {
+        guac_error = GUAC_STATUS_TIMEOUT;
+        guacd_log_handshake_failure();
+        guacd_listener_close(listener, listener->head);
+    }
+
+}
+
+int guacd_listen(int socket_fd, const guacd_connection_thread_params* defaults,
+        int* stop) {
+
+    int retval = 0;
+
+    guacd_listener listener = {
+        .epoll_fd = epoll_create1(0),
+        .defaults = defaults
+    };
+
+    if (listener.epoll_fd < 0) {
+        guacd_log(GUAC_LOG_ERROR, "Could not create epoll instance: %s", strerror(errno));
+        return 1;
+    }
+
+    /* Monitor listening socket for new connections */
+    struct epoll_event listen_event = {
+        .events = EPOLLIN,
+        .data.ptr = NULL
+    };
+
+    if (guacd_listener_set_nonblocking(socket_fd, 1)
+            || epoll_ctl(listener.epoll_fd, EPOLL_CTL_ADD, socket_fd, &listen_event)) {
+        guacd_log(GUAC_LOG_ERROR, "Could not monitor socket: %s", strerror(errno));
+        close(listener.epoll_fd);
+        return 1;
+    }
+
+    struct epoll_event events[GUACD_LISTENER_MAX_EVENTS];
+
+    while (!*stop) {
+
+        /* Wake in time to close the oldest pending connection */
+        int timeout = -1;
+        if (listener.head != NULL) {
+            guac_timestamp remaining = listener.head->deadline - guac_timestamp_current();
+            timeout = remaining > 0 ? (int) remaining : 0;
+        }
+
+        int count = epoll_wait(listener.epoll_fd, events,
+                GUACD_LISTENER_MAX_EVENTS, timeout);
+
+        if (count < 0) {
+
+            if (errno == EINTR) {
+                guacd_log(GUAC_LOG_DEBUG, "Accepting of further client connection(s) interrupted by signal.");
+                continue;
+            }
+
+            guacd_log(GUAC_LOG_ERROR, "Could not wait for client connections: %s", strerror(errno));
+            retval = 1;
+            break;
+
+        }
+
+        /* Each pending connection has only one file descriptor and thus at
+         * most one event per batch, so connections may be freed as they are
+         * handled */
+        for (int i = 0; i < count; i++) {
+
+            guacd_listener_pending* pending = events[i].data.ptr;
+
+            if (pending == NULL)
+                guacd_listener_accept(&listener, socket_fd);
+            else
+                guacd_listener_handle(&listener, pending);
+
+        }
+
+        guacd_listener_expire(&listener);
+
+    }
+
+    /* Close all connections that were never routed */
+    while (listener.head != NULL)
+        guacd_listener_close(&listener, listener.head);
+
+    close(listener.epoll_fd);
+    return retval;
+
+}
+
+#else
+
+int guacd_listen(int socket_fd, const guacd_connection_thread_params* defaults,
+        int* stop) {
+
+    /* Client */
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len;
+    int connected_socket_fd;
+
+    while (!*stop) {
+
+        /* Accept connection */
+        client_addr_len = sizeof(client_addr);
+        connected_socket_fd = accept(socket_fd,
+                (struct sockaddr*) &client_addr, &client_addr_len);
+
+        if (connected_socket_fd < 0) {
+            if (errno == EINTR)
+                guacd_log(GUAC_LOG_DEBUG, "Accepting of further client connection(s) interrupted by signal.");
+            else
+                guacd_log(GUAC_LOG_ERROR, "Could not accept client connection: %s", strerror(errno));
+            continue;
+        }
+
+        guacd_listener_init_connection(connected_socket_fd);
+
+        /* Create parameters for connection thread */
+        guacd_connection_thread_params* params =
+            guacd_listener_alloc_params(defaults, connected_socket_fd);
+
+        if (params == NULL) {
+            guacd_log(GUAC_LOG_ERROR, "Could not create connection thread: %s", strerror(errno));
+            close(connected_socket_fd);
+            continue;
+        }
+
+        /* Spawn thread to handle connection (performing the SSL handshake,
+         * if any, within that thread) */
+        guacd_listener_start_thread(params);
+
+    }
+
+    return 0;
+
+}
+
+#endif
+
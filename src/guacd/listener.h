@@ -0,0 +1,71 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACD_LISTENER_H
+#define GUACD_LISTENER_H
+
+#include "config.h"
+
+#include "connection.h"
+
+/**
+ * The maximum number of events handled by each pass of the listener event
+ * loop.
+ */
+#define GUACD_LISTENER_MAX_EVENTS 256
+
+/**
+ * The maximum number of bytes of a pending connection which are inspected
+ * while waiting for its "select" instruction. If this many bytes have been
+ * received without a complete instruction, the connection is routed anyway,
+ * leaving the connection thread to report the failure.
+ */
+#define GUACD_LISTENER_PEEK_SIZE 8192
+
+/**
+ * Accepts connections on the given listening socket until the given stop
+ * flag is set, handing each connection to a new, detached
+ * guacd_connection_thread() for routing. Where supported, connections are
+ * accepted, their SSL handshakes are performed, and their "select"
+ * instructions are awaited by a single event loop, such that a connection
+ * thread is started only once a connection can be routed. Connections which
+ * do not complete the handshake within GUACD_TIMEOUT are closed.
+ *
+ * @param socket_fd
+ *     The file descriptor of the socket listening for new connections.
+ *
+ * @param defaults
+ *     The parameters shared by all connection threads (the process map,
+ *     process pool, SSL context, etc.). The connection-specific parameters
+ *     within this structure are ignored.
+ *
+ * @param stop
+ *     A flag which, once set to a non-zero value (typically by a signal
+ *     handler), causes this function to stop accepting connections and
+ *     return.
+ *
+ * @return
+ *     Zero if accepting connections stopped due to the stop flag, non-zero
+ *     if an error prevented further connections from being accepted.
+ */
+int guacd_listen(int socket_fd, const guacd_connection_thread_params* defaults,
+        int* stop);
+
+#endif
+
@@ -0,0 +1,504 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "log.h"
+#include "pool.h"
+#include "proc.h"
+
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/string.h>
+#include <guacamole/timestamp.h>
+
+#include <ctype.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The upper bound of each startup latency bucket, in milliseconds. The final
+ * bucket, which has no upper bound, is not included.
+ */
+static const int guacd_pool_latency_bounds[GUACD_POOL_LATENCY_BUCKETS - 1] = {
+    1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000
+};
+
+/**
+ * Returns the resident memory of the given process, in bytes, as reported by
+ * /proc.
+ *
+ * @param pid
+ *     The ID of the process to inspect.
+ *
+ * @return
+ *     The resident memory of the given process in bytes, or zero if this
+ *     cannot be determined.
+ */
+static long guacd_pool_resident_memory(pid_t pid) {
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%i/statm", (int) pid);
+
+    FILE* statm = fopen(path, "r");
+    if (statm == NULL)
+        return 0;
+
+    /* The second field is the number of resident pages */
+    long size, resident;
+    int fields = fscanf(statm, "%li %li", &size, &resident);
+    fclose(statm);
+
+    if (fields != 2)
+        return 0;
+
+    return resident * sysconf(_SC_PAGESIZE);
+
+}
+
+/**
+ * Returns whether another idle process may be started without exceeding the
+ * memory limit of the given pool. The pool lock must be held.
+ *
+ * @param pool
+ *     The pool to check.
+ *
+ * @return
+ *     Non-zero if another idle process may be started, zero otherwise.
+ */
+static int guacd_pool_memory_available(guacd_pool* pool) {
+
+    if (pool->max_memory <= 0)
+        return 1;
+
+    /* Sum resident memory of all idle processes */
+    long total = 0;
+    for (int i = 0; i < pool->protocol_count; i++) {
+        guacd_pool_protocol* protocol = &pool->protocols[i];
+        for (int j = 0; j < protocol->idle_count; j++)
+            total += guacd_pool_resident_memory(protocol->idle[j]->pid);
+    }
+
+    return total < pool->max_memory;
+
+}
+
+/**
+ * Frees the parent-side resources of a process which has already terminated.
+ *
+ * @param proc
+ *     The terminated process to free.
+ */
+static void guacd_pool_free_terminated(guacd_proc* proc) {
+    guac_client_free(proc->client);
+    close(proc->fd_socket);
+    guac_mem_free(proc);
+}
+
+/**
+ * Returns whether the given idle process has terminated. As SIGCHLD is
+ * ignored by guacd, terminated processes are reaped automatically and their
+ * PIDs may be reused, so termination is instead detected by the process's end
+ * of the socket pair shared with guacd having been closed. An idle process
+ * sends nothing further along that socket pair once it has reported that it
+ * is ready, thus any pending data can only be end-of-file.
+ *
+ * @param proc
+ *     The idle process to check.
+ *
+ * @return
+ *     Non-zero if the given process has terminated, zero otherwise.
+ */
+static int guacd_pool_proc_terminated(guacd_proc* proc) {
+
+    struct pollfd fd_socket = {
+        .fd = proc->fd_socket,
+        .events = POLLIN
+    };
+
+    /* Check for hangup without waiting */
+    if (poll(&fd_socket, 1, 0) <= 0)
+        return 0;
+
+    if (fd_socket.revents & (POLLHUP | POLLERR | POLLNVAL))
+        return 1;
+
+    /* Some platforms report end-of-file only as readable data */
+    char data;
+    return recv(proc->fd_socket, &data, sizeof(data),
+            MSG_PEEK | MSG_DONTWAIT) == 0;
+
+}
+
+/**
+ * Removes all idle processes of the given protocol which have terminated.
+ * The pool lock must be held.
+ *
+ * @param protocol
+ *     The protocol whose idle processes should be checked.
+ */
+static void guacd_pool_remove_terminated(guacd_pool_protocol* protocol) {
+
+    int kept = 0;
+    for (int i = 0; i < protocol->idle_count; i++) {
+
+        guacd_proc* proc = protocol->idle[i];
+
+        if (guacd_pool_proc_terminated(proc)) {
+            guacd_log(GUAC_LOG_WARNING, "Idle process for protocol \"%s\" "
+                    "has terminated unexpectedly.", protocol->name);
+            guacd_pool_free_terminated(proc);
+        }
+        else
+            protocol->idle[kept++] = proc;
+
+    }
+
+    protocol->idle_count = kept;
+
+}
+
+/**
+ * Adds a single new idle process for the given protocol, if possible. The
+ * pool lock must be held, but is released while the process is created and
+ * while waiting for that process to load its client plugin.
+ *
+ * @param pool
+ *     The pool to add the process to.
+ *
+ * @param protocol
+ *     The protocol to create the process for.
+ *
+ * @return
+ *     Non-zero if a process was added, zero if no process could be added.
+ */
+static int guacd_pool_add_proc(guacd_pool* pool, guacd_pool_protocol* protocol) {
+
+    pthread_mutex_unlock(&pool->lock);
+
+    guacd_proc* proc = guacd_create_proc(protocol->name);
+    if (proc != NULL && guacd_proc_wait_ready(proc, GUACD_TIMEOUT)) {
+        guacd_proc_free(proc);
+        proc = NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    /* Avoid repeatedly starting processes that cannot succeed */
+    if (proc == NULL) {
+        guacd_log(GUAC_LOG_WARNING, "Unable to start idle process for "
+                "protocol \"%s\". Retrying in %i seconds.", protocol->name,
+                GUACD_POOL_RETRY_INTERVAL / 1000);
+        protocol->retry_after = guac_timestamp_current()
+            + GUACD_POOL_RETRY_INTERVAL;
+        return 0;
+    }
+
+    /* Discard the process if the pool has been stopped in the meantime */
+    if (!pool->running) {
+        pthread_mutex_unlock(&pool->lock);
+        guacd_proc_free(proc);
+        pthread_mutex_lock(&pool->lock);
+        return 0;
+    }
+
+    protocol->idle[protocol->idle_count++] = proc;
+
+    guacd_log(GUAC_LOG_DEBUG, "Started idle process for protocol \"%s\" "
+            "(%i of %i).", protocol->name, protocol->idle_count, pool->size);
+
+    return 1;
+
+}
+
+/**
+ * Repeatedly replenishes the idle processes of the given pool, checking for
+ * terminated processes periodically and whenever processes are claimed,
+ * until the pool is freed.
+ *
+ * @param data
+ *     The guacd_pool to replenish.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacd_pool_refill_thread(void* data) {
+
+    guacd_pool* pool = (guacd_pool*) data;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->running) {
+
+        for (int i = 0; i < pool->protocol_count && pool->running; i++) {
+
+            guacd_pool_protocol* protocol = &pool->protocols[i];
+            guacd_pool_remove_terminated(protocol);
+
+            /* Start processes until the pool is full or memory runs out */
+            while (pool->running
+                    && protocol->idle_count < pool->size
+                    && guac_timestamp_current() >= protocol->retry_after
+                    && guacd_pool_memory_available(pool)) {
+
+                if (!guacd_pool_add_proc(pool, protocol))
+                    break;
+
+            }
+
+        }
+
+        if (!pool->running)
+            break;
+
+        /* Wait until processes are claimed or the check interval elapses */
+        struct timeval now;
+        gettimeofday(&now, NULL);
+
+        long usec = now.tv_usec + (GUACD_POOL_CHECK_INTERVAL % 1000) * 1000;
+        struct timespec deadline = {
+            .tv_sec  = now.tv_sec + GUACD_POOL_CHECK_INTERVAL / 1000
+                     + usec / 1000000,
+            .tv_nsec = (usec % 1000000) * 1000
+        };
+
+        pthread_cond_timedwait(&pool->refill, &pool->lock, &deadline);
+
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+
+}
+
+guacd_pool* guacd_pool_alloc(const char* protocols, int size, long max_memory) {
+
+    guacd_pool* pool = guac_mem_zalloc(sizeof(guacd_pool));
+    if (pool == NULL)
+        return NULL;
+
+    pool->size = size;
+    pool->max_memory = max_memory;
+    pool->last_report = guac_timestamp_current();
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->refill, NULL);
+
+    /* Nothing further to do if no processes are pooled */
+    if (protocols == NULL || size <= 0)
+        return pool;
+
+    /* Allocate space for every possible entry of the comma-separated list */
+    int max_protocols = 1;
+    for (const char* current = protocols; *current != '\0'; current++) {
+        if (*current == ',')
+            max_protocols++;
+    }
+
+    pool->protocols = guac_mem_zalloc(sizeof(guacd_pool_protocol), max_protocols);
+
+    /* Add each non-empty protocol name within the list */
+    char* list = guac_strdup(protocols);
+    char* state;
+    for (char* name = strtok_r(list, ",", &state); name != NULL;
+            name = strtok_r(NULL, ",", &state)) {
+
+        /* Ignore any whitespace surrounding the protocol name */
+        while (isspace((unsigned char) *name))
+            name++;
+
+        char* end = name + strlen(name);
+        while (end > name && isspace((unsigned char) end[-1]))
+            *(--end) = '\0';
+
+        if (*name == '\0')
+            continue;
+
+        guacd_pool_protocol* protocol = &pool->protocols[pool->protocol_count++];
+        protocol->name = guac_strdup(name);
+        protocol->idle = guac_mem_zalloc(sizeof(guacd_proc*), size);
+
+        guacd_log(GUAC_LOG_INFO, "Maintaining %i idle process(es) for "
+                "protocol \"%s\".", size, name);
+
+    }
+
+    guac_mem_free(list);
+
+    if (pool->protocol_count == 0)
+        return pool;
+
+    /* Begin filling the pool in the background */
+    pool->running = 1;
+    if (pthread_create(&pool->refill_thread, NULL, guacd_pool_refill_thread, pool)) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to start thread for idle process "
+                "pool. Processes will not be started in advance.");
+        pool->running = 0;
+    }
+
+    return pool;
+
+}
+
+void guacd_pool_stop(guacd_pool* pool) {
+
+    pthread_mutex_lock(&pool->lock);
+    int running = pool->running;
+    pool->running = 0;
+    pthread_cond_signal(&pool->refill);
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Stop replenishing the pool */
+    if (running)
+        pthread_join(pool->refill_thread, NULL);
+
+    /* Terminate all remaining idle processes (the refill thread has stopped
+     * and no process can be claimed once the idle count is zero) */
+    for (int i = 0; i < pool->protocol_count; i++) {
+
+        guacd_pool_protocol* protocol = &pool->protocols[i];
+
+        pthread_mutex_lock(&pool->lock);
+        int idle_count = protocol->idle_count;
+        protocol->idle_count = 0;
+        pthread_mutex_unlock(&pool->lock);
+
+        for (int j = 0; j < idle_count; j++)
+            guacd_proc_free(protocol->idle[j]);
+
+    }
+
+}
+
+guacd_proc* guacd_pool_claim(guacd_pool* pool, const char* protocol_name) {
+
+    guacd_proc* proc = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (int i = 0; i < pool->protocol_count; i++) {
+
+        guacd_pool_protocol* protocol = &pool->protocols[i];
+        if (strcmp(protocol->name, protocol_name) != 0)
+            continue;
+
+        /* Claim the most recently started process that is still running */
+        while (proc == NULL && protocol->idle_count > 0) {
+
+            proc = protocol->idle[--protocol->idle_count];
+
+            if (guacd_pool_proc_terminated(proc)) {
+                guacd_log(GUAC_LOG_WARNING, "Idle process for protocol "
+                        "\"%s\" has terminated unexpectedly.", protocol->name);
+                guacd_pool_free_terminated(proc);
+                proc = NULL;
+            }
+
+        }
+
+        /* Start replacement in the background */
+        pthread_cond_signal(&pool->refill);
+        break;
+
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return proc;
+
+}
+
+/**
+ * Logs the given startup latency histogram at the info level.
+ *
+ * @param type
+ *     A human-readable description of the connections recorded within the
+ *     histogram.
+ *
+ * @param latency
+ *     The histogram to log.
+ */
+static void guacd_pool_log_latency(const char* type,
+        guacd_pool_latency* latency) {
+
+    char summary[512];
+    int length = 0;
+
+    for (int i = 0; i < GUACD_POOL_LATENCY_BUCKETS; i++) {
+
+        const char* separator = (i == 0) ? "" : ", ";
+
+        if (i < GUACD_POOL_LATENCY_BUCKETS - 1)
+            length += snprintf(summary + length, sizeof(summary) - length,
+                    "%s<=%ims: %i", separator, guacd_pool_latency_bounds[i],
+                    latency->counts[i]);
+        else
+            length += snprintf(summary + length, sizeof(summary) - length,
+                    "%s>%ims: %i", separator, guacd_pool_latency_bounds[i - 1],
+                    latency->counts[i]);
+
+    }
+
+    guacd_log(GUAC_LOG_INFO, "Startup latency of %s connections (%i total): "
+            "%s", type, latency->total, summary);
+
+}
+
+void guacd_pool_record_startup(guacd_pool* pool, int pooled,
+        guac_timestamp started) {
+
+    guac_timestamp now = guac_timestamp_current();
+    guac_timestamp elapsed = now - started;
+
+    /* Locate bucket for the elapsed time */
+    int bucket = 0;
+    while (bucket < GUACD_POOL_LATENCY_BUCKETS - 1
+            && elapsed > guacd_pool_latency_bounds[bucket])
+        bucket++;
+
+    pthread_mutex_lock(&pool->lock);
+
+    guacd_pool_latency* latency = pooled ? &pool->pooled : &pool->forked;
+    latency->counts[bucket]++;
+    latency->total++;
+
+    /* Periodically summarize all latency recorded */
+    if (now - pool->last_report >= GUACD_POOL_REPORT_INTERVAL) {
+
+        if (pool->pooled.total > 0)
+            guacd_pool_log_latency("pooled", &pool->pooled);
+
+        if (pool->forked.total > 0)
+            guacd_pool_log_latency("newly-created", &pool->forked);
+
+        pool->last_report = now;
+
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+}
+
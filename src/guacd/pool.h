@@ -0,0 +1,248 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACD_POOL_H
+#define GUACD_POOL_H
+
+#include "config.h"
+
+#include "proc.h"
+
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+
+/**
+ * The number of milliseconds between each check of the pool for idle
+ * processes which have terminated or which must be replaced.
+ */
+#define GUACD_POOL_CHECK_INTERVAL 1000
+
+/**
+ * The number of milliseconds to wait before again attempting to start idle
+ * processes for a protocol whose previous process failed to start.
+ */
+#define GUACD_POOL_RETRY_INTERVAL 30000
+
+/**
+ * The minimum number of milliseconds between each logged summary of
+ * connection startup latency.
+ */
+#define GUACD_POOL_REPORT_INTERVAL 60000
+
+/**
+ * The number of buckets within each startup latency histogram. The final
+ * bucket counts all latencies beyond the upper bound of the others.
+ */
+#define GUACD_POOL_LATENCY_BUCKETS 12
+
+/**
+ * A histogram of the time taken for new connections to be handed to a
+ * connection process that is ready to handle them.
+ */
+typedef struct guacd_pool_latency {
+
+    /**
+     * The number of connections within each latency bucket. The upper bound
+     * of each bucket is defined by guacd_pool_latency_bounds.
+     */
+    int counts[GUACD_POOL_LATENCY_BUCKETS];
+
+    /**
+     * The total number of connections recorded within this histogram.
+     */
+    int total;
+
+} guacd_pool_latency;
+
+/**
+ * The idle processes maintained for a single protocol.
+ */
+typedef struct guacd_pool_protocol {
+
+    /**
+     * The name of the protocol, as would be provided in the "select"
+     * instruction.
+     */
+    char* name;
+
+    /**
+     * Array of all idle processes for this protocol, each of which has
+     * already loaded the client plugin for the protocol and is waiting for
+     * its first user.
+     */
+    guacd_proc** idle;
+
+    /**
+     * The number of processes within the idle array.
+     */
+    int idle_count;
+
+    /**
+     * The time before which no further processes should be started for this
+     * protocol, as the most recent attempt failed.
+     */
+    guac_timestamp retry_after;
+
+} guacd_pool_protocol;
+
+/**
+ * A pool of idle connection processes, started in advance for each of a set
+ * of protocols such that new connections need not wait for a process to be
+ * created and for its client plugin to be loaded. The pool is replenished by
+ * a background thread as processes are claimed.
+ */
+typedef struct guacd_pool {
+
+    /**
+     * Array of all protocols for which idle processes are maintained.
+     */
+    guacd_pool_protocol* protocols;
+
+    /**
+     * The number of protocols within the protocols array.
+     */
+    int protocol_count;
+
+    /**
+     * The number of idle processes to maintain for each protocol.
+     */
+    int size;
+
+    /**
+     * The maximum total resident memory of all idle processes, in bytes, or
+     * zero if no limit applies. No further idle processes are started while
+     * this limit is reached.
+     */
+    long max_memory;
+
+    /**
+     * Whether the background thread which replenishes the pool should
+     * continue running.
+     */
+    int running;
+
+    /**
+     * The background thread which replenishes the pool, if any protocols are
+     * pooled.
+     */
+    pthread_t refill_thread;
+
+    /**
+     * Startup latency of connections which were handed to an idle process.
+     */
+    guacd_pool_latency pooled;
+
+    /**
+     * Startup latency of connections for which a new process had to be
+     * created.
+     */
+    guacd_pool_latency forked;
+
+    /**
+     * The time that startup latency was most recently logged.
+     */
+    guac_timestamp last_report;
+
+    /**
+     * Lock which must be acquired before accessing any of the idle processes
+     * or startup latency histograms.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever the pool requires replenishing
+     * or the background thread must stop.
+     */
+    pthread_cond_t refill;
+
+} guacd_pool;
+
+/**
+ * Allocates a new pool of idle connection processes, starting a background
+ * thread which creates the idle processes for each given protocol. If no
+ * protocols are given, no processes are pooled, but the pool may still be
+ * used to track startup latency.
+ *
+ * @param protocols
+ *     A comma-separated list of the protocols for which idle processes
+ *     should be maintained, or NULL if no processes should be pooled.
+ *
+ * @param size
+ *     The number of idle processes to maintain for each protocol.
+ *
+ * @param max_memory
+ *     The maximum total resident memory of all idle processes, in bytes, or
+ *     zero if no limit applies.
+ *
+ * @return
+ *     A newly-allocated pool, or NULL if the pool could not be created.
+ */
+guacd_pool* guacd_pool_alloc(const char* protocols, int size, long max_memory);
+
+/**
+ * Stops the background thread of the given pool and terminates all idle
+ * processes. Processes already claimed from the pool are unaffected. The pool
+ * itself is not freed, as connection threads may still be using it, but no
+ * further processes can be claimed.
+ *
+ * @param pool
+ *     The pool to stop.
+ */
+void guacd_pool_stop(guacd_pool* pool);
+
+/**
+ * Removes and returns an idle process for the given protocol from the pool,
+ * signalling the background thread to start a replacement. The returned
+ * process is ready to receive its first user and is managed exactly as if it
+ * had just been returned by guacd_create_proc().
+ *
+ * @param pool
+ *     The pool to claim a process from.
+ *
+ * @param protocol
+ *     The protocol that the claimed process must handle.
+ *
+ * @return
+ *     An idle process for the given protocol, or NULL if no such process is
+ *     currently available.
+ */
+guacd_proc* guacd_pool_claim(guacd_pool* pool, const char* protocol);
+
+/**
+ * Records the time taken for a new connection to be handed to a connection
+ * process that is ready to handle it, logging a summary of all startup
+ * latency recorded so far if sufficient time has elapsed since the last
+ * summary.
+ *
+ * @param pool
+ *     The pool tracking startup latency.
+ *
+ * @param pooled
+ *     Non-zero if the connection was handed to a process claimed from the
+ *     pool, zero if a new process had to be created.
+ *
+ * @param started
+ *     The time that the connection requested its protocol or connection ID.
+ */
+void guacd_pool_record_startup(guacd_pool* pool, int pooled,
+        guac_timestamp started);
+
+#endif
+
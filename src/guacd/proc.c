@@ -34,6 +34,7 @@
 #include <guacamole/user.h>
 
 #include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -104,6 +105,12 @@ static void* guacd_user_thread(void* data) {
         guacd_proc_stop(proc);
     }
 
+    /* Close the user's connection even if other processes still hold copies
+     * of its file descriptor (as is possible when that connection was handed
+     * directly to this process) */
+    guac_socket_flush(socket);
+    shutdown(params->fd, SHUT_RDWR);
+
     /* Clean up */
     guac_socket_free(socket);
     guac_user_free(user);
@@ -345,6 +352,18 @@ static void guacd_exec_proc(guacd_proc* proc, const char* protocol) {
             guacd_log_guac_error(GUAC_LOG_ERROR,
                     "Unable to load client plugin");
 
+        /* Inform parent that no users can be accepted */
+        char status = GUACD_PROC_FAILED;
+        send(proc->fd_socket, &status, sizeof(status), 0);
+
+        goto cleanup_client;
+    }
+
+    /* Inform parent that the first user can now be accepted */
+    char status = GUACD_PROC_READY;
+    if (send(proc->fd_socket, &status, sizeof(status), 0) < 0) {
+        guacd_log(GUAC_LOG_ERROR, "Cannot signal readiness of connection "
+                "process: %s", strerror(errno));
         goto cleanup_client;
     }
 
@@ -420,8 +439,9 @@ guacd_proc* guacd_create_proc(const char* protocol) {
 
     int sockets[2];
 
-    /* Open UNIX socket pair */
-    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sockets) < 0) {
+    /* Open UNIX socket pair (sequenced packets rather than datagrams, such
+     * that each end sees a hangup once the other end has closed) */
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets) < 0) {
         guacd_log(GUAC_LOG_ERROR, "Error opening socket pair: %s", strerror(errno));
         return NULL;
     }
@@ -486,6 +506,29 @@ guacd_proc* guacd_create_proc(const char* protocol) {
 
 }
 
+int guacd_proc_wait_ready(guacd_proc* proc, int timeout) {
+
+    struct pollfd fd_socket = {
+        .fd = proc->fd_socket,
+        .events = POLLIN
+    };
+
+    /* Wait for the process to report the status of its plugin */
+    int result = poll(&fd_socket, 1, timeout);
+    if (result <= 0) {
+        guacd_log(GUAC_LOG_ERROR, "Connection process did not start in a "
+                "timely manner.");
+        return 1;
+    }
+
+    char status;
+    if (recv(proc->fd_socket, &status, sizeof(status), 0) != sizeof(status))
+        return 1;
+
+    return status != GUACD_PROC_READY;
+
+}
+
 /**
  * Kill the provided child guacd process. This function must be called by the
  * parent process, and will block until all processes associated with the
@@ -536,3 +579,17 @@ void guacd_proc_stop(guacd_proc* proc) {
     close(proc->fd_socket);
 
 }
+
+void guacd_proc_free(guacd_proc* proc) {
+
+    /* Force process to stop and clean up */
+    guacd_proc_stop(proc);
+
+    /* Free skeleton client */
+    guac_client_free(proc->client);
+
+    /* Clean up */
+    close(proc->fd_socket);
+    guac_mem_free(proc);
+
+}
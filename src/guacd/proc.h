@@ -48,6 +48,20 @@
  */
 #define GUACD_CLIENT_FREE_TIMEOUT 5
 
+/**
+ * The status sent by a connection process along its fd_socket once the
+ * client plugin for its protocol has been loaded and the process is ready to
+ * receive its first user.
+ */
+#define GUACD_PROC_READY 'R'
+
+/**
+ * The status sent by a connection process along its fd_socket if the client
+ * plugin for its protocol could not be loaded. The process exits immediately
+ * after sending this status.
+ */
+#define GUACD_PROC_FAILED 'F'
+
 /**
  * Process information of the internal remote desktop client.
  */
@@ -96,6 +110,25 @@ typedef struct guacd_proc {
  */
 guacd_proc* guacd_create_proc(const char* protocol);
 
+/**
+ * Waits for the given process to finish loading the client plugin for its
+ * protocol, as signalled by the process through its fd_socket. This function
+ * must be called by the parent process, and must be called only once for
+ * each process.
+ *
+ * @param proc
+ *     The process to wait for.
+ *
+ * @param timeout
+ *     The maximum amount of time to wait, in milliseconds.
+ *
+ * @return
+ *     Zero if the process is ready to receive its first user, non-zero if the
+ *     process failed to load its plugin, terminated, or did not become ready
+ *     within the given timeout.
+ */
+int guacd_proc_wait_ready(guacd_proc* proc, int timeout);
+
 /**
  * Signals the given process to stop accepting new users and clean up. This
  * will eventually cause the child process to exit.
@@ -105,5 +138,15 @@ guacd_proc* guacd_create_proc(const char* protocol);
  */
 void guacd_proc_stop(guacd_proc* proc);
 
+/**
+ * Stops the given process, waiting for it to terminate, and frees the
+ * process structure along with its skeleton guac_client. This function must
+ * be called by the parent process.
+ *
+ * @param proc
+ *     The process to stop and free.
+ */
+void guacd_proc_free(guacd_proc* proc);
+
 #endif
 
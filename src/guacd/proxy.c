@@ -0,0 +1,776 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "connection.h"
+#include "log.h"
+#include "proxy.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+
+#include <guacamole/mem.h>
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
+
+#ifdef ENABLE_SSL
+#include <openssl/ssl.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Data which has been read from one side of a proxied connection but not yet
+ * written to the other.
+ */
+typedef struct guacd_proxy_buffer {
+
+    /**
+     * The data read, of which only the bytes between start and end have yet
+     * to be written.
+     */
+    char data[GUACD_PROXY_BUFFER_SIZE];
+
+    /**
+     * The offset of the first byte within data which has not yet been
+     * written.
+     */
+    int start;
+
+    /**
+     * The offset of the first byte after the data read. If equal to start,
+     * the buffer is empty.
+     */
+    int end;
+
+} guacd_proxy_buffer;
+
+/**
+ * A single proxy thread, along with the epoll instance monitoring the file
+ * descriptors of the connections assigned to that thread and the pipe along
+ * which new connections are sent to that thread as guacd_proxy_connection
+ * pointers. Only the owning thread ever modifies its epoll instance or touches
+ * a connection once handed off, so no further locking is required.
+ */
+typedef struct guacd_proxy_worker {
+
+    /**
+     * The epoll instance monitoring the pipe and the file descriptors of all
+     * connections assigned to this thread.
+     */
+    int epoll_fd;
+
+    /**
+     * Pipe along which new connections are sent to this thread.
+     */
+    int pipe[2];
+
+} guacd_proxy_worker;
+
+/**
+ * The state of a single user connection being serviced by the proxy.
+ */
+typedef struct guacd_proxy_connection {
+
+    /**
+     * The proxy thread which has been assigned this connection.
+     */
+    guacd_proxy_worker* worker;
+
+    /**
+     * The user's guac_socket, its underlying file descriptor and SSL session
+     * (if any), the file descriptor of the connection-specific process, and
+     * the guac_parser that may still contain data buffered during the
+     * handshake.
+     */
+    guacd_connection_io_thread_params* params;
+
+    /**
+     * Data read from the user that must be written to the process.
+     */
+    guacd_proxy_buffer to_proc;
+
+    /**
+     * Data read from the process that must be written to the user.
+     */
+    guacd_proxy_buffer to_user;
+
+    /**
+     * Whether no further data will be read from the user, either because the
+     * user closed their connection or because the process is no longer
+     * accepting data.
+     */
+    bool user_closed;
+
+    /**
+     * Whether the process has been informed that the user will send no
+     * further data, by shutting down the writing side of its file
+     * descriptor.
+     */
+    bool proc_shutdown;
+
+    /**
+     * Whether no further data will be read from the process.
+     */
+    bool proc_closed;
+
+    /**
+     * Whether the connection has been fully handled and is awaiting cleanup.
+     * Events which were already received for a finished connection are
+     * ignored.
+     */
+    bool finished;
+
+    /**
+     * The next connection within the list of finished connections awaiting
+     * cleanup, if any.
+     */
+    struct guacd_proxy_connection* next_finished;
+
+} guacd_proxy_connection;
+
+/**
+ * All proxy threads which were successfully started.
+ */
+static guacd_proxy_worker guacd_proxy_workers[GUACD_PROXY_THREADS];
+
+/**
+ * The number of entries within guacd_proxy_workers, or zero if the proxy
+ * could not be started.
+ */
+static int guacd_proxy_worker_count = 0;
+
+/**
+ * The index within guacd_proxy_workers of the proxy thread that should be
+ * assigned the next connection.
+ */
+static int guacd_proxy_next_worker = 0;
+
+/**
+ * Lock which guards access to guacd_proxy_next_worker.
+ */
+static pthread_mutex_t guacd_proxy_next_worker_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Guards the one-time startup of the proxy threads.
+ */
+static pthread_once_t guacd_proxy_init_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Reads as much data as is immediately available from the given user,
+ * returning any data buffered by the handshake parser before reading from
+ * the user's connection itself.
+ *
+ * @param connection
+ *     The connection of the user to read from.
+ *
+ * @param buffer
+ *     The buffer to read data into.
+ *
+ * @param length
+ *     The number of bytes available within the buffer.
+ *
+ * @return
+ *     The number of bytes read, zero if the user has closed their connection
+ *     or an error has occurred, or -1 if no data can be read without
+ *     blocking.
+ */
+static int guacd_proxy_read_user(guacd_proxy_connection* connection,
+        char* buffer, int length) {
+
+    guacd_connection_io_thread_params* params = connection->params;
+    int result;
+
+    /* Data already buffered by the parser must be transferred first */
+    if (params->parser != NULL) {
+
+        result = guac_parser_shift(params->parser, buffer, length);
+        if (result > 0)
+            return result;
+
+        /* Parser is no longer needed */
+        guac_parser_free(params->parser);
+        params->parser = NULL;
+
+    }
+
+#ifdef ENABLE_SSL
+    if (params->ssl != NULL) {
+
+        result = SSL_read(params->ssl, buffer, length);
+        if (result > 0)
+            return result;
+
+        int error = SSL_get_error(params->ssl, result);
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+            return -1;
+
+        return 0;
+
+    }
+#endif
+
+    do {
+        result = read(params->socket_fd, buffer, length);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? -1 : 0;
+
+    return result;
+
+}
+
+/**
+ * Writes as much of the given data to the given user as is possible without
+ * blocking.
+ *
+ * @param connection
+ *     The connection of the user to write to.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @return
+ *     The number of bytes written, zero if an error has occurred, or -1 if
+ *     no data can be written without blocking.
+ */
+static int guacd_proxy_write_user(guacd_proxy_connection* connection,
+        const char* buffer, int length) {
+
+    guacd_connection_io_thread_params* params = connection->params;
+    int result;
+
+#ifdef ENABLE_SSL
+    if (params->ssl != NULL) {
+
+        result = SSL_write(params->ssl, buffer, length);
+        if (result > 0)
+            return result;
+
+        int error = SSL_get_error(params->ssl, result);
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+            return -1;
+
+        return 0;
+
+    }
+#endif
+
+    do {
+        result = write(params->socket_fd, buffer, length);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? -1 : 0;
+
+    return result;
+
+}
+
+/**
+ * Reads as much data as is immediately available from the file descriptor of
+ * the connection-specific process.
+ *
+ * @param connection
+ *     The connection whose process should be read from.
+ *
+ * @param buffer
+ *     The buffer to read data into.
+ *
+ * @param length
+ *     The number of bytes available within the buffer.
+ *
+ * @return
+ *     The number of bytes read, zero if the process has closed its end of
+ *     the connection or an error has occurred, or -1 if no data can be read
+ *     without blocking.
+ */
+static int guacd_proxy_read_proc(guacd_proxy_connection* connection,
+        char* buffer, int length) {
+
+    int result;
+
+    do {
+        result = read(connection->params->fd, buffer, length);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? -1 : 0;
+
+    return result;
+
+}
+
+/**
+ * Writes as much of the given data to the file descriptor of the
+ * connection-specific process as is possible without blocking.
+ *
+ * @param connection
+ *     The connection whose process should be written to.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @return
+ *     The number of bytes written, zero if an error has occurred, or -1 if
+ *     no data can be written without blocking.
+ */
+static int guacd_proxy_write_proc(guacd_proxy_connection* connection,
+        const char* buffer, int length) {
+
+    int result;
+
+    do {
+        result = write(connection->params->fd, buffer, length);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? -1 : 0;
+
+    return result;
+
+}
+
+/**
+ * Transfers data in both directions between the given user and their
+ * connection-specific process until no further progress can be made without
+ * blocking. As all file descriptors are monitored in edge-triggered mode,
+ * each direction is pumped until it either blocks or is waiting on the other
+ * side, ensuring that a later event will resume the transfer.
+ *
+ * When the user closes their connection, all data already read from the user
+ * is delivered and the process is then informed via shutdown(), while data
+ * from the process continues to be delivered until the process closes its
+ * end.
+ *
+ * @param connection
+ *     The connection to transfer data for.
+ *
+ * @return
+ *     true if the connection has been fully handled and should be cleaned
+ *     up, false if further events are expected.
+ */
+static bool guacd_proxy_pump(guacd_proxy_connection* connection) {
+
+    guacd_proxy_buffer* to_proc = &connection->to_proc;
+    guacd_proxy_buffer* to_user = &connection->to_user;
+
+    bool progress;
+    int length;
+
+    do {
+
+        progress = false;
+
+        /* Read more from the user only after the process has everything
+         * read previously */
+        if (!connection->user_closed && to_proc->start == to_proc->end) {
+
+            length = guacd_proxy_read_user(connection, to_proc->data,
+                    sizeof(to_proc->data));
+
+            if (length > 0) {
+                to_proc->start = 0;
+                to_proc->end = length;
+                progress = true;
+            }
+            else if (length == 0)
+                connection->user_closed = true;
+
+        }
+
+        /* Pass pending user data along to the process */
+        if (to_proc->start < to_proc->end) {
+
+            length = guacd_proxy_write_proc(connection,
+                    to_proc->data + to_proc->start,
+                    to_proc->end - to_proc->start);
+
+            if (length > 0) {
+                to_proc->start += length;
+                progress = true;
+            }
+
+            /* Nothing further from the user can be delivered if the process
+             * stops accepting data */
+            else if (length == 0) {
+                to_proc->start = to_proc->end;
+                connection->user_closed = true;
+            }
+
+        }
+
+        /* Inform the process once the user has disconnected and all of that
+         * user's data has been delivered */
+        if (connection->user_closed && !connection->proc_shutdown
+                && to_proc->start == to_proc->end) {
+            shutdown(connection->params->fd, SHUT_WR);
+            connection->proc_shutdown = true;
+        }
+
+        /* Read more from the process only after the user has everything
+         * read previously */
+        if (!connection->proc_closed && to_user->start == to_user->end) {
+
+            length = guacd_proxy_read_proc(connection, to_user->data,
+                    sizeof(to_user->data));
+
+            if (length > 0) {
+                to_user->start = 0;
+                to_user->end = length;
+                progress = true;
+            }
+            else if (length == 0)
+                connection->proc_closed = true;
+
+        }
+
+        /* Pass pending process data along to the user */
+        if (to_user->start < to_user->end) {
+
+            length = guacd_proxy_write_user(connection,
+                    to_user->data + to_user->start,
+                    to_user->end - to_user->start);
+
+            if (length > 0) {
+                to_user->start += length;
+                progress = true;
+            }
+
+            /* There is nothing left to do if the user can no longer be
+             * written to */
+            else if (length == 0)
+                return true;
+
+        }
+
+    } while (progress);
+
+    /* The connection is complete once the process has closed its end and
+     * everything it sent has been delivered */
+    return connection->proc_closed && to_user->start == to_user->end;
+
+}
+
+/**
+ * Marks the given connection as finished, adding it to the given list of
+ * connections awaiting cleanup. The connection is not freed immediately, as
+ * events for that connection may remain within the current batch of events
+ * being handled.
+ *
+ * @param connection
+ *     The connection to mark as finished.
+ *
+ * @param finished
+ *     The head of the list of connections awaiting cleanup.
+ */
+static void guacd_proxy_finish(guacd_proxy_connection* connection,
+        guacd_proxy_connection** finished) {
+
+    connection->finished = true;
+    connection->next_finished = *finished;
+    *finished = connection;
+
+}
+
+/**
+ * Frees the given connection, closing both the user's connection and the
+ * file descriptor of the connection-specific process.
+ *
+ * @param connection
+ *     The connection to free.
+ */
+static void guacd_proxy_free(guacd_proxy_connection* connection) {
+
+    guacd_connection_io_thread_params* params = connection->params;
+    int epoll_fd = connection->worker->epoll_fd;
+
+    /* Copies of these file descriptors may remain open within other
+     * processes, so they must be explicitly removed from the epoll instance
+     * rather than relying on close() to do so */
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, params->socket_fd, NULL);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, params->fd, NULL);
+
+    if (params->parser != NULL)
+        guac_parser_free(params->parser);
+
+    guac_socket_free(params->socket);
+    close(params->fd);
+
+    guac_mem_free(params);
+    guac_mem_free(connection);
+
+}
+
+/**
+ * Sets the O_NONBLOCK flag on the given file descriptor.
+ *
+ * @param fd
+ *     The file descriptor to modify.
+ *
+ * @return
+ *     Zero on success, non-zero if the flag could not be set.
+ */
+static int guacd_proxy_set_nonblocking(int fd) {
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0)
+        return 1;
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0;
+
+}
+
+/**
+ * Begins monitoring all connections which have been sent to the given proxy
+ * thread by guacd_proxy_add() since this function was last invoked,
+ * transferring any data which is already available. This function may only be
+ * invoked by that proxy thread.
+ *
+ * @param worker
+ *     The proxy thread invoking this function.
+ *
+ * @param finished
+ *     The head of the list of connections awaiting cleanup.
+ */
+static void guacd_proxy_accept(guacd_proxy_worker* worker,
+        guacd_proxy_connection** finished) {
+
+    guacd_proxy_connection* connection;
+    while (read(worker->pipe[0], &connection, sizeof(connection))
+            == sizeof(connection)) {
+
+        guacd_connection_io_thread_params* params = connection->params;
+
+        struct epoll_event event = {
+            .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            .data.ptr = connection
+        };
+
+        /* Monitor both the user and the process for all future changes in
+         * readiness */
+        if (guacd_proxy_set_nonblocking(params->socket_fd)
+                || guacd_proxy_set_nonblocking(params->fd)
+                || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, params->socket_fd, &event)
+                || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, params->fd, &event)) {
+            guacd_log(GUAC_LOG_ERROR, "Unable to monitor user connection "
+                    "for I/O transfer: %s", strerror(errno));
+            guacd_proxy_finish(connection, finished);
+            continue;
+        }
+
+        /* Transfer any data already buffered by the handshake */
+        if (guacd_proxy_pump(connection))
+            guacd_proxy_finish(connection, finished);
+
+    }
+
+}
+
+/**
+ * Transfers data for all connections assigned to a proxy thread as their file
+ * descriptors become ready, freeing each connection once it has been fully
+ * handled.
+ *
+ * @param data
+ *     The guacd_proxy_worker representing the proxy thread.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacd_proxy_thread(void* data) {
+
+    guacd_proxy_worker* worker = (guacd_proxy_worker*) data;
+    struct epoll_event events[GUACD_PROXY_MAX_EVENTS];
+
+    for (;;) {
+
+        int count = epoll_wait(worker->epoll_fd, events,
+                GUACD_PROXY_MAX_EVENTS, -1);
+
+        if (count < 0) {
+
+            if (errno == EINTR)
+                continue;
+
+            guacd_log(GUAC_LOG_ERROR, "Unable to wait for user I/O: %s",
+                    strerror(errno));
+            break;
+
+        }
+
+        guacd_proxy_connection* finished = NULL;
+
+        for (int i = 0; i < count; i++) {
+
+            guacd_proxy_connection* connection = events[i].data.ptr;
+
+            /* Events for the pipe signal new connections */
+            if (connection == NULL)
+                guacd_proxy_accept(worker, &finished);
+
+            else if (!connection->finished && guacd_proxy_pump(connection))
+                guacd_proxy_finish(connection, &finished);
+
+        }
+
+        /* Clean up only once no events within the batch can refer to the
+         * finished connections */
+        while (finished != NULL) {
+            guacd_proxy_connection* next = finished->next_finished;
+            guacd_proxy_free(finished);
+            finished = next;
+        }
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Creates the epoll instance and pipe of the given proxy thread and starts
+ * that thread.
+ *
+ * @param worker
+ *     The proxy thread to start.
+ *
+ * @return
+ *     Zero if the proxy thread was started successfully, non-zero otherwise.
+ */
+static int guacd_proxy_worker_start(guacd_proxy_worker* worker) {
+
+    worker->epoll_fd = epoll_create1(0);
+    if (worker->epoll_fd < 0) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to create epoll instance for user "
+                "I/O: %s", strerror(errno));
+        return 1;
+    }
+
+    if (pipe(worker->pipe)) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to create pipe for user I/O: %s",
+                strerror(errno));
+        close(worker->epoll_fd);
+        return 1;
+    }
+
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.ptr = NULL
+    };
+
+    if (guacd_proxy_set_nonblocking(worker->pipe[0])
+            || epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->pipe[0], &event)) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to monitor pipe for user I/O: %s",
+                strerror(errno));
+        close(worker->pipe[0]);
+        close(worker->pipe[1]);
+        close(worker->epoll_fd);
+        return 1;
+    }
+
+    pthread_t proxy_thread;
+    if (pthread_create(&proxy_thread, NULL, guacd_proxy_thread, worker)) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to start user I/O thread.");
+        close(worker->pipe[0]);
+        close(worker->pipe[1]);
+        close(worker->epoll_fd);
+        return 1;
+    }
+
+    pthread_detach(proxy_thread);
+    return 0;
+
+}
+
+/**
+ * Starts the pool of proxy threads. Connections are assigned only to the
+ * threads that start successfully. If no thread can be started,
+ * guacd_proxy_worker_count is left as zero.
+ */
+static void guacd_proxy_init() {
+
+    for (int i = 0; i < GUACD_PROXY_THREADS; i++) {
+        if (!guacd_proxy_worker_start(&guacd_proxy_workers[guacd_proxy_worker_count]))
+            guacd_proxy_worker_count++;
+    }
+
+    if (guacd_proxy_worker_count > 0)
+        guacd_log(GUAC_LOG_DEBUG, "Proxying user I/O using %i threads.",
+                guacd_proxy_worker_count);
+
+}
+
+int guacd_proxy_add(guacd_connection_io_thread_params* params) {
+
+    pthread_once(&guacd_proxy_init_once, guacd_proxy_init);
+
+    /* Fail if the proxy could not be started */
+    if (guacd_proxy_worker_count == 0)
+        return 1;
+
+    /* Spread connections evenly across all proxy threads */
+    pthread_mutex_lock(&guacd_proxy_next_worker_lock);
+    guacd_proxy_worker* worker = &guacd_proxy_workers[guacd_proxy_next_worker];
+    guacd_proxy_next_worker = (guacd_proxy_next_worker + 1) % guacd_proxy_worker_count;
+    pthread_mutex_unlock(&guacd_proxy_next_worker_lock);
+
+    guacd_proxy_connection* connection = guac_mem_zalloc(sizeof(guacd_proxy_connection));
+    connection->worker = worker;
+    connection->params = params;
+
+    /* Hand connection to the proxy thread (writes of a single pointer to a
+     * pipe are atomic) */
+    if (write(worker->pipe[1], &connection, sizeof(connection))
+            != sizeof(connection)) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to hand user to I/O thread: %s",
+                strerror(errno));
+        guac_mem_free(connection);
+        return 1;
+    }
+
+    return 0;
+
+}
+
+#else
+
+int guacd_proxy_add(guacd_connection_io_thread_params* params) {
+
+    /* The event-driven proxy is implemented only using epoll */
+    return 1;
+
+}
+
+#endif
+
@@ -0,0 +1,74 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACD_PROXY_H
+#define GUACD_PROXY_H
+
+#include "config.h"
+
+#include "connection.h"
+
+/**
+ * The size of each of the two buffers maintained for every proxied user, one
+ * for data bound for the connection process and one for data bound for the
+ * user, in bytes.
+ */
+#define GUACD_PROXY_BUFFER_SIZE 8192
+
+/**
+ * The number of threads servicing proxied users. Each user is assigned to one
+ * of these threads, which performs all I/O (including any TLS encryption and
+ * decryption) for that user.
+ */
+#define GUACD_PROXY_THREADS 4
+
+/**
+ * The maximum number of events handled by each pass of the proxy event loop.
+ */
+#define GUACD_PROXY_MAX_EVENTS 64
+
+/**
+ * Hands the given user connection to the shared, event-driven proxy of the
+ * main guacd process, which transfers data bidirectionally between the
+ * guac_socket of the user and the file descriptor of the connection-specific
+ * process from one of a small pool of threads. Any data already buffered by
+ * the provided guac_parser is transferred first. The proxy threads are started
+ * automatically upon first use.
+ *
+ * If the user is handed off successfully, ownership of the provided
+ * parameters (including the guac_parser, the guac_socket and the file
+ * descriptor) passes to the proxy, which will free them once either side of
+ * the connection is closed. If the handoff fails, including when the proxy is
+ * not supported on the current platform, nothing is freed and the caller
+ * must transfer the data by other means, such as
+ * guacd_connection_io_thread().
+ *
+ * @param params
+ *     The guacd_connection_io_thread_params structure describing the user's
+ *     connection and the connection-specific process file descriptor. This
+ *     structure must have been allocated with guac_mem_alloc().
+ *
+ * @return
+ *     Zero if the user was handed to the proxy successfully, non-zero
+ *     otherwise.
+ */
+int guacd_proxy_add(guacd_connection_io_thread_params* params);
+
+#endif
+
@@ -0,0 +1,662 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Client simulator for load-testing the guacd listener. Many connections are
+ * opened at once, optionally completing an SSL/TLS handshake on each
+ * concurrently, and each connection sends only part of its "select"
+ * instruction, pauses, and then sends the rest. If given the PID of guacd,
+ * the number of threads within guacd is sampled throughout, such that it can
+ * be verified that no connection thread is started until a connection has
+ * sent a complete "select" instruction.
+ *
+ * This program is not built by default. Build it explicitly with
+ * "make guacd-load".
+ */
+
+#include "config.h"
+
+#ifdef ENABLE_SSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The default number of connections opened by the simulator.
+ */
+#define GUACD_LOAD_DEFAULT_CONNECTIONS 1000
+
+/**
+ * The default number of milliseconds that each connection waits after
+ * sending the first part of its "select" instruction.
+ */
+#define GUACD_LOAD_DEFAULT_PAUSE 2000
+
+/**
+ * The number of milliseconds to wait for all handshakes to complete and for
+ * all responses to be received before giving up.
+ */
+#define GUACD_LOAD_TIMEOUT 30000
+
+/**
+ * The number of milliseconds between each sample of the number of threads
+ * within guacd.
+ */
+#define GUACD_LOAD_SAMPLE_INTERVAL 10
+
+/**
+ * The number of bytes of the "select" instruction sent before pausing.
+ */
+#define GUACD_LOAD_FIRST_PART 5
+
+/**
+ * The maximum length of the "select" instruction sent by each connection,
+ * in bytes.
+ */
+#define GUACD_LOAD_INSTRUCTION_LENGTH 256
+
+/**
+ * The maximum number of bytes of each response that are retained, which is
+ * enough to determine the opcode of the first instruction received.
+ */
+#define GUACD_LOAD_RESPONSE_LENGTH 32
+
+/**
+ * The state of a single simulated client connection.
+ */
+typedef struct guacd_load_connection {
+
+    /**
+     * The file descriptor of the connection, or -1 if the connection has
+     * failed or has been closed.
+     */
+    int fd;
+
+#ifdef ENABLE_SSL
+    /**
+     * The SSL/TLS state of the connection, or NULL if SSL/TLS is not in use.
+     */
+    SSL* ssl;
+#endif
+
+    /**
+     * Whether the SSL/TLS handshake has completed, or true if SSL/TLS is not
+     * in use.
+     */
+    bool handshake_complete;
+
+    /**
+     * The beginning of the response received thus far.
+     */
+    char response[GUACD_LOAD_RESPONSE_LENGTH];
+
+    /**
+     * The number of bytes stored within the response buffer.
+     */
+    int response_length;
+
+    /**
+     * Whether a complete instruction has been received in response to the
+     * "select" instruction.
+     */
+    bool response_complete;
+
+} guacd_load_connection;
+
+/**
+ * The PID of the guacd process whose threads should be counted, or zero if
+ * threads should not be counted.
+ */
+static pid_t guacd_load_pid = 0;
+
+/**
+ * The largest number of threads observed within guacd.
+ */
+static int guacd_load_max_threads = 0;
+
+/**
+ * Returns the current value of CLOCK_MONOTONIC, in milliseconds.
+ *
+ * @return
+ *     The current value of CLOCK_MONOTONIC, in milliseconds.
+ */
+static long guacd_load_now() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+
+}
+
+/**
+ * Samples the number of threads currently within guacd, updating
+ * guacd_load_max_threads. If no guacd PID was given, this function has no
+ * effect.
+ */
+static void guacd_load_sample_threads() {
+
+    if (guacd_load_pid == 0)
+        return;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%i/status", (int) guacd_load_pid);
+
+    FILE* status = fopen(path, "r");
+    if (status == NULL)
+        return;
+
+    char line[256];
+    int threads;
+    while (fgets(line, sizeof(line), status) != NULL) {
+        if (sscanf(line, "Threads: %i", &threads) == 1
+                && threads > guacd_load_max_threads)
+            guacd_load_max_threads = threads;
+    }
+
+    fclose(status);
+
+}
+
+/**
+ * Waits for the given number of milliseconds, sampling the number of threads
+ * within guacd throughout.
+ *
+ * @param millis
+ *     The number of milliseconds to wait.
+ */
+static void guacd_load_pause(int millis) {
+
+    long end = guacd_load_now() + millis;
+
+    do {
+        guacd_load_sample_threads();
+        poll(NULL, 0, GUACD_LOAD_SAMPLE_INTERVAL);
+    } while (guacd_load_now() < end);
+
+}
+
+/**
+ * Closes the given connection, marking it as failed.
+ *
+ * @param conn
+ *     The connection to close.
+ */
+static void guacd_load_close(guacd_load_connection* conn) {
+
+#ifdef ENABLE_SSL
+    if (conn->ssl != NULL) {
+        SSL_free(conn->ssl);
+        conn->ssl = NULL;
+    }
+#endif
+
+    if (conn->fd != -1) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+
+}
+
+/**
+ * Opens a new TCP connection to the given address, switching the connection
+ * to non-blocking mode once connected.
+ *
+ * @param address
+ *     The address to connect to.
+ *
+ * @return
+ *     The file descriptor of the new connection, or -1 if the connection
+ *     could not be opened.
+ */
+static int guacd_load_connect(const struct addrinfo* address) {
+
+    int fd = socket(address->ai_family, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    if (connect(fd, address->ai_addr, address->ai_addrlen)) {
+        close(fd);
+        return -1;
+    }
+
+    const int SO_TRUE = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+            (const void*) &SO_TRUE, sizeof(SO_TRUE));
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+
+}
+
+/**
+ * Writes all of the given data to the given connection, waiting for the
+ * connection to become writable as necessary. If the data cannot be
+ * written, the connection is closed.
+ *
+ * @param conn
+ *     The connection to write to.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ */
+static void guacd_load_write(guacd_load_connection* conn, const char* data,
+        int length) {
+
+    while (length > 0 && conn->fd != -1) {
+
+        int written;
+
+#ifdef ENABLE_SSL
+        if (conn->ssl != NULL) {
+            written = SSL_write(conn->ssl, data, length);
+            if (written <= 0) {
+                int error = SSL_get_error(conn->ssl, written);
+                if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE)
+                    guacd_load_close(conn);
+                written = 0;
+            }
+        }
+        else
+#endif
+        {
+            written = write(conn->fd, data, length);
+            if (written < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    guacd_load_close(conn);
+                written = 0;
+            }
+        }
+
+        data += written;
+        length -= written;
+
+        /* Wait for room if nothing could be written */
+        if (written == 0 && conn->fd != -1) {
+            struct pollfd pfd = { .fd = conn->fd, .events = POLLIN | POLLOUT };
+            poll(&pfd, 1, GUACD_LOAD_SAMPLE_INTERVAL);
+        }
+
+    }
+
+}
+
+/**
+ * Reads any available data from the given connection, marking the response
+ * as complete once the first instruction has been fully received. If the
+ * connection fails or is closed before a complete instruction is received,
+ * the connection is closed.
+ *
+ * @param conn
+ *     The connection to read from.
+ */
+static void guacd_load_read(guacd_load_connection* conn) {
+
+    char buffer[4096];
+    int length;
+
+#ifdef ENABLE_SSL
+    if (conn->ssl != NULL) {
+        length = SSL_read(conn->ssl, buffer, sizeof(buffer));
+        if (length <= 0) {
+            int error = SSL_get_error(conn->ssl, length);
+            if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE)
+                guacd_load_close(conn);
+            return;
+        }
+    }
+    else
+#endif
+    {
+        length = read(conn->fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            if (length == 0 || (errno != EAGAIN && errno != EWOULDBLOCK
+                        && errno != EINTR))
+                guacd_load_close(conn);
+            return;
+        }
+    }
+
+    /* Retain only the beginning of the response */
+    int retained = sizeof(conn->response) - 1 - conn->response_length;
+    if (retained > length)
+        retained = length;
+
+    memcpy(conn->response + conn->response_length, buffer, retained);
+    conn->response_length += retained;
+    conn->response[conn->response_length] = '\0';
+
+    if (memchr(buffer, ';', length) != NULL)
+        conn->response_complete = true;
+
+}
+
+#ifdef ENABLE_SSL
+/**
+ * Advances the SSL/TLS handshake of the given connection as far as possible
+ * without blocking, closing the connection if the handshake fails.
+ *
+ * @param conn
+ *     The connection whose handshake should be advanced.
+ *
+ * @return
+ *     The poll() events that must be awaited before the handshake can
+ *     continue, or zero if the handshake has completed or failed.
+ */
+static short guacd_load_handshake(guacd_load_connection* conn) {
+
+    int result = SSL_connect(conn->ssl);
+    if (result == 1) {
+        conn->handshake_complete = true;
+        return 0;
+    }
+
+    int error = SSL_get_error(conn->ssl, result);
+    if (error == SSL_ERROR_WANT_READ)
+        return POLLIN;
+    if (error == SSL_ERROR_WANT_WRITE)
+        return POLLOUT;
+
+    guacd_load_close(conn);
+    return 0;
+
+}
+#endif
+
+/**
+ * Polls all connections for which the given function would make progress,
+ * invoking that function for each connection that is ready, until every
+ * connection has either finished or failed, or until GUACD_LOAD_TIMEOUT
+ * milliseconds have elapsed.
+ *
+ * @param conns
+ *     The connections to poll.
+ *
+ * @param count
+ *     The number of connections.
+ *
+ * @param handshake
+ *     True if SSL/TLS handshakes should be advanced, false if responses
+ *     should be read.
+ */
+static void guacd_load_poll_all(guacd_load_connection* conns, int count,
+        bool handshake) {
+
+    struct pollfd* pfds = calloc(count, sizeof(struct pollfd));
+    int* indices = calloc(count, sizeof(int));
+    long end = guacd_load_now() + GUACD_LOAD_TIMEOUT;
+
+    while (guacd_load_now() < end) {
+
+        int pending = 0;
+        for (int i = 0; i < count; i++) {
+
+            guacd_load_connection* conn = &conns[i];
+            if (conn->fd == -1)
+                continue;
+
+            short events = POLLIN;
+            if (handshake) {
+                if (conn->handshake_complete)
+                    continue;
+#ifdef ENABLE_SSL
+                events = guacd_load_handshake(conn);
+#endif
+                if (events == 0)
+                    continue;
+            }
+            else if (conn->response_complete)
+                continue;
+
+            pfds[pending] = (struct pollfd) { .fd = conn->fd, .events = events };
+            indices[pending] = i;
+            pending++;
+
+        }
+
+        /* Stop once nothing remains to be done */
+        if (pending == 0)
+            break;
+
+        guacd_load_sample_threads();
+        if (poll(pfds, pending, GUACD_LOAD_SAMPLE_INTERVAL) <= 0)
+            continue;
+
+        /* Read from any connections with available data (handshakes are
+         * advanced during the next pass) */
+        if (!handshake) {
+            for (int i = 0; i < pending; i++) {
+                if (pfds[i].revents)
+                    guacd_load_read(&conns[indices[i]]);
+            }
+        }
+
+    }
+
+    free(pfds);
+    free(indices);
+
+}
+
+/**
+ * Prints usage information for this program.
+ *
+ * @param name
+ *     The name that this program was invoked with.
+ */
+static void guacd_load_usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-h HOST] [-p PORT] [-n CONNECTIONS] "
+            "[-d PAUSE_MS] [-P PROTOCOL] [-t GUACD_PID] [-s]\n", name);
+}
+
+int main(int argc, char** argv) {
+
+    const char* host = "localhost";
+    const char* port = "4822";
+    const char* protocol = "ssh";
+    int count = GUACD_LOAD_DEFAULT_CONNECTIONS;
+    int pause = GUACD_LOAD_DEFAULT_PAUSE;
+    bool secure = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:n:d:P:t:s")) != -1) {
+        switch (opt) {
+            case 'h': host = optarg; break;
+            case 'p': port = optarg; break;
+            case 'n': count = atoi(optarg); break;
+            case 'd': pause = atoi(optarg); break;
+            case 'P': protocol = optarg; break;
+            case 't': guacd_load_pid = atoi(optarg); break;
+            case 's': secure = true; break;
+            default:
+                guacd_load_usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (count <= 0 || pause < 0) {
+        guacd_load_usage(argv[0]);
+        return 1;
+    }
+
+#ifndef ENABLE_SSL
+    if (secure) {
+        fprintf(stderr, "SSL/TLS support was not enabled at build time.\n");
+        return 1;
+    }
+#endif
+
+    /* Failed connections must not terminate the simulator */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Allow a file descriptor for every connection */
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0
+            && limit.rlim_cur < (rlim_t) count + 64) {
+        limit.rlim_cur = (rlim_t) count + 64;
+        if (limit.rlim_cur > limit.rlim_max)
+            limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM
+    };
+
+    struct addrinfo* address;
+    if (getaddrinfo(host, port, &hints, &address)) {
+        fprintf(stderr, "Unable to resolve \"%s\".\n", host);
+        return 1;
+    }
+
+#ifdef ENABLE_SSL
+    SSL_CTX* context = NULL;
+    if (secure) {
+        context = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_verify(context, SSL_VERIFY_NONE, NULL);
+    }
+#endif
+
+    /* Build "select" instruction */
+    char instruction[GUACD_LOAD_INSTRUCTION_LENGTH];
+    int instruction_length = snprintf(instruction, sizeof(instruction),
+            "6.select,%i.%s;", (int) strlen(protocol), protocol);
+    if (instruction_length >= (int) sizeof(instruction)
+            || instruction_length <= GUACD_LOAD_FIRST_PART) {
+        fprintf(stderr, "Protocol name is too long.\n");
+        return 1;
+    }
+
+    guacd_load_connection* conns = calloc(count, sizeof(guacd_load_connection));
+    guacd_load_sample_threads();
+    int initial_threads = guacd_load_max_threads;
+
+    /* Open all connections */
+    long start = guacd_load_now();
+    int connected = 0;
+    for (int i = 0; i < count; i++) {
+
+        guacd_load_connection* conn = &conns[i];
+        conn->fd = guacd_load_connect(address);
+        conn->handshake_complete = !secure;
+
+        if (conn->fd == -1)
+            continue;
+
+#ifdef ENABLE_SSL
+        if (secure) {
+            conn->ssl = SSL_new(context);
+            SSL_set_fd(conn->ssl, conn->fd);
+        }
+#endif
+
+        connected++;
+
+    }
+
+    freeaddrinfo(address);
+    printf("Connected:            %i of %i in %li ms\n", connected, count,
+            guacd_load_now() - start);
+
+    /* Perform all SSL/TLS handshakes concurrently */
+    if (secure) {
+
+        start = guacd_load_now();
+        guacd_load_poll_all(conns, count, true);
+
+        int handshakes = 0;
+        for (int i = 0; i < count; i++) {
+            if (conns[i].fd != -1 && conns[i].handshake_complete)
+                handshakes++;
+        }
+
+        printf("Handshakes completed: %i of %i in %li ms\n", handshakes,
+                count, guacd_load_now() - start);
+
+    }
+
+    /* Send only the first part of each "select" instruction */
+    for (int i = 0; i < count; i++)
+        guacd_load_write(&conns[i], instruction, GUACD_LOAD_FIRST_PART);
+
+    /* No connection thread should be started while every "select"
+     * instruction remains incomplete */
+    guacd_load_pause(pause);
+    if (guacd_load_pid != 0)
+        printf("Threads (incomplete): %i max, %i before connecting\n",
+                guacd_load_max_threads, initial_threads);
+
+    /* Send the remainder of each "select" instruction */
+    start = guacd_load_now();
+    for (int i = 0; i < count; i++)
+        guacd_load_write(&conns[i], instruction + GUACD_LOAD_FIRST_PART,
+                instruction_length - GUACD_LOAD_FIRST_PART);
+
+    /* Wait for guacd to respond to every connection */
+    guacd_load_max_threads = 0;
+    guacd_load_poll_all(conns, count, false);
+
+    int args = 0;
+    int responses = 0;
+    for (int i = 0; i < count; i++) {
+        if (conns[i].response_complete) {
+            responses++;
+            if (strncmp(conns[i].response, "4.args,", 7) == 0)
+                args++;
+        }
+        guacd_load_close(&conns[i]);
+    }
+
+    printf("Responses:            %i of %i (%i \"args\") in %li ms\n",
+            responses, count, args, guacd_load_now() - start);
+    if (guacd_load_pid != 0)
+        printf("Threads (complete):   %i max\n", guacd_load_max_threads);
+
+#ifdef ENABLE_SSL
+    if (context != NULL)
+        SSL_CTX_free(context);
+#endif
+
+    free(conns);
+    return responses == count ? 0 : 1;
+
+}
+
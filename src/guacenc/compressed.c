@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "compressed.h"
+#include "log.h"
+
+#include <guacamole/error.h>
+#include <guacamole/mem.h>
+#include <guacamole/recording.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+#include <sys/types.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * Socket read handler which reads and decompresses data from the compressed
+ * recording associated with the given socket.
+ *
+ * @param socket
+ *     The guac_socket being read from.
+ *
+ * @param buf
+ *     The buffer to read decompressed data into.
+ *
+ * @param count
+ *     The maximum number of bytes to read.
+ *
+ * @return
+ *     The number of bytes read, zero if the end of the recording has been
+ *     reached, or -1 if an error occurs.
+ */
+static ssize_t guacenc_compressed_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    gzFile file = (gzFile) socket->data;
+
+    int length = gzread(file, buf, count);
+    if (length < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error reading compressed recording";
+        return -1;
+    }
+
+    return length;
+
+}
+
+/**
+ * Socket free handler which closes the compressed recording associated with
+ * the given socket.
+ *
+ * @param socket
+ *     The guac_socket being freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guacenc_compressed_free_handler(guac_socket* socket) {
+    gzclose((gzFile) socket->data);
+    return 0;
+}
+
+guac_socket* guacenc_compressed_open(int fd) {
+
+    /* The file descriptor is owned by the socket even if the socket cannot
+     * be created */
+    gzFile file = gzdopen(fd, "rb");
+    if (file == NULL) {
+        close(fd);
+        guac_error = GUAC_STATUS_NO_MEMORY;
+        guac_error_message = "Compressed recording could not be opened";
+        return NULL;
+    }
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = file;
+    socket->read_handler = guacenc_compressed_read_handler;
+    socket->free_handler = guacenc_compressed_free_handler;
+
+    return socket;
+
+}
+
+int guacenc_compressed_seek(const char* path, int fd, int skip,
+        guac_timestamp* start) {
+
+    char index_path[4096];
+    int length = snprintf(index_path, sizeof(index_path), "%s%s",
+            path, GUAC_RECORDING_INDEX_SUFFIX);
+    if (length >= sizeof(index_path))
+        return 1;
+
+    FILE* index = fopen(index_path, "r");
+    if (index == NULL) {
+        guacenc_log(GUAC_LOG_WARNING, "%s: %s", index_path, strerror(errno));
+        return 1;
+    }
+
+    int64_t timestamp;
+    uint64_t offset;
+    char type;
+
+    int found = 0;
+    int64_t first_timestamp = 0;
+    uint64_t keyframe_offset = 0;
+
+    /* Find the last keyframe at or before the requested time */
+    while (fscanf(index, "%" SCNd64 " %" SCNu64 " %c",
+                &timestamp, &offset, &type) == 3) {
+
+        if (!found) {
+            first_timestamp = timestamp;
+            found = 1;
+        }
+
+        if (timestamp > first_timestamp + skip)
+            break;
+
+        if (type == GUAC_RECORDING_INDEX_KEYFRAME)
+            keyframe_offset = offset;
+
+    }
+
+    fclose(index);
+
+    if (!found) {
+        guacenc_log(GUAC_LOG_WARNING, "%s: Index is empty.", index_path);
+        return 1;
+    }
+
+    if (lseek(fd, keyframe_offset, SEEK_SET) == -1) {
+        guacenc_log(GUAC_LOG_WARNING, "%s: %s", path, strerror(errno));
+        return 1;
+    }
+
+    guacenc_log(GUAC_LOG_DEBUG, "%s: Starting from keyframe at offset "
+            "%" PRIu64 ".", path, keyframe_offset);
+
+    *start = first_timestamp;
+    return 0;
+
+}
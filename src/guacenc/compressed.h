@@ -0,0 +1,72 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACENC_COMPRESSED_H
+#define GUACENC_COMPRESSED_H
+
+#include "config.h"
+
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+/**
+ * Creates a new guac_socket which reads and decompresses the compressed
+ * recording within the given file, beginning at the current offset of that
+ * file. The recording may consist of any number of concatenated gzip members.
+ * The file descriptor is closed when the returned socket is freed, or
+ * immediately if the socket cannot be created.
+ *
+ * @param fd
+ *     The file descriptor of the compressed recording.
+ *
+ * @return
+ *     A newly-allocated guac_socket which reads the decompressed contents of
+ *     the given file, or NULL if the file cannot be read.
+ */
+guac_socket* guacenc_compressed_open(int fd);
+
+/**
+ * Seeks the given compressed recording to the most recent keyframe preceding
+ * the given point in time, using the index written alongside that recording.
+ *
+ * @param path
+ *     The path to the compressed recording. The index of the recording is
+ *     read from this path with GUAC_RECORDING_INDEX_SUFFIX appended.
+ *
+ * @param fd
+ *     The file descriptor of the compressed recording.
+ *
+ * @param skip
+ *     The number of milliseconds from the beginning of the recording that
+ *     playback should begin at.
+ *
+ * @param start
+ *     Pointer to a guac_timestamp which receives the timestamp at which the
+ *     recording began.
+ *
+ * @return
+ *     Zero if the recording was seeked successfully, non-zero if the index
+ *     cannot be read or the recording cannot be seeked, in which case the
+ *     recording must be read from the beginning.
+ */
+int guacenc_compressed_seek(const char* path, int fd, int skip,
+        guac_timestamp* start);
+
+#endif
+
@@ -40,6 +40,22 @@ int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp) {
     /* Update timestamp of display */
     display->last_sync = timestamp;
 
+    if (display->recording_start == 0)
+        display->recording_start = timestamp;
+
+    /* End the video at the requested point in the recording, such that the
+     * video can be joined with a video beginning at that same point */
+    if (display->end > 0
+            && timestamp >= display->recording_start + display->end) {
+        display->ended = true;
+        return guacenc_video_finish_timeline(display->output, timestamp);
+    }
+
+    /* Update display state without encoding any frames until the requested
+     * point in the recording has been reached */
+    if (timestamp < display->recording_start + display->skip)
+        return 0;
+
     /* Flatten display to default layer */
     if (guacenc_display_flatten(display))
         return 1;
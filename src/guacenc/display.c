@@ -25,6 +25,7 @@
 #include <cairo/cairo.h>
 #include <guacamole/mem.h>
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 cairo_operator_t guacenc_display_cairo_operator(guac_composite_mode mask) {
@@ -85,10 +86,11 @@ cairo_operator_t guacenc_display_cairo_operator(guac_composite_mode mask) {
 }
 
 guacenc_display* guacenc_display_alloc(const char* path, const char* codec,
-        int width, int height, int bitrate) {
+        int width, int height, int bitrate, bool pipelined) {
 
     /* Prepare video encoding */
-    guacenc_video* video = guacenc_video_alloc(path, codec, width, height, bitrate);
+    guacenc_video* video = guacenc_video_alloc(path, codec, width, height,
+            bitrate, pipelined);
     if (video == NULL)
         return NULL;
 
@@ -31,6 +31,8 @@
 #include <guacamole/protocol.h>
 #include <guacamole/timestamp.h>
 
+#include <stdbool.h>
+
 /**
  * The maximum number of buffers that the Guacamole video encoder will handle
  * within a single Guacamole protocol dump.
@@ -89,6 +91,33 @@ typedef struct guacenc_display {
      */
     guac_timestamp last_sync;
 
+    /**
+     * The number of milliseconds at the beginning of the recording which
+     * should be read but not encoded.
+     */
+    int skip;
+
+    /**
+     * The number of milliseconds from the beginning of the recording at which
+     * encoding should stop, or 0 if the remainder of the recording should be
+     * encoded. The video ends at the first sync instruction at or after this
+     * point.
+     */
+    int end;
+
+    /**
+     * Whether the point in the recording denoted by end has been reached,
+     * such that no further instructions need be read.
+     */
+    bool ended;
+
+    /**
+     * The timestamp at which the recording began, or 0 if not yet known. If
+     * not otherwise known, this will be the timestamp of the first sync
+     * instruction handled.
+     */
+    guac_timestamp recording_start;
+
     /**
      * The video that this display is recording to.
      */
@@ -150,12 +179,17 @@ int guacenc_display_flatten(guacenc_display* display);
  *     The desired overall bitrate of the resulting encoded video, in bits per
  *     second.
  *
+ * @param pipelined
+ *     Whether colour conversion and encoding of video frames should be
+ *     performed by dedicated threads, concurrently with the handling of
+ *     further instructions.
+ *
  * @return
  *     The newly-allocated Guacamole video encoder display, or NULL if the
  *     display could not be allocated.
  */
 guacenc_display* guacenc_display_alloc(const char* path, const char* codec,
-        int width, int height, int bitrate);
+        int width, int height, int bitrate, bool pipelined);
 
 /**
  * Frees all memory associated with the given Guacamole video encoder display,
@@ -19,25 +19,118 @@
 
 #include "config.h"
 #include "display.h"
+#include "encode.h"
 #include "instructions.h"
 #include "log.h"
+#include "parse.h"
+#include "video.h"
 
 #include <guacamole/client.h>
 #include <guacamole/error.h>
+#include <guacamole/mem.h>
 #include <guacamole/parser.h>
 #include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
 
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
+#ifdef ENABLE_ZLIB
+#include "compressed.h"
+#endif
+
+/**
+ * Returns whether the file having the given file descriptor is a compressed
+ * recording, leaving the offset of that file unchanged.
+ *
+ * @param fd
+ *     The file descriptor of the recording to test.
+ *
+ * @return
+ *     true if the file begins with the gzip magic number and is thus a
+ *     compressed recording, false otherwise.
+ */
+static bool guacenc_is_compressed(int fd) {
+
+    unsigned char magic[2];
+    ssize_t length = pread(fd, magic, sizeof(magic), 0);
+
+    return length == sizeof(magic) && magic[0] == 0x1F && magic[1] == 0x8B;
+
+}
+
+/**
+ * Opens a guac_socket which reads the Guacamole protocol data of the given
+ * recording, decompressing the recording if necessary. If the recording is
+ * compressed and indexed and a point in the recording other than the
+ * beginning is requested, reading begins at the most recent keyframe
+ * preceding that point.
+ *
+ * @param path
+ *     The name of the file being read (for logging purposes and for locating
+ *     the index of compressed recordings).
+ *
+ * @param fd
+ *     The file descriptor of the open recording. On success, this file
+ *     descriptor is owned by the returned guac_socket.
+ *
+ * @param skip
+ *     The number of milliseconds from the beginning of the recording at which
+ *     reading should ideally begin, or zero to read the entire recording.
+ *
+ * @param start
+ *     Pointer to a guac_timestamp which receives the timestamp at which the
+ *     recording began, if reading begins at a keyframe. If reading begins at
+ *     the beginning of the recording, this value is left untouched.
+ *
+ * @return
+ *     A newly-allocated guac_socket which reads the Guacamole protocol data
+ *     of the recording, or NULL if the recording cannot be read.
+ */
+static guac_socket* guacenc_open_recording(const char* path, int fd, int skip,
+        guac_timestamp* start) {
+
+    guac_socket* socket;
+
+    /* Decompress compressed recordings, beginning at the most recent keyframe
+     * preceding the requested point in the recording (if any) */
+    if (guacenc_is_compressed(fd)) {
+#ifdef ENABLE_ZLIB
+        if (skip > 0 && guacenc_compressed_seek(path, fd, skip, start))
+            guacenc_log(GUAC_LOG_INFO, "%s: Recording cannot be seeked and "
+                    "will be read from the beginning.", path);
+
+        socket = guacenc_compressed_open(fd);
+#else
+        guacenc_log(GUAC_LOG_ERROR, "%s: Recording is compressed, but "
+                "guacenc was built without zlib support.", path);
+        return NULL;
+#endif
+    }
+
+    /* Obtain guac_socket wrapping file descriptor */
+    else
+        socket = guac_socket_open(fd);
+
+    if (socket == NULL)
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s", path,
+                guac_status_string(guac_error));
+
+    return socket;
+
+}
+
 /**
  * Reads and handles all Guacamole instructions from the given guac_socket
- * until end-of-stream is reached.
+ * until end-of-stream is reached, or until the end of the requested portion
+ * of the recording is reached.
  *
  * @param display
  *     The current internal display of the Guacamole video encoder.
@@ -62,7 +155,7 @@ static int guacenc_read_instructions(guacenc_display* display,
         return 1;
 
     /* Continuously read and handle all instructions */
-    while (!guac_parser_read(parser, socket, -1)) {
+    while (!display->ended && !guac_parser_read(parser, socket, -1)) {
         if (guacenc_handle_instruction(display, parser->opcode,
                 parser->argc, parser->argv)) {
             guacenc_log(GUAC_LOG_DEBUG, "Handling of \"%s\" instruction "
@@ -71,7 +164,7 @@ static int guacenc_read_instructions(guacenc_display* display,
     }
 
     /* Fail on read/parse error */
-    if (guac_error != GUAC_STATUS_CLOSED) {
+    if (!display->ended && guac_error != GUAC_STATUS_CLOSED) {
         guacenc_log(GUAC_LOG_ERROR, "%s: %s",
                 path, guac_status_string(guac_error));
         guac_parser_free(parser);
@@ -84,8 +177,439 @@ static int guacenc_read_instructions(guacenc_display* display,
 
 }
 
+/**
+ * Encodes the given portion of the given recording as video. The file
+ * descriptor of the recording is always closed, regardless of whether
+ * encoding succeeds.
+ *
+ * @param path
+ *     The path to the file containing the recording.
+ *
+ * @param fd
+ *     The file descriptor of the open recording, which will be read from its
+ *     current offset and closed when encoding completes.
+ *
+ * @param out_path
+ *     The full path to the file in which encoded video should be written.
+ *
+ * @param codec
+ *     The name of the codec to use for the video encoding, as defined by
+ *     ffmpeg / libavcodec.
+ *
+ * @param width
+ *     The width of the desired video, in pixels.
+ *
+ * @param height
+ *     The height of the desired video, in pixels.
+ *
+ * @param bitrate
+ *     The desired overall bitrate of the resulting encoded video, in bits per
+ *     second.
+ *
+ * @param pipelined
+ *     Whether colour conversion and encoding should be performed by dedicated
+ *     threads, concurrently with the handling of further instructions.
+ *
+ * @param start
+ *     The timestamp at which the recording began, or 0 if this should be
+ *     determined from the recording itself.
+ *
+ * @param skip
+ *     The number of milliseconds at the beginning of the recording which
+ *     should not be included in the video.
+ *
+ * @param end
+ *     The number of milliseconds from the beginning of the recording at which
+ *     the video should end, or 0 if the remainder of the recording should be
+ *     encoded.
+ *
+ * @return
+ *     Zero on success, non-zero if an error prevented successful encoding of
+ *     the video.
+ */
+static int guacenc_encode_range(const char* path, int fd,
+        const char* out_path, const char* codec, int width, int height,
+        int bitrate, bool pipelined, guac_timestamp start, int skip,
+        int end) {
+
+    /* Allocate display for encoding process */
+    guacenc_display* display = guacenc_display_alloc(out_path, codec,
+            width, height, bitrate, pipelined);
+    if (display == NULL) {
+        close(fd);
+        return 1;
+    }
+
+    display->skip = skip;
+    display->end = end;
+
+    guac_socket* socket = guacenc_open_recording(path, fd, skip,
+            &display->recording_start);
+    if (socket == NULL) {
+        close(fd);
+        guacenc_display_free(display);
+        return 1;
+    }
+
+    /* Measure all portions of the recording from the same point */
+    if (start != 0)
+        display->recording_start = start;
+
+    /* Attempt to read all instructions in the file */
+    if (guacenc_read_instructions(display, path, socket)) {
+        guac_socket_free(socket);
+        guacenc_display_free(display);
+        return 1;
+    }
+
+    /* Close input and finish encoding process */
+    guac_socket_free(socket);
+    return guacenc_display_free(display);
+
+}
+
+/**
+ * Reads the entire given recording, determining the timestamps of its first
+ * and last "sync" instructions without rendering or encoding anything.
+ *
+ * @param path
+ *     The path to the file containing the recording.
+ *
+ * @param start
+ *     Pointer to a guac_timestamp which receives the timestamp of the first
+ *     "sync" instruction within the recording.
+ *
+ * @param end
+ *     Pointer to a guac_timestamp which receives the timestamp of the last
+ *     "sync" instruction within the recording.
+ *
+ * @return
+ *     Zero if the recording was read successfully and contains at least one
+ *     "sync" instruction, non-zero otherwise.
+ */
+static int guacenc_scan_recording(const char* path, guac_timestamp* start,
+        guac_timestamp* end) {
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s", path, strerror(errno));
+        return 1;
+    }
+
+    guac_timestamp ignored;
+    guac_socket* socket = guacenc_open_recording(path, fd, 0, &ignored);
+    if (socket == NULL) {
+        close(fd);
+        return 1;
+    }
+
+    guac_parser* parser = guac_parser_alloc();
+    if (parser == NULL) {
+        guac_socket_free(socket);
+        return 1;
+    }
+
+    bool found = false;
+
+    /* Note the timestamps of the first and last frames */
+    while (!guac_parser_read(parser, socket, -1)) {
+        if (parser->argc >= 1 && strcmp(parser->opcode, "sync") == 0) {
+
+            guac_timestamp timestamp = guacenc_parse_timestamp(parser->argv[0]);
+
+            if (!found) {
+                *start = timestamp;
+                found = true;
+            }
+
+            *end = timestamp;
+
+        }
+    }
+
+    int retval = !found || guac_error != GUAC_STATUS_CLOSED;
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+    return retval;
+
+}
+
+/**
+ * A single portion of a recording being encoded in parallel with the other
+ * portions of that recording by guacenc_encode_segments().
+ */
+typedef struct guacenc_segment {
+
+    /**
+     * The path to the file containing the recording.
+     */
+    const char* path;
+
+    /**
+     * The full path to the file in which the encoded video of this portion
+     * of the recording should be written.
+     */
+    char out_path[4096];
+
+    /**
+     * The name of the codec to use for the video encoding, as defined by
+     * ffmpeg / libavcodec.
+     */
+    const char* codec;
+
+    /**
+     * The width of the desired video, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the desired video, in pixels.
+     */
+    int height;
+
+    /**
+     * The desired overall bitrate of the resulting encoded video, in bits per
+     * second.
+     */
+    int bitrate;
+
+    /**
+     * Whether colour conversion and encoding should be performed by dedicated
+     * threads.
+     */
+    bool pipelined;
+
+    /**
+     * The timestamp at which the recording began.
+     */
+    guac_timestamp start;
+
+    /**
+     * The number of milliseconds from the beginning of the recording at which
+     * this portion begins.
+     */
+    int skip;
+
+    /**
+     * The number of milliseconds from the beginning of the recording at which
+     * this portion ends, or 0 if this is the final portion.
+     */
+    int end;
+
+    /**
+     * The thread encoding this portion of the recording.
+     */
+    pthread_t thread;
+
+    /**
+     * Zero if this portion of the recording was encoded successfully,
+     * non-zero otherwise.
+     */
+    int result;
+
+} guacenc_segment;
+
+/**
+ * Encodes a single portion of a recording, as described by the given
+ * guacenc_segment, storing the result within that guacenc_segment.
+ *
+ * @param data
+ *     The guacenc_segment describing the portion of the recording to encode.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacenc_segment_thread(void* data) {
+
+    guacenc_segment* segment = (guacenc_segment*) data;
+
+    /* Each portion reads the recording independently */
+    int fd = open(segment->path, O_RDONLY);
+    if (fd < 0) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s", segment->path, strerror(errno));
+        segment->result = 1;
+        return NULL;
+    }
+
+    segment->result = guacenc_encode_range(segment->path, fd,
+            segment->out_path, segment->codec, segment->width,
+            segment->height, segment->bitrate, segment->pipelined,
+            segment->start, segment->skip, segment->end);
+
+    return NULL;
+
+}
+
+/**
+ * Encodes the given recording as video by splitting the recording into
+ * portions of roughly equal duration, encoding each portion in parallel, and
+ * joining the resulting videos. Each portion begins and ends at a "sync"
+ * instruction, and the state of the display at the beginning of each portion
+ * is reconstructed by reading (but not encoding) the recording up to that
+ * point, beginning at the nearest keyframe if the recording is compressed and
+ * indexed.
+ *
+ * @param path
+ *     The path to the file containing the recording.
+ *
+ * @param out_path
+ *     The full path to the file in which encoded video should be written.
+ *
+ * @param codec
+ *     The name of the codec to use for the video encoding, as defined by
+ *     ffmpeg / libavcodec.
+ *
+ * @param width
+ *     The width of the desired video, in pixels.
+ *
+ * @param height
+ *     The height of the desired video, in pixels.
+ *
+ * @param bitrate
+ *     The desired overall bitrate of the resulting encoded video, in bits per
+ *     second.
+ *
+ * @param pipelined
+ *     Whether colour conversion and encoding of each portion should be
+ *     performed by dedicated threads.
+ *
+ * @param skip
+ *     The number of milliseconds at the beginning of the recording which
+ *     should not be included in the video.
+ *
+ * @param segments
+ *     The maximum number of portions to encode in parallel. Fewer portions
+ *     are used if portions would otherwise be shorter than
+ *     GUACENC_MIN_SEGMENT_DURATION.
+ *
+ * @return
+ *     Zero on success, non-zero if an error prevented successful encoding of
+ *     the video.
+ */
+static int guacenc_encode_segments(const char* path, const char* out_path,
+        const char* codec, int width, int height, int bitrate,
+        bool pipelined, int skip, int segments) {
+
+    guac_timestamp first_sync;
+    guac_timestamp last_sync;
+
+    if (guacenc_scan_recording(path, &first_sync, &last_sync)) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: Recording could not be scanned "
+                "for frames.", path);
+        return 1;
+    }
+
+    /* Limit the number of portions such that each is reasonably long */
+    guac_timestamp duration = last_sync - first_sync - skip;
+    if (segments > duration / GUACENC_MIN_SEGMENT_DURATION)
+        segments = duration / GUACENC_MIN_SEGMENT_DURATION;
+
+    /* Short recordings need not be split at all */
+    if (segments <= 1) {
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            guacenc_log(GUAC_LOG_ERROR, "%s: %s", path, strerror(errno));
+            return 1;
+        }
+
+        return guacenc_encode_range(path, fd, out_path, codec, width, height,
+                bitrate, pipelined, 0, skip, 0);
+
+    }
+
+    guacenc_log(GUAC_LOG_INFO, "%s: Encoding %i segments in parallel.",
+            path, segments);
+
+    /* Name the video of each portion after the final video, retaining the
+     * extension which dictates the container format */
+    const char* extension = strrchr(out_path, '.');
+    if (extension == NULL || strchr(extension, '/') != NULL)
+        extension = out_path + strlen(out_path);
+
+    int base_length = extension - out_path;
+
+    guacenc_segment* segment_list =
+        guac_mem_zalloc(sizeof(guacenc_segment), segments);
+    const char** parts = guac_mem_alloc(sizeof(const char*), segments);
+
+    int started = 0;
+    int failures = 0;
+
+    for (int i = 0; i < segments; i++) {
+
+        guacenc_segment* segment = &segment_list[i];
+
+        int length = snprintf(segment->out_path, sizeof(segment->out_path),
+                "%.*s.part%i%s", base_length, out_path, i, extension);
+
+        if (length >= sizeof(segment->out_path)) {
+            guacenc_log(GUAC_LOG_ERROR, "Cannot write output file for \"%s\": "
+                    "Name too long", path);
+            failures++;
+            break;
+        }
+
+        segment->path = path;
+        segment->codec = codec;
+        segment->width = width;
+        segment->height = height;
+        segment->bitrate = bitrate;
+        segment->pipelined = pipelined;
+        segment->start = first_sync;
+
+        /* Divide the requested portion of the recording evenly */
+        segment->skip = skip + duration * i / segments;
+        segment->end = (i + 1 < segments)
+            ? skip + duration * (i + 1) / segments : 0;
+
+        parts[i] = segment->out_path;
+
+        if (pthread_create(&segment->thread, NULL,
+                    guacenc_segment_thread, segment)) {
+            guacenc_log(GUAC_LOG_ERROR, "%s: Unable to start encoding "
+                    "thread.", path);
+            failures++;
+            break;
+        }
+
+        started++;
+
+    }
+
+    /* Wait for all portions to be encoded */
+    for (int i = 0; i < started; i++) {
+        pthread_join(segment_list[i].thread, NULL);
+        if (segment_list[i].result)
+            failures++;
+    }
+
+    /* Join all portions into the final video only if all succeeded */
+    int retval = 1;
+    if (failures == 0) {
+        guacenc_log(GUAC_LOG_DEBUG, "%s: Joining %i segments.", path,
+                segments);
+        retval = guacenc_video_concat(out_path, parts, segments);
+    }
+
+    /* The videos of the individual portions are no longer needed */
+    for (int i = 0; i < started; i++) {
+        if (unlink(segment_list[i].out_path) == -1 && errno != ENOENT)
+            guacenc_log(GUAC_LOG_WARNING, "Segment file \"%s\" could not be "
+                    "automatically deleted: %s", segment_list[i].out_path,
+                    strerror(errno));
+    }
+
+    guac_mem_free(parts);
+    guac_mem_free(segment_list);
+    return retval;
+
+}
+
 int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force) {
+        int width, int height, int bitrate, bool force, int skip,
+        bool pipelined, int segments) {
 
     /* Open input file */
     int fd = open(path, O_RDONLY);
@@ -121,36 +645,18 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
         return 1;
     }
 
-    /* Allocate display for encoding process */
-    guacenc_display* display = guacenc_display_alloc(out_path, codec,
-            width, height, bitrate);
-    if (display == NULL) {
-        close(fd);
-        return 1;
-    }
-
-    /* Obtain guac_socket wrapping file descriptor */
-    guac_socket* socket = guac_socket_open(fd);
-    if (socket == NULL) {
-        guacenc_log(GUAC_LOG_ERROR, "%s: %s", path,
-                guac_status_string(guac_error));
-        close(fd);
-        guacenc_display_free(display);
-        return 1;
-    }
-
     guacenc_log(GUAC_LOG_INFO, "Encoding \"%s\" to \"%s\" ...", path, out_path);
 
-    /* Attempt to read all instructions in the file */
-    if (guacenc_read_instructions(display, path, socket)) {
-        guac_socket_free(socket);
-        guacenc_display_free(display);
-        return 1;
+    /* Split the recording across multiple threads if requested. Each portion
+     * reads the recording through its own file descriptor. */
+    if (segments > 1) {
+        int retval = guacenc_encode_segments(path, out_path, codec, width,
+                height, bitrate, pipelined, skip, segments);
+        close(fd);
+        return retval;
     }
 
-    /* Close input and finish encoding process */
-    guac_socket_free(socket);
-    return guacenc_display_free(display);
+    return guacenc_encode_range(path, fd, out_path, codec, width, height,
+            bitrate, pipelined, 0, skip, 0);
 
 }
-
@@ -25,7 +25,16 @@
 #include <stdbool.h>
 
 /**
- * Encodes the given Guacamole protocol dump as video. A read lock will be
+ * The minimum duration of each portion of a recording encoded in parallel,
+ * in milliseconds. Recordings too short to be split into the requested
+ * number of portions of at least this duration are split into fewer
+ * portions.
+ */
+#define GUACENC_MIN_SEGMENT_DURATION 60000
+
+/**
+ * Encodes the given Guacamole protocol dump as video. The dump may be either
+ * plain Guacamole protocol data or a compressed recording. A read lock will be
  * acquired on the input file to ensure that in-progress recordings are not
  * encoded. This behavior can be overridden by specifying true for the force
  * parameter.
@@ -54,12 +63,30 @@
  *     Perform the encoding, even if the input file appears to be an
  *     in-progress recording (has an associated lock).
  *
+ * @param skip
+ *     The number of milliseconds at the beginning of the recording which
+ *     should not be included in the video. If the recording is compressed and
+ *     indexed, reading begins at the most recent keyframe preceding this
+ *     point.
+ *
+ * @param pipelined
+ *     Whether colour conversion and encoding of video frames should be
+ *     performed by dedicated threads, concurrently with the parsing and
+ *     rendering of the recording.
+ *
+ * @param segments
+ *     The number of portions that the recording should be split into, each
+ *     encoded in parallel before being joined into the final video. Each
+ *     portion begins and ends at a frame boundary ("sync" instruction) of the
+ *     recording. If 1 or less, the recording is encoded as a whole.
+ *
  * @return
  *     Zero on success, non-zero if an error prevented successful encoding of
  *     the video.
  */
 int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force);
+        int width, int height, int bitrate, bool force, int skip,
+        bool pipelined, int segments);
 
 #endif
 
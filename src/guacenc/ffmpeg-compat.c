@@ -265,3 +265,26 @@ int guacenc_open_avcodec(AVCodecContext *avcodec_context,
     return ret;
 
 }
+
+int guacenc_copy_stream_parameters(AVStream* dst, const AVStream* src) {
+
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(57, 33, 100)
+    int ret = avcodec_parameters_copy(dst->codecpar, src->codecpar);
+    if (ret < 0)
+        return ret;
+
+    /* Let the muxer choose the tag appropriate for its container */
+    dst->codecpar->codec_tag = 0;
+#else
+    int ret = avcodec_copy_context(dst->codec, src->codec);
+    if (ret < 0)
+        return ret;
+
+    /* Let the muxer choose the tag appropriate for its container */
+    dst->codec->codec_tag = 0;
+#endif
+
+    dst->time_base = src->time_base;
+    return 0;
+
+}
@@ -161,5 +161,23 @@ int guacenc_open_avcodec(AVCodecContext *avcodec_context,
         const AVCodec *codec, AVDictionary **options,
         AVStream* stream);
 
+/**
+ * Copies the codec parameters and time base of the given input stream to the
+ * given output stream, such that packets read from the input stream can be
+ * written to the output stream verbatim. Because libavformat ver 57.33.100
+ * and greater use stream->codecpar rather than stream->codec, this wrapper
+ * copies whichever is applicable.
+ *
+ * @param dst
+ *     The output stream to copy parameters to.
+ *
+ * @param src
+ *     The input stream to copy parameters from.
+ *
+ * @return
+ *     Zero on success, a negative value on error.
+ */
+int guacenc_copy_stream_parameters(AVStream* dst, const AVStream* src);
+
 #endif
 
@@ -28,6 +28,7 @@
 #include <libavformat/avformat.h>
 
 #include <getopt.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 
@@ -40,10 +41,13 @@ int main(int argc, char* argv[]) {
     int width = GUACENC_DEFAULT_WIDTH;
     int height = GUACENC_DEFAULT_HEIGHT;
     int bitrate = GUACENC_DEFAULT_BITRATE;
+    int skip = 0;
+    bool pipelined = false;
+    int segments = 1;
 
     /* Parse arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "s:r:f")) != -1) {
+    while ((opt = getopt(argc, argv, "s:r:t:j:pf")) != -1) {
 
         /* -s: Dimensions (WIDTHxHEIGHT) */
         if (opt == 's') {
@@ -61,6 +65,28 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        /* -t: Starting point (seconds) */
+        else if (opt == 't') {
+            /* The starting point is later converted to milliseconds */
+            if (guacenc_parse_int(optarg, &skip)
+                    || skip < 0 || skip > INT_MAX / 1000) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid starting point.");
+                goto invalid_options;
+            }
+        }
+
+        /* -j: Number of segments to encode in parallel */
+        else if (opt == 'j') {
+            if (guacenc_parse_int(optarg, &segments) || segments < 1) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid number of segments.");
+                goto invalid_options;
+            }
+        }
+
+        /* -p: Pipelined encoding */
+        else if (opt == 'p')
+            pipelined = true;
+
         /* -f: Force */
         else if (opt == 'f')
             force = true;
@@ -119,7 +145,8 @@ int main(int argc, char* argv[]) {
 
         /* Attempt encoding, log granular success/failure at debug level */
         if (guacenc_encode(path, out_path, "mpeg4",
-                    width, height, bitrate, force)) {
+                    width, height, bitrate, force, skip * 1000,
+                    pipelined, segments)) {
             failures++;
             guacenc_log(GUAC_LOG_DEBUG,
                     "%s was NOT successfully encoded.", path);
@@ -147,6 +174,9 @@ invalid_options:
     fprintf(stderr, "USAGE: %s"
             " [-s WIDTHxHEIGHT]"
             " [-r BITRATE]"
+            " [-t START]"
+            " [-j SEGMENTS]"
+            " [-p]"
             " [-f]"
             " [FILE]...\n", argv[0]);
 
@@ -45,8 +45,444 @@
 #include <string.h>
 #include <unistd.h>
 
+/**
+ * Initializes the given pipeline queue, which must not already be
+ * initialized.
+ *
+ * @param queue
+ *     The queue to initialize.
+ *
+ * @return
+ *     Zero if the queue was initialized successfully, non-zero otherwise.
+ */
+static int guacenc_video_queue_init(guacenc_video_queue* queue) {
+
+    queue->head = 0;
+    queue->length = 0;
+    queue->closed = false;
+
+    if (pthread_mutex_init(&queue->lock, NULL))
+        goto fail_lock;
+
+    if (pthread_cond_init(&queue->not_empty, NULL))
+        goto fail_not_empty;
+
+    if (pthread_cond_init(&queue->not_full, NULL))
+        goto fail_not_full;
+
+    return 0;
+
+fail_not_full:
+    pthread_cond_destroy(&queue->not_empty);
+
+fail_not_empty:
+    pthread_mutex_destroy(&queue->lock);
+
+fail_lock:
+    return 1;
+
+}
+
+/**
+ * Frees all resources associated with the given pipeline queue, which must
+ * be empty and no longer in use by any thread.
+ *
+ * @param queue
+ *     The queue to destroy.
+ */
+static void guacenc_video_queue_destroy(guacenc_video_queue* queue) {
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+}
+
+/**
+ * Adds a copy of the given task to the end of the given pipeline queue,
+ * blocking until space is available.
+ *
+ * @param queue
+ *     The queue to add the task to.
+ *
+ * @param task
+ *     The task to add.
+ */
+static void guacenc_video_queue_push(guacenc_video_queue* queue,
+        const guacenc_video_task* task) {
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (queue->length == GUACENC_VIDEO_PIPELINE_DEPTH)
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+
+    int index = (queue->head + queue->length) % GUACENC_VIDEO_PIPELINE_DEPTH;
+    queue->tasks[index] = *task;
+    queue->length++;
+
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+
+}
+
+/**
+ * Removes the oldest task from the given pipeline queue, blocking until a
+ * task is available or the queue is closed.
+ *
+ * @param queue
+ *     The queue to remove the task from.
+ *
+ * @param task
+ *     Pointer to a guacenc_video_task which receives the removed task.
+ *
+ * @return
+ *     true if a task was removed, false if the queue is closed and no tasks
+ *     remain.
+ */
+static bool guacenc_video_queue_pop(guacenc_video_queue* queue,
+        guacenc_video_task* task) {
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (queue->length == 0 && !queue->closed)
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+
+    /* Stop once all tasks have been handled */
+    if (queue->length == 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return false;
+    }
+
+    *task = queue->tasks[queue->head];
+    queue->head = (queue->head + 1) % GUACENC_VIDEO_PIPELINE_DEPTH;
+    queue->length--;
+
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return true;
+
+}
+
+/**
+ * Closes the given pipeline queue, such that the stage reading from the queue
+ * terminates once all remaining tasks have been handled.
+ *
+ * @param queue
+ *     The queue to close.
+ */
+static void guacenc_video_queue_close(guacenc_video_queue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Frees the given frame and its image data, as allocated by
+ * av_image_alloc().
+ *
+ * @param frame
+ *     The frame to free.
+ */
+static void guacenc_video_frame_free(AVFrame* frame) {
+    av_freep(&frame->data[0]);
+    av_frame_free(&frame);
+}
+
+/**
+ * Allocates a new frame having the format and size required by the encoder
+ * of the given video.
+ *
+ * @param video
+ *     The video that the frame will be written to.
+ *
+ * @return
+ *     A newly-allocated frame, which must eventually be freed with
+ *     guacenc_video_frame_free(), or NULL if allocation fails.
+ */
+static AVFrame* guacenc_video_frame_alloc(guacenc_video* video) {
+
+    AVFrame* frame = av_frame_alloc();
+    if (frame == NULL)
+        return NULL;
+
+    /* Copy necessary data for frame from context */
+    frame->format = video->context->pix_fmt;
+    frame->width = video->context->width;
+    frame->height = video->context->height;
+
+    /* Allocate actual backing data for frame */
+    if (av_image_alloc(frame->data, frame->linesize, frame->width,
+                frame->height, frame->format, 32) < 0) {
+        av_frame_free(&frame);
+        return NULL;
+    }
+
+    return frame;
+
+}
+
+/**
+ * Scales and converts the given RGB frame to the given destination frame,
+ * which must have the format and size of the given video. The scaling
+ * context of the video is reused if possible.
+ *
+ * @param video
+ *     The video that the destination frame will be written to.
+ *
+ * @param src
+ *     The RGB frame to convert.
+ *
+ * @param dst
+ *     The frame which should receive the converted image data.
+ *
+ * @return
+ *     Zero if the frame was converted successfully, non-zero otherwise.
+ */
+static int guacenc_video_convert_frame(guacenc_video* video, AVFrame* src,
+        AVFrame* dst) {
+
+    /* Prepare scaling context, reusing the previous context if possible */
+    video->sws = sws_getCachedContext(video->sws, src->width, src->height,
+            AV_PIX_FMT_RGB32, dst->width, dst->height, AV_PIX_FMT_YUV420P,
+            SWS_BICUBIC, NULL, NULL, NULL);
+
+    /* Abort if scaling context could not be created */
+    if (video->sws == NULL) {
+        guacenc_log(GUAC_LOG_WARNING, "Failed to allocate software scaling "
+                "context. Frame dropped.");
+        return 1;
+    }
+
+    /* Apply scaling, copying the source frame to the destination */
+    sws_scale(video->sws, (const uint8_t* const*) src->data, src->linesize,
+            0, src->height, dst->data, dst->linesize);
+
+    return 0;
+
+}
+
+/**
+ * Flushes the specified frame as a new frame of video, updating the internal
+ * video timestamp by one frame's worth of time. The pts member of the given
+ * frame structure will be updated with the current presentation timestamp of
+ * the video. If pending frames of the video are being flushed, the given frame
+ * may be NULL (as required by avcodec_encode_video2()).
+ *
+ * @param video
+ *     The video to write the given frame to.
+ *
+ * @param frame
+ *     The frame to write to the video, or NULL if previously-written frames
+ *     are being flushed.
+ *
+ * @return
+ *     A positive value if the frame was successfully written, zero if the
+ *     frame has been saved for later writing / reordering, negative if an
+ *     error occurs.
+ */
+static int guacenc_video_write_frame(guacenc_video* video, AVFrame* frame) {
+
+    /* Set timestamp of frame, if frame given */
+    if (frame != NULL)
+        frame->pts = video->next_pts;
+
+    /* Write frame to video */
+    int got_data = guacenc_avcodec_encode_video(video, frame);
+    if (got_data < 0)
+        return -1;
+
+    /* Update presentation timestamp for next frame */
+    video->next_pts++;
+
+    /* Write was successful */
+    return got_data;
+
+}
+
+/**
+ * Flushes the current frame of the given video (the frame most recently
+ * prepared with guacenc_video_prepare_frame()) as a new frame of video,
+ * duplicating that frame the given number of times and updating the internal
+ * video timestamp by one frame's worth of time for each copy written.
+ *
+ * @param video
+ *     The video to flush.
+ *
+ * @param count
+ *     The number of times the current frame should be written.
+ *
+ * @return
+ *     Zero if flushing was successful, non-zero if an error occurs.
+ */
+static int guacenc_video_flush_frame(guacenc_video* video, int count) {
+
+    while (count-- > 0) {
+        if (guacenc_video_write_frame(video, video->next_frame) < 0) {
+            guacenc_log(GUAC_LOG_ERROR, "Unable to flush frame to video "
+                    "stream.");
+            video->failed = 1;
+            return 1;
+        }
+    }
+
+    return 0;
+
+}
+
+/**
+ * The colour conversion stage of the encoding pipeline. RGB frames prepared
+ * by guacenc_video_prepare_frame() are scaled and converted to the format of
+ * the video, and all tasks are then passed on to the encoding stage in their
+ * original order.
+ *
+ * @param data
+ *     The guacenc_video being encoded.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacenc_video_convert_thread(void* data) {
+
+    guacenc_video* video = (guacenc_video*) data;
+    guacenc_video_task task;
+
+    while (guacenc_video_queue_pop(&video->convert_queue, &task)) {
+
+        if (task.type == GUACENC_VIDEO_TASK_FRAME) {
+
+            AVFrame* src = task.frame;
+
+            /* Drop frames which cannot be converted, just as
+             * guacenc_video_prepare_frame() would without a pipeline */
+            task.frame = guacenc_video_frame_alloc(video);
+            if (task.frame == NULL) {
+                guacenc_log(GUAC_LOG_WARNING, "Failed to allocate "
+                        "destination frame. Frame dropped.");
+                guacenc_video_frame_free(src);
+                continue;
+            }
+
+            if (guacenc_video_convert_frame(video, src, task.frame)) {
+                guacenc_video_frame_free(task.frame);
+                guacenc_video_frame_free(src);
+                continue;
+            }
+
+            guacenc_video_frame_free(src);
+
+        }
+
+        guacenc_video_queue_push(&video->encode_queue, &task);
+
+    }
+
+    /* No further tasks will be passed to the encoding stage */
+    guacenc_video_queue_close(&video->encode_queue);
+    return NULL;
+
+}
+
+/**
+ * The encoding stage of the encoding pipeline. Converted frames replace the
+ * current frame of the video, which is written as many times as each
+ * GUACENC_VIDEO_TASK_WRITE task requires.
+ *
+ * @param data
+ *     The guacenc_video being encoded.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacenc_video_encode_thread(void* data) {
+
+    guacenc_video* video = (guacenc_video*) data;
+    guacenc_video_task task;
+
+    while (guacenc_video_queue_pop(&video->encode_queue, &task)) {
+
+        if (task.type == GUACENC_VIDEO_TASK_FRAME) {
+            guacenc_video_frame_free(video->next_frame);
+            video->next_frame = task.frame;
+        }
+
+        else
+            guacenc_video_flush_frame(video, task.count);
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Starts the colour conversion and encoding stages of the encoding pipeline
+ * of the given video, each within its own thread.
+ *
+ * @param video
+ *     The video whose pipeline should be started.
+ *
+ * @return
+ *     Zero if the pipeline was started successfully, non-zero otherwise.
+ */
+static int guacenc_video_start_pipeline(guacenc_video* video) {
+
+    if (guacenc_video_queue_init(&video->convert_queue))
+        goto fail_convert_queue;
+
+    if (guacenc_video_queue_init(&video->encode_queue))
+        goto fail_encode_queue;
+
+    if (pthread_create(&video->encode_thread, NULL,
+                guacenc_video_encode_thread, video))
+        goto fail_encode_thread;
+
+    if (pthread_create(&video->convert_thread, NULL,
+                guacenc_video_convert_thread, video))
+        goto fail_convert_thread;
+
+    return 0;
+
+fail_convert_thread:
+    guacenc_video_queue_close(&video->encode_queue);
+    pthread_join(video->encode_thread, NULL);
+
+fail_encode_thread:
+    guacenc_video_queue_destroy(&video->encode_queue);
+
+fail_encode_queue:
+    guacenc_video_queue_destroy(&video->convert_queue);
+
+fail_convert_queue:
+    guacenc_log(GUAC_LOG_WARNING, "Unable to start encoding pipeline. "
+            "Frames will be encoded sequentially.");
+    return 1;
+
+}
+
+/**
+ * Waits for all tasks pending within the encoding pipeline of the given
+ * video to be handled, and then stops the pipeline. Once the pipeline has
+ * stopped, the current frame of the video may again be accessed by the
+ * calling thread.
+ *
+ * @param video
+ *     The video whose pipeline should be stopped.
+ */
+static void guacenc_video_stop_pipeline(guacenc_video* video) {
+
+    /* The conversion stage closes the encoding queue upon termination */
+    guacenc_video_queue_close(&video->convert_queue);
+    pthread_join(video->convert_thread, NULL);
+    pthread_join(video->encode_thread, NULL);
+
+    guacenc_video_queue_destroy(&video->encode_queue);
+    guacenc_video_queue_destroy(&video->convert_queue);
+
+    video->pipelined = false;
+
+}
+
 guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
-        int width, int height, int bitrate) {
+        int width, int height, int bitrate, bool pipelined) {
 
     const AVOutputFormat *container_format;
     AVFormatContext *container_format_context;
@@ -155,6 +591,12 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
     /* No frames have been written or prepared yet */
     video->last_timestamp = 0;
     video->next_pts = 0;
+    video->sws = NULL;
+    video->finished = false;
+    video->failed = 0;
+
+    /* Convert and encode frames in separate threads if requested */
+    video->pipelined = pipelined && !guacenc_video_start_pipeline(video);
 
     return video;
 
@@ -190,67 +632,15 @@ fail_codec:
 
 }
 
-/**
- * Flushes the specified frame as a new frame of video, updating the internal
- * video timestamp by one frame's worth of time. The pts member of the given
- * frame structure will be updated with the current presentation timestamp of
- * the video. If pending frames of the video are being flushed, the given frame
- * may be NULL (as required by avcodec_encode_video2()).
- *
- * @param video
- *     The video to write the given frame to.
- *
- * @param frame
- *     The frame to write to the video, or NULL if previously-written frames
- *     are being flushed.
- *
- * @return
- *     A positive value if the frame was successfully written, zero if the
- *     frame has been saved for later writing / reordering, negative if an
- *     error occurs.
- */
-static int guacenc_video_write_frame(guacenc_video* video, AVFrame* frame) {
-
-    /* Set timestamp of frame, if frame given */
-    if (frame != NULL)
-        frame->pts = video->next_pts;
-
-    /* Write frame to video */
-    int got_data = guacenc_avcodec_encode_video(video, frame);
-    if (got_data < 0)
-        return -1;
-
-    /* Update presentation timestamp for next frame */
-    video->next_pts++;
-
-    /* Write was successful */
-    return got_data;
-
-}
-
-/**
- * Flushes the frame previously specified by guacenc_video_prepare_frame() as a
- * new frame of video, updating the internal video timestamp by one frame's
- * worth of time.
- *
- * @param video
- *     The video to flush.
- *
- * @return
- *     Zero if flushing was successful, non-zero if an error occurs.
- */
-static int guacenc_video_flush_frame(guacenc_video* video) {
-
-    /* Write frame to video */
-    return guacenc_video_write_frame(video, video->next_frame) < 0;
-
-}
-
 int guacenc_video_advance_timeline(guacenc_video* video,
         guac_timestamp timestamp) {
 
     guac_timestamp next_timestamp = timestamp;
 
+    /* Ignore any further frames once the timeline is finished */
+    if (video->finished)
+        return 0;
+
     /* Flush frames as necessary if previously updated */
     if (video->last_timestamp != 0) {
 
@@ -267,13 +657,16 @@ int guacenc_video_advance_timeline(guacenc_video* video,
                         + elapsed * 1000 / GUACENC_VIDEO_FRAMERATE;
 
         /* Flush frames to bring timeline in sync, duplicating if necessary */
-        do {
-            if (guacenc_video_flush_frame(video)) {
-                guacenc_log(GUAC_LOG_ERROR, "Unable to flush frame to video "
-                        "stream.");
-                return 1;
-            }
-        } while (--elapsed != 0);
+        if (video->pipelined) {
+            guacenc_video_task task = {
+                .type  = GUACENC_VIDEO_TASK_WRITE,
+                .count = elapsed
+            };
+            guacenc_video_queue_push(&video->convert_queue, &task);
+        }
+
+        else if (guacenc_video_flush_frame(video, elapsed))
+            return 1;
 
     }
 
@@ -283,6 +676,15 @@ int guacenc_video_advance_timeline(guacenc_video* video,
 
 }
 
+int guacenc_video_finish_timeline(guacenc_video* video,
+        guac_timestamp timestamp) {
+
+    int retval = guacenc_video_advance_timeline(video, timestamp);
+    video->finished = true;
+    return retval;
+
+}
+
 /**
  * Converts the given Guacamole video encoder buffer to a frame in the format
  * required by libavcodec / libswscale. Black margins of the specified sizes
@@ -403,32 +805,34 @@ void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer) {
     int lsize;
     int psize;
 
-    /* Ignore NULL buffers */
-    if (buffer == NULL || buffer->surface == NULL)
+    /* Ignore NULL buffers and any frames after the timeline is finished */
+    if (buffer == NULL || buffer->surface == NULL || video->finished)
         return;
 
-    /* Obtain destination frame */
-    AVFrame* dst = video->next_frame;
+    /* Obtain destination dimensions (the destination frame itself belongs to
+     * the encoding stage if the video is pipelined) */
+    int width = video->context->width;
+    int height = video->context->height;
 
     /* Determine width of image if height is scaled to match destination */
-    int scaled_width = buffer->width * dst->height / buffer->height;
+    int scaled_width = buffer->width * height / buffer->height;
 
     /* Determine height of image if width is scaled to match destination */
-    int scaled_height = buffer->height * dst->width / buffer->width;
+    int scaled_height = buffer->height * width / buffer->width;
 
     /* If height-based scaling results in a fit width, add pillarboxes */
-    if (scaled_width <= dst->width) {
+    if (scaled_width <= width) {
         lsize = 0;
-        psize = (dst->width - scaled_width)
-               * buffer->height / dst->height / 2;
+        psize = (width - scaled_width)
+               * buffer->height / height / 2;
     }
 
     /* If width-based scaling results in a fit width, add letterboxes */
     else {
-        assert(scaled_height <= dst->height);
+        assert(scaled_height <= height);
         psize = 0;
-        lsize = (dst->height - scaled_height)
-               * buffer->width / dst->width / 2;
+        lsize = (height - scaled_height)
+               * buffer->width / width / 2;
     }
 
     /* Prepare source frame for buffer */
@@ -439,30 +843,21 @@ void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer) {
         return;
     }
 
-    /* Prepare scaling context */
-    struct SwsContext* sws = sws_getContext(src->width, src->height,
-            AV_PIX_FMT_RGB32, dst->width, dst->height, AV_PIX_FMT_YUV420P,
-            SWS_BICUBIC, NULL, NULL, NULL);
-
-    /* Abort if scaling context could not be created */
-    if (sws == NULL) {
-        guacenc_log(GUAC_LOG_WARNING, "Failed to allocate software scaling "
-                "context. Frame dropped.");
-        av_freep(&src->data[0]);
-        av_frame_free(&src);
+    /* Leave conversion of the copied frame to the pipeline, if any */
+    if (video->pipelined) {
+        guacenc_video_task task = {
+            .type  = GUACENC_VIDEO_TASK_FRAME,
+            .frame = src
+        };
+        guacenc_video_queue_push(&video->convert_queue, &task);
         return;
     }
 
     /* Apply scaling, copying the source frame to the destination */
-    sws_scale(sws, (const uint8_t* const*) src->data, src->linesize,
-            0, src->height, dst->data, dst->linesize);
-
-    /* Free scaling context */
-    sws_freeContext(sws);
+    guacenc_video_convert_frame(video, src, video->next_frame);
 
     /* Free source frame */
-    av_freep(&src->data[0]);
-    av_frame_free(&src);
+    guacenc_video_frame_free(src);
 
 }
 
@@ -472,8 +867,13 @@ int guacenc_video_free(guacenc_video* video) {
     if (video == NULL)
         return 0;
 
-    /* Write final frame */
-    guacenc_video_flush_frame(video);
+    /* Wait for all frames within the pipeline to be encoded */
+    if (video->pipelined)
+        guacenc_video_stop_pipeline(video);
+
+    /* Write final frame, unless the timeline ended at that frame */
+    if (!video->finished)
+        guacenc_video_flush_frame(video, 1);
 
     /* Flush any unwritten frames */
     int retval;
@@ -495,8 +895,8 @@ int guacenc_video_free(guacenc_video* video) {
     }
 
     /* Free frame encoding data */
-    av_freep(&video->next_frame->data[0]);
-    av_frame_free(&video->next_frame);
+    guacenc_video_frame_free(video->next_frame);
+    sws_freeContext(video->sws);
 
     /* Clean up encoding context */
     if (video->context != NULL) {
@@ -506,8 +906,156 @@ int guacenc_video_free(guacenc_video* video) {
         avcodec_free_context(&(video->context));
     }
 
+    int failed = video->failed;
     guac_mem_free(video);
-    return 0;
+    return failed;
 
 }
 
+int guacenc_video_concat(const char* path, const char** parts, int count) {
+
+    AVFormatContext* output = NULL;
+    AVStream* output_stream = NULL;
+    bool header_written = false;
+    int retval = 1;
+
+    /* The end of the joined video thus far, in output stream time base */
+    int64_t offset = 0;
+
+    avformat_alloc_output_context2(&output, NULL, NULL, path);
+    if (output == NULL) {
+        guacenc_log(GUAC_LOG_ERROR, "Failed to determine container from "
+                "output file name");
+        return 1;
+    }
+
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 12, 100)
+    AVPacket packet_data;
+    AVPacket* packet = &packet_data;
+    av_init_packet(packet);
+    packet->data = NULL;
+    packet->size = 0;
+#else
+    AVPacket* packet = av_packet_alloc();
+    if (packet == NULL)
+        goto done;
+#endif
+
+    for (int i = 0; i < count; i++) {
+
+        AVFormatContext* input = NULL;
+        if (avformat_open_input(&input, parts[i], NULL, NULL) < 0
+                || avformat_find_stream_info(input, NULL) < 0
+                || input->nb_streams < 1) {
+            guacenc_log(GUAC_LOG_ERROR, "%s: Unable to read encoded video.",
+                    parts[i]);
+            avformat_close_input(&input);
+            goto done;
+        }
+
+        AVStream* input_stream = input->streams[0];
+
+        /* Create the output stream and write the header based on the first
+         * video, which was encoded identically to all others */
+        if (output_stream == NULL) {
+
+            output_stream = avformat_new_stream(output, NULL);
+            if (output_stream == NULL
+                    || guacenc_copy_stream_parameters(output_stream,
+                        input_stream) < 0) {
+                guacenc_log(GUAC_LOG_ERROR, "Could not allocate output "
+                        "stream.");
+                avformat_close_input(&input);
+                goto done;
+            }
+
+            /* Open output file, if the container needs it */
+            if (!(output->oformat->flags & AVFMT_NOFILE)
+                    && avio_open(&output->pb, path, AVIO_FLAG_WRITE) < 0) {
+                guacenc_log(GUAC_LOG_ERROR, "Error occurred while opening "
+                        "output file.");
+                avformat_close_input(&input);
+                goto done;
+            }
+
+            if (avformat_write_header(output, NULL) < 0) {
+                guacenc_log(GUAC_LOG_ERROR, "Error occurred while writing "
+                        "output file header.");
+                avformat_close_input(&input);
+                goto done;
+            }
+
+            header_written = true;
+
+        }
+
+        /* Packets lacking a duration last for a single frame */
+        int64_t frame_duration = av_rescale_q(1,
+                (AVRational) { 1, GUACENC_VIDEO_FRAMERATE },
+                output_stream->time_base);
+
+        /* Copy all packets, offset to follow the previous video */
+        int64_t end = offset;
+        while (av_read_frame(input, packet) >= 0) {
+
+            if (packet->stream_index != input_stream->index) {
+                av_packet_unref(packet);
+                continue;
+            }
+
+            av_packet_rescale_ts(packet, input_stream->time_base,
+                    output_stream->time_base);
+
+            if (packet->dts != AV_NOPTS_VALUE)
+                packet->dts += offset;
+
+            if (packet->pts != AV_NOPTS_VALUE) {
+
+                packet->pts += offset;
+
+                int64_t duration = packet->duration > 0
+                    ? packet->duration : frame_duration;
+
+                if (packet->pts + duration > end)
+                    end = packet->pts + duration;
+
+            }
+
+            packet->stream_index = output_stream->index;
+            int result = av_interleaved_write_frame(output, packet);
+            av_packet_unref(packet);
+
+            if (result < 0) {
+                guacenc_log(GUAC_LOG_ERROR, "%s: Unable to write frame.",
+                        path);
+                avformat_close_input(&input);
+                goto done;
+            }
+
+        }
+
+        offset = end;
+        avformat_close_input(&input);
+
+    }
+
+    retval = 0;
+
+done:
+
+    /* Finish the output file, if any part of it was written */
+    if (header_written && av_write_trailer(output) != 0)
+        retval = 1;
+
+    if (output->pb != NULL)
+        avio_closep(&output->pb);
+
+    avformat_free_context(output);
+
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 12, 100)
+    av_packet_free(&packet);
+#endif
+
+    return retval;
+
+}
@@ -34,6 +34,8 @@
 #include <libavformat/avformat.h>
 #endif
 
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -42,6 +44,105 @@
  */
 #define GUACENC_VIDEO_FRAMERATE 25
 
+/**
+ * The maximum number of tasks which may be waiting within each stage of the
+ * encoding pipeline. Once a stage has this many tasks pending, earlier stages
+ * block until the stage catches up, bounding the memory used by frames in
+ * flight.
+ */
+#define GUACENC_VIDEO_PIPELINE_DEPTH 8
+
+/**
+ * The type of a task passed between the stages of the encoding pipeline.
+ */
+typedef enum guacenc_video_task_type {
+
+    /**
+     * Replaces the frame that will be written by subsequent
+     * GUACENC_VIDEO_TASK_WRITE tasks with the frame of the task.
+     */
+    GUACENC_VIDEO_TASK_FRAME,
+
+    /**
+     * Writes the current frame to the video one or more times.
+     */
+    GUACENC_VIDEO_TASK_WRITE
+
+} guacenc_video_task_type;
+
+/**
+ * A single unit of work passed between the stages of the encoding pipeline.
+ */
+typedef struct guacenc_video_task {
+
+    /**
+     * The type of this task.
+     */
+    guacenc_video_task_type type;
+
+    /**
+     * The frame associated with this task, if the task is a
+     * GUACENC_VIDEO_TASK_FRAME task. Prior to colour conversion, this frame
+     * contains RGB image data of arbitrary size. After colour conversion, this
+     * frame contains image data in the format and size of the video. The frame
+     * and its image data are owned by whichever stage currently holds the
+     * task.
+     */
+    AVFrame* frame;
+
+    /**
+     * The number of times the current frame should be written, if the task
+     * is a GUACENC_VIDEO_TASK_WRITE task.
+     */
+    int count;
+
+} guacenc_video_task;
+
+/**
+ * A bounded, blocking queue of tasks awaiting handling by one stage of the
+ * encoding pipeline.
+ */
+typedef struct guacenc_video_queue {
+
+    /**
+     * The tasks currently within the queue, stored as a ring buffer.
+     */
+    guacenc_video_task tasks[GUACENC_VIDEO_PIPELINE_DEPTH];
+
+    /**
+     * The index of the oldest task within the queue.
+     */
+    int head;
+
+    /**
+     * The number of tasks currently within the queue.
+     */
+    int length;
+
+    /**
+     * Whether no further tasks will be added to the queue. Once closed and
+     * empty, the stage reading from the queue terminates.
+     */
+    bool closed;
+
+    /**
+     * Lock which guards all other members of this queue.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever a task is added to the queue or
+     * the queue is closed.
+     */
+    pthread_cond_t not_empty;
+
+    /**
+     * Condition which is signalled whenever a task is removed from the queue.
+     */
+    pthread_cond_t not_full;
+
+} guacenc_video_queue;
+
 /**
  * A video which is actively being encoded. Frames can be added to the video
  * as they are generated, along with their associated timestamps, and the
@@ -102,6 +203,57 @@ typedef struct guacenc_video {
      */
     guac_timestamp last_timestamp;
 
+    /**
+     * The scaling context most recently used to convert prepared frames to
+     * the format and size of the video, or NULL if no frames have yet been
+     * converted. The context is reused for as long as the size of prepared
+     * frames remains the same.
+     */
+    struct SwsContext* sws;
+
+    /**
+     * Whether the timeline of the video has been finished with
+     * guacenc_video_finish_timeline(), in which case no further frames will
+     * be written, including the final frame normally written by
+     * guacenc_video_free().
+     */
+    bool finished;
+
+    /**
+     * Whether colour conversion and encoding are performed by dedicated
+     * threads, each a separate stage of a pipeline fed by the thread that
+     * prepares frames. If false, all work is performed by the calling thread.
+     */
+    bool pipelined;
+
+    /**
+     * The tasks awaiting colour conversion, if the video is pipelined.
+     */
+    guacenc_video_queue convert_queue;
+
+    /**
+     * The tasks awaiting encoding, if the video is pipelined.
+     */
+    guacenc_video_queue encode_queue;
+
+    /**
+     * The thread performing colour conversion, if the video is pipelined.
+     */
+    pthread_t convert_thread;
+
+    /**
+     * The thread performing encoding, if the video is pipelined. While the
+     * pipeline is running, this thread exclusively owns next_frame.
+     */
+    pthread_t encode_thread;
+
+    /**
+     * Non-zero if any stage of the pipeline failed to convert or write a
+     * frame. This value may only be read by other threads after the pipeline
+     * has terminated.
+     */
+    int failed;
+
 } guacenc_video;
 
 /**
@@ -127,9 +279,15 @@ typedef struct guacenc_video {
  * @param bitrate
  *     The desired overall bitrate of the resulting encoded video, in bits per
  *     second.
+ *
+ * @param pipelined
+ *     Whether colour conversion and encoding should be performed by dedicated
+ *     threads, concurrently with the preparation of further frames. If the
+ *     threads cannot be created, all work is instead performed by the calling
+ *     thread.
  */
 guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
-        int width, int height, int bitrate);
+        int width, int height, int bitrate, bool pipelined);
 
 /**
  * Advances the timeline of the encoding process to the given timestamp, such
@@ -158,6 +316,29 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
 int guacenc_video_advance_timeline(guacenc_video* video,
         guac_timestamp timestamp);
 
+/**
+ * Advances the timeline of the encoding process to the given timestamp, as
+ * guacenc_video_advance_timeline(), and then finishes the timeline such that
+ * no further frames are written. The frame prepared most recently is written
+ * only as many times as required to reach the given timestamp, and is not
+ * written again when the video is freed. This allows separately-encoded
+ * portions of a recording to be joined at the given timestamp without
+ * duplicating the frame at the boundary.
+ *
+ * @param video
+ *     The video whose timeline should be finished.
+ *
+ * @param timestamp
+ *     The Guacamole timestamp denoting the point in time at which the video
+ *     should end.
+ *
+ * @return
+ *     Zero if the timeline was finished successfully, non-zero if an error
+ *     occurs.
+ */
+int guacenc_video_finish_timeline(guacenc_video* video,
+        guac_timestamp timestamp);
+
 /**
  * Stores the given buffer within the given video structure such that it will
  * be written if it falls within proper frame boundaries. If the timeline of
@@ -190,5 +371,25 @@ void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer);
  */
 int guacenc_video_free(guacenc_video* video);
 
+/**
+ * Joins the given videos, which must have been encoded with identical
+ * settings, into a single video saved in the given file. The packets of each
+ * video are copied verbatim, without re-encoding, with their timestamps
+ * offset such that each video begins where the previous video ends.
+ *
+ * @param path
+ *     The full path to the file in which the joined video should be written.
+ *
+ * @param parts
+ *     The full paths to the files containing the videos to join, in order.
+ *
+ * @param count
+ *     The number of videos to join.
+ *
+ * @return
+ *     Zero if the videos were joined successfully, non-zero otherwise.
+ */
+int guacenc_video_concat(const char* path, const char** parts, int count);
+
 #endif
 
@@ -27,6 +27,10 @@
 #include "guacamole/user.h"
 #include "raw_encoder.h"
 
+#ifdef ENABLE_OPUS
+#include "opus_encoder.h"
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -89,6 +93,14 @@ static void* guac_audio_assign_encoder(guac_user* user, void* data) {
 
         const char* mimetype = user->info.audio_mimetypes[i];
 
+#ifdef ENABLE_OPUS
+        /* If Opus is supported, done (any PCM format can be encoded) */
+        if (strcmp(mimetype, guac_opus_encoder->mimetype) == 0) {
+            guac_audio_stream_set_encoder(audio, guac_opus_encoder);
+            break;
+        }
+#endif
+
         /* If 16-bit raw audio is supported, done. */
         if (bps == 16 && strcmp(mimetype, raw16_encoder->mimetype) == 0) {
             guac_audio_stream_set_encoder(audio, raw16_encoder);
@@ -212,6 +224,15 @@ void guac_audio_stream_write_pcm(guac_audio_stream* audio,
 
 }
 
+void guac_audio_stream_set_compression(guac_audio_stream* audio,
+        int bitrate, int frame_duration, int low_delay) {
+
+    audio->bitrate = bitrate;
+    audio->frame_duration = frame_duration;
+    audio->low_delay = low_delay;
+
+}
+
 void guac_audio_stream_flush(guac_audio_stream* audio) {
 
     /* Flush any buffered data */
@@ -0,0 +1,619 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "base64.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(HAVE_SSSE3_TARGET)
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * All characters used by base64, in order of the 6-bit values they
+ * represent.
+ */
+static const char GUAC_BASE64_CHARACTERS[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * Value within the decoding table for characters which terminate decoding
+ * (padding and the null terminator).
+ */
+#define GUAC_BASE64_DECODE_STOP 0x80
+
+/**
+ * Signature of any function which encodes bytes as base64 in the manner
+ * described for guac_base64_encode().
+ */
+typedef size_t guac_base64_encoder(const unsigned char* src, size_t length, char* dest);
+
+/**
+ * Signature of any function which decodes base64 in-place in the manner
+ * described for guac_base64_decode_length().
+ */
+typedef size_t guac_base64_decoder(char* base64, size_t length);
+
+/**
+ * Decodes the given null-terminated base64 string in-place without the use of
+ * vectorized instructions. The length of the string is not needed by this
+ * implementation and is ignored.
+ */
+static guac_base64_decoder guac_base64_decode_fallback;
+
+/**
+ * The implementation of base64 encoding selected for the local processor.
+ */
+static guac_base64_encoder* guac_base64_encode_impl = guac_base64_encode_scalar;
+
+/**
+ * The implementation of base64 decoding selected for the local processor.
+ */
+static guac_base64_decoder* guac_base64_decode_impl = guac_base64_decode_fallback;
+
+/**
+ * Lookup table mapping each possible character to its 6-bit base64 value,
+ * GUAC_BASE64_DECODE_STOP for characters which terminate decoding, or zero
+ * for all other characters.
+ */
+static unsigned char guac_base64_decode_table[256];
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+/**
+ * Lookup table mapping each 7-bit character to its 6-bit base64 value, or
+ * 0xFF for all characters which are not valid base64 (including padding and
+ * the null terminator). Used only by guac_base64_decode_neon().
+ */
+static unsigned char guac_base64_decode_table_neon[128];
+#endif
+
+/**
+ * Guard ensuring guac_base64_init() is invoked exactly once.
+ */
+static pthread_once_t guac_base64_init_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Encodes the trailing one or two bytes of data as four base64 characters,
+ * including padding.
+ *
+ * @param src
+ *     The bytes to encode.
+ *
+ * @param length
+ *     The number of bytes to encode. This MUST be 1 or 2.
+ *
+ * @param dest
+ *     The buffer that should receive exactly four base64 characters.
+ */
+static void guac_base64_encode_tail(const unsigned char* src, size_t length,
+        char* dest) {
+
+    /*
+     * One character of padding:
+     *
+     *   AAAAAA  AABBBB  BBBB--  ======
+     *
+     * Two characters of padding:
+     *
+     *   AAAAAA  AA----  ======  ======
+     */
+    unsigned int a = src[0];
+    unsigned int b = (length > 1) ? src[1] : 0;
+
+    dest[0] = GUAC_BASE64_CHARACTERS[a >> 2];
+    dest[1] = GUAC_BASE64_CHARACTERS[((a & 0x03) << 4) | (b >> 4)];
+    dest[2] = (length > 1) ? GUAC_BASE64_CHARACTERS[(b & 0x0F) << 2] : '=';
+    dest[3] = '=';
+
+}
+
+size_t guac_base64_encode_scalar(const unsigned char* src, size_t length,
+        char* dest) {
+
+    char* start = dest;
+
+    /* Encode all complete groups of three bytes with no need to consider
+     * padding */
+    while (length >= 3) {
+
+        /* AAAAAA AABBBB BBBBCC CCCCCC */
+        uint32_t group = (src[0] << 16) | (src[1] << 8) | src[2];
+
+        dest[0] = GUAC_BASE64_CHARACTERS[(group >> 18) & 0x3F];
+        dest[1] = GUAC_BASE64_CHARACTERS[(group >> 12) & 0x3F];
+        dest[2] = GUAC_BASE64_CHARACTERS[(group >> 6) & 0x3F];
+        dest[3] = GUAC_BASE64_CHARACTERS[group & 0x3F];
+
+        src += 3;
+        dest += 4;
+        length -= 3;
+
+    }
+
+    /* Take care of partial remnants */
+    if (length > 0) {
+        guac_base64_encode_tail(src, length, dest);
+        dest += 4;
+    }
+
+    return dest - start;
+
+}
+
+#if defined(HAVE_SSSE3_TARGET)
+
+/**
+ * Encodes the given bytes as base64 using SSSE3 instructions, converting 12
+ * bytes to 16 characters at a time. This function may only be invoked if the
+ * local processor supports SSSE3.
+ *
+ * @param src
+ *     The bytes to encode.
+ *
+ * @param length
+ *     The number of bytes to encode.
+ *
+ * @param dest
+ *     The buffer that should receive the base64-encoded characters.
+ *
+ * @return
+ *     The number of characters written to the destination buffer.
+ */
+__attribute__((target("ssse3")))
+static size_t guac_base64_encode_ssse3(const unsigned char* src, size_t length,
+        char* dest) {
+
+    char* start = dest;
+
+    /* Translation offsets, indexed by range of 6-bit value (see below) */
+    const __m128i offsets = _mm_setr_epi8(
+            'A', 'a' - 26,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '+' - 62, '/' - 63, 0, 0);
+
+    /* NOTE: Each iteration reads 16 bytes but consumes only 12 */
+    while (length >= 16) {
+
+        __m128i in = _mm_loadu_si128((const __m128i*) src);
+
+        /* Duplicate each group of three bytes [a b c] into a 32-bit word
+         * [b a c b] such that each of the four 6-bit values can be isolated
+         * within its own byte with only shifts and masks */
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(
+                    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+        /* Shift the first and third 6-bit values into position ... */
+        __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+        __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+
+        /* ... as well as the second and fourth */
+        __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+        __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+        __m128i values = _mm_or_si128(t1, t3);
+
+        /* Determine range of each value: 0 for 0-25, 1 for 26-51, and 2-13
+         * for 52-63, then translate using the offset for that range */
+        __m128i range = _mm_subs_epu8(values, _mm_set1_epi8(51));
+        range = _mm_sub_epi8(range, _mm_cmpgt_epi8(values, _mm_set1_epi8(25)));
+
+        __m128i out = _mm_add_epi8(values, _mm_shuffle_epi8(offsets, range));
+        _mm_storeu_si128((__m128i*) dest, out);
+
+        src += 12;
+        dest += 16;
+        length -= 12;
+
+    }
+
+    return (dest - start) + guac_base64_encode_scalar(src, length, dest);
+
+}
+
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+
+/**
+ * Encodes the given bytes as base64 using NEON instructions, converting 48
+ * bytes to 64 characters at a time. NEON is always available on AArch64.
+ *
+ * @param src
+ *     The bytes to encode.
+ *
+ * @param length
+ *     The number of bytes to encode.
+ *
+ * @param dest
+ *     The buffer that should receive the base64-encoded characters.
+ *
+ * @return
+ *     The number of characters written to the destination buffer.
+ */
+static size_t guac_base64_encode_neon(const unsigned char* src, size_t length,
+        char* dest) {
+
+    char* start = dest;
+
+    const uint8x16x4_t characters = {{
+        vld1q_u8((const uint8_t*) GUAC_BASE64_CHARACTERS),
+        vld1q_u8((const uint8_t*) GUAC_BASE64_CHARACTERS + 16),
+        vld1q_u8((const uint8_t*) GUAC_BASE64_CHARACTERS + 32),
+        vld1q_u8((const uint8_t*) GUAC_BASE64_CHARACTERS + 48)
+    }};
+
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+
+    while (length >= 48) {
+
+        /* Load 16 groups of three bytes, deinterleaving such that each
+         * vector contains the same byte of each group */
+        uint8x16x3_t in = vld3q_u8(src);
+        uint8x16x4_t values;
+
+        /* AAAAAA AABBBB BBBBCC CCCCCC */
+        values.val[0] = vshrq_n_u8(in.val[0], 2);
+        values.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+                    vshrq_n_u8(in.val[1], 4)), mask);
+        values.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+                    vshrq_n_u8(in.val[2], 6)), mask);
+        values.val[3] = vandq_u8(in.val[2], mask);
+
+        /* Translate and reinterleave into 64 characters */
+        values.val[0] = vqtbl4q_u8(characters, values.val[0]);
+        values.val[1] = vqtbl4q_u8(characters, values.val[1]);
+        values.val[2] = vqtbl4q_u8(characters, values.val[2]);
+        values.val[3] = vqtbl4q_u8(characters, values.val[3]);
+        vst4q_u8((uint8_t*) dest, values);
+
+        src += 48;
+        dest += 64;
+        length -= 48;
+
+    }
+
+    return (dest - start) + guac_base64_encode_scalar(src, length, dest);
+
+}
+
+#endif
+
+/**
+ * Decodes base64 characters starting at the given input position, writing
+ * the decoded bytes starting at the given output position, until a character
+ * which terminates decoding is reached. The output position may be the same
+ * as the input position, or may trail behind it by any amount.
+ *
+ * @param input
+ *     The first base64 character to decode.
+ *
+ * @param output
+ *     The location that should receive the first decoded byte.
+ *
+ * @return
+ *     The number of bytes written to the output location.
+ */
+static size_t guac_base64_decode_remaining(const unsigned char* input,
+        unsigned char* output) {
+
+    unsigned char* start = output;
+
+    /* Decode groups of four characters for as long as none of those
+     * characters terminate decoding (NOTE: the null terminator is itself a
+     * terminating character, thus this never reads past the end of the
+     * string) */
+    for (;;) {
+
+        unsigned char a = guac_base64_decode_table[input[0]];
+        if (a & GUAC_BASE64_DECODE_STOP) break;
+
+        unsigned char b = guac_base64_decode_table[input[1]];
+        if (b & GUAC_BASE64_DECODE_STOP) break;
+
+        unsigned char c = guac_base64_decode_table[input[2]];
+        if (c & GUAC_BASE64_DECODE_STOP) break;
+
+        unsigned char d = guac_base64_decode_table[input[3]];
+        if (d & GUAC_BASE64_DECODE_STOP) break;
+
+        /* AAAAAA BBBBBB CCCCCC DDDDDD */
+        uint32_t group = (a << 18) | (b << 12) | (c << 6) | d;
+
+        /* NOTE: The output can never overtake the input, as each group of
+         * four characters produces only three bytes */
+        output[0] = group >> 16;
+        output[1] = group >> 8;
+        output[2] = group;
+
+        input += 4;
+        output += 3;
+
+    }
+
+    /* Decode any remaining characters prior to termination, where two or
+     * three characters produce one or two bytes respectively */
+    uint32_t value = 0;
+    int bits_read = 0;
+
+    unsigned char current;
+    while (!((current = guac_base64_decode_table[*(input++)]) & GUAC_BASE64_DECODE_STOP)) {
+
+        value = (value << 6) | current;
+        bits_read += 6;
+
+        /* If we have at least one byte, write out the latest whole byte */
+        if (bits_read >= 8) {
+            *(output++) = (value >> (bits_read - 8)) & 0xFF;
+            bits_read -= 8;
+        }
+
+    }
+
+    /* Return number of bytes written */
+    return output - start;
+
+}
+
+static size_t guac_base64_decode_fallback(char* base64, size_t length) {
+    return guac_base64_decode_remaining((const unsigned char*) base64,
+            (unsigned char*) base64);
+}
+
+#if defined(HAVE_SSSE3_TARGET)
+
+/**
+ * Decodes the given null-terminated base64 string in-place using SSSE3
+ * instructions, converting 16 characters to 12 bytes at a time. Any group of
+ * 16 characters containing padding, the null terminator, or characters which
+ * are not valid base64 is left to the scalar implementation. This function
+ * may only be invoked if the local processor supports SSSE3.
+ *
+ * @param base64
+ *     The base64 string to decode.
+ *
+ * @param length
+ *     The length of the string, excluding the null terminator. Vector loads
+ *     never read beyond this many characters.
+ *
+ * @return
+ *     The number of bytes resulting from decoding the string.
+ */
+__attribute__((target("ssse3")))
+static size_t guac_base64_decode_ssse3(char* base64, size_t length) {
+
+    const unsigned char* input = (const unsigned char*) base64;
+    unsigned char* output = (unsigned char*) base64;
+
+    /* Flags identifying invalid characters, indexed by the low and high
+     * nibbles of each character respectively. A character is invalid if the
+     * flags for its low and high nibbles have any bits in common. */
+    const __m128i invalid_lo = _mm_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i invalid_hi = _mm_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+
+    /* Translation offsets, indexed by high nibble, except that '/' (which
+     * shares its high nibble with '+') uses index 1 */
+    const __m128i offsets = _mm_setr_epi8(
+            0, '/' - 63, '+' - 62, '0' - 52, 'A', 'A', 'a' - 26, 'a' - 26,
+            0, 0, 0, 0, 0, 0, 0, 0);
+
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    while (length >= 16) {
+
+        __m128i in = _mm_loadu_si128((const __m128i*) input);
+
+        __m128i lo = _mm_and_si128(in, nibble);
+        __m128i hi = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+
+        /* Leave any group with characters requiring special handling to the
+         * scalar implementation */
+        __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(invalid_lo, lo),
+                _mm_shuffle_epi8(invalid_hi, hi));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xFFFF)
+            break;
+
+        /* Translate each character to its 6-bit value */
+        __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        __m128i values = _mm_sub_epi8(in,
+                _mm_shuffle_epi8(offsets, _mm_add_epi8(hi, slash)));
+
+        /* Pack each group of four 6-bit values into 24 bits: first into
+         * pairs of 12 bits ... */
+        __m128i packed = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+
+        /* ... then into 24 bits at the bottom of each 32-bit word */
+        packed = _mm_madd_epi16(packed, _mm_set1_epi32(0x00011000));
+
+        /* Reorder into 12 contiguous bytes in big-endian order */
+        __m128i out = _mm_shuffle_epi8(packed, _mm_setr_epi8(
+                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+        /* NOTE: Though only 12 bytes are meaningful, 16 are written. This
+         * can never overwrite characters not yet read, as the output trails
+         * the input. */
+        _mm_storeu_si128((__m128i*) output, out);
+
+        input += 16;
+        output += 12;
+        length -= 16;
+
+    }
+
+    return (output - (unsigned char*) base64)
+        + guac_base64_decode_remaining(input, output);
+
+}
+
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+
+/**
+ * Decodes the given null-terminated base64 string in-place using NEON
+ * instructions, converting 64 characters to 48 bytes at a time. Any group of
+ * 64 characters containing padding, the null terminator, or characters which
+ * are not valid base64 is left to the scalar implementation. NEON is always
+ * available on AArch64.
+ *
+ * @param base64
+ *     The base64 string to decode.
+ *
+ * @param length
+ *     The length of the string, excluding the null terminator. Vector loads
+ *     never read beyond this many characters.
+ *
+ * @return
+ *     The number of bytes resulting from decoding the string.
+ */
+static size_t guac_base64_decode_neon(char* base64, size_t length) {
+
+    const unsigned char* input = (const unsigned char*) base64;
+    unsigned char* output = (unsigned char*) base64;
+
+    const uint8x16x4_t table_lo = {{
+        vld1q_u8(guac_base64_decode_table_neon),
+        vld1q_u8(guac_base64_decode_table_neon + 16),
+        vld1q_u8(guac_base64_decode_table_neon + 32),
+        vld1q_u8(guac_base64_decode_table_neon + 48)
+    }};
+
+    const uint8x16x4_t table_hi = {{
+        vld1q_u8(guac_base64_decode_table_neon + 64),
+        vld1q_u8(guac_base64_decode_table_neon + 80),
+        vld1q_u8(guac_base64_decode_table_neon + 96),
+        vld1q_u8(guac_base64_decode_table_neon + 112)
+    }};
+
+    const uint8x16_t offset = vdupq_n_u8(64);
+    const uint8x16_t high_bit = vdupq_n_u8(0x80);
+
+    while (length >= 64) {
+
+        /* Load 16 groups of four characters, deinterleaving such that each
+         * vector contains the same character of each group */
+        uint8x16x4_t in = vld4q_u8(input);
+        uint8x16x4_t values;
+        uint8x16_t invalid = vdupq_n_u8(0);
+
+        /* Translate each character to its 6-bit value, looking up the first
+         * 64 characters within the lower half of the table and the next 64
+         * within the upper half (characters outside the table are translated
+         * to zero and flagged separately) */
+        for (int i = 0; i < 4; i++) {
+            values.val[i] = vqtbx4q_u8(vqtbl4q_u8(table_lo, in.val[i]),
+                    table_hi, vsubq_u8(in.val[i], offset));
+            invalid = vorrq_u8(invalid, vorrq_u8(values.val[i],
+                        vandq_u8(in.val[i], high_bit)));
+        }
+
+        /* Leave any group with characters requiring special handling to the
+         * scalar implementation */
+        if (vmaxvq_u8(invalid) & 0x80)
+            break;
+
+        /* AAAAAA BBBBBB CCCCCC DDDDDD */
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8(vshlq_n_u8(values.val[0], 2),
+                vshrq_n_u8(values.val[1], 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(values.val[1], 4),
+                vshrq_n_u8(values.val[2], 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]);
+
+        /* Reinterleave into 48 bytes (the output trails the input, thus this
+         * can never overwrite characters not yet read) */
+        vst3q_u8(output, out);
+
+        input += 64;
+        output += 48;
+        length -= 64;
+
+    }
+
+    return (output - (unsigned char*) base64)
+        + guac_base64_decode_remaining(input, output);
+
+}
+
+#endif
+
+/**
+ * Selects the base64 implementation appropriate for the local processor and
+ * initializes the decoding table. This function is invoked exactly once
+ * through pthread_once().
+ */
+static void guac_base64_init() {
+
+    /* Mark all characters that terminate decoding */
+    guac_base64_decode_table['\0'] = GUAC_BASE64_DECODE_STOP;
+    guac_base64_decode_table['='] = GUAC_BASE64_DECODE_STOP;
+
+    for (int i = 0; i < 64; i++)
+        guac_base64_decode_table[(unsigned char) GUAC_BASE64_CHARACTERS[i]] = i;
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+    memset(guac_base64_decode_table_neon, 0xFF, sizeof(guac_base64_decode_table_neon));
+    for (int i = 0; i < 64; i++)
+        guac_base64_decode_table_neon[(unsigned char) GUAC_BASE64_CHARACTERS[i]] = i;
+
+    guac_base64_encode_impl = guac_base64_encode_neon;
+    guac_base64_decode_impl = guac_base64_decode_neon;
+#elif defined(HAVE_SSSE3_TARGET)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        guac_base64_encode_impl = guac_base64_encode_ssse3;
+        guac_base64_decode_impl = guac_base64_decode_ssse3;
+    }
+#endif
+
+}
+
+size_t guac_base64_encode(const unsigned char* src, size_t length, char* dest) {
+    pthread_once(&guac_base64_init_once, guac_base64_init);
+    return guac_base64_encode_impl(src, length, dest);
+}
+
+size_t guac_base64_decode(char* base64) {
+    return guac_base64_decode_length(base64, strlen(base64));
+}
+
+size_t guac_base64_decode_length(char* base64, size_t length) {
+    pthread_once(&guac_base64_init_once, guac_base64_init);
+    return guac_base64_decode_impl(base64, length);
+}
+
+size_t guac_base64_decode_scalar(char* base64) {
+    pthread_once(&guac_base64_init_once, guac_base64_init);
+    return guac_base64_decode_remaining((const unsigned char*) base64,
+            (unsigned char*) base64);
+}
+
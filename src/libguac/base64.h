@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_BASE64_H
+#define GUAC_BASE64_H
+
+#include <stddef.h>
+
+/**
+ * Returns the number of characters required to represent the given number of
+ * bytes as base64, including any padding.
+ *
+ * @param length
+ *     The number of bytes to be encoded.
+ *
+ * @return
+ *     The number of characters required to encode the given number of bytes.
+ */
+#define GUAC_BASE64_ENCODED_LENGTH(length) (((length) + 2) / 3 * 4)
+
+/**
+ * Encodes the given bytes as base64, including any padding required. The
+ * destination buffer must have space for at least
+ * GUAC_BASE64_ENCODED_LENGTH(length) characters. No null terminator is
+ * written.
+ *
+ * Depending on the capabilities of the compiler and the local processor, this
+ * function may use vectorized (SIMD) instructions. The implementation used is
+ * chosen once, the first time this function is invoked.
+ *
+ * @param src
+ *     The bytes to encode.
+ *
+ * @param length
+ *     The number of bytes to encode.
+ *
+ * @param dest
+ *     The buffer that should receive the base64-encoded characters.
+ *
+ * @return
+ *     The number of characters written to the destination buffer.
+ */
+size_t guac_base64_encode(const unsigned char* src, size_t length, char* dest);
+
+/**
+ * Encodes the given bytes as base64, exactly as guac_base64_encode() does,
+ * but without the use of vectorized instructions. This implementation serves
+ * as the fallback for guac_base64_encode() and as a reference for verifying
+ * the vectorized implementations.
+ *
+ * @param src
+ *     The bytes to encode.
+ *
+ * @param length
+ *     The number of bytes to encode.
+ *
+ * @param dest
+ *     The buffer that should receive the base64-encoded characters.
+ *
+ * @return
+ *     The number of characters written to the destination buffer.
+ */
+size_t guac_base64_encode_scalar(const unsigned char* src, size_t length, char* dest);
+
+/**
+ * Decodes the given null-terminated base64 string in-place. Decoding stops at
+ * the first padding character ('=') or at the end of the string, whichever
+ * comes first. Characters which are not valid base64 are decoded as if they
+ * were zero.
+ *
+ * Depending on the capabilities of the compiler and the local processor, this
+ * function may use vectorized (SIMD) instructions. The implementation used is
+ * chosen once, the first time this function or guac_base64_encode() is
+ * invoked.
+ *
+ * @param base64
+ *     The base64 string to decode. The decoded bytes will overwrite the
+ *     contents of this string, starting at the beginning of the string.
+ *
+ * @return
+ *     The number of bytes resulting from decoding the string.
+ */
+size_t guac_base64_decode(char* base64);
+
+/**
+ * Decodes the given null-terminated base64 string in-place, exactly as
+ * guac_base64_decode() does, but using a length already known to the caller
+ * (such as the argument sizes determined by guac_parser) rather than
+ * measuring the string again. The string must still be null-terminated at
+ * the given length. If the string contains an earlier null character,
+ * decoding stops there, just as it would for guac_base64_decode().
+ *
+ * @param base64
+ *     The base64 string to decode. The decoded bytes will overwrite the
+ *     contents of this string, starting at the beginning of the string.
+ *
+ * @param length
+ *     The length of the string, in bytes, excluding the null terminator.
+ *
+ * @return
+ *     The number of bytes resulting from decoding the string.
+ */
+size_t guac_base64_decode_length(char* base64, size_t length);
+
+/**
+ * Decodes the given null-terminated base64 string in-place, exactly as
+ * guac_base64_decode() does, but without the use of vectorized instructions.
+ * This implementation serves as the fallback for guac_base64_decode() and as a
+ * reference for verifying the vectorized implementations.
+ *
+ * @param base64
+ *     The base64 string to decode. The decoded bytes will overwrite the
+ *     contents of this string, starting at the beginning of the string.
+ *
+ * @return
+ *     The number of bytes resulting from decoding the string.
+ */
+size_t guac_base64_decode_scalar(char* base64);
+
+#endif
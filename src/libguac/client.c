@@ -36,6 +36,7 @@
 #include "guacamole/timestamp.h"
 #include "guacamole/user.h"
 #include "id.h"
+#include "socket-broadcast.h"
 
 #include <dlfcn.h>
 #include <errno.h>
@@ -155,9 +156,154 @@ void guac_client_free_stream(guac_client* client, guac_stream* stream) {
 
 }
 
+/**
+ * Adds the given list of users to the start of the list of full users. The
+ * list of full users must NOT already be locked for writing.
+ *
+ * @param client
+ *     The client whose list of full users should be updated.
+ *
+ * @param first_user
+ *     The first user in the list of users to add, or NULL if there are no
+ *     users to add.
+ */
+static void guac_client_add_full_users(guac_client* client,
+        guac_user* first_user) {
+
+    if (first_user == NULL)
+        return;
+
+    /* Iterate through the given users to find the final user */
+    guac_user* last_user = first_user;
+    while (last_user->__next != NULL)
+        last_user = last_user->__next;
+
+    /* Acquire the lock for reading and modifying the list of full users. */
+    guac_rwlock_acquire_write_lock(&(client->__users_lock));
+
+    /* Add all given users to the start of the user list */
+    if (client->__users != NULL)
+        client->__users->__prev = last_user;
+
+    last_user->__next = client->__users;
+    client->__users = first_user;
+
+    guac_rwlock_release_lock(&(client->__users_lock));
+
+}
+
+/**
+ * Removes all full users that fell too far behind to receive broadcast data
+ * from the list of full users, returning those users as a separate list. If
+ * the client cannot resynchronize users (it has no resync_handler), such
+ * users are instead signalled to stop and left in place. The list of full
+ * users must already be locked for writing.
+ *
+ * @param client
+ *     The client whose users should be checked.
+ *
+ * @return
+ *     The first user in the list of removed users, or NULL if no users were
+ *     removed.
+ */
+static guac_user* guac_client_remove_lagging_users(guac_client* client) {
+
+    guac_user* lagging_users = NULL;
+
+    guac_user* user = client->__users;
+    while (user != NULL) {
+
+        guac_user* next = user->__next;
+
+        if (guac_socket_broadcast_queue_begin_resync(user)) {
+
+            if (client->resync_handler == NULL) {
+                guac_user_log(user, GUAC_LOG_WARNING, "User cannot be "
+                        "resynchronized and will be disconnected.");
+                guac_user_stop(user);
+                user = next;
+                continue;
+            }
+
+            /* Remove from list of full users */
+            if (user->__prev != NULL)
+                user->__prev->__next = user->__next;
+            else
+                client->__users = user->__next;
+
+            if (user->__next != NULL)
+                user->__next->__prev = user->__prev;
+
+            /* Add to list of lagging users */
+            user->__prev = NULL;
+            user->__next = lagging_users;
+
+            if (lagging_users != NULL)
+                lagging_users->__prev = user;
+
+            lagging_users = user;
+
+            guac_user_log(user, GUAC_LOG_DEBUG, "Resynchronizing user.");
+
+        }
+
+        user = next;
+
+    }
+
+    return lagging_users;
+
+}
+
+/**
+ * Resynchronizes all full users that fell too far behind to receive broadcast
+ * data, invoking the resync handler with the pending user socket temporarily
+ * directed at only those users. The users remain full users throughout; the
+ * join pending handler is NOT invoked for them, as they have already joined.
+ * The list of pending users must already be locked for writing.
+ *
+ * @param client
+ *     The client whose lagging users should be resynchronized.
+ */
+static void guac_client_resync_lagging_users(guac_client* client) {
+
+    guac_rwlock_acquire_write_lock(&(client->__users_lock));
+    guac_user* lagging_users = guac_client_remove_lagging_users(client);
+    guac_rwlock_release_lock(&(client->__users_lock));
+
+    if (lagging_users == NULL)
+        return;
+
+    /* Direct the pending user socket at only the lagging users (no user can
+     * be added to or removed from the pending list meanwhile, as that list is
+     * locked for writing) */
+    guac_user* pending_users = client->__pending_users;
+    client->__pending_users = lagging_users;
+
+    if (client->resync_handler(client)) {
+
+        guac_client_log(client, GUAC_LOG_WARNING, "resync_handler did not "
+                "successfully complete; any users that fell behind will be "
+                "disconnected.");
+
+        for (guac_user* user = lagging_users; user != NULL; user = user->__next)
+            guac_user_stop(user);
+
+    }
+
+    /* Hand off everything written for the lagging users before the pending
+     * user socket is again directed at the actual pending users */
+    guac_socket_flush(client->pending_socket);
+
+    client->__pending_users = pending_users;
+    guac_client_add_full_users(client, lagging_users);
+
+}
+
 /**
  * Promote all pending users to full users, calling the join pending handler
- * before, if any.
+ * before, if any. Any full users that fell too far behind to receive
+ * broadcast data are first resynchronized using the resync handler.
  *
  * @param client
  *     The client for which all pending users should be promoted.
@@ -167,6 +313,9 @@ static void guac_client_promote_pending_users(guac_client* client) {
     /* Acquire the lock for reading and modifying the list of pending users */
     guac_rwlock_acquire_write_lock(&(client->__pending_users_lock));
 
+    /* Resynchronize any users that have fallen behind */
+    guac_client_resync_lagging_users(client);
+
     /* Skip user promotion entirely if there's no pending users */
     if (client->__pending_users == NULL)
         goto promotion_complete;
@@ -186,38 +335,11 @@ static void guac_client_promote_pending_users(guac_client* client) {
         }
     }
 
-    /* The first pending user in the list, if any */
+    /* Promote all formerly-pending users, marking the pending list as
+     * empty */
     guac_user* first_user = client->__pending_users;
-
-    /* The final user in the list, if any */
-    guac_user* last_user = first_user;
-
-    /* Iterate through the pending users to find the final user */
-    guac_user* user = first_user;
-    while (user != NULL) {
-        last_user = user;
-        user = user->__next;
-    }
-
-    /* Mark the list as empty */
     client->__pending_users = NULL;
-
-    /* Acquire the lock for reading and modifying the list of full users. */
-    guac_rwlock_acquire_write_lock(&(client->__users_lock));
-
-    /* If any users were removed from the pending list, promote them now */
-    if (last_user != NULL) {
-
-        /* Add all formerly-pending users to the start of the user list */
-        if (client->__users != NULL)
-            client->__users->__prev = last_user;
-
-        last_user->__next = client->__users;
-        client->__users = first_user;
-
-    }
-
-    guac_rwlock_release_lock(&(client->__users_lock));
+    guac_client_add_full_users(client, first_user);
 
 promotion_complete:
 
@@ -472,6 +594,10 @@ int guac_client_add_user(guac_client* client, guac_user* user, int argc, char**
 
     if (retval == 0) {
 
+        /* Start delivery of broadcast data to the user (this must be ready
+         * before the user can be added to any list of users) */
+        guac_socket_broadcast_queue_alloc(user);
+
         /*
          * Add the user to the list of pending users, to have their connection
          * state synchronized asynchronously.
@@ -518,6 +644,13 @@ void guac_client_remove_user(guac_client* client, guac_user* user) {
     guac_rwlock_release_lock(&(client->__users_lock));
     guac_rwlock_release_lock(&(client->__pending_users_lock));
 
+    /* Stop delivery of broadcast data now that the user can no longer
+     * receive any. The writer thread is NOT waited for here, as this function
+     * may be invoked while the user lists are locked (by guac_client_free()),
+     * and a stalled user must not block other users. The queue is freed by
+     * the thread handling the user's connection. */
+    guac_socket_broadcast_queue_stop(user);
+
     /* Update owner of user having left the connection. */
     if (!user->owner)
         guac_client_owner_notify_leave(client, user);
@@ -0,0 +1,464 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+#include "guacamole/client.h"
+#include "guacamole/display.h"
+#include "guacamole/mem.h"
+#include "guacamole/protocol.h"
+#include "guacamole/rect.h"
+#include "guacamole/rwlock.h"
+#include "guacamole/socket.h"
+
+#include <cairo/cairo.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * The number of bytes in each row of a tile stored within the cache.
+ */
+#define GUAC_DISPLAY_CACHE_TILE_STRIDE \
+    (GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_LAYER_RAW_BPP)
+
+/**
+ * The number of bytes of image data within each tile stored within the cache.
+ */
+#define GUAC_DISPLAY_CACHE_TILE_SIZE \
+    (GUAC_DISPLAY_CACHE_TILE_STRIDE * GUAC_DISPLAY_CELL_SIZE)
+
+/**
+ * Returns the index of the hash bucket that should contain the tile having the
+ * given hash.
+ *
+ * @param hash
+ *     The hash of the tile, as calculated by
+ *     PFR_guac_display_plan_index_dirty_cells().
+ *
+ * @return
+ *     The index of the hash bucket that should contain the tile.
+ */
+static unsigned int guac_display_cache_bucket(uint64_t hash) {
+    return (hash ^ (hash >> 21) ^ (hash >> 42)) & (GUAC_DISPLAY_CACHE_BUCKETS - 1);
+}
+
+/**
+ * Removes the given entry from the least-recently-used list of the given
+ * cache. The entry is NOT removed from its hash bucket.
+ *
+ * @param cache
+ *     The cache containing the entry.
+ *
+ * @param entry
+ *     The entry to remove from the least-recently-used list.
+ */
+static void guac_display_cache_unlink(guac_display_cache* cache,
+        guac_display_cache_entry* entry) {
+
+    if (entry->more_recent != NULL)
+        entry->more_recent->less_recent = entry->less_recent;
+    else
+        cache->most_recent = entry->less_recent;
+
+    if (entry->less_recent != NULL)
+        entry->less_recent->more_recent = entry->more_recent;
+    else
+        cache->least_recent = entry->more_recent;
+
+    entry->more_recent = entry->less_recent = NULL;
+
+}
+
+/**
+ * Inserts the given entry at the head of the least-recently-used list of the
+ * given cache, such that it is the most recently used entry.
+ *
+ * @param cache
+ *     The cache containing the entry.
+ *
+ * @param entry
+ *     The entry to mark as most recently used.
+ */
+static void guac_display_cache_touch(guac_display_cache* cache,
+        guac_display_cache_entry* entry) {
+
+    entry->more_recent = NULL;
+    entry->less_recent = cache->most_recent;
+
+    if (cache->most_recent != NULL)
+        cache->most_recent->more_recent = entry;
+    else
+        cache->least_recent = entry;
+
+    cache->most_recent = entry;
+
+}
+
+/**
+ * Removes the given entry from its hash bucket within the given cache. The
+ * entry is NOT removed from the least-recently-used list.
+ *
+ * @param cache
+ *     The cache containing the entry.
+ *
+ * @param entry
+ *     The entry to remove from its hash bucket.
+ */
+static void guac_display_cache_remove_from_bucket(guac_display_cache* cache,
+        guac_display_cache_entry* entry) {
+
+    guac_display_cache_entry** current =
+        &cache->buckets[guac_display_cache_bucket(entry->hash)];
+
+    while (*current != entry)
+        current = &(*current)->next_in_bucket;
+
+    *current = entry->next_in_bucket;
+    entry->next_in_bucket = NULL;
+
+}
+
+/**
+ * Allocates the entries of the given cache, as well as the client-side buffer
+ * that will contain the cached tiles, if not already allocated.
+ *
+ * @param display
+ *     The display that owns the cache.
+ */
+static void LFW_guac_display_cache_init(guac_display* display) {
+
+    guac_display_cache* cache = &display->cache;
+    if (cache->entries != NULL)
+        return;
+
+    cache->capacity = cache->max_size / GUAC_DISPLAY_CACHE_TILE_SIZE;
+    cache->entries = guac_mem_zalloc(cache->capacity, sizeof(guac_display_cache_entry));
+    cache->data = guac_mem_alloc(cache->capacity, GUAC_DISPLAY_CACHE_TILE_SIZE);
+    cache->pending_stores = guac_mem_alloc(cache->capacity, sizeof(guac_display_cache_entry*));
+
+    /* Assign each entry a fixed location within the client-side buffer */
+    for (int i = 0; i < cache->capacity; i++) {
+        guac_display_cache_entry* entry = &cache->entries[i];
+        entry->data = cache->data + (size_t) i * GUAC_DISPLAY_CACHE_TILE_SIZE;
+        guac_rect_init(&entry->rect,
+                (i % GUAC_DISPLAY_CACHE_COLUMNS) * GUAC_DISPLAY_CELL_SIZE,
+                (i / GUAC_DISPLAY_CACHE_COLUMNS) * GUAC_DISPLAY_CELL_SIZE,
+                GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE);
+    }
+
+    /* Allocate client-side buffer large enough for all tiles */
+    guac_client* client = display->client;
+    int rows = (cache->capacity + GUAC_DISPLAY_CACHE_COLUMNS - 1) / GUAC_DISPLAY_CACHE_COLUMNS;
+    cache->buffer = guac_client_alloc_buffer(client);
+    guac_protocol_send_size(client->socket, cache->buffer,
+            GUAC_DISPLAY_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE,
+            rows * GUAC_DISPLAY_CELL_SIZE);
+
+}
+
+/**
+ * Returns the entry within the given cache that contains exactly the given
+ * tile, if any. If found, the entry becomes the most recently used entry in
+ * the cache.
+ *
+ * @param cache
+ *     The cache to search.
+ *
+ * @param hash
+ *     The hash of the tile.
+ *
+ * @param tile
+ *     The first byte of image data of the tile.
+ *
+ * @param stride
+ *     The number of bytes in each row of image data of the tile.
+ *
+ * @return
+ *     The entry containing the given tile, or NULL if no such entry exists.
+ */
+static guac_display_cache_entry* guac_display_cache_get(guac_display_cache* cache,
+        uint64_t hash, const unsigned char* tile, size_t stride) {
+
+    guac_display_cache_entry* entry = cache->buckets[guac_display_cache_bucket(hash)];
+    for (; entry != NULL; entry = entry->next_in_bucket) {
+
+        if (entry->hash != hash)
+            continue;
+
+        /* Verify tile contents row by row, as the hash alone may collide */
+        const unsigned char* expected = entry->data;
+        const unsigned char* actual = tile;
+        int y;
+        for (y = 0; y < GUAC_DISPLAY_CELL_SIZE; y++) {
+
+            if (memcmp(expected, actual, GUAC_DISPLAY_CACHE_TILE_STRIDE))
+                break;
+
+            expected += GUAC_DISPLAY_CACHE_TILE_STRIDE;
+            actual += stride;
+
+        }
+
+        if (y == GUAC_DISPLAY_CELL_SIZE) {
+            guac_display_cache_unlink(cache, entry);
+            guac_display_cache_touch(cache, entry);
+            return entry;
+        }
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Adds the given tile to the given cache, replacing the least recently used
+ * tile if the cache is full. The tile will be copied into the client-side
+ * buffer of the cache from the given layer once the current frame has been
+ * sent.
+ *
+ * @param cache
+ *     The cache to add the tile to.
+ *
+ * @param hash
+ *     The hash of the tile.
+ *
+ * @param tile
+ *     The first byte of image data of the tile.
+ *
+ * @param stride
+ *     The number of bytes in each row of image data of the tile.
+ *
+ * @param layer
+ *     The layer that will contain the tile once the current frame has been
+ *     sent.
+ *
+ * @param rect
+ *     The location of the tile within the given layer.
+ */
+static void guac_display_cache_put(guac_display_cache* cache, uint64_t hash,
+        const unsigned char* tile, size_t stride, guac_display_layer* layer,
+        const guac_rect* rect) {
+
+    guac_display_cache_entry* entry;
+
+    /* Use unused entries first, replacing the least recently used entry only
+     * once all entries are in use */
+    if (cache->length < cache->capacity)
+        entry = &cache->entries[cache->length++];
+    else {
+        entry = cache->least_recent;
+        guac_display_cache_unlink(cache, entry);
+        guac_display_cache_remove_from_bucket(cache, entry);
+    }
+
+    entry->hash = hash;
+
+    unsigned char* data = entry->data;
+    for (int y = 0; y < GUAC_DISPLAY_CELL_SIZE; y++) {
+        memcpy(data, tile, GUAC_DISPLAY_CACHE_TILE_STRIDE);
+        data += GUAC_DISPLAY_CACHE_TILE_STRIDE;
+        tile += stride;
+    }
+
+    /* Schedule copy into client-side buffer (replacing any store that was
+     * already scheduled for a previous tile in the same entry) */
+    if (entry->store_from == NULL)
+        cache->pending_stores[cache->pending_store_count++] = entry;
+
+    entry->store_from = layer;
+    entry->store_rect = *rect;
+
+    entry->next_in_bucket = cache->buckets[guac_display_cache_bucket(hash)];
+    cache->buckets[guac_display_cache_bucket(hash)] = entry;
+
+    guac_display_cache_touch(cache, entry);
+
+}
+
+void PFR_LFW_guac_display_plan_rewrite_from_cache(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+    guac_display_cache* cache = &display->cache;
+
+    /* Caching is disabled if not even one tile fits within the budget */
+    if (cache->max_size < GUAC_DISPLAY_CACHE_TILE_SIZE)
+        return;
+
+    for (int i = 0; i < plan->length; i++) {
+
+        /* Only full cells that still need to be drawn are cached */
+        guac_display_plan_indexed_operation* indexed = &plan->indexed_ops[i];
+        guac_display_plan_operation* op = indexed->op;
+        if (op == NULL || indexed->level != 0
+                || op->type != GUAC_DISPLAY_PLAN_OPERATION_IMG)
+            continue;
+
+        /* Tiles cannot be reliably copied to or from layers that have an
+         * alpha channel, as copies are composited over existing contents */
+        guac_display_layer* layer = op->layer;
+        if (!layer->opaque)
+            continue;
+
+        LFW_guac_display_cache_init(display);
+
+        const unsigned char* tile = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(layer->pending_frame, indexed->block);
+        size_t stride = layer->pending_frame.buffer_stride;
+
+        /* Replace draw with copy from cache if the tile is already present
+         * within the client-side buffer */
+        guac_display_cache_entry* entry = guac_display_cache_get(cache, indexed->hash, tile, stride);
+        if (entry != NULL) {
+
+            /* Tiles added during this frame are not yet available */
+            if (entry->store_from != NULL)
+                continue;
+
+            op->type = GUAC_DISPLAY_PLAN_OPERATION_COPY;
+            op->src.layer_rect.layer = cache->buffer;
+            op->src.layer_rect.rect = entry->rect;
+            op->dest = indexed->block;
+
+            cache->hits++;
+
+        }
+
+        /* Otherwise, cache the tile for future frames */
+        else {
+            guac_display_cache_put(cache, indexed->hash, tile, stride,
+                    layer, &indexed->block);
+            cache->misses++;
+        }
+
+    }
+
+}
+
+void LFR_guac_display_cache_commit(guac_display* display) {
+
+    guac_display_cache* cache = &display->cache;
+    guac_socket* socket = display->client->socket;
+
+    for (int i = 0; i < cache->pending_store_count; i++) {
+
+        guac_display_cache_entry* entry = cache->pending_stores[i];
+        const guac_rect* src = &entry->store_rect;
+
+        guac_protocol_send_copy(socket, entry->store_from->layer,
+                src->left, src->top, guac_rect_width(src), guac_rect_height(src),
+                GUAC_COMP_OVER, cache->buffer, entry->rect.left, entry->rect.top);
+
+        entry->store_from = NULL;
+
+    }
+
+    cache->pending_store_count = 0;
+
+}
+
+void LFR_guac_display_cache_dup(guac_display* display, guac_socket* socket) {
+
+    guac_display_cache* cache = &display->cache;
+    if (cache->buffer == NULL)
+        return;
+
+    int width = GUAC_DISPLAY_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE;
+    int rows = (cache->capacity + GUAC_DISPLAY_CACHE_COLUMNS - 1) / GUAC_DISPLAY_CACHE_COLUMNS;
+    guac_protocol_send_size(socket, cache->buffer, width, rows * GUAC_DISPLAY_CELL_SIZE);
+
+    if (cache->length == 0)
+        return;
+
+    /* Lay out all tiles in use exactly as they are laid out within the
+     * client-side buffer, such that a single image restores the buffer */
+    int used_rows = (cache->length + GUAC_DISPLAY_CACHE_COLUMNS - 1) / GUAC_DISPLAY_CACHE_COLUMNS;
+    int height = used_rows * GUAC_DISPLAY_CELL_SIZE;
+    size_t stride = (size_t) width * GUAC_DISPLAY_LAYER_RAW_BPP;
+    unsigned char* image = guac_mem_zalloc(stride, height);
+
+    for (int i = 0; i < cache->length; i++) {
+
+        /* Tiles not yet stored client-side are included as well, as the
+         * receiving socket may not receive the copies that store those tiles
+         * within LFR_guac_display_cache_commit() (storing the same tile
+         * twice is harmless) */
+        guac_display_cache_entry* entry = &cache->entries[i];
+
+        unsigned char* dst = image + entry->rect.top * stride
+            + entry->rect.left * GUAC_DISPLAY_LAYER_RAW_BPP;
+        const unsigned char* src = entry->data;
+
+        for (int y = 0; y < GUAC_DISPLAY_CELL_SIZE; y++) {
+            memcpy(dst, src, GUAC_DISPLAY_CACHE_TILE_STRIDE);
+            dst += stride;
+            src += GUAC_DISPLAY_CACHE_TILE_STRIDE;
+        }
+
+    }
+
+    /* Only tiles of opaque layers are cached */
+    cairo_surface_t* surface = cairo_image_surface_create_for_data(image,
+            CAIRO_FORMAT_RGB24, width, height, stride);
+
+    guac_client_stream_png(display->client, socket, GUAC_COMP_SRC,
+            cache->buffer, 0, 0, surface);
+
+    cairo_surface_destroy(surface);
+    guac_mem_free(image);
+
+}
+
+void guac_display_set_cache_size(guac_display* display, size_t size) {
+
+    guac_display_cache* cache = &display->cache;
+
+    if (size > GUAC_DISPLAY_CACHE_MAX_SIZE)
+        size = GUAC_DISPLAY_CACHE_MAX_SIZE;
+
+    guac_rwlock_acquire_write_lock(&display->last_frame.lock);
+
+    /* The budget is fixed once the first tile has been cached */
+    if (cache->entries != NULL)
+        guac_client_log(display->client, GUAC_LOG_WARNING, "The image cache "
+                "is already in use. Its size cannot be changed.");
+    else
+        cache->max_size = size;
+
+    guac_rwlock_release_lock(&display->last_frame.lock);
+
+}
+
+void guac_display_cache_free(guac_display* display) {
+
+    guac_display_cache* cache = &display->cache;
+
+    guac_client_log(display->client, GUAC_LOG_DEBUG, "Image cache statistics: "
+            "%" PRIu64 " hit(s), %" PRIu64 " miss(es), %i of %i tile(s) in "
+            "use.", cache->hits, cache->misses, cache->length,
+            cache->capacity);
+
+    if (cache->buffer != NULL)
+        guac_client_free_buffer(display->client, cache->buffer);
+
+    guac_mem_free(cache->pending_stores);
+    guac_mem_free(cache->entries);
+    guac_mem_free(cache->data);
+
+}
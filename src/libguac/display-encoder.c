@@ -0,0 +1,359 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-encoder.h"
+#include "guacamole/timestamp.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Returns whether the given format is lossless.
+ *
+ * @param format
+ *     The format to check.
+ *
+ * @return
+ *     Non-zero if the given format is lossless, zero otherwise.
+ */
+static int guac_display_encoder_is_lossless(guac_display_encoder_format format) {
+    return format == GUAC_DISPLAY_ENCODER_PNG
+        || format == GUAC_DISPLAY_ENCODER_WEBP_LOSSLESS;
+}
+
+/**
+ * Returns whether the given format may be used for the given request.
+ *
+ * @param request
+ *     The request to check.
+ *
+ * @param format
+ *     The format to check.
+ *
+ * @return
+ *     Non-zero if the given format may be used for the given request, zero
+ *     otherwise.
+ */
+static int guac_display_encoder_is_allowed(const guac_display_encoder_request* request,
+        guac_display_encoder_format format) {
+
+    switch (format) {
+
+        case GUAC_DISPLAY_ENCODER_PNG:
+            return 1;
+
+        case GUAC_DISPLAY_ENCODER_JPEG:
+            return request->jpeg_allowed && !request->lossless;
+
+        case GUAC_DISPLAY_ENCODER_WEBP:
+            return request->webp_allowed && !request->lossless;
+
+        case GUAC_DISPLAY_ENCODER_WEBP_LOSSLESS:
+            return request->webp_allowed;
+
+        default:
+            return 0;
+
+    }
+
+}
+
+/**
+ * Updates the given running average with the given sample.
+ *
+ * @param average
+ *     The running average to update.
+ *
+ * @param sample
+ *     The new sample.
+ *
+ * @param samples
+ *     The number of samples that have previously contributed to the running
+ *     average.
+ */
+static void guac_display_encoder_average(double* average, double sample,
+        unsigned int samples) {
+
+    if (samples == 0)
+        *average = sample;
+    else
+        *average = (*average * GUAC_DISPLAY_ENCODER_SMOOTHING + sample)
+                 / (GUAC_DISPLAY_ENCODER_SMOOTHING + 1);
+
+}
+
+/**
+ * Estimates the time required to encode and transfer an update using the
+ * given measured costs.
+ *
+ * @param policy
+ *     The policy providing the current bandwidth estimate.
+ *
+ * @param cost
+ *     The measured costs of the format being considered.
+ *
+ * @param format
+ *     The format being considered.
+ *
+ * @param quality
+ *     The lossy quality being considered.
+ *
+ * @param pixels
+ *     The number of pixels in the update.
+ *
+ * @return
+ *     The estimated time required to encode and transfer the update, in
+ *     milliseconds.
+ */
+static double guac_display_encoder_estimate(const guac_display_encoder_policy* policy,
+        const guac_display_encoder_cost* cost, guac_display_encoder_format format,
+        int quality, int pixels) {
+
+    double bytes = cost->bytes_per_pixel * pixels;
+    if (!guac_display_encoder_is_lossless(format))
+        bytes *= guac_display_encoder_quality_factor(quality);
+
+    return cost->usec_per_pixel * pixels / 1000.0 + bytes / policy->bandwidth;
+
+}
+
+void guac_display_encoder_policy_init(guac_display_encoder_policy* policy) {
+    memset(policy, 0, sizeof(guac_display_encoder_policy));
+    pthread_mutex_init(&policy->lock, NULL);
+}
+
+void guac_display_encoder_policy_destroy(guac_display_encoder_policy* policy) {
+    pthread_mutex_destroy(&policy->lock);
+}
+
+double guac_display_encoder_quality_factor(int quality) {
+
+    /* Lossy encoders discard increasingly more detail as quality decreases,
+     * with the size of the encoded image falling roughly quadratically down
+     * to the fixed overhead of the format */
+    double relative_quality = quality / 100.0;
+    return 0.25 + 0.75 * relative_quality * relative_quality;
+
+}
+
+void guac_display_encoder_choose(guac_display_encoder_policy* policy,
+        const guac_display_encoder_request* request,
+        guac_display_encoder_choice* choice) {
+
+    pthread_mutex_lock(&policy->lock);
+
+    const guac_display_encoder_cost* costs = policy->costs[request->content];
+
+    /* Follow static heuristics unless there's reason to do otherwise */
+    choice->format = request->static_format;
+    choice->quality = request->static_quality;
+    choice->latency = -1;
+
+    /* Periodically use the least-measured format so that formats which would
+     * otherwise never be chosen continue to be measured */
+    if (++policy->decisions % GUAC_DISPLAY_ENCODER_EXPLORE_INTERVAL == 0) {
+
+        for (int format = 0; format < GUAC_DISPLAY_ENCODER_FORMATS; format++) {
+            if (guac_display_encoder_is_allowed(request, format)
+                    && costs[format].samples < costs[choice->format].samples)
+                choice->format = format;
+        }
+
+        goto done;
+
+    }
+
+    /* Nothing can be estimated without knowing the available bandwidth */
+    if (policy->bandwidth <= 0)
+        goto done;
+
+    /* Allow each update to take as long as the time until the region is
+     * expected to change again */
+    int framerate = request->framerate;
+    if (framerate > GUAC_DISPLAY_ENCODER_MAX_FRAMERATE)
+        framerate = GUAC_DISPLAY_ENCODER_MAX_FRAMERATE;
+    else if (framerate < 1)
+        framerate = 1;
+
+    double budget = 1000.0 / framerate;
+
+    int best_quality = -1;
+    double best_latency = 0;
+
+    for (int format = 0; format < GUAC_DISPLAY_ENCODER_FORMATS; format++) {
+
+        const guac_display_encoder_cost* cost = &costs[format];
+        if (!guac_display_encoder_is_allowed(request, format)
+                || cost->samples < GUAC_DISPLAY_ENCODER_MIN_SAMPLES)
+            continue;
+
+        /* Lossless formats are considered only at full quality, while lossy
+         * formats are considered at each quality level */
+        int lossless = guac_display_encoder_is_lossless(format);
+        int quality = lossless ? 100 : GUAC_DISPLAY_ENCODER_MAX_QUALITY;
+
+        for (; quality >= GUAC_DISPLAY_ENCODER_MIN_QUALITY;
+                quality -= GUAC_DISPLAY_ENCODER_QUALITY_STEP) {
+
+            double latency = guac_display_encoder_estimate(policy, cost,
+                    format, quality, request->pixels);
+
+            /* Within budget, prefer higher quality and then lower latency.
+             * If nothing fits the budget, prefer lower latency. */
+            int better;
+            if (best_quality < 0)
+                better = 1;
+            else if (latency <= budget)
+                better = best_latency > budget || quality > best_quality
+                    || (quality == best_quality && latency < best_latency);
+            else
+                better = best_latency > budget && latency < best_latency;
+
+            if (better) {
+                choice->format = format;
+                choice->quality = lossless ? request->static_quality : quality;
+                choice->latency = latency;
+                best_quality = quality;
+                best_latency = latency;
+            }
+
+            if (lossless)
+                break;
+
+        }
+
+    }
+
+done:
+    policy->chosen[choice->format]++;
+    pthread_mutex_unlock(&policy->lock);
+
+}
+
+void guac_display_encoder_record(guac_display_encoder_policy* policy,
+        guac_display_encoder_content content, guac_display_encoder_format format,
+        int quality, int pixels, int bytes, uint64_t usec) {
+
+    if (pixels <= 0 || bytes < 0)
+        return;
+
+    double bytes_per_pixel = (double) bytes / pixels;
+    if (!guac_display_encoder_is_lossless(format))
+        bytes_per_pixel /= guac_display_encoder_quality_factor(quality);
+
+    double usec_per_pixel = (double) usec / pixels;
+
+    pthread_mutex_lock(&policy->lock);
+
+    guac_display_encoder_cost* cost = &policy->costs[content][format];
+    guac_display_encoder_average(&cost->bytes_per_pixel, bytes_per_pixel, cost->samples);
+    guac_display_encoder_average(&cost->usec_per_pixel, usec_per_pixel, cost->samples);
+
+    if (cost->samples < UINT_MAX)
+        cost->samples++;
+
+    policy->frame_bytes += bytes;
+
+    pthread_mutex_unlock(&policy->lock);
+
+}
+
+void guac_display_encoder_end_frame(guac_display_encoder_policy* policy,
+        guac_timestamp timestamp) {
+
+    pthread_mutex_lock(&policy->lock);
+
+    guac_display_encoder_frame* frame = &policy->frames[policy->next_frame];
+    frame->timestamp = timestamp;
+    frame->bytes = policy->frame_bytes;
+
+    policy->next_frame = (policy->next_frame + 1) % GUAC_DISPLAY_ENCODER_FRAME_HISTORY;
+    policy->frame_bytes = 0;
+
+    pthread_mutex_unlock(&policy->lock);
+
+}
+
+void guac_display_encoder_ack_frame(guac_display_encoder_policy* policy,
+        guac_timestamp timestamp, int rtt) {
+
+    if (rtt <= 0)
+        return;
+
+    pthread_mutex_lock(&policy->lock);
+
+    for (int i = 0; i < GUAC_DISPLAY_ENCODER_FRAME_HISTORY; i++) {
+
+        guac_display_encoder_frame* frame = &policy->frames[i];
+        if (frame->timestamp != timestamp || frame->bytes < 0)
+            continue;
+
+        /* The quickest round trip observed approximates the latency of the
+         * network itself, with any additional time spent transferring data.
+         * That observation is periodically discarded, such that the estimate
+         * follows changes in the latency of the network. */
+        if (policy->min_rtt == 0 || rtt < policy->min_rtt
+                || timestamp - policy->min_rtt_timestamp
+                    > GUAC_DISPLAY_ENCODER_MIN_RTT_LIFETIME) {
+            policy->min_rtt = rtt;
+            policy->min_rtt_timestamp = timestamp;
+        }
+
+        if (frame->bytes > 0) {
+
+            int transfer = rtt - policy->min_rtt;
+
+            /* If the time spent transferring the frame cannot be reliably
+             * distinguished from the latency of the network, the bandwidth
+             * can only be said to be at least enough to have transferred the
+             * frame within the full round trip. The estimate is raised to
+             * that bound immediately, but otherwise only decays toward it
+             * (and only for frames large enough to have taken measurable
+             * time at the current estimate), such that an estimate that is
+             * no longer accurate eventually falls. */
+            if (transfer < rtt / 4) {
+
+                double bandwidth = (double) frame->bytes / rtt;
+
+                if (bandwidth > policy->bandwidth)
+                    policy->bandwidth = bandwidth;
+                else if (frame->bytes >= policy->bandwidth)
+                    guac_display_encoder_average(&policy->bandwidth, bandwidth, 1);
+
+            }
+
+            /* Otherwise, the bandwidth can be measured directly */
+            else
+                guac_display_encoder_average(&policy->bandwidth,
+                        (double) frame->bytes / transfer,
+                        policy->bandwidth > 0);
+
+        }
+
+        /* Each frame is acknowledged only once */
+        frame->bytes = -1;
+        break;
+
+    }
+
+    pthread_mutex_unlock(&policy->lock);
+
+}
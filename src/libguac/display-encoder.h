@@ -0,0 +1,440 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_DISPLAY_ENCODER_H
+#define GUAC_DISPLAY_ENCODER_H
+
+#include "guacamole/timestamp.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * The number of measurements of a particular image format that must be
+ * recorded before the measured costs of that format are trusted. Until then,
+ * the static choice provided with each request is used.
+ */
+#define GUAC_DISPLAY_ENCODER_MIN_SAMPLES 4
+
+/**
+ * The number of decisions between each decision that deliberately uses the
+ * least-measured format, such that the measured costs of formats that would
+ * otherwise never be chosen continue to be updated.
+ */
+#define GUAC_DISPLAY_ENCODER_EXPLORE_INTERVAL 64
+
+/**
+ * The weight of the existing value of any running average, relative to a new
+ * sample having a weight of 1.
+ */
+#define GUAC_DISPLAY_ENCODER_SMOOTHING 7
+
+/**
+ * The highest quality that will be chosen for lossy formats.
+ */
+#define GUAC_DISPLAY_ENCODER_MAX_QUALITY 90
+
+/**
+ * The lowest quality that will be chosen for lossy formats.
+ */
+#define GUAC_DISPLAY_ENCODER_MIN_QUALITY 30
+
+/**
+ * The difference between each lossy quality level considered.
+ */
+#define GUAC_DISPLAY_ENCODER_QUALITY_STEP 15
+
+/**
+ * The highest framerate considered when determining the amount of time
+ * available to deliver each update. Updates to regions changing faster than
+ * this are given the same time budget as updates at this framerate.
+ */
+#define GUAC_DISPLAY_ENCODER_MAX_FRAMERATE 60
+
+/**
+ * The number of recently-sent frames whose sizes are retained for the sake of
+ * estimating bandwidth once those frames are acknowledged.
+ */
+#define GUAC_DISPLAY_ENCODER_FRAME_HISTORY 16
+
+/**
+ * The number of milliseconds that the smallest observed round-trip time is
+ * retained as the latency of the network before being replaced by the next
+ * observed round-trip time, regardless of whether that round trip is larger.
+ */
+#define GUAC_DISPLAY_ENCODER_MIN_RTT_LIFETIME 10000
+
+/**
+ * An image format that may be chosen by guac_display_encoder_choose().
+ */
+typedef enum guac_display_encoder_format {
+
+    /**
+     * Lossless PNG.
+     */
+    GUAC_DISPLAY_ENCODER_PNG,
+
+    /**
+     * Lossy JPEG.
+     */
+    GUAC_DISPLAY_ENCODER_JPEG,
+
+    /**
+     * Lossy WebP.
+     */
+    GUAC_DISPLAY_ENCODER_WEBP,
+
+    /**
+     * Lossless WebP.
+     */
+    GUAC_DISPLAY_ENCODER_WEBP_LOSSLESS,
+
+    /**
+     * The number of image formats. This is not itself a valid format.
+     */
+    GUAC_DISPLAY_ENCODER_FORMATS
+
+} guac_display_encoder_format;
+
+/**
+ * The broad category of image content being encoded. Costs are tracked
+ * separately for each category, as the relative performance of lossless and
+ * lossy formats depends heavily on content.
+ */
+typedef enum guac_display_encoder_content {
+
+    /**
+     * Content with many repeated pixels, such as text and user interface
+     * elements, which lossless compression handles well.
+     */
+    GUAC_DISPLAY_ENCODER_CONTENT_SIMPLE,
+
+    /**
+     * Content with few repeated pixels, such as photos and video.
+     */
+    GUAC_DISPLAY_ENCODER_CONTENT_COMPLEX,
+
+    /**
+     * The number of content categories. This is not itself a valid category.
+     */
+    GUAC_DISPLAY_ENCODER_CONTENTS
+
+} guac_display_encoder_content;
+
+/**
+ * The measured cost of encoding and sending a particular category of content
+ * using a particular image format.
+ */
+typedef struct guac_display_encoder_cost {
+
+    /**
+     * The average number of bytes of encoded data per pixel. For lossy
+     * formats, this value is normalized to a quality of 100 using
+     * guac_display_encoder_quality_factor().
+     */
+    double bytes_per_pixel;
+
+    /**
+     * The average number of microseconds spent encoding each pixel.
+     */
+    double usec_per_pixel;
+
+    /**
+     * The number of measurements that have contributed to the averages
+     * above.
+     */
+    unsigned int samples;
+
+} guac_display_encoder_cost;
+
+/**
+ * A description of an image update for which a format must be chosen.
+ */
+typedef struct guac_display_encoder_request {
+
+    /**
+     * The number of pixels in the update.
+     */
+    int pixels;
+
+    /**
+     * The category of content within the update.
+     */
+    guac_display_encoder_content content;
+
+    /**
+     * The rate that the region covered by the update has historically been
+     * updated, in frames per second.
+     */
+    int framerate;
+
+    /**
+     * Non-zero if the update must be encoded losslessly, zero otherwise.
+     */
+    int lossless;
+
+    /**
+     * Non-zero if JPEG may be used for the update, zero otherwise. JPEG cannot
+     * represent alpha transparency.
+     */
+    int jpeg_allowed;
+
+    /**
+     * Non-zero if WebP (lossy or lossless) may be used for the update, zero
+     * otherwise.
+     */
+    int webp_allowed;
+
+    /**
+     * The format chosen for the update by static heuristics, used until
+     * enough measurements have been recorded to do better.
+     */
+    guac_display_encoder_format static_format;
+
+    /**
+     * The lossy quality chosen for the update by static heuristics.
+     */
+    int static_quality;
+
+} guac_display_encoder_request;
+
+/**
+ * The format and quality chosen for an image update.
+ */
+typedef struct guac_display_encoder_choice {
+
+    /**
+     * The chosen image format.
+     */
+    guac_display_encoder_format format;
+
+    /**
+     * The chosen quality, between 0 and 100 inclusive. For lossy formats,
+     * this is the image quality. For lossless WebP, this is the compression
+     * effort.
+     */
+    int quality;
+
+    /**
+     * The estimated time required to encode and transfer the update, in
+     * milliseconds, or a negative value if no estimate was possible (static
+     * heuristics or exploration were used).
+     */
+    double latency;
+
+} guac_display_encoder_choice;
+
+/**
+ * The size of a frame that has been sent but possibly not yet acknowledged.
+ */
+typedef struct guac_display_encoder_frame {
+
+    /**
+     * The timestamp of the frame, as sent within its "sync" instruction.
+     */
+    guac_timestamp timestamp;
+
+    /**
+     * The total number of bytes of image data sent for the frame.
+     */
+    int bytes;
+
+} guac_display_encoder_frame;
+
+/**
+ * Feedback-driven policy for choosing the image format and quality of each
+ * update. The policy tracks the measured size and encoding time of each
+ * format, along with the bandwidth and round-trip time observed through
+ * frame acknowledgements, choosing the highest-quality encoding that can be
+ * delivered within the time available before the region is expected to
+ * change again. If no encoding can be delivered in time, the encoding that
+ * minimizes latency is chosen.
+ *
+ * The policy itself performs no I/O and reads no clocks, such that recorded
+ * measurements can be replayed deterministically.
+ */
+typedef struct guac_display_encoder_policy {
+
+    /**
+     * Lock which guards all other members of this structure.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The measured costs of each format for each category of content.
+     */
+    guac_display_encoder_cost costs[GUAC_DISPLAY_ENCODER_CONTENTS][GUAC_DISPLAY_ENCODER_FORMATS];
+
+    /**
+     * The estimated bandwidth available, in bytes per millisecond, or zero if
+     * no estimate is yet available.
+     */
+    double bandwidth;
+
+    /**
+     * The smallest round-trip time observed for any frame, in milliseconds,
+     * or zero if no frame has yet been acknowledged. This is taken as the
+     * latency of the network excluding the time spent transferring data.
+     */
+    int min_rtt;
+
+    /**
+     * The timestamp of the frame whose round trip was most recently taken as
+     * min_rtt. Once GUAC_DISPLAY_ENCODER_MIN_RTT_LIFETIME milliseconds have
+     * passed since that frame, min_rtt is replaced.
+     */
+    guac_timestamp min_rtt_timestamp;
+
+    /**
+     * The number of bytes of image data sent thus far for the current frame.
+     */
+    int frame_bytes;
+
+    /**
+     * Recently-sent frames, as a ring buffer.
+     */
+    guac_display_encoder_frame frames[GUAC_DISPLAY_ENCODER_FRAME_HISTORY];
+
+    /**
+     * The index within frames that will receive the next frame sent.
+     */
+    int next_frame;
+
+    /**
+     * The total number of decisions made.
+     */
+    uint64_t decisions;
+
+    /**
+     * The number of times each format has been chosen.
+     */
+    uint64_t chosen[GUAC_DISPLAY_ENCODER_FORMATS];
+
+} guac_display_encoder_policy;
+
+/**
+ * Initializes the given policy, which has no measurements and thus initially
+ * follows the static choice of each request. The policy must eventually be
+ * destroyed with guac_display_encoder_policy_destroy().
+ *
+ * @param policy
+ *     The policy to initialize.
+ */
+void guac_display_encoder_policy_init(guac_display_encoder_policy* policy);
+
+/**
+ * Releases all resources associated with the given policy.
+ *
+ * @param policy
+ *     The policy to destroy.
+ */
+void guac_display_encoder_policy_destroy(guac_display_encoder_policy* policy);
+
+/**
+ * Returns the approximate size of a lossy image encoded at the given quality,
+ * relative to the size of the same image encoded at a quality of 100.
+ *
+ * @param quality
+ *     The lossy quality, between 0 and 100 inclusive.
+ *
+ * @return
+ *     The approximate relative size of an image encoded at the given quality.
+ */
+double guac_display_encoder_quality_factor(int quality);
+
+/**
+ * Chooses the format and quality that should be used to encode the given
+ * update.
+ *
+ * @param policy
+ *     The policy to consult.
+ *
+ * @param request
+ *     The update requiring a format.
+ *
+ * @param choice
+ *     The structure to populate with the chosen format and quality.
+ */
+void guac_display_encoder_choose(guac_display_encoder_policy* policy,
+        const guac_display_encoder_request* request,
+        guac_display_encoder_choice* choice);
+
+/**
+ * Records the measured cost of encoding an update with the given format and
+ * quality, additionally counting the encoded size toward the current frame.
+ *
+ * @param policy
+ *     The policy to update.
+ *
+ * @param content
+ *     The category of content that was encoded.
+ *
+ * @param format
+ *     The format used.
+ *
+ * @param quality
+ *     The quality used, if the format was lossy.
+ *
+ * @param pixels
+ *     The number of pixels encoded.
+ *
+ * @param bytes
+ *     The number of bytes of encoded data produced.
+ *
+ * @param usec
+ *     The number of microseconds spent encoding.
+ */
+void guac_display_encoder_record(guac_display_encoder_policy* policy,
+        guac_display_encoder_content content, guac_display_encoder_format format,
+        int quality, int pixels, int bytes, uint64_t usec);
+
+/**
+ * Notes that the current frame has been sent with the given timestamp,
+ * retaining its size until it is acknowledged.
+ *
+ * @param policy
+ *     The policy to update.
+ *
+ * @param timestamp
+ *     The timestamp of the frame, as sent within its "sync" instruction.
+ */
+void guac_display_encoder_end_frame(guac_display_encoder_policy* policy,
+        guac_timestamp timestamp);
+
+/**
+ * Updates the bandwidth estimate of the given policy using the
+ * acknowledgement of a previously-sent frame. Acknowledgements of frames that
+ * are no longer (or were never) retained are ignored.
+ *
+ * @param policy
+ *     The policy to update.
+ *
+ * @param timestamp
+ *     The timestamp of the acknowledged frame.
+ *
+ * @param rtt
+ *     The time between sending the frame and receiving its acknowledgement,
+ *     in milliseconds. This must be the raw round trip of the acknowledged
+ *     frame, including any time spent transferring and processing the frame,
+ *     not a baseline that excludes that time.
+ */
+void guac_display_encoder_ack_frame(guac_display_encoder_policy* policy,
+        guac_timestamp timestamp, int rtt);
+
+#endif
@@ -247,6 +247,9 @@ static int PFW_LFW_guac_display_frame_complete(guac_display* display) {
         current->last_frame.search_for_copies = current->pending_frame.search_for_copies;
         current->pending_frame.search_for_copies = 0;
 
+        /* Hints describe only changes relative to the frame just committed */
+        current->pending_frame_hint_count = 0;
+
         /* Commit any change in lossless setting (no need to synchronize this
          * to the client - it affects only how last_frame is interpreted) */
         current->last_frame.lossless = current->pending_frame.lossless;
@@ -332,28 +335,45 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
      * passes. */
     GUAC_DISPLAY_PLAN_BEGIN_PHASE();
     plan = PFW_LFR_guac_display_plan_create(display);
-    GUAC_DISPLAY_PLAN_END_PHASE(display, "draft", 1, 5);
+    GUAC_DISPLAY_PLAN_END_PHASE(display, "draft", 1, 7);
 
     if (plan != NULL) {
 
         display->pending_frame.timestamp = plan->frame_end;
 
-        /* PASS 1: Identify draw operations that only apply a single color, and
+        /* PASS 0: Drop draw operations within any continuously-changing
+         * region of the default layer that is being streamed as video. This
+         * must happen before any other pass considers those operations. */
+        GUAC_DISPLAY_PLAN_BEGIN_PHASE();
+        PFW_guac_display_plan_rewrite_as_video(plan);
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "video", 2, 7);
+
+        /* PASS 1: Replace draw operations with copies or rects wherever the
+         * code drawing to the display has hinted at the nature of the change,
+         * verifying each hint rather than hashing or searching. */
+        GUAC_DISPLAY_PLAN_BEGIN_PHASE();
+        PFR_LFR_guac_display_plan_rewrite_from_hints(plan);
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "hints", 3, 7);
+
+        /* PASS 2: Identify draw operations that only apply a single color, and
          * replace those operations with simple rectangle draws. */
         GUAC_DISPLAY_PLAN_BEGIN_PHASE();
         PFR_guac_display_plan_rewrite_as_rects(plan);
-        GUAC_DISPLAY_PLAN_END_PHASE(display, "rects", 2, 5);
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "rects", 4, 7);
 
-        /* PASS 2 (and 3): Index all modified cells by their graphical contents and
+        /* PASS 3 (and 4): Index all modified cells by their graphical contents and
          * search the previous frame for occurrences of the same content. Where any
          * draws could instead be represented as copies from the previous frame, do
-         * so instead of sending new image data. */
+         * so instead of sending new image data. Any remaining draws of cells that
+         * were sent in some earlier frame are replaced with copies from the image
+         * cache. */
         GUAC_DISPLAY_PLAN_BEGIN_PHASE();
         PFR_guac_display_plan_index_dirty_cells(plan);
         PFR_LFR_guac_display_plan_rewrite_as_copies(plan);
-        GUAC_DISPLAY_PLAN_END_PHASE(display, "search", 3, 5);
+        PFR_LFW_guac_display_plan_rewrite_from_cache(plan);
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "search", 5, 7);
 
-        /* PASS 4 (and 5): Combine adjacent updates in horizontal and vertical
+        /* PASS 5 (and 6): Combine adjacent updates in horizontal and vertical
          * directions where doing so would be more efficient. The goal of these
          * passes is to ensure that graphics can be encoded and decoded
          * efficiently, without defeating the parralelism provided by providing the
@@ -361,7 +381,7 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
         GUAC_DISPLAY_PLAN_BEGIN_PHASE();
         PFW_guac_display_plan_combine_horizontally(plan);
         PFW_guac_display_plan_combine_vertically(plan);
-        GUAC_DISPLAY_PLAN_END_PHASE(display, "combine", 4, 5);
+        GUAC_DISPLAY_PLAN_END_PHASE(display, "combine", 6, 7);
 
     }
 
@@ -376,7 +396,7 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
 
     GUAC_DISPLAY_PLAN_BEGIN_PHASE();
     frame_nonempty = PFW_LFW_guac_display_frame_complete(display);
-    GUAC_DISPLAY_PLAN_END_PHASE(display, "commit", 5, 5);
+    GUAC_DISPLAY_PLAN_END_PHASE(display, "commit", 7, 7);
 
     guac_rwlock_release_lock(&display->last_frame.lock);
 
@@ -398,6 +418,7 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
             .type = GUAC_DISPLAY_PLAN_OPERATION_NOP
         };
         guac_fifo_enqueue(&display->ops, &end_frame_op);
+        guac_display_worker_pool_schedule(display);
     }
 
 finished_with_pending_frame_lock:
@@ -186,6 +186,60 @@ void guac_display_layer_raw_context_put(guac_display_layer_raw_context* context,
 
 }
 
+/**
+ * Records the given hint for the given layer, to be taken into account when
+ * the pending frame is flushed. If the maximum number of hints has already
+ * been recorded for the layer, the hint is ignored.
+ *
+ * @param layer
+ *     The layer that the hint applies to.
+ *
+ * @param hint
+ *     The hint to record.
+ */
+static void guac_display_layer_add_hint(guac_display_layer* layer,
+        const guac_display_layer_hint* hint) {
+
+    /* Hints covering nothing can never apply to anything */
+    if (guac_rect_is_empty(&hint->dest))
+        return;
+
+    guac_display* display = layer->display;
+    guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
+
+    if (layer->pending_frame_hint_count < GUAC_DISPLAY_MAX_HINTS)
+        layer->pending_frame_hints[layer->pending_frame_hint_count++] = *hint;
+
+    guac_rwlock_release_lock(&display->pending_frame.lock);
+
+}
+
+void guac_display_layer_hint_copy(guac_display_layer* layer,
+        const guac_rect* src, int x, int y) {
+
+    guac_display_layer_hint hint = {
+        .type = GUAC_DISPLAY_LAYER_HINT_COPY,
+        .src.rect = *src
+    };
+
+    guac_rect_init(&hint.dest, x, y, guac_rect_width(src), guac_rect_height(src));
+    guac_display_layer_add_hint(layer, &hint);
+
+}
+
+void guac_display_layer_hint_fill(guac_display_layer* layer,
+        const guac_rect* dst, uint32_t color) {
+
+    guac_display_layer_hint hint = {
+        .type = GUAC_DISPLAY_LAYER_HINT_FILL,
+        .dest = *dst,
+        .src.color = color
+    };
+
+    guac_display_layer_add_hint(layer, &hint);
+
+}
+
 guac_display_layer_raw_context* guac_display_layer_open_raw(guac_display_layer* layer) {
 
     guac_display* display = layer->display;
@@ -0,0 +1,208 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+#include "guacamole/display.h"
+#include "guacamole/mem.h"
+#include "guacamole/rect.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Returns whether the given outer rectangle fully contains the given inner
+ * rectangle.
+ *
+ * @param outer
+ *     The rectangle that must contain the inner rectangle.
+ *
+ * @param inner
+ *     The rectangle to test.
+ *
+ * @return
+ *     Non-zero if the inner rectangle lies entirely within the outer
+ *     rectangle, zero otherwise.
+ */
+static int guac_display_plan_rect_contains(const guac_rect* outer,
+        const guac_rect* inner) {
+
+    return inner->left   >= outer->left
+        && inner->top    >= outer->top
+        && inner->right  <= outer->right
+        && inner->bottom <= outer->bottom;
+
+}
+
+/**
+ * Attempts to rewrite the given draw operation as a rect using the given
+ * fill hint, verifying that the region modified by the operation really does
+ * consist only of the hinted color.
+ *
+ * @param op
+ *     The draw operation to rewrite, which must lie entirely within the
+ *     destination rect of the hint.
+ *
+ * @param hint
+ *     The fill hint to apply.
+ *
+ * @return
+ *     Non-zero if the operation was rewritten, zero otherwise.
+ */
+static int PFR_guac_display_plan_apply_fill_hint(guac_display_plan_operation* op,
+        const guac_display_layer_hint* hint) {
+
+    guac_display_layer* layer = op->layer;
+    const guac_display_layer_state* pending = &layer->pending_frame;
+
+    /* The alpha channel of opaque layers is not meaningful */
+    uint32_t mask = layer->opaque ? 0x00FFFFFF : 0xFFFFFFFF;
+    uint32_t color = hint->src.color & mask;
+
+    int width = guac_rect_width(&op->dest);
+    int height = guac_rect_height(&op->dest);
+    const unsigned char* row = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(*pending, op->dest);
+
+    for (int y = 0; y < height; y++) {
+
+        const uint32_t* pixel = (const uint32_t*) row;
+        for (int x = 0; x < width; x++) {
+            if ((*(pixel++) & mask) != color)
+                return 0;
+        }
+
+        row += pending->buffer_stride;
+
+    }
+
+    op->type = GUAC_DISPLAY_PLAN_OPERATION_RECT;
+    op->src.color = layer->opaque ? (color | 0xFF000000) : color;
+    return 1;
+
+}
+
+/**
+ * Attempts to rewrite the given draw operation as a copy from the previous
+ * frame using the given copy hint, verifying that the region modified by the
+ * operation really does match the hinted region of the previous frame.
+ *
+ * @param plan
+ *     The plan containing the operation.
+ *
+ * @param op
+ *     The draw operation to rewrite, which must lie entirely within the
+ *     destination rect of the hint.
+ *
+ * @param hint
+ *     The copy hint to apply.
+ *
+ * @return
+ *     Non-zero if the operation was rewritten, zero otherwise.
+ */
+static int PFR_LFR_guac_display_plan_apply_copy_hint(guac_display_plan* plan,
+        guac_display_plan_operation* op, const guac_display_layer_hint* hint) {
+
+    guac_display_layer* layer = op->layer;
+    const guac_display_layer_state* pending = &layer->pending_frame;
+    const guac_display_layer_state* last = &layer->last_frame;
+
+    /* Locate the region of the previous frame that corresponds to the
+     * operation */
+    guac_rect src = op->dest;
+    int dx = hint->src.rect.left - hint->dest.left;
+    int dy = hint->src.rect.top - hint->dest.top;
+    src.left += dx;
+    src.right += dx;
+    src.top += dy;
+    src.bottom += dy;
+
+    guac_rect last_bounds;
+    guac_rect_init(&last_bounds, 0, 0, last->width, last->height);
+    if (last->buffer == NULL || !guac_display_plan_rect_contains(&last_bounds, &src))
+        return 0;
+
+    /* The client-side contents of any region covered by video are stale
+     * and cannot be copied */
+    if (layer == plan->display->default_layer
+            && guac_rect_intersects(&src, &plan->video_rect))
+        return 0;
+
+    size_t length = guac_mem_ckd_mul_or_die(guac_rect_width(&src), GUAC_DISPLAY_LAYER_RAW_BPP);
+    int height = guac_rect_height(&src);
+
+    const unsigned char* copy_to = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(*pending, op->dest);
+    const unsigned char* copy_from = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(*last, src);
+
+    for (int y = 0; y < height; y++) {
+
+        if (memcmp(copy_to, copy_from, length))
+            return 0;
+
+        copy_to += pending->buffer_stride;
+        copy_from += last->buffer_stride;
+
+    }
+
+    op->type = GUAC_DISPLAY_PLAN_OPERATION_COPY;
+    op->src.layer_rect.layer = layer->last_frame_buffer;
+    op->src.layer_rect.rect = src;
+    return 1;
+
+}
+
+void PFR_LFR_guac_display_plan_rewrite_from_hints(guac_display_plan* plan) {
+
+    guac_display_plan_operation* op = plan->ops;
+    for (int i = 0; i < plan->length; i++, op++) {
+
+        if (op->type != GUAC_DISPLAY_PLAN_OPERATION_IMG)
+            continue;
+
+        /* NOTE: Processing of operations referring to layers whose buffers
+         * have been replaced with NULL is intentionally allowed to ensure
+         * references to external buffers can be safely removed if
+         * necessary, even before guac_display is freed */
+        guac_display_layer* layer = op->layer;
+        if (layer->pending_frame.buffer == NULL)
+            continue;
+
+        /* Later hints take precedence, as they describe the more recent
+         * state of the layer */
+        for (int j = layer->pending_frame_hint_count - 1; j >= 0; j--) {
+
+            const guac_display_layer_hint* hint = &layer->pending_frame_hints[j];
+            if (!guac_display_plan_rect_contains(&hint->dest, &op->dest))
+                continue;
+
+            int applied;
+            if (hint->type == GUAC_DISPLAY_LAYER_HINT_FILL)
+                applied = PFR_guac_display_plan_apply_fill_hint(op, hint);
+            else
+                applied = PFR_LFR_guac_display_plan_apply_copy_hint(plan, op, hint);
+
+            if (applied) {
+                plan->display->hinted_ops++;
+                break;
+            }
+
+        }
+
+    }
+
+}
@@ -28,9 +28,9 @@
 /**
  * Stores the given operation within the ops_by_hash table of the given display
  * plan based on the given hash value. The hash function applied for storing
- * the operation is GUAC_DISPLAY_PLAN_OPERATION_HASH(). If another operation is
- * already stored at the same location within ops_by_hash, that operation will
- * be replaced.
+ * the operation is GUAC_DISPLAY_PLAN_OPERATION_HASH(). Operations whose hashes
+ * map to the same location within ops_by_hash are chained together, such that
+ * no operation is ever dropped from the index due to a collision.
  *
  * @param plan
  *     The plan to store the operation within.
@@ -39,74 +39,51 @@
  *     The hash value to use to calculate the storage location. This value will
  *     be further hashed with GUAC_DISPLAY_PLAN_OPERATION_HASH().
  *
+ * @param level
+ *     The search level of the block that was hashed to produce the given
+ *     hash value.
+ *
+ * @param block
+ *     The block that was hashed to produce the given hash value.
+ *
  * @param op
  *     The operation to store.
  */
 static void guac_display_plan_store_indexed_op(guac_display_plan* plan, uint64_t hash,
-        guac_display_plan_operation* op) {
-
-    size_t index = GUAC_DISPLAY_PLAN_OPERATION_HASH(hash);
-    guac_display_plan_indexed_operation* entry = &(plan->ops_by_hash[index]);
-
-    if (entry->op == NULL) {
-        entry->hash = hash;
-        entry->op = op;
-    }
-
-}
-
-/**
- * Removes and returns a pointer to the matching operation stored within the
- * ops_by_hash table of the given display plan, if any. If no such operation is
- * stored, NULL is returned.
- *
- * @param plan
- *     The plan to retrieve the operation from.
- *
- * @param hash
- *     The hash value to use to calculate the storage location. This value will
- *     be further hashed with GUAC_DISPLAY_PLAN_OPERATION_HASH().
- *
- * @return
- *     The operation that was stored under the given hash, if any, or NULL if
- *     no such operation was found.
- */
-static guac_display_plan_operation* guac_display_plan_remove_indexed_op(guac_display_plan* plan, uint64_t hash) {
+        int level, const guac_rect* block, guac_display_plan_operation* op) {
 
     size_t index = GUAC_DISPLAY_PLAN_OPERATION_HASH(hash);
-    guac_display_plan_indexed_operation* entry = &(plan->ops_by_hash[index]);
+    guac_display_plan_indexed_operation* entry = &(plan->indexed_ops[op - plan->ops]);
 
-    /* NOTE: We verify the hash value here because the lookup performed is
-     * actually a hash of a hash. There's an additional chance of collisions
-     * between hash values at this second level of hashing. */
+    entry->op = op;
+    entry->hash = hash;
+    entry->level = level;
+    entry->block = *block;
 
-    guac_display_plan_operation* op = entry->op;
-    if (op != NULL && entry->hash == hash) {
-        entry->op = NULL;
-        return op;
-    }
+    entry->next = plan->ops_by_hash[index];
+    plan->ops_by_hash[index] = entry;
 
-    return NULL;
+    plan->indexed_count[level]++;
 
 }
 
 /**
- * Callback invoked by guac_hash_foreach_image_rect() for each 64x64 rectangle
- * of image data.
+ * Callback invoked by guac_hash_foreach_image_rect() for each square block of
+ * image data.
  *
  * @param plan
  *     The display plan related to the call to guac_hash_foreach_image_rect().
  *
  * @param x
- *     The X coordinate of the upper-left corner of the current 64x64 rectangle
- *     within the search region.
+ *     The X coordinate of the upper-left corner of the current block within
+ *     the search region.
  *
  * @param y
- *     The Y coordinate of the upper-left corner of the current 64x64 rectangle
- *     within the search region.
+ *     The Y coordinate of the upper-left corner of the current block within
+ *     the search region.
  *
  * @param hash
- *     The hash value that applies to the current 64x64 rectangle.
+ *     The hash value that applies to the current block.
  *
  * @param closure
  *     The closure value that was originally provided to the call to 
@@ -115,12 +92,12 @@ static guac_display_plan_operation* guac_display_plan_remove_indexed_op(guac_dis
 typedef void guac_hash_callback(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure);
 
 /**
- * Iterates through each 64x64 subrectangle within the given rectangular region
- * of the underlying buffer of the given layer state, invoking the given
- * callback for each such subrectangle. Each 64x64 subrectangle within the
- * rectangular region is evaluated by sliding a 64x64 window over each pixel of
- * the region such that every 64x64 subrectangle in the region is eventually
- * covered.
+ * Iterates through each square subrectangle of the given search level's block
+ * size within the given rectangular region of the underlying buffer of the
+ * given layer state, invoking the given callback for each such subrectangle.
+ * Each subrectangle within the rectangular region is evaluated by sliding a
+ * window of that size over each pixel of the region such that every
+ * subrectangle of that size in the region is eventually covered.
  *
  * @param plan
  *     The display plan related to the search/indexing operation being
@@ -132,8 +109,13 @@ typedef void guac_hash_callback(guac_display_plan* plan, int x, int y, uint64_t
  * @param rect
  *     The rectangular region within the image buffer that should be hashed.
  *
+ * @param level
+ *     The search level dictating the size of the blocks hashed, as defined by
+ *     GUAC_DISPLAY_PLAN_SEARCH_BLOCK_SIZE().
+ *
  * @param callback
- *     The callback to invoke for each 64x64 subrectangle of the given region.
+ *     The callback to invoke for each block-sized subrectangle of the given
+ *     region.
  *
  * @param closure
  *     The arbitrary value to pass the given callback each time it is invoked
@@ -141,7 +123,7 @@ typedef void guac_hash_callback(guac_display_plan* plan, int x, int y, uint64_t
  */
 static int guac_hash_foreach_image_rect(guac_display_plan* plan,
         const guac_display_layer_state* layer_state, const guac_rect* rect,
-        guac_hash_callback* callback, void* closure) {
+        int level, guac_hash_callback* callback, void* closure) {
 
     size_t stride = layer_state->buffer_stride;
     const unsigned char* data = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(*layer_state, *rect);
@@ -149,21 +131,31 @@ static int guac_hash_foreach_image_rect(guac_display_plan* plan,
     int x, y;
     uint64_t cell_hash[GUAC_DISPLAY_MAX_WIDTH] = { 0 };
 
-    /* NOTE: Because the hash value of the sliding 64x64 window is available
-     * only upon reaching the bottom-right corner of that window, we offset the
+    /* NOTE: The hash of each row segment and of each block is a polynomial
+     * hash over 64-bit integers using a multiplier of 31 * 2^(64 / size). The
+     * contribution of any value that has been multiplied "size" times has
+     * thus been shifted left by 64 bits and vanishes, leaving only the
+     * contributions of the most recent "size" values. This is what allows the
+     * hash to describe a sliding window without explicitly removing the
+     * values that leave that window. */
+    int size = GUAC_DISPLAY_PLAN_SEARCH_BLOCK_SIZE(level);
+    int shift = 64 / size;
+
+    /* NOTE: Because the hash value of the sliding window is available only
+     * upon reaching the bottom-right corner of that window, we offset the
      * coordinates here by the relative location of the bottom-right corner
-     * (GUAC_DISPLAY_CELL_SIZE - 1) so that we have easy access to the
-     * coordinates of the upper-left corner of the sliding window, as required
-     * by the callback being invoked.
+     * (size - 1) so that we have easy access to the coordinates of the
+     * upper-left corner of the sliding window, as required by the callback
+     * being invoked.
      *
      * This also allows us to easily determine when the hash is valid and it's
      * safe to invoke the callback. Once the coordinates are within the given
-     * rect, we have evaluated a full 64x64 rectangle and have a valid hash. */
+     * rect, we have evaluated a full block and have a valid hash. */
 
-    int start_x = rect->left   - GUAC_DISPLAY_CELL_SIZE + 1;
-    int end_x   = rect->right  - GUAC_DISPLAY_CELL_SIZE + 1;
-    int start_y = rect->top    - GUAC_DISPLAY_CELL_SIZE + 1;
-    int end_y   = rect->bottom - GUAC_DISPLAY_CELL_SIZE + 1;
+    int start_x = rect->left   - size + 1;
+    int end_x   = rect->right  - size + 1;
+    int start_y = rect->top    - size + 1;
+    int end_y   = rect->bottom - size + 1;
 
     for (y = start_y; y < end_y; y++) {
 
@@ -181,10 +173,10 @@ static int guac_hash_foreach_image_rect(guac_display_plan* plan,
             uint32_t pixel = *(row++);
 
             /* Update hash value for current row segment */
-            row_hash = ((row_hash * 31) << 1) + pixel;
+            row_hash = ((row_hash * 31) << shift) + pixel;
 
             /* Incorporate row hash value into overall cell hash */
-            uint64_t cell_hash = ((*current_cell_hash * 31) << 1) + row_hash;
+            uint64_t cell_hash = ((*current_cell_hash * 31) << shift) + row_hash;
             *(current_cell_hash++) = cell_hash;
 
             /* Invoke callback for every hash generated, breaking out early if
@@ -220,54 +212,115 @@ static void guac_display_cell_init_rect(guac_rect* rect, int x, int y) {
 }
 
 /**
- * Callback for guac_hash_foreach_image_rect() which stores the given operation
- * in the ops_by_hash table of the given display plan.
+ * Determines the smallest square block within the search levels supported by
+ * guac_display_plan that fully contains the region modified by the given
+ * operation while remaining within both the cell containing that operation
+ * and the bounds of the layer being modified.
+ *
+ * @param op
+ *     The operation to locate a block for.
+ *
+ * @param block
+ *     The rectangle to initialize with the bounds of the located block, if
+ *     any.
+ *
+ * @return
+ *     The search level of the located block, or -1 if no such block exists
+ *     (the operation touches a partial cell at the edge of the layer that is
+ *     too small for any block to fit).
+ */
+static int guac_display_plan_find_block(const guac_display_plan_operation* op,
+        guac_rect* block) {
+
+    guac_rect layer_bounds;
+    guac_display_layer_get_bounds(op->layer, &layer_bounds);
+
+    guac_rect cell;
+    guac_display_cell_init_rect(&cell, op->dest.left, op->dest.top);
+    guac_rect_constrain(&cell, &layer_bounds);
+
+    int width = guac_rect_width(&op->dest);
+    int height = guac_rect_height(&op->dest);
+
+    for (int level = GUAC_DISPLAY_PLAN_SEARCH_SIZES - 1; level >= 0; level--) {
+
+        int size = GUAC_DISPLAY_PLAN_SEARCH_BLOCK_SIZE(level);
+
+        /* Skip any block sizes that cannot contain the operation or that
+         * cannot fit within the available portion of the cell */
+        if (width > size || height > size
+                || guac_rect_width(&cell) < size
+                || guac_rect_height(&cell) < size)
+            continue;
+
+        /* Align the block with the upper-left corner of the operation,
+         * shifting up/left only as far as necessary to stay within the cell */
+        int left = op->dest.left;
+        if (left + size > cell.right)
+            left = cell.right - size;
+
+        int top = op->dest.top;
+        if (top + size > cell.bottom)
+            top = cell.bottom - size;
+
+        guac_rect_init(block, left, top, size, size);
+        return level;
+
+    }
+
+    return -1;
+
+}
+
+/**
+ * Callback for guac_hash_foreach_image_rect() which stores the hash of the
+ * single block that was hashed within the ops_by_hash table of the given
+ * display plan.
  *
  * @param plan
  *     The display plan to store the given operation in.
  *
  * @param x
- *     The X coordinate of the upper-left corner of the 64x64 rectangle
- *     modified by the given operation.
+ *     The X coordinate of the upper-left corner of the block containing the
+ *     region modified by the given operation.
  *
  * @param y
- *     The Y coordinate of the upper-left corner of the 64x64 rectangle
- *     modified by the given operation.
+ *     The Y coordinate of the upper-left corner of the block containing the
+ *     region modified by the given operation.
  *
  * @param hash
- *     The hash value that applies to the 64x64 rectangle at the given
- *     coordinates.
+ *     The hash value that applies to the block at the given coordinates.
  *
  * @param closure
- *     A pointer to the guac_display_plan_operation that should be stored
- *     within the ops_by_hash table of the given display plan.
+ *     A pointer to the uint64_t that should receive the hash value.
  */
-static void guac_display_plan_index_op_for_cell(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure) {
-    guac_display_plan_store_indexed_op(plan, hash, (guac_display_plan_operation*) closure);
+static void guac_display_plan_store_block_hash(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure) {
+    *((uint64_t*) closure) = hash;
 }
 
 void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan) {
 
     memset(plan->ops_by_hash, 0, sizeof(plan->ops_by_hash));
+    memset(plan->indexed_count, 0, sizeof(plan->indexed_count));
+    memset(plan->matched_count, 0, sizeof(plan->matched_count));
 
     guac_display_plan_operation* op = plan->ops;
     for (int i = 0; i < plan->length; i++) {
 
+        plan->indexed_ops[i].op = NULL;
+
         if (op->type == GUAC_DISPLAY_PLAN_OPERATION_IMG) {
 
-            guac_display_layer* layer = op->layer;
+            guac_rect block;
+            int level = guac_display_plan_find_block(op, &block);
+            if (level >= 0) {
 
-            guac_rect layer_bounds;
-            guac_display_layer_get_bounds(layer, &layer_bounds);
+                uint64_t hash = 0;
+                guac_hash_foreach_image_rect(plan, &op->layer->pending_frame,
+                        &block, level, guac_display_plan_store_block_hash, &hash);
 
-            guac_rect cell;
-            guac_display_cell_init_rect(&cell, op->dest.left, op->dest.top);
+                guac_display_plan_store_indexed_op(plan, hash, level, &block, op);
 
-            guac_rect_constrain(&cell, &layer_bounds);
-            if (guac_rect_width(&cell) == GUAC_DISPLAY_CELL_SIZE
-                    && guac_rect_height(&cell) == GUAC_DISPLAY_CELL_SIZE) {
-                guac_hash_foreach_image_rect(plan, &layer->pending_frame,
-                        &cell, guac_display_plan_index_op_for_cell, op);
             }
 
         }
@@ -342,66 +395,110 @@ static int guac_image_cmp(const unsigned char* restrict data_a, int width_a, int
 
 }
 
+/**
+ * The search that should be performed by PFR_LFR_guac_display_plan_find_copies()
+ * for each block hashed by guac_hash_foreach_image_rect().
+ */
+typedef struct guac_display_plan_copy_search {
+
+    /**
+     * The layer whose previous frame is being searched.
+     */
+    guac_display_layer* layer;
+
+    /**
+     * The search level of the blocks being hashed. Only indexed operations
+     * having the same search level can match those blocks.
+     */
+    int level;
+
+} guac_display_plan_copy_search;
+
 /**
  * Callback for guac_hash_foreach_image_rect() which searches the ops_by_hash
  * table of the given display plan for occurrences of the given hash, replacing
- * the matching operation with a copy operation if a match is found.
+ * each matching operation with a copy operation.
  *
- * NOTE: While this function will search for and optimize operations that copy
- * existing data, it can only do so for distinct image data. Multiple
- * operations that copy the same exact data (like a region tiled with multiple
- * copies of some pattern) can only be stored in the table once, and therefore
- * will only match once.
+ * As operations having identical hashes are all retained within ops_by_hash,
+ * multiple operations that copy the same exact data (like a region tiled with
+ * multiple copies of some pattern) will all match the same source region.
  *
  * @param plan
  *     The display plan to update with any copies found.
  *
  * @param x
- *     The X coordinate of the upper-left corner of the 64x64 region currently
- *     being checked.
+ *     The X coordinate of the upper-left corner of the block currently being
+ *     checked.
  *
  * @param y
- *     The Y coordinate of the upper-left corner of the 64x64 region currently
- *     being checked.
+ *     The Y coordinate of the upper-left corner of the block currently being
+ *     checked.
  *
  * @param hash
- *     The hash value that applies to the 64x64 rectangle at the given
- *     coordinates.
+ *     The hash value that applies to the block at the given coordinates.
  *
  * @param closure
- *     A pointer to the guac_display_layer that is being searched.
+ *     A pointer to the guac_display_plan_copy_search describing the search
+ *     being performed.
  */
 static void PFR_LFR_guac_display_plan_find_copies(guac_display_plan* plan,
         int x, int y, uint64_t hash, void* closure) {
 
-    guac_display_layer* copy_from_layer = (guac_display_layer*) closure;
+    guac_display_plan_copy_search* search = (guac_display_plan_copy_search*) closure;
+    guac_display_layer* copy_from_layer = search->layer;
+
+    int size = GUAC_DISPLAY_PLAN_SEARCH_BLOCK_SIZE(search->level);
 
-    /* Transform the matching operation into a copy of the current region if
-     * any operations match, banning the underlying hash from further checks if
-     * a collision occurs */
-    guac_display_plan_operation* op = guac_display_plan_remove_indexed_op(plan, hash);
-    if (op != NULL) {
+    guac_display_plan_indexed_operation** current =
+        &(plan->ops_by_hash[GUAC_DISPLAY_PLAN_OPERATION_HASH(hash)]);
 
+    while (*current != NULL) {
+
+        guac_display_plan_indexed_operation* entry = *current;
+
+        /* NOTE: We verify the hash value here because the lookup performed is
+         * actually a hash of a hash. There's an additional chance of
+         * collisions between hash values at this second level of hashing. */
+        if (entry->hash != hash || entry->level != search->level) {
+            current = &entry->next;
+            continue;
+        }
+
+        guac_display_plan_operation* op = entry->op;
         guac_display_layer* copy_to_layer = op->layer;
 
         guac_rect src_rect;
-        guac_rect_init(&src_rect, x, y, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE);
+        guac_rect_init(&src_rect, x, y, size, size);
 
-        guac_rect dst_rect;
-        guac_display_cell_init_rect(&dst_rect, op->dest.left, op->dest.top);
+        /* The client-side contents of any region covered by video are stale
+         * and cannot be copied */
+        if (copy_from_layer == plan->display->default_layer
+                && guac_rect_intersects(&src_rect, &plan->video_rect))
+            return;
 
         const unsigned char* copy_from = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(copy_from_layer->last_frame, src_rect);
-        const unsigned char* copy_to = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(copy_to_layer->pending_frame, dst_rect);
+        const unsigned char* copy_to = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(copy_to_layer->pending_frame, entry->block);
+
+        /* Only transform into a copy if the image data is truly identical (not
+         * a collision), removing the operation from further consideration once
+         * transformed */
+        if (!guac_image_cmp(copy_from, size, size, copy_from_layer->last_frame.buffer_stride,
+                copy_to, size, size, copy_to_layer->pending_frame.buffer_stride)) {
 
-        /* Only transform into a copy if the image data is truly identical (not a collision) */
-        if (!guac_image_cmp(copy_from, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE, copy_from_layer->last_frame.buffer_stride,
-                copy_to, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE, copy_to_layer->pending_frame.buffer_stride)) {
             op->type = GUAC_DISPLAY_PLAN_OPERATION_COPY;
             op->src.layer_rect.layer = copy_from_layer->last_frame_buffer;
             op->src.layer_rect.rect = src_rect;
-            op->dest = dst_rect;
+            op->dest = entry->block;
+
+            plan->matched_count[search->level]++;
+
+            *current = entry->next;
+            continue;
+
         }
 
+        current = &entry->next;
+
     }
 
 }
@@ -409,27 +506,45 @@ static void PFR_LFR_guac_display_plan_find_copies(guac_display_plan* plan,
 void PFR_LFR_guac_display_plan_rewrite_as_copies(guac_display_plan* plan) {
 
     guac_display* display = plan->display;
-    guac_display_layer* current = display->last_frame.layers;
-    while (current != NULL) {
 
-        /* Search only the layers that are specifically noted as possible
-         * sources for copies */
-        if (current->pending_frame.search_for_copies) {
+    for (int level = 0; level < GUAC_DISPLAY_PLAN_SEARCH_SIZES; level++) {
 
-            guac_rect search_region;
-            guac_rect_init(&search_region, 0, 0, current->last_frame.width, current->last_frame.height);
+        /* Skip any search levels that have nothing to match */
+        if (!plan->indexed_count[level])
+            continue;
+
+        guac_display_layer* current = display->last_frame.layers;
+        while (current != NULL) {
+
+            /* Search only the layers that are specifically noted as possible
+             * sources for copies */
+            if (current->pending_frame.search_for_copies) {
+
+                guac_rect search_region;
+                guac_rect_init(&search_region, 0, 0, current->last_frame.width, current->last_frame.height);
+
+                /* Avoid excessive computation by restricting the search region to only
+                 * the area that was changed in the upcoming frame (in the case of
+                 * scrolling, absolutely all data relevant to the scroll will have been
+                 * modified) */
+                guac_rect_constrain(&search_region, &current->pending_frame.dirty);
+
+                guac_display_plan_copy_search search = {
+                    .layer = current,
+                    .level = level
+                };
+
+                guac_hash_foreach_image_rect(plan, &current->last_frame, &search_region,
+                        level, PFR_LFR_guac_display_plan_find_copies, &search);
+
+            }
 
-            /* Avoid excessive computation by restricting the search region to only
-             * the area that was changed in the upcoming frame (in the case of
-             * scrolling, absolutely all data relevant to the scroll will have been
-             * modified) */
-            guac_rect_constrain(&search_region, &current->pending_frame.dirty);
+            current = current->last_frame.next;
 
-            guac_hash_foreach_image_rect(plan, &current->last_frame, &search_region,
-                    PFR_LFR_guac_display_plan_find_copies, current);
         }
 
-        current = current->last_frame.next;
+        display->copy_search_indexed[level] += plan->indexed_count[level];
+        display->copy_search_matched[level] += plan->matched_count[level];
 
     }
 
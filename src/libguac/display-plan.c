@@ -23,11 +23,14 @@
 #include "guacamole/client.h"
 #include "guacamole/display.h"
 #include "guacamole/fifo.h"
+#include "guacamole/layer.h"
 #include "guacamole/mem.h"
 #include "guacamole/protocol.h"
 #include "guacamole/socket.h"
 #include "guacamole/timestamp.h"
 
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 #include <cairo/cairo.h>
 
@@ -307,6 +310,9 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
     plan->frame_end = frame_end;
     plan->length = op_count;
     plan->ops = guac_mem_alloc(plan->length, sizeof(guac_display_plan_operation));
+    plan->indexed_ops = guac_mem_alloc(plan->length, sizeof(guac_display_plan_indexed_operation));
+    plan->video_op.type = GUAC_DISPLAY_PLAN_OPERATION_NOP;
+    plan->video_rect = (guac_rect) { 0 };
 
     /* Convert the dirty rectangles stored in each layer's cells to individual
      * image operations for later optimization */
@@ -364,16 +370,221 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
 }
 
 void guac_display_plan_free(guac_display_plan* plan) {
+    guac_mem_free(plan->indexed_ops);
     guac_mem_free(plan->ops);
     guac_mem_free(plan);
 }
 
+/**
+ * An image operation of a progressive frame, along with its priority.
+ */
+typedef struct guac_display_plan_tile {
+
+    /**
+     * The image operation covering this tile.
+     */
+    guac_display_plan_operation op;
+
+    /**
+     * The squared distance between the mouse cursor and the nearest point of
+     * this tile, in pixels, or INT_MAX if the tile is not visible.
+     */
+    int distance;
+
+    /**
+     * The order in which this tile was produced, used to ensure that tiles
+     * of equal priority retain their original order.
+     */
+    int index;
+
+} guac_display_plan_tile;
+
+/**
+ * Comparator for qsort() that orders guac_display_plan_tile structures by
+ * ascending distance from the mouse cursor.
+ *
+ * @param a
+ *     Pointer to the first guac_display_plan_tile to compare.
+ *
+ * @param b
+ *     Pointer to the second guac_display_plan_tile to compare.
+ *
+ * @return
+ *     A negative value if the first tile should be encoded first, a positive
+ *     value if the second tile should be encoded first, or zero if the tiles
+ *     are identical.
+ */
+static int guac_display_plan_tile_compare(const void* a, const void* b) {
+
+    const guac_display_plan_tile* tile_a = (const guac_display_plan_tile*) a;
+    const guac_display_plan_tile* tile_b = (const guac_display_plan_tile*) b;
+
+    if (tile_a->distance != tile_b->distance)
+        return tile_a->distance < tile_b->distance ? -1 : 1;
+
+    return tile_a->index - tile_b->index;
+
+}
+
+/**
+ * Returns the squared distance between the given point and the nearest point
+ * within the given rectangle along a single axis.
+ *
+ * @param point
+ *     The coordinate of the point along the axis.
+ *
+ * @param start
+ *     The coordinate of the start of the rectangle along the axis, inclusive.
+ *
+ * @param end
+ *     The coordinate of the end of the rectangle along the axis, exclusive.
+ *
+ * @return
+ *     The squared distance between the point and the rectangle along the
+ *     axis, or zero if the point lies within the rectangle along that axis.
+ */
+static int guac_display_plan_axis_distance(int point, int start, int end) {
+
+    int distance = 0;
+    if (point < start)
+        distance = start - point;
+    else if (point >= end)
+        distance = point - end + 1;
+
+    return distance * distance;
+
+}
+
+/**
+ * Returns the number of tiles that the given rectangle would be split into
+ * if its image operation were delivered progressively.
+ *
+ * @param rect
+ *     The destination rectangle of the image operation.
+ *
+ * @return
+ *     The number of tiles that would cover the given rectangle.
+ */
+static size_t guac_display_plan_tile_count(const guac_rect* rect) {
+
+    guac_rect grid = *rect;
+    guac_rect_align(&grid, GUAC_DISPLAY_PROGRESSIVE_TILE_SIZE);
+
+    return (size_t) (guac_rect_width(&grid) >> GUAC_DISPLAY_PROGRESSIVE_TILE_SIZE)
+                  * (guac_rect_height(&grid) >> GUAC_DISPLAY_PROGRESSIVE_TILE_SIZE);
+
+}
+
+/**
+ * Splits each of the given image operations into tiles no larger than
+ * 2^GUAC_DISPLAY_PROGRESSIVE_TILE_SIZE pixels on each side, adding those
+ * tiles to the ops FIFO in order of their distance from the mouse cursor.
+ * Tiles of layers that are not positioned relative to the default layer
+ * (including off-screen buffers) are added last. The ops FIFO of the display
+ * must already be locked.
+ *
+ * @param display
+ *     The display whose ops FIFO should receive the tiles.
+ *
+ * @param ops
+ *     The image operations to split.
+ *
+ * @param op_count
+ *     The number of image operations in the ops array.
+ *
+ * @param tile_count
+ *     The total number of tiles that will result from splitting all provided
+ *     operations.
+ */
+static void guac_display_plan_enqueue_tiles(guac_display* display,
+        guac_display_plan_operation** ops, size_t op_count, size_t tile_count) {
+
+    const int tile_size = 1 << GUAC_DISPLAY_PROGRESSIVE_TILE_SIZE;
+    int cursor_x = display->pending_frame.cursor_x;
+    int cursor_y = display->pending_frame.cursor_y;
+
+    guac_display_plan_tile* tiles = guac_mem_alloc(tile_count, sizeof(guac_display_plan_tile));
+    guac_display_plan_tile* tile = tiles;
+
+    for (size_t i = 0; i < op_count; i++) {
+
+        guac_display_plan_operation* op = ops[i];
+        guac_display_layer* display_layer = op->layer;
+
+        /* Only the default layer and its immediate children are positioned
+         * relative to the mouse cursor (visible layers are children of the
+         * default layer unless given some other parent) */
+        const guac_layer* layer = display_layer->layer;
+        const guac_layer* parent = display_layer->pending_frame.parent;
+        int visible = layer->index == 0 || (layer->index > 0
+                && (parent == NULL || parent == GUAC_DEFAULT_LAYER));
+
+        int offset_x = layer->index > 0 ? display_layer->pending_frame.x : 0;
+        int offset_y = layer->index > 0 ? display_layer->pending_frame.y : 0;
+
+        guac_rect grid = op->dest;
+        guac_rect_align(&grid, GUAC_DISPLAY_PROGRESSIVE_TILE_SIZE);
+
+        size_t op_size = (size_t) guac_rect_width(&op->dest) * guac_rect_height(&op->dest);
+
+        for (int y = grid.top; y < grid.bottom; y += tile_size) {
+            for (int x = grid.left; x < grid.right; x += tile_size) {
+
+                guac_rect dest;
+                guac_rect_init(&dest, x, y, tile_size, tile_size);
+                guac_rect_constrain(&dest, &op->dest);
+
+                if (guac_rect_is_empty(&dest))
+                    continue;
+
+                GUAC_ASSERT(tile - tiles < tile_count);
+
+                /* Each tile accounts for its share of the changed pixels of
+                 * the original operation */
+                size_t tile_size_pixels = (size_t) guac_rect_width(&dest) * guac_rect_height(&dest);
+
+                tile->op = *op;
+                tile->op.dest = dest;
+                tile->op.dirty_size = op->dirty_size * tile_size_pixels / op_size;
+                tile->index = tile - tiles;
+
+                if (visible)
+                    tile->distance =
+                          guac_display_plan_axis_distance(cursor_x, offset_x + dest.left, offset_x + dest.right)
+                        + guac_display_plan_axis_distance(cursor_y, offset_y + dest.top, offset_y + dest.bottom);
+                else
+                    tile->distance = INT_MAX;
+
+                tile++;
+
+            }
+        }
+
+    }
+
+    size_t added = tile - tiles;
+    qsort(tiles, added, sizeof(guac_display_plan_tile), guac_display_plan_tile_compare);
+
+    for (size_t i = 0; i < added; i++)
+        guac_fifo_enqueue(&display->ops, &tiles[i].op);
+
+    guac_mem_free(tiles);
+
+}
+
 void guac_display_plan_apply(guac_display_plan* plan) {
 
     guac_display* display = plan->display;
     guac_client* client = display->client;
     guac_display_plan_operation* op = plan->ops;
 
+    /* All image operations are deferred until the overall size of the frame
+     * is known */
+    guac_display_plan_operation** image_ops = guac_mem_alloc(plan->length, sizeof(guac_display_plan_operation*));
+    size_t image_op_count = 0;
+    size_t image_size = 0;
+    size_t tile_count = 0;
+
     /* Do not allow worker threads to move forward with image encoding until
      * AFTER the non-image instructions have finished being written */
     guac_fifo_lock(&display->ops);
@@ -421,7 +632,9 @@ void guac_display_plan_apply(guac_display_plan* plan) {
 
             /* All other operations should be handled by the workers */
             default:
-                guac_fifo_enqueue(&display->ops, op);
+                image_ops[image_op_count++] = op;
+                image_size += (size_t) guac_rect_width(&op->dest) * guac_rect_height(&op->dest);
+                tile_count += guac_display_plan_tile_count(&op->dest);
                 break;
 
         }
@@ -430,6 +643,29 @@ void guac_display_plan_apply(guac_display_plan* plan) {
 
     }
 
+    /* Deliver large frames progressively, splitting their image updates into
+     * tiles that are encoded in order of distance from the mouse cursor */
+    display->progressive = image_size >= GUAC_DISPLAY_PROGRESSIVE_MIN_PIXELS;
+    if (display->progressive) {
+        display->last_progressive_sync = guac_timestamp_current();
+        guac_display_plan_enqueue_tiles(display, image_ops, image_op_count, tile_count);
+    }
+
+    /* Smaller frames are encoded as-is */
+    else {
+        for (size_t i = 0; i < image_op_count; i++)
+            guac_fifo_enqueue(&display->ops, image_ops[i]);
+    }
+
+    /* Any update to the video stream is encoded alongside the images */
+    if (plan->video_op.type != GUAC_DISPLAY_PLAN_OPERATION_NOP)
+        guac_fifo_enqueue(&display->ops, &plan->video_op);
+
     guac_fifo_unlock(&display->ops);
 
+    guac_mem_free(image_ops);
+
+    /* Awaken worker threads to encode any operations added above */
+    guac_display_worker_pool_schedule(display);
+
 }
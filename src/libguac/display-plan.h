@@ -103,6 +103,25 @@
  */
 #define GUAC_DISPLAY_PLAN_OPERATION_INDEX_SIZE 0x10000
 
+/**
+ * The number of distinct block sizes used when searching the previous frame
+ * for image data that can be copied rather than re-encoded. The largest block
+ * size is GUAC_DISPLAY_CELL_SIZE, and each subsequent block size is half the
+ * size of the previous (64x64, 32x32, and 16x16).
+ */
+#define GUAC_DISPLAY_PLAN_SEARCH_SIZES 3
+
+/**
+ * Returns the width and height of the square blocks hashed for the given
+ * search level, where level 0 corresponds to blocks the size of an entire
+ * cell (GUAC_DISPLAY_CELL_SIZE) and each subsequent level halves that size.
+ *
+ * @param level
+ *     The search level, which must be less than
+ *     GUAC_DISPLAY_PLAN_SEARCH_SIZES.
+ */
+#define GUAC_DISPLAY_PLAN_SEARCH_BLOCK_SIZE(level) (GUAC_DISPLAY_CELL_SIZE >> (level))
+
 /**
  * Hash function which hashes a larger, 64-bit hash into a 16-bit hash that
  * will fit within GUAC_DISPLAY_PLAN_OPERATION_INDEX_SIZE. Note that the random
@@ -141,7 +160,13 @@ typedef enum guac_display_plan_operation_type {
     /**
      * Draw arbitrary image data to the destination rect.
      */
-    GUAC_DISPLAY_PLAN_OPERATION_IMG
+    GUAC_DISPLAY_PLAN_OPERATION_IMG,
+
+    /**
+     * Encode the destination rect as the next frame of the H.264 video stream
+     * covering that rect, or end that stream. See guac_display_video.
+     */
+    GUAC_DISPLAY_PLAN_OPERATION_VIDEO
 
 } guac_display_plan_operation_type;
 
@@ -219,6 +244,15 @@ typedef struct guac_display_plan_operation {
          */
         guac_display_plan_layer_rect layer_rect;
 
+        /**
+         * Non-zero if the video stream covering the destination rect should
+         * be ended, with the contents of that rect restored as an image, zero
+         * if the destination rect should be encoded as the next frame of that
+         * stream. This value applies only to GUAC_DISPLAY_PLAN_OPERATION_VIDEO
+         * operations.
+         */
+        int end_video;
+
     } src;
 
 } guac_display_plan_operation;
@@ -227,7 +261,9 @@ typedef struct guac_display_plan_operation {
  * A guac_display_plan_operation that has been hashed and stored within a
  * guac_display_plan.
  */
-typedef struct guac_display_plan_indexed_operation {
+typedef struct guac_display_plan_indexed_operation guac_display_plan_indexed_operation;
+
+struct guac_display_plan_indexed_operation {
 
     /**
      * The operation.
@@ -236,15 +272,35 @@ typedef struct guac_display_plan_indexed_operation {
 
     /**
      * The hash value associated with the operation. This hash value is derived
-     * from the actual image contents of the region that was changed, using the
-     * new contents of that region. The intent of this hash is to allow
-     * operations to be quickly located based on the output they will produce,
-     * such that image draw operations can be automatically replaced with
-     * simple copies if they reuse data from elsewhere in a layer.
+     * from the actual image contents of the block containing the region that
+     * was changed, using the new contents of that block. The intent of this
+     * hash is to allow operations to be quickly located based on the output
+     * they will produce, such that image draw operations can be automatically
+     * replaced with simple copies if they reuse data from elsewhere in a
+     * layer.
      */
     uint64_t hash;
 
-} guac_display_plan_indexed_operation;
+    /**
+     * The search level of the block that was hashed, where the width and
+     * height of that block are GUAC_DISPLAY_PLAN_SEARCH_BLOCK_SIZE(level).
+     */
+    int level;
+
+    /**
+     * The square block containing all changes made by the operation, whose
+     * new contents were hashed. This block lies entirely within the cell
+     * affected by the operation.
+     */
+    guac_rect block;
+
+    /**
+     * The next operation stored within the same hash bucket, or NULL if this
+     * is the last such operation.
+     */
+    guac_display_plan_indexed_operation* next;
+
+};
 
 /**
  * The set of operations required to transform the display state from what each
@@ -279,10 +335,45 @@ typedef struct guac_display_plan {
     size_t length;
 
     /**
-     * Index of operations in the plan by their image contents. Only operations
-     * that can be easily stored without collisions will be represented here.
+     * Index of operations in the plan by their image contents. Each entry is
+     * the head of a list of all indexed operations whose hashes fall within
+     * the same bucket, including operations having identical hashes.
+     */
+    guac_display_plan_indexed_operation* ops_by_hash[GUAC_DISPLAY_PLAN_OPERATION_INDEX_SIZE];
+
+    /**
+     * Storage for all entries within ops_by_hash. As each operation is indexed
+     * at most once, this array contains exactly as many entries as there are
+     * operations in the plan, in the same order. The entries of operations
+     * that were not indexed have a NULL op.
+     */
+    guac_display_plan_indexed_operation* indexed_ops;
+
+    /**
+     * The number of operations indexed at each search level.
+     */
+    unsigned int indexed_count[GUAC_DISPLAY_PLAN_SEARCH_SIZES];
+
+    /**
+     * The number of operations at each search level which were replaced with
+     * copies.
+     */
+    unsigned int matched_count[GUAC_DISPLAY_PLAN_SEARCH_SIZES];
+
+    /**
+     * The operation that should be applied to the video stream of the
+     * display, if any. If no such operation is needed for the current frame,
+     * the type of this operation is GUAC_DISPLAY_PLAN_OPERATION_NOP.
+     */
+    guac_display_plan_operation video_op;
+
+    /**
+     * The region of the default layer that is covered by a video stream for
+     * the current frame, or an empty rect if there is no such stream. The
+     * client-side contents of the default layer within this region are not
+     * kept up-to-date and must not be used as the source of copies.
      */
-    guac_display_plan_indexed_operation ops_by_hash[GUAC_DISPLAY_PLAN_OPERATION_INDEX_SIZE];
+    guac_rect video_rect;
 
 } guac_display_plan;
 
@@ -326,6 +417,34 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display);
  */
 void guac_display_plan_free(guac_display_plan* plan);
 
+/**
+ * Walks through all operations currently in the given guac_display_plan,
+ * tracking regions of the default layer that are continuously changing. If
+ * video streaming is enabled for the display and such a region has been
+ * changing for long enough, all draw operations within that region are
+ * dropped and replaced with a single GUAC_DISPLAY_PLAN_OPERATION_VIDEO
+ * operation stored within video_op. This function must be invoked before any
+ * other pass that rewrites draw operations.
+ *
+ * @param plan
+ *     The guac_display_plan to modify.
+ */
+void PFW_guac_display_plan_rewrite_as_video(guac_display_plan* plan);
+
+/**
+ * Walks through all operations currently in the given guac_display_plan,
+ * replacing draw operations with copies or rects wherever hints provided via
+ * guac_display_layer_hint_copy() or guac_display_layer_hint_fill() describe
+ * the changes made by those draws. Each hint is verified against the actual
+ * contents of the affected layer before being applied. Draw operations that
+ * are rewritten by this pass are not considered by later passes that must
+ * hash or search image data.
+ *
+ * @param plan
+ *     The guac_display_plan to modify.
+ */
+void PFR_LFR_guac_display_plan_rewrite_from_hints(guac_display_plan* plan);
+
 /**
  * Walks through all operations currently in the given guac_display_plan,
  * replacing draw operations with simple rects wherever draws consist only of a
@@ -339,6 +458,8 @@ void PFR_guac_display_plan_rewrite_as_rects(guac_display_plan* plan);
 /**
  * Walks through all operations currently in the given guac_display_plan,
  * storing the hashes of each outstanding draw operation within ops_by_hash.
+ * Each operation is hashed using the smallest square block (64x64, 32x32, or
+ * 16x16) that contains all changes made by that operation.
  * This function must be invoked before guac_display_plan_rewrite_as_copies()
  * can be used for the current pending frame.
  *
@@ -359,6 +480,21 @@ void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan);
  */
 void PFR_LFR_guac_display_plan_rewrite_as_copies(guac_display_plan* plan);
 
+/**
+ * Walks through all operations currently in the given guac_display_plan,
+ * replacing draw operations with copies from the image cache of the
+ * associated guac_display wherever the full 64x64 cell being drawn is already
+ * present in that cache. Cells that are drawn but not present in the cache
+ * are added to the cache, with their contents copied into the client-side
+ * buffer of the cache once the frame has been sent. The display plan must
+ * first be indexed by guac_display_plan_index_dirty_cells() before this
+ * function can be used.
+ *
+ * @param plan
+ *     The guac_display_plan to modify.
+ */
+void PFR_LFW_guac_display_plan_rewrite_from_cache(guac_display_plan* plan);
+
 /**
  * Walks through all operations currently in the given guac_display_plan,
  * combining horizontally-adjacent operations wherever doing so appears to be
@@ -20,14 +20,18 @@
 #ifndef GUAC_DISPLAY_PRIV_H
 #define GUAC_DISPLAY_PRIV_H
 
+#include "display-encoder.h"
 #include "display-plan.h"
+#include "encode-h264.h"
 #include "guacamole/client.h"
 #include "guacamole/display.h"
 #include "guacamole/fifo.h"
+#include "guacamole/flag.h"
 #include "guacamole/rect.h"
 #include "guacamole/socket.h"
 
 #include <pthread.h>
+#include <stdint.h>
 
 /**
  * The maximum amount of time to wait after flushing a frame when compensating
@@ -92,6 +96,7 @@
  * 2) last_frame.lock
  * 3) ops
  * 4) render_state
+ * 5) worker_pool->state
  *
  * Acquiring these locks in any other order risks deadlock. Don't do it.
  */
@@ -151,6 +156,118 @@
                 / GUAC_DISPLAY_CELL_SIZE                                      \
                 * 8)
 
+/**
+ * The maximum number of operations that a display worker thread may pull from
+ * the operation FIFO at once. Workers pull no more than their fair share of
+ * the operations currently pending, thus this limit matters only for frames
+ * consisting of many operations.
+ */
+#define GUAC_DISPLAY_WORKER_MAX_BATCH 16
+
+/**
+ * The minimum rate at which a cell must be changing, in frames per second,
+ * for changes to that cell to be considered motion that may warrant a video
+ * stream.
+ */
+#define GUAC_DISPLAY_VIDEO_MIN_FRAMERATE 10
+
+/**
+ * The minimum number of pixels that must be changed by motion within a single
+ * frame for that frame to count toward starting a video stream.
+ */
+#define GUAC_DISPLAY_VIDEO_MIN_PIXELS 65536
+
+/**
+ * The number of frames that must contain sufficient motion within the same
+ * region before a video stream is started for that region.
+ */
+#define GUAC_DISPLAY_VIDEO_MIN_FRAMES 30
+
+/**
+ * The amount of time that may elapse without motion before a video stream is
+ * ended (or before the motion tracked toward starting a video stream is
+ * forgotten), in milliseconds.
+ */
+#define GUAC_DISPLAY_VIDEO_TIMEOUT 2000
+
+/**
+ * The target bitrate of a video stream if the available bandwidth has not yet
+ * been measured, in bits per second.
+ */
+#define GUAC_DISPLAY_VIDEO_DEFAULT_BITRATE 2000000
+
+/**
+ * The lowest target bitrate that will be used for a video stream, in bits per
+ * second.
+ */
+#define GUAC_DISPLAY_VIDEO_MIN_BITRATE 250000
+
+/**
+ * The highest target bitrate that will be used for a video stream, in bits
+ * per second.
+ */
+#define GUAC_DISPLAY_VIDEO_MAX_BITRATE 20000000
+
+/**
+ * The minimum total number of pixels that must be covered by the image
+ * updates of a frame for that frame to be delivered progressively. The image
+ * updates of a progressive frame are split into tiles that are encoded in
+ * order of their distance from the mouse cursor, with intermediate "sync"
+ * instructions allowing connected clients to render completed tiles before
+ * the entire frame has been encoded.
+ */
+#define GUAC_DISPLAY_PROGRESSIVE_MIN_PIXELS 1048576
+
+/**
+ * The width and height of each tile of a progressive frame, in pixels, as the
+ * exponent of a power of two. The current value of 8 means that each tile
+ * will be no larger than 256x256 pixels.
+ */
+#define GUAC_DISPLAY_PROGRESSIVE_TILE_SIZE 8
+
+/**
+ * The minimum amount of time that must elapse between each intermediate
+ * "sync" instruction sent for a progressive frame, in milliseconds.
+ */
+#define GUAC_DISPLAY_PROGRESSIVE_INTERVAL 40
+
+/**
+ * The number of bytes of image data that may be retained within the image
+ * cache of each guac_display, unless a different budget is set with
+ * guac_display_set_cache_size(). This budget applies separately to the
+ * client-side buffer containing cached tiles and to the server-side copy of
+ * those tiles that is used to verify cache hits.
+ */
+#define GUAC_DISPLAY_CACHE_DEFAULT_SIZE 16777216
+
+/**
+ * The largest budget that may be set with guac_display_set_cache_size(), in
+ * bytes. Larger budgets are reduced to this value, such that the height of
+ * the client-side buffer containing cached tiles (16384 pixels) remains
+ * within the canvas size limits of common browsers.
+ */
+#define GUAC_DISPLAY_CACHE_MAX_SIZE 134217728
+
+/**
+ * The number of tiles within each row of the client-side buffer backing the
+ * image cache of each guac_display.
+ */
+#define GUAC_DISPLAY_CACHE_COLUMNS 32
+
+/**
+ * The number of hash buckets within the image cache of each guac_display.
+ * This value MUST be a power of two.
+ */
+#define GUAC_DISPLAY_CACHE_BUCKETS 4096
+
+/**
+ * The maximum number of hints that may be recorded for each layer within a
+ * single pending frame via guac_display_layer_hint_copy() and
+ * guac_display_layer_hint_fill(). Any further hints are ignored, leaving the
+ * affected regions to the usual rect and copy detection.
+ */
+#define GUAC_DISPLAY_MAX_HINTS 64
+
 /**
  * Returns the memory address of the given rectangle within the mutable image
  * buffer of the given guac_display_layer_state, where the upper-left corner of
@@ -245,6 +362,18 @@
  */
 #define GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_READY 4
 
+/**
+ * Bitwise flag set on the state flag of a guac_display_worker_pool when at
+ * least one guac_display is present within the run queue of the pool.
+ */
+#define GUAC_DISPLAY_WORKER_POOL_STATE_NONEMPTY 1
+
+/**
+ * Bitwise flag set on the state flag of a guac_display_worker_pool when the
+ * pool is being destroyed and all of its worker threads should terminate.
+ */
+#define GUAC_DISPLAY_WORKER_POOL_STATE_STOPPING 4
+
 /**
  * The state of the mouse cursor, as independently tracked by the render
  * thread. The mouse cursor state may be reported by
@@ -317,6 +446,65 @@ struct guac_display_render_thread {
 
 };
 
+/**
+ * The type of a hint recorded for a layer of the pending frame.
+ */
+typedef enum guac_display_layer_hint_type {
+
+    /**
+     * The destination rect now contains the image data that was present
+     * within the source rect of the same layer as of the last frame. See
+     * guac_display_layer_hint_copy().
+     */
+    GUAC_DISPLAY_LAYER_HINT_COPY,
+
+    /**
+     * The destination rect now contains only a single color. See
+     * guac_display_layer_hint_fill().
+     */
+    GUAC_DISPLAY_LAYER_HINT_FILL
+
+} guac_display_layer_hint_type;
+
+/**
+ * A description of a change made to a layer, provided by the code drawing to
+ * that layer, which may allow the changed region to be sent without hashing
+ * or searching its contents. Hints are verified against the actual contents
+ * of the layer before they are used, and thus an inaccurate or outdated hint
+ * is never harmful.
+ */
+typedef struct guac_display_layer_hint {
+
+    /**
+     * The type of this hint, dictating which member of src is relevant.
+     */
+    guac_display_layer_hint_type type;
+
+    /**
+     * The region of the layer described by this hint.
+     */
+    guac_rect dest;
+
+    union {
+
+        /**
+         * The region of the same layer, as of the last frame, whose contents
+         * were copied to the destination rect. This value applies only to
+         * GUAC_DISPLAY_LAYER_HINT_COPY hints, and has the same dimensions as
+         * the destination rect.
+         */
+        guac_rect rect;
+
+        /**
+         * The color that now fills the destination rect. This value applies
+         * only to GUAC_DISPLAY_LAYER_HINT_FILL hints.
+         */
+        uint32_t color;
+
+    } src;
+
+} guac_display_layer_hint;
+
 /**
  * Approximation of how often a region of a layer is modified, as well as what
  * changes have been made to that region since the last frame. This information
@@ -603,6 +791,23 @@ struct guac_display_layer {
      */
     size_t pending_frame_cells_height;
 
+    /**
+     * All hints recorded for this layer since the last frame, in the order
+     * they were recorded.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    guac_display_layer_hint pending_frame_hints[GUAC_DISPLAY_MAX_HINTS];
+
+    /**
+     * The number of hints currently stored within pending_frame_hints.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    int pending_frame_hint_count;
+
 };
 
 typedef struct guac_display_state {
@@ -694,6 +899,342 @@ typedef struct guac_display_state {
 
 } guac_display_state;
 
+/**
+ * Pool of worker threads that encodes the graphical operations of every
+ * guac_display within the current process. Rather than each guac_display
+ * starting its own set of threads, all displays share a single, bounded pool
+ * such that the number of encoding threads scales with the number of
+ * available processors rather than with the number of displays.
+ *
+ * Displays having pending operations are placed within a run queue. Each
+ * worker pulls the display at the head of that queue, handles exactly one
+ * operation from that display, and the display is placed back at the end of
+ * the queue if further operations remain. Worker threads are thus distributed
+ * fairly between all displays while still allowing the operations of a
+ * single display to be encoded in parallel.
+ */
+typedef struct guac_display_worker_pool {
+
+    /**
+     * The current state of the pool, including whether the run queue is
+     * non-empty and whether the pool is stopping. The lock of this flag also
+     * guards all other members of this structure, as well as the
+     * worker_pool_* members of each guac_display.
+     *
+     * @see GUAC_DISPLAY_WORKER_POOL_STATE_NONEMPTY
+     * @see GUAC_DISPLAY_WORKER_POOL_STATE_STOPPING
+     */
+    guac_flag state;
+
+    /**
+     * Condition which is broadcast, with the lock of the state flag held,
+     * whenever a worker thread has finished handling an operation from any
+     * display. Threads waiting for a particular display to no longer be in use
+     * by any worker wait on this condition (using the mutex of the state flag)
+     * until the worker_pool_active member of that display reaches zero.
+     */
+    pthread_cond_t display_released;
+
+    /**
+     * The number of guac_display instances currently holding a reference to
+     * this pool.
+     */
+    unsigned int ref_count;
+
+    /**
+     * The number of threads in the threads array.
+     */
+    int thread_count;
+
+    /**
+     * All worker threads of this pool.
+     */
+    pthread_t* threads;
+
+    /**
+     * The first display within the run queue, or NULL if the run queue is
+     * empty.
+     */
+    guac_display* head;
+
+    /**
+     * The last display within the run queue, or NULL if the run queue is
+     * empty.
+     */
+    guac_display* tail;
+
+    /**
+     * The number of displays currently within the run queue.
+     */
+    unsigned int length;
+
+    /**
+     * The largest number of displays that have been simultaneously present
+     * within the run queue since the pool was created.
+     */
+    unsigned int peak_length;
+
+} guac_display_worker_pool;
+
+/**
+ * A single tile of image data that has previously been sent to connected
+ * clients, stored within a guac_display_cache.
+ */
+typedef struct guac_display_cache_entry guac_display_cache_entry;
+
+struct guac_display_cache_entry {
+
+    /**
+     * The hash of the image contents of this tile, as calculated by
+     * PFR_guac_display_plan_index_dirty_cells() for a full 64x64 cell.
+     */
+    uint64_t hash;
+
+    /**
+     * The location of this tile within the client-side buffer of the cache.
+     */
+    guac_rect rect;
+
+    /**
+     * The server-side copy of the image contents of this tile, used to verify
+     * that a cache hit is not merely a hash collision. Each row of this tile
+     * consists of exactly GUAC_DISPLAY_CELL_SIZE pixels.
+     */
+    unsigned char* data;
+
+    /**
+     * The layer that this tile must be copied from at the end of the current
+     * frame to populate the client-side buffer of the cache, or NULL if the
+     * client-side buffer already contains this tile. Tiles whose contents
+     * have not yet been copied into the client-side buffer cannot be used
+     * as the source of copies.
+     */
+    guac_display_layer* store_from;
+
+    /**
+     * The location within store_from that this tile must be copied from.
+     * This value is meaningful only if store_from is non-NULL.
+     */
+    guac_rect store_rect;
+
+    /**
+     * The next entry within the same hash bucket, or NULL if this is the last
+     * entry in the bucket.
+     */
+    guac_display_cache_entry* next_in_bucket;
+
+    /**
+     * The entry which was used more recently than this entry, or NULL if this
+     * entry is the most recently used.
+     */
+    guac_display_cache_entry* more_recent;
+
+    /**
+     * The entry which was used less recently than this entry, or NULL if this
+     * entry is the least recently used.
+     */
+    guac_display_cache_entry* less_recent;
+
+};
+
+/**
+ * Cache of 64x64 tiles of image data that have previously been sent to
+ * connected clients, stored within an off-screen client-side buffer. Draw
+ * operations that would send a tile already present in the cache are instead
+ * replaced with copies from that buffer, regardless of how many frames have
+ * elapsed since the tile was last visible. Once the cache is full, the least
+ * recently used tiles are replaced.
+ *
+ * IMPORTANT: All members of this structure must only be accessed or modified
+ * while the last frame is locked for writing, with the exception of the
+ * pending stores, which are also committed by the worker thread that ends
+ * each frame (no other frame can be flushed while that worker is active).
+ */
+typedef struct guac_display_cache {
+
+    /**
+     * The client-side buffer containing all cached tiles, or NULL if this
+     * buffer has not yet been allocated.
+     */
+    guac_layer* buffer;
+
+    /**
+     * All entries of this cache, allocated only once the first tile is
+     * cached.
+     */
+    guac_display_cache_entry* entries;
+
+    /**
+     * Storage for the server-side copies of all tiles in the cache.
+     */
+    unsigned char* data;
+
+    /**
+     * The number of bytes of image data that may be retained within this
+     * cache. If smaller than a single tile, no tiles are cached.
+     */
+    size_t max_size;
+
+    /**
+     * The number of entries in the entries array.
+     */
+    int capacity;
+
+    /**
+     * The number of entries that have been placed into use.
+     */
+    int length;
+
+    /**
+     * Hash table of all entries currently in use.
+     */
+    guac_display_cache_entry* buckets[GUAC_DISPLAY_CACHE_BUCKETS];
+
+    /**
+     * The most recently used entry, or NULL if the cache is empty.
+     */
+    guac_display_cache_entry* most_recent;
+
+    /**
+     * The least recently used entry, or NULL if the cache is empty.
+     */
+    guac_display_cache_entry* least_recent;
+
+    /**
+     * All entries whose tiles must be copied into the client-side buffer at
+     * the end of the current frame.
+     */
+    guac_display_cache_entry** pending_stores;
+
+    /**
+     * The number of entries within the pending_stores array.
+     */
+    int pending_store_count;
+
+    /**
+     * The number of draw operations that were replaced with copies from the
+     * cache.
+     */
+    uint64_t hits;
+
+    /**
+     * The number of draw operations that were eligible for caching but were
+     * not found within the cache.
+     */
+    uint64_t misses;
+
+} guac_display_cache;
+
+/**
+ * The state of the H.264 video stream that may be used to deliver a
+ * continuously-changing region of the default layer, such as a region playing
+ * video or an animation. While a video stream is active, draw operations
+ * within its region are dropped, and the contents of that region are instead
+ * encoded as frames of video played on a dedicated layer positioned above
+ * the default layer.
+ *
+ * IMPORTANT: All members of this structure, except for those noted as being
+ * owned by the worker threads, must only be accessed or modified while the
+ * pending frame is locked for writing. Members that are owned by the worker
+ * threads are only accessed while handling GUAC_DISPLAY_PLAN_OPERATION_VIDEO
+ * operations (there is at most one such operation per frame, and no other
+ * frame can be flushed while that operation is being handled).
+ */
+typedef struct guac_display_video {
+
+    /**
+     * Non-zero if video streaming is enabled for the display, zero otherwise.
+     */
+    int enabled;
+
+    /**
+     * Non-zero if a video stream is currently covering the region described
+     * by rect, zero otherwise.
+     */
+    int active;
+
+    /**
+     * Non-zero if the active video stream should be ended (and possibly later
+     * restarted), such as when new users join and have not received the
+     * beginning of the stream.
+     */
+    int restart;
+
+    /**
+     * The region of the default layer covered by the active video stream.
+     */
+    guac_rect rect;
+
+    /**
+     * The region of the default layer in which motion has been observed
+     * recently, and which may be covered by a video stream if that motion
+     * continues.
+     */
+    guac_rect candidate;
+
+    /**
+     * The number of frames that have contained motion within the candidate
+     * region.
+     */
+    unsigned int candidate_frames;
+
+    /**
+     * The timestamp of the last frame that contained motion within the
+     * candidate region or within the region of the active video stream.
+     */
+    guac_timestamp last_motion;
+
+    /**
+     * Non-zero if a worker thread was unable to encode the active video
+     * stream and has already ended that stream. Access to this flag is
+     * guarded by failed_lock, as it is set by the worker threads while the
+     * pending frame may be locked by another thread.
+     */
+    int failed;
+
+    /**
+     * Lock which guards access to the failed flag. A dedicated lock is used
+     * (rather than the pending frame lock) because the worker threads set
+     * that flag while holding the last frame lock, which must never be held
+     * while waiting to acquire the pending frame lock.
+     */
+    pthread_mutex_t failed_lock;
+
+    /**
+     * Non-zero if video streaming should not be attempted for the current set
+     * of users, either because not all of those users support H.264 video or
+     * because a previous stream could not be encoded. This is reset when
+     * users join (see PFW_guac_display_video_restart()) or leave.
+     */
+    int blocked;
+
+    /**
+     * The number of users connected at the time video streaming was blocked.
+     * A change in this value indicates that users have left, and thus that
+     * video streaming may be attempted again.
+     */
+    int blocked_users;
+
+    /**
+     * The layer on which the active video stream is played, or NULL if the
+     * stream has not yet been started. Owned by the worker threads.
+     */
+    guac_layer* layer;
+
+    /**
+     * The stream carrying the encoded video, or NULL if the stream has not
+     * yet been started. Owned by the worker threads.
+     */
+    guac_stream* stream;
+
+    /**
+     * The encoder producing the active video stream, or NULL if the stream
+     * has not yet been started. Owned by the worker threads.
+     */
+    guac_h264_encoder* encoder;
+
+} guac_display_video;
+
 struct guac_display {
 
     /* NOTE: Any member of this structure that requires protection against
@@ -749,15 +1290,109 @@ struct guac_display {
     /* ---------------- FRAME ENCODING WORKER THREADS ---------------- */
 
     /**
-     * The number of worker threads in the worker_threads array.
+     * The process-wide pool of worker threads that pulls from the ops FIFO,
+     * sending corresponding Guacamole instructions to all connected clients.
+     * This pool is shared by all guac_display instances within the current
+     * process.
+     *
+     * NOTE: This value is set only during allocation and may safely be
+     * accessed without acquiring any lock.
      */
-    int worker_thread_count;
+    guac_display_worker_pool* worker_pool;
 
     /**
-     * Pool of worker threads that automatically pull from the ops FIFO,
-     * sending corresponding Guacamole instructions to all connected clients.
+     * The display that follows this display within the run queue of the
+     * worker pool, or NULL if this display is the last display in the run
+     * queue or is not currently scheduled.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the state
+     * flag of the worker pool is locked.
+     */
+    guac_display* worker_pool_next;
+
+    /**
+     * Non-zero if this display is currently within the run queue of the worker
+     * pool, zero otherwise.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the state
+     * flag of the worker pool is locked.
+     */
+    int worker_pool_scheduled;
+
+    /**
+     * The number of worker pool threads that have pulled this display from
+     * the run queue and have not yet finished handling it.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the state
+     * flag of the worker pool is locked.
+     */
+    unsigned int worker_pool_active;
+
+    /**
+     * The total number of operations pulled from the ops FIFO by worker
+     * threads.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    uint64_t worker_ops_processed;
+
+    /**
+     * The largest number of operations observed to be waiting within the ops
+     * FIFO at the time an operation was pulled by a worker thread.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    size_t worker_ops_peak_depth;
+
+    /**
+     * The total number of draw operations, for each search level, that were
+     * indexed by their contents for the sake of locating identical content in
+     * the previous frame. See GUAC_DISPLAY_PLAN_SEARCH_BLOCK_SIZE().
+     *
+     * IMPORTANT: This member must only be accessed or modified while the
+     * pending frame is locked for writing.
+     */
+    uint64_t copy_search_indexed[GUAC_DISPLAY_PLAN_SEARCH_SIZES];
+
+    /**
+     * The total number of draw operations, for each search level, that were
+     * replaced with copies of identical content from the previous frame.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the
+     * pending frame is locked for writing.
+     */
+    uint64_t copy_search_matched[GUAC_DISPLAY_PLAN_SEARCH_SIZES];
+
+    /**
+     * The total number of draw operations that were replaced with copies or
+     * rects based on hints provided via guac_display_layer_hint_copy() or
+     * guac_display_layer_hint_fill(), without being indexed or searched.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the
+     * pending frame is locked for writing.
+     */
+    uint64_t hinted_ops;
+
+    /**
+     * Cache of image tiles previously sent to connected clients, allowing
+     * those tiles to be reused via copies in any later frame.
+     */
+    guac_display_cache cache;
+
+    /**
+     * The policy used by worker threads to choose the image format and
+     * quality of each update, based on measurements of previous updates and
+     * of the network.
+     */
+    guac_display_encoder_policy encoder_policy;
+
+    /**
+     * The H.264 video stream used to deliver continuously-changing regions of
+     * the default layer, if video streaming is enabled.
      */
-    pthread_t* worker_threads;
+    guac_display_video video;
 
     /**
      * FIFO of all graphical operations required to transform the remote
@@ -790,6 +1425,26 @@ struct guac_display {
      */
     int frame_deferred;
 
+    /**
+     * Whether the frame currently being encoded is being delivered
+     * progressively, with intermediate "sync" instructions sent as tiles are
+     * completed. See GUAC_DISPLAY_PROGRESSIVE_MIN_PIXELS.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    int progressive;
+
+    /**
+     * The time that the current progressive frame began being encoded, or
+     * the time that the most recent intermediate "sync" instruction was sent
+     * for that frame, whichever is later.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_timestamp last_progressive_sync;
+
     /**
      * The current state of the rendering process. Code that needs to be aware
      * of whether a frame is currently in the process of being rendered can
@@ -849,16 +1504,165 @@ void PFW_guac_display_layer_resize(guac_display_layer* layer,
         int width, int height);
 
 /**
- * Worker thread that continuously pulls operations from the operation FIFO of
- * the given guac_display, applying those operations by seding corresponding
- * instructions to connected clients.
+ * Copies all tiles that were added to the image cache of the given display
+ * during the current frame into the client-side buffer of that cache, such
+ * that those tiles may be used as the source of copies in later frames. This
+ * function must be invoked only after all drawing operations of the current
+ * frame have been sent.
+ *
+ * @param display
+ *     The display whose image cache should be committed.
+ */
+void LFR_guac_display_cache_commit(guac_display* display);
+
+/**
+ * Replicates the client-side buffer of the image cache of the given display
+ * across the given socket, such that the recipient may use every tile within
+ * the cache as the source of copies, including tiles that have not yet been
+ * committed with LFR_guac_display_cache_commit(). This does not affect the
+ * cache as seen by connected users. No frame may be in progress while the last frame is
+ * locked for reading and the render_state flag is locked.
+ *
+ * @param display
+ *     The display whose image cache should be replicated.
+ *
+ * @param socket
+ *     The socket to send the contents of the image cache over.
+ */
+void LFR_guac_display_cache_dup(guac_display* display, guac_socket* socket);
+
+/**
+ * Writes the full current state of the given display to the given
+ * asynchronous socket as a recording keyframe, without disturbing the image
+ * cache or any video stream seen by connected users. The socket is marked
+ * with guac_socket_async_mark() only after any in-progress frame has been
+ * completely sent, such that the member started by that mark begins exactly
+ * at a frame boundary with the state being written. As a player starting at
+ * the keyframe could not decode the remainder of an H.264 stream that began
+ * earlier, no keyframe is written while a video stream is active.
+ *
+ * @param display
+ *     The display whose state should be written.
+ *
+ * @param socket
+ *     The asynchronous socket of the recording, as returned by
+ *     guac_socket_async_open() or guac_recording_compress_open().
+ *
+ * @return
+ *     Zero if the keyframe was written, non-zero if it must be attempted
+ *     again later.
+ */
+int guac_display_write_keyframe(guac_display* display, guac_socket* socket);
+
+/**
+ * Frees all memory associated with the image cache of the given display,
+ * logging the number of hits and misses that occurred throughout the life of
+ * that cache.
+ *
+ * @param display
+ *     The display whose image cache should be freed.
+ */
+void guac_display_cache_free(guac_display* display);
+
+/**
+ * Applies the given GUAC_DISPLAY_PLAN_OPERATION_VIDEO operation, encoding the
+ * destination rect of that operation as the next frame of the video stream
+ * of the given display (starting that stream if necessary), or ending that
+ * stream and restoring its region as an image.
+ *
+ * @param display
+ *     The display whose video stream should be updated.
+ *
+ * @param op
+ *     The video operation to apply.
+ */
+void LFR_guac_display_video_handle_operation(guac_display* display,
+        const guac_display_plan_operation* op);
+
+/**
+ * Requests that any active video stream of the given display be ended and
+ * restarted, such that newly-joined users receive the stream from its
+ * beginning. As the set of users has changed, video streaming is also
+ * allowed to be attempted again if it had previously been blocked. The
+ * pending frame must be locked for writing.
+ *
+ * @param display
+ *     The display whose video stream should be restarted.
+ */
+void PFW_guac_display_video_restart(guac_display* display);
+
+/**
+ * Initializes the video stream state of the given display, which must
+ * otherwise have been zeroed. The video stream state must eventually be freed
+ * with guac_display_video_free().
+ *
+ * @param display
+ *     The display whose video stream state should be initialized.
+ */
+void guac_display_video_init(guac_display* display);
+
+/**
+ * Frees all resources associated with the video stream of the given display.
+ * The worker threads of the display must already have been stopped.
+ *
+ * @param display
+ *     The display whose video stream resources should be freed.
+ */
+void guac_display_video_free(guac_display* display);
+
+/**
+ * Pulls a single operation from the operation FIFO of the given guac_display,
+ * applying that operation by sending corresponding instructions to connected
+ * clients. If the FIFO still contains further operations after the operation
+ * has been pulled, the display is rescheduled within its worker pool such that
+ * other worker threads may handle those operations concurrently. If the FIFO
+ * is empty or has been invalidated, this function has no effect.
+ *
+ * @param display
+ *     The guac_display whose next pending operation should be handled.
+ */
+void guac_display_worker_process(guac_display* display);
+
+/**
+ * Acquires a reference to the process-wide worker pool on behalf of the given
+ * guac_display, creating that pool (and starting its threads) if it does not
+ * yet exist. The reference must eventually be released with a call to
+ * guac_display_worker_pool_release().
  *
- * @param data
- *     A pointer to the guac_display.
+ * @param display
+ *     The guac_display that will be submitting operations to the pool.
  *
  * @return
- *     Always NULL.
+ *     The process-wide worker pool.
+ */
+guac_display_worker_pool* guac_display_worker_pool_acquire(guac_display* display);
+
+/**
+ * Adds the given guac_display to the end of the run queue of its worker
+ * pool, such that the next available worker thread will handle the next
+ * operation within its ops FIFO. If the display is already within the run
+ * queue or its ops FIFO has been invalidated, this function has no effect.
+ *
+ * Displays are rescheduled after each operation is pulled, and thus worker
+ * threads are distributed between all displays with pending operations in a
+ * round-robin fashion.
+ *
+ * @param display
+ *     The guac_display to schedule.
+ */
+void guac_display_worker_pool_schedule(guac_display* display);
+
+/**
+ * Releases the reference to the process-wide worker pool held by the given
+ * guac_display, removing that display from the run queue and blocking until
+ * no worker thread is handling operations from that display. The ops FIFO of
+ * the display MUST already have been invalidated. If this is the last
+ * reference to the pool, all threads of the pool are stopped and the pool is
+ * freed.
+ *
+ * @param display
+ *     The guac_display whose reference to the worker pool should be released.
  */
-void* guac_display_worker_thread(void* data);
+void guac_display_worker_pool_release(guac_display* display);
 
 #endif
@@ -0,0 +1,568 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "display-plan.h"
+#include "display-priv.h"
+#include "encode-h264.h"
+#include "guacamole/client.h"
+#include "guacamole/display.h"
+#include "guacamole/layer.h"
+#include "guacamole/protocol.h"
+#include "guacamole/rect.h"
+#include "guacamole/rwlock.h"
+#include "guacamole/socket.h"
+#include "guacamole/stream.h"
+#include "guacamole/timestamp.h"
+#include "guacamole/user.h"
+
+#include <cairo/cairo.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Returns whether the given rect lies entirely within the given bounds.
+ *
+ * @param bounds
+ *     The bounds to test against.
+ *
+ * @param rect
+ *     The rect to test.
+ *
+ * @return
+ *     Non-zero if the given rect lies entirely within the given bounds, zero
+ *     otherwise.
+ */
+static int guac_display_video_rect_within(const guac_rect* bounds,
+        const guac_rect* rect) {
+    return rect->left   >= bounds->left
+        && rect->top    >= bounds->top
+        && rect->right  <= bounds->right
+        && rect->bottom <= bounds->bottom;
+}
+
+/**
+ * Returns the number of pixels within the given rect.
+ *
+ * @param rect
+ *     The rect to measure.
+ *
+ * @return
+ *     The number of pixels within the given rect.
+ */
+static size_t guac_display_video_rect_size(const guac_rect* rect) {
+    return (size_t) guac_rect_width(rect) * guac_rect_height(rect);
+}
+
+void guac_display_video_init(guac_display* display) {
+    pthread_mutex_init(&display->video.failed_lock, NULL);
+}
+
+void guac_display_set_video_streaming(guac_display* display, int enabled) {
+
+    guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
+    display->video.enabled = enabled;
+    guac_rwlock_release_lock(&display->pending_frame.lock);
+
+#ifndef ENABLE_VIDEO_STREAMING
+    if (enabled)
+        guac_client_log(display->client, GUAC_LOG_WARNING, "Video "
+                "streaming was requested, but libguac was built without "
+                "support for H.264 video streaming. Continuously-changing "
+                "regions of the display will be sent as images.");
+#endif
+
+}
+
+void PFW_guac_display_video_restart(guac_display* display) {
+
+    if (display->video.active)
+        display->video.restart = 1;
+
+    display->video.blocked = 0;
+
+}
+
+/**
+ * Drops all draw operations of the given plan that lie entirely within the
+ * region of the active video stream, adding a video operation to the plan if
+ * any part of that region has changed.
+ *
+ * @param plan
+ *     The plan to modify.
+ */
+static void PFW_guac_display_plan_update_video(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+    guac_display_video* video = &display->video;
+    guac_display_layer* default_layer = display->default_layer;
+
+    int changed = 0;
+
+    guac_display_plan_operation* op = plan->ops;
+    for (size_t i = 0; i < plan->length; i++, op++) {
+
+        if (op->layer != default_layer
+                || op->type != GUAC_DISPLAY_PLAN_OPERATION_IMG
+                || !guac_rect_intersects(&op->dest, &video->rect))
+            continue;
+
+        changed = 1;
+
+        /* Operations that only partially overlap the video are still drawn,
+         * as their contents are not otherwise sent */
+        if (guac_display_video_rect_within(&video->rect, &op->dest))
+            op->type = GUAC_DISPLAY_PLAN_OPERATION_NOP;
+
+    }
+
+    plan->video_rect = video->rect;
+
+    if (changed) {
+        plan->video_op.layer = default_layer;
+        plan->video_op.type = GUAC_DISPLAY_PLAN_OPERATION_VIDEO;
+        plan->video_op.dest = video->rect;
+        plan->video_op.current_frame = plan->frame_end;
+        plan->video_op.src.end_video = 0;
+    }
+
+}
+
+#ifdef ENABLE_VIDEO_STREAMING
+/**
+ * Callback for guac_client_foreach_user() which clears the int pointed to by
+ * the given data if the given user does not support H.264 video.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @param data
+ *     Pointer to an int that is non-zero if all users checked thus far
+ *     support H.264 video, zero otherwise.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_display_video_support_callback(guac_user* user, void* data) {
+
+    int* supported = (int*) data;
+    if (!*supported)
+        return NULL;
+
+    const char** mimetype = user->info.video_mimetypes;
+    if (mimetype != NULL) {
+        for (; *mimetype != NULL; mimetype++) {
+            if (strcmp(*mimetype, GUAC_H264_MIMETYPE) == 0)
+                return NULL;
+        }
+    }
+
+    *supported = 0;
+    return NULL;
+
+}
+
+/**
+ * Blocks any further attempt to stream video for the given display until the
+ * set of connected users changes.
+ *
+ * @param display
+ *     The display for which video streaming should be blocked.
+ */
+static void PFW_guac_display_video_block(guac_display* display) {
+
+    guac_display_video* video = &display->video;
+
+    video->blocked = 1;
+    video->blocked_users = display->client->connected_users;
+    video->candidate_frames = 0;
+
+}
+
+#endif
+
+void PFW_guac_display_plan_rewrite_as_video(guac_display_plan* plan) {
+
+#ifdef ENABLE_VIDEO_STREAMING
+    guac_display* display = plan->display;
+    guac_display_video* video = &display->video;
+    guac_display_layer* default_layer = display->default_layer;
+
+    /* The worker threads may have had to end the stream themselves, in which
+     * case the stream would likely fail again if restarted */
+    pthread_mutex_lock(&video->failed_lock);
+    int failed = video->failed;
+    video->failed = 0;
+    pthread_mutex_unlock(&video->failed_lock);
+
+    if (failed) {
+        video->active = 0;
+        video->restart = 0;
+        PFW_guac_display_video_block(display);
+    }
+
+    if (!video->enabled && !video->active)
+        return;
+
+    /* Locate all cells of the default layer that are changing rapidly */
+    guac_rect motion = { 0 };
+    size_t motion_size = 0;
+
+    guac_display_plan_operation* op = plan->ops;
+    for (size_t i = 0; i < plan->length; i++, op++) {
+
+        if (op->layer != default_layer
+                || op->type != GUAC_DISPLAY_PLAN_OPERATION_IMG)
+            continue;
+
+        guac_timestamp interval = op->current_frame - op->last_frame;
+        if (interval <= 0 || interval > 1000 / GUAC_DISPLAY_VIDEO_MIN_FRAMERATE)
+            continue;
+
+        if (motion_size == 0)
+            motion = op->dest;
+        else
+            guac_rect_extend(&motion, &op->dest);
+
+        motion_size += op->dirty_size;
+
+    }
+
+    guac_rect bounds = {
+        .left   = 0,
+        .top    = 0,
+        .right  = default_layer->pending_frame.width,
+        .bottom = default_layer->pending_frame.height
+    };
+
+    if (video->active) {
+
+        if (motion_size > 0 && guac_rect_intersects(&motion, &video->rect))
+            video->last_motion = plan->frame_end;
+
+        /* End the stream if it is no longer needed or can no longer be
+         * used, restoring its region as an image */
+        if (video->restart || !video->enabled
+                || default_layer->pending_frame.lossless
+                || !guac_display_video_rect_within(&bounds, &video->rect)
+                || plan->frame_end - video->last_motion > GUAC_DISPLAY_VIDEO_TIMEOUT) {
+
+            video->active = 0;
+            video->restart = 0;
+            video->candidate_frames = 0;
+
+            /* The client-side contents of the region remain stale until the
+             * end of the stream has been handled */
+            plan->video_rect = video->rect;
+
+            plan->video_op.layer = default_layer;
+            plan->video_op.type = GUAC_DISPLAY_PLAN_OPERATION_VIDEO;
+            plan->video_op.dest = video->rect;
+            plan->video_op.current_frame = plan->frame_end;
+            plan->video_op.src.end_video = 1;
+            return;
+
+        }
+
+        PFW_guac_display_plan_update_video(plan);
+        return;
+
+    }
+
+    video->restart = 0;
+
+    /* Do not retry video streaming until the set of users has changed */
+    if (video->blocked) {
+        if (display->client->connected_users == video->blocked_users)
+            return;
+        video->blocked = 0;
+    }
+
+    /* Track the region containing significant motion, starting over if that
+     * region moves or grows substantially (as when a window is dragged) */
+    if (motion_size >= GUAC_DISPLAY_VIDEO_MIN_PIXELS) {
+
+        guac_rect candidate = video->candidate;
+        guac_rect_extend(&candidate, &motion);
+
+        if (video->candidate_frames > 0
+                && plan->frame_end - video->last_motion <= GUAC_DISPLAY_VIDEO_TIMEOUT
+                && guac_display_video_rect_size(&candidate)
+                    <= guac_display_video_rect_size(&video->candidate) * 5 / 4) {
+            video->candidate = candidate;
+            video->candidate_frames++;
+        }
+
+        else {
+            video->candidate = motion;
+            video->candidate_frames = 1;
+        }
+
+        video->last_motion = plan->frame_end;
+
+    }
+
+    else if (plan->frame_end - video->last_motion > GUAC_DISPLAY_VIDEO_TIMEOUT)
+        video->candidate_frames = 0;
+
+    /* Stream only regions that have been in motion for a while, and only
+     * where lossy compression is acceptable */
+    if (video->candidate_frames < GUAC_DISPLAY_VIDEO_MIN_FRAMES
+            || default_layer->pending_frame.lossless
+            || !default_layer->opaque)
+        return;
+
+    /* Cover whole cells with the video, as the draw operations replaced by
+     * the video each cover all or part of a cell, additionally ensuring the
+     * dimensions of the video are even (as required by YUV 4:2:0) */
+    guac_rect rect = video->candidate;
+    guac_rect_align(&rect, GUAC_DISPLAY_CELL_SIZE_EXPONENT);
+    guac_rect_constrain(&rect, &bounds);
+    rect.right  -= guac_rect_width(&rect) & 1;
+    rect.bottom -= guac_rect_height(&rect) & 1;
+
+    video->candidate_frames = 0;
+
+    if (guac_rect_is_empty(&rect))
+        return;
+
+    /* Video can only be used if it can be played by all users, which must be
+     * verified before any draw operations are replaced by the video */
+    int supported = 1;
+    guac_client_foreach_user(display->client,
+            guac_display_video_support_callback, &supported);
+    if (!supported) {
+        guac_client_log(display->client, GUAC_LOG_DEBUG, "Not all users "
+                "support \"%s\". Continuously-changing regions will "
+                "continue to be sent as images.", GUAC_H264_MIMETYPE);
+        PFW_guac_display_video_block(display);
+        return;
+    }
+
+    video->active = 1;
+    video->rect = rect;
+    video->last_motion = plan->frame_end;
+
+    guac_client_log(display->client, GUAC_LOG_DEBUG, "Streaming %ix%i "
+            "region at (%i, %i) as video.", guac_rect_width(&rect),
+            guac_rect_height(&rect), rect.left, rect.top);
+
+    PFW_guac_display_plan_update_video(plan);
+#endif
+
+}
+
+#ifdef ENABLE_VIDEO_STREAMING
+/**
+ * Returns the target bitrate that should be used for a new video stream,
+ * based on the bandwidth measured for the image updates of the display. Half
+ * of the measured bandwidth is reserved for the video stream.
+ *
+ * @param display
+ *     The display that the video stream will be part of.
+ *
+ * @return
+ *     The target bitrate, in bits per second.
+ */
+static int64_t guac_display_video_bitrate(guac_display* display) {
+
+    guac_display_encoder_policy* policy = &display->encoder_policy;
+
+    pthread_mutex_lock(&policy->lock);
+    double bandwidth = policy->bandwidth;
+    pthread_mutex_unlock(&policy->lock);
+
+    if (bandwidth <= 0)
+        return GUAC_DISPLAY_VIDEO_DEFAULT_BITRATE;
+
+    /* Bandwidth is measured in bytes per millisecond */
+    int64_t bitrate = (int64_t) (bandwidth * 8000 / 2);
+
+    if (bitrate < GUAC_DISPLAY_VIDEO_MIN_BITRATE)
+        return GUAC_DISPLAY_VIDEO_MIN_BITRATE;
+
+    if (bitrate > GUAC_DISPLAY_VIDEO_MAX_BITRATE)
+        return GUAC_DISPLAY_VIDEO_MAX_BITRATE;
+
+    return bitrate;
+
+}
+
+/**
+ * Ends the video stream of the given display, if started, restoring the
+ * given region of the given layer as an image and freeing all resources
+ * associated with the stream.
+ *
+ * @param display
+ *     The display whose video stream should be ended.
+ *
+ * @param display_layer
+ *     The layer beneath the video stream.
+ *
+ * @param rect
+ *     The region of the layer covered by the video stream.
+ */
+static void LFR_guac_display_video_end(guac_display* display,
+        guac_display_layer* display_layer, const guac_rect* rect) {
+
+    guac_client* client = display->client;
+    guac_socket* socket = client->socket;
+    guac_display_video* video = &display->video;
+
+    /* Restore the region beneath the video, including the copy of that
+     * region retained client-side for the sake of copies */
+    unsigned char* buffer = GUAC_DISPLAY_LAYER_STATE_MUTABLE_BUFFER(display_layer->last_frame, *rect);
+    cairo_surface_t* surface = cairo_image_surface_create_for_data(buffer,
+            CAIRO_FORMAT_RGB24, guac_rect_width(rect), guac_rect_height(rect),
+            display_layer->last_frame.buffer_stride);
+
+    guac_client_stream_png(client, socket, GUAC_COMP_OVER,
+            display_layer->layer, rect->left, rect->top, surface);
+
+    guac_protocol_send_copy(socket, display_layer->layer,
+            rect->left, rect->top, guac_rect_width(rect), guac_rect_height(rect),
+            GUAC_COMP_OVER, display_layer->last_frame_buffer,
+            rect->left, rect->top);
+
+    cairo_surface_destroy(surface);
+
+    if (video->stream != NULL) {
+        guac_protocol_send_end(socket, video->stream);
+        guac_client_free_stream(client, video->stream);
+        video->stream = NULL;
+    }
+
+    if (video->layer != NULL) {
+        guac_protocol_send_dispose(socket, video->layer);
+        guac_client_free_layer(client, video->layer);
+        video->layer = NULL;
+    }
+
+    if (video->encoder != NULL) {
+        guac_h264_encoder_free(video->encoder);
+        video->encoder = NULL;
+    }
+
+}
+
+/**
+ * Starts a new video stream for the given display covering the given region
+ * of the default layer. If the video stream cannot be started, the stream
+ * members of the display are left NULL.
+ *
+ * @param display
+ *     The display whose video stream should be started.
+ *
+ * @param rect
+ *     The region of the default layer that should be covered by the video
+ *     stream.
+ *
+ * @return
+ *     Zero if the video stream was started successfully, non-zero otherwise.
+ */
+static int guac_display_video_start(guac_display* display,
+        const guac_rect* rect) {
+
+    guac_client* client = display->client;
+    guac_socket* socket = client->socket;
+    guac_display_video* video = &display->video;
+
+    int width = guac_rect_width(rect);
+    int height = guac_rect_height(rect);
+
+    video->encoder = guac_h264_encoder_alloc(width, height,
+            guac_display_video_bitrate(display));
+
+    if (video->encoder == NULL) {
+        guac_client_log(client, GUAC_LOG_WARNING, "No H.264 encoder could "
+                "be initialized. Region will continue to be sent as images "
+                "until the set of users changes.");
+        return 1;
+    }
+
+    /* Play the video on a dedicated layer directly above the region */
+    video->layer = guac_client_alloc_layer(client);
+    video->stream = guac_client_alloc_stream(client);
+
+    guac_protocol_send_size(socket, video->layer, width, height);
+    guac_protocol_send_move(socket, video->layer, GUAC_DEFAULT_LAYER,
+            rect->left, rect->top, 0);
+    guac_protocol_send_video(socket, video->stream, video->layer,
+            GUAC_H264_MIMETYPE);
+
+    return 0;
+
+}
+#endif
+
+void LFR_guac_display_video_handle_operation(guac_display* display,
+        const guac_display_plan_operation* op) {
+
+#ifdef ENABLE_VIDEO_STREAMING
+    guac_client* client = display->client;
+    guac_display_video* video = &display->video;
+    guac_display_layer* display_layer = op->layer;
+    const guac_rect* rect = &op->dest;
+
+    if (op->src.end_video) {
+        LFR_guac_display_video_end(display, display_layer, rect);
+        return;
+    }
+
+    /* Start the stream with its first frame */
+    if (video->encoder == NULL && guac_display_video_start(display, rect)) {
+        LFR_guac_display_video_end(display, display_layer, rect);
+        pthread_mutex_lock(&video->failed_lock);
+        video->failed = 1;
+        pthread_mutex_unlock(&video->failed_lock);
+        return;
+    }
+
+    const unsigned char* buffer = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(display_layer->last_frame, *rect);
+    int length = guac_h264_encoder_write(video->encoder, client->socket,
+            video->stream, buffer, display_layer->last_frame.buffer_stride,
+            op->current_frame);
+
+    if (length < 0) {
+        guac_client_log(client, GUAC_LOG_WARNING, "Encoding of video "
+                "frame failed. Region will continue to be sent as images.");
+        LFR_guac_display_video_end(display, display_layer, rect);
+        pthread_mutex_lock(&video->failed_lock);
+        video->failed = 1;
+        pthread_mutex_unlock(&video->failed_lock);
+    }
+#endif
+
+}
+
+void guac_display_video_free(guac_display* display) {
+
+    guac_display_video* video = &display->video;
+
+#ifdef ENABLE_VIDEO_STREAMING
+    if (video->encoder != NULL)
+        guac_h264_encoder_free(video->encoder);
+#endif
+
+    video->encoder = NULL;
+    pthread_mutex_destroy(&video->failed_lock);
+
+}
+
@@ -0,0 +1,363 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "display-priv.h"
+#include "guacamole/client.h"
+#include "guacamole/display.h"
+#include "guacamole/fifo.h"
+#include "guacamole/flag.h"
+#include "guacamole/mem.h"
+
+#ifdef __MINGW32__
+#include <winbase.h>
+#endif
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+/**
+ * The number of worker threads to create per processor.
+ */
+#define GUAC_DISPLAY_CPU_THREAD_FACTOR 1
+
+/**
+ * The maximum number of worker threads that the process-wide worker pool may
+ * create, as set by guac_display_set_max_worker_threads(). If zero, the
+ * number of worker threads is determined solely by the number of available
+ * processors.
+ */
+static int guac_display_max_worker_threads = 0;
+
+/**
+ * The process-wide worker pool shared by all guac_display instances, or NULL
+ * if no guac_display currently exists.
+ */
+static guac_display_worker_pool* guac_display_worker_pool_instance = NULL;
+
+/**
+ * Lock which guards creation and destruction of the process-wide worker pool,
+ * as well as the reference count of that pool and the configured maximum
+ * number of worker threads.
+ */
+static pthread_mutex_t guac_display_worker_pool_instance_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Returns the number of processors available to this process. If possible,
+ * limits on otherwise available processors like CPU affinity will be taken
+ * into account. If the number of available processors cannot be determined,
+ * zero is returned.
+ *
+ * @return
+ *     The number of available processors, or zero if this value cannot be
+ *     determined for any reason.
+ */
+static unsigned long guac_display_nproc() {
+
+#if defined(HAVE_SCHED_GETAFFINITY)
+
+    /* Linux, etc. implementation leveraging sched_getaffinity() (this is
+     * specific to glibc and MUSL libc and is non-portable) */
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        long cpu_count = CPU_COUNT(&cpu_set);
+        if (cpu_count > 0)
+            return cpu_count;
+    }
+
+#elif defined(_SC_NPROCESSORS_ONLN)
+
+    /* Linux, etc. implementation leveraging sysconf() and _SC_NPROCESSORS_ONLN
+     * (which is also non-portable) */
+
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count > 0)
+        return cpu_count;
+
+#elif defined(__MINGW32__)
+
+    /* Windows-specific implementation (clearly also non-portable) */
+
+    unsigned long cpu_count = 0;
+    DWORD_PTR process_mask, system_mask;
+    for (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+            process_mask != 0; process_mask >>= 1) {
+
+        if (process_mask & 1)
+                cpu_count++;
+
+    }
+
+    if (cpu_count > 0)
+        return cpu_count;
+
+#else
+
+    /* Fallback implementation that does not query the number of CPUs available
+     * at all, returning an error code (as portable as it gets) */
+
+    long cpu_count = 0;
+
+#endif
+
+    return 0;
+
+}
+
+/**
+ * Worker thread that continuously pulls displays from the run queue of the
+ * given guac_display_worker_pool, handling one pending operation of each
+ * display pulled.
+ *
+ * @param data
+ *     A pointer to the guac_display_worker_pool.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_display_worker_pool_thread(void* data) {
+
+    guac_display_worker_pool* pool = (guac_display_worker_pool*) data;
+
+    for (;;) {
+
+        guac_flag_wait_and_lock(&pool->state,
+                GUAC_DISPLAY_WORKER_POOL_STATE_NONEMPTY
+                | GUAC_DISPLAY_WORKER_POOL_STATE_STOPPING);
+
+        if (pool->state.value & GUAC_DISPLAY_WORKER_POOL_STATE_STOPPING) {
+            guac_flag_unlock(&pool->state);
+            break;
+        }
+
+        /* Pull next display from head of run queue */
+        guac_display* display = pool->head;
+        pool->head = display->worker_pool_next;
+        pool->length--;
+
+        if (pool->head == NULL) {
+            pool->tail = NULL;
+            guac_flag_clear(&pool->state, GUAC_DISPLAY_WORKER_POOL_STATE_NONEMPTY);
+        }
+
+        /* NOTE: The display cannot be freed while worker_pool_active is
+         * non-zero, as guac_display_worker_pool_release() waits for this
+         * value to reach zero */
+        display->worker_pool_next = NULL;
+        display->worker_pool_scheduled = 0;
+        display->worker_pool_active++;
+
+        guac_flag_unlock(&pool->state);
+
+        guac_display_worker_process(display);
+
+        /* The display must not be referenced after this point */
+        guac_flag_lock(&pool->state);
+        display->worker_pool_active--;
+        pthread_cond_broadcast(&pool->display_released);
+        guac_flag_unlock(&pool->state);
+
+    }
+
+    return NULL;
+
+}
+
+void guac_display_set_max_worker_threads(int max_threads) {
+    pthread_mutex_lock(&guac_display_worker_pool_instance_lock);
+    guac_display_max_worker_threads = max_threads > 0 ? max_threads : 0;
+    pthread_mutex_unlock(&guac_display_worker_pool_instance_lock);
+}
+
+guac_display_worker_pool* guac_display_worker_pool_acquire(guac_display* display) {
+
+    guac_client* client = display->client;
+
+    pthread_mutex_lock(&guac_display_worker_pool_instance_lock);
+
+    /* Reuse existing pool if other displays already exist */
+    guac_display_worker_pool* pool = guac_display_worker_pool_instance;
+    if (pool != NULL) {
+
+        guac_flag_lock(&pool->state);
+        pool->ref_count++;
+        guac_flag_unlock(&pool->state);
+
+        guac_client_log(client, GUAC_LOG_DEBUG, "Graphical updates will be "
+                "encoded using the existing pool of %i worker thread(s).",
+                pool->thread_count);
+
+        pthread_mutex_unlock(&guac_display_worker_pool_instance_lock);
+        return pool;
+
+    }
+
+    int cpu_count = guac_display_nproc();
+    if (cpu_count <= 0) {
+        guac_client_log(client, GUAC_LOG_WARNING, "Number of available "
+                "processors could not be determined. Assuming single-processor.");
+        cpu_count = 1;
+    }
+    else {
+        guac_client_log(client, GUAC_LOG_INFO, "Local system reports %i "
+                "processor(s) are available.", cpu_count);
+    }
+
+    int thread_count = cpu_count * GUAC_DISPLAY_CPU_THREAD_FACTOR;
+    if (guac_display_max_worker_threads > 0
+            && thread_count > guac_display_max_worker_threads) {
+        guac_client_log(client, GUAC_LOG_INFO, "Number of worker threads is "
+                "limited to %i by configuration.",
+                guac_display_max_worker_threads);
+        thread_count = guac_display_max_worker_threads;
+    }
+
+    pool = guac_mem_zalloc(sizeof(guac_display_worker_pool));
+    guac_flag_init(&pool->state);
+    pthread_cond_init(&pool->display_released, NULL);
+    pool->ref_count = 1;
+    pool->thread_count = thread_count;
+    pool->threads = guac_mem_alloc(thread_count, sizeof(pthread_t));
+
+    guac_client_log(client, GUAC_LOG_INFO, "Graphical updates will be encoded "
+            "using %i worker thread(s).", pool->thread_count);
+
+    for (int i = 0; i < pool->thread_count; i++)
+        pthread_create(&(pool->threads[i]), NULL, guac_display_worker_pool_thread, pool);
+
+    guac_display_worker_pool_instance = pool;
+    pthread_mutex_unlock(&guac_display_worker_pool_instance_lock);
+
+    return pool;
+
+}
+
+void guac_display_worker_pool_schedule(guac_display* display) {
+
+    guac_display_worker_pool* pool = display->worker_pool;
+    guac_flag_lock(&pool->state);
+
+    /* Add to end of run queue only if not already present and only if there
+     * may actually be operations to handle */
+    if (!display->worker_pool_scheduled && guac_fifo_is_valid(&display->ops)) {
+
+        display->worker_pool_next = NULL;
+        display->worker_pool_scheduled = 1;
+
+        if (pool->tail != NULL)
+            pool->tail->worker_pool_next = display;
+        else
+            pool->head = display;
+
+        pool->tail = display;
+
+        pool->length++;
+        if (pool->length > pool->peak_length)
+            pool->peak_length = pool->length;
+
+        guac_flag_set(&pool->state, GUAC_DISPLAY_WORKER_POOL_STATE_NONEMPTY);
+
+    }
+
+    guac_flag_unlock(&pool->state);
+
+}
+
+void guac_display_worker_pool_release(guac_display* display) {
+
+    guac_client* client = display->client;
+    guac_display_worker_pool* pool = display->worker_pool;
+
+    guac_flag_lock(&pool->state);
+
+    /* Wait for all workers to finish with this display. The condition being
+     * waited for is specific to this display, thus concurrent releases of
+     * other displays cannot consume the wakeup intended for this one. */
+    while (display->worker_pool_active)
+        pthread_cond_wait(&pool->display_released, &pool->state.value_mutex);
+
+    /* Remove from run queue if still present (no further scheduling can occur
+     * as the ops FIFO has already been invalidated) */
+    if (display->worker_pool_scheduled) {
+
+        guac_display* prev = NULL;
+        guac_display* current = pool->head;
+        while (current != display) {
+            prev = current;
+            current = current->worker_pool_next;
+        }
+
+        if (prev != NULL)
+            prev->worker_pool_next = display->worker_pool_next;
+        else
+            pool->head = display->worker_pool_next;
+
+        if (pool->tail == display)
+            pool->tail = prev;
+
+        pool->length--;
+        if (pool->head == NULL)
+            guac_flag_clear(&pool->state, GUAC_DISPLAY_WORKER_POOL_STATE_NONEMPTY);
+
+        display->worker_pool_next = NULL;
+        display->worker_pool_scheduled = 0;
+
+    }
+
+    /* NOTE: No worker can be accessing the ops FIFO of this display at this
+     * point, thus the statistics within the display are stable */
+    guac_client_log(client, GUAC_LOG_DEBUG, "Display worker statistics: "
+            "%" PRIu64 " operation(s) encoded, peak operation queue depth "
+            "%zu, peak display run queue depth %u.",
+            display->worker_ops_processed, display->worker_ops_peak_depth,
+            pool->peak_length);
+
+    guac_flag_unlock(&pool->state);
+
+    pthread_mutex_lock(&guac_display_worker_pool_instance_lock);
+
+    guac_flag_lock(&pool->state);
+    int last_reference = (--pool->ref_count == 0);
+    guac_flag_unlock(&pool->state);
+
+    /* Stop and clean up worker threads if no other display uses this pool */
+    if (last_reference) {
+
+        guac_flag_set(&pool->state, GUAC_DISPLAY_WORKER_POOL_STATE_STOPPING);
+
+        for (int i = 0; i < pool->thread_count; i++)
+            pthread_join(pool->threads[i], NULL);
+
+        pthread_cond_destroy(&pool->display_released);
+        guac_flag_destroy(&pool->state);
+        guac_mem_free(pool->threads);
+        guac_mem_free(pool);
+
+        guac_display_worker_pool_instance = NULL;
+
+    }
+
+    pthread_mutex_unlock(&guac_display_worker_pool_instance_lock);
+
+}
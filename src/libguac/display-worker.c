@@ -17,8 +17,13 @@
  * under the License.
  */
 
+#include "config.h"
+#include "display-encoder.h"
 #include "display-plan.h"
 #include "display-priv.h"
+#include "encode-jpeg.h"
+#include "encode-png.h"
+#include "encode-webp.h"
 #include "guacamole/client.h"
 #include "guacamole/display.h"
 #include "guacamole/fifo.h"
@@ -28,12 +33,20 @@
 #include "guacamole/rect.h"
 #include "guacamole/rwlock.h"
 #include "guacamole/socket.h"
+#include "guacamole/stream.h"
 #include "guacamole/timestamp.h"
+#include "guacamole/user.h"
 
 #include <inttypes.h>
 #include <limits.h>
 #include <cairo/cairo.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
 
 /**
  * Returns a new Cairo surface representing the contents of the given dirty
@@ -227,12 +240,16 @@ static int LFR_guac_display_layer_png_optimality(guac_display_layer* layer,
  *     The rate that the region covered by the given rectangle has historically
  *     been being updated within the given layer, in frames per second.
  *
+ * @param png_optimality
+ *     The value returned by LFR_guac_display_layer_png_optimality() for the
+ *     given rectangle.
+ *
  * @return
  *     Non-zero if the rectangle would be optimally encoded as JPEG, zero
  *     otherwise.
  */
 static int LFR_guac_display_layer_should_use_jpeg(guac_display_layer* layer,
-        const guac_rect* rect, int framerate) {
+        const guac_rect* rect, int framerate, int png_optimality) {
 
     /* Do not use JPEG if lossless quality is required */
     if (layer->last_frame.lossless)
@@ -248,7 +265,7 @@ static int LFR_guac_display_layer_should_use_jpeg(guac_display_layer* layer,
      * - PNG is not more optimal based on image contents */
     return framerate >= GUAC_DISPLAY_JPEG_FRAMERATE
         && rect_size > GUAC_DISPLAY_JPEG_MIN_BITMAP_SIZE
-        && LFR_guac_display_layer_png_optimality(layer, rect) < 0;
+        && png_optimality < 0;
 
 }
 
@@ -266,12 +283,16 @@ static int LFR_guac_display_layer_should_use_jpeg(guac_display_layer* layer,
  *     The rate that the region covered by the given rectangle has historically
  *     been being updated within the given layer, in frames per second.
  *
+ * @param png_optimality
+ *     The value returned by LFR_guac_display_layer_png_optimality() for the
+ *     given rectangle.
+ *
  * @return
  *     Non-zero if the rectangle would be optimally encoded as WebP, zero
  *     otherwise.
  */
 static int LFR_guac_display_layer_should_use_webp(guac_display_layer* layer,
-        const guac_rect* rect, int framerate) {
+        const guac_rect* rect, int framerate, int png_optimality) {
 
     /* Do not use WebP if not supported */
     if (!guac_client_supports_webp(layer->display->client))
@@ -281,21 +302,280 @@ static int LFR_guac_display_layer_should_use_webp(guac_display_layer* layer,
      * - frame rate is high enough
      * - PNG is not more optimal based on image contents */
     return framerate >= GUAC_DISPLAY_JPEG_FRAMERATE
-        && LFR_guac_display_layer_png_optimality(layer, rect) < 0;
+        && png_optimality < 0;
 
 }
 
-void* guac_display_worker_thread(void* data) {
+/**
+ * Returns the current value of a monotonic clock, in microseconds. This clock
+ * is used only to measure the time spent encoding images.
+ *
+ * @return
+ *     The current value of a monotonic clock, in microseconds.
+ */
+static uint64_t guac_display_worker_usec() {
+
+#ifdef HAVE_CLOCK_GETTIME
+
+    struct timespec current;
+
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &current);
+#else
+    clock_gettime(CLOCK_REALTIME, &current);
+#endif
+
+    return (uint64_t) current.tv_sec * 1000000 + current.tv_nsec / 1000;
+
+#else
+
+    struct timeval current;
+    gettimeofday(&current, NULL);
+
+    return (uint64_t) current.tv_sec * 1000000 + current.tv_usec;
+
+#endif
+
+}
+
+/**
+ * Streams the given surface to the given layer using the given format and
+ * quality, returning the number of bytes of encoded image data sent.
+ *
+ * @param client
+ *     The client that should allocate the stream used.
+ *
+ * @param socket
+ *     The socket to send the image over.
+ *
+ * @param layer
+ *     The layer that should receive the image.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle
+ *     within the given layer.
+ *
+ * @param surface
+ *     The Cairo surface containing the image to send.
+ *
+ * @param choice
+ *     The format and quality that should be used to encode the image.
+ *
+ * @return
+ *     The number of bytes of encoded image data sent, or a negative value if
+ *     encoding failed.
+ */
+static int guac_display_worker_stream_image(guac_client* client,
+        guac_socket* socket, const guac_layer* layer, int x, int y,
+        cairo_surface_t* surface, const guac_display_encoder_choice* choice) {
+
+    int length;
+
+    guac_stream* stream = guac_client_alloc_stream(client);
+
+    switch (choice->format) {
+
+#ifdef ENABLE_WEBP
+        case GUAC_DISPLAY_ENCODER_WEBP:
+        case GUAC_DISPLAY_ENCODER_WEBP_LOSSLESS:
+            guac_protocol_send_img(socket, stream, GUAC_COMP_OVER, layer, "image/webp", x, y);
+            length = guac_webp_write(socket, stream, surface, choice->quality,
+                    choice->format == GUAC_DISPLAY_ENCODER_WEBP_LOSSLESS);
+            break;
+#endif
+
+        case GUAC_DISPLAY_ENCODER_JPEG:
+            guac_protocol_send_img(socket, stream, GUAC_COMP_OVER, layer, "image/jpeg", x, y);
+            length = guac_jpeg_write(socket, stream, surface, choice->quality);
+            break;
+
+        default:
+            guac_protocol_send_img(socket, stream, GUAC_COMP_OVER, layer, "image/png", x, y);
+            length = guac_png_write(socket, stream, surface);
+            break;
+
+    }
+
+    guac_protocol_send_end(socket, stream);
+    guac_client_free_stream(client, stream);
+
+    return length;
+
+}
+
+/**
+ * Callback for guac_client_foreach_user() which locates the user that has
+ * acknowledged the oldest frame, such that the bandwidth estimate reflects
+ * the slowest connected user.
+ *
+ * @param user
+ *     The user being checked.
+ *
+ * @param data
+ *     A pointer to the guac_user pointer that should be updated if the given
+ *     user has acknowledged an older frame than the user currently pointed
+ *     to.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_display_worker_find_slowest_user(guac_user* user, void* data) {
+
+    guac_user** slowest = (guac_user**) data;
+
+    if (*slowest == NULL
+            || user->last_received_timestamp < (*slowest)->last_received_timestamp)
+        *slowest = user;
+
+    return NULL;
+
+}
+
+/**
+ * Handles a single operation pulled from the operation FIFO of the given
+ * display, sending any resulting instructions to connected users. The
+ * last_frame lock of the display MUST already be held for reading.
+ *
+ * @param display
+ *     The display that the operation was pulled from.
+ *
+ * @param op
+ *     The operation to handle.
+ */
+static void LFR_guac_display_worker_handle_operation(guac_display* display,
+        guac_display_plan_operation* op) {
 
     int framerate;
-    int has_outstanding_frames = 0;
 
-    guac_display* display = (guac_display*) data;
     guac_client* client = display->client;
     guac_socket* socket = client->socket;
+    guac_display_layer* display_layer = op->layer;
+
+    switch (op->type) {
+
+        case GUAC_DISPLAY_PLAN_OPERATION_IMG:
+
+            framerate = INT_MAX;
+            if (op->current_frame > op->last_frame)
+                framerate = 1000 / (op->current_frame - op->last_frame);
+
+            guac_rect* dirty = &op->dest;
+
+            cairo_surface_t* rect = LFR_guac_display_layer_cairo_rect(display_layer, dirty);
+            const guac_layer* layer = display_layer->layer;
+
+            int png_optimality = LFR_guac_display_layer_png_optimality(display_layer, dirty);
+            int lossless = display_layer->last_frame.lossless;
+
+            guac_display_encoder_request request = {
+                .pixels = guac_rect_width(dirty) * guac_rect_height(dirty),
+                .content = png_optimality < 0
+                    ? GUAC_DISPLAY_ENCODER_CONTENT_COMPLEX
+                    : GUAC_DISPLAY_ENCODER_CONTENT_SIMPLE,
+                .framerate = framerate,
+                .lossless = lossless,
+                .jpeg_allowed = display_layer->opaque,
+                .webp_allowed = guac_client_supports_webp(client),
+                .static_format = GUAC_DISPLAY_ENCODER_PNG,
+                .static_quality = guac_display_suggest_quality(client)
+            };
+
+            /* Prefer WebP when reasonable */
+            if (LFR_guac_display_layer_should_use_webp(display_layer, dirty, framerate, png_optimality))
+                request.static_format = lossless
+                    ? GUAC_DISPLAY_ENCODER_WEBP_LOSSLESS
+                    : GUAC_DISPLAY_ENCODER_WEBP;
+
+            /* If not WebP, JPEG is the next best (lossy) choice */
+            else if (display_layer->opaque && LFR_guac_display_layer_should_use_jpeg(display_layer, dirty, framerate, png_optimality))
+                request.static_format = GUAC_DISPLAY_ENCODER_JPEG;
+
+            /* Refine the static choice above using the measured cost of each
+             * format and the measured state of the network */
+            guac_display_encoder_choice choice;
+            guac_display_encoder_choose(&display->encoder_policy, &request, &choice);
+
+            /* Clear relevant rect of destination layer if necessary to
+             * ensure fresh data is not drawn on top of old data for layers
+             * with alpha transparency */
+            guac_display_layer_clear_non_opaque(display_layer, dirty);
+
+            uint64_t encode_start = guac_display_worker_usec();
+            int length = guac_display_worker_stream_image(client, socket,
+                    layer, dirty->left, dirty->top, rect, &choice);
+
+            guac_display_encoder_record(&display->encoder_policy,
+                    request.content, choice.format, choice.quality,
+                    request.pixels, length,
+                    guac_display_worker_usec() - encode_start);
+
+            cairo_surface_destroy(rect);
+            break;
+
+        case GUAC_DISPLAY_PLAN_OPERATION_VIDEO:
+            LFR_guac_display_video_handle_operation(display, op);
+            break;
+
+        case GUAC_DISPLAY_PLAN_OPERATION_COPY:
+        case GUAC_DISPLAY_PLAN_OPERATION_RECT:
+            guac_client_log(client, GUAC_LOG_DEBUG, "Operation type %i "
+                    "should NOT be present in the set of operations given "
+                    "to guac_display worker thread. All operations except "
+                    "IMG and NOP are handled during the initial, "
+                    "single-threaded flush step. This is likely a bug.",
+                    op->type);
+            break;
+
+        case GUAC_DISPLAY_PLAN_OPERATION_NOP:
+            /* Do nothing */
+            break;
 
-    guac_display_plan_operation op;
-    while (guac_fifo_dequeue_and_lock(&display->ops, &op)) {
+    }
+
+}
+
+void guac_display_worker_process(guac_display* display) {
+
+    int has_outstanding_frames = 0;
+
+    guac_client* client = display->client;
+
+    /* Pull no more than this worker's fair share of the pending operations,
+     * such that other workers may handle the remainder in parallel */
+    guac_fifo_lock(&display->ops);
+    size_t max_ops = display->ops.item_count / display->worker_pool->thread_count;
+    if (max_ops < 1)
+        max_ops = 1;
+    else if (max_ops > GUAC_DISPLAY_WORKER_MAX_BATCH)
+        max_ops = GUAC_DISPLAY_WORKER_MAX_BATCH;
+
+    /* Pull the next operations without waiting (other workers may have
+     * already handled all operations that were pending when the display was
+     * scheduled) */
+    guac_display_plan_operation ops[GUAC_DISPLAY_WORKER_MAX_BATCH];
+    size_t op_count = guac_fifo_timed_dequeue_batch_and_lock(&display->ops,
+            ops, max_ops, 0);
+
+    /* Release the lock acquired above to determine the batch size (the lock
+     * is still held if any operations were pulled) */
+    guac_fifo_unlock(&display->ops);
+
+    if (op_count > 0) {
+
+        /* Track how deep the queue of operations has become */
+        display->worker_ops_processed += op_count;
+        if (display->ops.item_count + op_count > display->worker_ops_peak_depth)
+            display->worker_ops_peak_depth = display->ops.item_count + op_count;
+
+        /* Allow other workers to handle any further operations in parallel,
+         * after any other displays with pending operations have had their
+         * turn */
+        if (display->ops.state.value & GUAC_FIFO_STATE_NONEMPTY)
+            guac_display_worker_pool_schedule(display);
 
         /* Notify any watchers of render_state that a frame is now in progress */
         guac_flag_set_and_lock(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS);
@@ -309,78 +589,8 @@ void* guac_display_worker_thread(void* data) {
         guac_fifo_unlock(&display->ops);
 
         guac_rwlock_acquire_read_lock(&display->last_frame.lock);
-        guac_display_layer* display_layer = op.layer;
-        switch (op.type) {
-
-            case GUAC_DISPLAY_PLAN_OPERATION_IMG:
-
-                framerate = INT_MAX;
-                if (op.current_frame > op.last_frame)
-                    framerate = 1000 / (op.current_frame - op.last_frame);
-
-                guac_rect* dirty = &op.dest;
-
-                /* TODO: Determine whether to use PNG/WebP/JPEG purely
-                 * based on whether lossless encoding is required, the
-                 * expected time until another frame is received (time
-                 * since last frame), and estimated encoding times. The
-                 * time allowed per update should be divided up
-                 * proportionately based on the dirty_size of the update. */
-
-                /* TODO: Stream PNG/WebP/JPEG using progressive encoding such
-                 * that a frame that is currently being encoded can be
-                 * preempted by the next frame, with the connected client then
-                 * simply receiving a lower-quality intermediate frame. If
-                 * necessary, progressive encoding can be achieved by manually
-                 * dividing images into multiple reduced-resolution stages,
-                 * such that each image streamed is actually only one quarter
-                 * the size of the original image. Compositing via Guacamole
-                 * protocol instructions can reassemble those stages. */
-
-                cairo_surface_t* rect = LFR_guac_display_layer_cairo_rect(display_layer, dirty);
-                const guac_layer* layer = display_layer->layer;
-
-                /* Clear relevant rect of destination layer if necessary to
-                 * ensure fresh data is not drawn on top of old data for layers
-                 * with alpha transparency */
-                guac_display_layer_clear_non_opaque(display_layer, dirty);
-
-                /* Prefer WebP when reasonable */
-                if (LFR_guac_display_layer_should_use_webp(display_layer, dirty, framerate))
-                    guac_client_stream_webp(client, socket, GUAC_COMP_OVER, layer,
-                            dirty->left, dirty->top, rect,
-                            guac_display_suggest_quality(client),
-                            display_layer->last_frame.lossless ? 1 : 0);
-
-                /* If not WebP, JPEG is the next best (lossy) choice */
-                else if (display_layer->opaque && LFR_guac_display_layer_should_use_jpeg(display_layer, dirty, framerate))
-                    guac_client_stream_jpeg(client, socket, GUAC_COMP_OVER, layer,
-                            dirty->left, dirty->top, rect,
-                            guac_display_suggest_quality(client));
-
-                /* Use PNG if no lossy formats are appropriate */
-                else
-                    guac_client_stream_png(client, socket, GUAC_COMP_OVER,
-                            layer, dirty->left, dirty->top, rect);
-
-                cairo_surface_destroy(rect);
-                break;
-
-            case GUAC_DISPLAY_PLAN_OPERATION_COPY:
-            case GUAC_DISPLAY_PLAN_OPERATION_RECT:
-                guac_client_log(client, GUAC_LOG_DEBUG, "Operation type %i "
-                        "should NOT be present in the set of operations given "
-                        "to guac_display worker thread. All operations except "
-                        "IMG and NOP are handled during the initial, "
-                        "single-threaded flush step. This is likely a bug.",
-                        op.type);
-                break;
-
-            case GUAC_DISPLAY_PLAN_OPERATION_NOP:
-                /* Do nothing */
-                break;
-
-        }
+        for (size_t i = 0; i < op_count; i++)
+            LFR_guac_display_worker_handle_operation(display, &ops[i]);
 
         guac_fifo_lock(&display->ops);
 
@@ -404,6 +614,22 @@ void* guac_display_worker_thread(void* data) {
             /* Allow connected clients to move forward with rendering */
             guac_client_end_multiple_frames(client, display->last_frame.frames);
 
+            /* Track the size of this frame until it is acknowledged, using
+             * the most recent acknowledgement from the slowest user to
+             * refine the bandwidth estimate. The raw round trip of that
+             * acknowledgement is the lag-compensated baseline stored in
+             * last_frame_duration plus the processing lag that was excluded
+             * from it (see __guac_handle_sync()). */
+            guac_user* slowest = NULL;
+            guac_client_foreach_user(client, guac_display_worker_find_slowest_user, &slowest);
+            if (slowest != NULL)
+                guac_display_encoder_ack_frame(&display->encoder_policy,
+                        slowest->last_received_timestamp,
+                        slowest->last_frame_duration + slowest->processing_lag);
+
+            guac_display_encoder_end_frame(&display->encoder_policy,
+                    client->last_sent_timestamp);
+
             /* While connected clients moves forward with rendering,
              * commit any changed contents to client-side backing buffer */
             guac_display_layer* current = display->last_frame.layers;
@@ -437,6 +663,9 @@ void* guac_display_worker_thread(void* data) {
 
             }
 
+            /* Populate the image cache with any tiles drawn in this frame */
+            LFR_guac_display_cache_commit(display);
+
             /* This is now absolutely everything for the current frame,
              * and it's safe to flush any outstanding data */
             guac_socket_flush(client->socket);
@@ -446,10 +675,25 @@ void* guac_display_worker_thread(void* data) {
             guac_flag_clear(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS);
             guac_flag_unlock(&display->render_state);
 
+            display->progressive = 0;
             has_outstanding_frames = display->frame_deferred;
 
         }
 
+        /* If the frame is being delivered progressively and is taking a
+         * while, allow connected clients to render the tiles that have been
+         * completed so far */
+        else if (display->progressive) {
+
+            guac_timestamp now = guac_timestamp_current();
+            if (now - display->last_progressive_sync >= GUAC_DISPLAY_PROGRESSIVE_INTERVAL) {
+                guac_client_end_multiple_frames(client, 0);
+                guac_socket_flush(client->socket);
+                display->last_progressive_sync = now;
+            }
+
+        }
+
         display->active_workers--;
         guac_fifo_unlock(&display->ops);
 
@@ -457,13 +701,9 @@ void* guac_display_worker_thread(void* data) {
 
         /* Trigger additional flush if frames were completed while we were
          * still processing the previous frame */
-        if (has_outstanding_frames) {
+        if (has_outstanding_frames)
             guac_display_end_multiple_frames(display, 0);
-            has_outstanding_frames = 0;
-        }
 
     }
 
-    return NULL;
-
 }
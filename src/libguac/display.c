@@ -31,85 +31,11 @@
 #include "guacamole/socket.h"
 #include "guacamole/timestamp.h"
 #include "guacamole/user.h"
-
-#ifdef __MINGW32__
-#include <winbase.h>
-#endif
+#include "socket-async.h"
 
 #include <cairo/cairo.h>
+#include <inttypes.h>
 #include <pthread.h>
-#include <sched.h>
-#include <unistd.h>
-
-/**
- * The number of worker threads to create per processor.
- */
-#define GUAC_DISPLAY_CPU_THREAD_FACTOR 1
-
-/**
- * Returns the number of processors available to this process. If possible,
- * limits on otherwise available processors like CPU affinity will be taken
- * into account. If the number of available processors cannot be determined,
- * zero is returned.
- *
- * @return
- *     The number of available processors, or zero if this value cannot be
- *     determined for any reason.
- */
-static unsigned long guac_display_nproc() {
-
-#if defined(HAVE_SCHED_GETAFFINITY)
-
-    /* Linux, etc. implementation leveraging sched_getaffinity() (this is
-     * specific to glibc and MUSL libc and is non-portable) */
-
-    cpu_set_t cpu_set;
-    CPU_ZERO(&cpu_set);
-
-    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
-        long cpu_count = CPU_COUNT(&cpu_set);
-        if (cpu_count > 0)
-            return cpu_count;
-    }
-
-#elif defined(_SC_NPROCESSORS_ONLN)
-
-    /* Linux, etc. implementation leveraging sysconf() and _SC_NPROCESSORS_ONLN
-     * (which is also non-portable) */
-
-    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
-    if (cpu_count > 0)
-        return cpu_count;
-
-#elif defined(__MINGW32__)
-
-    /* Windows-specific implementation (clearly also non-portable) */
-
-    unsigned long cpu_count = 0;
-    DWORD_PTR process_mask, system_mask;
-    for (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
-            process_mask != 0; process_mask >>= 1) {
-
-        if (process_mask & 1)
-                cpu_count++;
-
-    }
-
-    if (cpu_count > 0)
-        return cpu_count;
-
-#else
-
-    /* Fallback implementation that does not query the number of CPUs available
-     * at all, returning an error code (as portable as it gets) */
-
-    long cpu_count = 0;
-
-#endif
-
-    return 0;
-
-}
 
 guac_display* guac_display_alloc(guac_client* client) {
 
@@ -128,6 +54,16 @@ guac_display* guac_display_alloc(guac_client* client) {
     display->default_layer = guac_display_add_layer(display, (guac_layer*) GUAC_DEFAULT_LAYER, 1);
     display->cursor_buffer = guac_display_alloc_buffer(display, 0);
 
+    /* Cache previously-sent tiles within the default budget unless
+     * overridden with guac_display_set_cache_size() */
+    display->cache.max_size = GUAC_DISPLAY_CACHE_DEFAULT_SIZE;
+
+    /* Init state of any video stream (no stream is yet active) */
+    guac_display_video_init(display);
+
+    /* Init policy used by worker threads to choose image formats */
+    guac_display_encoder_policy_init(&display->encoder_policy);
+
     /* Init operation FIFO used by worker threads */
     guac_fifo_init(&display->ops, display->ops_items,
             GUAC_DISPLAY_WORKER_FIFO_SIZE, sizeof(guac_display_plan_operation));
@@ -137,26 +73,9 @@ guac_display* guac_display_alloc(guac_client* client) {
     guac_flag_init(&display->render_state);
     guac_flag_set(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
 
-    int cpu_count = guac_display_nproc();
-    if (cpu_count <= 0) {
-        guac_client_log(client, GUAC_LOG_WARNING, "Number of available "
-                "processors could not be determined. Assuming single-processor.");
-        cpu_count = 1;
-    }
-    else {
-        guac_client_log(client, GUAC_LOG_INFO, "Local system reports %i "
-                "processor(s) are available.", cpu_count);
-    }
-
-    display->worker_thread_count = cpu_count * GUAC_DISPLAY_CPU_THREAD_FACTOR;
-    display->worker_threads = guac_mem_alloc(display->worker_thread_count, sizeof(pthread_t));
-    guac_client_log(client, GUAC_LOG_INFO, "Graphical updates will be encoded "
-            "using %i worker thread(s).", display->worker_thread_count);
-
     /* Now that the core of the display has been fully initialized, it's safe
-     * to start the worker threads */
-    for (int i = 0; i < display->worker_thread_count; i++)
-        pthread_create(&(display->worker_threads[i]), NULL, guac_display_worker_thread, display);
+     * to begin submitting operations to the worker threads */
+    display->worker_pool = guac_display_worker_pool_acquire(display);
 
     return display;
 
@@ -178,18 +97,15 @@ void guac_display_stop(guac_display* display) {
         guac_fifo_invalidate(&display->ops);
         guac_fifo_unlock(&display->ops);
 
-        /* Wait for all worker threads to terminate (they should nearly immediately
-         * terminate following invalidation of the FIFO) */
-        for (int i = 0; i < display->worker_thread_count; i++)
-            pthread_join(display->worker_threads[i], NULL);
+        /* Wait for all worker threads to finish with this display (they
+         * should nearly immediately do so following invalidation of the
+         * FIFO), releasing the worker threads entirely if no other display
+         * is using them */
+        guac_display_worker_pool_release(display);
 
-        /* All worker threads are now terminated and may be safely cleaned up */
-        guac_mem_free(display->worker_threads);
-        display->worker_thread_count = 0;
-
-        /* NOTE: The only other reference to the worker_threads AT ALL is in
-         * guac_display_create(). Nothing outside of guac_display_create() and
-         * guac_display_stop() references worker_threads or worker_thread_count. */
+        /* NOTE: The only other reference to the worker pool AT ALL is in
+         * guac_display_alloc() and guac_display_worker_pool_schedule(). The
+         * latter has no effect once the FIFO has been invalidated. */
 
         /* Notify other calls to guac_display_stop() that the display is now
          * officially stopped */
@@ -214,8 +130,35 @@ void guac_display_stop(guac_display* display) {
 void guac_display_free(guac_display* display) {
 
     guac_display_stop(display);
+    guac_display_cache_free(display);
+    guac_display_video_free(display);
+
+    for (int level = 0; level < GUAC_DISPLAY_PLAN_SEARCH_SIZES; level++) {
+        int size = GUAC_DISPLAY_PLAN_SEARCH_BLOCK_SIZE(level);
+        guac_client_log(display->client, GUAC_LOG_DEBUG, "Copy detection "
+                "statistics for %ix%i blocks: %" PRIu64 " of %" PRIu64 " "
+                "indexed draw operation(s) replaced with copies.", size, size,
+                display->copy_search_matched[level],
+                display->copy_search_indexed[level]);
+    }
+
+    guac_client_log(display->client, GUAC_LOG_DEBUG, "%" PRIu64 " draw "
+            "operation(s) replaced with copies or rects based on hints.",
+            display->hinted_ops);
+
+    guac_display_encoder_policy* policy = &display->encoder_policy;
+    guac_client_log(display->client, GUAC_LOG_DEBUG, "Image format "
+            "statistics: %" PRIu64 " PNG, %" PRIu64 " JPEG, %" PRIu64 " WebP, "
+            "%" PRIu64 " lossless WebP (estimated bandwidth %.0f bytes/ms, "
+            "minimum round trip %ims).",
+            policy->chosen[GUAC_DISPLAY_ENCODER_PNG],
+            policy->chosen[GUAC_DISPLAY_ENCODER_JPEG],
+            policy->chosen[GUAC_DISPLAY_ENCODER_WEBP],
+            policy->chosen[GUAC_DISPLAY_ENCODER_WEBP_LOSSLESS],
+            policy->bandwidth, policy->min_rtt);
 
     /* All locks, FIFOs, etc. are now unused and can be safely destroyed */
+    guac_display_encoder_policy_destroy(&display->encoder_policy);
     guac_flag_destroy(&display->render_state);
     guac_fifo_destroy(&display->ops);
     guac_rwlock_destroy(&display->last_frame.lock);
@@ -235,19 +178,22 @@ void guac_display_free(guac_display* display) {
 
 }
 
-void guac_display_dup(guac_display* display, guac_socket* socket) {
+/**
+ * Sends the full state of all layers and buffers of the given display, as
+ * well as the mouse cursor, over the given socket, ending with a "sync"
+ * instruction. No frame may be in progress while the last frame is locked for
+ * reading and the render_state flag is locked.
+ *
+ * @param display
+ *     The display whose state should be sent.
+ *
+ * @param socket
+ *     The socket to send the display state over.
+ */
+static void LFR_guac_display_send_state(guac_display* display,
+        guac_socket* socket) {
 
     guac_client* client = display->client;
-    guac_rwlock_acquire_read_lock(&display->last_frame.lock);
-
-    /* Wait for any pending frame to finish being sent to established users of
-     * the connection before syncing any new users (doing otherwise could
-     * result in trailing instructions of that pending frame getting sent to
-     * new users after they finish joining, even though they are already in
-     * sync with that frame, and those trailing instructions may not have the
-     * intended meaning in context of the new users' remote displays) */
-    guac_flag_wait_and_lock(&display->render_state,
-            GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
 
     /* Sync the state of all layers/buffers */
     guac_display_layer* current = display->last_frame.layers;
@@ -325,6 +271,33 @@ void guac_display_dup(guac_display* display, guac_socket* socket) {
     /* The initial frame synchronizing the newly-joined users is now complete */
     guac_protocol_send_sync(socket, client->last_sent_timestamp, display->last_frame.frames);
 
+}
+
+void guac_display_dup(guac_display* display, guac_socket* socket) {
+
+    /* The newly-joined users have not received the beginning of any active
+     * video stream, which must therefore be restarted */
+    guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
+    PFW_guac_display_video_restart(display);
+    guac_rwlock_release_lock(&display->pending_frame.lock);
+
+    guac_rwlock_acquire_read_lock(&display->last_frame.lock);
+
+    /* Wait for any pending frame to finish being sent to established users of
+     * the connection before syncing any new users (doing otherwise could
+     * result in trailing instructions of that pending frame getting sent to
+     * new users after they finish joining, even though they are already in
+     * sync with that frame, and those trailing instructions may not have the
+     * intended meaning in context of the new users' remote displays) */
+    guac_flag_wait_and_lock(&display->render_state,
+            GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
+
+    /* The newly-joined users have not received any cached tiles, which must
+     * be sent before any of those tiles may be used as the source of copies */
+    LFR_guac_display_cache_dup(display, socket);
+
+    LFR_guac_display_send_state(display, socket);
+
     /* Further rendering for the current connection can now safely continue */
     guac_flag_unlock(&display->render_state);
     guac_rwlock_release_lock(&display->last_frame.lock);
@@ -333,6 +306,36 @@ void guac_display_dup(guac_display* display, guac_socket* socket) {
 
 }
 
+int guac_display_write_keyframe(guac_display* display, guac_socket* socket) {
+
+    guac_rwlock_acquire_read_lock(&display->pending_frame.lock);
+    int video_active = display->video.active;
+    guac_rwlock_release_lock(&display->pending_frame.lock);
+
+    if (video_active)
+        return 1;
+
+    guac_rwlock_acquire_read_lock(&display->last_frame.lock);
+
+    /* The new member of the recording must begin at a frame boundary */
+    guac_flag_wait_and_lock(&display->render_state,
+            GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
+
+    guac_socket_async_mark(socket);
+
+    /* Tiles cached before the keyframe remain in use after it, and must thus
+     * be part of the keyframe */
+    LFR_guac_display_cache_dup(display, socket);
+    LFR_guac_display_send_state(display, socket);
+
+    guac_flag_unlock(&display->render_state);
+    guac_rwlock_release_lock(&display->last_frame.lock);
+
+    guac_socket_flush(socket);
+    return 0;
+
+}
+
 void guac_display_notify_user_left(guac_display* display, guac_user* user) {
     guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
 
@@ -0,0 +1,249 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "encode-h264.h"
+#include "guacamole/mem.h"
+#include "guacamole/protocol.h"
+#include "guacamole/socket.h"
+#include "guacamole/stream.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/opt.h>
+
+#include <stdint.h>
+
+struct guac_h264_encoder {
+
+    /**
+     * The libavcodec context of the underlying H.264 encoder.
+     */
+    AVCodecContext* context;
+
+    /**
+     * The YUV 4:2:0 frame that receives each converted image prior to
+     * encoding.
+     */
+    AVFrame* frame;
+
+    /**
+     * Packet that receives each unit of encoded data.
+     */
+    AVPacket* packet;
+
+    /**
+     * The presentation timestamp of the most recently encoded frame, in
+     * milliseconds, or a negative value if no frame has yet been encoded.
+     */
+    int64_t last_timestamp;
+
+};
+
+/**
+ * Converts the given 32-bit XRGB image data to the planar YUV 4:2:0 format
+ * expected by the encoder, storing the result within the given frame. The
+ * conversion uses the BT.601 coefficients, with chroma values calculated from
+ * the average of each 2x2 block of pixels.
+ *
+ * @param frame
+ *     The frame that should receive the converted image data. The dimensions
+ *     of this frame must be multiples of 2.
+ *
+ * @param buffer
+ *     The 32-bit XRGB image data to convert, having the same dimensions as
+ *     the given frame.
+ *
+ * @param stride
+ *     The number of bytes in each row of the given image data.
+ */
+static void guac_h264_convert(AVFrame* frame, const unsigned char* buffer,
+        int stride) {
+
+    for (int y = 0; y < frame->height; y += 2) {
+
+        const uint32_t* row_a = (const uint32_t*) (buffer + y * stride);
+        const uint32_t* row_b = (const uint32_t*) (buffer + (y + 1) * stride);
+
+        uint8_t* luma_a = frame->data[0] + y * frame->linesize[0];
+        uint8_t* luma_b = luma_a + frame->linesize[0];
+        uint8_t* cb = frame->data[1] + (y / 2) * frame->linesize[1];
+        uint8_t* cr = frame->data[2] + (y / 2) * frame->linesize[2];
+
+        for (int x = 0; x < frame->width; x += 2) {
+
+            uint32_t pixels[4] = { row_a[x], row_a[x + 1], row_b[x], row_b[x + 1] };
+            uint8_t* luma[4] = { &luma_a[x], &luma_a[x + 1], &luma_b[x], &luma_b[x + 1] };
+
+            int red_sum = 0;
+            int green_sum = 0;
+            int blue_sum = 0;
+
+            for (int i = 0; i < 4; i++) {
+
+                int red   = (pixels[i] >> 16) & 0xFF;
+                int green = (pixels[i] >> 8)  & 0xFF;
+                int blue  =  pixels[i]        & 0xFF;
+
+                *luma[i] = ((66 * red + 129 * green + 25 * blue + 128) >> 8) + 16;
+
+                red_sum   += red;
+                green_sum += green;
+                blue_sum  += blue;
+
+            }
+
+            int red   = red_sum   / 4;
+            int green = green_sum / 4;
+            int blue  = blue_sum  / 4;
+
+            cb[x / 2] = ((-38 * red -  74 * green + 112 * blue + 128) >> 8) + 128;
+            cr[x / 2] = ((112 * red -  94 * green -  18 * blue + 128) >> 8) + 128;
+
+        }
+
+    }
+
+}
+
+guac_h264_encoder* guac_h264_encoder_alloc(int width, int height,
+        int64_t bitrate) {
+
+    /* Prefer x264, which can be explicitly tuned for low latency, falling
+     * back to any other available H.264 encoder */
+    const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+    if (codec == NULL)
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+
+    if (codec == NULL)
+        return NULL;
+
+    AVCodecContext* context = avcodec_alloc_context3(codec);
+    if (context == NULL)
+        return NULL;
+
+    context->width = width;
+    context->height = height;
+    context->pix_fmt = AV_PIX_FMT_YUV420P;
+    context->time_base = (AVRational) { 1, 1000 };
+    context->bit_rate = bitrate;
+    context->gop_size = GUAC_H264_KEYFRAME_INTERVAL;
+
+    /* Each frame must be sent as soon as it is encoded, thus there can be no
+     * frames that depend on future frames */
+    context->max_b_frames = 0;
+
+    /* Encoding is already parallelized across displays and regions by the
+     * display worker threads */
+    context->thread_count = 1;
+
+    /* These options are specific to x264 and are ignored otherwise */
+    av_opt_set(context->priv_data, "preset", "ultrafast", 0);
+    av_opt_set(context->priv_data, "tune", "zerolatency", 0);
+
+    if (avcodec_open2(context, codec, NULL) < 0) {
+        avcodec_free_context(&context);
+        return NULL;
+    }
+
+    AVFrame* frame = av_frame_alloc();
+    if (frame == NULL) {
+        avcodec_free_context(&context);
+        return NULL;
+    }
+
+    frame->format = context->pix_fmt;
+    frame->width = width;
+    frame->height = height;
+
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        avcodec_free_context(&context);
+        return NULL;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    if (packet == NULL) {
+        av_frame_free(&frame);
+        avcodec_free_context(&context);
+        return NULL;
+    }
+
+    guac_h264_encoder* encoder = guac_mem_alloc(sizeof(guac_h264_encoder));
+    encoder->context = context;
+    encoder->frame = frame;
+    encoder->packet = packet;
+    encoder->last_timestamp = -1;
+
+    return encoder;
+
+}
+
+int guac_h264_encoder_write(guac_h264_encoder* encoder, guac_socket* socket,
+        guac_stream* stream, const unsigned char* buffer, int stride,
+        int64_t timestamp) {
+
+    AVFrame* frame = encoder->frame;
+
+    /* The frame may still be referenced by the encoder */
+    if (av_frame_make_writable(frame) < 0)
+        return -1;
+
+    guac_h264_convert(frame, buffer, stride);
+
+    /* Timestamps must strictly increase */
+    if (timestamp <= encoder->last_timestamp)
+        timestamp = encoder->last_timestamp + 1;
+
+    frame->pts = timestamp;
+    encoder->last_timestamp = timestamp;
+
+    if (avcodec_send_frame(encoder->context, frame) < 0)
+        return -1;
+
+    /* Send all encoded data that is now available */
+    int length = 0;
+    AVPacket* packet = encoder->packet;
+    while (avcodec_receive_packet(encoder->context, packet) == 0) {
+
+        int result = guac_protocol_send_blobs(socket, stream, packet->data, packet->size);
+        length += packet->size;
+
+        av_packet_unref(packet);
+
+        if (result)
+            return -1;
+
+    }
+
+    return length;
+
+}
+
+void guac_h264_encoder_free(guac_h264_encoder* encoder) {
+
+    av_packet_free(&encoder->packet);
+    av_frame_free(&encoder->frame);
+    avcodec_free_context(&encoder->context);
+
+    guac_mem_free(encoder);
+
+}
+
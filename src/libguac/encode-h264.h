@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_ENCODE_H264_H
+#define GUAC_ENCODE_H264_H
+
+#include "config.h"
+
+#include "guacamole/socket.h"
+#include "guacamole/stream.h"
+
+#include <stdint.h>
+
+/**
+ * The mimetype of the video data produced by guac_h264_encoder_write(). The
+ * data is a raw H.264 elementary stream in Annex B format, with each "blob"
+ * instruction containing a portion of exactly one access unit (frame).
+ */
+#define GUAC_H264_MIMETYPE "video/h264"
+
+/**
+ * The number of frames between each keyframe (IDR frame) produced by the
+ * encoder.
+ */
+#define GUAC_H264_KEYFRAME_INTERVAL 250
+
+/**
+ * An H.264 encoder producing a single stream of video frames having fixed
+ * dimensions. The internals of this structure are specific to the underlying
+ * encoder library.
+ */
+typedef struct guac_h264_encoder guac_h264_encoder;
+
+/**
+ * Allocates a new H.264 encoder producing frames of the given dimensions,
+ * tuned for low latency. The first frame written will be a keyframe.
+ *
+ * @param width
+ *     The width of each frame, in pixels. This must be a multiple of 2.
+ *
+ * @param height
+ *     The height of each frame, in pixels. This must be a multiple of 2.
+ *
+ * @param bitrate
+ *     The target bitrate of the encoded video, in bits per second.
+ *
+ * @return
+ *     A newly-allocated H.264 encoder, or NULL if no suitable encoder is
+ *     available or the encoder could not be initialized.
+ */
+guac_h264_encoder* guac_h264_encoder_alloc(int width, int height,
+        int64_t bitrate);
+
+/**
+ * Encodes the given image as the next frame of the video produced by the
+ * given encoder, sending any resulting encoded data over the given stream and
+ * socket as blobs.
+ *
+ * @param encoder
+ *     The encoder to use.
+ *
+ * @param socket
+ *     The socket to send H.264 blobs over.
+ *
+ * @param stream
+ *     The stream to associate with each blob.
+ *
+ * @param buffer
+ *     The 32-bit XRGB image data of the frame, having the same dimensions as
+ *     the encoder.
+ *
+ * @param stride
+ *     The number of bytes in each row of the given image data.
+ *
+ * @param timestamp
+ *     The presentation timestamp of the frame, in milliseconds. Timestamps
+ *     must increase with each frame.
+ *
+ * @return
+ *     The number of bytes of H.264 data sent if the encoding operation is
+ *     successful, or a negative value otherwise.
+ */
+int guac_h264_encoder_write(guac_h264_encoder* encoder, guac_socket* socket,
+        guac_stream* stream, const unsigned char* buffer, int stride,
+        int64_t timestamp);
+
+/**
+ * Frees all resources associated with the given encoder. Any frames that
+ * have been buffered within the encoder are discarded.
+ *
+ * @param encoder
+ *     The encoder to free.
+ */
+void guac_h264_encoder_free(guac_h264_encoder* encoder);
+
+#endif
+
@@ -44,7 +44,8 @@
  *     JPEG image quality.
  * 
  * @return
- *     Zero if the encoding operation is successful, non-zero otherwise.
+ *     The number of bytes of JPEG data sent if the encoding operation is
+ *     successful, or a negative value otherwise.
  */
 int guac_jpeg_write(guac_socket* socket, guac_stream* stream,
         cairo_surface_t* surface, int quality);
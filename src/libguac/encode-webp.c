@@ -59,6 +59,11 @@ typedef struct guac_webp_stream_writer {
      */
     int buffer_size;
 
+    /**
+     * The total number of bytes of WebP data sent thus far.
+     */
+    int length;
+
 } guac_webp_stream_writer;
 
 /**
@@ -75,6 +80,7 @@ static void guac_webp_flush_data(guac_webp_stream_writer* writer) {
             writer->buffer, writer->buffer_size);
 
     /* Clear buffer */
+    writer->length += writer->buffer_size;
     writer->buffer_size = 0;
 
 }
@@ -96,6 +102,7 @@ static void guac_webp_stream_writer_init(guac_webp_stream_writer* writer,
         guac_socket* socket, guac_stream* stream) {
 
     writer->buffer_size = 0;
+    writer->length = 0;
 
     /* Store Guacamole-specific objects */
     writer->socket = socket;
@@ -258,7 +265,10 @@ int guac_webp_write(guac_socket* socket, guac_stream* stream,
     /* Ensure all data is written */
     guac_webp_flush_data(&writer);
 
-    return result;
+    if (result)
+        return result;
+
+    return writer.length;
 
 }
 
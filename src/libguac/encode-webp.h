@@ -50,7 +50,8 @@
  *     Zero for a lossy image, non-zero for lossless.
  *
  * @return
- *     Zero if the encoding operation is successful, non-zero otherwise.
+ *     The number of bytes of WebP data sent if the encoding operation is
+ *     successful, or a negative value otherwise.
  */
 int guac_webp_write(guac_socket* socket, guac_stream* stream,
         cairo_surface_t* surface, int quality, int lossless);
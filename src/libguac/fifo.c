@@ -118,25 +118,47 @@ int guac_fifo_enqueue_and_lock(guac_fifo* fifo,
 }
 
 /**
- * Dequeues a single item from the given guac_fifo, storing a copy
- * of that item in the provided buffer. The event fifo MUST be non-empty. The
- * state flag of the fifo MUST already be locked.
+ * Dequeues up to the given number of items from the given guac_fifo, storing
+ * copies of those items in the provided buffer, oldest first. The fifo MUST be
+ * non-empty. The state flag of the fifo MUST already be locked.
  *
  * @param fifo
- *     The guac_fifo to dequeue an item from.
+ *     The guac_fifo to dequeue items from.
  *
- * @param item
- *     The buffer that should receive a copy of the dequeued item.
+ * @param items
+ *     The buffer that should receive copies of the dequeued items. This
+ *     buffer must have space for at least max_items items.
+ *
+ * @param max_items
+ *     The maximum number of items to dequeue. This MUST be at least 1.
+ *
+ * @return
+ *     The number of items dequeued, which will always be at least 1.
  */
-static void dequeue(guac_fifo* fifo, void* item) {
+static size_t dequeue(guac_fifo* fifo, void* items, size_t max_items) {
+
+    size_t count = fifo->item_count;
+    if (count > max_items)
+        count = max_items;
 
-    /* Copy data of first item in fifo to provided output buffer */
-    void* head_item = ((char*) fifo) + fifo->items_offset + fifo->item_size * fifo->head;
-    memcpy(item, head_item, fifo->item_size);
+    /* Items to be copied may wrap around the end of the items array, in which
+     * case they must be copied in two separate segments */
+    size_t first_count = fifo->max_items - fifo->head;
+    if (first_count > count)
+        first_count = count;
+
+    /* Copy data of first items in fifo to provided output buffer */
+    char* fifo_items = ((char*) fifo) + fifo->items_offset;
+    memcpy(items, fifo_items + fifo->item_size * fifo->head,
+            fifo->item_size * first_count);
+
+    if (count > first_count)
+        memcpy((char*) items + fifo->item_size * first_count, fifo_items,
+                fifo->item_size * (count - first_count));
 
     /* Advance to next item in fifo, if any */
-    fifo->item_count--;
-    fifo->head = (fifo->head + 1) % fifo->max_items;
+    fifo->item_count -= count;
+    fifo->head = (fifo->head + count) % fifo->max_items;
 
     /* Keep state flag up-to-date with respect to non-emptiness ... */
     if (fifo->item_count == 0)
@@ -145,7 +167,8 @@ static void dequeue(guac_fifo* fifo, void* item) {
     /* ... and readiness for further items */
     guac_flag_set(&fifo->state, GUAC_FIFO_STATE_READY);
 
-    /* Item has been dequeued successfully */
+    /* Items have been dequeued successfully */
+    return count;
 
 }
 
@@ -182,7 +205,7 @@ int guac_fifo_dequeue_and_lock(guac_fifo* fifo, void* item) {
         return 0;
     }
 
-    dequeue(fifo, item);
+    dequeue(fifo, item, 1);
     return 1;
 
 }
@@ -203,8 +226,70 @@ int guac_fifo_timed_dequeue_and_lock(guac_fifo* fifo,
         return 0;
     }
 
-    dequeue(fifo, item);
+    dequeue(fifo, item, 1);
     return 1;
 
 }
 
+size_t guac_fifo_dequeue_batch(guac_fifo* fifo, void* items,
+        size_t max_items) {
+
+    size_t count = guac_fifo_dequeue_batch_and_lock(fifo, items, max_items);
+    if (count == 0)
+        return 0;
+
+    guac_flag_unlock(&fifo->state);
+    return count;
+
+}
+
+size_t guac_fifo_timed_dequeue_batch(guac_fifo* fifo, void* items,
+        size_t max_items, int msec_timeout) {
+
+    size_t count = guac_fifo_timed_dequeue_batch_and_lock(fifo, items,
+            max_items, msec_timeout);
+
+    if (count == 0)
+        return 0;
+
+    guac_flag_unlock(&fifo->state);
+    return count;
+
+}
+
+size_t guac_fifo_dequeue_batch_and_lock(guac_fifo* fifo, void* items,
+        size_t max_items) {
+
+    /* Block indefinitely while waiting for an item to be added, but bail out
+     * if the fifo becomes invalid */
+    guac_flag_wait_and_lock(&fifo->state,
+            GUAC_FIFO_STATE_NONEMPTY | GUAC_FIFO_STATE_INVALID);
+
+    if (max_items == 0 || fifo->state.value & GUAC_FIFO_STATE_INVALID) {
+        guac_flag_unlock(&fifo->state);
+        return 0;
+    }
+
+    return dequeue(fifo, items, max_items);
+
+}
+
+size_t guac_fifo_timed_dequeue_batch_and_lock(guac_fifo* fifo, void* items,
+        size_t max_items, int msec_timeout) {
+
+    /* Wait up to timeout for an item to be present in the fifo, failing if no
+     * items enter the fifo before the timeout lapses */
+    if (!guac_flag_timedwait_and_lock(&fifo->state,
+                GUAC_FIFO_STATE_NONEMPTY | GUAC_FIFO_STATE_INVALID,
+                msec_timeout)) {
+        return 0;
+    }
+
+    if (max_items == 0 || fifo->state.value & GUAC_FIFO_STATE_INVALID) {
+        guac_flag_unlock(&fifo->state);
+        return 0;
+    }
+
+    return dequeue(fifo, items, max_items);
+
+}
@@ -107,6 +107,28 @@ struct guac_audio_stream {
      */
     void* data;
 
+    /**
+     * The target bitrate of any compressed encoding of this stream, in bits
+     * per second, or zero if the default bitrate of the encoder should be
+     * used. Encoders which do not compress audio ignore this value.
+     */
+    int bitrate;
+
+    /**
+     * The duration of each compressed audio frame, in milliseconds, or zero
+     * if the default frame duration of the encoder should be used. Longer
+     * frames reduce overhead at the expense of latency. Encoders which do not
+     * compress audio ignore this value.
+     */
+    int frame_duration;
+
+    /**
+     * Non-zero if any compressed encoding of this stream should minimize
+     * latency at the expense of quality, zero otherwise. Encoders which do
+     * not compress audio ignore this value.
+     */
+    int low_delay;
+
 };
 
 /**
@@ -221,6 +243,30 @@ void guac_audio_stream_free(guac_audio_stream* stream);
 void guac_audio_stream_write_pcm(guac_audio_stream* stream,
         const unsigned char* data, int length);
 
+/**
+ * Sets the parameters used by any compressed encoding of the given audio
+ * stream, such as Opus. These parameters take effect only if set before any
+ * PCM data is written to the stream, and are ignored by encoders which do not
+ * compress audio.
+ *
+ * @param stream
+ *     The guac_audio_stream whose compression parameters should be set.
+ *
+ * @param bitrate
+ *     The target bitrate, in bits per second, or zero to use the default
+ *     bitrate of the encoder.
+ *
+ * @param frame_duration
+ *     The duration of each compressed audio frame, in milliseconds, or zero
+ *     to use the default frame duration of the encoder.
+ *
+ * @param low_delay
+ *     Non-zero if latency should be minimized at the expense of quality,
+ *     zero otherwise.
+ */
+void guac_audio_stream_set_compression(guac_audio_stream* stream,
+        int bitrate, int frame_duration, int low_delay);
+
 /**
  * Flushes the underlying audio buffer, if any, ensuring that all audio
  * previously written via guac_audio_stream_write_pcm() has been encoded and
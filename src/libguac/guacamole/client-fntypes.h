@@ -64,6 +64,24 @@ typedef int guac_client_free_handler(guac_client* client);
  */
 typedef int guac_client_join_pending_handler(guac_client* client);
 
+/**
+ * Handler that will run before users that fell too far behind to receive
+ * broadcast data are returned to the list of full users. At the time this
+ * handler runs, the pending user socket (and guac_client_foreach_pending_user())
+ * refers to only those users. Unlike the join pending handler, this handler
+ * must only restore state that may have been lost along with the dropped data,
+ * such as the contents of the display, as the users have already joined and
+ * any streams allocated for them remain open.
+ *
+ * @param client
+ *     The client whose handler was invoked.
+ *
+ * @return
+ *     Zero if the users were successfully resynchronized, or a non-zero value
+ *     if an error occurred.
+ */
+typedef int guac_client_resync_handler(guac_client* client);
+
 /**
  * Handler for logging messages related to a given guac_client instance.
  *
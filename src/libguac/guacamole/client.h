@@ -311,6 +311,25 @@ struct guac_client {
      */
     void* __plugin_handle;
 
+    /**
+     * A handler that will be run prior to users that fell too far behind to
+     * receive broadcast data being returned to the list of full users. The
+     * state of those users should be restored using the client's pending user
+     * socket, which broadcasts only to those users while this handler runs.
+     * If no handler is defined, users that fall too far behind are
+     * disconnected.
+     *
+     * Example:
+     * @code
+     *     int resync_handler(guac_client* client);
+     *
+     *     int guac_client_init(guac_client* client) {
+     *         client->resync_handler = resync_handler;
+     *     }
+     * @endcode
+     */
+    guac_client_resync_handler* resync_handler;
+
 };
 
 /**
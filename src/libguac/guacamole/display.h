@@ -246,6 +246,63 @@ void guac_display_stop(guac_display* display);
  */
 void guac_display_free(guac_display* display);
 
+/**
+ * Sets the maximum number of worker threads that may be used to encode the
+ * graphical updates of all guac_display instances within the current
+ * process. All guac_display instances within a process share the same pool
+ * of worker threads, and that pool is normally sized according to the number
+ * of available processors. This function has no effect on a pool of worker
+ * threads that already exists; the new limit takes effect only when the pool
+ * is next created (when the first guac_display is allocated after all others
+ * have been freed, or in a newly-forked process).
+ *
+ * @param max_threads
+ *     The maximum number of worker threads to create, or zero (or any
+ *     negative value) to size the pool only according to the number of
+ *     available processors.
+ */
+void guac_display_set_max_worker_threads(int max_threads);
+
+/**
+ * Sets whether regions of the default layer that change continuously, such as
+ * regions playing video or animations, may be streamed to connected users as
+ * H.264 video rather than as a series of images. Video is streamed only if
+ * libguac was built with support for H.264 video streaming, and only while
+ * every connected user supports the "video/h264" mimetype. All other regions
+ * continue to be sent as images. By default, video streaming is disabled.
+ * Video streaming should not be enabled while graphical output is being
+ * recorded, as session recordings cannot contain video streams.
+ *
+ * @param display
+ *     The display to enable or disable video streaming for.
+ *
+ * @param enabled
+ *     Non-zero if continuously-changing regions may be streamed as video,
+ *     zero otherwise.
+ */
+void guac_display_set_video_streaming(guac_display* display, int enabled);
+
+/**
+ * Sets the maximum number of bytes of image data that may be retained within
+ * the image cache of the given display. Full tiles of image data sent to
+ * connected users are retained within an off-screen buffer on each client,
+ * and later draws of those same tiles are replaced with copies from that
+ * buffer. The same amount of memory is used by guacd to verify cache hits.
+ * A size of zero disables the cache. Budgets larger than the maximum
+ * supported size are reduced to that size. By default, 16 MiB is used.
+ *
+ * The size of the cache can only be set before the first frame containing
+ * image data is flushed. Later calls have no effect.
+ *
+ * @param display
+ *     The display whose image cache size should be set.
+ *
+ * @param size
+ *     The maximum number of bytes of image data to retain, or zero to disable
+ *     the image cache.
+ */
+void guac_display_set_cache_size(guac_display* display, size_t size);
+
 /**
  * Replicates the current remote display state across the given socket. When
  * new users join a particular guac_client, this function should be used to
@@ -700,6 +757,62 @@ void guac_display_layer_raw_context_set(guac_display_layer_raw_context* context,
 void guac_display_layer_raw_context_put(guac_display_layer_raw_context* context,
         const guac_rect* dst, const void* restrict buffer, size_t stride);
 
+/**
+ * Notes that the given region of the given layer has been, or will be,
+ * replaced with the image data that was present within another region of the
+ * same layer as of the last frame, such as when the contents of the layer
+ * have been scrolled. This allows the change to be sent to connected clients
+ * as a copy without first hashing and searching the previous frame for the
+ * same image data.
+ *
+ * Hints are verified against the actual contents of the layer when the frame
+ * is flushed. If the contents of the destination region are not identical to
+ * those of the source region of the last frame (for example, because the
+ * region was drawn to again after the copy), the hint is simply ignored. Only
+ * a limited number of hints are retained for each layer in each frame, with
+ * any further hints being ignored. This function may be called regardless of
+ * whether a raw or Cairo context for the layer is currently open.
+ *
+ * @param layer
+ *     The layer that was drawn to.
+ *
+ * @param src
+ *     The region of the layer, as of the last frame, whose contents were
+ *     copied.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the region that received
+ *     the copied image data.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the region that received
+ *     the copied image data.
+ */
+void guac_display_layer_hint_copy(guac_display_layer* layer,
+        const guac_rect* src, int x, int y);
+
+/**
+ * Notes that the given region of the given layer has been, or will be,
+ * filled with a single color. This allows the change to be sent to connected
+ * clients as a simple rect without first scanning the region for differing
+ * pixels. As with guac_display_layer_hint_copy(), hints are verified against
+ * the actual contents of the layer when the frame is flushed and are ignored
+ * if inaccurate.
+ *
+ * @param layer
+ *     The layer that was drawn to.
+ *
+ * @param dst
+ *     The region of the layer that was filled.
+ *
+ * @param color
+ *     The color that the region was filled with, in the same format as the
+ *     pixels of the layer's image buffer. The alpha channel of this color is
+ *     ignored if the layer is opaque.
+ */
+void guac_display_layer_hint_fill(guac_display_layer* layer,
+        const guac_rect* dst, uint32_t color);
+
 /**
  * Begins a drawing operation for the given layer, returning a context that can
  * be used to draw to a Cairo surface containing the layer's current pending
@@ -306,6 +306,122 @@ int guac_fifo_timed_dequeue(guac_fifo* fifo,
 int guac_fifo_timed_dequeue_and_lock(guac_fifo* fifo,
         void* item, int msec_timeout);
 
+/**
+ * Removes up to the given number of the oldest items from the FIFO, storing
+ * copies of those items within the provided buffer, oldest first. If the FIFO
+ * is currently empty, this function will block until at least one item has
+ * been added to the FIFO or until the FIFO becomes invalid. This function
+ * never blocks waiting for more than one item.
+ *
+ * Removing several items at once requires acquiring exclusive access to the
+ * FIFO only once, and should be preferred over repeated calls to
+ * guac_fifo_dequeue() where multiple threads compete to remove many small
+ * items.
+ *
+ * @param fifo
+ *     The FIFO to remove items from.
+ *
+ * @param items
+ *     The buffer that should receive copies of the removed items. This buffer
+ *     must have space for at least max_items items.
+ *
+ * @param max_items
+ *     The maximum number of items to remove.
+ *
+ * @return
+ *     The number of items removed, or zero if items cannot be removed from
+ *     the FIFO because the FIFO has been invalidated (or max_items is zero).
+ */
+size_t guac_fifo_dequeue_batch(guac_fifo* fifo, void* items,
+        size_t max_items);
+
+/**
+ * Atomically removes up to the given number of the oldest items from the
+ * FIFO, storing copies of those items within the provided buffer, oldest
+ * first. If this function successfully removes any items, the FIFO is left
+ * locked after this function returns. If the FIFO is currently empty, this
+ * function will block until at least one item has been added to the FIFO or
+ * until the FIFO becomes invalid. This function never blocks waiting for more
+ * than one item.
+ *
+ * @param fifo
+ *     The FIFO to remove items from.
+ *
+ * @param items
+ *     The buffer that should receive copies of the removed items. This buffer
+ *     must have space for at least max_items items.
+ *
+ * @param max_items
+ *     The maximum number of items to remove.
+ *
+ * @return
+ *     The number of items removed, or zero if items cannot be removed from
+ *     the FIFO because the FIFO has been invalidated (or max_items is zero).
+ */
+size_t guac_fifo_dequeue_batch_and_lock(guac_fifo* fifo, void* items,
+        size_t max_items);
+
+/**
+ * Removes up to the given number of the oldest items from the FIFO, storing
+ * copies of those items within the provided buffer, oldest first. If the FIFO
+ * is currently empty, this function will block until at least one item has
+ * been added to the FIFO, until the given timeout has elapsed, or until the
+ * FIFO becomes invalid. This function never blocks waiting for more than one
+ * item.
+ *
+ * @param fifo
+ *     The FIFO to remove items from.
+ *
+ * @param items
+ *     The buffer that should receive copies of the removed items. This buffer
+ *     must have space for at least max_items items.
+ *
+ * @param max_items
+ *     The maximum number of items to remove.
+ *
+ * @param msec_timeout
+ *     The maximum number of milliseconds to wait for at least one item to be
+ *     present within the FIFO (or for the FIFO to become invalid).
+ *
+ * @return
+ *     The number of items removed, or zero if the timeout has elapsed or if
+ *     items cannot be removed from the FIFO because the FIFO has been
+ *     invalidated (or max_items is zero).
+ */
+size_t guac_fifo_timed_dequeue_batch(guac_fifo* fifo, void* items,
+        size_t max_items, int msec_timeout);
+
+/**
+ * Atomically removes up to the given number of the oldest items from the
+ * FIFO, storing copies of those items within the provided buffer, oldest
+ * first. If this function successfully removes any items, the FIFO is left
+ * locked after this function returns. If the FIFO is currently empty, this
+ * function will block until at least one item has been added to the FIFO,
+ * until the given timeout has elapsed, or until the FIFO becomes invalid. This
+ * function never blocks waiting for more than one item.
+ *
+ * @param fifo
+ *     The FIFO to remove items from.
+ *
+ * @param items
+ *     The buffer that should receive copies of the removed items. This buffer
+ *     must have space for at least max_items items.
+ *
+ * @param max_items
+ *     The maximum number of items to remove.
+ *
+ * @param msec_timeout
+ *     The maximum number of milliseconds to wait for at least one item to be
+ *     present within the FIFO (or for the FIFO to become invalid).
+ *
+ * @return
+ *     The number of items removed, or zero if the timeout has elapsed or if
+ *     items cannot be removed from the FIFO because the FIFO has been
+ *     invalidated (or max_items is zero).
+ */
+size_t guac_fifo_timed_dequeue_batch_and_lock(guac_fifo* fifo, void* items,
+        size_t max_items, int msec_timeout);
+
 /**
  * @}
  */
@@ -85,6 +85,20 @@ struct guac_parser {
      */
     char __instructionbuf[32768];
 
+    /**
+     * The size of each argument within argv, in bytes, not including the
+     * null terminator. Arguments are null-terminated in place within the
+     * data originally provided to the parser, thus arguments may be used
+     * directly without copying, and these sizes allow arguments (such as
+     * large blobs) to be processed without rescanning for their terminators.
+     */
+    int* argv_sizes;
+
+    /**
+     * The size of each completely-parsed element, in bytes.
+     */
+    int __element_sizes[GUAC_INSTRUCTION_MAX_ELEMENTS];
+
 };
 
 /**
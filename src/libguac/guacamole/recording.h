@@ -21,6 +21,8 @@
 #define GUAC_RECORDING_H
 
 #include <guacamole/client.h>
+#include <guacamole/display-types.h>
+#include <guacamole/timestamp-types.h>
 
 /**
  * Provides functions and structures to be use for session recording.
@@ -48,6 +50,40 @@
  */
 #define GUAC_COMMON_RECORDING_MAX_NAME_LENGTH 2048
 
+/**
+ * The suffix appended to the filename of a compressed session recording to
+ * produce the filename of its index. A compressed recording is a series of
+ * independent gzip members, each ending at a "sync" instruction, and its
+ * index contains one line per member of the form:
+ *
+ *     TIMESTAMP OFFSET TYPE
+ *
+ * where TIMESTAMP is the timestamp of the first "sync" instruction within the
+ * member, OFFSET is the byte offset of the member within the recording file,
+ * and TYPE is GUAC_RECORDING_INDEX_KEYFRAME if the member begins with the
+ * full state of the display or GUAC_RECORDING_INDEX_FRAME otherwise. Playback
+ * may begin at the offset of any keyframe.
+ */
+#define GUAC_RECORDING_INDEX_SUFFIX ".index"
+
+/**
+ * The type of an index entry whose member begins with the full state of the
+ * display.
+ */
+#define GUAC_RECORDING_INDEX_KEYFRAME 'K'
+
+/**
+ * The type of an index entry whose member depends on the state produced by
+ * preceding members.
+ */
+#define GUAC_RECORDING_INDEX_FRAME 'F'
+
+/**
+ * The minimum number of milliseconds between keyframes written by
+ * guac_recording_keyframe().
+ */
+#define GUAC_RECORDING_KEYFRAME_INTERVAL 60000
+
 /**
  * An in-progress session recording, attached to a guac_client instance such
  * that output Guacamole instructions may be dynamically intercepted and
@@ -57,7 +93,9 @@ typedef struct guac_recording {
 
     /**
      * The guac_socket which writes directly to the recording file, rather than
-     * to any particular user.
+     * to any particular user. Data written to this socket is queued and
+     * written to the recording file by a dedicated thread, such that a slow
+     * recording file does not delay the connection.
      */
     guac_socket* socket;
 
@@ -95,6 +133,23 @@ typedef struct guac_recording {
      */
     int include_keys;
 
+    /**
+     * The guac_client associated with this recording.
+     */
+    guac_client* client;
+
+    /**
+     * Non-zero if the recording is compressed and indexed, zero if the
+     * recording is written as plain Guacamole protocol data.
+     */
+    int compressed;
+
+    /**
+     * The time that the most recent keyframe was written, or that the
+     * recording was created if no keyframe has yet been written.
+     */
+    guac_timestamp last_keyframe;
+
 } guac_recording;
 
 /**
@@ -104,7 +159,8 @@ typedef struct guac_recording {
  * created if it does not yet exist. If creation of the recording file or path
  * fails, error messages will automatically be logged, and no recording will be
  * written. The recording will automatically be closed once the client is
- * freed.
+ * freed. The recording is written as plain, uncompressed Guacamole protocol
+ * data. To write a compressed recording, use guac_recording_create_ex().
  *
  * @param client
  *     The client whose output should be copied to a recording file.
@@ -162,6 +218,76 @@ guac_recording* guac_recording_create(guac_client* client,
         int include_output, int include_mouse, int include_touch,
         int include_keys, int allow_write_existing);
 
+/**
+ * Replaces the socket of the given client such that all further Guacamole
+ * protocol output will be copied into a file within the given path and having
+ * the given name, exactly as guac_recording_create() does, additionally
+ * allowing that recording to be compressed and indexed. Keyframes may then
+ * be added to the recording with guac_recording_keyframe().
+ *
+ * @param client
+ *     The client whose output should be copied to a recording file.
+ *
+ * @param path
+ *     The full absolute path to a directory in which the recording file should
+ *     be created.
+ *
+ * @param name
+ *     The base name to use for the recording file created within the specified
+ *     path.
+ *
+ * @param create_path
+ *     Zero if the specified path MUST exist for the recording file to be
+ *     written, or non-zero if the path should be created if it does not yet
+ *     exist.
+ *
+ * @param include_output
+ *     Non-zero if output which is broadcast to each connected client
+ *     (graphics, streams, etc.) should be included in the session recording,
+ *     zero otherwise. Including output is necessary for any recording which
+ *     must later be viewable as video.
+ *
+ * @param include_mouse
+ *     Non-zero if changes to mouse state, such as position and buttons pressed
+ *     or released, should be included in the session recording, zero
+ *     otherwise. Including mouse state is necessary for the mouse cursor to be
+ *     rendered in any resulting video.
+ *
+ * @param include_touch
+ *     Non-zero if touch events should be included in the session recording,
+ *     zero otherwise. Depending on whether the remote desktop will
+ *     automatically provide graphical feedback for touches, including touch
+ *     events may be necessary for multi-touch interactions to be rendered in
+ *     any resulting video.
+ *
+ * @param include_keys
+ *     Non-zero if keys pressed and released should be included in the session
+ *     recording, zero otherwise. Including key events within the recording may
+ *     be necessary in certain auditing contexts, but should only be done with
+ *     caution. Key events can easily contain sensitive information, such as
+ *     passwords, credit card numbers, etc.
+ *
+ * @param allow_write_existing
+ *     Non-zero if writing to an existing file should be allowed, or zero
+ *     otherwise.
+ *
+ * @param compress
+ *     Non-zero if the recording should be compressed and accompanied by an
+ *     index allowing playback to begin at any keyframe, zero if the recording
+ *     should be written as plain Guacamole protocol data. If compression is
+ *     not supported by this build of libguac, a warning is logged and the
+ *     recording is written uncompressed.
+ *
+ * @return
+ *     A new guac_recording structure representing the in-progress
+ *     recording if the recording file has been successfully created and a
+ *     recording will be written, NULL otherwise.
+ */
+guac_recording* guac_recording_create_ex(guac_client* client,
+        const char* path, const char* name, int create_path,
+        int include_output, int include_mouse, int include_touch,
+        int include_keys, int allow_write_existing, int compress);
+
 /**
  * Frees the resources associated with the given in-progress recording. Note
  * that, due to the manner that recordings are attached to the guac_client, the
@@ -173,6 +299,22 @@ guac_recording* guac_recording_create(guac_client* client,
  */
 void guac_recording_free(guac_recording* recording);
 
+/**
+ * Writes a keyframe containing the full current state of the given display
+ * to the recording, if the recording is compressed, includes output, and at
+ * least GUAC_RECORDING_KEYFRAME_INTERVAL milliseconds have elapsed since the
+ * previous keyframe. Otherwise, this function has no effect. This function
+ * may safely be invoked frequently, such as within the main loop of a
+ * connection, but must not be invoked concurrently for the same recording.
+ *
+ * @param recording
+ *     The guac_recording to write the keyframe to.
+ *
+ * @param display
+ *     The display whose state should be written.
+ */
+void guac_recording_keyframe(guac_recording* recording, guac_display* display);
+
 /**
  * Reports the current mouse position and button state within the recording.
  *
@@ -79,5 +79,23 @@ typedef struct guac_socket_ssl_data {
  */
 guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd);
 
+/**
+ * Creates a new guac_socket which will use the given SSL connection for all
+ * communication. The SSL handshake must have already completed, for example
+ * through a non-blocking call to SSL_accept(), and the SSL connection must be
+ * associated with the file descriptor of the underlying connection. Freeing
+ * this guac_socket will automatically free the SSL connection and close the
+ * associated file descriptor.
+ *
+ * @param ssl
+ *     The SSL connection to use for all communication, which must have
+ *     completed its handshake.
+ *
+ * @return
+ *     A newly-allocated guac_socket which will transparently use the given
+ *     SSL connection for all communication.
+ */
+guac_socket* guac_socket_open_ssl(SSL* ssl);
+
 #endif
 
@@ -240,9 +240,14 @@ guac_socket* guac_socket_tee(guac_socket* primary, guac_socket* secondary);
  * to read from the socket will fail. If a write occurs while no users are
  * connected, that write will simply be dropped.
  *
- * Return values (error codes) from each user's socket will not affect the
- * in-progress write, but each failing user will be forcibly stopped with
- * guac_user_stop().
+ * Instructions are serialized only once and are delivered to each user
+ * asynchronously, such that a slow user does not delay delivery to other
+ * users. Return values (error codes) from each user's socket will not affect
+ * the in-progress write, but each failing user will be forcibly stopped with
+ * guac_user_stop(). If only one user is connected, writes are subject to the
+ * same backpressure as writes to that user's socket. Users which fall too far
+ * behind other users have any pending data dropped and are resynchronized
+ * with the current state of the connection.
  *
  * If an error occurs while allocating the guac_socket object, NULL is returned,
  * and guac_error is set appropriately.
@@ -266,9 +271,10 @@ guac_socket* guac_socket_broadcast(guac_client* client);
  * Attempts to read from the socket will fail.  If a write occurs while no
  * users are connected, that write will simply be dropped.
  *
- * Return values (error codes) from each user's socket will not affect the
- * in-progress write, but each failing user will be forcibly stopped with
- * guac_user_stop().
+ * As with guac_socket_broadcast(), instructions are delivered to each user
+ * asynchronously. Return values (error codes) from each user's socket will
+ * not affect the in-progress write, but each failing user will be forcibly
+ * stopped with guac_user_stop().
  *
  * If an error occurs while allocating the guac_socket object, NULL is returned,
  * and guac_error is set appropriately.
@@ -538,6 +538,14 @@ struct guac_user {
      */
     guac_user_touch_handler* touch_handler;
 
+    /**
+     * The queue of data broadcast to this user which has not yet been written
+     * to this user's socket, or NULL if this user has not joined a
+     * connection. This queue is managed internally by the guac_client that
+     * the user has joined.
+     */
+    struct guac_socket_broadcast_queue* __broadcast_queue;
+
 };
 
 /**
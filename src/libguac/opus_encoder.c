@@ -0,0 +1,404 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/mem.h"
+#include "guacamole/audio.h"
+#include "guacamole/client.h"
+#include "guacamole/protocol.h"
+#include "guacamole/socket.h"
+#include "guacamole/user.h"
+#include "opus_encoder.h"
+
+#include <opus/opus.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Returns the number of channels which will be encoded for the given audio
+ * stream. Opus streams produced by this encoder are either mono or stereo.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @return
+ *     The number of channels to encode, either 1 or 2.
+ */
+static int guac_opus_encoder_channels(guac_audio_stream* audio) {
+    return audio->channels >= 2 ? 2 : 1;
+}
+
+/**
+ * Returns the frame duration which should be used for the given audio
+ * stream, in milliseconds. Opus supports only a fixed set of frame
+ * durations, thus the largest supported duration not exceeding the requested
+ * duration is used.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @return
+ *     The frame duration to use, in milliseconds.
+ */
+static int guac_opus_encoder_frame_duration(guac_audio_stream* audio) {
+
+    int requested = audio->frame_duration;
+    if (requested <= 0)
+        return GUAC_OPUS_ENCODER_DEFAULT_FRAME_DURATION;
+
+    if (requested >= 60) return 60;
+    if (requested >= 40) return 40;
+    if (requested >= 20) return 20;
+    if (requested >= 10) return 10;
+    return 5;
+
+}
+
+static void guac_opus_encoder_send_audio(guac_audio_stream* audio,
+        guac_socket* socket) {
+
+    char mimetype[256];
+
+    /* Produce mimetype string from format info */
+    snprintf(mimetype, sizeof(mimetype), "audio/opus;rate=%i,channels=%i",
+            GUAC_OPUS_ENCODER_RATE, guac_opus_encoder_channels(audio));
+
+    /* Associate stream */
+    guac_protocol_send_audio(socket, audio->stream, mimetype);
+
+}
+
+/**
+ * Creates the underlying libopus encoder using the compression parameters
+ * currently set on the given audio stream. If the encoder cannot be created,
+ * the encoder state is marked as failed.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param state
+ *     The state of the Opus encoder.
+ */
+static void guac_opus_encoder_create(guac_audio_stream* audio,
+        guac_opus_encoder_state* state) {
+
+    int error;
+
+    int application = audio->low_delay
+        ? OPUS_APPLICATION_RESTRICTED_LOWDELAY
+        : OPUS_APPLICATION_AUDIO;
+
+    state->encoder = opus_encoder_create(GUAC_OPUS_ENCODER_RATE,
+            state->channels, application, &error);
+
+    if (state->encoder == NULL) {
+        guac_client_log(audio->client, GUAC_LOG_WARNING, "Opus encoder "
+                "could not be created: %s", opus_strerror(error));
+        state->failed = 1;
+        return;
+    }
+
+    int bitrate = audio->bitrate > 0
+        ? audio->bitrate
+        : GUAC_OPUS_ENCODER_DEFAULT_BITRATE;
+
+    opus_encoder_ctl(state->encoder, OPUS_SET_BITRATE(bitrate));
+
+    /* Allocate space for a single frame */
+    state->frame_duration = guac_opus_encoder_frame_duration(audio);
+    state->frame_size = GUAC_OPUS_ENCODER_RATE / 1000 * state->frame_duration;
+    state->frame = guac_mem_alloc(sizeof(opus_int16),
+            state->frame_size, state->channels);
+
+    guac_client_log(audio->client, GUAC_LOG_DEBUG, "Encoding audio as Opus "
+            "at %i bps with %i ms frames%s.", bitrate, state->frame_duration,
+            audio->low_delay ? " (low delay)" : "");
+
+}
+
+/**
+ * Sends all encoded packets which have not yet been sent as a single blob.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param state
+ *     The state of the Opus encoder.
+ */
+static void guac_opus_encoder_send_packets(guac_audio_stream* audio,
+        guac_opus_encoder_state* state) {
+
+    if (state->packets_length == 0)
+        return;
+
+    guac_protocol_send_blob(audio->client->socket, audio->stream,
+            state->packets, state->packets_length);
+
+    state->packets_length = 0;
+    state->packets_frames = 0;
+
+}
+
+/**
+ * Encodes the current frame as a single Opus packet, appending that packet
+ * to the packets awaiting send. Packets are sent automatically if the
+ * maximum amount of buffered audio has been reached.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param state
+ *     The state of the Opus encoder.
+ */
+static void guac_opus_encoder_encode_frame(guac_audio_stream* audio,
+        guac_opus_encoder_state* state) {
+
+    state->frame_written = 0;
+
+    /* Ensure there is space for the largest possible packet */
+    if (state->packets_length + 2 + GUAC_OPUS_ENCODER_MAX_PACKET_SIZE
+            > GUAC_OPUS_ENCODER_BLOB_SIZE)
+        guac_opus_encoder_send_packets(audio, state);
+
+    unsigned char* packet = state->packets + state->packets_length;
+    opus_int32 length = opus_encode(state->encoder, state->frame,
+            state->frame_size, packet + 2, GUAC_OPUS_ENCODER_MAX_PACKET_SIZE);
+
+    if (length < 0) {
+        guac_client_log(audio->client, GUAC_LOG_WARNING, "Opus encoding "
+                "failed: %s", opus_strerror(length));
+        return;
+    }
+
+    /* Prefix packet with its length */
+    packet[0] = (length >> 8) & 0xFF;
+    packet[1] = length & 0xFF;
+
+    state->packets_length += 2 + length;
+    state->packets_frames++;
+
+    /* Do not allow encoded audio to be held indefinitely */
+    if (state->packets_frames * state->frame_duration
+            >= GUAC_OPUS_ENCODER_BUFFER_SIZE)
+        guac_opus_encoder_send_packets(audio, state);
+
+}
+
+/**
+ * Resamples the given input sample to GUAC_OPUS_ENCODER_RATE, adding the
+ * resulting samples (if any) to the current frame, and encoding each frame
+ * as it is completed. Resampling is performed by linear interpolation
+ * between consecutive input samples.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param state
+ *     The state of the Opus encoder.
+ *
+ * @param sample
+ *     The input sample, containing one value per channel being encoded.
+ */
+static void guac_opus_encoder_add_sample(guac_audio_stream* audio,
+        guac_opus_encoder_state* state, const opus_int16* sample) {
+
+    double step = (double) audio->rate / GUAC_OPUS_ENCODER_RATE;
+
+    while (state->position <= 1.0) {
+
+        opus_int16* output = state->frame
+            + state->frame_written * state->channels;
+
+        for (int i = 0; i < state->channels; i++)
+            output[i] = state->last[i]
+                + (sample[i] - state->last[i]) * state->position;
+
+        if (++state->frame_written == state->frame_size)
+            guac_opus_encoder_encode_frame(audio, state);
+
+        state->position += step;
+
+    }
+
+    state->position -= 1.0;
+    memcpy(state->last, sample, sizeof(state->last));
+
+}
+
+/**
+ * Converts a single sample of raw PCM data having the format of the given
+ * audio stream into signed 16-bit values, one per channel being encoded,
+ * and adds that sample to the audio being encoded.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param state
+ *     The state of the Opus encoder.
+ *
+ * @param pcm_data
+ *     The raw PCM data of the sample. This must contain exactly one value
+ *     for each channel of the audio stream.
+ */
+static void guac_opus_encoder_add_pcm(guac_audio_stream* audio,
+        guac_opus_encoder_state* state, const unsigned char* pcm_data) {
+
+    opus_int16 sample[2] = { 0, 0 };
+
+    for (int i = 0; i < state->channels; i++) {
+
+        /* 8-bit samples are signed */
+        if (audio->bps == 8)
+            sample[i] = (int8_t) pcm_data[i] * 256;
+
+        /* 16-bit samples are signed and little-endian */
+        else
+            sample[i] = (int16_t) (pcm_data[i*2] | (pcm_data[i*2 + 1] << 8));
+
+    }
+
+    guac_opus_encoder_add_sample(audio, state, sample);
+
+}
+
+static void guac_opus_encoder_begin_handler(guac_audio_stream* audio) {
+
+    guac_opus_encoder_state* state;
+
+    /* Broadcast existence of stream */
+    guac_opus_encoder_send_audio(audio, audio->client->socket);
+
+    /* Allocate and init encoder state (the libopus encoder itself is created
+     * upon first write) */
+    audio->data = state = guac_mem_zalloc(sizeof(guac_opus_encoder_state));
+    state->channels = guac_opus_encoder_channels(audio);
+    state->position = 1.0;
+
+}
+
+static void guac_opus_encoder_join_handler(guac_audio_stream* audio,
+        guac_user* user) {
+
+    /* Notify user of existence of stream */
+    guac_opus_encoder_send_audio(audio, user->socket);
+
+}
+
+static void guac_opus_encoder_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm_data, int length) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+
+    if (state->encoder == NULL && !state->failed)
+        guac_opus_encoder_create(audio, state);
+
+    if (state->failed)
+        return;
+
+    int sample_size = audio->channels * audio->bps / 8;
+
+    /* Complete any partial sample remaining from the previous write */
+    if (state->partial_length > 0) {
+
+        int remaining = sample_size - state->partial_length;
+        if (remaining > length)
+            remaining = length;
+
+        memcpy(state->partial + state->partial_length, pcm_data, remaining);
+        state->partial_length += remaining;
+        pcm_data += remaining;
+        length -= remaining;
+
+        if (state->partial_length < sample_size)
+            return;
+
+        guac_opus_encoder_add_pcm(audio, state, state->partial);
+        state->partial_length = 0;
+
+    }
+
+    /* Add each complete sample */
+    while (length >= sample_size) {
+        guac_opus_encoder_add_pcm(audio, state, pcm_data);
+        pcm_data += sample_size;
+        length -= sample_size;
+    }
+
+    /* Store any partial sample until the next write */
+    if (length > 0 && length <= (int) sizeof(state->partial)) {
+        memcpy(state->partial, pcm_data, length);
+        state->partial_length = length;
+    }
+
+}
+
+static void guac_opus_encoder_flush_handler(guac_audio_stream* audio) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+
+    /* Send all complete frames (any partial frame remains buffered until
+     * enough audio has been written to complete it) */
+    guac_opus_encoder_send_packets(audio, state);
+
+}
+
+static void guac_opus_encoder_end_handler(guac_audio_stream* audio) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+
+    if (state->encoder != NULL) {
+
+        /* Pad any partial frame with silence */
+        if (state->frame_written > 0) {
+            memset(state->frame + state->frame_written * state->channels, 0,
+                    sizeof(opus_int16) * state->channels
+                    * (state->frame_size - state->frame_written));
+            guac_opus_encoder_encode_frame(audio, state);
+        }
+
+        guac_opus_encoder_send_packets(audio, state);
+        opus_encoder_destroy(state->encoder);
+
+    }
+
+    /* Send end of stream */
+    guac_protocol_send_end(audio->client->socket, audio->stream);
+
+    /* Free state information */
+    guac_mem_free(state->frame);
+    guac_mem_free(state);
+
+}
+
+/* Opus encoder handlers */
+guac_audio_encoder _guac_opus_encoder = {
+    .mimetype      = "audio/opus",
+    .begin_handler = guac_opus_encoder_begin_handler,
+    .write_handler = guac_opus_encoder_write_handler,
+    .flush_handler = guac_opus_encoder_flush_handler,
+    .join_handler  = guac_opus_encoder_join_handler,
+    .end_handler   = guac_opus_encoder_end_handler
+};
+
+/* Actual encoder definition */
+guac_audio_encoder* guac_opus_encoder = &_guac_opus_encoder;
+
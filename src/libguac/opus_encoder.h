@@ -0,0 +1,159 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_OPUS_ENCODER_H
+#define GUAC_OPUS_ENCODER_H
+
+#include "config.h"
+
+#include "guacamole/audio.h"
+
+#include <opus/opus.h>
+
+/**
+ * The sample rate of all audio encoded by the Opus encoder, in samples per
+ * second. PCM data of any other rate is resampled to this rate prior to
+ * encoding.
+ */
+#define GUAC_OPUS_ENCODER_RATE 48000
+
+/**
+ * The default target bitrate of the Opus encoder, in bits per second, used
+ * if no bitrate has been set for the audio stream.
+ */
+#define GUAC_OPUS_ENCODER_DEFAULT_BITRATE 32000
+
+/**
+ * The default duration of each Opus frame, in milliseconds, used if no frame
+ * duration has been set for the audio stream.
+ */
+#define GUAC_OPUS_ENCODER_DEFAULT_FRAME_DURATION 20
+
+/**
+ * The maximum size of a single Opus packet, in bytes.
+ */
+#define GUAC_OPUS_ENCODER_MAX_PACKET_SIZE 1275
+
+/**
+ * The maximum number of bytes to send in each audio blob.
+ */
+#define GUAC_OPUS_ENCODER_BLOB_SIZE 6048
+
+/**
+ * The maximum duration of audio which may be encoded but not yet sent, in
+ * milliseconds, regardless of whether the audio stream has been flushed.
+ */
+#define GUAC_OPUS_ENCODER_BUFFER_SIZE 100
+
+/**
+ * The current state of the Opus encoder. PCM data is converted to signed
+ * 16-bit samples, resampled to GUAC_OPUS_ENCODER_RATE, and accumulated into
+ * frames. Each complete frame is encoded as a single Opus packet, and packets
+ * are sent in blobs, each packet preceded by its length as a 16-bit unsigned
+ * big-endian integer.
+ */
+typedef struct guac_opus_encoder_state {
+
+    /**
+     * The underlying libopus encoder, or NULL if no PCM data has yet been
+     * written. The libopus encoder is created upon the first write, such
+     * that the compression parameters of the audio stream may be set after
+     * the stream is allocated.
+     */
+    OpusEncoder* encoder;
+
+    /**
+     * Non-zero if the libopus encoder could not be created or has failed,
+     * in which case all further PCM data is ignored.
+     */
+    int failed;
+
+    /**
+     * The number of channels being encoded (1 or 2).
+     */
+    int channels;
+
+    /**
+     * The number of samples per channel within each frame.
+     */
+    int frame_size;
+
+    /**
+     * The duration of each frame, in milliseconds.
+     */
+    int frame_duration;
+
+    /**
+     * The frame currently being accumulated, as interleaved signed 16-bit
+     * samples.
+     */
+    opus_int16* frame;
+
+    /**
+     * The number of samples per channel currently within the frame.
+     */
+    int frame_written;
+
+    /**
+     * The position of the next resampled sample, in units of input samples,
+     * relative to the input sample preceding the most recent input sample.
+     */
+    double position;
+
+    /**
+     * The most recent input sample of each channel.
+     */
+    opus_int16 last[2];
+
+    /**
+     * Any partial input sample remaining from the previous write, as raw
+     * PCM data.
+     */
+    unsigned char partial[4];
+
+    /**
+     * The number of bytes within the partial input sample buffer.
+     */
+    int partial_length;
+
+    /**
+     * Encoded packets which have not yet been sent, each preceded by its
+     * length.
+     */
+    unsigned char packets[GUAC_OPUS_ENCODER_BLOB_SIZE];
+
+    /**
+     * The number of bytes within the packet buffer.
+     */
+    int packets_length;
+
+    /**
+     * The number of frames within the packet buffer.
+     */
+    int packets_frames;
+
+} guac_opus_encoder_state;
+
+/**
+ * Audio encoder which encodes PCM data of any format as Opus.
+ */
+extern guac_audio_encoder* guac_opus_encoder;
+
+#endif
+
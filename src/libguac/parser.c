@@ -23,12 +23,48 @@
 #include "guacamole/error.h"
 #include "guacamole/parser.h"
 #include "guacamole/socket.h"
-#include "guacamole/unicode.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+/**
+ * The number of bytes of element content examined at once while searching
+ * for the end of an element.
+ */
+#define GUAC_PARSER_WORD_SIZE 8
+
+/**
+ * Returns the number of UTF-8 characters which begin within the
+ * GUAC_PARSER_WORD_SIZE bytes at the given location. All bytes other than
+ * continuation bytes (bytes of the form 10xxxxxx) begin a character. The
+ * bytes are examined in parallel as a single 64-bit word.
+ *
+ * @param data
+ *     The bytes to examine. There must be at least GUAC_PARSER_WORD_SIZE
+ *     bytes available at this location, though no alignment is required.
+ *
+ * @return
+ *     The number of UTF-8 characters beginning within the given bytes.
+ */
+static int guac_parser_count_chars(const unsigned char* data) {
+
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+
+    /* Set the low bit of each byte having its high bit set and the
+     * following bit clear (a continuation byte) */
+    uint64_t continuation = ((word & ~(word << 1)) >> 7)
+        & UINT64_C(0x0101010101010101);
+
+    /* Sum all bytes, each of which is now either 0 or 1 */
+    int continuation_count = (continuation * UINT64_C(0x0101010101010101)) >> 56;
+
+    return GUAC_PARSER_WORD_SIZE - continuation_count;
+
+}
+
 static void guac_parser_reset(guac_parser* parser) {
     parser->opcode = NULL;
     parser->argc = 0;
@@ -111,52 +147,69 @@ int guac_parser_append(guac_parser* parser, void* buffer, int length) {
     /* Parse element content */
     if (parser->state == GUAC_PARSE_CONTENT) {
 
-        while (bytes_parsed < length && parser->__element_length >= 0) {
+        unsigned char* current = (unsigned char*) char_buffer;
+        unsigned char* end = (unsigned char*) buffer + length;
+
+        /* Skip whole words at a time while the terminator cannot possibly
+         * be within the next word */
+        int element_length = parser->__element_length;
+        while (element_length >= GUAC_PARSER_WORD_SIZE
+                && end - current >= GUAC_PARSER_WORD_SIZE) {
+            element_length -= guac_parser_count_chars(current);
+            current += GUAC_PARSER_WORD_SIZE;
+        }
+
+        /* Locate terminator one byte at a time */
+        for (; current < end; current++) {
 
-            /* Get length of current character */
-            char c = *char_buffer;
-            int char_length = guac_utf8_charsize((unsigned char) c);
+            /* Continuation bytes never start a character */
+            unsigned char c = *current;
+            if ((c & 0xC0) == 0x80)
+                continue;
 
-            /* If full character not present in buffer, stop now */
-            if (char_length + bytes_parsed > length)
+            /* Handle terminator if end of element reached */
+            if (element_length == 0)
                 break;
 
-            /* Record character as parsed */
-            bytes_parsed += char_length;
+            element_length--;
 
-            /* If end of element, handle terminator */
-            if (parser->__element_length == 0) {
+        }
 
-                *char_buffer = '\0';
+        bytes_parsed = (char*) current - (char*) buffer;
+        parser->__element_length = element_length;
 
-                /* If semicolon, store end-of-instruction */
-                if (c == ';') {
-                    parser->state = GUAC_PARSE_COMPLETE;
-                    parser->opcode = parser->__elementv[0];
-                    parser->argv = &(parser->__elementv[1]);
-                    parser->argc = parser->__elementc - 1;
-                    break;
-                }
+        /* If end of element, handle terminator */
+        if (current < end) {
 
-                /* If comma, move on to next element */
-                else if (c == ',') {
-                    parser->state = GUAC_PARSE_LENGTH;
-                    break;
-                }
+            char c = *current;
+            char* element = parser->__elementv[parser->__elementc - 1];
 
-                /* Otherwise, parse error */
-                else {
-                    parser->state = GUAC_PARSE_ERROR;
-                    return 0;
-                }
+            *current = '\0';
+            bytes_parsed++;
+
+            parser->__element_sizes[parser->__elementc - 1] =
+                (char*) current - element;
 
-            } /* end if end of element */
+            /* If semicolon, store end-of-instruction */
+            if (c == ';') {
+                parser->state = GUAC_PARSE_COMPLETE;
+                parser->opcode = parser->__elementv[0];
+                parser->argv = &(parser->__elementv[1]);
+                parser->argv_sizes = &(parser->__element_sizes[1]);
+                parser->argc = parser->__elementc - 1;
+            }
 
-            /* Advance to next character */
-            parser->__element_length--;
-            char_buffer += char_length;
+            /* If comma, move on to next element */
+            else if (c == ',')
+                parser->state = GUAC_PARSE_LENGTH;
 
-        }
+            /* Otherwise, parse error */
+            else {
+                parser->state = GUAC_PARSE_ERROR;
+                return 0;
+            }
+
+        } /* end if end of element */
 
     } /* end parse content */
 
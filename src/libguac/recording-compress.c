@@ -0,0 +1,556 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/mem.h"
+#include "guacamole/recording.h"
+#include "guacamole/timestamp-types.h"
+#include "recording-compress.h"
+#include "socket-async.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * The maximum number of bytes of the opcode of each instruction retained by
+ * the instruction scanner. Longer opcodes are truncated.
+ */
+#define GUAC_RECORDING_COMPRESS_MAX_OPCODE 16
+
+/**
+ * The maximum number of bytes of the first argument of each instruction
+ * retained by the instruction scanner. Longer arguments are truncated.
+ */
+#define GUAC_RECORDING_COMPRESS_MAX_ARG 32
+
+/**
+ * The possible states of the instruction scanner.
+ */
+typedef enum guac_recording_compress_scan_state {
+
+    /**
+     * The scanner is reading the decimal length prefix of an element.
+     */
+    GUAC_RECORDING_COMPRESS_SCAN_LENGTH,
+
+    /**
+     * The scanner is reading the value of an element.
+     */
+    GUAC_RECORDING_COMPRESS_SCAN_VALUE
+
+} guac_recording_compress_scan_state;
+
+/**
+ * The state of a compressed recording, used as the sink of the asynchronous
+ * socket writing that recording.
+ */
+typedef struct guac_recording_compress {
+
+    /**
+     * The file descriptor of the recording file.
+     */
+    int fd;
+
+    /**
+     * The file descriptor of the index file.
+     */
+    int index_fd;
+
+    /**
+     * The zlib stream compressing the current member.
+     */
+    z_stream stream;
+
+    /**
+     * Compressed data which has not yet been written to the recording file.
+     */
+    unsigned char output[GUAC_RECORDING_COMPRESS_BUFFER_SIZE];
+
+    /**
+     * The number of compressed bytes written to the recording file so far,
+     * not including any data remaining within the output buffer.
+     */
+    uint64_t written;
+
+    /**
+     * The offset of the first byte of the current member within the
+     * recording file.
+     */
+    uint64_t member_offset;
+
+    /**
+     * The number of uncompressed bytes within the current member.
+     */
+    size_t member_size;
+
+    /**
+     * The timestamp of the first "sync" instruction within the current
+     * member, or -1 if no such instruction has yet been written.
+     */
+    guac_timestamp member_timestamp;
+
+    /**
+     * Non-zero if the current member begins with a keyframe, zero otherwise.
+     */
+    int member_keyframe;
+
+    /**
+     * The timestamp of the most recent "sync" instruction written.
+     */
+    guac_timestamp last_timestamp;
+
+    /**
+     * The current state of the instruction scanner.
+     */
+    guac_recording_compress_scan_state scan_state;
+
+    /**
+     * The index of the element currently being scanned within the current
+     * instruction, where the opcode is element 0.
+     */
+    int element;
+
+    /**
+     * The length of the element currently being scanned, in Unicode
+     * codepoints, or, while its value is being scanned, the number of
+     * codepoints remaining.
+     */
+    size_t element_length;
+
+    /**
+     * The opcode of the current instruction, truncated to
+     * GUAC_RECORDING_COMPRESS_MAX_OPCODE bytes.
+     */
+    char opcode[GUAC_RECORDING_COMPRESS_MAX_OPCODE];
+
+    /**
+     * The number of bytes stored within the opcode buffer.
+     */
+    size_t opcode_length;
+
+    /**
+     * The first argument of the current instruction, truncated to
+     * GUAC_RECORDING_COMPRESS_MAX_ARG - 1 bytes.
+     */
+    char arg[GUAC_RECORDING_COMPRESS_MAX_ARG];
+
+    /**
+     * The number of bytes stored within the argument buffer.
+     */
+    size_t arg_length;
+
+} guac_recording_compress;
+
+/**
+ * Writes the entirety of the given buffer to the given file descriptor,
+ * retrying partial writes.
+ *
+ * @param fd
+ *     The file descriptor to write to.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise.
+ */
+static int guac_recording_compress_write_all(int fd, const void* buffer,
+        size_t length) {
+
+    const char* current = (const char*) buffer;
+
+    while (length > 0) {
+
+        /* Retry writes interrupted by signals */
+        ssize_t written = write(fd, current, length);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return 1;
+        }
+
+        current += written;
+        length -= written;
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Writes all compressed data within the output buffer to the recording file,
+ * emptying the output buffer.
+ *
+ * @param compress
+ *     The compressed recording whose output buffer should be written.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise.
+ */
+static int guac_recording_compress_flush_output(guac_recording_compress* compress) {
+
+    size_t length = sizeof(compress->output) - compress->stream.avail_out;
+    if (guac_recording_compress_write_all(compress->fd, compress->output, length))
+        return 1;
+
+    compress->written += length;
+    compress->stream.next_out = compress->output;
+    compress->stream.avail_out = sizeof(compress->output);
+    return 0;
+
+}
+
+/**
+ * Compresses the given data as part of the current member, writing any
+ * compressed data to the recording file as the output buffer fills.
+ *
+ * @param compress
+ *     The compressed recording to write to.
+ *
+ * @param buffer
+ *     The uncompressed data to compress, or NULL if the current member is
+ *     being finished.
+ *
+ * @param length
+ *     The number of bytes of uncompressed data.
+ *
+ * @param flush
+ *     The zlib flush mode to use (Z_NO_FLUSH or Z_FINISH).
+ *
+ * @return
+ *     Zero if compression and writing succeeded, non-zero otherwise.
+ */
+static int guac_recording_compress_deflate(guac_recording_compress* compress,
+        const char* buffer, size_t length, int flush) {
+
+    z_stream* stream = &compress->stream;
+    stream->next_in = (Bytef*) buffer;
+    stream->avail_in = length;
+
+    for (;;) {
+
+        int result = deflate(stream, flush);
+        if (result == Z_STREAM_ERROR)
+            return 1;
+
+        /* Write compressed data only once the output buffer is full, such
+         * that the recording file is written in large blocks */
+        if (stream->avail_out == 0) {
+            if (guac_recording_compress_flush_output(compress))
+                return 1;
+            continue;
+        }
+
+        if (flush == Z_FINISH ? result == Z_STREAM_END : stream->avail_in == 0)
+            return 0;
+
+    }
+
+}
+
+/**
+ * Finishes the current member of the given compressed recording, writing all
+ * of its compressed data and its line within the index file. If the current
+ * member is empty, this function has no effect.
+ *
+ * @param compress
+ *     The compressed recording whose current member should be finished.
+ *
+ * @return
+ *     Zero if the member was finished successfully, non-zero otherwise.
+ */
+static int guac_recording_compress_end_member(guac_recording_compress* compress) {
+
+    if (compress->member_size == 0)
+        return 0;
+
+    if (guac_recording_compress_deflate(compress, NULL, 0, Z_FINISH)
+            || guac_recording_compress_flush_output(compress))
+        return 1;
+
+    /* Members without any "sync" instruction inherit the timestamp of the
+     * most recent frame */
+    guac_timestamp timestamp = compress->member_timestamp;
+    if (timestamp < 0)
+        timestamp = compress->last_timestamp;
+
+    char line[64];
+    int length = snprintf(line, sizeof(line), "%" PRId64 " %" PRIu64 " %c\n",
+            (int64_t) timestamp, compress->member_offset,
+            compress->member_keyframe
+                ? GUAC_RECORDING_INDEX_KEYFRAME : GUAC_RECORDING_INDEX_FRAME);
+
+    if (guac_recording_compress_write_all(compress->index_fd, line, length))
+        return 1;
+
+    deflateReset(&compress->stream);
+    compress->member_offset = compress->written;
+    compress->member_size = 0;
+    compress->member_timestamp = -1;
+    compress->member_keyframe = 0;
+    return 0;
+
+}
+
+/**
+ * Scans the given Guacamole protocol data for the end of the next "sync"
+ * instruction, updating the state of the instruction scanner. Data may be
+ * split arbitrarily across calls.
+ *
+ * @param compress
+ *     The compressed recording whose instruction scanner should be used.
+ *
+ * @param buffer
+ *     The data to scan.
+ *
+ * @param length
+ *     The number of bytes to scan.
+ *
+ * @param timestamp
+ *     Pointer to a guac_timestamp which receives the timestamp of the
+ *     "sync" instruction found, if any.
+ *
+ * @return
+ *     The number of bytes up to and including the end of the first "sync"
+ *     instruction within the given data, or zero if no "sync" instruction
+ *     ends within the given data.
+ */
+static size_t guac_recording_compress_scan(guac_recording_compress* compress,
+        const char* buffer, size_t length, guac_timestamp* timestamp) {
+
+    for (size_t i = 0; i < length; i++) {
+
+        char c = buffer[i];
+
+        if (compress->scan_state == GUAC_RECORDING_COMPRESS_SCAN_LENGTH) {
+
+            if (c >= '0' && c <= '9')
+                compress->element_length = compress->element_length * 10 + (c - '0');
+
+            else if (c == '.')
+                compress->scan_state = GUAC_RECORDING_COMPRESS_SCAN_VALUE;
+
+            continue;
+
+        }
+
+        /* Element lengths are in codepoints, thus only bytes which begin a
+         * codepoint count against the remaining length, and the element ends
+         * at the first such byte beyond that length */
+        int continuation = (c & 0xC0) == 0x80;
+        if (continuation || compress->element_length > 0) {
+
+            if (!continuation)
+                compress->element_length--;
+
+            if (compress->element == 0
+                    && compress->opcode_length < sizeof(compress->opcode))
+                compress->opcode[compress->opcode_length++] = c;
+
+            else if (compress->element == 1
+                    && compress->arg_length < sizeof(compress->arg) - 1)
+                compress->arg[compress->arg_length++] = c;
+
+            continue;
+
+        }
+
+        /* Any terminator begins a new element */
+        compress->scan_state = GUAC_RECORDING_COMPRESS_SCAN_LENGTH;
+        compress->element_length = 0;
+        compress->element++;
+
+        if (c != ';')
+            continue;
+
+        /* The instruction is complete */
+        int sync = compress->opcode_length == 4
+                && memcmp(compress->opcode, "sync", 4) == 0;
+
+        compress->arg[compress->arg_length] = '\0';
+        if (sync)
+            *timestamp = strtoll(compress->arg, NULL, 10);
+
+        compress->element = 0;
+        compress->opcode_length = 0;
+        compress->arg_length = 0;
+
+        if (sync)
+            return i + 1;
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Sink write handler which compresses the given complete instructions,
+ * ending the current member at any "sync" instruction once that member is
+ * large enough or covers enough time.
+ *
+ * @param data
+ *     The guac_recording_compress of the recording.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise.
+ */
+static int guac_recording_compress_write(void* data, const char* buffer,
+        size_t length) {
+
+    guac_recording_compress* compress = (guac_recording_compress*) data;
+
+    while (length > 0) {
+
+        guac_timestamp timestamp;
+        size_t frame_length = guac_recording_compress_scan(compress, buffer,
+                length, &timestamp);
+
+        /* Compress everything if no frame ends within the given data */
+        size_t chunk = frame_length ? frame_length : length;
+        if (guac_recording_compress_deflate(compress, buffer, chunk, Z_NO_FLUSH))
+            return 1;
+
+        compress->member_size += chunk;
+        buffer += chunk;
+        length -= chunk;
+
+        if (!frame_length)
+            break;
+
+        if (compress->member_timestamp < 0)
+            compress->member_timestamp = timestamp;
+
+        compress->last_timestamp = timestamp;
+
+        /* Start a new member at this frame boundary if the current member is
+         * large enough */
+        if (compress->member_size >= GUAC_RECORDING_COMPRESS_MEMBER_SIZE
+                || timestamp - compress->member_timestamp
+                    >= GUAC_RECORDING_COMPRESS_MEMBER_DURATION) {
+            if (guac_recording_compress_end_member(compress))
+                return 1;
+        }
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Sink mark handler which ends the current member, flagging the following
+ * member as a keyframe.
+ *
+ * @param data
+ *     The guac_recording_compress of the recording.
+ *
+ * @return
+ *     Zero if the current member was ended successfully, non-zero otherwise.
+ */
+static int guac_recording_compress_mark(void* data) {
+
+    guac_recording_compress* compress = (guac_recording_compress*) data;
+
+    if (guac_recording_compress_end_member(compress))
+        return 1;
+
+    compress->member_keyframe = 1;
+    return 0;
+
+}
+
+/**
+ * Sink close handler which finishes the final member of the recording and
+ * closes both the recording and index files.
+ *
+ * @param data
+ *     The guac_recording_compress of the recording.
+ */
+static void guac_recording_compress_close(void* data) {
+
+    guac_recording_compress* compress = (guac_recording_compress*) data;
+
+    guac_recording_compress_end_member(compress);
+    deflateEnd(&compress->stream);
+
+    close(compress->fd);
+    close(compress->index_fd);
+    guac_mem_free(compress);
+
+}
+
+guac_socket* guac_recording_compress_open(int fd, int index_fd) {
+
+    guac_recording_compress* compress = guac_mem_zalloc(sizeof(guac_recording_compress));
+    compress->fd = fd;
+    compress->index_fd = index_fd;
+    compress->member_timestamp = -1;
+
+    /* The beginning of the recording contains the entire state of the
+     * connection */
+    compress->member_keyframe = 1;
+
+    /* Each member is a complete gzip stream (window bits of 16 + 15) */
+    if (deflateInit2(&compress->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        guac_mem_free(compress);
+        return NULL;
+    }
+
+    compress->stream.next_out = compress->output;
+    compress->stream.avail_out = sizeof(compress->output);
+
+    guac_socket_async_sink sink = {
+        .write_handler = guac_recording_compress_write,
+        .mark_handler  = guac_recording_compress_mark,
+        .close_handler = guac_recording_compress_close,
+        .data = compress
+    };
+
+    guac_socket* socket = guac_socket_async_open_sink(&sink,
+            GUAC_SOCKET_ASYNC_DEFAULT_CAPACITY,
+            GUAC_SOCKET_ASYNC_OVERFLOW_BLOCK);
+
+    /* The file descriptors remain owned by the caller on failure */
+    if (socket == NULL) {
+        deflateEnd(&compress->stream);
+        guac_mem_free(compress);
+    }
+
+    return socket;
+
+}
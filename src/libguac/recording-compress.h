@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_RECORDING_COMPRESS_H
+#define GUAC_RECORDING_COMPRESS_H
+
+#include "config.h"
+
+#include "guacamole/socket-types.h"
+
+/**
+ * The number of uncompressed bytes after which the current gzip member of a
+ * compressed recording is ended at the next "sync" instruction. Smaller
+ * members allow finer-grained seeking at the expense of compression ratio.
+ */
+#define GUAC_RECORDING_COMPRESS_MEMBER_SIZE 4194304
+
+/**
+ * The number of milliseconds of recorded time after which the current gzip
+ * member of a compressed recording is ended at the next "sync" instruction,
+ * regardless of its size.
+ */
+#define GUAC_RECORDING_COMPRESS_MEMBER_DURATION 10000
+
+/**
+ * The size of the buffer used to accumulate compressed data before writing
+ * that data to the recording file, in bytes.
+ */
+#define GUAC_RECORDING_COMPRESS_BUFFER_SIZE 262144
+
+/**
+ * Creates a new write-only guac_socket which compresses all data written to
+ * it and writes that data to the given recording file from a dedicated
+ * thread, as with guac_socket_async_open(). The recording file consists of a
+ * series of independent gzip members, each ending at a "sync" instruction,
+ * such that the file as a whole can be decompressed with standard tools while
+ * any individual member can be decompressed without reading the members
+ * preceding it. One line describing each member is written to the given
+ * index file, in the format described by GUAC_RECORDING_INDEX_SUFFIX.
+ *
+ * Marking the returned socket with guac_socket_async_mark() ends the current
+ * member, with the following member being flagged as a keyframe within the
+ * index.
+ *
+ * Both file descriptors are closed when the returned socket is freed.
+ *
+ * @param fd
+ *     The file descriptor of the recording file.
+ *
+ * @param index_fd
+ *     The file descriptor of the index file.
+ *
+ * @return
+ *     A newly-allocated guac_socket which compresses and writes to the given
+ *     recording file asynchronously, or NULL if the compressor or its
+ *     writer thread cannot be initialized. If NULL is returned, neither file
+ *     descriptor is closed.
+ */
+guac_socket* guac_recording_compress_open(int fd, int index_fd);
+
+#endif
+
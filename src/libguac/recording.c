@@ -17,12 +17,21 @@
  * under the License.
  */
 
+#include "config.h"
+
+#include "display-priv.h"
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
+#include "guacamole/display.h"
 #include "guacamole/protocol.h"
 #include "guacamole/recording.h"
 #include "guacamole/socket.h"
 #include "guacamole/timestamp.h"
+#include "socket-async.h"
+
+#ifdef ENABLE_ZLIB
+#include "recording-compress.h"
+#endif
 
 #ifdef __MINGW32__
 #include <direct.h>
@@ -32,6 +41,7 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -146,6 +156,17 @@ guac_recording* guac_recording_create(guac_client* client,
         int include_output, int include_mouse, int include_touch,
         int include_keys, int allow_write_existing) {
 
+    return guac_recording_create_ex(client, path, name, create_path,
+            include_output, include_mouse, include_touch, include_keys,
+            allow_write_existing, 0);
+
+}
+
+guac_recording* guac_recording_create_ex(guac_client* client,
+        const char* path, const char* name, int create_path,
+        int include_output, int include_mouse, int include_touch,
+        int include_keys, int allow_write_existing, int compress) {
+
     char filename[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH];
 
     /* Create path if it does not exist, fail if impossible */
@@ -169,9 +190,67 @@ guac_recording* guac_recording_create(guac_client* client,
         return NULL;
     }
 
+    guac_socket* socket = NULL;
+
+    /* Compress recording and write index alongside, if requested */
+    if (compress) {
+#ifdef ENABLE_ZLIB
+        char index_filename[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH
+            + sizeof(GUAC_RECORDING_INDEX_SUFFIX)];
+
+        snprintf(index_filename, sizeof(index_filename), "%s%s",
+                filename, GUAC_RECORDING_INDEX_SUFFIX);
+
+        /* As with the recording itself, require the index not exist already
+         * unless writing to existing files has been explicitly allowed */
+        int index_flags = O_CREAT | O_WRONLY
+            | (allow_write_existing ? O_TRUNC : O_EXCL);
+
+        int index_fd = open(index_filename, index_flags,
+                S_IRUSR | S_IWUSR | S_IRGRP);
+
+        if (index_fd == -1)
+            guac_client_log(client, GUAC_LOG_WARNING, "Recording index "
+                    "\"%s\" cannot be created (%s). The recording will not be "
+                    "compressed.", index_filename, strerror(errno));
+
+        else if ((socket = guac_recording_compress_open(fd, index_fd)) == NULL) {
+            guac_client_log(client, GUAC_LOG_WARNING, "Recording compression "
+                    "could not be initialized. The recording will not be "
+                    "compressed.");
+            close(index_fd);
+        }
+#else
+        guac_client_log(client, GUAC_LOG_WARNING, "Recording compression was "
+                "requested, but this build of libguac lacks zlib support. The "
+                "recording will not be compressed.");
+#endif
+    }
+
+    /* Otherwise, write plain protocol data */
+    int compressed = (socket != NULL);
+    if (!compressed) {
+
+        socket = guac_socket_async_open(fd,
+                GUAC_SOCKET_ASYNC_DEFAULT_CAPACITY,
+                GUAC_SOCKET_ASYNC_OVERFLOW_BLOCK, 0);
+
+        if (socket == NULL) {
+            guac_client_log(client, GUAC_LOG_ERROR, "Creation of recording "
+                    "failed: Recording could not be written in the "
+                    "background.");
+            close(fd);
+            return NULL;
+        }
+
+    }
+
     /* Create recording structure with reference to underlying socket */
     guac_recording* recording = guac_mem_alloc(sizeof(guac_recording));
-    recording->socket = guac_socket_open(fd);
+    recording->client = client;
+    recording->socket = socket;
+    recording->compressed = compressed;
+    recording->last_keyframe = guac_timestamp_current();
     recording->include_output = include_output;
     recording->include_mouse = include_mouse;
     recording->include_touch = include_touch;
@@ -193,6 +272,15 @@ guac_recording* guac_recording_create(guac_client* client,
 
 void guac_recording_free(guac_recording* recording) {
 
+    guac_socket_async_stats stats;
+    guac_socket_async_get_stats(recording->socket, &stats);
+
+    guac_client_log(recording->client, GUAC_LOG_DEBUG, "Recording: %" PRIu64
+            " byte(s) written in %" PRIu64 " batch(es), %" PRIu64 " byte(s) "
+            "delayed by a full queue, %" PRIu64 " byte(s) dropped, peak of "
+            "%zu byte(s) queued.", stats.bytes_written, stats.writes,
+            stats.bytes_delayed, stats.bytes_dropped, stats.peak_queued);
+
     /* If not including broadcast output, the output socket is not associated
      * with the client, and must be freed manually */
     if (!recording->include_output)
@@ -203,6 +291,24 @@ void guac_recording_free(guac_recording* recording) {
 
 }
 
+void guac_recording_keyframe(guac_recording* recording, guac_display* display) {
+
+    /* Keyframes are only useful within indexed recordings of output */
+    if (!recording->compressed || !recording->include_output)
+        return;
+
+    guac_timestamp now = guac_timestamp_current();
+    if (now - recording->last_keyframe < GUAC_RECORDING_KEYFRAME_INTERVAL)
+        return;
+
+    /* Start a new member of the recording, beginning with the full state of
+     * the display. This state is written to the recording alone, without
+     * restarting video or clearing the image cache for connected users. */
+    if (!guac_display_write_keyframe(display, recording->socket))
+        recording->last_keyframe = now;
+
+}
+
 void guac_recording_report_mouse(guac_recording* recording,
         int x, int y, int button_mask) {
 
@@ -0,0 +1,628 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/error.h"
+#include "guacamole/flag.h"
+#include "guacamole/mem.h"
+#include "guacamole/socket.h"
+#include "socket-async.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The sink-specific data of an asynchronous socket which writes to a file
+ * descriptor.
+ */
+typedef struct guac_socket_async_fd_sink {
+
+    /**
+     * The file descriptor that queued data is written to.
+     */
+    int fd;
+
+    /**
+     * Non-zero if fdatasync() should be invoked after each batch of data is
+     * written, zero otherwise.
+     */
+    int sync;
+
+} guac_socket_async_fd_sink;
+
+/**
+ * Data associated with an open socket which writes to a sink from a
+ * dedicated thread.
+ */
+typedef struct guac_socket_async_data {
+
+    /**
+     * The sink that queued data is written to.
+     */
+    guac_socket_async_sink sink;
+
+    /**
+     * The behavior of this socket when its queue is full.
+     */
+    guac_socket_async_overflow overflow;
+
+    /**
+     * Lock which is acquired when an instruction is being written, and
+     * released when the instruction is finished being written.
+     */
+    pthread_mutex_t socket_lock;
+
+    /**
+     * The current state of the queue. This flag also guards access to all
+     * other members of this structure which may change after the socket is
+     * created.
+     */
+    guac_flag state;
+
+    /**
+     * Ring buffer of all data awaiting writing.
+     */
+    char* buffer;
+
+    /**
+     * The size of the ring buffer, in bytes.
+     */
+    size_t capacity;
+
+    /**
+     * The number of committed bytes at which the writer thread should write
+     * immediately rather than waiting for more data to accumulate.
+     */
+    size_t batch_size;
+
+    /**
+     * The offset of the first byte awaiting writing within the ring buffer.
+     */
+    size_t head;
+
+    /**
+     * The number of bytes currently within the ring buffer, including any
+     * incomplete instruction.
+     */
+    size_t length;
+
+    /**
+     * The number of bytes at the head of the ring buffer which make up
+     * complete instructions, and thus may be written by the writer thread.
+     */
+    size_t committed;
+
+    /**
+     * The total number of bytes that have been removed from the head of the
+     * ring buffer, whether written or dropped. This is the absolute position
+     * of the byte at the head of the ring buffer within the overall stream.
+     */
+    uint64_t position;
+
+    /**
+     * Non-zero if the mark handler of the sink must be invoked upon reaching
+     * mark_position, zero otherwise.
+     */
+    int mark_pending;
+
+    /**
+     * The absolute position within the overall stream at which the mark
+     * handler of the sink must be invoked, if mark_pending is non-zero.
+     */
+    uint64_t mark_position;
+
+    /**
+     * Non-zero if an instruction is currently being written, zero otherwise.
+     */
+    int in_instruction;
+
+    /**
+     * Non-zero if the remainder of the instruction currently being written
+     * is being dropped, zero otherwise.
+     */
+    int dropping;
+
+    /**
+     * Non-zero if writing to the sink has failed, in which case all further
+     * data is dropped.
+     */
+    int failed;
+
+    /**
+     * Running totals describing the data written to this socket.
+     */
+    guac_socket_async_stats stats;
+
+    /**
+     * The thread which writes queued data to the sink.
+     */
+    pthread_t writer;
+
+} guac_socket_async_data;
+
+/**
+ * Updates the state flag of the given asynchronous socket to reflect the
+ * current contents of its queue. The state flag must already be locked.
+ *
+ * @param data
+ *     The data of the asynchronous socket whose state flag should be
+ *     updated.
+ */
+static void guac_socket_async_update_state(guac_socket_async_data* data) {
+
+    if (data->committed > 0)
+        guac_flag_set(&data->state, GUAC_SOCKET_ASYNC_NONEMPTY);
+    else
+        guac_flag_clear(&data->state, GUAC_SOCKET_ASYNC_NONEMPTY);
+
+    if (data->committed >= data->batch_size)
+        guac_flag_set(&data->state, GUAC_SOCKET_ASYNC_BATCH_READY);
+    else
+        guac_flag_clear(&data->state, GUAC_SOCKET_ASYNC_BATCH_READY);
+
+    if (data->length < data->capacity)
+        guac_flag_set(&data->state, GUAC_SOCKET_ASYNC_NOT_FULL);
+    else
+        guac_flag_clear(&data->state, GUAC_SOCKET_ASYNC_NOT_FULL);
+
+    if (data->length > data->stats.peak_queued)
+        data->stats.peak_queued = data->length;
+
+}
+
+/**
+ * Sink write handler which writes the entirety of the given buffer to the
+ * file descriptor of the sink, retrying partial writes.
+ *
+ * @param data
+ *     The guac_socket_async_fd_sink describing the file descriptor.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise.
+ */
+static int guac_socket_async_fd_write(void* data, const char* buffer,
+        size_t length) {
+
+    guac_socket_async_fd_sink* fd_sink = (guac_socket_async_fd_sink*) data;
+
+    while (length > 0) {
+
+        /* Retry writes interrupted by signals */
+        ssize_t written = write(fd_sink->fd, buffer, length);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return 1;
+        }
+
+        buffer += written;
+        length -= written;
+
+    }
+
+#if defined(HAVE_FDATASYNC)
+    if (fd_sink->sync)
+        return fdatasync(fd_sink->fd);
+#elif defined(HAVE_FSYNC)
+    if (fd_sink->sync)
+        return fsync(fd_sink->fd);
+#endif
+
+    return 0;
+
+}
+
+/**
+ * Sink close handler which closes the file descriptor of the sink.
+ *
+ * @param data
+ *     The guac_socket_async_fd_sink describing the file descriptor.
+ */
+static void guac_socket_async_fd_close(void* data) {
+
+    guac_socket_async_fd_sink* fd_sink = (guac_socket_async_fd_sink*) data;
+
+    close(fd_sink->fd);
+    guac_mem_free(fd_sink);
+
+}
+
+/**
+ * Thread which writes all complete instructions queued within an
+ * asynchronous socket to its sink, waiting briefly for data to accumulate
+ * such that data is written in as few batches as possible.
+ *
+ * @param arg
+ *     A pointer to the guac_socket_async_data of the socket.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_socket_async_writer_thread(void* arg) {
+
+    guac_socket_async_data* data = (guac_socket_async_data*) arg;
+
+    for (;;) {
+
+        guac_flag_wait_and_lock(&data->state,
+                GUAC_SOCKET_ASYNC_NONEMPTY | GUAC_SOCKET_ASYNC_STOPPING);
+
+        /* Allow small amounts of data to accumulate before writing */
+        if (!(data->state.value & (GUAC_SOCKET_ASYNC_BATCH_READY | GUAC_SOCKET_ASYNC_STOPPING))) {
+            guac_flag_unlock(&data->state);
+            if (!guac_flag_timedwait_and_lock(&data->state,
+                        GUAC_SOCKET_ASYNC_BATCH_READY | GUAC_SOCKET_ASYNC_STOPPING,
+                        GUAC_SOCKET_ASYNC_MAX_DELAY))
+                guac_flag_lock(&data->state);
+        }
+
+        /* Stop only after all remaining data has been written */
+        if (data->committed == 0) {
+            int stopping = data->state.value & GUAC_SOCKET_ASYNC_STOPPING;
+            guac_flag_unlock(&data->state);
+            if (stopping)
+                break;
+            continue;
+        }
+
+        /* Write as much contiguous data as possible at once. The writer
+         * thread is the only consumer of the queue, and producers write only
+         * beyond the committed data, thus the data can be written without
+         * holding the lock. */
+        size_t length = data->committed;
+        if (length > data->capacity - data->head)
+            length = data->capacity - data->head;
+
+        /* Never write past a pending mark, invoking the mark handler first if
+         * the mark has been reached */
+        int mark = 0;
+        if (data->mark_pending) {
+            uint64_t until_mark = data->mark_position - data->position;
+            if (until_mark == 0) {
+                data->mark_pending = 0;
+                mark = 1;
+            }
+            else if (length > until_mark)
+                length = until_mark;
+        }
+
+        const char* chunk = data->buffer + data->head;
+        int failed = data->failed;
+        guac_flag_unlock(&data->state);
+
+        if (!failed && mark && data->sink.mark_handler != NULL)
+            failed = data->sink.mark_handler(data->sink.data);
+
+        if (!failed)
+            failed = data->sink.write_handler(data->sink.data, chunk, length);
+
+        guac_flag_lock(&data->state);
+
+        data->head = (data->head + length) % data->capacity;
+        data->position += length;
+        data->length -= length;
+        data->committed -= length;
+        data->stats.writes++;
+
+        /* Drop all further data if the sink can no longer be written */
+        if (failed) {
+            data->failed = 1;
+            data->stats.bytes_dropped += length;
+        }
+        else
+            data->stats.bytes_written += length;
+
+        guac_socket_async_update_state(data);
+        guac_flag_unlock(&data->state);
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Socket write handler which copies the given data into the queue of the
+ * asynchronous socket, applying the overflow behavior of the socket if the
+ * queue is full.
+ *
+ * @param socket
+ *     The asynchronous socket being written to.
+ *
+ * @param buf
+ *     The data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @return
+ *     The number of bytes written. This handler always succeeds, as any data
+ *     which cannot be queued is dropped according to the overflow behavior
+ *     of the socket, and thus always returns count.
+ */
+static ssize_t guac_socket_async_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_async_data* data = (guac_socket_async_data*) socket->data;
+    const char* buffer = (const char*) buf;
+    size_t remaining = count;
+    int delayed = 0;
+
+    guac_flag_lock(&data->state);
+
+    while (remaining > 0) {
+
+        /* Data is dropped once the file has failed, or for the remainder of
+         * any instruction that did not fit within the queue */
+        if (data->failed || data->dropping) {
+            data->stats.bytes_dropped += remaining;
+            break;
+        }
+
+        size_t available = data->capacity - data->length;
+        if (available == 0) {
+
+            /* Discard the incomplete instruction and the rest of that
+             * instruction, such that only complete instructions are
+             * written */
+            if (data->overflow == GUAC_SOCKET_ASYNC_OVERFLOW_DROP) {
+                data->stats.bytes_dropped += data->length - data->committed + remaining;
+                data->length = data->committed;
+                data->dropping = data->in_instruction;
+                break;
+            }
+
+            /* Otherwise, wait for room, allowing any partial instruction to
+             * be written to make that room */
+            if (!delayed) {
+                data->stats.bytes_delayed += remaining;
+                delayed = 1;
+            }
+
+            data->committed = data->length;
+            guac_socket_async_update_state(data);
+            guac_flag_unlock(&data->state);
+
+            guac_flag_wait_and_lock(&data->state, GUAC_SOCKET_ASYNC_NOT_FULL);
+            continue;
+
+        }
+
+        /* Copy as much as possible, up to the end of the ring buffer */
+        size_t tail = (data->head + data->length) % data->capacity;
+        size_t length = remaining;
+        if (length > available)
+            length = available;
+        if (length > data->capacity - tail)
+            length = data->capacity - tail;
+
+        memcpy(data->buffer + tail, buffer, length);
+        data->length += length;
+        buffer += length;
+        remaining -= length;
+
+    }
+
+    /* Data written outside of any instruction is complete as-is */
+    if (!data->in_instruction)
+        data->committed = data->length;
+
+    guac_socket_async_update_state(data);
+    guac_flag_unlock(&data->state);
+
+    return count;
+
+}
+
+/**
+ * Socket flush handler which does nothing, as queued data is written
+ * automatically by the writer thread once enough data has accumulated or
+ * GUAC_SOCKET_ASYNC_MAX_DELAY milliseconds have elapsed. Waiting for data to
+ * be written here would defeat the purpose of the asynchronous socket.
+ *
+ * @param socket
+ *     The asynchronous socket to flush.
+ *
+ * @return
+ *     Always zero.
+ */
+static ssize_t guac_socket_async_flush_handler(guac_socket* socket) {
+    return 0;
+}
+
+/**
+ * Socket lock handler which acquires exclusive access to the asynchronous
+ * socket in preparation for the beginning of a new Guacamole instruction.
+ *
+ * @param socket
+ *     The asynchronous socket to lock.
+ */
+static void guac_socket_async_lock_handler(guac_socket* socket) {
+
+    guac_socket_async_data* data = (guac_socket_async_data*) socket->data;
+
+    /* Acquire exclusive access to socket */
+    pthread_mutex_lock(&(data->socket_lock));
+
+    guac_flag_lock(&data->state);
+    data->in_instruction = 1;
+    guac_flag_unlock(&data->state);
+
+}
+
+/**
+ * Socket unlock handler which marks the instruction just written as complete,
+ * allowing it to be written by the writer thread, and releases exclusive
+ * access to the asynchronous socket.
+ *
+ * @param socket
+ *     The asynchronous socket to unlock.
+ */
+static void guac_socket_async_unlock_handler(guac_socket* socket) {
+
+    guac_socket_async_data* data = (guac_socket_async_data*) socket->data;
+
+    guac_flag_lock(&data->state);
+    data->committed = data->length;
+    data->in_instruction = 0;
+    data->dropping = 0;
+    guac_socket_async_update_state(data);
+    guac_flag_unlock(&data->state);
+
+    /* Relinquish exclusive access to socket */
+    pthread_mutex_unlock(&(data->socket_lock));
+
+}
+
+/**
+ * Frees all implementation-specific data associated with the given socket,
+ * first waiting for all queued data to be written and closing the sink.
+ *
+ * @param socket
+ *     The asynchronous socket whose associated data should be freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_socket_async_free_handler(guac_socket* socket) {
+
+    guac_socket_async_data* data = (guac_socket_async_data*) socket->data;
+
+    /* Write all remaining data, complete or not, then stop */
+    guac_flag_lock(&data->state);
+    data->committed = data->length;
+    guac_socket_async_update_state(data);
+    guac_flag_set(&data->state, GUAC_SOCKET_ASYNC_STOPPING);
+    guac_flag_unlock(&data->state);
+
+    pthread_join(data->writer, NULL);
+
+    data->sink.close_handler(data->sink.data);
+
+    pthread_mutex_destroy(&(data->socket_lock));
+    guac_flag_destroy(&data->state);
+
+    guac_mem_free(data->buffer);
+    guac_mem_free(data);
+    return 0;
+
+}
+
+guac_socket* guac_socket_async_open_sink(const guac_socket_async_sink* sink,
+        size_t capacity, guac_socket_async_overflow overflow) {
+
+    guac_socket_async_data* data = guac_mem_zalloc(sizeof(guac_socket_async_data));
+    data->sink = *sink;
+    data->overflow = overflow;
+    data->capacity = capacity > 0 ? capacity : 1;
+    data->buffer = guac_mem_alloc(data->capacity);
+
+    /* Write immediately once the queue is half full, even if that is less
+     * than GUAC_SOCKET_ASYNC_WRITE_SIZE, such that writers are not blocked
+     * waiting for a small queue to be written */
+    data->batch_size = data->capacity / 2;
+    if (data->batch_size > GUAC_SOCKET_ASYNC_WRITE_SIZE)
+        data->batch_size = GUAC_SOCKET_ASYNC_WRITE_SIZE;
+    if (data->batch_size < 1)
+        data->batch_size = 1;
+
+    pthread_mutex_init(&(data->socket_lock), NULL);
+    guac_flag_init(&data->state);
+    guac_flag_set(&data->state, GUAC_SOCKET_ASYNC_NOT_FULL);
+
+    /* Without a writer thread, queued data would never be written */
+    if (pthread_create(&data->writer, NULL, guac_socket_async_writer_thread, data)) {
+        pthread_mutex_destroy(&(data->socket_lock));
+        guac_flag_destroy(&data->state);
+        guac_mem_free(data->buffer);
+        guac_mem_free(data);
+        return NULL;
+    }
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = data;
+
+    socket->write_handler  = guac_socket_async_write_handler;
+    socket->flush_handler  = guac_socket_async_flush_handler;
+    socket->lock_handler   = guac_socket_async_lock_handler;
+    socket->unlock_handler = guac_socket_async_unlock_handler;
+    socket->free_handler   = guac_socket_async_free_handler;
+
+    return socket;
+
+}
+
+guac_socket* guac_socket_async_open(int fd, size_t capacity,
+        guac_socket_async_overflow overflow, int sync) {
+
+    guac_socket_async_fd_sink* fd_sink = guac_mem_alloc(sizeof(guac_socket_async_fd_sink));
+    fd_sink->fd = fd;
+    fd_sink->sync = sync;
+
+    guac_socket_async_sink sink = {
+        .write_handler = guac_socket_async_fd_write,
+        .close_handler = guac_socket_async_fd_close,
+        .data = fd_sink
+    };
+
+    guac_socket* socket = guac_socket_async_open_sink(&sink, capacity, overflow);
+    if (socket == NULL)
+        guac_mem_free(fd_sink);
+
+    return socket;
+
+}
+
+void guac_socket_async_mark(guac_socket* socket) {
+
+    guac_socket_async_data* data = (guac_socket_async_data*) socket->data;
+
+    guac_flag_lock(&data->state);
+
+    if (!data->mark_pending) {
+        data->mark_pending = 1;
+        data->mark_position = data->position + data->committed;
+    }
+
+    guac_flag_unlock(&data->state);
+
+}
+
+void guac_socket_async_get_stats(guac_socket* socket,
+        guac_socket_async_stats* stats) {
+
+    guac_socket_async_data* data = (guac_socket_async_data*) socket->data;
+
+    guac_flag_lock(&data->state);
+    *stats = data->stats;
+    guac_flag_unlock(&data->state);
+
+}
+
@@ -0,0 +1,293 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_SOCKET_ASYNC_H
+#define GUAC_SOCKET_ASYNC_H
+
+#include "guacamole/socket-types.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The default number of bytes that may be queued within an asynchronous
+ * socket before the overflow behavior of that socket takes effect.
+ */
+#define GUAC_SOCKET_ASYNC_DEFAULT_CAPACITY 8388608
+
+/**
+ * The number of queued bytes at which the writer thread of an asynchronous
+ * socket will immediately write queued data, rather than waiting up to
+ * GUAC_SOCKET_ASYNC_MAX_DELAY milliseconds for more data to accumulate.
+ */
+#define GUAC_SOCKET_ASYNC_WRITE_SIZE 262144
+
+/**
+ * The maximum number of milliseconds that data may remain queued within an
+ * asynchronous socket before being written, if less than
+ * GUAC_SOCKET_ASYNC_WRITE_SIZE bytes are queued.
+ */
+#define GUAC_SOCKET_ASYNC_MAX_DELAY 250
+
+/**
+ * The value of the state flag of an asynchronous socket when complete
+ * instructions are waiting to be written.
+ */
+#define GUAC_SOCKET_ASYNC_NONEMPTY 1
+
+/**
+ * The value of the state flag of an asynchronous socket when enough data is
+ * waiting that it should be written immediately (GUAC_SOCKET_ASYNC_WRITE_SIZE
+ * bytes or half the queue, whichever is smaller).
+ */
+#define GUAC_SOCKET_ASYNC_BATCH_READY 2
+
+/**
+ * The value of the state flag of an asynchronous socket when space is
+ * available within its queue.
+ */
+#define GUAC_SOCKET_ASYNC_NOT_FULL 4
+
+/**
+ * The value of the state flag of an asynchronous socket when its writer
+ * thread must write all remaining data and stop.
+ */
+#define GUAC_SOCKET_ASYNC_STOPPING 8
+
+/**
+ * The behavior of an asynchronous socket when data is written while its queue
+ * is full.
+ */
+typedef enum guac_socket_async_overflow {
+
+    /**
+     * Block the thread writing to the socket until the writer thread has
+     * made room within the queue. No data is lost, but the latency of the
+     * writing thread will reflect the speed of the sink.
+     */
+    GUAC_SOCKET_ASYNC_OVERFLOW_BLOCK,
+
+    /**
+     * Drop the instruction being written in its entirety. The thread writing
+     * to the socket is never delayed, but the resulting file will be missing
+     * any instructions dropped.
+     */
+    GUAC_SOCKET_ASYNC_OVERFLOW_DROP
+
+} guac_socket_async_overflow;
+
+/**
+ * Running totals describing the data written to an asynchronous socket.
+ */
+typedef struct guac_socket_async_stats {
+
+    /**
+     * The total number of bytes written to the sink.
+     */
+    uint64_t bytes_written;
+
+    /**
+     * The total number of bytes whose writes were delayed because the queue
+     * was full.
+     */
+    uint64_t bytes_delayed;
+
+    /**
+     * The total number of bytes dropped, either because the queue was full
+     * or because writing to the sink failed.
+     */
+    uint64_t bytes_dropped;
+
+    /**
+     * The total number of batches written to the sink.
+     */
+    uint64_t writes;
+
+    /**
+     * The largest number of bytes that have been queued at any one time.
+     */
+    size_t peak_queued;
+
+} guac_socket_async_stats;
+
+/**
+ * Handler which writes a batch of complete instructions dequeued by the
+ * writer thread of an asynchronous socket. This handler is only ever invoked
+ * by the writer thread.
+ *
+ * @param data
+ *     The arbitrary data associated with the sink.
+ *
+ * @param buffer
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise.
+ */
+typedef int guac_socket_async_sink_write_handler(void* data,
+        const char* buffer, size_t length);
+
+/**
+ * Handler which is invoked by the writer thread of an asynchronous socket
+ * upon reaching a position marked with guac_socket_async_mark(), before any
+ * data following that position is written.
+ *
+ * @param data
+ *     The arbitrary data associated with the sink.
+ *
+ * @return
+ *     Zero on success, non-zero if the sink can no longer be written.
+ */
+typedef int guac_socket_async_sink_mark_handler(void* data);
+
+/**
+ * Handler which is invoked once all queued data has been written and the
+ * asynchronous socket is being freed. This handler must release all
+ * resources associated with the sink.
+ *
+ * @param data
+ *     The arbitrary data associated with the sink.
+ */
+typedef void guac_socket_async_sink_close_handler(void* data);
+
+/**
+ * The destination of all data written to an asynchronous socket.
+ */
+typedef struct guac_socket_async_sink {
+
+    /**
+     * Handler which writes each batch of queued data.
+     */
+    guac_socket_async_sink_write_handler* write_handler;
+
+    /**
+     * Handler which is invoked at each position marked with
+     * guac_socket_async_mark(), or NULL if marks should be ignored.
+     */
+    guac_socket_async_sink_mark_handler* mark_handler;
+
+    /**
+     * Handler which releases all resources associated with the sink.
+     */
+    guac_socket_async_sink_close_handler* close_handler;
+
+    /**
+     * Arbitrary data which is passed to each handler.
+     */
+    void* data;
+
+} guac_socket_async_sink;
+
+/**
+ * Creates a new write-only guac_socket which writes to the given sink from a
+ * dedicated thread. Data written to the returned socket is copied into a
+ * bounded queue and passed to the sink in large batches of complete
+ * instructions, such that threads writing to the socket are not delayed by
+ * the sink. Queued data is written once enough data has accumulated, or once
+ * GUAC_SOCKET_ASYNC_MAX_DELAY milliseconds have elapsed. Flushing the
+ * returned socket does not wait for queued data to be written.
+ *
+ * When the returned socket is freed, all queued data is written, the sink is
+ * closed, and the writer thread is stopped.
+ *
+ * @param sink
+ *     The sink to write to. The contents of this structure are copied.
+ *
+ * @param capacity
+ *     The maximum number of bytes that may be queued.
+ *
+ * @param overflow
+ *     The behavior of the socket when data is written while the queue is
+ *     full.
+ *
+ * @return
+ *     A newly-allocated guac_socket which writes to the given sink
+ *     asynchronously, or NULL if the writer thread could not be started. If
+ *     NULL is returned, the sink is not closed.
+ */
+guac_socket* guac_socket_async_open_sink(const guac_socket_async_sink* sink,
+        size_t capacity, guac_socket_async_overflow overflow);
+
+/**
+ * Creates a new write-only guac_socket which writes to the given file
+ * descriptor from a dedicated thread. Data written to the returned socket is
+ * copied into a bounded queue and written to the file descriptor in large
+ * batches, such that threads writing to the socket are not delayed by the
+ * underlying file. Queued data is written once enough data has accumulated, or
+ * once GUAC_SOCKET_ASYNC_MAX_DELAY milliseconds have elapsed. Flushing the
+ * returned socket does not wait for queued data to be written.
+ *
+ * When the returned socket is freed, all queued data is written, the file
+ * descriptor is closed, and the writer thread is stopped.
+ *
+ * @param fd
+ *     The file descriptor to write to.
+ *
+ * @param capacity
+ *     The maximum number of bytes that may be queued.
+ *
+ * @param overflow
+ *     The behavior of the socket when data is written while the queue is
+ *     full.
+ *
+ * @param sync
+ *     Non-zero if fdatasync() should be invoked after each batch of data is
+ *     written, such that data reaches stable storage as soon as it is
+ *     written, zero otherwise.
+ *
+ * @return
+ *     A newly-allocated guac_socket which writes to the given file
+ *     descriptor asynchronously, or NULL if the writer thread could not be
+ *     started. If NULL is returned, the file descriptor is not closed.
+ */
+guac_socket* guac_socket_async_open(int fd, size_t capacity,
+        guac_socket_async_overflow overflow, int sync);
+
+/**
+ * Marks the current end of the complete instructions queued within the given
+ * asynchronous socket. The mark handler of the socket's sink will be invoked
+ * once all data preceding the mark has been written, before any data
+ * following the mark. Only one mark may be pending at a time; if a mark is
+ * already pending, this function has no effect.
+ *
+ * @param socket
+ *     The asynchronous socket to mark, as returned by guac_socket_async_open()
+ *     or guac_socket_async_open_sink().
+ */
+void guac_socket_async_mark(guac_socket* socket);
+
+/**
+ * Retrieves the current running totals describing the data written to the
+ * given asynchronous socket.
+ *
+ * @param socket
+ *     The asynchronous socket to retrieve statistics from, as returned by
+ *     guac_socket_async_open() or guac_socket_async_open_sink().
+ *
+ * @param stats
+ *     The structure to populate with the current statistics.
+ */
+void guac_socket_async_get_stats(guac_socket* socket,
+        guac_socket_async_stats* stats);
+
+#endif
+
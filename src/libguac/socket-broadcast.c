@@ -22,11 +22,16 @@
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
 #include "guacamole/error.h"
+#include "guacamole/flag.h"
 #include "guacamole/socket.h"
+#include "guacamole/timestamp.h"
 #include "guacamole/user.h"
+#include "socket-broadcast.h"
 
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * A function that will broadcast arbitrary data to a subset of users for
@@ -68,24 +73,35 @@ typedef struct guac_socket_broadcast_data {
      */
     guac_socket_broadcast_handler* broadcast_handler;
 
-} guac_socket_broadcast_data;
-
-/**
- * Single chunk of data, to be broadcast to all users.
- */
-typedef struct __write_chunk {
+    /**
+     * Lock which guards access to the buffer of data not yet handed off to
+     * the queues of the relevant users.
+     */
+    pthread_mutex_t buffer_lock;
 
     /**
-     * The buffer to write.
+     * All data written to this socket which has not yet been handed off to
+     * the queues of the relevant users.
      */
-    const void* buffer;
+    char* buffer;
 
     /**
-     * The number of bytes in the buffer.
+     * The number of bytes currently within the buffer.
      */
     size_t length;
 
-} __write_chunk;
+    /**
+     * The number of bytes at the beginning of the buffer which make up
+     * complete instructions, and thus may be handed off to user queues.
+     */
+    size_t committed;
+
+    /**
+     * The number of bytes allocated for the buffer.
+     */
+    size_t capacity;
+
+} guac_socket_broadcast_data;
 
 /**
  * Callback which handles read requests on the broadcast socket. This callback
@@ -114,190 +130,636 @@ static ssize_t __guac_socket_broadcast_read_handler(guac_socket* socket,
 }
 
 /**
- * Callback invoked by the broadcast handler which write a given chunk of
- * data to that user's socket. If the write attempt fails, the user is
- * signalled to stop with guac_user_stop().
+ * Releases a single reference to the given chunk, freeing the chunk if no
+ * references remain.
+ *
+ * @param chunk
+ *     The chunk to release.
+ */
+static void guac_socket_broadcast_chunk_release(
+        guac_socket_broadcast_chunk* chunk) {
+
+    pthread_mutex_lock(&(chunk->lock));
+    int ref_count = --chunk->ref_count;
+    pthread_mutex_unlock(&(chunk->lock));
+
+    if (ref_count == 0) {
+        pthread_mutex_destroy(&(chunk->lock));
+        guac_mem_free(chunk);
+    }
+
+}
+
+/**
+ * A single recipient of a broadcast chunk which must be revisited once the
+ * locks guarding the broadcast socket and the user list have been released.
+ */
+typedef struct guac_socket_broadcast_recipient {
+
+    /**
+     * The queue of the recipient. A reference to this queue is held until
+     * the recipient has been handled.
+     */
+    guac_socket_broadcast_queue* queue;
+
+    /**
+     * Non-zero if the chunk must be written directly to the user's socket,
+     * zero if the chunk has already been queued and the broadcast must only
+     * wait for the user to catch up.
+     */
+    int direct;
+
+} guac_socket_broadcast_recipient;
+
+/**
+ * The details of a single chunk being handed off to the queues of all
+ * relevant users.
+ */
+typedef struct guac_socket_broadcast_delivery {
+
+    /**
+     * The chunk being handed off.
+     */
+    guac_socket_broadcast_chunk* chunk;
+
+    /**
+     * The number of users receiving the chunk.
+     */
+    int users;
+
+    /**
+     * Non-zero if the broadcast socket is being flushed, in which case the
+     * chunk must be flushed to each user once written.
+     */
+    int flush;
+
+    /**
+     * All recipients that must be revisited once locks have been released,
+     * or NULL if there are no such recipients.
+     */
+    guac_socket_broadcast_recipient* recipients;
+
+    /**
+     * The number of entries within the recipients array.
+     */
+    int length;
+
+    /**
+     * The number of entries allocated for the recipients array.
+     */
+    int capacity;
+
+} guac_socket_broadcast_delivery;
+
+/**
+ * Callback invoked by the broadcast handler which counts the users that will
+ * receive the next chunk.
  *
  * @param user
- *     The user that the chunk of data should be written to.
+ *     The user being counted.
  *
  * @param data
- *     A pointer to a __write_chunk which describes the data to be written.
+ *     A pointer to the int containing the current number of users.
  *
  * @return
  *     Always NULL.
  */
-static void* __write_chunk_callback(guac_user* user, void* data) {
+static void* __count_user_callback(guac_user* user, void* data) {
 
-    __write_chunk* chunk = (__write_chunk*) data;
-
-    /* Attempt write, disconnect on failure */
-    if (guac_socket_write(user->socket, chunk->buffer, chunk->length))
-        guac_user_stop(user);
+    int* users = (int*) data;
+    (*users)++;
 
     return NULL;
 
 }
 
 /**
- * Socket write handler which operates on each of the sockets of all connected
- * users. This write handler will always succeed, but any failing user-specific
- * writes will invoke guac_user_stop() on the failing user.
- *
- * @param socket
- *     The socket to which the given data must be written.
+ * Drops all chunks currently within the given queue. The state flag of the
+ * queue must already be locked.
  *
- * @param buf
- *     The buffer containing the data to write.
+ * @param queue
+ *     The queue to drop all chunks from.
+ */
+static void guac_socket_broadcast_queue_drop(
+        guac_socket_broadcast_queue* queue) {
+
+    while (queue->length > 0) {
+        guac_socket_broadcast_chunk_release(queue->chunks[queue->head]);
+        queue->head = (queue->head + 1) % GUAC_SOCKET_BROADCAST_QUEUE_CAPACITY;
+        queue->length--;
+    }
+
+    queue->backlog = 0;
+    guac_flag_clear(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_NONEMPTY);
+    guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_READY);
+
+}
+
+/**
+ * Drops all chunks currently within the given queue and marks the user for
+ * resynchronization, logging that the user has fallen too far behind. The
+ * state flag of the queue must already be locked, and is unlocked by this
+ * function.
  *
- * @param count
- *     The number of bytes to attempt to write from the given buffer.
+ * @param queue
+ *     The queue of the user that has fallen too far behind.
+ */
+static void guac_socket_broadcast_queue_overflow(
+        guac_socket_broadcast_queue* queue) {
+
+    size_t backlog = queue->backlog;
+    unsigned int length = queue->length;
+
+    guac_socket_broadcast_queue_drop(queue);
+    queue->resync = 1;
+    queue->resyncs++;
+    guac_flag_unlock(&queue->state);
+
+    guac_user_log(queue->user, GUAC_LOG_WARNING, "User has fallen too far "
+            "behind (%zu bytes in %u chunks pending). Pending data has been "
+            "dropped, and the user will be resynchronized.", backlog, length);
+
+}
+
+/**
+ * Marks the given queue as failed, such that all further chunks are dropped,
+ * and wakes any threads waiting for the queue. The state flag of the queue
+ * must NOT already be locked.
  *
- * @return
- *     The number of bytes written, or -1 if an error occurs. This handler will
- *     always succeed, and thus will always return the exact number of bytes
- *     specified by count.
+ * @param queue
+ *     The queue to mark as failed.
  */
-static ssize_t __guac_socket_broadcast_write_handler(guac_socket* socket,
-        const void* buf, size_t count) {
+static void guac_socket_broadcast_queue_fail(
+        guac_socket_broadcast_queue* queue) {
 
-    guac_socket_broadcast_data* data =
-        (guac_socket_broadcast_data*) socket->data;
+    guac_flag_lock(&queue->state);
+    queue->failed = 1;
+    guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_READY
+            | GUAC_SOCKET_BROADCAST_QUEUE_IDLE);
+    guac_flag_unlock(&queue->state);
 
-    /* Build chunk */
-    __write_chunk chunk;
-    chunk.buffer = buf;
-    chunk.length = count;
+}
 
-    /* Broadcast chunk to the users */
-    data->broadcast_handler(data->client, __write_chunk_callback, &chunk);
+/**
+ * Releases a reference to the given queue that was acquired while queuing a
+ * chunk for its user, allowing the queue to be freed once no references
+ * remain. The state flag of the queue must NOT already be locked.
+ *
+ * @param queue
+ *     The queue to release.
+ */
+static void guac_socket_broadcast_queue_release(
+        guac_socket_broadcast_queue* queue) {
 
-    return count;
+    guac_flag_lock(&queue->state);
+
+    if (--queue->refs == 0)
+        guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_UNREFERENCED);
+
+    guac_flag_unlock(&queue->state);
 
 }
 
 /**
- * Callback which is invoked by the broadcast handler to flush all
- * pending data on the given user's socket. If an error occurs while flushing
- * a user's socket, that user is signalled to stop with guac_user_stop().
+ * Records the given queue as a recipient that must be revisited once all
+ * locks have been released, acquiring a reference to that queue. The state
+ * flag of the queue must already be locked.
  *
- * @param user
- *     The user whose socket should be flushed.
+ * @param delivery
+ *     The delivery that the recipient should be added to.
  *
- * @param data
- *     Arbitrary data passed to the broadcast handler. This is not needed
- *     by this callback, and should be left as NULL.
+ * @param queue
+ *     The queue of the recipient.
  *
- * @return
- *     Always NULL.
+ * @param direct
+ *     Non-zero if the chunk must be written directly to the user's socket,
+ *     zero if the broadcast must only wait for the user.
  */
-static void* __flush_callback(guac_user* user, void* data) {
+static void guac_socket_broadcast_delivery_add(
+        guac_socket_broadcast_delivery* delivery,
+        guac_socket_broadcast_queue* queue, int direct) {
 
-    /* Attempt flush, disconnect on failure */
-    if (guac_socket_flush(user->socket))
-        guac_user_stop(user);
+    if (delivery->length == delivery->capacity) {
+        delivery->capacity = delivery->capacity ? delivery->capacity * 2 : 4;
+        delivery->recipients = guac_mem_realloc_or_die(delivery->recipients,
+                sizeof(guac_socket_broadcast_recipient), delivery->capacity);
+    }
 
-    return NULL;
+    guac_socket_broadcast_recipient* recipient =
+        &delivery->recipients[delivery->length++];
+
+    recipient->queue = queue;
+    recipient->direct = direct;
+
+    queue->refs++;
+    guac_flag_clear(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_UNREFERENCED);
 
 }
 
 /**
- * Socket flush handler which operates on each of the sockets of all connected
- * users. This flush handler will always succeed, but any failing user-specific
- * flush will invoke guac_user_stop() on the failing user.
+ * Writes the given chunk directly to the socket of the given user from the
+ * current thread, bypassing the user's writer thread. This is only possible
+ * if the user's queue was idle when the chunk was broadcast, and is used when
+ * the user is the only recipient of a broadcast, such that the broadcasting
+ * thread is subject to the same backpressure as if the user's socket were
+ * written directly. Any chunks queued while the chunk is being written are
+ * handed to the writer thread only once the write is complete.
  *
- * @param socket
- *     The broadcast socket to flush.
+ * @param queue
+ *     The queue of the user receiving the chunk.
  *
- * @return
- *     Zero if the flush operation succeeds, non-zero if the operation fails.
- *     This handler will always succeed, and thus will always return zero.
+ * @param chunk
+ *     The chunk to write.
+ *
+ * @param flush
+ *     Non-zero if the user's socket should be flushed after the chunk has
+ *     been written, zero otherwise.
  */
-static ssize_t __guac_socket_broadcast_flush_handler(guac_socket* socket) {
+static void guac_socket_broadcast_write_direct(
+        guac_socket_broadcast_queue* queue,
+        guac_socket_broadcast_chunk* chunk, int flush) {
 
-    guac_socket_broadcast_data* data =
-        (guac_socket_broadcast_data*) socket->data;
+    guac_user* user = queue->user;
 
-    /* Flush the users */
-    data->broadcast_handler(data->client, __flush_callback, NULL);
+    guac_socket_instruction_begin(user->socket);
+    int failed = guac_socket_write(user->socket, chunk->data, chunk->length);
+    guac_socket_instruction_end(user->socket);
 
-    return 0;
+    if (!failed && flush)
+        failed = guac_socket_flush(user->socket);
+
+    guac_flag_lock(&queue->state);
+    queue->direct = 0;
+
+    if (!failed) {
+        queue->chunks_written++;
+        queue->bytes_written += chunk->length;
+    }
+
+    /* Hand off anything queued meanwhile to the writer thread */
+    if (queue->length > 0)
+        guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_NONEMPTY);
+    else
+        guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_IDLE);
+
+    guac_flag_unlock(&queue->state);
+
+    if (failed) {
+        guac_socket_broadcast_queue_fail(queue);
+        guac_user_stop(user);
+    }
 
 }
 
 /**
- * Callback which is invoked by the broadcast handler to lock the given
- * user's socket in preparation for the beginning of a Guacamole protocol
- * instruction.
+ * Callback invoked by the broadcast handler which adds a given chunk of data
+ * to that user's broadcast queue. This callback never blocks. If the user is
+ * the only recipient and nothing remains to be written by the user's writer
+ * thread, the user is instead recorded as needing the chunk written
+ * directly. If the user has fallen behind, or is the only recipient of a
+ * chunk being flushed, the user is recorded as needing to be waited for.
+ * Writing and waiting are performed by guac_socket_broadcast_complete() once
+ * the lock on the user list and the buffer of the broadcast socket have been
+ * released.
  *
  * @param user
- *     The user whose socket should be locked.
+ *     The user that the chunk of data should be queued for.
  *
  * @param data
- *     Arbitrary data passed to the broadcast handler. This is not needed
- *     by this callback, and should be left as NULL.
+ *     A pointer to the guac_socket_broadcast_delivery describing the chunk to
+ *     be queued.
  *
  * @return
  *     Always NULL.
  */
-static void* __lock_callback(guac_user* user, void* data) {
-
-    /* Lock socket */
-    guac_socket_instruction_begin(user->socket);
+static void* __enqueue_chunk_callback(guac_user* user, void* data) {
+
+    guac_socket_broadcast_delivery* delivery =
+        (guac_socket_broadcast_delivery*) data;
+
+    guac_socket_broadcast_chunk* chunk = delivery->chunk;
+    guac_socket_broadcast_queue* queue = user->__broadcast_queue;
+
+    /* Users that have not joined through guac_client_add_user() cannot
+     * receive broadcast data */
+    if (queue == NULL)
+        return NULL;
+
+    int sole_user = (delivery->users == 1);
+
+    guac_flag_lock(&queue->state);
+
+    /* Data for users that have failed, that are leaving, or that are
+     * awaiting resync is dropped */
+    if (queue->failed || queue->resync
+            || (queue->state.value & GUAC_SOCKET_BROADCAST_QUEUE_STOPPING)) {
+        guac_flag_unlock(&queue->state);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&(chunk->lock));
+    chunk->ref_count++;
+    pthread_mutex_unlock(&(chunk->lock));
+
+    /* The only recipient of a broadcast receives data directly if nothing
+     * remains to be written by the user's writer thread */
+    if (sole_user && !queue->direct
+            && (queue->state.value & GUAC_SOCKET_BROADCAST_QUEUE_IDLE)) {
+        queue->direct = 1;
+        guac_flag_clear(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_IDLE);
+        guac_socket_broadcast_delivery_add(delivery, queue, 1);
+        guac_flag_unlock(&queue->state);
+        return NULL;
+    }
+
+    /* Resynchronize immediately if not even the headroom for concurrent
+     * broadcasts remains */
+    if (queue->length == GUAC_SOCKET_BROADCAST_QUEUE_CAPACITY) {
+        guac_socket_broadcast_chunk_release(chunk);
+        guac_socket_broadcast_queue_overflow(queue);
+        return NULL;
+    }
+
+    /* Add chunk to the tail of the queue */
+    unsigned int tail = (queue->head + queue->length)
+        % GUAC_SOCKET_BROADCAST_QUEUE_CAPACITY;
+
+    queue->chunks[tail] = chunk;
+    queue->length++;
+
+    queue->backlog += chunk->length;
+    if (queue->backlog > queue->peak_backlog)
+        queue->peak_backlog = queue->backlog;
+
+    if (queue->length >= GUAC_SOCKET_BROADCAST_QUEUE_SIZE
+            || queue->backlog >= GUAC_SOCKET_BROADCAST_MAX_BACKLOG)
+        guac_flag_clear(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_READY);
+
+    guac_flag_clear(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_IDLE);
+
+    /* Chunks queued while a chunk is being written directly must wait for
+     * that write to complete */
+    if (!queue->direct)
+        guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_NONEMPTY);
+
+    /* Wait for the user once all locks are released if the user has fallen
+     * behind, or if a flush must block until the sole recipient has received
+     * everything (just as flushing that recipient's socket would) */
+    if (!(queue->state.value & GUAC_SOCKET_BROADCAST_QUEUE_READY)
+            || (sole_user && delivery->flush))
+        guac_socket_broadcast_delivery_add(delivery, queue, 0);
+
+    guac_flag_unlock(&queue->state);
 
     return NULL;
 
 }
 
 /**
- * Socket lock handler which acquires the socket locks of all connected users.
- * Socket-level locks are acquired in preparation for the beginning of a new
- * Guacamole instruction to ensure that parallel writes are only interleaved at
- * instruction boundaries.
+ * Hands off all complete instructions within the buffer of the given
+ * broadcast socket to the queues of all relevant users. The buffer lock of the
+ * broadcast socket must already be held. This function never blocks on any
+ * user. Any users that must be written to directly or waited for are recorded
+ * within the given delivery, which must be passed to
+ * guac_socket_broadcast_complete() after the buffer lock has been released.
+ *
+ * @param data
+ *     The data associated with the broadcast socket.
+ *
+ * @param delivery
+ *     The delivery to initialize with the details of the chunk handed off.
+ *
+ * @param flush
+ *     Non-zero if the broadcast socket is being flushed, zero otherwise.
+ */
+static void guac_socket_broadcast_publish(guac_socket_broadcast_data* data,
+        guac_socket_broadcast_delivery* delivery, int flush) {
+
+    memset(delivery, 0, sizeof(guac_socket_broadcast_delivery));
+
+    size_t length = data->committed;
+    if (length == 0)
+        return;
+
+    /* Copy all complete instructions into a new chunk, initially referenced
+     * only by this function */
+    guac_socket_broadcast_chunk* chunk = guac_mem_alloc(
+            guac_mem_ckd_add_or_die(sizeof(guac_socket_broadcast_chunk), length));
+
+    pthread_mutex_init(&(chunk->lock), NULL);
+    chunk->ref_count = 1;
+    chunk->length = length;
+    memcpy(chunk->data, data->buffer, length);
+
+    /* Retain any partial instruction */
+    data->length -= length;
+    data->committed = 0;
+    memmove(data->buffer, data->buffer + length, data->length);
+
+    delivery->chunk = chunk;
+    delivery->flush = flush;
+
+    /* Queue chunk for the users, noting whether there is only one user (and
+     * thus no other users that could be held back by that user) */
+    data->broadcast_handler(data->client, __count_user_callback, &delivery->users);
+    data->broadcast_handler(data->client, __enqueue_chunk_callback, delivery);
+
+}
+
+/**
+ * Completes the given delivery, writing its chunk to any user that must
+ * receive it directly and waiting for any users that have fallen behind.
+ * Users that are the only recipient of the chunk are waited for
+ * indefinitely. Otherwise, all users that have fallen behind are waited for
+ * against a single deadline GUAC_SOCKET_BROADCAST_BACKPRESSURE_TIMEOUT
+ * milliseconds from now, after which any users that have still not caught up
+ * have their queued data dropped and are marked for resynchronization. Locks
+ * guarding the broadcast socket and its users must NOT be held.
+ *
+ * @param delivery
+ *     The delivery to complete, as initialized by
+ *     guac_socket_broadcast_publish().
+ */
+static void guac_socket_broadcast_complete(
+        guac_socket_broadcast_delivery* delivery) {
+
+    guac_socket_broadcast_chunk* chunk = delivery->chunk;
+    if (chunk == NULL)
+        return;
+
+    guac_timestamp deadline = guac_timestamp_current()
+        + GUAC_SOCKET_BROADCAST_BACKPRESSURE_TIMEOUT;
+
+    for (int i = 0; i < delivery->length; i++) {
+
+        guac_socket_broadcast_recipient* recipient = &delivery->recipients[i];
+        guac_socket_broadcast_queue* queue = recipient->queue;
+
+        if (recipient->direct) {
+            guac_socket_broadcast_write_direct(queue, chunk, delivery->flush);
+            guac_socket_broadcast_chunk_release(chunk);
+        }
+
+        /* A sole recipient is waited for exactly as if writing to its socket
+         * directly, including through any flush */
+        else if (delivery->users == 1) {
+
+            guac_flag_wait_and_lock(&queue->state,
+                    GUAC_SOCKET_BROADCAST_QUEUE_READY);
+
+            if (delivery->flush) {
+                guac_flag_unlock(&queue->state);
+                guac_flag_wait_and_lock(&queue->state,
+                        GUAC_SOCKET_BROADCAST_QUEUE_IDLE);
+            }
+
+            guac_flag_unlock(&queue->state);
+
+        }
+
+        /* Rather than hold back all other users, drop everything queued for
+         * any user that does not catch up by the deadline shared by all such
+         * users, resynchronizing that user once they have caught up with the
+         * data already being written */
+        else {
+
+            guac_timestamp now = guac_timestamp_current();
+            unsigned int remaining = (now < deadline) ? deadline - now : 0;
+
+            if (guac_flag_timedwait_and_lock(&queue->state,
+                        GUAC_SOCKET_BROADCAST_QUEUE_READY, remaining))
+                guac_flag_unlock(&queue->state);
+
+            else {
+
+                guac_flag_lock(&queue->state);
+
+                /* Only a user that is still behind (and is not already being
+                 * dropped for other reasons) is resynchronized */
+                if (!(queue->state.value & GUAC_SOCKET_BROADCAST_QUEUE_READY)
+                        && !queue->failed && !queue->resync)
+                    guac_socket_broadcast_queue_overflow(queue);
+                else
+                    guac_flag_unlock(&queue->state);
+
+            }
+
+        }
+
+        guac_socket_broadcast_queue_release(queue);
+
+    }
+
+    guac_mem_free(delivery->recipients);
+    guac_socket_broadcast_chunk_release(chunk);
+
+}
+
+/**
+ * Socket write handler which buffers the given data for later delivery to
+ * all relevant users. Data is handed off to the queues of those users in
+ * chunks of complete instructions, and each user's queue is written to that
+ * user's socket by a separate thread. This write handler will always
+ * succeed.
  *
  * @param socket
- *     The broadcast socket to lock.
+ *     The socket to which the given data must be written.
+ *
+ * @param buf
+ *     The buffer containing the data to write.
+ *
+ * @param count
+ *     The number of bytes to attempt to write from the given buffer.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs. This handler will
+ *     always succeed, and thus will always return the exact number of bytes
+ *     specified by count.
  */
-static void __guac_socket_broadcast_lock_handler(guac_socket* socket) {
+static ssize_t __guac_socket_broadcast_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
 
     guac_socket_broadcast_data* data =
         (guac_socket_broadcast_data*) socket->data;
 
-    /* Acquire exclusive access to socket */
-    pthread_mutex_lock(&(data->socket_lock));
+    pthread_mutex_lock(&(data->buffer_lock));
+
+    /* Grow buffer as necessary */
+    if (data->length + count > data->capacity) {
+
+        size_t capacity = data->capacity * 2;
+        if (capacity < data->length + count)
+            capacity = data->length + count;
 
-    /* Lock sockets of the users */
-    data->broadcast_handler(data->client, __lock_callback, NULL);
+        data->buffer = guac_mem_realloc_or_die(data->buffer, capacity);
+        data->capacity = capacity;
+
+    }
+
+    memcpy(data->buffer + data->length, buf, count);
+    data->length += count;
+
+    pthread_mutex_unlock(&(data->buffer_lock));
+
+    return count;
 
 }
 
 /**
- * Callback which is invoked by the broadcast handler to unlock the given
- * user's socket at the end of a Guacamole protocol instruction.
+ * Socket flush handler which hands off all complete instructions written to
+ * the broadcast socket to the queues of all relevant users. Each user's socket
+ * is flushed by that user's writer thread once the user's queue is empty. If
+ * there is only one user, this handler blocks until that user's socket has
+ * been flushed.
  *
- * @param user
- *     The user whose socket should be unlocked.
- *
- * @param data
- *     Arbitrary data passed to the broadcast handler. This is not needed
- *     by this callback, and should be left as NULL.
+ * @param socket
+ *     The broadcast socket to flush.
  *
  * @return
- *     Always NULL.
+ *     Zero if the flush operation succeeds, non-zero if the operation fails.
+ *     This handler will always succeed, and thus will always return zero.
  */
-static void* __unlock_callback(guac_user* user, void* data) {
+static ssize_t __guac_socket_broadcast_flush_handler(guac_socket* socket) {
 
-    /* Unlock socket */
-    guac_socket_instruction_end(user->socket);
+    guac_socket_broadcast_data* data =
+        (guac_socket_broadcast_data*) socket->data;
 
-    return NULL;
+    guac_socket_broadcast_delivery delivery;
+
+    pthread_mutex_lock(&(data->buffer_lock));
+    guac_socket_broadcast_publish(data, &delivery, 1);
+    pthread_mutex_unlock(&(data->buffer_lock));
+
+    /* Wait for users only after other threads may again write */
+    guac_socket_broadcast_complete(&delivery);
+
+    return 0;
 
 }
 
 /**
- * Socket unlock handler which releases the socket locks of all connected users.
- * Socket-level locks are released after a Guacamole instruction has finished
- * being written.
+ * Socket lock handler which acquires exclusive access to the broadcast socket
+ * in preparation for the beginning of a new Guacamole instruction, ensuring
+ * that parallel writes are only interleaved at instruction boundaries.
+ *
+ * @param socket
+ *     The broadcast socket to lock.
+ */
+static void __guac_socket_broadcast_lock_handler(guac_socket* socket) {
+
+    guac_socket_broadcast_data* data =
+        (guac_socket_broadcast_data*) socket->data;
+
+    /* Acquire exclusive access to socket */
+    pthread_mutex_lock(&(data->socket_lock));
+
+}
+
+/**
+ * Socket unlock handler which marks the instruction just written as complete
+ * and releases exclusive access to the broadcast socket. If enough complete
+ * instructions have accumulated, those instructions are handed off to the
+ * queues of all relevant users.
  *
  * @param socket
  *     The broadcast socket to unlock.
@@ -307,12 +769,23 @@ static void __guac_socket_broadcast_unlock_handler(guac_socket* socket) {
     guac_socket_broadcast_data* data =
         (guac_socket_broadcast_data*) socket->data;
 
-    /* Unlock sockets of all users */
-    data->broadcast_handler(data->client, __unlock_callback, NULL);
+    guac_socket_broadcast_delivery delivery = { 0 };
+
+    pthread_mutex_lock(&(data->buffer_lock));
+
+    /* All data written thus far makes up complete instructions */
+    data->committed = data->length;
+    if (data->committed >= GUAC_SOCKET_BROADCAST_CHUNK_SIZE)
+        guac_socket_broadcast_publish(data, &delivery, 0);
+
+    pthread_mutex_unlock(&(data->buffer_lock));
 
     /* Relinquish exclusive access to socket */
     pthread_mutex_unlock(&(data->socket_lock));
 
+    /* Wait for users only after other threads may again write */
+    guac_socket_broadcast_complete(&delivery);
+
 }
 
 /**
@@ -358,14 +831,124 @@ static int __guac_socket_broadcast_free_handler(guac_socket* socket) {
     guac_socket_broadcast_data* data =
         (guac_socket_broadcast_data*) socket->data;
 
+    guac_socket_broadcast_delivery delivery;
+
+    /* Hand off any remaining data, complete or not */
+    pthread_mutex_lock(&(data->buffer_lock));
+    data->committed = data->length;
+    guac_socket_broadcast_publish(data, &delivery, 0);
+    pthread_mutex_unlock(&(data->buffer_lock));
+
+    guac_socket_broadcast_complete(&delivery);
+
     /* Destroy locks */
     pthread_mutex_destroy(&(data->socket_lock));
+    pthread_mutex_destroy(&(data->buffer_lock));
 
+    guac_mem_free(data->buffer);
     guac_mem_free(data);
     return 0;
 
 }
 
+/**
+ * Thread which writes each chunk within the given user's broadcast queue to
+ * that user's socket, in order, flushing the user's socket whenever the queue
+ * has been emptied. If a write fails, the user is signalled to stop with
+ * guac_user_stop() and all further chunks are dropped. Once the queue is
+ * stopping, the thread exits as soon as the queue has been emptied or no
+ * further data can be written to the user.
+ *
+ * @param data
+ *     A pointer to the guac_socket_broadcast_queue of the user.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_socket_broadcast_queue_thread(void* data) {
+
+    guac_socket_broadcast_queue* queue = (guac_socket_broadcast_queue*) data;
+    guac_user* user = queue->user;
+
+    for (;;) {
+
+        guac_flag_wait_and_lock(&queue->state,
+                GUAC_SOCKET_BROADCAST_QUEUE_NONEMPTY
+                | GUAC_SOCKET_BROADCAST_QUEUE_STOPPING);
+
+        /* Continue writing while stopping only until the queue is drained
+         * (any chunks that cannot be written are dropped by
+         * guac_socket_broadcast_queue_free()) */
+        if ((queue->state.value & GUAC_SOCKET_BROADCAST_QUEUE_STOPPING)
+                && (queue->length == 0 || queue->failed)) {
+            guac_flag_unlock(&queue->state);
+            break;
+        }
+
+        /* Pull chunk from head of queue */
+        guac_socket_broadcast_chunk* chunk = queue->chunks[queue->head];
+        queue->head = (queue->head + 1) % GUAC_SOCKET_BROADCAST_QUEUE_CAPACITY;
+        queue->length--;
+        queue->backlog -= chunk->length;
+
+        int drained = (queue->length == 0);
+        if (drained)
+            guac_flag_clear(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_NONEMPTY);
+
+        /* Allow any broadcasts waiting on this user to continue */
+        if (queue->length < GUAC_SOCKET_BROADCAST_QUEUE_SIZE
+                && queue->backlog < GUAC_SOCKET_BROADCAST_MAX_BACKLOG)
+            guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_READY);
+
+        int failed = queue->failed;
+        guac_flag_unlock(&queue->state);
+
+        if (!failed) {
+
+            /* Chunks contain only complete instructions, thus they may be
+             * interleaved with instructions written directly to the user's
+             * socket by other threads */
+            guac_socket_instruction_begin(user->socket);
+            failed = guac_socket_write(user->socket, chunk->data, chunk->length);
+            guac_socket_instruction_end(user->socket);
+
+            /* Flush only once caught up, such that a user that is behind
+             * receives data in as few network writes as possible */
+            if (!failed && drained)
+                failed = guac_socket_flush(user->socket);
+
+            /* Drop all further data if the user's socket has failed */
+            if (failed) {
+                guac_socket_broadcast_queue_fail(queue);
+                guac_user_stop(user);
+            }
+
+            else {
+
+                guac_flag_lock(&queue->state);
+                queue->chunks_written++;
+                queue->bytes_written += chunk->length;
+
+                /* Everything queued has now been received by the user if
+                 * nothing further was queued while writing */
+                if (queue->length == 0)
+                    guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_IDLE);
+
+                guac_flag_unlock(&queue->state);
+
+            }
+
+        }
+
+        guac_socket_broadcast_chunk_release(chunk);
+
+    }
+
+    guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_STOPPED);
+    return NULL;
+
+}
+
 /**
  * Construct and return a socket that will broadcast to the users given by
  * by the provided broadcast handler.
@@ -388,7 +971,7 @@ static guac_socket* __guac_socket_init(
     /* Allocate socket and associated data */
     guac_socket* socket = guac_socket_alloc();
     guac_socket_broadcast_data* data =
-        guac_mem_alloc(sizeof(guac_socket_broadcast_data));
+        guac_mem_zalloc(sizeof(guac_socket_broadcast_data));
 
     /* Set the provided broadcast handler */
     data->broadcast_handler = broadcast_handler;
@@ -400,8 +983,9 @@ static guac_socket* __guac_socket_init(
     pthread_mutexattr_init(&lock_attributes);
     pthread_mutexattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
 
-    /* Init lock */
+    /* Init locks */
     pthread_mutex_init(&(data->socket_lock), &lock_attributes);
+    pthread_mutex_init(&(data->buffer_lock), NULL);
 
     /* Set read/write handlers */
     socket->read_handler   = __guac_socket_broadcast_read_handler;
@@ -430,3 +1014,94 @@ guac_socket* guac_socket_broadcast_pending(guac_client* client) {
 
 }
 
+
+void guac_socket_broadcast_queue_alloc(guac_user* user) {
+
+    guac_socket_broadcast_queue* queue =
+        guac_mem_zalloc(sizeof(guac_socket_broadcast_queue));
+
+    queue->user = user;
+    guac_flag_init(&queue->state);
+    guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_READY
+            | GUAC_SOCKET_BROADCAST_QUEUE_IDLE
+            | GUAC_SOCKET_BROADCAST_QUEUE_UNREFERENCED);
+
+    user->__broadcast_queue = queue;
+    pthread_create(&queue->writer, NULL,
+            guac_socket_broadcast_queue_thread, queue);
+
+}
+
+int guac_socket_broadcast_queue_begin_resync(guac_user* user) {
+
+    guac_socket_broadcast_queue* queue = user->__broadcast_queue;
+    if (queue == NULL)
+        return 0;
+
+    guac_flag_lock(&queue->state);
+    int resync = queue->resync && !queue->failed;
+    queue->resync = 0;
+    guac_flag_unlock(&queue->state);
+
+    return resync;
+
+}
+
+void guac_socket_broadcast_queue_stop(guac_user* user) {
+
+    guac_socket_broadcast_queue* queue = user->__broadcast_queue;
+    if (queue != NULL)
+        guac_flag_set(&queue->state, GUAC_SOCKET_BROADCAST_QUEUE_STOPPING);
+
+}
+
+void guac_socket_broadcast_queue_free(guac_user* user) {
+
+    guac_socket_broadcast_queue* queue = user->__broadcast_queue;
+    if (queue == NULL)
+        return;
+
+    /* Allow the writer thread a limited amount of time to write any data
+     * remaining in the queue, such as the reason for disconnect */
+    guac_socket_broadcast_queue_stop(user);
+    if (guac_flag_timedwait_and_lock(&queue->state,
+                GUAC_SOCKET_BROADCAST_QUEUE_STOPPED,
+                GUAC_SOCKET_BROADCAST_DRAIN_TIMEOUT))
+        guac_flag_unlock(&queue->state);
+
+    /* Drop remaining data for users that have stalled */
+    else {
+        guac_socket_broadcast_queue_fail(queue);
+        guac_user_log(user, GUAC_LOG_DEBUG, "User did not receive pending "
+                "data within %i ms. Remaining data will be dropped.",
+                GUAC_SOCKET_BROADCAST_DRAIN_TIMEOUT);
+    }
+
+    /* Wait for writer thread to finish any in-progress write */
+    pthread_join(queue->writer, NULL);
+
+    /* Wake any broadcasts still waiting on this user, and wait for those
+     * broadcasts (as well as any in-progress direct write) to finish with
+     * the queue */
+    guac_socket_broadcast_queue_fail(queue);
+    guac_flag_wait_and_lock(&queue->state,
+            GUAC_SOCKET_BROADCAST_QUEUE_UNREFERENCED);
+    guac_flag_unlock(&queue->state);
+
+    guac_user_log(user, GUAC_LOG_DEBUG, "Broadcast queue statistics: "
+            "%" PRIu64 " chunks (%" PRIu64 " bytes) written, peak backlog of "
+            "%zu bytes, %u resyncs, %u chunks (%zu bytes) never written.",
+            queue->chunks_written, queue->bytes_written, queue->peak_backlog,
+            queue->resyncs, queue->length, queue->backlog);
+
+    /* Drop any data that could not be written */
+    guac_flag_lock(&queue->state);
+    guac_socket_broadcast_queue_drop(queue);
+    guac_flag_unlock(&queue->state);
+
+    guac_flag_destroy(&queue->state);
+    guac_mem_free(queue);
+
+    user->__broadcast_queue = NULL;
+
+}
@@ -0,0 +1,323 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_SOCKET_BROADCAST_H
+#define GUAC_SOCKET_BROADCAST_H
+
+#include "guacamole/flag.h"
+#include "guacamole/user.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The number of bytes of complete instructions that may accumulate within a
+ * broadcast socket before those instructions are handed off to the queues of
+ * all relevant users, even if the broadcast socket has not been flushed.
+ */
+#define GUAC_SOCKET_BROADCAST_CHUNK_SIZE 8192
+
+/**
+ * The maximum number of chunks that may be queued for any one user. If a
+ * user falls further behind than this, further broadcasts wait for that user
+ * for up to GUAC_SOCKET_BROADCAST_BACKPRESSURE_TIMEOUT milliseconds, after
+ * which the user's queued data is dropped and the user is resynchronized.
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_SIZE 4096
+
+/**
+ * The number of chunks that may be queued for any one user beyond
+ * GUAC_SOCKET_BROADCAST_QUEUE_SIZE. Broadcasts queue each chunk before
+ * waiting for any users that have fallen behind, such that no lock is held
+ * while waiting, and each broadcasting thread may thus exceed
+ * GUAC_SOCKET_BROADCAST_QUEUE_SIZE by one chunk. If even this headroom is
+ * exhausted, the user's queued data is dropped and the user is
+ * resynchronized immediately.
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_HEADROOM 256
+
+/**
+ * The total number of chunks that the queue of any one user can hold.
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_CAPACITY \
+    (GUAC_SOCKET_BROADCAST_QUEUE_SIZE + GUAC_SOCKET_BROADCAST_QUEUE_HEADROOM)
+
+/**
+ * The maximum number of bytes that may be queued for any one user. If a user
+ * falls further behind than this, further broadcasts wait for that user in
+ * the same way as when GUAC_SOCKET_BROADCAST_QUEUE_SIZE is reached. As chunks
+ * are shared between all users, this is a limit on how far behind a user may
+ * fall, not on the memory consumed by each user.
+ */
+#define GUAC_SOCKET_BROADCAST_MAX_BACKLOG 33554432
+
+/**
+ * The maximum number of milliseconds that a broadcast may wait for space to
+ * become available within the queue of a user that has fallen behind while
+ * other users are also connected. If no space becomes available within this
+ * time, all data queued for that user is dropped and the user is
+ * resynchronized, such that one slow user cannot indefinitely hold back all
+ * other users. A user that is the only recipient of a broadcast is always
+ * waited for, exactly as if writing directly to that user's socket.
+ */
+#define GUAC_SOCKET_BROADCAST_BACKPRESSURE_TIMEOUT 500
+
+/**
+ * The value of the state flag of a guac_socket_broadcast_queue when at least
+ * one chunk is waiting to be written.
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_NONEMPTY 1
+
+/**
+ * The value of the state flag of a guac_socket_broadcast_queue when its
+ * writer thread must stop.
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_STOPPING 2
+
+/**
+ * The value of the state flag of a guac_socket_broadcast_queue once its
+ * writer thread has stopped.
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_STOPPED 4
+
+/**
+ * The value of the state flag of a guac_socket_broadcast_queue when further
+ * chunks may be queued without exceeding GUAC_SOCKET_BROADCAST_QUEUE_SIZE or
+ * GUAC_SOCKET_BROADCAST_MAX_BACKLOG, or when writing to the user has failed
+ * (in which case further chunks are simply dropped).
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_READY 8
+
+/**
+ * The value of the state flag of a guac_socket_broadcast_queue when all
+ * queued chunks have been written to the user's socket and that socket has
+ * been flushed, or when writing to the user has failed.
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_IDLE 16
+
+/**
+ * The value of the state flag of a guac_socket_broadcast_queue when no
+ * broadcast holds a reference to the queue (see the refs member of
+ * guac_socket_broadcast_queue).
+ */
+#define GUAC_SOCKET_BROADCAST_QUEUE_UNREFERENCED 32
+
+/**
+ * The maximum number of milliseconds to wait for the writer thread of a
+ * stopping user's broadcast queue to write any data remaining in that queue
+ * (such as the instruction describing why the user was disconnected) before
+ * that data is dropped.
+ */
+#define GUAC_SOCKET_BROADCAST_DRAIN_TIMEOUT 5000
+
+/**
+ * An immutable, reference-counted block of serialized Guacamole instructions
+ * which has been broadcast to any number of users. Each chunk contains only
+ * complete instructions.
+ */
+typedef struct guac_socket_broadcast_chunk {
+
+    /**
+     * Lock which guards the reference count of this chunk.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The number of queues (and other holders) which still reference this
+     * chunk. Once this reaches zero, the chunk is freed.
+     */
+    int ref_count;
+
+    /**
+     * The number of bytes within this chunk.
+     */
+    size_t length;
+
+    /**
+     * The serialized instructions contained within this chunk.
+     */
+    char data[];
+
+} guac_socket_broadcast_chunk;
+
+/**
+ * The queue of broadcast chunks awaiting delivery to a single user, along
+ * with the thread that writes those chunks to that user's socket. Each
+ * connected user has their own queue, such that a user with a slow network
+ * connection only delays the data sent to that user.
+ */
+typedef struct guac_socket_broadcast_queue {
+
+    /**
+     * The user that this queue delivers data to.
+     */
+    guac_user* user;
+
+    /**
+     * The current state of this queue. This flag also guards access to all
+     * other members of this structure.
+     */
+    guac_flag state;
+
+    /**
+     * Ring buffer of all chunks awaiting delivery.
+     */
+    guac_socket_broadcast_chunk* chunks[GUAC_SOCKET_BROADCAST_QUEUE_CAPACITY];
+
+    /**
+     * The index of the next chunk to be written within the chunks ring
+     * buffer.
+     */
+    unsigned int head;
+
+    /**
+     * The number of chunks currently within the chunks ring buffer.
+     */
+    unsigned int length;
+
+    /**
+     * The total number of bytes across all chunks awaiting delivery.
+     */
+    size_t backlog;
+
+    /**
+     * The largest value that backlog has reached.
+     */
+    size_t peak_backlog;
+
+    /**
+     * Non-zero if writing to the user's socket has failed or the user did
+     * not receive all remaining data within
+     * GUAC_SOCKET_BROADCAST_DRAIN_TIMEOUT while stopping, in which case all
+     * further chunks are dropped.
+     */
+    int failed;
+
+    /**
+     * Non-zero if this user fell too far behind and the data queued for the
+     * user has been dropped. Further chunks are dropped until the user has
+     * been removed from the full users list of its guac_client (see
+     * guac_socket_broadcast_queue_begin_resync()), after which the user
+     * receives the current state of the connection through the client's
+     * resync_handler.
+     */
+    int resync;
+
+    /**
+     * The total number of times this user fell too far behind and had to be
+     * resynchronized.
+     */
+    unsigned int resyncs;
+
+    /**
+     * The total number of chunks written to the user's socket.
+     */
+    uint64_t chunks_written;
+
+    /**
+     * The total number of bytes written to the user's socket.
+     */
+    uint64_t bytes_written;
+
+    /**
+     * The thread which writes queued chunks to the user's socket.
+     */
+    pthread_t writer;
+
+    /**
+     * The number of broadcasts which have queued data for the user and are
+     * still referencing this queue after releasing the lock on the user
+     * list, either to wait for the user to catch up or to write to the
+     * user's socket directly. The queue, and the user, are not freed until
+     * no such references remain.
+     */
+    unsigned int refs;
+
+    /**
+     * Non-zero if a broadcast is currently writing directly to the user's
+     * socket, in which case the writer thread must not yet be woken for any
+     * chunks queued meanwhile, as those chunks must follow the chunk being
+     * written directly.
+     */
+    int direct;
+
+} guac_socket_broadcast_queue;
+
+/**
+ * Allocates a new broadcast queue for the given user, starting the thread
+ * that writes queued data to that user's socket. The queue is stored within
+ * the given user, and all broadcast sockets will deliver data to the user
+ * through that queue. The queue must eventually be freed with a call to
+ * guac_socket_broadcast_queue_free().
+ *
+ * @param user
+ *     The user to allocate a broadcast queue for.
+ */
+void guac_socket_broadcast_queue_alloc(guac_user* user);
+
+/**
+ * Checks whether the given user fell too far behind and had their queued
+ * broadcast data dropped, clearing that state such that the user may again
+ * receive broadcast data. If this function returns non-zero, the caller MUST
+ * remove the user from the full users list of its guac_client and
+ * resynchronize the user with the current state of the connection using the
+ * client's resync_handler before returning the user to that list. Both the
+ * pending and full user lists of the guac_client MUST be locked for writing.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @return
+ *     Non-zero if the user must be resynchronized, zero otherwise.
+ */
+int guac_socket_broadcast_queue_begin_resync(guac_user* user);
+
+/**
+ * Signals the writer thread of the given user's broadcast queue to stop once
+ * all data already queued has been written. Queued data is dropped only if
+ * the user has already fallen too far behind or its socket has failed. This
+ * function does not wait for the writer thread, and thus may safely be
+ * invoked while holding locks that other users depend on, even if the user's
+ * socket has stalled. The user MUST already have been removed from all user
+ * lists of its guac_client such that no further data can be broadcast to that
+ * user. If the user has no broadcast queue, this function has no effect.
+ *
+ * @param user
+ *     The user whose broadcast queue should be stopped.
+ */
+void guac_socket_broadcast_queue_stop(guac_user* user);
+
+/**
+ * Stops the writer thread of the given user's broadcast queue and frees the
+ * queue. The writer thread is given up to GUAC_SOCKET_BROADCAST_DRAIN_TIMEOUT
+ * milliseconds to write all data remaining in the queue, after which any data
+ * not yet written is dropped, as the user has stalled. As this function may
+ * block for as long as a write to the user's socket blocks, it must not be
+ * invoked while holding any lock required by other users. The
+ * user MUST already have been removed from all user lists of its guac_client
+ * such that no further data can be broadcast to that user. If the user has no
+ * broadcast queue, this function has no effect.
+ *
+ * @param user
+ *     The user whose broadcast queue should be freed.
+ */
+void guac_socket_broadcast_queue_free(guac_user* user);
+
+#endif
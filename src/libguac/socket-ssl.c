@@ -141,14 +141,8 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
     if (ssl == NULL)
         return NULL;
 
-    /* Allocate socket and associated data */
-    guac_socket* socket = guac_socket_alloc();
-    guac_socket_ssl_data* data = guac_mem_alloc(sizeof(guac_socket_ssl_data));
-
     /* Init SSL */
-    data->context = context;
-    data->ssl = ssl;
-    SSL_set_fd(data->ssl, fd);
+    SSL_set_fd(ssl, fd);
 
     /* Accept SSL connection, handle errors */
     if (SSL_accept(ssl) <= 0) {
@@ -156,19 +150,31 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
         guac_error = GUAC_STATUS_INTERNAL_ERROR;
         guac_error_message = "SSL accept failed";
 
-        guac_mem_free(data);
-        guac_socket_free(socket);
         SSL_free(ssl);
         return NULL;
     }
 
+    return guac_socket_open_ssl(ssl);
+
+}
+
+guac_socket* guac_socket_open_ssl(SSL* ssl) {
+
+    /* Allocate socket and associated data */
+    guac_socket* socket = guac_socket_alloc();
+    guac_socket_ssl_data* data = guac_mem_alloc(sizeof(guac_socket_ssl_data));
+
+    /* Init SSL */
+    data->context = SSL_get_SSL_CTX(ssl);
+    data->ssl = ssl;
+
     pthread_mutexattr_t lock_attributes;
     pthread_mutexattr_init(&lock_attributes);
     pthread_mutexattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
     pthread_mutex_init(&(data->socket_lock), &lock_attributes);
 
     /* Store file descriptor as socket data */
-    data->fd = fd;
+    data->fd = SSL_get_fd(ssl);
     socket->data = data;
 
     /* Set read/write handlers */
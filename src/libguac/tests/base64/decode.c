@@ -0,0 +1,229 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "base64.h"
+
+#include <CUnit/CUnit.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The largest number of characters decoded by any one test.
+ */
+#define TEST_BASE64_MAX_LENGTH 4096
+
+/**
+ * The number of characters decoded by each iteration of the throughput test.
+ */
+#define TEST_BASE64_THROUGHPUT_LENGTH 1048576
+
+/**
+ * The number of iterations performed by the throughput test.
+ */
+#define TEST_BASE64_THROUGHPUT_ITERATIONS 64
+
+/**
+ * Fills the given buffer with pseudo-random base64 characters, followed by a
+ * null terminator.
+ *
+ * @param buffer
+ *     The buffer to fill. This buffer must have space for at least length + 1
+ *     characters.
+ *
+ * @param length
+ *     The number of base64 characters to write to the buffer.
+ */
+static void test_base64_fill(char* buffer, size_t length) {
+
+    static const char characters[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    for (size_t i = 0; i < length; i++)
+        buffer[i] = characters[rand() % 64];
+
+    buffer[length] = '\0';
+
+}
+
+/**
+ * Returns the number of seconds elapsed since the given start time, as
+ * measured by clock().
+ *
+ * @param start
+ *     The time that measurement started, as returned by clock().
+ *
+ * @return
+ *     The number of seconds elapsed since the given start time.
+ */
+static double test_base64_elapsed(clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/**
+ * Verifies that the implementation of guac_base64_decode() selected for the
+ * local processor decodes the given string exactly as the scalar reference
+ * implementation does, both when the length of the string is measured by
+ * guac_base64_decode() and when it is provided to
+ * guac_base64_decode_length().
+ *
+ * @param base64
+ *     The null-terminated base64 string to decode. This string is not
+ *     modified.
+ *
+ * @param length
+ *     The length of the string, excluding the null terminator.
+ */
+static void test_base64_compare(const char* base64, size_t length) {
+
+    char expected[TEST_BASE64_MAX_LENGTH + 1];
+    char output[TEST_BASE64_MAX_LENGTH + 1];
+    char output_known_length[TEST_BASE64_MAX_LENGTH + 1];
+
+    memcpy(expected, base64, length + 1);
+    memcpy(output, base64, length + 1);
+    memcpy(output_known_length, base64, length + 1);
+
+    size_t expected_length = guac_base64_decode_scalar(expected);
+    size_t output_length = guac_base64_decode(output);
+
+    CU_ASSERT_EQUAL_FATAL(output_length, expected_length);
+    CU_ASSERT_FATAL(memcmp(output, expected, output_length) == 0);
+
+    output_length = guac_base64_decode_length(output_known_length, length);
+
+    CU_ASSERT_EQUAL_FATAL(output_length, expected_length);
+    CU_ASSERT_FATAL(memcmp(output_known_length, expected, output_length) == 0);
+
+    /* Nothing beyond the end of the string may be touched */
+    CU_ASSERT_EQUAL_FATAL(output[length], '\0');
+    CU_ASSERT_EQUAL_FATAL(output_known_length[length], '\0');
+
+}
+
+/**
+ * Verifies that guac_base64_decode() correctly decodes known values, both
+ * with and without padding.
+ */
+void test_base64__decode_known() {
+
+    char hello[] = "SEVMTE8=";
+    CU_ASSERT_EQUAL(guac_base64_decode(hello), 5);
+    CU_ASSERT_NSTRING_EQUAL(hello, "HELLO", 5);
+
+    char avocado[] = "QVZPQ0FETw==";
+    CU_ASSERT_EQUAL(guac_base64_decode(avocado), 7);
+    CU_ASSERT_NSTRING_EQUAL(avocado, "AVOCADO", 7);
+
+    /* Long enough to be handled by any vectorized implementation */
+    char long_text[] =
+        "VGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4gVGhl"
+        "IHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4=";
+    CU_ASSERT_EQUAL(guac_base64_decode(long_text), 89);
+    CU_ASSERT_NSTRING_EQUAL(long_text,
+            "The quick brown fox jumps over the lazy dog. "
+            "The quick brown fox jumps over the lazy dog.", 89);
+
+    char empty[] = "";
+    CU_ASSERT_EQUAL(guac_base64_decode(empty), 0);
+
+}
+
+/**
+ * Verifies that the implementation of guac_base64_decode() selected for the
+ * local processor produces exactly the same output as the scalar reference
+ * implementation for all lengths up to TEST_BASE64_MAX_LENGTH, including
+ * strings containing padding or invalid characters at arbitrary positions.
+ */
+void test_base64__decode_matches_scalar() {
+
+    char input[TEST_BASE64_MAX_LENGTH + 1];
+
+    for (size_t length = 0; length <= TEST_BASE64_MAX_LENGTH; length++) {
+
+        test_base64_fill(input, length);
+        test_base64_compare(input, length);
+
+        if (length == 0)
+            continue;
+
+        /* Padding terminates decoding wherever it appears */
+        size_t position = rand() % length;
+        char original = input[position];
+        input[position] = '=';
+        test_base64_compare(input, length);
+
+        /* Invalid characters decode as zero and must not terminate
+         * decoding */
+        input[position] = (rand() & 1) ? '*' : (char) 0xC3;
+        test_base64_compare(input, length);
+
+        input[position] = original;
+
+    }
+
+}
+
+/**
+ * Compares the throughput of guac_base64_decode() against that of the scalar
+ * reference implementation, printing the results. This test fails only if
+ * the selected implementation is dramatically slower than the reference.
+ */
+void test_base64__decode_throughput() {
+
+    char* input = malloc(TEST_BASE64_THROUGHPUT_LENGTH + 1);
+    char* output = malloc(TEST_BASE64_THROUGHPUT_LENGTH + 1);
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(input);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+
+    test_base64_fill(input, TEST_BASE64_THROUGHPUT_LENGTH);
+
+    /* NOTE: Decoding is in-place, thus each iteration must first restore the
+     * original string, a cost shared equally by both implementations */
+    clock_t start = clock();
+    for (int i = 0; i < TEST_BASE64_THROUGHPUT_ITERATIONS; i++) {
+        memcpy(output, input, TEST_BASE64_THROUGHPUT_LENGTH + 1);
+        guac_base64_decode_scalar(output);
+    }
+    double scalar_time = test_base64_elapsed(start);
+
+    start = clock();
+    for (int i = 0; i < TEST_BASE64_THROUGHPUT_ITERATIONS; i++) {
+        memcpy(output, input, TEST_BASE64_THROUGHPUT_LENGTH + 1);
+        guac_base64_decode(output);
+    }
+    double selected_time = test_base64_elapsed(start);
+
+    double megabytes = (double) TEST_BASE64_THROUGHPUT_LENGTH
+        * TEST_BASE64_THROUGHPUT_ITERATIONS / 1048576;
+
+    printf("-------- %s() --------\n", __func__);
+    printf("Scalar:   %.0f MiB/s\n", megabytes / scalar_time);
+    printf("Selected: %.0f MiB/s\n", megabytes / selected_time);
+
+    /* Allow for considerable noise in timing, but catch anything that is
+     * clearly a regression */
+    CU_ASSERT(selected_time <= scalar_time * 2);
+
+    free(input);
+    free(output);
+
+}
@@ -0,0 +1,163 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "base64.h"
+
+#include <CUnit/CUnit.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The largest number of bytes encoded by any one test.
+ */
+#define TEST_BASE64_MAX_LENGTH 4096
+
+/**
+ * The number of bytes encoded by each iteration of the throughput test.
+ */
+#define TEST_BASE64_THROUGHPUT_LENGTH 1048576
+
+/**
+ * The number of iterations performed by the throughput test.
+ */
+#define TEST_BASE64_THROUGHPUT_ITERATIONS 64
+
+/**
+ * Fills the given buffer with pseudo-random bytes.
+ *
+ * @param buffer
+ *     The buffer to fill.
+ *
+ * @param length
+ *     The number of bytes to write to the buffer.
+ */
+static void test_base64_fill(unsigned char* buffer, size_t length) {
+    for (size_t i = 0; i < length; i++)
+        buffer[i] = rand() & 0xFF;
+}
+
+/**
+ * Returns the number of seconds elapsed since the given start time, as
+ * measured by clock().
+ *
+ * @param start
+ *     The time that measurement started, as returned by clock().
+ *
+ * @return
+ *     The number of seconds elapsed since the given start time.
+ */
+static double test_base64_elapsed(clock_t start) {
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/**
+ * Verifies that guac_base64_encode() produces correctly-padded output for
+ * known values.
+ */
+void test_base64__encode_known() {
+
+    char output[16];
+
+    CU_ASSERT_EQUAL(guac_base64_encode((const unsigned char*) "HELLO", 5, output), 8);
+    CU_ASSERT_NSTRING_EQUAL(output, "SEVMTE8=", 8);
+
+    CU_ASSERT_EQUAL(guac_base64_encode((const unsigned char*) "AVOCADO", 7, output), 12);
+    CU_ASSERT_NSTRING_EQUAL(output, "QVZPQ0FETw==", 12);
+
+    CU_ASSERT_EQUAL(guac_base64_encode((const unsigned char*) "GUACAMOLE", 9, output), 12);
+    CU_ASSERT_NSTRING_EQUAL(output, "R1VBQ0FNT0xF", 12);
+
+    CU_ASSERT_EQUAL(guac_base64_encode((const unsigned char*) "", 0, output), 0);
+
+}
+
+/**
+ * Verifies that the implementation of guac_base64_encode() selected for the
+ * local processor produces exactly the same output as the scalar reference
+ * implementation for all lengths up to TEST_BASE64_MAX_LENGTH, and that the
+ * output decodes back to the original bytes.
+ */
+void test_base64__encode_matches_scalar() {
+
+    unsigned char input[TEST_BASE64_MAX_LENGTH];
+    char expected[GUAC_BASE64_ENCODED_LENGTH(TEST_BASE64_MAX_LENGTH)];
+    char output[GUAC_BASE64_ENCODED_LENGTH(TEST_BASE64_MAX_LENGTH) + 1];
+
+    test_base64_fill(input, sizeof(input));
+
+    for (size_t length = 0; length <= TEST_BASE64_MAX_LENGTH; length++) {
+
+        size_t expected_length = guac_base64_encode_scalar(input, length, expected);
+        size_t output_length = guac_base64_encode(input, length, output);
+
+        CU_ASSERT_EQUAL_FATAL(expected_length, GUAC_BASE64_ENCODED_LENGTH(length));
+        CU_ASSERT_EQUAL_FATAL(output_length, expected_length);
+        CU_ASSERT_FATAL(memcmp(output, expected, output_length) == 0);
+
+        /* Encoded data must decode to the original bytes */
+        output[output_length] = '\0';
+        CU_ASSERT_EQUAL_FATAL(guac_base64_decode(output), length);
+        CU_ASSERT_FATAL(memcmp(output, input, length) == 0);
+
+    }
+
+}
+
+/**
+ * Compares the throughput of guac_base64_encode() against that of the scalar
+ * reference implementation, printing the results. This test fails only if
+ * the selected implementation is dramatically slower than the reference.
+ */
+void test_base64__encode_throughput() {
+
+    unsigned char* input = malloc(TEST_BASE64_THROUGHPUT_LENGTH);
+    char* output = malloc(GUAC_BASE64_ENCODED_LENGTH(TEST_BASE64_THROUGHPUT_LENGTH));
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(input);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(output);
+
+    test_base64_fill(input, TEST_BASE64_THROUGHPUT_LENGTH);
+
+    clock_t start = clock();
+    for (int i = 0; i < TEST_BASE64_THROUGHPUT_ITERATIONS; i++)
+        guac_base64_encode_scalar(input, TEST_BASE64_THROUGHPUT_LENGTH, output);
+    double scalar_time = test_base64_elapsed(start);
+
+    start = clock();
+    for (int i = 0; i < TEST_BASE64_THROUGHPUT_ITERATIONS; i++)
+        guac_base64_encode(input, TEST_BASE64_THROUGHPUT_LENGTH, output);
+    double selected_time = test_base64_elapsed(start);
+
+    double megabytes = (double) TEST_BASE64_THROUGHPUT_LENGTH
+        * TEST_BASE64_THROUGHPUT_ITERATIONS / 1048576;
+
+    printf("-------- %s() --------\n", __func__);
+    printf("Scalar:   %.0f MiB/s\n", megabytes / scalar_time);
+    printf("Selected: %.0f MiB/s\n", megabytes / selected_time);
+
+    /* Allow for considerable noise in timing, but catch anything that is
+     * clearly a regression */
+    CU_ASSERT(selected_time <= scalar_time * 2);
+
+    free(input);
+    free(output);
+
+}
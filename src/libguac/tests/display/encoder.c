@@ -0,0 +1,321 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-encoder.h"
+
+#include <CUnit/CUnit.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The number of frames within each replayed session.
+ */
+#define REPLAY_FRAMES 600
+
+/**
+ * The bandwidth of the simulated network, in bytes per millisecond.
+ */
+#define REPLAY_BANDWIDTH 500
+
+/**
+ * The round-trip time of the simulated network, excluding transfer time, in
+ * milliseconds.
+ */
+#define REPLAY_RTT 20
+
+/**
+ * The simulated cost of encoding a particular category of content with a
+ * particular format, in the same terms as guac_display_encoder_cost.
+ */
+typedef struct replay_cost {
+
+    /**
+     * Bytes per pixel, normalized to quality 100 for lossy formats.
+     */
+    double bytes_per_pixel;
+
+    /**
+     * Microseconds spent encoding each pixel.
+     */
+    double usec_per_pixel;
+
+} replay_cost;
+
+/**
+ * The simulated cost of each format for each category of content, roughly
+ * reflecting the relative performance of real encoders.
+ */
+static const replay_cost replay_costs[GUAC_DISPLAY_ENCODER_CONTENTS][GUAC_DISPLAY_ENCODER_FORMATS] = {
+
+    /* Simple content (text, user interface) */
+    {
+        { 0.30, 0.020 }, /* PNG */
+        { 1.00, 0.010 }, /* JPEG */
+        { 0.60, 0.060 }, /* WebP */
+        { 0.20, 0.080 }  /* Lossless WebP */
+    },
+
+    /* Complex content (photos, video) */
+    {
+        { 2.50, 0.050 }, /* PNG */
+        { 1.20, 0.010 }, /* JPEG */
+        { 0.80, 0.060 }, /* WebP */
+        { 2.00, 0.120 }  /* Lossless WebP */
+    }
+
+};
+
+/**
+ * The aggregate results of replaying a session.
+ */
+typedef struct replay_result {
+
+    /**
+     * The total estimated time spent encoding and transferring all updates,
+     * in milliseconds.
+     */
+    double latency;
+
+    /**
+     * The sum of the quality of all updates, where lossless updates have a
+     * quality of 100.
+     */
+    double quality;
+
+    /**
+     * The number of updates replayed.
+     */
+    int updates;
+
+    /**
+     * The number of updates requiring lossless encoding that were encoded
+     * with a lossy format.
+     */
+    int lossy_violations;
+
+    /**
+     * A checksum of every format and quality chosen, used to verify that
+     * replay is deterministic.
+     */
+    uint64_t checksum;
+
+} replay_result;
+
+/**
+ * Replays a deterministic session consisting of a large, frequently-updated
+ * video region alongside small, infrequent user interface updates, some of
+ * which require lossless encoding, accumulating the simulated cost of every
+ * update.
+ *
+ * @param adaptive
+ *     Non-zero if guac_display_encoder_choose() should be used to choose the
+ *     format of each update, zero if the static choice of each update should
+ *     be used as-is.
+ *
+ * @param result
+ *     The structure to populate with the results of the replay.
+ */
+static void replay(int adaptive, replay_result* result) {
+
+    guac_display_encoder_policy policy;
+    guac_display_encoder_policy_init(&policy);
+
+    *result = (replay_result) { 0 };
+    uint32_t seed = 1;
+
+    for (int frame = 0; frame < REPLAY_FRAMES; frame++) {
+
+        guac_timestamp timestamp = 1000 + frame * 33;
+        int frame_bytes = 0;
+
+        for (int update = 0; update < 3; update++) {
+
+            seed = seed * 1103515245 + 12345;
+
+            /* The first update of each frame is video, while the others are
+             * small user interface changes */
+            int video = (update == 0);
+            guac_display_encoder_request request = {
+                .pixels = video ? 640 * 360 : 64 * (16 + (seed >> 16) % 48),
+                .content = video
+                    ? GUAC_DISPLAY_ENCODER_CONTENT_COMPLEX
+                    : GUAC_DISPLAY_ENCODER_CONTENT_SIMPLE,
+                .framerate = video ? 30 : 1,
+                .lossless = !video && (seed >> 8) % 4 == 0,
+                .jpeg_allowed = 1,
+                .webp_allowed = 1,
+                .static_quality = 90
+            };
+
+            /* Static heuristics: lossy formats only for frequently-updated,
+             * complex content */
+            request.static_format = (video && !request.lossless)
+                ? GUAC_DISPLAY_ENCODER_JPEG
+                : GUAC_DISPLAY_ENCODER_PNG;
+
+            guac_display_encoder_choice choice = {
+                .format = request.static_format,
+                .quality = request.static_quality
+            };
+
+            if (adaptive)
+                guac_display_encoder_choose(&policy, &request, &choice);
+
+            int lossless = choice.format == GUAC_DISPLAY_ENCODER_PNG
+                || choice.format == GUAC_DISPLAY_ENCODER_WEBP_LOSSLESS;
+
+            /* Simulate encoding */
+            const replay_cost* cost = &replay_costs[request.content][choice.format];
+            double bytes = cost->bytes_per_pixel * request.pixels;
+            if (!lossless)
+                bytes *= guac_display_encoder_quality_factor(choice.quality);
+
+            double usec = cost->usec_per_pixel * request.pixels;
+            guac_display_encoder_record(&policy, request.content, choice.format,
+                    choice.quality, request.pixels, (int) bytes, (uint64_t) usec);
+
+            frame_bytes += (int) bytes;
+
+            result->latency += usec / 1000 + bytes / REPLAY_BANDWIDTH;
+            result->quality += lossless ? 100 : choice.quality;
+            result->updates++;
+
+            if (request.lossless && !lossless)
+                result->lossy_violations++;
+
+            result->checksum = result->checksum * 31 + choice.format * 101 + choice.quality;
+
+        }
+
+        /* Simulate acknowledgement of the frame, including transfer time */
+        guac_display_encoder_end_frame(&policy, timestamp);
+        guac_display_encoder_ack_frame(&policy, timestamp,
+                REPLAY_RTT + frame_bytes / REPLAY_BANDWIDTH);
+
+    }
+
+    guac_display_encoder_policy_destroy(&policy);
+
+}
+
+/**
+ * Verifies that replaying the same session with the adaptive policy always
+ * produces the same decisions, and that lossless encoding is always used
+ * where required.
+ */
+void test_display__encoder_deterministic() {
+
+    replay_result first;
+    replay_result second;
+
+    replay(1, &first);
+    replay(1, &second);
+
+    CU_ASSERT_EQUAL(first.checksum, second.checksum);
+    CU_ASSERT_EQUAL(first.updates, REPLAY_FRAMES * 3);
+    CU_ASSERT_EQUAL(first.lossy_violations, 0);
+
+}
+
+/**
+ * Compares the static policy against the adaptive policy for the same
+ * replayed session, verifying that the adaptive policy reduces the time
+ * spent encoding and transferring updates over a constrained network.
+ */
+void test_display__encoder_replay() {
+
+    replay_result static_result;
+    replay_result adaptive_result;
+
+    replay(0, &static_result);
+    replay(1, &adaptive_result);
+
+    printf("-------- %s() --------\n", __func__);
+    printf("Policy   | Mean latency (ms) | Mean quality\n");
+    printf("Static   | %17.1f | %12.1f\n",
+            static_result.latency / static_result.updates,
+            static_result.quality / static_result.updates);
+    printf("Adaptive | %17.1f | %12.1f\n",
+            adaptive_result.latency / adaptive_result.updates,
+            adaptive_result.quality / adaptive_result.updates);
+
+    CU_ASSERT(adaptive_result.latency < static_result.latency);
+    CU_ASSERT_EQUAL(adaptive_result.lossy_violations, 0);
+
+}
+
+/**
+ * Acknowledges a single simulated frame of the given size, sent with the
+ * given timestamp over a network with the given latency and bandwidth.
+ *
+ * @param policy
+ *     The policy to update.
+ *
+ * @param timestamp
+ *     The timestamp of the frame.
+ *
+ * @param bytes
+ *     The size of the frame, in bytes.
+ *
+ * @param rtt
+ *     The round-trip time of the simulated network, excluding transfer time,
+ *     in milliseconds.
+ *
+ * @param bandwidth
+ *     The bandwidth of the simulated network, in bytes per millisecond.
+ */
+static void ack_frame(guac_display_encoder_policy* policy,
+        guac_timestamp timestamp, int bytes, int rtt, int bandwidth) {
+
+    policy->frame_bytes = bytes;
+    guac_display_encoder_end_frame(policy, timestamp);
+    guac_display_encoder_ack_frame(policy, timestamp, rtt + bytes / bandwidth);
+
+}
+
+/**
+ * Verifies that the bandwidth estimate falls when the available bandwidth
+ * falls, and that the estimated latency of the network follows increases in
+ * that latency rather than retaining the smallest round trip ever observed.
+ */
+void test_display__encoder_bandwidth_adapts() {
+
+    guac_display_encoder_policy policy;
+    guac_display_encoder_policy_init(&policy);
+
+    guac_timestamp timestamp = 1000;
+
+    /* Fast network, with small frames interleaved such that the latency of
+     * the network can be observed */
+    for (int i = 0; i < 100; i++, timestamp += 33)
+        ack_frame(&policy, timestamp, (i % 2) ? 100000 : 500, REPLAY_RTT, 1000);
+
+    CU_ASSERT(policy.bandwidth > 500);
+    CU_ASSERT_EQUAL(policy.min_rtt, REPLAY_RTT);
+
+    /* Same network with much less bandwidth and more latency */
+    for (int i = 0; i < 1000; i++, timestamp += 33)
+        ack_frame(&policy, timestamp, 20000, REPLAY_RTT * 5, 100);
+
+    CU_ASSERT(policy.bandwidth < 200);
+    CU_ASSERT_EQUAL(policy.min_rtt, REPLAY_RTT * 5 + 200);
+
+    guac_display_encoder_policy_destroy(&policy);
+
+}
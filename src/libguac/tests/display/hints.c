@@ -0,0 +1,277 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+#include "guacamole/display.h"
+#include "guacamole/layer.h"
+#include "guacamole/rect.h"
+#include "guacamole/rwlock.h"
+
+#include <CUnit/CUnit.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * The width and height of the layer used by each test, in pixels.
+ */
+#define HINT_TEST_SIZE 128
+
+/**
+ * The number of bytes in each row of the image buffers of the layer used by
+ * each test.
+ */
+#define HINT_TEST_STRIDE (HINT_TEST_SIZE * GUAC_DISPLAY_LAYER_RAW_BPP)
+
+/**
+ * The display containing the layer used by each test.
+ */
+static guac_display test_display;
+
+/**
+ * The layer used by each test.
+ */
+static guac_display_layer test_layer;
+
+/**
+ * The Guacamole buffer that serves as the client-side copy of the previous
+ * frame of test_layer.
+ */
+static guac_layer test_last_frame_buffer = { .index = -1 };
+
+/**
+ * The image data of the pending frame of test_layer.
+ */
+static uint32_t test_pending[HINT_TEST_SIZE * HINT_TEST_SIZE];
+
+/**
+ * The image data of the previous frame of test_layer.
+ */
+static uint32_t test_last[HINT_TEST_SIZE * HINT_TEST_SIZE];
+
+/**
+ * Resets the display and layer used by each test such that the previous
+ * frame contains a distinct value at each pixel and the pending frame is
+ * identical to the previous frame.
+ */
+static void hint_test_reset() {
+
+    static int lock_initialized = 0;
+    if (lock_initialized)
+        guac_rwlock_destroy(&test_display.pending_frame.lock);
+
+    memset(&test_display, 0, sizeof(test_display));
+    guac_rwlock_init(&test_display.pending_frame.lock);
+    lock_initialized = 1;
+
+    memset(&test_layer, 0, sizeof(test_layer));
+
+    for (int i = 0; i < HINT_TEST_SIZE * HINT_TEST_SIZE; i++)
+        test_last[i] = 0xFF000000 | i;
+
+    memcpy(test_pending, test_last, sizeof(test_pending));
+
+    guac_display_layer_state state = {
+        .width = HINT_TEST_SIZE,
+        .height = HINT_TEST_SIZE,
+        .buffer_width = HINT_TEST_SIZE,
+        .buffer_height = HINT_TEST_SIZE,
+        .buffer_stride = HINT_TEST_STRIDE
+    };
+
+    test_layer.display = &test_display;
+    test_layer.opaque = 1;
+    test_layer.last_frame_buffer = &test_last_frame_buffer;
+
+    test_layer.last_frame = state;
+    test_layer.last_frame.buffer = (unsigned char*) test_last;
+
+    test_layer.pending_frame = state;
+    test_layer.pending_frame.buffer = (unsigned char*) test_pending;
+
+}
+
+/**
+ * Copies the given region of the previous frame of the test layer to the
+ * given location within the pending frame.
+ */
+static void hint_test_copy(const guac_rect* src, int x, int y) {
+    for (int row = 0; row < guac_rect_height(src); row++)
+        memcpy(&test_pending[(y + row) * HINT_TEST_SIZE + x],
+                &test_last[(src->top + row) * HINT_TEST_SIZE + src->left],
+                guac_rect_width(src) * GUAC_DISPLAY_LAYER_RAW_BPP);
+}
+
+/**
+ * Fills the given region of the pending frame of the test layer with the
+ * given color.
+ */
+static void hint_test_fill(const guac_rect* dst, uint32_t color) {
+    for (int y = dst->top; y < dst->bottom; y++)
+        for (int x = dst->left; x < dst->right; x++)
+            test_pending[y * HINT_TEST_SIZE + x] = color;
+}
+
+/**
+ * Runs the hint pass over a plan consisting of a single draw operation
+ * covering the given region of the test layer, storing the resulting
+ * operation in the given guac_display_plan_operation.
+ */
+static void hint_test_plan(const guac_rect* dest, guac_display_plan_operation* result) {
+
+    guac_display_plan_operation op = {
+        .layer = &test_layer,
+        .type = GUAC_DISPLAY_PLAN_OPERATION_IMG,
+        .dest = *dest
+    };
+
+    guac_display_plan plan = {
+        .display = &test_display,
+        .ops = &op,
+        .length = 1
+    };
+
+    PFR_LFR_guac_display_plan_rewrite_from_hints(&plan);
+    *result = op;
+
+}
+
+/**
+ * Verifies that a draw operation covered by a copy hint whose contents truly
+ * match the hinted region of the previous frame is rewritten as a copy from
+ * the corresponding region of the previous frame.
+ */
+void test_display__hint_copy() {
+
+    hint_test_reset();
+
+    /* Scroll everything up by 16 pixels */
+    guac_rect src;
+    guac_rect_init(&src, 0, 16, HINT_TEST_SIZE, HINT_TEST_SIZE - 16);
+    hint_test_copy(&src, 0, 0);
+    guac_display_layer_hint_copy(&test_layer, &src, 0, 0);
+    CU_ASSERT_EQUAL(test_layer.pending_frame_hint_count, 1);
+
+    guac_rect dest;
+    guac_rect_init(&dest, 64, 32, 64, 32);
+
+    guac_display_plan_operation op;
+    hint_test_plan(&dest, &op);
+
+    CU_ASSERT_EQUAL(op.type, GUAC_DISPLAY_PLAN_OPERATION_COPY);
+    CU_ASSERT_PTR_EQUAL(op.src.layer_rect.layer, &test_last_frame_buffer);
+    CU_ASSERT_EQUAL(op.src.layer_rect.rect.left, 64);
+    CU_ASSERT_EQUAL(op.src.layer_rect.rect.top, 48);
+    CU_ASSERT_EQUAL(op.src.layer_rect.rect.right, 128);
+    CU_ASSERT_EQUAL(op.src.layer_rect.rect.bottom, 80);
+    CU_ASSERT_EQUAL(test_display.hinted_ops, 1);
+
+}
+
+/**
+ * Verifies that copy hints which do not match the actual contents of the
+ * layer, or which do not fully cover a draw operation, are ignored.
+ */
+void test_display__hint_copy_mismatch() {
+
+    hint_test_reset();
+
+    guac_rect src;
+    guac_rect_init(&src, 0, 16, HINT_TEST_SIZE, 64);
+    hint_test_copy(&src, 0, 0);
+    guac_display_layer_hint_copy(&test_layer, &src, 0, 0);
+
+    /* Draw over part of the copied region after the copy */
+    guac_rect overdrawn;
+    guac_rect_init(&overdrawn, 10, 10, 1, 1);
+    hint_test_fill(&overdrawn, 0xFFFFFFFF);
+
+    guac_display_plan_operation op;
+    guac_rect dest;
+
+    /* Operation covering the overdrawn pixel */
+    guac_rect_init(&dest, 0, 0, 64, 32);
+    hint_test_plan(&dest, &op);
+    CU_ASSERT_EQUAL(op.type, GUAC_DISPLAY_PLAN_OPERATION_IMG);
+
+    /* Operation extending beyond the hinted region */
+    guac_rect_init(&dest, 64, 32, 64, 64);
+    hint_test_plan(&dest, &op);
+    CU_ASSERT_EQUAL(op.type, GUAC_DISPLAY_PLAN_OPERATION_IMG);
+
+    CU_ASSERT_EQUAL(test_display.hinted_ops, 0);
+
+}
+
+/**
+ * Verifies that fill hints are applied only where the region is truly filled
+ * with the hinted color, and that later hints take precedence.
+ */
+void test_display__hint_fill() {
+
+    hint_test_reset();
+
+    guac_rect filled;
+    guac_rect_init(&filled, 0, 0, 64, 64);
+    hint_test_fill(&filled, 0xFF123456);
+    guac_display_layer_hint_fill(&test_layer, &filled, 0xFF123456);
+
+    /* A hint that is inaccurate for part of the region */
+    guac_rect inaccurate;
+    guac_rect_init(&inaccurate, 32, 32, 64, 64);
+    guac_display_layer_hint_fill(&test_layer, &inaccurate, 0xFF654321);
+
+    guac_display_plan_operation op;
+    guac_rect dest;
+
+    /* Covered by both hints, with only the earlier hint being accurate */
+    guac_rect_init(&dest, 32, 32, 32, 32);
+    hint_test_plan(&dest, &op);
+    CU_ASSERT_EQUAL(op.type, GUAC_DISPLAY_PLAN_OPERATION_RECT);
+    CU_ASSERT_EQUAL(op.src.color, 0xFF123456);
+
+    /* Covered only by the inaccurate hint */
+    guac_rect_init(&dest, 64, 64, 32, 32);
+    hint_test_plan(&dest, &op);
+    CU_ASSERT_EQUAL(op.type, GUAC_DISPLAY_PLAN_OPERATION_IMG);
+
+    CU_ASSERT_EQUAL(test_display.hinted_ops, 1);
+
+}
+
+/**
+ * Verifies that no more than GUAC_DISPLAY_MAX_HINTS hints are retained for
+ * any one layer, and that empty hints are ignored.
+ */
+void test_display__hint_limit() {
+
+    hint_test_reset();
+
+    guac_rect empty = { 0 };
+    guac_display_layer_hint_fill(&test_layer, &empty, 0);
+    CU_ASSERT_EQUAL(test_layer.pending_frame_hint_count, 0);
+
+    guac_rect rect;
+    guac_rect_init(&rect, 0, 0, 1, 1);
+    for (int i = 0; i < GUAC_DISPLAY_MAX_HINTS * 2; i++)
+        guac_display_layer_hint_fill(&test_layer, &rect, 0);
+
+    CU_ASSERT_EQUAL(test_layer.pending_frame_hint_count, GUAC_DISPLAY_MAX_HINTS);
+
+}
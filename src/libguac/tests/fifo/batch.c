@@ -0,0 +1,286 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/fifo.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The maximum number of items permitted in batch_test_fifo.
+ */
+#define BATCH_TEST_FIFO_MAX_ITEMS 256
+
+/**
+ * The maximum number of items removed by each call to
+ * guac_fifo_dequeue_batch() within the contention benchmark.
+ */
+#define BATCH_TEST_MAX_BATCH 16
+
+/**
+ * The number of items sent through the fifo for each run of the contention
+ * benchmark.
+ */
+#define BATCH_TEST_ITEMS 1000000
+
+/**
+ * The largest number of consumer threads tested by the contention benchmark.
+ */
+#define BATCH_TEST_MAX_THREADS 64
+
+/**
+ * Fifo of integers that extends the guac_fifo base.
+ */
+typedef struct batch_test_fifo {
+
+    /**
+     * The base fifo implementation.
+     */
+    guac_fifo base;
+
+    /**
+     * Storage for all items in this fifo.
+     */
+    uint64_t items[BATCH_TEST_FIFO_MAX_ITEMS];
+
+} batch_test_fifo;
+
+/**
+ * The state of a single consumer thread within the contention benchmark.
+ */
+typedef struct batch_test_consumer {
+
+    /**
+     * The fifo to remove items from.
+     */
+    batch_test_fifo* fifo;
+
+    /**
+     * The maximum number of items to remove at once, or zero to remove items
+     * one at a time using guac_fifo_dequeue().
+     */
+    size_t batch_size;
+
+    /**
+     * The number of items removed by this consumer.
+     */
+    uint64_t count;
+
+    /**
+     * The sum of the values of all items removed by this consumer.
+     */
+    uint64_t sum;
+
+} batch_test_consumer;
+
+/**
+ * Thread which removes items from a fifo until that fifo is invalidated,
+ * tracking the number and sum of all items removed.
+ *
+ * @param data
+ *     A pointer to the batch_test_consumer describing the consumer.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* batch_test_consumer_thread(void* data) {
+
+    batch_test_consumer* consumer = (batch_test_consumer*) data;
+    uint64_t items[BATCH_TEST_MAX_BATCH];
+
+    for (;;) {
+
+        size_t count;
+        if (consumer->batch_size == 0)
+            count = guac_fifo_dequeue(&consumer->fifo->base, items) ? 1 : 0;
+        else
+            count = guac_fifo_dequeue_batch(&consumer->fifo->base, items,
+                    consumer->batch_size);
+
+        /* Fifo is invalidated only after all items have been removed */
+        if (count == 0)
+            break;
+
+        for (size_t i = 0; i < count; i++)
+            consumer->sum += items[i];
+
+        consumer->count += count;
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Sends BATCH_TEST_ITEMS items through a fifo from a single producer to the
+ * given number of consumer threads, verifying that every item is received
+ * exactly once and returning the rate at which items were received.
+ *
+ * @param thread_count
+ *     The number of consumer threads.
+ *
+ * @param batch_size
+ *     The maximum number of items each consumer should remove at once, or
+ *     zero to remove items one at a time using guac_fifo_dequeue().
+ *
+ * @return
+ *     The number of items sent and received per second, as measured using
+ *     CLOCK_MONOTONIC.
+ */
+static double batch_test_run(int thread_count, size_t batch_size) {
+
+    batch_test_fifo fifo;
+    guac_fifo_init(&fifo.base, fifo.items, BATCH_TEST_FIFO_MAX_ITEMS,
+            sizeof(uint64_t));
+
+    pthread_t threads[BATCH_TEST_MAX_THREADS];
+    batch_test_consumer consumers[BATCH_TEST_MAX_THREADS] = { { 0 } };
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < thread_count; i++) {
+        consumers[i].fifo = &fifo;
+        consumers[i].batch_size = batch_size;
+        CU_ASSERT_FALSE_FATAL(pthread_create(&threads[i], NULL,
+                    batch_test_consumer_thread, &consumers[i]));
+    }
+
+    for (uint64_t value = 1; value <= BATCH_TEST_ITEMS; value++)
+        CU_ASSERT_FATAL(guac_fifo_enqueue(&fifo.base, &value));
+
+    /* Wait for all items to be removed before stopping consumers */
+    for (;;) {
+
+        guac_fifo_lock(&fifo.base);
+        int empty = !(fifo.base.state.value & GUAC_FIFO_STATE_NONEMPTY);
+        guac_fifo_unlock(&fifo.base);
+
+        if (empty)
+            break;
+
+        usleep(100);
+
+    }
+
+    guac_fifo_invalidate(&fifo.base);
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    for (int i = 0; i < thread_count; i++) {
+        CU_ASSERT_FALSE(pthread_join(threads[i], NULL));
+        count += consumers[i].count;
+        sum += consumers[i].sum;
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    int64_t duration = (end.tv_sec - start.tv_sec) * 1000000000LL
+        + (end.tv_nsec - start.tv_nsec);
+
+    /* Every item must have been received exactly once */
+    CU_ASSERT_EQUAL(count, BATCH_TEST_ITEMS);
+    CU_ASSERT_EQUAL(sum, (uint64_t) BATCH_TEST_ITEMS * (BATCH_TEST_ITEMS + 1) / 2);
+
+    guac_fifo_destroy(&fifo.base);
+    return BATCH_TEST_ITEMS * 1000000000.0 / (duration > 0 ? duration : 1);
+
+}
+
+/**
+ * Verify that guac_fifo_dequeue_batch() removes items in order, including
+ * items which wrap around the end of the underlying storage, and never
+ * removes more than the requested number of items.
+ */
+void test_fifo__batch_order() {
+
+    batch_test_fifo fifo;
+    guac_fifo_init(&fifo.base, fifo.items, BATCH_TEST_FIFO_MAX_ITEMS,
+            sizeof(uint64_t));
+
+    uint64_t next_sent = 0;
+    uint64_t next_expected = 0;
+    uint64_t items[BATCH_TEST_FIFO_MAX_ITEMS];
+
+    /* Repeatedly fill and partially drain the fifo such that the head of the
+     * fifo moves around the full extent of its storage */
+    for (int round = 0; round < 16; round++) {
+
+        while (fifo.base.item_count < BATCH_TEST_FIFO_MAX_ITEMS) {
+            CU_ASSERT_FATAL(guac_fifo_enqueue(&fifo.base, &next_sent));
+            next_sent++;
+        }
+
+        size_t max_items = 7 + round * 13;
+        size_t count = guac_fifo_dequeue_batch(&fifo.base, items, max_items);
+        CU_ASSERT_EQUAL_FATAL(count, max_items);
+
+        for (size_t i = 0; i < count; i++)
+            CU_ASSERT_EQUAL_FATAL(items[i], next_expected++);
+
+    }
+
+    /* Removing more items than are present removes only those present */
+    size_t remaining = fifo.base.item_count;
+    CU_ASSERT_EQUAL(guac_fifo_timed_dequeue_batch(&fifo.base, items,
+                BATCH_TEST_FIFO_MAX_ITEMS, 0), remaining);
+
+    for (size_t i = 0; i < remaining; i++)
+        CU_ASSERT_EQUAL_FATAL(items[i], next_expected++);
+
+    /* An empty fifo yields nothing */
+    CU_ASSERT_EQUAL(guac_fifo_timed_dequeue_batch(&fifo.base, items,
+                BATCH_TEST_FIFO_MAX_ITEMS, 0), 0);
+
+    /* An invalid fifo yields nothing, even if not empty */
+    CU_ASSERT_FATAL(guac_fifo_enqueue(&fifo.base, &next_sent));
+    guac_fifo_invalidate(&fifo.base);
+    CU_ASSERT_EQUAL(guac_fifo_dequeue_batch(&fifo.base, items,
+                BATCH_TEST_FIFO_MAX_ITEMS), 0);
+
+    guac_fifo_destroy(&fifo.base);
+
+}
+
+/**
+ * Benchmark comparing the throughput of a fifo shared by a single producer
+ * and 1 through 64 consumers when consumers remove items one at a time versus
+ * in batches, verifying that every item is received exactly once.
+ */
+void test_fifo__contention() {
+
+    printf("-------- %s() --------\n", __func__);
+    printf("Threads | Mutex (items/s) | Batch (items/s)\n");
+
+    for (int thread_count = 1; thread_count <= BATCH_TEST_MAX_THREADS;
+            thread_count++) {
+
+        double single = batch_test_run(thread_count, 0);
+        double batch = batch_test_run(thread_count, BATCH_TEST_MAX_BATCH);
+
+        printf("%7i | %15.0f | %15.0f\n", thread_count, single, batch);
+
+    }
+
+}
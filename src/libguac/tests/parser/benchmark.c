@@ -0,0 +1,184 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Test string which contains exactly four Unicode characters encoded in UTF-8.
+ * This particular test string uses several characters which encode to multiple
+ * bytes in UTF-8.
+ */
+#define UTF8_4 "\xe7\x8a\xac\xf0\x90\xac\x80z\xc3\xa1"
+
+/**
+ * A "text" instruction containing 20 Unicode characters (50 bytes) within a
+ * single argument.
+ */
+#define TEST_TEXT_INSTRUCTION "4.text,20." UTF8_4 UTF8_4 UTF8_4 UTF8_4 UTF8_4 ";"
+
+/**
+ * The number of bytes of base64 data within each "blob" instruction.
+ */
+#define TEST_BLOB_SIZE 6144
+
+/**
+ * The total number of "blob" instructions to parse. One "text" instruction
+ * is parsed for every 16 "blob" instructions.
+ */
+#define TEST_BLOB_INSTRUCTIONS 4096
+
+/**
+ * The characters used to produce the arbitrary base64 data within each
+ * "blob" instruction.
+ */
+static const char TEST_BASE64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * Writes a series of "blob" and "text" instructions to the given file
+ * descriptor, closing the file descriptor once all instructions have been
+ * written.
+ *
+ * @param fd
+ *     The file descriptor to write instructions to.
+ */
+static void write_instructions(int fd) {
+
+    /* Build a single blob instruction containing arbitrary base64 */
+    char blob[TEST_BLOB_SIZE + 32];
+    int length = sprintf(blob, "4.blob,1.1,%i.", TEST_BLOB_SIZE);
+    for (int i = 0; i < TEST_BLOB_SIZE; i++)
+        blob[length++] = TEST_BASE64[(i * 7) % 64];
+    blob[length++] = ';';
+
+    for (int i = 0; i < TEST_BLOB_INSTRUCTIONS; i++) {
+
+        if (write(fd, blob, length) != length)
+            break;
+
+        if (i % 16 == 0 && write(fd, TEST_TEXT_INSTRUCTION,
+                    sizeof(TEST_TEXT_INSTRUCTION) - 1)
+                != sizeof(TEST_TEXT_INSTRUCTION) - 1)
+            break;
+
+    }
+
+    close(fd);
+
+}
+
+/**
+ * Reads and verifies all instructions written by write_instructions(),
+ * logging the throughput of the parser to STDERR.
+ *
+ * @param fd
+ *     The file descriptor to read instructions from.
+ */
+static void read_instructions(int fd) {
+
+    guac_socket* socket = guac_socket_open(fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    int blobs = 0;
+    int texts = 0;
+    long bytes = 0;
+
+    guac_timestamp start = guac_timestamp_current();
+
+    while (guac_parser_read(parser, socket, 1000000) == 0) {
+
+        if (strcmp(parser->opcode, "blob") == 0) {
+            CU_ASSERT_EQUAL_FATAL(parser->argc, 2);
+            CU_ASSERT_EQUAL_FATAL(parser->argv_sizes[0], 1);
+            CU_ASSERT_EQUAL_FATAL(parser->argv_sizes[1], TEST_BLOB_SIZE);
+            CU_ASSERT_EQUAL_FATAL(parser->argv[1][TEST_BLOB_SIZE - 1],
+                    TEST_BASE64[((TEST_BLOB_SIZE - 1) * 7) % 64]);
+            bytes += TEST_BLOB_SIZE;
+            blobs++;
+        }
+
+        else {
+            CU_ASSERT_STRING_EQUAL_FATAL(parser->opcode, "text");
+            CU_ASSERT_EQUAL_FATAL(parser->argc, 1);
+            CU_ASSERT_EQUAL_FATAL(parser->argv_sizes[0], 50);
+            CU_ASSERT_STRING_EQUAL_FATAL(parser->argv[0],
+                    UTF8_4 UTF8_4 UTF8_4 UTF8_4 UTF8_4);
+            texts++;
+        }
+
+    }
+
+    guac_timestamp duration = guac_timestamp_current() - start;
+
+    CU_ASSERT_EQUAL(blobs, TEST_BLOB_INSTRUCTIONS);
+    CU_ASSERT_EQUAL(texts, TEST_BLOB_INSTRUCTIONS / 16);
+
+    fprintf(stderr, "Parsed %i instructions (%li bytes of blob data) in "
+            "%i ms (%.1f MB/s)\n", blobs + texts, bytes, (int) duration,
+            duration > 0 ? bytes / 1000.0 / duration : 0.0);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Benchmark which verifies that guac_parser_read() correctly parses a large
+ * number of instructions containing large blobs and multibyte characters,
+ * reporting the throughput achieved. A child process is forked to write the
+ * instructions which are read and verified by the parent process.
+ */
+void test_parser__benchmark() {
+
+    int fd[2];
+
+    /* Create pipe */
+    CU_ASSERT_EQUAL_FATAL(pipe(fd), 0);
+
+    int read_fd = fd[0];
+    int write_fd = fd[1];
+
+    /* Fork into writer process (child) and reader process (parent) */
+    int childpid;
+    CU_ASSERT_NOT_EQUAL_FATAL((childpid = fork()), -1);
+
+    /* Write all instructions within the child process */
+    if (childpid == 0) {
+        close(read_fd);
+        write_instructions(write_fd);
+        exit(0);
+    }
+
+    /* Read and verify all instructions within the parent process */
+    close(write_fd);
+    read_instructions(read_fd);
+
+}
+
@@ -0,0 +1,284 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "recording-compress.h"
+#include "socket-async.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/recording.h>
+#include <guacamole/socket.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * The number of frames written to each test recording.
+ */
+#define TEST_FRAMES 100
+
+/**
+ * The frame after which the test recording is marked, such that the next
+ * member begins with a keyframe.
+ */
+#define TEST_MARK_FRAME 42
+
+/**
+ * The number of milliseconds between the frames of the test recording.
+ */
+#define TEST_FRAME_DURATION 1000
+
+/**
+ * A name containing characters that resemble instruction boundaries, along
+ * with multibyte UTF-8 characters, which must not confuse the scanner that
+ * locates "sync" instructions.
+ */
+#define TEST_NAME "4.sync,4.1234;\xe7\x8a\xac\xf0\x90\xac\x80;"
+
+/**
+ * The length of TEST_NAME in Unicode codepoints.
+ */
+#define TEST_NAME_LENGTH 17
+
+/**
+ * The maximum number of index entries read by the test.
+ */
+#define TEST_MAX_ENTRIES 64
+
+/**
+ * A single entry of a recording index.
+ */
+typedef struct index_entry {
+
+    /**
+     * The timestamp of the first frame within the member.
+     */
+    int64_t timestamp;
+
+    /**
+     * The offset of the member within the recording.
+     */
+    uint64_t offset;
+
+    /**
+     * The type of the member (GUAC_RECORDING_INDEX_KEYFRAME or
+     * GUAC_RECORDING_INDEX_FRAME).
+     */
+    char type;
+
+} index_entry;
+
+/**
+ * Reads the entire contents of the file having the given file descriptor,
+ * starting from the beginning of the file.
+ *
+ * @param fd
+ *     The file descriptor of the file to read.
+ *
+ * @param length
+ *     Pointer to a size_t which receives the number of bytes read.
+ *
+ * @return
+ *     A newly-allocated buffer containing the contents of the file, which
+ *     must be freed with guac_mem_free().
+ */
+static char* read_file(int fd, size_t* length) {
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    char* buffer = guac_mem_alloc(size + 1);
+
+    *length = pread(fd, buffer, size, 0);
+    buffer[*length] = '\0';
+    return buffer;
+
+}
+
+/**
+ * Decompresses the given series of gzip members.
+ *
+ * @param buffer
+ *     The compressed data.
+ *
+ * @param length
+ *     The number of bytes of compressed data.
+ *
+ * @param output
+ *     The buffer which should receive the decompressed data.
+ *
+ * @param output_length
+ *     The size of the output buffer, in bytes.
+ *
+ * @param single
+ *     Non-zero if decompression should stop at the end of the first member,
+ *     zero if all members should be decompressed.
+ *
+ * @return
+ *     The number of decompressed bytes, or -1 if the data is not valid.
+ */
+static ssize_t decompress(const char* buffer, size_t length,
+        char* output, size_t output_length, int single) {
+
+    z_stream stream = { 0 };
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+        return -1;
+
+    stream.next_in = (Bytef*) buffer;
+    stream.avail_in = length;
+    stream.next_out = (Bytef*) output;
+    stream.avail_out = output_length;
+
+    int result;
+    while ((result = inflate(&stream, Z_NO_FLUSH)) == Z_STREAM_END
+            && !single && stream.avail_in > 0)
+        inflateReset(&stream);
+
+    ssize_t decompressed = output_length - stream.avail_out;
+    inflateEnd(&stream);
+
+    return result == Z_STREAM_END ? decompressed : -1;
+
+}
+
+/**
+ * Verifies that a compressed recording is a valid series of gzip members
+ * which decompress to exactly the data written, that its index describes
+ * each member, and that each member can be decompressed independently
+ * beginning at the offset within its index entry.
+ */
+void test_recording__compress() {
+
+    char recording_path[] = "/tmp/guac-recording-XXXXXX";
+    char index_path[] = "/tmp/guac-recording-index-XXXXXX";
+
+    int fd = mkstemp(recording_path);
+    int index_fd = mkstemp(index_path);
+    CU_ASSERT_FATAL(fd != -1 && index_fd != -1);
+
+    /* Keep separate descriptors for reading back the written files */
+    int read_fd = open(recording_path, O_RDONLY);
+    int read_index_fd = open(index_path, O_RDONLY);
+    unlink(recording_path);
+    unlink(index_path);
+
+    guac_socket* socket = guac_recording_compress_open(fd, index_fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    for (int frame = 0; frame < TEST_FRAMES; frame++) {
+
+        guac_protocol_send_name(socket, TEST_NAME);
+        guac_protocol_send_sync(socket, 1000 + frame * TEST_FRAME_DURATION, 1);
+
+        if (frame == TEST_MARK_FRAME)
+            guac_socket_async_mark(socket);
+
+    }
+
+    guac_socket_free(socket);
+
+    /* Produce the expected uncompressed recording */
+    size_t expected_length = 0;
+    char* expected = guac_mem_alloc(TEST_FRAMES * 128);
+
+    for (int frame = 0; frame < TEST_FRAMES; frame++) {
+
+        char timestamp[32];
+        int timestamp_length = sprintf(timestamp, "%i",
+                1000 + frame * TEST_FRAME_DURATION);
+
+        expected_length += sprintf(expected + expected_length,
+                "4.name,%i.%s;4.sync,%i.%s,1.1;", TEST_NAME_LENGTH, TEST_NAME,
+                timestamp_length, timestamp);
+
+    }
+
+    size_t length;
+    char* recording = read_file(read_fd, &length);
+    char* decompressed = guac_mem_alloc(expected_length + 1);
+
+    CU_ASSERT_EQUAL(decompress(recording, length, decompressed,
+                expected_length + 1, 0), expected_length);
+    CU_ASSERT_NSTRING_EQUAL(decompressed, expected, expected_length);
+
+    /* Parse index */
+    size_t index_length;
+    char* index = read_file(read_index_fd, &index_length);
+
+    index_entry entries[TEST_MAX_ENTRIES];
+    int count = 0;
+    int consumed;
+    const char* current = index;
+
+    while (count < TEST_MAX_ENTRIES && sscanf(current, "%" SCNd64 " %" SCNu64 " %c%n",
+                &entries[count].timestamp, &entries[count].offset,
+                &entries[count].type, &consumed) == 3) {
+        current += consumed;
+        count++;
+    }
+
+    /* Each member covers at most GUAC_RECORDING_COMPRESS_MEMBER_DURATION,
+     * plus the additional member started by the mark */
+    CU_ASSERT(count >= TEST_FRAMES * TEST_FRAME_DURATION
+            / GUAC_RECORDING_COMPRESS_MEMBER_DURATION);
+
+    CU_ASSERT_EQUAL(entries[0].offset, 0);
+    CU_ASSERT_EQUAL(entries[0].timestamp, 1000);
+    CU_ASSERT_EQUAL(entries[0].type, GUAC_RECORDING_INDEX_KEYFRAME);
+
+    int keyframes = 0;
+    for (int i = 0; i < count; i++) {
+
+        if (entries[i].type == GUAC_RECORDING_INDEX_KEYFRAME) {
+            keyframes++;
+            if (i > 0)
+                CU_ASSERT_EQUAL(entries[i].timestamp,
+                        1000 + (TEST_MARK_FRAME + 1) * TEST_FRAME_DURATION);
+        }
+
+        if (i > 0)
+            CU_ASSERT(entries[i].offset > entries[i - 1].offset);
+
+        /* Each member must begin with the first instruction of a frame */
+        CU_ASSERT_FATAL(entries[i].offset < length);
+        ssize_t member_length = decompress(recording + entries[i].offset,
+                length - entries[i].offset, decompressed, expected_length + 1, 1);
+
+        CU_ASSERT(member_length > 0);
+        CU_ASSERT_NSTRING_EQUAL(decompressed, "4.name,", 7);
+
+    }
+
+    CU_ASSERT_EQUAL(keyframes, 2);
+
+    guac_mem_free(index);
+    guac_mem_free(decompressed);
+    guac_mem_free(recording);
+    guac_mem_free(expected);
+
+    close(read_fd);
+    close(read_index_fd);
+
+}
+
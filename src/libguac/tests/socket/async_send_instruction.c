@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "socket-async.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/mem.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The instruction written repeatedly by each test.
+ */
+#define TEST_INSTRUCTION "3.nop;"
+
+/**
+ * The number of instructions written by each test.
+ */
+#define TEST_INSTRUCTIONS 100000
+
+/**
+ * The contents of a pipe as read by read_pipe().
+ */
+typedef struct pipe_contents {
+
+    /**
+     * The file descriptor of the read end of the pipe.
+     */
+    int fd;
+
+    /**
+     * All data read from the pipe.
+     */
+    char* buffer;
+
+    /**
+     * The number of bytes read from the pipe.
+     */
+    size_t length;
+
+} pipe_contents;
+
+/**
+ * Reads from the pipe described by the given pipe_contents until the write
+ * end of that pipe is closed.
+ *
+ * @param arg
+ *     The pipe_contents describing the pipe to read from.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* read_pipe(void* arg) {
+
+    pipe_contents* contents = (pipe_contents*) arg;
+    size_t capacity = sizeof(TEST_INSTRUCTION) * TEST_INSTRUCTIONS;
+    contents->buffer = guac_mem_alloc(capacity);
+
+    ssize_t numread;
+    while (contents->length < capacity && (numread = read(contents->fd,
+                    contents->buffer + contents->length,
+                    capacity - contents->length)) > 0)
+        contents->length += numread;
+
+    close(contents->fd);
+    return NULL;
+
+}
+
+/**
+ * Verifies that the given data consists of nothing but complete copies of
+ * TEST_INSTRUCTION.
+ *
+ * @param contents
+ *     The data read from the pipe.
+ */
+static void verify_instructions(const pipe_contents* contents) {
+
+    size_t instruction_length = strlen(TEST_INSTRUCTION);
+    CU_ASSERT_EQUAL_FATAL(contents->length % instruction_length, 0);
+
+    for (size_t offset = 0; offset < contents->length; offset += instruction_length) {
+        if (memcmp(contents->buffer + offset, TEST_INSTRUCTION, instruction_length) != 0) {
+            CU_FAIL("Instruction corrupted");
+            break;
+        }
+    }
+
+}
+
+/**
+ * Tests that an asynchronous guac_socket which blocks when its queue is full
+ * writes every instruction, in order, even when its queue is far smaller
+ * than the data written.
+ */
+void test_socket__async_send_instruction_block() {
+
+    int fd[2];
+    CU_ASSERT_EQUAL_FATAL(pipe(fd), 0);
+
+    pipe_contents contents = { .fd = fd[0] };
+    pthread_t reader;
+    pthread_create(&reader, NULL, read_pipe, &contents);
+
+    guac_socket* socket = guac_socket_async_open(fd[1], 64,
+            GUAC_SOCKET_ASYNC_OVERFLOW_BLOCK, 0);
+
+    for (int i = 0; i < TEST_INSTRUCTIONS; i++)
+        guac_protocol_send_nop(socket);
+
+    guac_socket_async_stats stats;
+    guac_socket_async_get_stats(socket, &stats);
+    CU_ASSERT_EQUAL(stats.bytes_dropped, 0);
+    CU_ASSERT(stats.peak_queued <= 64);
+
+    /* Freeing the socket writes all remaining data and closes the pipe */
+    guac_socket_free(socket);
+    pthread_join(reader, NULL);
+
+    CU_ASSERT_EQUAL(contents.length, strlen(TEST_INSTRUCTION) * TEST_INSTRUCTIONS);
+    verify_instructions(&contents);
+
+    guac_mem_free(contents.buffer);
+
+}
+
+/**
+ * Tests that an asynchronous guac_socket which drops data when its queue is
+ * full drops only complete instructions, and accounts for every byte
+ * dropped.
+ */
+void test_socket__async_send_instruction_drop() {
+
+    int fd[2];
+    CU_ASSERT_EQUAL_FATAL(pipe(fd), 0);
+
+    guac_socket* socket = guac_socket_async_open(fd[1], 4096,
+            GUAC_SOCKET_ASYNC_OVERFLOW_DROP, 0);
+
+    /* Nothing reads from the pipe until all instructions have been written,
+     * thus the pipe and then the queue will fill */
+    for (int i = 0; i < TEST_INSTRUCTIONS; i++)
+        guac_protocol_send_nop(socket);
+
+    guac_socket_async_stats stats;
+    guac_socket_async_get_stats(socket, &stats);
+    CU_ASSERT(stats.bytes_dropped > 0);
+    CU_ASSERT_EQUAL(stats.bytes_delayed, 0);
+
+    pipe_contents contents = { .fd = fd[0] };
+    pthread_t reader;
+    pthread_create(&reader, NULL, read_pipe, &contents);
+
+    guac_socket_free(socket);
+    pthread_join(reader, NULL);
+
+    CU_ASSERT_EQUAL(contents.length + stats.bytes_dropped,
+            strlen(TEST_INSTRUCTION) * TEST_INSTRUCTIONS);
+    verify_instructions(&contents);
+
+    guac_mem_free(contents.buffer);
+
+}
+
@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "base64.h"
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
 #include "guacamole/object.h"
@@ -103,7 +104,8 @@ static int64_t __guac_parse_int(const char* str) {
 
 /* Guacamole instruction handlers */
 
-int __guac_handle_sync(guac_user* user, int argc, char** argv) {
+int __guac_handle_sync(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     int frame_duration;
 
@@ -162,7 +164,8 @@ int __guac_handle_sync(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_touch(guac_user* user, int argc, char** argv) {
+int __guac_handle_touch(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     if (user->touch_handler)
         return user->touch_handler(
             user,
@@ -177,7 +180,8 @@ int __guac_handle_touch(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_mouse(guac_user* user, int argc, char** argv) {
+int __guac_handle_mouse(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     if (user->mouse_handler)
         return user->mouse_handler(
             user,
@@ -188,7 +192,8 @@ int __guac_handle_mouse(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_key(guac_user* user, int argc, char** argv) {
+int __guac_handle_key(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     if (user->key_handler)
         return user->key_handler(
             user,
@@ -321,7 +326,8 @@ static guac_stream* __init_input_stream(guac_user* user, int stream_index) {
 
 }
 
-int __guac_handle_audio(guac_user* user, int argc, char** argv) {
+int __guac_handle_audio(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     /* Pull corresponding stream */
     int stream_index = atoi(argv[0]);
@@ -344,7 +350,8 @@ int __guac_handle_audio(guac_user* user, int argc, char** argv) {
 
 }
 
-int __guac_handle_clipboard(guac_user* user, int argc, char** argv) {
+int __guac_handle_clipboard(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     /* Pull corresponding stream */
     int stream_index = atoi(argv[0]);
@@ -367,7 +374,8 @@ int __guac_handle_clipboard(guac_user* user, int argc, char** argv) {
 
 }
 
-int __guac_handle_size(guac_user* user, int argc, char** argv) {
+int __guac_handle_size(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     if (user->size_handler)
         return user->size_handler(
             user,
@@ -377,7 +385,8 @@ int __guac_handle_size(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_file(guac_user* user, int argc, char** argv) {
+int __guac_handle_file(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     /* Pull corresponding stream */
     int stream_index = atoi(argv[0]);
@@ -400,7 +409,8 @@ int __guac_handle_file(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_pipe(guac_user* user, int argc, char** argv) {
+int __guac_handle_pipe(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     /* Pull corresponding stream */
     int stream_index = atoi(argv[0]);
@@ -423,7 +433,8 @@ int __guac_handle_pipe(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_argv(guac_user* user, int argc, char** argv) {
+int __guac_handle_argv(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     /* Pull corresponding stream */
     int stream_index = atoi(argv[0]);
@@ -447,7 +458,8 @@ int __guac_handle_argv(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_ack(guac_user* user, int argc, char** argv) {
+int __guac_handle_ack(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     guac_stream* stream;
 
@@ -484,7 +496,33 @@ int __guac_handle_ack(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_blob(guac_user* user, int argc, char** argv) {
+/**
+ * Decodes the base64 data of a received "blob" instruction in-place, using
+ * the size of that data as already determined by the parser, if known.
+ *
+ * @param argv
+ *     The arguments of the "blob" instruction, where the second argument is
+ *     the base64 data to decode.
+ *
+ * @param argv_sizes
+ *     The size of each argument in argv, in bytes, or NULL if the sizes of
+ *     the arguments are not known.
+ *
+ * @return
+ *     The number of bytes resulting from decoding the blob data.
+ */
+static int __guac_decode_blob(char** argv, const int* argv_sizes) {
+
+    /* Fall back to measuring the data only if the parser was bypassed */
+    if (argv_sizes == NULL)
+        return guac_protocol_decode_base64(argv[1]);
+
+    return guac_base64_decode_length(argv[1], argv_sizes[1]);
+
+}
+
+int __guac_handle_blob(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     int stream_index = atoi(argv[0]);
     guac_stream* stream = __get_open_input_stream(user, stream_index);
@@ -495,14 +533,14 @@ int __guac_handle_blob(guac_user* user, int argc, char** argv) {
 
     /* Call stream handler if defined */
     if (stream->blob_handler) {
-        int length = guac_protocol_decode_base64(argv[1]);
+        int length = __guac_decode_blob(argv, argv_sizes);
         return stream->blob_handler(user, stream, argv[1],
             length);
     }
 
     /* Fall back to global handler if defined */
     if (user->blob_handler) {
-        int length = guac_protocol_decode_base64(argv[1]);
+        int length = __guac_decode_blob(argv, argv_sizes);
         return user->blob_handler(user, stream, argv[1],
             length);
     }
@@ -512,7 +550,8 @@ int __guac_handle_blob(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_end(guac_user* user, int argc, char** argv) {
+int __guac_handle_end(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     int result = 0;
     int stream_index = atoi(argv[0]);
@@ -535,7 +574,8 @@ int __guac_handle_end(guac_user* user, int argc, char** argv) {
     return result;
 }
 
-int __guac_handle_get(guac_user* user, int argc, char** argv) {
+int __guac_handle_get(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     guac_object* object;
 
@@ -569,7 +609,8 @@ int __guac_handle_get(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_put(guac_user* user, int argc, char** argv) {
+int __guac_handle_put(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     guac_object* object;
 
@@ -616,20 +657,23 @@ int __guac_handle_put(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
-int __guac_handle_nop(guac_user* user, int argc, char** argv) {
+int __guac_handle_nop(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     guac_user_log(user, GUAC_LOG_TRACE,
             "Received nop instruction");
     return 0;
 }
 
-int __guac_handle_disconnect(guac_user* user, int argc, char** argv) {
+int __guac_handle_disconnect(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     guac_user_stop(user);
     return 0;
 }
 
 /* Guacamole handshake handler functions. */
 
-int __guac_handshake_size_handler(guac_user* user, int argc, char** argv) {
+int __guac_handshake_size_handler(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     
     /* Validate size of instruction. */
     if (argc < 2) {
@@ -654,7 +698,8 @@ int __guac_handshake_size_handler(guac_user* user, int argc, char** argv) {
     
 }
 
-int __guac_handshake_audio_handler(guac_user* user, int argc, char** argv) {
+int __guac_handshake_audio_handler(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     guac_free_mimetypes((char **) user->info.audio_mimetypes);
     
@@ -665,7 +710,8 @@ int __guac_handshake_audio_handler(guac_user* user, int argc, char** argv) {
     
 }
 
-int __guac_handshake_video_handler(guac_user* user, int argc, char** argv) {
+int __guac_handshake_video_handler(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     guac_free_mimetypes((char **) user->info.video_mimetypes);
     
@@ -676,7 +722,8 @@ int __guac_handshake_video_handler(guac_user* user, int argc, char** argv) {
     
 }
 
-int __guac_handshake_image_handler(guac_user* user, int argc, char** argv) {
+int __guac_handshake_image_handler(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     
     guac_free_mimetypes((char **) user->info.image_mimetypes);
     
@@ -687,7 +734,8 @@ int __guac_handshake_image_handler(guac_user* user, int argc, char** argv) {
     
 }
 
-int __guac_handshake_name_handler(guac_user* user, int argc, char** argv) {
+int __guac_handshake_name_handler(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
 
     /* Free any past value for the user's name */
     guac_mem_free_const(user->info.name);
@@ -704,7 +752,8 @@ int __guac_handshake_name_handler(guac_user* user, int argc, char** argv) {
 
 }
 
-int __guac_handshake_timezone_handler(guac_user* user, int argc, char** argv) {
+int __guac_handshake_timezone_handler(guac_user* user, int argc, char** argv,
+        const int* argv_sizes) {
     
     /* Free any past value */
     guac_mem_free_const(user->info.timezone);
@@ -758,7 +807,8 @@ void guac_free_mimetypes(char** mimetypes) {
 }
 
 int __guac_user_call_opcode_handler(__guac_instruction_handler_mapping* map,
-        guac_user* user, const char* opcode, int argc, char** argv) {
+        guac_user* user, const char* opcode, int argc, char** argv,
+        const int* argv_sizes) {
 
     /* For each defined instruction */
     __guac_instruction_handler_mapping* current = map;
@@ -766,7 +816,7 @@ int __guac_user_call_opcode_handler(__guac_instruction_handler_mapping* map,
 
         /* If recognized, call handler */
         if (strcmp(opcode, current->opcode) == 0)
-            return current->handler(user, argc, argv);
+            return current->handler(user, argc, argv, argv_sizes);
 
         current++;
     }
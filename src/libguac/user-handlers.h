@@ -48,10 +48,16 @@
  * @param argv
  *     The arguments included with the instruction, excluding the opcode.
  *
+ * @param argv_sizes
+ *     The size of each argument in argv, in bytes, excluding the null
+ *     terminator, as determined by the guac_parser that parsed the
+ *     instruction, or NULL if these sizes are not known.
+ *
  * @return
  *     Zero if the instruction was successfully handled, non-zero otherwise.
  */
-typedef int __guac_instruction_handler(guac_user* user, int argc, char** argv);
+typedef int __guac_instruction_handler(guac_user* user, int argc, char** argv,
+        const int* argv_sizes);
 
 /**
  * Structure mapping an instruction opcode to an instruction handler.
@@ -302,10 +308,15 @@ char** guac_copy_mimetypes(char** mimetypes, int count);
  * @param argv
  *     An array of all arguments which are part of the instruction.
  *
+ * @param argv_sizes
+ *     The size of each argument in argv, in bytes, excluding the null
+ *     terminator, or NULL if these sizes are not known.
+ *
  * @return
  *     Zero if the instruction was handled successfully, or non-zero otherwise.
  */
 int __guac_user_call_opcode_handler(__guac_instruction_handler_mapping* map,
-        guac_user* user, const char* opcode, int argc, char** argv);
+        guac_user* user, const char* opcode, int argc, char** argv,
+        const int* argv_sizes);
 
 #endif
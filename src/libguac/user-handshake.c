@@ -26,6 +26,7 @@
 #include "guacamole/protocol.h"
 #include "guacamole/socket.h"
 #include "guacamole/user.h"
+#include "socket-broadcast.h"
 #include "user-handlers.h"
 
 #include <pthread.h>
@@ -164,7 +165,8 @@ static void* guac_user_input_thread(void* data) {
 
         /* Call handler, stop on error */
         if (__guac_user_call_opcode_handler(__guac_instruction_handler_map, 
-                user, parser->opcode, parser->argc, parser->argv)) {
+                user, parser->opcode, parser->argc, parser->argv,
+                parser->argv_sizes)) {
 
             /* Log error */
             guac_user_log_guac_error(user, GUAC_LOG_WARNING,
@@ -268,7 +270,8 @@ static int __guac_user_handshake(guac_user* user, guac_parser* parser,
         
         /* Run instruction handler for opcode with arguments. */
         if (__guac_user_call_opcode_handler(__guac_handshake_handler_map, user,
-                parser->opcode, parser->argc, parser->argv)) {
+                parser->opcode, parser->argc, parser->argv,
+                parser->argv_sizes)) {
             
             guac_user_log_handshake_failure(user);
             guac_user_log_guac_error(user, GUAC_LOG_DEBUG,
@@ -362,6 +365,7 @@ int guac_user_handle_connection(guac_user* user, int usec_timeout) {
 
         /* Remove/free user */
         guac_client_remove_user(client, user);
+        guac_socket_broadcast_queue_free(user);
         guac_client_log(client, GUAC_LOG_INFO, "User \"%s\" disconnected (%i "
                 "users remain)", user->user_id, client->connected_users);
 
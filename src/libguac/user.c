@@ -33,6 +33,7 @@
 #include "guacamole/timestamp.h"
 #include "guacamole/user.h"
 #include "id.h"
+#include "socket-broadcast.h"
 #include "user-handlers.h"
 
 #include <errno.h>
@@ -83,6 +84,9 @@ guac_user* guac_user_alloc() {
 
 void guac_user_free(guac_user* user) {
 
+    /* Free broadcast queue, if not already freed after the user left */
+    guac_socket_broadcast_queue_free(user);
+
     /* Free streams */
     guac_mem_free(user->__input_streams);
     guac_mem_free(user->__output_streams);
@@ -169,8 +173,9 @@ void guac_user_free_object(guac_user* user, guac_object* object) {
 
 int guac_user_handle_instruction(guac_user* user, const char* opcode, int argc, char** argv) {
 
+    /* Argument sizes are unknown for instructions not read by a parser */
     return __guac_user_call_opcode_handler(__guac_instruction_handler_map,
-            user, opcode, argc, argv);
+            user, opcode, argc, argv, NULL);
 
 }
 
@@ -107,6 +107,32 @@ static int guac_kubernetes_join_pending_handler(guac_client* client) {
 
 }
 
+/**
+ * A resync handler implementation that will restore the terminal display of
+ * all users that fell too far behind to receive broadcast data.
+ *
+ * @param client
+ *     The client whose lagging users are being resynchronized.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_kubernetes_resync_handler(guac_client* client) {
+
+    guac_kubernetes_client* kubernetes_client =
+        (guac_kubernetes_client*) client->data;
+
+    /* Synchronize the terminal display to all lagging users */
+    if (kubernetes_client->term != NULL) {
+        guac_socket* broadcast_socket = client->pending_socket;
+        guac_terminal_sync_users(kubernetes_client->term, client, broadcast_socket);
+        guac_socket_flush(broadcast_socket);
+    }
+
+    return 0;
+
+}
+
 int guac_client_init(guac_client* client) {
 
     /* Ensure reference to main guac_client remains available in all
@@ -127,6 +153,7 @@ int guac_client_init(guac_client* client) {
     /* Set handlers */
     client->join_handler = guac_kubernetes_user_join_handler;
     client->join_pending_handler = guac_kubernetes_join_pending_handler;
+    client->resync_handler = guac_kubernetes_resync_handler;
     client->free_handler = guac_kubernetes_client_free_handler;
     client->leave_handler = guac_kubernetes_user_leave_handler;
 
@@ -230,7 +230,7 @@ void* guac_kubernetes_client_thread(void* data) {
 
     /* Set up screen recording, if requested */
     if (settings->recording_path != NULL) {
-        kubernetes_client->recording = guac_recording_create(client,
+        kubernetes_client->recording = guac_recording_create_ex(client,
                 settings->recording_path,
                 settings->recording_name,
                 settings->create_recording_path,
@@ -238,7 +238,8 @@ void* guac_kubernetes_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compress);
     }
 
     /* Create terminal options with required parameters */
@@ -253,6 +254,7 @@ void* guac_kubernetes_client_thread(void* data) {
     options->font_size = settings->font_size;
     options->color_scheme = settings->color_scheme;
     options->backspace = settings->backspace;
+    options->recording = kubernetes_client->recording;
 
     /* Create terminal */
     kubernetes_client->term = guac_terminal_create(client, options);
@@ -27,10 +27,306 @@
 #include <freerdp/gdi/gfx.h>
 #include <freerdp/event.h>
 #include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <guacamole/mem.h>
+#include <guacamole/rect.h>
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Returns the guac_rdp_client associated with the given RdpgfxClientContext.
+ * The RdpgfxClientContext must have been initialized for GDI-backed rendering
+ * via gdi_graphics_pipeline_init().
+ *
+ * @param context
+ *     The RdpgfxClientContext of the RDPGFX channel.
+ *
+ * @return
+ *     The guac_rdp_client associated with the given RdpgfxClientContext.
+ */
+static guac_rdp_client* guac_rdp_rdpgfx_get_rdp_client(
+        RdpgfxClientContext* context) {
+
+    rdpGdi* gdi = (rdpGdi*) context->custom;
+    guac_client* client = ((rdp_freerdp_context*) gdi->context)->client;
+    return (guac_rdp_client*) client->data;
+
+}
+
+/**
+ * Translates the given rectangle within the RDPGFX surface having the given
+ * ID into the corresponding rectangle within the default layer of the
+ * guac_display. Translation is possible only if the surface is mapped
+ * directly (without scaling) to the output.
+ *
+ * @param context
+ *     The RdpgfxClientContext of the RDPGFX channel.
+ *
+ * @param surface_id
+ *     The ID of the RDPGFX surface containing the rectangle.
+ *
+ * @param left
+ *     The X coordinate of the left edge of the rectangle within the surface.
+ *
+ * @param top
+ *     The Y coordinate of the upper edge of the rectangle within the surface.
+ *
+ * @param right
+ *     The X coordinate of the right edge of the rectangle within the surface,
+ *     exclusive.
+ *
+ * @param bottom
+ *     The Y coordinate of the lower edge of the rectangle within the surface,
+ *     exclusive.
+ *
+ * @param rect
+ *     The guac_rect to populate with the translated rectangle. The rectangle
+ *     is constrained to the bounds of the surface.
+ *
+ * @return
+ *     Non-zero if the rectangle was translated successfully and is not
+ *     empty, zero if the rectangle has no corresponding non-empty rectangle
+ *     within the default layer.
+ */
+static int guac_rdp_rdpgfx_translate_rect(RdpgfxClientContext* context,
+        UINT16 surface_id, int left, int top, int right, int bottom,
+        guac_rect* rect) {
+
+    gdiGfxSurface* surface = (gdiGfxSurface*) context->GetSurfaceData(context, surface_id);
+    if (surface == NULL || !surface->outputMapped)
+        return 0;
+
+    /* Scaled output cannot be represented as a simple rect or copy */
+    if (surface->outputTargetWidth != surface->mappedWidth
+            || surface->outputTargetHeight != surface->mappedHeight)
+        return 0;
+
+    guac_rect bounds = {
+        .left   = 0,
+        .top    = 0,
+        .right  = surface->width,
+        .bottom = surface->height
+    };
+
+    *rect = (guac_rect) {
+        .left   = left,
+        .top    = top,
+        .right  = right,
+        .bottom = bottom
+    };
+
+    guac_rect_constrain(rect, &bounds);
+    if (guac_rect_is_empty(rect))
+        return 0;
+
+    rect->left   += surface->outputOriginX;
+    rect->top    += surface->outputOriginY;
+    rect->right  += surface->outputOriginX;
+    rect->bottom += surface->outputOriginY;
+    return 1;
+
+}
+
+/**
+ * Handler for the RDPGFX SolidFill PDU which renders the fill using FreeRDP's
+ * GDI and then hints each filled rectangle to the guac_display.
+ *
+ * @param context
+ *     The RdpgfxClientContext of the RDPGFX channel.
+ *
+ * @param solid_fill
+ *     The received SolidFill PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK (zero) if the PDU was handled successfully, an error code
+ *     (non-zero) otherwise.
+ */
+static UINT guac_rdp_rdpgfx_solid_fill(RdpgfxClientContext* context,
+        const RDPGFX_SOLID_FILL_PDU* solid_fill) {
+
+    guac_rdp_client* rdp_client = guac_rdp_rdpgfx_get_rdp_client(context);
+
+    UINT status = rdp_client->rdpgfx->solid_fill(context, solid_fill);
+    if (status != CHANNEL_RC_OK || rdp_client->display == NULL)
+        return status;
+
+    guac_display_layer* default_layer = guac_display_default_layer(rdp_client->display);
+
+    /* Rendered data is XRGB32, matching the format used by guac_display */
+    uint32_t color = (solid_fill->fillPixel.R << 16)
+                   | (solid_fill->fillPixel.G << 8)
+                   |  solid_fill->fillPixel.B;
+
+    for (int i = 0; i < solid_fill->fillRectCount; i++) {
+
+        const RECT16* fill_rect = &solid_fill->fillRects[i];
+
+        guac_rect dst;
+        if (guac_rdp_rdpgfx_translate_rect(context, solid_fill->surfaceId,
+                    fill_rect->left, fill_rect->top,
+                    fill_rect->right, fill_rect->bottom, &dst))
+            guac_display_layer_hint_fill(default_layer, &dst, color);
+
+    }
+
+    return status;
+
+}
+
+/**
+ * Handler for the RDPGFX SurfaceToSurface PDU which renders the copy using
+ * FreeRDP's GDI and then hints each copy to the guac_display.
+ *
+ * @param context
+ *     The RdpgfxClientContext of the RDPGFX channel.
+ *
+ * @param surface_to_surface
+ *     The received SurfaceToSurface PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK (zero) if the PDU was handled successfully, an error code
+ *     (non-zero) otherwise.
+ */
+static UINT guac_rdp_rdpgfx_surface_to_surface(RdpgfxClientContext* context,
+        const RDPGFX_SURFACE_TO_SURFACE_PDU* surface_to_surface) {
+
+    guac_rdp_client* rdp_client = guac_rdp_rdpgfx_get_rdp_client(context);
+
+    UINT status = rdp_client->rdpgfx->surface_to_surface(context, surface_to_surface);
+    if (status != CHANNEL_RC_OK || rdp_client->display == NULL)
+        return status;
+
+    const RECT16* rect_src = &surface_to_surface->rectSrc;
+
+    guac_rect src;
+    if (!guac_rdp_rdpgfx_translate_rect(context, surface_to_surface->surfaceIdSrc,
+                rect_src->left, rect_src->top, rect_src->right, rect_src->bottom,
+                &src))
+        return status;
+
+    guac_display_layer* default_layer = guac_display_default_layer(rdp_client->display);
+
+    int width = rect_src->right - rect_src->left;
+    int height = rect_src->bottom - rect_src->top;
+
+    for (int i = 0; i < surface_to_surface->destPtsCount; i++) {
+
+        const RDPGFX_POINT16* dest_pt = &surface_to_surface->destPts[i];
+
+        /* Hint only copies that are entirely visible within the output (as
+         * any part of the source that was not visible was dropped during
+         * translation above) */
+        guac_rect dst;
+        if (guac_rdp_rdpgfx_translate_rect(context, surface_to_surface->surfaceIdDest,
+                    dest_pt->x, dest_pt->y, dest_pt->x + width, dest_pt->y + height,
+                    &dst)
+                && guac_rect_width(&dst) == guac_rect_width(&src)
+                && guac_rect_height(&dst) == guac_rect_height(&src))
+            guac_display_layer_hint_copy(default_layer, &src, dst.left, dst.top);
+
+    }
+
+    return status;
+
+}
+
+/**
+ * Handler for the RDPGFX SurfaceToCache PDU which stores the relevant surface
+ * contents using FreeRDP's GDI and then records the region of the default
+ * layer that those contents were copied from, if any.
+ *
+ * @param context
+ *     The RdpgfxClientContext of the RDPGFX channel.
+ *
+ * @param surface_to_cache
+ *     The received SurfaceToCache PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK (zero) if the PDU was handled successfully, an error code
+ *     (non-zero) otherwise.
+ */
+static UINT guac_rdp_rdpgfx_surface_to_cache(RdpgfxClientContext* context,
+        const RDPGFX_SURFACE_TO_CACHE_PDU* surface_to_cache) {
+
+    guac_rdp_client* rdp_client = guac_rdp_rdpgfx_get_rdp_client(context);
+    guac_rdp_rdpgfx* rdpgfx = rdp_client->rdpgfx;
+
+    UINT status = rdpgfx->surface_to_cache(context, surface_to_cache);
+    if (status != CHANNEL_RC_OK)
+        return status;
+
+    UINT16 slot = surface_to_cache->cacheSlot;
+    if (slot < 1 || slot > GUAC_RDP_RDPGFX_MAX_CACHE_SLOTS)
+        return status;
+
+    /* Cache only the location of fully-visible contents, as partially-visible
+     * contents cannot later be hinted as a copy */
+    const RECT16* rect_src = &surface_to_cache->rectSrc;
+    guac_rect* cached = &rdpgfx->cache_slots[slot];
+    if (!guac_rdp_rdpgfx_translate_rect(context, surface_to_cache->surfaceId,
+                rect_src->left, rect_src->top, rect_src->right, rect_src->bottom,
+                cached)
+            || guac_rect_width(cached) != rect_src->right - rect_src->left
+            || guac_rect_height(cached) != rect_src->bottom - rect_src->top)
+        guac_rect_init(cached, 0, 0, 0, 0);
+
+    return status;
+
+}
+
+/**
+ * Handler for the RDPGFX CacheToSurface PDU which renders the cached contents
+ * using FreeRDP's GDI and then hints the guac_display that those contents
+ * were copied from the region of the default layer that they were originally
+ * cached from, if known.
+ *
+ * @param context
+ *     The RdpgfxClientContext of the RDPGFX channel.
+ *
+ * @param cache_to_surface
+ *     The received CacheToSurface PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK (zero) if the PDU was handled successfully, an error code
+ *     (non-zero) otherwise.
+ */
+static UINT guac_rdp_rdpgfx_cache_to_surface(RdpgfxClientContext* context,
+        const RDPGFX_CACHE_TO_SURFACE_PDU* cache_to_surface) {
+
+    guac_rdp_client* rdp_client = guac_rdp_rdpgfx_get_rdp_client(context);
+    guac_rdp_rdpgfx* rdpgfx = rdp_client->rdpgfx;
+
+    UINT status = rdpgfx->cache_to_surface(context, cache_to_surface);
+    if (status != CHANNEL_RC_OK || rdp_client->display == NULL)
+        return status;
+
+    UINT16 slot = cache_to_surface->cacheSlot;
+    if (slot < 1 || slot > GUAC_RDP_RDPGFX_MAX_CACHE_SLOTS)
+        return status;
+
+    const guac_rect* src = &rdpgfx->cache_slots[slot];
+    if (guac_rect_is_empty(src))
+        return status;
+
+    const RDPGFX_POINT16* dest_pt = &cache_to_surface->destPt;
+    int width = guac_rect_width(src);
+    int height = guac_rect_height(src);
+
+    guac_rect dst;
+    if (guac_rdp_rdpgfx_translate_rect(context, cache_to_surface->surfaceId,
+                dest_pt->x, dest_pt->y, dest_pt->x + width, dest_pt->y + height,
+                &dst)
+            && guac_rect_width(&dst) == width
+            && guac_rect_height(&dst) == height)
+        guac_display_layer_hint_copy(guac_display_default_layer(rdp_client->display),
+                src, dst.left, dst.top);
+
+    return status;
+
+}
+
 /**
  * Callback which associates handlers specific to Guacamole with the
  * RdpgfxClientContext instance allocated by FreeRDP to deal with received
@@ -65,10 +361,29 @@ static void guac_rdp_rdpgfx_channel_connected(rdpContext* context,
     if (!gdi_graphics_pipeline_init(gdi, rdpgfx))
         guac_client_log(client, GUAC_LOG_WARNING, "Rendering backend for RDPGFX "
                 "channel could not be loaded. Graphics may not render at all!");
-    else
+    else {
+
+        guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+
+        /* Translate surface commands into display hints, retaining the GDI
+         * handlers for actual rendering */
+        guac_mem_free(rdp_client->rdpgfx);
+        rdp_client->rdpgfx = guac_mem_zalloc(sizeof(guac_rdp_rdpgfx));
+        rdp_client->rdpgfx->solid_fill = rdpgfx->SolidFill;
+        rdp_client->rdpgfx->surface_to_surface = rdpgfx->SurfaceToSurface;
+        rdp_client->rdpgfx->surface_to_cache = rdpgfx->SurfaceToCache;
+        rdp_client->rdpgfx->cache_to_surface = rdpgfx->CacheToSurface;
+
+        rdpgfx->SolidFill = guac_rdp_rdpgfx_solid_fill;
+        rdpgfx->SurfaceToSurface = guac_rdp_rdpgfx_surface_to_surface;
+        rdpgfx->SurfaceToCache = guac_rdp_rdpgfx_surface_to_cache;
+        rdpgfx->CacheToSurface = guac_rdp_rdpgfx_cache_to_surface;
+
         guac_client_log(client, GUAC_LOG_DEBUG, "RDPGFX channel will be used for "
                 "the RDP Graphics Pipeline Extension.");
 
+    }
+
 }
 
 /**
@@ -101,6 +416,9 @@ static void guac_rdp_rdpgfx_channel_disconnected(rdpContext* context,
     rdpGdi* gdi = context->gdi;
     gdi_graphics_pipeline_uninit(gdi, rdpgfx);
 
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_mem_free(rdp_client->rdpgfx);
+
     guac_client_log(client, GUAC_LOG_DEBUG, "RDPGFX channel support unloaded.");
 
 }
@@ -25,6 +25,59 @@
 #include <freerdp/client/rdpgfx.h>
 #include <freerdp/freerdp.h>
 #include <guacamole/client.h>
+#include <guacamole/rect.h>
+
+/**
+ * The maximum number of cache slots that may be used by an RDP server via the
+ * Graphics Pipeline Extension.
+ */
+#define GUAC_RDP_RDPGFX_MAX_CACHE_SLOTS 25600
+
+/**
+ * Guacamole-specific state of the RDPGFX channel. Surface commands received
+ * along the channel are rendered by FreeRDP's GDI as usual, but are
+ * additionally translated into hints for the guac_display, such that solid
+ * fills and copies already described by the RDP server need not be
+ * rediscovered by hashing and searching the rendered image data.
+ */
+typedef struct guac_rdp_rdpgfx {
+
+    /**
+     * The SolidFill handler installed by FreeRDP's GDI, which is invoked to
+     * render each SolidFill command.
+     */
+    pcRdpgfxSolidFill solid_fill;
+
+    /**
+     * The SurfaceToSurface handler installed by FreeRDP's GDI, which is
+     * invoked to render each SurfaceToSurface command.
+     */
+    pcRdpgfxSurfaceToSurface surface_to_surface;
+
+    /**
+     * The SurfaceToCache handler installed by FreeRDP's GDI, which is invoked
+     * to render each SurfaceToCache command.
+     */
+    pcRdpgfxSurfaceToCache surface_to_cache;
+
+    /**
+     * The CacheToSurface handler installed by FreeRDP's GDI, which is invoked
+     * to render each CacheToSurface command.
+     */
+    pcRdpgfxCacheToSurface cache_to_surface;
+
+    /**
+     * For each cache slot, the region of the default layer that was the
+     * source of the slot's current contents, or an empty rect if that region
+     * is unknown (the slot was populated from a surface not directly mapped
+     * to the output). Cached contents are not mirrored to Guacamole buffers;
+     * drawing a cache slot is instead hinted as a copy from this region of the
+     * previous frame, which is verified before use. Cached contents which are
+     * no longer visible remain available via the image cache of guac_display.
+     */
+    guac_rect cache_slots[GUAC_RDP_RDPGFX_MAX_CACHE_SLOTS + 1];
+
+} guac_rdp_rdpgfx;
 
 /**
  * Adds FreeRDP's "rdpgfx" plugin to the list of dynamic virtual channel plugins
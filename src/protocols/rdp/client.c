@@ -143,6 +143,36 @@ static int guac_rdp_join_pending_handler(guac_client* client) {
 
 }
 
+/**
+ * A resync handler implementation that will restore the display of all users
+ * that fell too far behind to receive broadcast data. Audio streams and pipes
+ * already announced to those users remain open and are NOT announced again.
+ *
+ * @param client
+ *     The client whose lagging users are being resynchronized.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_rdp_resync_handler(guac_client* client) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_socket* broadcast_socket = client->pending_socket;
+
+    guac_rwlock_acquire_read_lock(&(rdp_client->lock));
+
+    /* Synchronize with current display */
+    if (rdp_client->display != NULL) {
+        guac_display_dup(rdp_client->display, broadcast_socket);
+        guac_socket_flush(broadcast_socket);
+    }
+
+    guac_rwlock_release_lock(&(rdp_client->lock));
+
+    return 0;
+
+}
+
 int guac_client_init(guac_client* client, int argc, char** argv) {
 
     /* Automatically set HOME environment variable if unset (FreeRDP's
@@ -213,6 +243,11 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
 
     rdp_client->input_event_queued = CreateEvent(NULL, TRUE, FALSE, NULL);
 
+    /* Collapse runs of queued mouse motion as input events are processed */
+    rdp_client->input_coalescer = guac_common_input_coalescer_alloc(
+            sizeof(guac_rdp_input_event), guac_rdp_handle_input_event,
+            rdp_client);
+
     /* Init display update module */
     rdp_client->disp = guac_rdp_disp_alloc(client);
 
@@ -237,6 +272,7 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
     /* Set handlers */
     client->join_handler = guac_rdp_user_join_handler;
     client->join_pending_handler = guac_rdp_join_pending_handler;
+    client->resync_handler = guac_rdp_resync_handler;
     client->free_handler = guac_rdp_client_free_handler;
     client->leave_handler = guac_rdp_user_leave_handler;
 
@@ -266,6 +302,7 @@ int guac_rdp_client_free_handler(guac_client* client) {
     /* Clean up event queue and associated signalling handle */
     guac_fifo_destroy(&rdp_client->input_events);
     CloseHandle(rdp_client->input_event_queued);
+    guac_common_input_coalescer_free(rdp_client->input_coalescer);
 
     /* Free parsed settings */
     if (rdp_client->settings != NULL)
@@ -323,6 +360,9 @@ int guac_rdp_client_free_handler(guac_client* client) {
     if (rdp_client->audio_input != NULL)
         guac_rdp_audio_buffer_free(rdp_client->audio_input);
 
+    /* Clean up RDPGFX state, if the channel was never disconnected */
+    guac_mem_free(rdp_client->rdpgfx);
+
     guac_rwlock_destroy(&(rdp_client->lock));
     pthread_mutex_destroy(&(rdp_client->message_lock));
 
@@ -56,30 +56,39 @@ int guac_rdp_download_ack_handler(guac_user* user, guac_stream* stream,
     /* If successful, read data */
     if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
 
-        /* Attempt read into buffer */
-        char buffer[4096];
-        int bytes_read = guac_rdp_fs_read(fs,
-                download_status->file_id,
-                download_status->offset, buffer, sizeof(buffer));
-
-        /* If bytes read, send as blob */
-        if (bytes_read > 0) {
-            download_status->offset += bytes_read;
-            guac_protocol_send_blob(user->socket, stream,
-                    buffer, bytes_read);
-        }
+        guac_common_download_window* window = &download_status->window;
+        guac_common_download_window_ack(window);
+
+        /* Send as many blobs as the download window allows */
+        int available;
+        while ((available = guac_common_download_window_available(window,
+                        sizeof(download_status->buffer))) > 0) {
+
+            int bytes_read = guac_rdp_fs_read(fs,
+                    download_status->file_id, download_status->offset,
+                    download_status->buffer, available);
+
+            /* Stop at EOF or error, waiting for any blobs already sent to
+             * be acknowledged in either case */
+            if (bytes_read < 0) {
+                guac_user_log(user, GUAC_LOG_ERROR,
+                        "Error reading file for download");
+                guac_common_download_window_fail(window);
+                break;
+            }
+
+            if (bytes_read > 0) {
+                download_status->offset += bytes_read;
+                guac_protocol_send_blobs(user->socket, stream,
+                        download_status->buffer, bytes_read);
+            }
+
+            guac_common_download_window_sent(window, bytes_read);
 
-        /* If EOF, send end */
-        else if (bytes_read == 0) {
-            guac_protocol_send_end(user->socket, stream);
-            guac_user_free_stream(user, stream);
-            guac_mem_free(download_status);
         }
 
-        /* Otherwise, fail stream */
-        else {
-            guac_user_log(user, GUAC_LOG_ERROR,
-                    "Error reading file for download");
+        /* End stream only after all data has been acknowledged */
+        if (guac_common_download_window_complete(window)) {
             guac_protocol_send_end(user->socket, stream);
             guac_user_free_stream(user, stream);
             guac_mem_free(download_status);
@@ -157,6 +166,8 @@ int guac_rdp_download_get_handler(guac_user* user, guac_object* object,
         guac_rdp_download_status* download_status = guac_mem_alloc(sizeof(guac_rdp_download_status));
         download_status->file_id = file_id;
         download_status->offset = 0;
+        guac_common_download_window_init(&download_status->window,
+                GUAC_COMMON_DOWNLOAD_DEFAULT_WINDOW);
 
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
@@ -215,6 +226,8 @@ void* guac_rdp_download_to_user(guac_user* user, void* data) {
         stream->ack_handler = guac_rdp_download_ack_handler;
         download_status->file_id = file_id;
         download_status->offset = 0;
+        guac_common_download_window_init(&download_status->window,
+                GUAC_COMMON_DOWNLOAD_DEFAULT_WINDOW);
 
         guac_user_log(user, GUAC_LOG_DEBUG, "%s: Initiating download "
                 "of \"%s\"", __func__, path);
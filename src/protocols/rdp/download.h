@@ -20,6 +20,7 @@
 #ifndef GUAC_RDP_DOWNLOAD_H
 #define GUAC_RDP_DOWNLOAD_H
 
+#include "common/download.h"
 #include "common/json.h"
 
 #include <guacamole/protocol.h>
@@ -43,6 +44,17 @@ typedef struct guac_rdp_download_status {
      */
     uint64_t offset;
 
+    /**
+     * The blobs of the download that have been sent but not yet
+     * acknowledged.
+     */
+    guac_common_download_window window;
+
+    /**
+     * Buffer receiving file data read from the filesystem.
+     */
+    char buffer[GUAC_COMMON_DOWNLOAD_BUFFER_SIZE];
+
 } guac_rdp_download_status;
 
 /**
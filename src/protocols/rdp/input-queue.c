@@ -19,6 +19,7 @@
 
 #include "channels/disp.h"
 #include "channels/rdpei.h"
+#include "common/input_coalescer.h"
 #include "input.h"
 #include "guacamole/display.h"
 #include "keyboard.h"
@@ -250,32 +251,57 @@ void guac_rdp_input_event_enqueue(guac_rdp_client* rdp_client,
 
 }
 
+void guac_rdp_handle_input_event(const void* event, void* data) {
+
+    const guac_rdp_input_event* input_event =
+        (const guac_rdp_input_event*) event;
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) data;
+
+    switch (input_event->type) {
+
+        /* Mouse event */
+        case GUAC_RDP_INPUT_EVENT_MOUSE:
+            guac_rdp_handle_mouse_event(rdp_client, input_event);
+            break;
+
+        /* Keyboard event */
+        case GUAC_RDP_INPUT_EVENT_KEY:
+            guac_rdp_handle_key_event(rdp_client, input_event);
+            break;
+
+        /* Touch event */
+        case GUAC_RDP_INPUT_EVENT_TOUCH:
+            guac_rdp_handle_touch_event(rdp_client, input_event);
+            break;
+
+    }
+
+}
+
 void guac_rdp_handle_input_events(guac_rdp_client* rdp_client) {
 
+    guac_common_input_coalescer* coalescer = rdp_client->input_coalescer;
+
     guac_fifo_lock(&rdp_client->input_events);
 
+    /* Mouse motion is held back by the coalescer until the next event is
+     * known, such that runs of motion which have accumulated while the RDP
+     * server was busy are sent only as their final position */
     guac_rdp_input_event input_event;
     while (guac_fifo_timed_dequeue(&rdp_client->input_events, &input_event, 0)) {
-        switch (input_event.type) {
 
-            /* Mouse event */
-            case GUAC_RDP_INPUT_EVENT_MOUSE:
-                guac_rdp_handle_mouse_event(rdp_client, &input_event);
-                break;
+        if (input_event.type == GUAC_RDP_INPUT_EVENT_MOUSE)
+            guac_common_input_coalescer_mouse(coalescer, &input_event,
+                    input_event.user, input_event.details.mouse.mask);
+        else
+            guac_common_input_coalescer_event(coalescer, &input_event);
 
-            /* Keyboard event */
-            case GUAC_RDP_INPUT_EVENT_KEY:
-                guac_rdp_handle_key_event(rdp_client, &input_event);
-                break;
-
-            /* Touch event */
-            case GUAC_RDP_INPUT_EVENT_TOUCH:
-                guac_rdp_handle_touch_event(rdp_client, &input_event);
-                break;
-
-        }
     }
 
+    /* Send the final position of any remaining motion */
+    guac_common_input_coalescer_flush(coalescer);
+
     ResetEvent(rdp_client->input_event_queued);
     guac_fifo_unlock(&rdp_client->input_events);
 
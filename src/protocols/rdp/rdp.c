@@ -75,6 +75,7 @@
 #include <winpr/synch.h>
 #include <winpr/wtypes.h>
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -540,6 +541,24 @@ static int guac_rdp_handle_connection(guac_client* client) {
      * heuristics) */
     guac_display_layer_set_lossless(default_layer, settings->lossless);
 
+    /* Stream continuously-changing regions as video only if requested, and
+     * only if graphical output is not being recorded (recordings cannot be
+     * played back with video streams, as guacenc does not decode video) */
+    int enable_video_streaming = settings->enable_video_streaming;
+    if (enable_video_streaming && settings->recording_path != NULL
+            && !settings->recording_exclude_output) {
+        guac_client_log(client, GUAC_LOG_INFO, "Video streaming has been "
+                "disabled, as graphical output of this connection is being "
+                "recorded.");
+        enable_video_streaming = 0;
+    }
+
+    guac_display_set_video_streaming(rdp_client->display, enable_video_streaming);
+
+    /* Override the size of the image cache only if requested */
+    if (settings->image_cache_size >= 0)
+        guac_display_set_cache_size(rdp_client->display, settings->image_cache_size);
+
     rdp_client->current_surface = default_layer;
 
     rdp_client->available_svc = guac_common_list_alloc();
@@ -661,6 +680,10 @@ static int guac_rdp_handle_connection(guac_client* client) {
             guac_client_abort(client, GUAC_PROTOCOL_STATUS_UPSTREAM_UNAVAILABLE,
                     "Connection closed.");
 
+        /* Periodically record the full state of the display, if needed */
+        if (rdp_client->recording != NULL)
+            guac_recording_keyframe(rdp_client->recording, rdp_client->display);
+
     }
 
     guac_rwlock_acquire_write_lock(&(rdp_client->lock));
@@ -720,6 +743,12 @@ static int guac_rdp_handle_connection(guac_client* client) {
     /* Client is now disconnected */
     guac_client_log(client, GUAC_LOG_INFO, "Internal RDP client disconnected");
 
+    guac_common_input_coalescer_stats stats;
+    guac_common_input_coalescer_get_stats(rdp_client->input_coalescer, &stats);
+    guac_client_log(client, GUAC_LOG_INFO, "%" PRIu64 " of %" PRIu64 " mouse "
+            "events were superseded by later mouse motion and not sent.",
+            stats.mouse_events_coalesced, stats.mouse_events_received);
+
     return 0;
 
 fail:
@@ -793,6 +822,12 @@ void* guac_rdp_client_thread(void* data) {
             guac_client_log(client, GUAC_LOG_INFO,
                     "No available audio encoding. Sound disabled.");
 
+        /* Apply requested compression, if any */
+        else
+            guac_audio_stream_set_compression(rdp_client->audio,
+                    settings->audio_bitrate, settings->audio_frame_duration,
+                    settings->audio_low_delay);
+
     } /* end if audio enabled */
 
     /* Load filesystem if drive enabled */
@@ -928,7 +963,7 @@ void* guac_rdp_client_thread(void* data) {
 
     /* Set up screen recording, if requested */
     if (settings->recording_path != NULL) {
-        rdp_client->recording = guac_recording_create(client,
+        rdp_client->recording = guac_recording_create_ex(client,
                 settings->recording_path,
                 settings->recording_name,
                 settings->create_recording_path,
@@ -936,7 +971,8 @@ void* guac_rdp_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 !settings->recording_exclude_touch,
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compress);
     }
 
     /* Continue handling connections until error or client disconnect */
@@ -24,8 +24,10 @@
 #include "channels/cliprdr.h"
 #include "channels/disp.h"
 #include "channels/rdpei.h"
+#include "channels/rdpgfx.h"
 #include "channels/webcam.h"
 #include "common/clipboard.h"
+#include "common/input_coalescer.h"
 #include "common/list.h"
 #include "config.h"
 #include "fs.h"
@@ -156,6 +158,14 @@ typedef struct guac_rdp_client {
      */
     HANDLE input_event_queued;
 
+    /**
+     * Collapses runs of queued mouse motion into their final position as
+     * events are drained from the input_events queue, and records how many
+     * mouse events were collapsed. This coalescer is only used by the RDP
+     * client thread, though its statistics may be read from any thread.
+     */
+    guac_common_input_coalescer* input_coalescer;
+
     /**
      * The current state of the keyboard with respect to the RDP session.
      */
@@ -224,6 +234,12 @@ typedef struct guac_rdp_client {
      */
     guac_rdp_rdpei* rdpei;
 
+    /**
+     * Guacamole-specific state of the Graphics Pipeline Extension (RDPGFX),
+     * or NULL if the RDPGFX channel is not connected.
+     */
+    guac_rdp_rdpgfx* rdpgfx;
+
     /**
      * Webcam support channel.
      */
@@ -316,11 +332,29 @@ void* guac_rdp_client_thread(void* data);
 void guac_rdp_input_event_enqueue(guac_rdp_client* rdp_client,
         const guac_rdp_input_event* input_event);
 
+/**
+ * Processes a single input event that has been dequeued from the input event
+ * queue of an RDP client, sending any associated RDP PDUs. This function is
+ * the guac_common_input_coalescer_handler of the input_coalescer of each
+ * guac_rdp_client.
+ *
+ * @param event
+ *     The guac_rdp_input_event to process.
+ *
+ * @param data
+ *     The guac_rdp_client associated with the RDP session receiving the
+ *     event.
+ */
+void guac_rdp_handle_input_event(const void* event, void* data);
+
 /**
  * Processes all events that have been enqueued with
  * guac_rdp_input_event_enqueue(), clearing the event queue and the state of
  * the input_event_queued handle. Events are processed in the order they are
- * received.
+ * received, except that consecutive mouse events from the same user which
+ * only move the mouse are collapsed into the last such event by the
+ * input_coalescer of the RDP client. Button transitions, key events, and
+ * touch events are never collapsed, nor reordered relative to mouse motion.
  *
  * @param rdp_client
  *     The RDP client instance whose queued input events should be processed.
@@ -127,11 +127,15 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "recording-include-keys",
     "create-recording-path",
     "recording-write-existing",
+    "recording-compress",
     "resize-method",
     "enable-audio-input",
+    "audio-bitrate",
+    "audio-frame-duration",
+    "audio-low-delay",
     "enable-webcam",
     "enable-touch",
-    "enable-webcam",
+    "enable-video-streaming",
     "read-only",
 
     "gateway-hostname",
@@ -153,6 +157,7 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "wol-wait-time",
 
     "force-lossless",
+    "image-cache-size",
     "normalize-clipboard",
     NULL
 };
@@ -595,6 +600,13 @@ enum RDP_ARGS_IDX {
      */
     IDX_RECORDING_WRITE_EXISTING,
 
+    /**
+     * Whether the recording should be compressed and written alongside an
+     * index allowing playback to begin at points other than the beginning of
+     * the recording. Disabled by default.
+     */
+    IDX_RECORDING_COMPRESS,
+
     /**
      * The method to use to apply screen size changes requested by the user.
      * Valid values are blank, "display-update", and "reconnect".
@@ -607,6 +619,27 @@ enum RDP_ARGS_IDX {
      */
     IDX_ENABLE_AUDIO_INPUT,
 
+    /**
+     * The target bitrate of compressed audio, in bits per second. If
+     * omitted, the default bitrate of the audio encoder is used. This has no
+     * effect if audio is sent uncompressed.
+     */
+    IDX_AUDIO_BITRATE,
+
+    /**
+     * The duration of each frame of compressed audio, in milliseconds. If
+     * omitted, the default frame duration of the audio encoder is used. This
+     * has no effect if audio is sent uncompressed.
+     */
+    IDX_AUDIO_FRAME_DURATION,
+
+    /**
+     * "true" if compressed audio should be encoded for minimal latency at the
+     * expense of quality, "false" or blank otherwise. This has no effect if
+     * audio is sent uncompressed.
+     */
+    IDX_AUDIO_LOW_DELAY,
+
     /**
      * "true" if webcam redirection should be enabled for the RDP connection,
      * "false" or blank otherwise.
@@ -619,6 +652,12 @@ enum RDP_ARGS_IDX {
      */
     IDX_ENABLE_TOUCH,
 
+    /**
+     * "true" if continuously-changing regions of the display (such as video
+     * playback) may be streamed as H.264 video, "false" or blank otherwise.
+     */
+    IDX_ENABLE_VIDEO_STREAMING,
+
     /**
      * "true" if this connection should be read-only (user input should be
      * dropped), "false" or blank otherwise.
@@ -727,6 +766,14 @@ enum RDP_ARGS_IDX {
      */
     IDX_FORCE_LOSSLESS,
 
+    /**
+     * The maximum number of bytes of previously-sent image data that may be
+     * cached by each connected client, such that the same image data need
+     * not be sent again. A value of zero disables this cache. If omitted,
+     * the default size of the image cache is used.
+     */
+    IDX_IMAGE_CACHE_SIZE,
+
     /**
      * Controls whether the text content of the clipboard should be
      * automatically normalized to use a particular line ending format. Valid
@@ -912,6 +959,11 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_FORCE_LOSSLESS, 0);
 
+    /* Image cache size (negative for default) */
+    settings->image_cache_size =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_IMAGE_CACHE_SIZE, -1);
+
     /* Domain */
     settings->domain =
         guac_user_parse_args_string(user, GUAC_RDP_CLIENT_ARGS, argv,
@@ -1223,6 +1275,11 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_RECORDING_WRITE_EXISTING, 0);
 
+    /* Parse recording compression flag */
+    settings->recording_compress =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESS, 0);
+
     /* No resize method */
     if (strcmp(argv[IDX_RESIZE_METHOD], "") == 0) {
         guac_user_log(user, GUAC_LOG_INFO, "Resize method: none");
@@ -1263,11 +1320,29 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_ENABLE_TOUCH, 0);
 
+    /* H.264 video streaming enable/disable */
+    settings->enable_video_streaming =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_ENABLE_VIDEO_STREAMING, 0);
+
     /* Audio input enable/disable */
     settings->enable_audio_input =
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_ENABLE_AUDIO_INPUT, 0);
 
+    /* Audio compression parameters (zero for encoder defaults) */
+    settings->audio_bitrate =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_AUDIO_BITRATE, 0);
+
+    settings->audio_frame_duration =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_AUDIO_FRAME_DURATION, 0);
+
+    settings->audio_low_delay =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_AUDIO_LOW_DELAY, 0);
+
     settings->enable_webcam =
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_ENABLE_WEBCAM, 0);
@@ -218,6 +218,13 @@ typedef struct guac_rdp_settings {
      */
     int lossless;
 
+    /**
+     * The maximum number of bytes of previously-sent image data that may be
+     * cached by each connected client, zero to disable that cache, or a
+     * negative value to use the default size.
+     */
+    int image_cache_size;
+
     /**
      * Whether audio is enabled.
      */
@@ -596,6 +603,13 @@ typedef struct guac_rdp_settings {
      */
     int recording_write_existing;
 
+    /**
+     * Non-zero if the recording should be compressed and written alongside
+     * an index allowing playback to begin at points other than the beginning
+     * of the recording. Disabled by default.
+     */
+    int recording_compress;
+
     /** 
      * The method to apply when the user's display changes size.
      */
@@ -606,6 +620,23 @@ typedef struct guac_rdp_settings {
      */
     int enable_audio_input;
 
+    /**
+     * The target bitrate of compressed audio, in bits per second, or zero
+     * to use the default bitrate of the audio encoder.
+     */
+    int audio_bitrate;
+
+    /**
+     * The duration of each frame of compressed audio, in milliseconds, or
+     * zero to use the default frame duration of the audio encoder.
+     */
+    int audio_frame_duration;
+
+    /**
+     * Whether compressed audio should be encoded for minimal latency.
+     */
+    int audio_low_delay;
+
     /**
      * Whether webcam redirection is enabled.
      */
@@ -621,6 +652,12 @@ typedef struct guac_rdp_settings {
      */
     int enable_touch;
 
+    /**
+     * Whether continuously-changing regions of the display may be streamed
+     * as H.264 video.
+     */
+    int enable_video_streaming;
+
     /**
      * The hostname of the remote desktop gateway that should be used as an
      * intermediary for the remote desktop connection. If no gateway should
@@ -280,6 +280,13 @@ typedef struct guac_ssh_settings {
      */
     bool recording_write_existing;
 
+    /**
+     * Whether the recording should be compressed and written alongside an
+     * index allowing playback to begin at points other than the beginning of
+     * the recording. Disabled by default.
+     */
+    bool recording_compress;
+
     /**
      * The number of seconds between sending server alive messages.
      */
@@ -278,7 +278,7 @@ void* ssh_client_thread(void* data) {
 
     /* Set up screen recording, if requested */
     if (settings->recording_path != NULL) {
-        ssh_client->recording = guac_recording_create(client,
+        ssh_client->recording = guac_recording_create_ex(client,
                 settings->recording_path,
                 settings->recording_name,
                 settings->create_recording_path,
@@ -286,7 +286,8 @@ void* ssh_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compress);
     }
 
     /* Create terminal options with required parameters */
@@ -301,6 +302,7 @@ void* ssh_client_thread(void* data) {
     options->font_size = settings->font_size;
     options->color_scheme = settings->color_scheme;
     options->backspace = settings->backspace;
+    options->recording = ssh_client->recording;
 
     /* Create terminal */
     ssh_client->term = guac_terminal_create(client, options);
@@ -63,6 +63,31 @@ static int guac_telnet_join_pending_handler(guac_client* client) {
 
 }
 
+/**
+ * A resync handler implementation that will restore the terminal display of
+ * all users that fell too far behind to receive broadcast data.
+ *
+ * @param client
+ *     The client whose lagging users are being resynchronized.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_telnet_resync_handler(guac_client* client) {
+
+    guac_telnet_client* telnet_client = (guac_telnet_client*) client->data;
+
+    /* Synchronize the terminal display to all lagging users */
+    if (telnet_client->term != NULL) {
+        guac_socket* broadcast_socket = client->pending_socket;
+        guac_terminal_sync_users(telnet_client->term, client, broadcast_socket);
+        guac_socket_flush(broadcast_socket);
+    }
+
+    return 0;
+
+}
+
 int guac_client_init(guac_client* client) {
 
     /* Set client args */
@@ -80,6 +105,7 @@ int guac_client_init(guac_client* client) {
     /* Set handlers */
     client->join_handler = guac_telnet_user_join_handler;
     client->join_pending_handler = guac_telnet_join_pending_handler;
+    client->resync_handler = guac_telnet_resync_handler;
     client->free_handler = guac_telnet_client_free_handler;
     client->leave_handler = guac_telnet_user_leave_handler;
 
@@ -109,10 +135,6 @@ int guac_telnet_client_free_handler(guac_client* client) {
     if (telnet_client->socket_fd != -1)
         close(telnet_client->socket_fd);
 
-    /* Clean up recording, if in progress */
-    if (telnet_client->recording != NULL)
-        guac_recording_free(telnet_client->recording);
-
     /* Kill terminal */
     guac_terminal_free(telnet_client->term);
 
@@ -122,6 +144,11 @@ int guac_telnet_client_free_handler(guac_client* client) {
         telnet_free(telnet_client->telnet);
     }
 
+    /* Clean up recording, if in progress (the terminal and telnet threads
+     * which may write to the recording have now stopped) */
+    if (telnet_client->recording != NULL)
+        guac_recording_free(telnet_client->recording);
+
     /* Free settings */
     if (telnet_client->settings != NULL)
         guac_telnet_settings_free(telnet_client->settings);
@@ -256,6 +256,13 @@ typedef struct guac_telnet_settings {
      */
     bool recording_write_existing;
 
+    /**
+     * Whether the recording should be compressed and written alongside an
+     * index allowing playback to begin at points other than the beginning of
+     * the recording. Disabled by default.
+     */
+    bool recording_compress;
+
     /**
      * The ASCII code, as an integer, that the telnet client will use when the
      * backspace key is pressed.  By default, this is 127, ASCII delete, if
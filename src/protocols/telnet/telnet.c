@@ -529,7 +529,7 @@ void* guac_telnet_client_thread(void* data) {
 
     /* Set up screen recording, if requested */
     if (settings->recording_path != NULL) {
-        telnet_client->recording = guac_recording_create(client,
+        telnet_client->recording = guac_recording_create_ex(client,
                 settings->recording_path,
                 settings->recording_name,
                 settings->create_recording_path,
@@ -537,7 +537,8 @@ void* guac_telnet_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compress);
     }
 
     /* Create terminal options with required parameters */
@@ -552,6 +553,7 @@ void* guac_telnet_client_thread(void* data) {
     options->font_size = settings->font_size;
     options->color_scheme = settings->color_scheme;
     options->backspace = settings->backspace;
+    options->recording = telnet_client->recording;
 
     /* Create terminal */
     telnet_client->term = guac_terminal_create(client, options);
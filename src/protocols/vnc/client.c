@@ -35,6 +35,7 @@
 
 #include <guacamole/client.h>
 #include <guacamole/display.h>
+#include <guacamole/fifo.h>
 #include <guacamole/mem.h>
 #include <guacamole/recording.h>
 
@@ -98,6 +99,32 @@ static int guac_vnc_join_pending_handler(guac_client* client) {
 
 }
 
+/**
+ * A resync handler implementation that will restore the display of all users
+ * that fell too far behind to receive broadcast data. Any audio stream
+ * already announced to those users remains open and is NOT announced again.
+ *
+ * @param client
+ *     The client whose lagging users are being resynchronized.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_vnc_resync_handler(guac_client* client) {
+
+    guac_vnc_client* vnc_client = (guac_vnc_client*) client->data;
+    guac_socket* broadcast_socket = client->pending_socket;
+
+    /* Synchronize with current display */
+    if (vnc_client->display != NULL) {
+        guac_display_dup(vnc_client->display, broadcast_socket);
+        guac_socket_flush(broadcast_socket);
+    }
+
+    return 0;
+
+}
+
 int guac_client_init(guac_client* client) {
 
     /* Set client args */
@@ -115,9 +142,19 @@ int guac_client_init(guac_client* client) {
     /* Initialize the message lock. */
     pthread_mutex_init(&(vnc_client->message_lock), NULL);
 
+    /* Initialize the queue of input events awaiting the input thread */
+    guac_fifo_init(&vnc_client->input_events, &vnc_client->input_events_items,
+            GUAC_VNC_INPUT_EVENT_QUEUE_SIZE, sizeof(guac_vnc_input_event));
+
+    /* Collapse runs of queued mouse motion as input events are sent */
+    vnc_client->input_coalescer = guac_common_input_coalescer_alloc(
+            sizeof(guac_vnc_input_event), guac_vnc_send_input_event,
+            vnc_client);
+
     /* Set handlers */
     client->join_handler = guac_vnc_user_join_handler;
     client->join_pending_handler = guac_vnc_join_pending_handler;
+    client->resync_handler = guac_vnc_resync_handler;
     client->leave_handler = guac_vnc_user_leave_handler;
     client->free_handler = guac_vnc_client_free_handler;
 
@@ -218,6 +255,10 @@ int guac_vnc_client_free_handler(guac_client* client) {
     /* Clean up the message lock. */
     pthread_mutex_destroy(&(vnc_client->message_lock));
 
+    /* Clean up the input event queue */
+    guac_fifo_destroy(&vnc_client->input_events);
+    guac_common_input_coalescer_free(vnc_client->input_coalescer);
+
     /* Free generic data struct */
     guac_mem_free(client->data);
 
@@ -19,19 +19,89 @@
 
 #include "config.h"
 
+#include "common/input_coalescer.h"
 #include "display.h"
+#include "input.h"
 #include "vnc.h"
 
+#include <guacamole/client.h>
 #include <guacamole/display.h>
+#include <guacamole/fifo.h>
 #include <guacamole/recording.h>
 #include <guacamole/user.h>
 #include <rfb/rfbclient.h>
 
+#include <pthread.h>
+
+void guac_vnc_send_input_event(const void* event, void* data) {
+
+    const guac_vnc_input_event* input_event =
+        (const guac_vnc_input_event*) event;
+
+    guac_vnc_client* vnc_client = (guac_vnc_client*) data;
+    rfbClient* rfb_client = vnc_client->rfb_client;
+
+    pthread_mutex_lock(&(vnc_client->message_lock));
+
+    switch (input_event->type) {
+
+        case GUAC_VNC_INPUT_EVENT_MOUSE:
+            SendPointerEvent(rfb_client, input_event->details.mouse.x,
+                    input_event->details.mouse.y,
+                    input_event->details.mouse.mask);
+            break;
+
+        case GUAC_VNC_INPUT_EVENT_KEY:
+            SendKeyEvent(rfb_client, input_event->details.key.keysym,
+                    input_event->details.key.pressed);
+            break;
+
+    }
+
+    pthread_mutex_unlock(&(vnc_client->message_lock));
+
+}
+
+void* guac_vnc_input_thread(void* data) {
+
+    guac_client* client = (guac_client*) data;
+    guac_vnc_client* vnc_client = (guac_vnc_client*) client->data;
+    guac_common_input_coalescer* coalescer = vnc_client->input_coalescer;
+
+    guac_vnc_input_event events[GUAC_VNC_INPUT_EVENT_BATCH_SIZE];
+
+    /* Process everything that has been queued since the last batch was sent,
+     * such that runs of motion which accumulate while the VNC server is busy
+     * are sent only as their final position */
+    size_t count;
+    while ((count = guac_fifo_dequeue_batch(&vnc_client->input_events,
+                    events, GUAC_VNC_INPUT_EVENT_BATCH_SIZE)) > 0) {
+
+        for (size_t i = 0; i < count; i++) {
+
+            const guac_vnc_input_event* event = &events[i];
+
+            if (event->type == GUAC_VNC_INPUT_EVENT_MOUSE)
+                guac_common_input_coalescer_mouse(coalescer, event,
+                        event->user, event->details.mouse.mask);
+            else
+                guac_common_input_coalescer_event(coalescer, event);
+
+        }
+
+        /* Send the final position of any remaining motion */
+        guac_common_input_coalescer_flush(coalescer);
+
+    }
+
+    return NULL;
+
+}
+
 int guac_vnc_user_mouse_handler(guac_user* user, int x, int y, int mask) {
 
     guac_client* client = user->client;
     guac_vnc_client* vnc_client = (guac_vnc_client*) client->data;
-    rfbClient* rfb_client = vnc_client->rfb_client;
 
     /* Store current mouse location/state */
     guac_display_render_thread_notify_user_moved_mouse(vnc_client->render_thread, user, x, y, mask);
@@ -41,8 +111,21 @@ int guac_vnc_user_mouse_handler(guac_user* user, int x, int y, int mask) {
         guac_recording_report_mouse(vnc_client->recording, x, y, mask);
 
     /* Send VNC event only if finished connecting */
-    if (rfb_client != NULL)
-        SendPointerEvent(rfb_client, x, y, mask);
+    if (vnc_client->rfb_client != NULL) {
+
+        guac_vnc_input_event mouse_event = {
+            .type = GUAC_VNC_INPUT_EVENT_MOUSE,
+            .user = user,
+            .details.mouse = {
+                .x = x,
+                .y = y,
+                .mask = mask
+            }
+        };
+
+        guac_fifo_enqueue(&vnc_client->input_events, &mouse_event);
+
+    }
 
     return 0;
 }
@@ -50,7 +133,6 @@ int guac_vnc_user_mouse_handler(guac_user* user, int x, int y, int mask) {
 int guac_vnc_user_key_handler(guac_user* user, int keysym, int pressed) {
 
     guac_vnc_client* vnc_client = (guac_vnc_client*) user->client->data;
-    rfbClient* rfb_client = vnc_client->rfb_client;
 
     /* Report key state within recording */
     if (vnc_client->recording != NULL)
@@ -58,8 +140,20 @@ int guac_vnc_user_key_handler(guac_user* user, int keysym, int pressed) {
                 keysym, pressed);
 
     /* Send VNC event only if finished connecting */
-    if (rfb_client != NULL)
-        SendKeyEvent(rfb_client, keysym, pressed);
+    if (vnc_client->rfb_client != NULL) {
+
+        guac_vnc_input_event key_event = {
+            .type = GUAC_VNC_INPUT_EVENT_KEY,
+            .user = user,
+            .details.key = {
+                .keysym = keysym,
+                .pressed = pressed
+            }
+        };
+
+        guac_fifo_enqueue(&vnc_client->input_events, &key_event);
+
+    }
 
     return 0;
 }
@@ -24,6 +24,136 @@
 
 #include <guacamole/user.h>
 
+/**
+ * The maximum number of input events that may be queued for sending to the
+ * VNC server at any one time. If the queue is full, further input events
+ * block until space is available.
+ */
+#define GUAC_VNC_INPUT_EVENT_QUEUE_SIZE 4096
+
+/**
+ * The maximum number of queued input events that the input thread will remove
+ * from the queue and process at once.
+ */
+#define GUAC_VNC_INPUT_EVENT_BATCH_SIZE 256
+
+/**
+ * All event types supported by the guac_vnc_input_event structure.
+ */
+typedef enum guac_vnc_input_event_type {
+
+    /**
+     * A mouse event, such as mouse movement or press/release of a mouse
+     * button.
+     */
+    GUAC_VNC_INPUT_EVENT_MOUSE,
+
+    /**
+     * A key event, such as press/release of a keyboard key.
+     */
+    GUAC_VNC_INPUT_EVENT_KEY
+
+} guac_vnc_input_event_type;
+
+/**
+ * Generic input event that may represent any one of several possible event
+ * types, as dictated by guac_vnc_input_event_type.
+ */
+typedef struct guac_vnc_input_event {
+
+    /**
+     * The type of this event. This value dictates which event details are
+     * relevant.
+     */
+    guac_vnc_input_event_type type;
+
+    /**
+     * The user that originated this event. NOTE: This pointer is not
+     * guaranteed to be valid and MUST NOT be dereferenced. It is used only to
+     * determine whether two events originated from the same user.
+     */
+    guac_user* user;
+
+    /**
+     * Event details that are type-specific.
+     */
+    union {
+
+        /**
+         * Event details specific to GUAC_VNC_INPUT_EVENT_MOUSE events.
+         */
+        struct {
+
+            /**
+             * The X coordinate of the mouse pointer, in pixels.
+             */
+            int x;
+
+            /**
+             * The Y coordinate of the mouse pointer, in pixels.
+             */
+            int y;
+
+            /**
+             * The current state of each mouse button, as a button mask.
+             */
+            int mask;
+
+        } mouse;
+
+        /**
+         * Event details specific to GUAC_VNC_INPUT_EVENT_KEY events.
+         */
+        struct {
+
+            /**
+             * The X11 keysym of the key that was pressed or released.
+             */
+            int keysym;
+
+            /**
+             * Non-zero if the key was pressed, zero if the key was released.
+             */
+            int pressed;
+
+        } key;
+
+    } details;
+
+} guac_vnc_input_event;
+
+/**
+ * Sends a single input event to the VNC server. This function is the
+ * guac_common_input_coalescer_handler of the input_coalescer of each
+ * guac_vnc_client.
+ *
+ * @param event
+ *     The guac_vnc_input_event to send.
+ *
+ * @param data
+ *     The guac_vnc_client of the VNC connection that should receive the
+ *     event.
+ */
+void guac_vnc_send_input_event(const void* event, void* data);
+
+/**
+ * Thread which sends all input events queued by the mouse and key handlers to
+ * the VNC server, in the order they were received. Consecutive mouse events
+ * from the same user which only move the mouse are collapsed into the last
+ * such event by the input_coalescer of the guac_vnc_client if they
+ * accumulate while the VNC server is busy. Button
+ * transitions and key events are never collapsed, nor reordered relative to
+ * mouse motion. The thread runs until the input_events queue of the
+ * guac_vnc_client is invalidated.
+ *
+ * @param data
+ *     The guac_client instance associated with the VNC session.
+ *
+ * @return
+ *     Always NULL.
+ */
+void* guac_vnc_input_thread(void* data);
+
 /**
  * Handler for Guacamole user mouse events.
  */
@@ -89,6 +89,7 @@ const char* GUAC_VNC_CLIENT_ARGS[] = {
     "recording-include-keys",
     "create-recording-path",
     "recording-write-existing",
+    "recording-compress",
     "clipboard-buffer-size",
     "disable-copy",
     "disable-paste",
@@ -101,6 +102,7 @@ const char* GUAC_VNC_CLIENT_ARGS[] = {
     "wol-wait-time",
 
     "force-lossless",
+    "image-cache-size",
     "compress-level",
     "quality-level",
     NULL
@@ -365,6 +367,13 @@ enum VNC_ARGS_IDX {
      */
     IDX_RECORDING_WRITE_EXISTING,
 
+    /**
+     * Whether the recording should be compressed and written alongside an
+     * index allowing playback to begin at points other than the beginning of
+     * the recording. Disabled by default.
+     */
+    IDX_RECORDING_COMPRESS,
+
     /**
      * The maximum number of bytes to allow within the clipboard.
      */
@@ -427,6 +436,14 @@ enum VNC_ARGS_IDX {
      */
     IDX_FORCE_LOSSLESS,
 
+    /**
+     * The maximum number of bytes of previously-sent image data that may be
+     * cached by each connected client, such that the same image data need
+     * not be sent again. A value of zero disables this cache. If omitted,
+     * the default size of the image cache is used.
+     */
+    IDX_IMAGE_CACHE_SIZE,
+
     /**
      * The level of compression, on a scale of 0 (no compression) to 9 (maximum
      * compression), that the connection will be configured for.
@@ -513,6 +530,11 @@ guac_vnc_settings* guac_vnc_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
                 IDX_FORCE_LOSSLESS, false);
 
+    /* Image cache size (negative for default) */
+    settings->image_cache_size =
+        guac_user_parse_args_int(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_IMAGE_CACHE_SIZE, -1);
+
     /* Compression level */
     settings->compress_level =
         guac_user_parse_args_int(user, GUAC_VNC_CLIENT_ARGS, argv,
@@ -686,6 +708,11 @@ guac_vnc_settings* guac_vnc_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
                 IDX_RECORDING_WRITE_EXISTING, false);
 
+    /* Parse recording compression flag */
+    settings->recording_compress =
+        guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESS, false);
+
     /* Parse clipboard copy disable flag */
     settings->disable_copy =
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
@@ -93,6 +93,13 @@ typedef struct guac_vnc_settings {
      */
     bool lossless;
 
+    /**
+     * The maximum number of bytes of previously-sent image data that may be
+     * cached by each connected client, zero to disable that cache, or a
+     * negative value to use the default size.
+     */
+    int image_cache_size;
+
     /**
      * The level of compression to ask the VNC client library to perform.
      */
@@ -317,6 +324,13 @@ typedef struct guac_vnc_settings {
      * Disabled by default.
      */
     bool recording_write_existing;
+
+    /**
+     * Whether the recording should be compressed and written alongside an
+     * index allowing playback to begin at points other than the beginning of
+     * the recording. Disabled by default.
+     */
+    bool recording_compress;
     
     /**
      * Whether or not to send the magic Wake-on-LAN (WoL) packet prior to
@@ -25,6 +25,7 @@
 #include "common/clipboard.h"
 #include "cursor.h"
 #include "display.h"
+#include "input.h"
 #include "log.h"
 #include "settings.h"
 #include "vnc.h"
@@ -58,6 +59,8 @@
 #include <gcrypt.h>
 #endif
 
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -579,7 +582,7 @@ void* guac_vnc_client_thread(void* data) {
 
     /* Set up screen recording, if requested */
     if (settings->recording_path != NULL) {
-        vnc_client->recording = guac_recording_create(client,
+        vnc_client->recording = guac_recording_create_ex(client,
                 settings->recording_path,
                 settings->recording_name,
                 settings->create_recording_path,
@@ -587,7 +590,8 @@ void* guac_vnc_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compress);
     }
 
     /* Create display */
@@ -599,6 +603,10 @@ void* guac_vnc_client_thread(void* data) {
     guac_display_layer_set_lossless(guac_display_default_layer(vnc_client->display),
             settings->lossless);
 
+    /* Override the size of the image cache only if requested */
+    if (settings->image_cache_size >= 0)
+        guac_display_set_cache_size(vnc_client->display, settings->image_cache_size);
+
     /* If compression and display quality have been configured, set those. */
     if (settings->compress_level >= 0 && settings->compress_level <= 9)
         rfb_client->appData.compressLevel = settings->compress_level;
@@ -624,6 +632,14 @@ void* guac_vnc_client_thread(void* data) {
 
     vnc_client->render_thread = guac_display_render_thread_create(vnc_client->display);
 
+    /* Send input events to the VNC server from a dedicated thread */
+    if (pthread_create(&vnc_client->input_thread, NULL,
+                guac_vnc_input_thread, client))
+        guac_client_abort(client, GUAC_PROTOCOL_STATUS_SERVER_ERROR,
+                "Unable to start input thread.");
+    else
+        vnc_client->input_thread_started = 1;
+
     /* Handle messages from VNC server while client is running */
     while (client->state == GUAC_CLIENT_RUNNING) {
 
@@ -647,6 +663,25 @@ void* guac_vnc_client_thread(void* data) {
         if (wait_result < 0)
             guac_client_abort(client, GUAC_PROTOCOL_STATUS_UPSTREAM_ERROR, "Connection closed.");
 
+        /* Periodically record the full state of the display, if needed */
+        if (vnc_client->recording != NULL)
+            guac_recording_keyframe(vnc_client->recording, vnc_client->display);
+
+    }
+
+    /* Stop sending input events, discarding any which remain */
+    guac_fifo_invalidate(&vnc_client->input_events);
+    if (vnc_client->input_thread_started) {
+        pthread_join(vnc_client->input_thread, NULL);
+        vnc_client->input_thread_started = 0;
+
+        guac_common_input_coalescer_stats stats;
+        guac_common_input_coalescer_get_stats(vnc_client->input_coalescer,
+                &stats);
+        guac_client_log(client, GUAC_LOG_INFO, "%" PRIu64 " of %" PRIu64 " "
+                "mouse events were superseded by later mouse motion and not "
+                "sent.", stats.mouse_events_coalesced,
+                stats.mouse_events_received);
     }
 
     /* Stop render loop */
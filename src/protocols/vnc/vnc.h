@@ -24,11 +24,14 @@
 
 #include "common/clipboard.h"
 #include "common/iconv.h"
+#include "common/input_coalescer.h"
 #include "display.h"
+#include "input.h"
 #include "settings.h"
 
 #include <guacamole/client.h>
 #include <guacamole/display.h>
+#include <guacamole/fifo.h>
 #include <guacamole/layer.h>
 #include <rfb/rfbclient.h>
 
@@ -45,6 +48,7 @@
 #include <guacamole/recording.h>
 
 #include <pthread.h>
+#include <stdint.h>
 
 /**
  * The ID of the RFB client screen. If multi-screen support is added, more than
@@ -74,6 +78,39 @@ typedef struct guac_vnc_client {
      */
     pthread_mutex_t message_lock;
 
+    /**
+     * Queue of mouse and key events awaiting sending to the VNC server by the
+     * input thread. Sending these events from the Guacamole event handlers
+     * directly would block handling of further Guacamole events (including
+     * "sync") whenever the VNC server is slow to accept them, and would
+     * leave no opportunity to discard stale mouse motion.
+     */
+    guac_fifo input_events;
+
+    /**
+     * Storage for the input_events queue (see above).
+     */
+    guac_vnc_input_event input_events_items[GUAC_VNC_INPUT_EVENT_QUEUE_SIZE];
+
+    /**
+     * The thread which sends the contents of the input_events queue to the
+     * VNC server.
+     */
+    pthread_t input_thread;
+
+    /**
+     * Whether the input thread has been started.
+     */
+    int input_thread_started;
+
+    /**
+     * Collapses runs of queued mouse motion into their final position as
+     * events are sent by the input thread, and records how many mouse events
+     * were collapsed. This coalescer is only used by the input thread, though
+     * its statistics may be read from any thread.
+     */
+    guac_common_input_coalescer* input_coalescer;
+
     /**
      * The underlying VNC client.
      */
@@ -17,6 +17,7 @@
  * under the License.
  */
 
+#include "terminal/buffer-priv.h"
 #include "terminal/buffer.h"
 #include "terminal/common.h"
 #include "terminal/terminal.h"
@@ -28,79 +29,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-/**
- * The minimum number of columns to allocate for a buffer row, regardless of
- * the terminal size. We set a minimum size here to reduce the memory
- * reallocation overhead for small rows.
- */
-#define GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE 256
-
-/**
- * A single variable-length row of terminal data.
- */
-typedef struct guac_terminal_buffer_row {
-
-    /**
-     * Array of guac_terminal_char representing the contents of the row.
-     */
-    guac_terminal_char* characters;
-
-    /**
-     * The length of this row in characters. This is the number of initialized
-     * characters in the buffer, usually equal to the number of characters
-     * in the screen width at the time this row was created.
-     */
-    unsigned int length;
-
-    /**
-     * The number of elements in the characters array. After the length
-     * equals this value, the array must be resized.
-     */
-    unsigned int available;
-
-    /**
-     * True if the current row has been wrapped to avoid going off the screen.
-     * False otherwise.
-     */
-    bool wrapped_row;
-
-} guac_terminal_buffer_row;
-
-struct guac_terminal_buffer {
-
-    /**
-     * The character to assign to newly-allocated cells.
-     */
-    guac_terminal_char default_character;
-
-    /**
-     * Array of buffer rows. This array functions as a ring buffer.
-     * When a new row needs to be appended, the top reference is moved down
-     * and the old top row is replaced.
-     */
-    guac_terminal_buffer_row* rows;
-
-    /**
-     * The index of the first row in the buffer (the row which represents row 0
-     * with respect to the terminal display). This is also the index of the row
-     * to replace when insufficient space remains in the buffer to add a new
-     * row.
-     */
-    unsigned int top;
-
-    /**
-     * The number of rows currently stored in the buffer.
-     */
-    unsigned int length;
-
-    /**
-     * The number of rows in the buffer. This is the total capacity
-     * of the buffer.
-     */
-    unsigned int available;
-
-};
-
 guac_terminal_buffer* guac_terminal_buffer_alloc(int rows,
         const guac_terminal_char* default_character) {
 
@@ -116,17 +44,36 @@ guac_terminal_buffer* guac_terminal_buffer_alloc(int rows,
     buffer->available = rows;
     buffer->top = 0;
     buffer->length = 0;
+    buffer->height = GUAC_TERMINAL_MAX_ROWS;
     buffer->rows = guac_mem_alloc(sizeof(guac_terminal_buffer_row), buffer->available);
 
-    /* Init scrollback rows */
+    /* Init attribute table and packing state */
+    buffer->attributes = guac_mem_alloc(sizeof(guac_terminal_attributes),
+            GUAC_TERMINAL_BUFFER_MAX_ATTRIBUTES);
+    buffer->attribute_refs = guac_mem_zalloc(sizeof(unsigned int),
+            GUAC_TERMINAL_BUFFER_MAX_ATTRIBUTES);
+    buffer->attribute_count = 0;
+    buffer->last_attribute = 0;
+    buffer->accesses = 0;
+    buffer->pack_buffer = NULL;
+    buffer->pack_buffer_size = 0;
+
+    buffer->unpacked = guac_mem_alloc(sizeof(int), GUAC_TERMINAL_BUFFER_MAX_UNPACKED);
+    buffer->next_unpacked = 0;
+    for (i = 0; i < GUAC_TERMINAL_BUFFER_MAX_UNPACKED; i++)
+        buffer->unpacked[i] = -1;
+
+    /* Init scrollback rows (storage for each row is allocated only once
+     * that row is actually used) */
     row = buffer->rows;
     for (i=0; i<rows; i++) {
 
-        /* Allocate row  */
-        row->available = GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE;
+        row->available = 0;
         row->length = 0;
         row->wrapped_row = false;
-        row->characters = guac_mem_alloc(sizeof(guac_terminal_char), row->available);
+        row->characters = NULL;
+        row->packed = NULL;
+        row->last_access = 0;
 
         /* Next row */
         row++;
@@ -145,9 +92,16 @@ void guac_terminal_buffer_free(guac_terminal_buffer* buffer) {
     /* Free all rows */
     for (i=0; i<buffer->available; i++) {
         guac_mem_free(row->characters);
+        guac_mem_free(row->packed);
         row++;
     }
 
+    /* Free packing state */
+    guac_mem_free(buffer->attributes);
+    guac_mem_free(buffer->attribute_refs);
+    guac_mem_free(buffer->unpacked);
+    guac_mem_free(buffer->pack_buffer);
+
     /* Free actual buffer */
     guac_mem_free(buffer->rows);
     guac_mem_free(buffer);
@@ -155,13 +109,478 @@ void guac_terminal_buffer_free(guac_terminal_buffer* buffer) {
 }
 
 void guac_terminal_buffer_reset(guac_terminal_buffer* buffer) {
+
+    int i;
+    guac_terminal_buffer_row* row = buffer->rows;
+
     buffer->top = 0;
     buffer->length = 0;
+
+    /* Discard the contents of all packed rows, such that nothing refers to
+     * the attribute table any longer */
+    for (i = 0; i < buffer->available; i++) {
+
+        if (row->packed != NULL) {
+            guac_mem_free(row->packed);
+            row->packed = NULL;
+            row->length = 0;
+            row->wrapped_row = false;
+        }
+
+        row++;
+
+    }
+
+    /* Clear attribute table and packing state */
+    memset(buffer->attribute_refs, 0, sizeof(unsigned int)
+            * GUAC_TERMINAL_BUFFER_MAX_ATTRIBUTES);
+    buffer->attribute_count = 0;
+    buffer->last_attribute = 0;
+
+    for (i = 0; i < GUAC_TERMINAL_BUFFER_MAX_UNPACKED; i++)
+        buffer->unpacked[i] = -1;
+
+}
+
+/**
+ * Returns the index of the given attributes within the attribute table of
+ * the given buffer, adding those attributes to the table if not already
+ * present, and acquires a reference to that entry of the table. If the table
+ * is full, the attributes replace an entry that is no longer referenced, if
+ * any. Each reference acquired must eventually be released with
+ * guac_terminal_buffer_release_attributes().
+ *
+ * @param buffer
+ *     The buffer whose attribute table should be searched.
+ *
+ * @param attributes
+ *     The attributes to search for.
+ *
+ * @return
+ *     The index of the given attributes within the attribute table, or -1
+ *     if the attributes are not present and the table is full.
+ */
+static int guac_terminal_buffer_intern_attributes(guac_terminal_buffer* buffer,
+        const guac_terminal_attributes* attributes) {
+
+    int index = -1;
+
+    /* Consecutive spans very often share attributes */
+    if (buffer->last_attribute < buffer->attribute_count
+            && guac_terminal_attributes_equal(
+                &buffer->attributes[buffer->last_attribute], attributes))
+        index = buffer->last_attribute;
+
+    for (int i = 0; index < 0 && i < buffer->attribute_count; i++) {
+        if (guac_terminal_attributes_equal(&buffer->attributes[i], attributes))
+            index = i;
+    }
+
+    /* Add attributes to the table, reusing any unreferenced entry once the
+     * table is full */
+    if (index < 0) {
+
+        if (buffer->attribute_count < GUAC_TERMINAL_BUFFER_MAX_ATTRIBUTES)
+            index = buffer->attribute_count++;
+
+        else {
+
+            for (int i = 0; index < 0 && i < buffer->attribute_count; i++) {
+                if (buffer->attribute_refs[i] == 0)
+                    index = i;
+            }
+
+            if (index < 0)
+                return -1;
+
+        }
+
+        buffer->attributes[index] = *attributes;
+
+    }
+
+    buffer->attribute_refs[index]++;
+    return buffer->last_attribute = index;
+
+}
+
+/**
+ * Releases a reference to the given entry of the attribute table of the given
+ * buffer, acquired with guac_terminal_buffer_intern_attributes().
+ *
+ * @param buffer
+ *     The buffer whose attribute table contains the entry.
+ *
+ * @param index
+ *     The index of the entry within the attribute table.
+ */
+static void guac_terminal_buffer_release_attributes(guac_terminal_buffer* buffer,
+        unsigned int index) {
+
+    GUAC_ASSERT(index < buffer->attribute_count);
+    GUAC_ASSERT(buffer->attribute_refs[index] > 0);
+
+    buffer->attribute_refs[index]--;
+
+}
+
+/**
+ * Writes the given value as a variable-length integer, using 7 bits per
+ * byte, least-significant bits first, with the high bit of each byte set if
+ * more bytes follow.
+ *
+ * @param data
+ *     The location to write the value to.
+ *
+ * @param value
+ *     The value to write.
+ *
+ * @return
+ *     The location immediately after the written value.
+ */
+static unsigned char* guac_terminal_buffer_write_varint(unsigned char* data,
+        unsigned int value) {
+
+    while (value >= 0x80) {
+        *(data++) = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+
+    *(data++) = value;
+    return data;
+
+}
+
+/**
+ * Reads a variable-length integer written by
+ * guac_terminal_buffer_write_varint().
+ *
+ * @param data
+ *     The location of the value to read. This pointer is advanced past the
+ *     value read.
+ *
+ * @return
+ *     The value read.
+ */
+static unsigned int guac_terminal_buffer_read_varint(const unsigned char** data) {
+
+    unsigned int value = 0;
+    int shift = 0;
+
+    const unsigned char* current = *data;
+    do {
+        value |= (*current & 0x7F) << shift;
+        shift += 7;
+    } while (*(current++) & 0x80);
+
+    *data = current;
+    return value;
+
+}
+
+/**
+ * Writes the value and width of the given character, omitting its
+ * attributes. Single-column characters are written as their value plus 2,
+ * and continuation characters as 1, such that most characters occupy a single
+ * byte. All other characters are written as 0, followed by their value plus 1
+ * and their width.
+ *
+ * @param data
+ *     The location to write the character to.
+ *
+ * @param character
+ *     The character to write.
+ *
+ * @return
+ *     The location immediately after the written character.
+ */
+static unsigned char* guac_terminal_buffer_write_char(unsigned char* data,
+        const guac_terminal_char* character) {
+
+    if (character->width == 1)
+        return guac_terminal_buffer_write_varint(data, character->value + 2);
+
+    if (character->value == GUAC_CHAR_CONTINUATION && character->width == 0)
+        return guac_terminal_buffer_write_varint(data, 1);
+
+    data = guac_terminal_buffer_write_varint(data, 0);
+    data = guac_terminal_buffer_write_varint(data, character->value + 1);
+    return guac_terminal_buffer_write_varint(data, character->width);
+
+}
+
+/**
+ * Reads the value and width of a character written by
+ * guac_terminal_buffer_write_char().
+ *
+ * @param data
+ *     The location of the character to read. This pointer is advanced past
+ *     the character read.
+ *
+ * @param character
+ *     The character whose value and width should be set.
+ */
+static void guac_terminal_buffer_read_char(const unsigned char** data,
+        guac_terminal_char* character) {
+
+    unsigned int value = guac_terminal_buffer_read_varint(data);
+
+    if (value >= 2) {
+        character->value = (int) value - 2;
+        character->width = 1;
+    }
+
+    else if (value == 1) {
+        character->value = GUAC_CHAR_CONTINUATION;
+        character->width = 0;
+    }
+
+    else {
+        character->value = (int) guac_terminal_buffer_read_varint(data) - 1;
+        character->width = guac_terminal_buffer_read_varint(data);
+    }
+
+}
+
+/**
+ * Returns whether the given characters are identical, including their
+ * attributes.
+ */
+static bool guac_terminal_buffer_chars_equal(const guac_terminal_char* a,
+        const guac_terminal_char* b) {
+    return a->value == b->value && a->width == b->width
+        && guac_terminal_attributes_equal(&a->attributes, &b->attributes);
+}
+
+/**
+ * Returns the number of consecutive, identical characters beginning at the
+ * given column of the given row.
+ */
+static int guac_terminal_buffer_run_length(const guac_terminal_buffer_row* row,
+        int column) {
+
+    int end = column + 1;
+    while (end < row->length && guac_terminal_buffer_chars_equal(
+                &row->characters[column], &row->characters[end]))
+        end++;
+
+    return end - column;
+
+}
+
+/**
+ * Releases the references to the attribute table held by each span within
+ * the given packed data, as produced by guac_terminal_buffer_pack_row().
+ *
+ * @param buffer
+ *     The buffer whose attribute table is referenced by the packed data.
+ *
+ * @param data
+ *     The first span of the packed data.
+ *
+ * @param end
+ *     The location immediately after the last span of the packed data.
+ */
+static void guac_terminal_buffer_release_spans(guac_terminal_buffer* buffer,
+        const unsigned char* data, const unsigned char* end) {
+
+    guac_terminal_char character;
+
+    while (data < end) {
+
+        unsigned int header = guac_terminal_buffer_read_varint(&data);
+        unsigned int attribute = guac_terminal_buffer_read_varint(&data);
+
+        /* Skip the single repeated character or each character */
+        int count = (header & 1) ? 1 : header >> 1;
+        for (int i = 0; i < count; i++)
+            guac_terminal_buffer_read_char(&data, &character);
+
+        guac_terminal_buffer_release_attributes(buffer, attribute);
+
+    }
+
+}
+
+/**
+ * Packs the given row, replacing its array of characters with a compact
+ * representation. The packed row consists of consecutive spans, each
+ * beginning with a header (the number of characters in the span, shifted
+ * left by one bit, with the lowest bit set if the span consists of a single
+ * repeated character) followed by the index of the attributes shared by all
+ * characters in the span and then the value and width of either the single
+ * repeated character or of each character. All integers are stored with
+ * guac_terminal_buffer_write_varint().
+ *
+ * Each span holds a reference to its entry of the attribute table until the
+ * row is unpacked. If the row is already packed, or contains characters or
+ * attributes that cannot be packed, the row is left untouched.
+ *
+ * @param buffer
+ *     The buffer containing the row.
+ *
+ * @param row
+ *     The row to pack.
+ */
+static void guac_terminal_buffer_pack_row(guac_terminal_buffer* buffer,
+        guac_terminal_buffer_row* row) {
+
+    if (row->packed != NULL || row->characters == NULL)
+        return;
+
+    /* Empty rows need no storage at all */
+    if (row->length == 0) {
+        guac_mem_free(row->characters);
+        row->characters = NULL;
+        row->available = 0;
+        return;
+    }
+
+    /* Reserve enough space for the worst case: a separate span for each
+     * character, with each of up to 5 integers taking up to 5 bytes */
+    size_t required = guac_mem_ckd_mul_or_die(row->length, 25);
+    if (buffer->pack_buffer_size < required) {
+        buffer->pack_buffer = guac_mem_realloc_or_die(buffer->pack_buffer, required);
+        buffer->pack_buffer_size = required;
+    }
+
+    unsigned char* current = buffer->pack_buffer;
+
+    int column = 0;
+    while (column < row->length) {
+
+        const guac_terminal_char* first = &row->characters[column];
+
+        /* Values and widths must be representable */
+        if (first->value < GUAC_CHAR_CONTINUATION || first->width < 0)
+            goto pack_failed;
+
+        int attribute = guac_terminal_buffer_intern_attributes(buffer,
+                &first->attributes);
+        if (attribute < 0)
+            goto pack_failed;
+
+        /* Store runs of identical characters as a single character */
+        int count = guac_terminal_buffer_run_length(row, column);
+        if (count >= GUAC_TERMINAL_BUFFER_MIN_REPEAT) {
+            current = guac_terminal_buffer_write_varint(current, (count << 1) | 1);
+            current = guac_terminal_buffer_write_varint(current, attribute);
+            current = guac_terminal_buffer_write_char(current, first);
+            column += count;
+            continue;
+        }
+
+        /* Otherwise, extend span to include all following characters which
+         * share the same attributes, up to the next run */
+        count = 1;
+        while (column + count < row->length) {
+
+            const guac_terminal_char* next = &row->characters[column + count];
+
+            if (next->value < GUAC_CHAR_CONTINUATION || next->width < 0) {
+                guac_terminal_buffer_release_attributes(buffer, attribute);
+                goto pack_failed;
+            }
+
+            if (!guac_terminal_attributes_equal(&first->attributes, &next->attributes)
+                    || guac_terminal_buffer_run_length(row, column + count)
+                        >= GUAC_TERMINAL_BUFFER_MIN_REPEAT)
+                break;
+
+            count++;
+
+        }
+
+        current = guac_terminal_buffer_write_varint(current, count << 1);
+        current = guac_terminal_buffer_write_varint(current, attribute);
+        for (int i = 0; i < count; i++)
+            current = guac_terminal_buffer_write_char(current, &row->characters[column + i]);
+
+        column += count;
+
+    }
+
+    /* Replace characters with packed representation */
+    size_t size = current - buffer->pack_buffer;
+    row->packed = guac_mem_alloc(size);
+    memcpy(row->packed, buffer->pack_buffer, size);
+
+    guac_mem_free(row->characters);
+    row->characters = NULL;
+    row->available = 0;
+    return;
+
+pack_failed:
+
+    /* Release the attributes of all spans packed thus far */
+    guac_terminal_buffer_release_spans(buffer, buffer->pack_buffer, current);
+
+}
+
+/**
+ * Unpacks the given row, restoring its array of characters from the
+ * representation produced by guac_terminal_buffer_pack_row(). If the row is
+ * not packed, this function has no effect.
+ *
+ * @param buffer
+ *     The buffer containing the row.
+ *
+ * @param row
+ *     The row to unpack.
+ */
+static void guac_terminal_buffer_unpack_row(guac_terminal_buffer* buffer,
+        guac_terminal_buffer_row* row) {
+
+    if (row->packed == NULL)
+        return;
+
+    row->available = row->length;
+    row->characters = guac_mem_alloc(sizeof(guac_terminal_char), row->available);
+
+    const unsigned char* current = row->packed;
+    guac_terminal_char* character = row->characters;
+
+    int column = 0;
+    while (column < row->length) {
+
+        unsigned int header = guac_terminal_buffer_read_varint(&current);
+        unsigned int attribute = guac_terminal_buffer_read_varint(&current);
+
+        int count = header >> 1;
+        GUAC_ASSERT(count <= row->length - column);
+        GUAC_ASSERT(attribute < buffer->attribute_count);
+
+        /* The span no longer refers to the attribute table once unpacked */
+        guac_terminal_buffer_release_attributes(buffer, attribute);
+
+        /* Expand single repeated character */
+        if (header & 1) {
+            guac_terminal_buffer_read_char(&current, character);
+            character->attributes = buffer->attributes[attribute];
+            for (int i = 1; i < count; i++)
+                character[i] = *character;
+        }
+
+        /* Read each character */
+        else {
+            for (int i = 0; i < count; i++) {
+                guac_terminal_buffer_read_char(&current, &character[i]);
+                character[i].attributes = buffer->attributes[attribute];
+            }
+        }
+
+        character += count;
+        column += count;
+
+    }
+
+    guac_mem_free(row->packed);
+    row->packed = NULL;
+
 }
 
 /**
- * Returns the row at the given location. The row returned is guaranteed to be at least the given
- * width.
+ * Returns the row at the given location without unpacking that row.
  *
  * @param buffer
  *     The buffer to retrieve a row from.
@@ -174,17 +593,89 @@ void guac_terminal_buffer_reset(guac_terminal_buffer* buffer) {
  * @return
  *     The buffer row at the given location, or NULL if there is no such row.
  */
-static guac_terminal_buffer_row* guac_terminal_buffer_get_row(guac_terminal_buffer* buffer, int row) {
+static guac_terminal_buffer_row* guac_terminal_buffer_get_row_packed(guac_terminal_buffer* buffer, int row) {
 
     if (abs(row) >= buffer->available)
         return NULL;
 
     /* Normalize row index into a scrollback buffer index */
-    unsigned int index = (buffer->top + row) % buffer->available;
+    unsigned int index = (buffer->top + row + buffer->available) % buffer->available;
     return &(buffer->rows[index]);
 
 }
 
+/**
+ * Records that the given row has been unpacked due to being accessed,
+ * packing the least-recently unpacked row again if too many rows have been
+ * unpacked this way. Rows are packed again only if they are still within the
+ * scrollback buffer and have not been accessed recently.
+ *
+ * @param buffer
+ *     The buffer containing the row.
+ *
+ * @param index
+ *     The index of the unpacked row within the rows array of the buffer.
+ */
+static void guac_terminal_buffer_track_unpacked(guac_terminal_buffer* buffer,
+        int index) {
+
+    int evicted = buffer->unpacked[buffer->next_unpacked];
+    buffer->unpacked[buffer->next_unpacked] = index;
+    buffer->next_unpacked = (buffer->next_unpacked + 1) % GUAC_TERMINAL_BUFFER_MAX_UNPACKED;
+
+    if (evicted < 0 || evicted == index)
+        return;
+
+    guac_terminal_buffer_row* row = &buffer->rows[evicted];
+
+    /* Rows on screen (from top through top + height - 1) are never packed */
+    unsigned int offset = (evicted - buffer->top + buffer->available) % buffer->available;
+    if (offset < buffer->height)
+        return;
+
+    /* Determine how far past the last visible row (into the scrollback) the
+     * row currently is, with the row immediately above the display at depth
+     * 1 */
+    unsigned int depth = buffer->available - offset;
+
+    if (depth >= GUAC_TERMINAL_BUFFER_HOT_ROWS
+            && buffer->accesses - row->last_access >= GUAC_TERMINAL_BUFFER_MAX_UNPACKED)
+        guac_terminal_buffer_pack_row(buffer, row);
+
+}
+
+/**
+ * Returns the row at the given location, unpacking that row if necessary. The
+ * row returned is guaranteed to be at least the given width.
+ *
+ * @param buffer
+ *     The buffer to retrieve a row from.
+ *
+ * @param row
+ *     The index of the row to retrieve, where zero is the top-most row.
+ *     Negative indices represent rows in the scrollback buffer, above the
+ *     top-most row.
+ *
+ * @return
+ *     The buffer row at the given location, or NULL if there is no such row.
+ */
+static guac_terminal_buffer_row* guac_terminal_buffer_get_row(guac_terminal_buffer* buffer, int row) {
+
+    guac_terminal_buffer_row* buffer_row = guac_terminal_buffer_get_row_packed(buffer, row);
+    if (buffer_row == NULL)
+        return NULL;
+
+    buffer_row->last_access = ++buffer->accesses;
+
+    if (buffer_row->packed != NULL) {
+        guac_terminal_buffer_unpack_row(buffer, buffer_row);
+        guac_terminal_buffer_track_unpacked(buffer, buffer_row - buffer->rows);
+    }
+
+    return buffer_row;
+
+}
+
 /**
  * Rounds the given value up to the nearest possible row length. To avoid
  * unnecessary, repeated resizing of rows, each row length is rounded up to the
@@ -413,7 +904,8 @@ void guac_terminal_buffer_copy_rows(guac_terminal_buffer* buffer,
         GUAC_ASSERT(dst_row->length >= src_row->length);
 
         /* Copy data */
-        memcpy(dst_row->characters, src_row->characters, guac_mem_ckd_mul_or_die(sizeof(guac_terminal_char), src_row->length));
+        if (src_row->length > 0)
+            memcpy(dst_row->characters, src_row->characters, guac_mem_ckd_mul_or_die(sizeof(guac_terminal_char), src_row->length));
         dst_row->length = src_row->length;
         dst_row->wrapped_row = src_row->wrapped_row;
 
@@ -438,6 +930,27 @@ void guac_terminal_buffer_scroll_up(guac_terminal_buffer* buffer, int amount) {
     if (buffer->length > buffer->available)
         buffer->length = buffer->available;
 
+    /* Pack any rows that have now scrolled far enough into the scrollback
+     * that they are unlikely to be needed again soon */
+    int first = GUAC_TERMINAL_BUFFER_HOT_ROWS;
+    int last = GUAC_TERMINAL_BUFFER_HOT_ROWS + amount - 1;
+    if (last >= buffer->available)
+        last = buffer->available - 1;
+
+    for (int depth = first; depth <= last; depth++) {
+
+        /* Rows on screen are never packed, even if the buffer is so small
+         * relative to the display that going that far into the scrollback
+         * wraps around to the display */
+        if (buffer->available - depth < buffer->height)
+            continue;
+
+        guac_terminal_buffer_row* row = guac_terminal_buffer_get_row_packed(buffer, -depth);
+        if (row != NULL)
+            guac_terminal_buffer_pack_row(buffer, row);
+
+    }
+
 }
 
 void guac_terminal_buffer_scroll_down(guac_terminal_buffer* buffer, int amount) {
@@ -445,7 +958,9 @@ void guac_terminal_buffer_scroll_down(guac_terminal_buffer* buffer, int amount)
     if (amount <= 0)
         return;
 
-    buffer->top = (buffer->top - amount) % buffer->available;
+    /* NOTE: The top index is unsigned and must not be allowed to wrap */
+    amount %= buffer->available;
+    buffer->top = (buffer->top + buffer->available - amount) % buffer->available;
 
 }
 
@@ -519,6 +1034,40 @@ void guac_terminal_buffer_set_columns(guac_terminal_buffer* buffer, int row,
 
 }
 
+void guac_terminal_buffer_set_characters(guac_terminal_buffer* buffer, int row,
+        int start_column, const guac_terminal_char* characters, int length) {
+
+    /* Do nothing if there's nothing to do or if nothing sanely can be done
+     * (row is impossibly large) */
+    if (length <= 0 || row >= GUAC_TERMINAL_MAX_ROWS || row <= -GUAC_TERMINAL_MAX_ROWS)
+        return;
+
+    /* Do nothing if there is no such row within the buffer */
+    guac_terminal_buffer_row* buffer_row = guac_terminal_buffer_get_row(buffer, row);
+    if (buffer_row == NULL)
+        return;
+
+    start_column = guac_terminal_fit_to_range(start_column, 0, GUAC_TERMINAL_MAX_COLUMNS - 1);
+    int end_column = guac_terminal_fit_to_range(start_column + length - 1,
+            start_column, GUAC_TERMINAL_MAX_COLUMNS - 1);
+
+    guac_terminal_buffer_row_expand(buffer_row, end_column + 1, &buffer->default_character);
+    GUAC_ASSERT(buffer_row->length >= end_column + 1);
+
+    memcpy(&(buffer_row->characters[start_column]), characters,
+            guac_mem_ckd_mul_or_die(sizeof(guac_terminal_char),
+                end_column - start_column + 1));
+
+    /* Update length depending on row written */
+    if (row >= buffer->length)
+        buffer->length = row + 1;
+
+    /* Force breaks around destination region */
+    guac_terminal_buffer_force_break(buffer, row, start_column);
+    guac_terminal_buffer_force_break(buffer, row, end_column + 1);
+
+}
+
 void guac_terminal_buffer_set_cursor(guac_terminal_buffer* buffer, int row,
         int column, bool is_cursor) {
 
@@ -541,6 +1090,10 @@ void guac_terminal_buffer_set_cursor(guac_terminal_buffer* buffer, int row,
 
 }
 
+void guac_terminal_buffer_set_height(guac_terminal_buffer* buffer, int height) {
+    buffer->height = height;
+}
+
 unsigned int guac_terminal_buffer_effective_length(guac_terminal_buffer* buffer, int scrollback) {
 
     /* If the buffer contains more rows than requested, pretend it only
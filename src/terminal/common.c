@@ -91,6 +91,25 @@ bool guac_terminal_has_glyph(int codepoint) {
         && codepoint != GUAC_CHAR_CONTINUATION;
 }
 
+bool guac_terminal_attributes_equal(const guac_terminal_attributes* a,
+        const guac_terminal_attributes* b) {
+
+    return a->bold        == b->bold
+        && a->half_bright == b->half_bright
+        && a->cursor      == b->cursor
+        && a->reverse     == b->reverse
+        && a->underscore  == b->underscore
+        && a->foreground.palette_index == b->foreground.palette_index
+        && a->foreground.red           == b->foreground.red
+        && a->foreground.green         == b->foreground.green
+        && a->foreground.blue          == b->foreground.blue
+        && a->background.palette_index == b->background.palette_index
+        && a->background.red           == b->background.red
+        && a->background.green         == b->background.green
+        && a->background.blue          == b->background.blue;
+
+}
+
 int guac_terminal_write_all(int fd, const char* buffer, int size) {
 
     int remaining = size;
@@ -17,15 +17,17 @@
  * under the License.
  */
 
-#include "common/surface.h"
 #include "terminal/common.h"
 #include "terminal/display.h"
+#include "terminal/glyph-cache.h"
 #include "terminal/palette.h"
 #include "terminal/terminal.h"
 #include "terminal/terminal-priv.h"
 #include "terminal/types.h"
 
+#include <inttypes.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
@@ -34,8 +36,10 @@
 #include <glib-object.h>
 #include <guacamole/assert.h>
 #include <guacamole/client.h>
+#include <guacamole/display.h>
 #include <guacamole/mem.h>
 #include <guacamole/protocol.h>
+#include <guacamole/rect.h>
 #include <guacamole/socket.h>
 #include <pango/pangocairo.h>
 
@@ -98,12 +102,60 @@ int __guac_terminal_set_colors(guac_terminal_display* display,
 
 }
 
+/**
+ * Copies the given rendered glyph into the display layer at the given row and
+ * column. Any part of the glyph which would extend beyond the bounds of the
+ * display layer is clipped.
+ *
+ * @param display
+ *     The terminal display being drawn to.
+ *
+ * @param context
+ *     The raw context of the display layer of the given terminal display.
+ *
+ * @param row
+ *     The row at which the glyph should be drawn.
+ *
+ * @param col
+ *     The column at which the glyph should be drawn.
+ *
+ * @param surface
+ *     The rendered glyph, as an RGB24 Cairo image surface.
+ */
+static void __guac_terminal_put_glyph(guac_terminal_display* display,
+        guac_display_layer_raw_context* context, int row, int col,
+        cairo_surface_t* surface) {
+
+    guac_rect dst;
+    guac_rect_init(&dst,
+            display->char_width * col,
+            display->char_height * row,
+            cairo_image_surface_get_width(surface),
+            cairo_image_surface_get_height(surface));
+
+    guac_rect_constrain(&dst, &context->bounds);
+    if (guac_rect_is_empty(&dst))
+        return;
+
+    /* Glyphs are always RGB24, matching the format of the opaque display
+     * layer, and can thus be copied directly */
+    cairo_surface_flush(surface);
+    guac_display_layer_raw_context_put(context, &dst,
+            cairo_image_surface_get_data(surface),
+            cairo_image_surface_get_stride(surface));
+
+}
+
 /**
  * Sends the given character to the terminal at the given row and column,
  * rendering the character immediately. This bypasses the guac_terminal_display
- * mechanism and is intended for flushing of updates only.
+ * mechanism and is intended for flushing of updates only. Glyphs are rendered
+ * only if not already present in the glyph cache of the display, and are
+ * added to that cache once rendered.
  */
-int __guac_terminal_set(guac_terminal_display* display, int row, int col, int codepoint) {
+int __guac_terminal_set(guac_terminal_display* display,
+        guac_display_layer_raw_context* context, int row, int col,
+        int codepoint) {
 
     int width;
 
@@ -133,6 +185,15 @@ int __guac_terminal_set(guac_terminal_display* display, int row, int col, int co
     if (width == 0)
         return 0;
 
+    /* Reuse previous rendering of the same glyph if possible */
+    surface = guac_terminal_glyph_cache_get(display->glyph_cache,
+            codepoint, color, background);
+
+    if (surface != NULL) {
+        __guac_terminal_put_glyph(display, context, row, col, surface);
+        return 0;
+    }
+
     /* Convert to UTF-8 */
     bytes = guac_terminal_encode_utf8(codepoint, utf8);
 
@@ -189,15 +250,13 @@ int __guac_terminal_set(guac_terminal_display* display, int row, int col, int co
     pango_cairo_show_layout(cairo, layout);
 
     /* Draw */
-    guac_common_surface_draw(display->display_surface,
-        display->char_width * col,
-        display->char_height * row,
-        surface);
+    __guac_terminal_put_glyph(display, context, row, col, surface);
 
-    /* Free all */
+    /* Free all except the rendered glyph, which is retained by the cache */
     g_object_unref(layout);
     cairo_destroy(cairo);
-    cairo_surface_destroy(surface);
+    guac_terminal_glyph_cache_put(display->glyph_cache,
+            codepoint, color, background, surface);
 
     return 0;
 
@@ -216,39 +275,131 @@ static int get_margin_by_dpi(int dpi) {
     return dpi * GUAC_TERMINAL_MARGINS / GUAC_TERMINAL_MM_PER_INCH;
 }
 
+/**
+ * Marks the given range of columns within the given row as possibly
+ * containing pending operations, such that those operations are considered
+ * when the display is next flushed.
+ *
+ * @param display
+ *     The terminal display containing the operations.
+ *
+ * @param row
+ *     The row containing the operations. This must be within the bounds of
+ *     the display.
+ *
+ * @param start_column
+ *     The first column of the range to mark, inclusive.
+ *
+ * @param end_column
+ *     The last column of the range to mark, inclusive.
+ */
+static void guac_terminal_display_mark_dirty(guac_terminal_display* display,
+        int row, int start_column, int end_column) {
+
+    uint64_t* word = &display->dirty_rows[row / 64];
+    uint64_t bit = UINT64_C(1) << (row % 64);
+
+    /* Begin new range if row was previously clean */
+    if (!(*word & bit)) {
+        *word |= bit;
+        display->dirty_left[row] = start_column;
+        display->dirty_right[row] = end_column;
+        return;
+    }
+
+    /* Otherwise, extend existing range */
+    if (start_column < display->dirty_left[row])
+        display->dirty_left[row] = start_column;
+
+    if (end_column > display->dirty_right[row])
+        display->dirty_right[row] = end_column;
+
+}
+
+/**
+ * Returns the first row at or after the given row which may contain pending
+ * operations, skipping any clean rows.
+ *
+ * @param display
+ *     The terminal display containing the operations.
+ *
+ * @param row
+ *     The row to begin searching at.
+ *
+ * @return
+ *     The first row at or after the given row which may contain pending
+ *     operations, or the height of the display if there are no such rows.
+ */
+static int guac_terminal_display_next_dirty_row(guac_terminal_display* display,
+        int row) {
+
+    while (row < display->height) {
+
+        /* Skip entire words of clean rows at once */
+        uint64_t word = display->dirty_rows[row / 64] >> (row % 64);
+        if (word == 0) {
+            row = (row / 64 + 1) * 64;
+            continue;
+        }
+
+        while (!(word & 1)) {
+            word >>= 1;
+            row++;
+        }
+
+        return row;
+
+    }
+
+    return display->height;
+
+}
+
+/**
+ * Marks all rows of the display as clean. This must only be invoked once all
+ * pending operations have been flushed.
+ *
+ * @param display
+ *     The terminal display to mark as clean.
+ */
+static void guac_terminal_display_clear_dirty(guac_terminal_display* display) {
+    memset(display->dirty_rows, 0, sizeof(uint64_t) * ((display->height + 63) / 64));
+}
+
 guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
         const char* font_name, int font_size, int dpi,
         guac_terminal_color* foreground, guac_terminal_color* background,
-        guac_terminal_color (*palette)[256]) {
+        guac_terminal_color (*palette)[256], size_t glyph_cache_size) {
 
     /* Allocate display */
     guac_terminal_display* display = guac_mem_alloc(sizeof(guac_terminal_display));
     display->client = client;
 
+    /* Initially no glyphs have been rendered */
+    display->glyph_cache = guac_terminal_glyph_cache_alloc(glyph_cache_size);
+
     /* Initially no font loaded */
     display->font_desc = NULL;
     display->char_width = 0;
     display->char_height = 0;
 
-    /* Create default surface */
-    display->display_layer = guac_client_alloc_layer(client);
-    display->select_layer = guac_client_alloc_layer(client);
-    display->display_surface = guac_common_surface_alloc(client,
-            client->socket, display->display_layer, 0, 0);
+    /* Create display and its layers */
+    display->graphical_display = guac_display_alloc(client);
+    display->display_layer = guac_display_alloc_layer(display->graphical_display, 1);
+    display->select_layer = guac_display_alloc_layer(display->graphical_display, 0);
 
     /* Never use lossy compression for terminal contents */
-    guac_common_surface_set_lossless(display->display_surface, 1);
+    guac_display_layer_set_lossless(display->display_layer, 1);
+    guac_display_layer_set_lossless(display->select_layer, 1);
 
     /* Select layer is a child of the display layer */
-    guac_protocol_send_move(client->socket, display->select_layer,
-            display->display_layer, 0, 0, 0);
+    guac_display_layer_set_parent(display->select_layer, display->display_layer);
 
     /* Calculate margin size by DPI */
     display->margin = get_margin_by_dpi(dpi);
 
     /* Offset the Default Layer to make margins even on all sides */
-    guac_protocol_send_move(client->socket, display->display_layer,
-        GUAC_DEFAULT_LAYER, display->margin, display->margin, 0);
+    guac_display_layer_move(display->display_layer, display->margin, display->margin);
 
     display->default_foreground = display->glyph_foreground = *foreground;
     display->default_background = display->glyph_background = *background;
@@ -259,6 +410,9 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     display->height = 0;
     display->operations = NULL;
     display->unflushed_set = false;
+    display->dirty_rows = NULL;
+    display->dirty_left = NULL;
+    display->dirty_right = NULL;
 
     /* Initially nothing selected */
     display->text_selected = false;
@@ -267,6 +421,8 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     if (guac_terminal_display_set_font(display, font_name, font_size, dpi)) {
         guac_client_abort(display->client, GUAC_PROTOCOL_STATUS_SERVER_ERROR,
                 "Unable to set initial font \"%s\"", font_name);
+        guac_terminal_glyph_cache_free(display->glyph_cache);
+        guac_display_free(display->graphical_display);
         guac_mem_free(display);
         return NULL;
     }
@@ -277,6 +433,13 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
 
 void guac_terminal_display_free(guac_terminal_display* display) {
 
+    guac_client_log(display->client, GUAC_LOG_DEBUG, "Terminal glyph cache: "
+            "%" PRIu64 " hit(s), %" PRIu64 " miss(es).",
+            display->glyph_cache->hits, display->glyph_cache->misses);
+
+    /* Free all cached glyphs */
+    guac_terminal_glyph_cache_free(display->glyph_cache);
+
     /* Free font description */
     pango_font_description_free(display->font_desc);
 
@@ -285,6 +448,12 @@ void guac_terminal_display_free(guac_terminal_display* display) {
 
     /* Free operations buffers */
     guac_mem_free(display->operations);
+    guac_mem_free(display->dirty_rows);
+    guac_mem_free(display->dirty_left);
+    guac_mem_free(display->dirty_right);
+
+    /* Free underlying display and all of its layers */
+    guac_display_free(display->graphical_display);
 
     /* Free display */
     guac_mem_free(display);
@@ -399,6 +568,9 @@ void guac_terminal_display_copy_columns(guac_terminal_display* display, int row,
 
     }
 
+    guac_terminal_display_mark_dirty(display, row,
+            start_column + offset, end_column + offset);
+
 }
 
 void guac_terminal_display_copy_rows(guac_terminal_display* display,
@@ -464,6 +636,9 @@ void guac_terminal_display_copy_rows(guac_terminal_display* display,
 
         }
 
+        guac_terminal_display_mark_dirty(display, row + offset,
+                0, display->width - 1);
+
         /* Next row */
         dst += display->width;
 
@@ -506,6 +681,8 @@ void guac_terminal_display_set_columns(guac_terminal_display* display, int row,
 
     }
 
+    guac_terminal_display_mark_dirty(display, row, start_column, end_column);
+
     /* Marks whether there are unflushed GUAC_CHAR_SET operations when the
      * operation is not on the first or last row because flushing new lines
      * added has a high performance cost. This flag is used to determine
@@ -569,27 +746,93 @@ void guac_terminal_display_resize(guac_terminal_display* display, int width, int
     display->width = width;
     display->height = height;
 
-    /* Send display size */
-    guac_common_surface_resize(
-            display->display_surface,
+    /* Reallocate dirty tracking, considering all rows dirty, as any row may
+     * now contain operations clearing newly-exposed space */
+    guac_mem_free(display->dirty_rows);
+    guac_mem_free(display->dirty_left);
+    guac_mem_free(display->dirty_right);
+
+    display->dirty_rows = guac_mem_zalloc(sizeof(uint64_t), (height + 63) / 64 + 1);
+    display->dirty_left = guac_mem_alloc(sizeof(int), height + 1);
+    display->dirty_right = guac_mem_alloc(sizeof(int), height + 1);
+
+    for (int y = 0; y < height; y++)
+        guac_terminal_display_mark_dirty(display, y, 0, width - 1);
+
+    /* Resize display layers */
+    guac_display_layer_resize(display->display_layer,
             display->char_width  * width,
             display->char_height * height);
 
-    guac_protocol_send_size(display->client->socket,
-            display->select_layer,
+    guac_display_layer_resize(display->select_layer,
             display->char_width  * width,
             display->char_height * height);
 
 }
 
-void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
+/**
+ * Copies the given rectangle of the given raw context to the given
+ * destination coordinates within the same context, correctly handling any
+ * overlap between the source and destination rectangles. The rectangle and
+ * its destination must both be within the bounds of the context.
+ *
+ * @param context
+ *     The raw context of the layer being drawn to.
+ *
+ * @param src
+ *     The rectangle to copy.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle.
+ */
+static void __guac_terminal_display_raw_copy(guac_display_layer_raw_context* context,
+        const guac_rect* src, int x, int y) {
+
+    guac_rect dst;
+    guac_rect_init(&dst, x, y, guac_rect_width(src), guac_rect_height(src));
+
+    size_t length = guac_mem_ckd_mul_or_die(guac_rect_width(src), GUAC_DISPLAY_LAYER_RAW_BPP);
+    int height = guac_rect_height(src);
+
+    unsigned char* src_row = GUAC_DISPLAY_LAYER_RAW_BUFFER(context, *src);
+    unsigned char* dst_row = GUAC_DISPLAY_LAYER_RAW_BUFFER(context, dst);
+
+    /* Copy rows from the bottom up if the destination is below the source,
+     * such that no row is overwritten before it has been copied */
+    ptrdiff_t step = context->stride;
+    if (dst.top > src->top) {
+        src_row += (height - 1) * step;
+        dst_row += (height - 1) * step;
+        step = -step;
+    }
+
+    for (int i = 0; i < height; i++) {
+        memmove(dst_row, src_row, length);
+        src_row += step;
+        dst_row += step;
+    }
+
+    guac_rect_extend(&context->dirty, &dst);
+
+}
+
+void __guac_terminal_display_flush_copy(guac_terminal_display* display,
+        guac_display_layer_raw_context* context) {
 
-    guac_terminal_operation* current = display->operations;
     int row, col;
 
-    /* For each operation */
-    for (row=0; row<display->height; row++) {
-        for (col=0; col<display->width; col++) {
+    /* For each operation within each row that may have pending operations */
+    for (row = guac_terminal_display_next_dirty_row(display, 0);
+            row < display->height;
+            row = guac_terminal_display_next_dirty_row(display, row + 1)) {
+
+        guac_terminal_operation* current = &(display->operations[
+                row * display->width + display->dirty_left[row]]);
+
+        for (col = display->dirty_left[row]; col <= display->dirty_right[row]; col++) {
 
             /* If operation is a copy operation */
             if (current->type == GUAC_CHAR_COPY) {
@@ -684,16 +927,15 @@ void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
 
                 }
 
-                /* Send copy */
-                guac_common_surface_copy(
-
-                        display->display_surface,
+                /* Perform copy */
+                guac_rect src;
+                guac_rect_init(&src,
                         current->column * display->char_width,
                         current->row * display->char_height,
                         rect_width * display->char_width,
-                        rect_height * display->char_height,
+                        rect_height * display->char_height);
 
-                        display->display_surface,
+                __guac_terminal_display_raw_copy(context, &src,
                         col * display->char_width,
                         row * display->char_height);
 
@@ -707,14 +949,20 @@ void __guac_terminal_display_flush_copy(guac_terminal_display* display) {
 
 }
 
-void __guac_terminal_display_flush_clear(guac_terminal_display* display) {
+void __guac_terminal_display_flush_clear(guac_terminal_display* display,
+        guac_display_layer_raw_context* context) {
 
-    guac_terminal_operation* current = display->operations;
     int row, col;
 
-    /* For each operation */
-    for (row=0; row<display->height; row++) {
-        for (col=0; col<display->width; col++) {
+    /* For each operation within each row that may have pending operations */
+    for (row = guac_terminal_display_next_dirty_row(display, 0);
+            row < display->height;
+            row = guac_terminal_display_next_dirty_row(display, row + 1)) {
+
+        guac_terminal_operation* current = &(display->operations[
+                row * display->width + display->dirty_left[row]]);
+
+        for (col = display->dirty_left[row]; col <= display->dirty_right[row]; col++) {
 
             /* If operation is a clear operation (set to space) */
             if (current->type == GUAC_CHAR_SET &&
@@ -821,15 +1069,20 @@ void __guac_terminal_display_flush_clear(guac_terminal_display* display) {
 
                 }
 
-                /* Send rect */
-                guac_common_surface_set(
-                        display->display_surface,
+                /* Fill rect */
+                guac_rect rect;
+                guac_rect_init(&rect,
                         col * display->char_width,
                         row * display->char_height,
                         rect_width * display->char_width,
-                        rect_height * display->char_height,
-                        color.red, color.green, color.blue,
-                        0xFF);
+                        rect_height * display->char_height);
+
+                guac_rect_constrain(&rect, &context->bounds);
+                guac_display_layer_raw_context_set(context, &rect,
+                        0xFF000000
+                        | (color.red   << 16)
+                        | (color.green << 8)
+                        |  color.blue);
 
             } /* end if clear operation */
 
@@ -841,14 +1094,23 @@ void __guac_terminal_display_flush_clear(guac_terminal_display* display) {
 
 }
 
-void __guac_terminal_display_flush_set(guac_terminal_display* display) {
+void __guac_terminal_display_flush_set(guac_terminal_display* display,
+        guac_display_layer_raw_context* context) {
+
+    /* The attributes most recently applied with __guac_terminal_set_colors() */
+    const guac_terminal_attributes* run_attributes = NULL;
 
-    guac_terminal_operation* current = display->operations;
     int row, col;
 
-    /* For each operation */
-    for (row=0; row<display->height; row++) {
-        for (col=0; col<display->width; col++) {
+    /* For each operation within each row that may have pending operations */
+    for (row = guac_terminal_display_next_dirty_row(display, 0);
+            row < display->height;
+            row = guac_terminal_display_next_dirty_row(display, row + 1)) {
+
+        guac_terminal_operation* current = &(display->operations[
+                row * display->width + display->dirty_left[row]]);
+
+        for (col = display->dirty_left[row]; col <= display->dirty_right[row]; col++) {
 
             /* Perform given operation */
             if (current->type == GUAC_CHAR_SET) {
@@ -859,12 +1121,17 @@ void __guac_terminal_display_flush_set(guac_terminal_display* display) {
                 if (!guac_terminal_has_glyph(codepoint))
                     codepoint = ' ';
 
-                /* Set attributes */
-                __guac_terminal_set_colors(display,
-                        &(current->character.attributes));
+                /* Set attributes only once for each run of characters
+                 * sharing the same attributes */
+                if (run_attributes == NULL || !guac_terminal_attributes_equal(
+                            run_attributes, &current->character.attributes)) {
+                    __guac_terminal_set_colors(display,
+                            &(current->character.attributes));
+                    run_attributes = &(current->character.attributes);
+                }
 
                 /* Send character */
-                __guac_terminal_set(display, row, col, codepoint);
+                __guac_terminal_set(display, context, row, col, codepoint);
 
                 /* Mark operation as handled */
                 current->type = GUAC_CHAR_NOP;
@@ -877,56 +1144,84 @@ void __guac_terminal_display_flush_set(guac_terminal_display* display) {
         }
     }
 
+    /* All operations have now been flushed */
+    guac_terminal_display_clear_dirty(display);
+
     /* Mark that all SET operations have been flushed */
     display->unflushed_set = 0;
 
 }
+
 void guac_terminal_display_flush_operations(guac_terminal_display* display) {
 
+    guac_display_layer_raw_context* context =
+        guac_display_layer_open_raw(display->display_layer);
+
     /* Flush operations, copies first, then clears, then sets. */
-    __guac_terminal_display_flush_copy(display);
-    __guac_terminal_display_flush_clear(display);
-    __guac_terminal_display_flush_set(display);
+    __guac_terminal_display_flush_copy(display, context);
+    __guac_terminal_display_flush_clear(display, context);
+    __guac_terminal_display_flush_set(display, context);
+
+    guac_display_layer_close_raw(display->display_layer, context);
 
 }
 
 void guac_terminal_display_flush(guac_terminal_display* display) {
 
-    /* Flush operations */
+    /* Flush operations (the changes will be sent when the frame ends) */
     guac_terminal_display_flush_operations(display);
 
-    /* Flush surface */
-    guac_common_surface_flush(display->display_surface);
-
 }
 
 void guac_terminal_display_dup(
         guac_terminal_display* display, guac_client* client, guac_socket* socket) {
 
-    /* Create default surface */
-    guac_common_surface_dup(display->display_surface, client, socket);
+    /* Sync all layers, including their positions and hierarchy */
+    guac_display_dup(display->graphical_display, socket);
 
-    /* Select layer is a child of the display layer */
-    guac_protocol_send_move(socket, display->select_layer,
-            display->display_layer, 0, 0, 0);
+}
 
-    /* Offset the Default Layer to make margins even on all sides */
-    guac_protocol_send_move(socket, display->display_layer,
-        GUAC_DEFAULT_LAYER, display->margin, display->margin, 0);
+/**
+ * The color of the highlight drawn over selected text, as a 32-bit ARGB value
+ * with premultiplied alpha. This is a translucent blue (0x0080FF at 0x60
+ * alpha).
+ */
+#define GUAC_TERMINAL_SELECTION_COLOR 0x60003060
 
-    /* Send select layer size */
-    guac_protocol_send_size(socket, display->select_layer,
-            display->char_width  * display->width,
-            display->char_height * display->height);
+/**
+ * Highlights the given rectangle within the select layer.
+ *
+ * @param context
+ *     The raw context of the select layer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle, in pixels.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle, in pixels.
+ *
+ * @param width
+ *     The width of the rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle, in pixels.
+ */
+static void __guac_terminal_display_highlight(guac_display_layer_raw_context* context,
+        int x, int y, int width, int height) {
+
+    guac_rect rect;
+    guac_rect_init(&rect, x, y, width, height);
+    guac_rect_constrain(&rect, &context->bounds);
+
+    if (!guac_rect_is_empty(&rect))
+        guac_display_layer_raw_context_set(context, &rect,
+                GUAC_TERMINAL_SELECTION_COLOR);
 
 }
 
 void guac_terminal_display_select(guac_terminal_display* display,
         int start_row, int start_col, int end_row, int end_col) {
 
-    guac_socket* socket = display->client->socket;
-    guac_layer* select_layer = display->select_layer;
-
     /* Do nothing if selection is unchanged */
     if (display->text_selected
             && display->selection_start_row    == start_row
@@ -943,6 +1238,12 @@ void guac_terminal_display_select(guac_terminal_display* display,
     display->selection_end_row = end_row;
     display->selection_end_column = end_col;
 
+    guac_display_layer_raw_context* context =
+        guac_display_layer_open_raw(display->select_layer);
+
+    /* Erase old selection */
+    guac_display_layer_raw_context_set(context, &context->bounds, 0x00000000);
+
     /* If single row, just need one rectangle */
     if (start_row == end_row) {
 
@@ -954,7 +1255,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
         }
 
         /* Select characters between columns */
-        guac_protocol_send_rect(socket, select_layer,
+        __guac_terminal_display_highlight(context,
 
                 start_col * display->char_width,
                 start_row * display->char_height,
@@ -983,7 +1284,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
         }
 
         /* First row */
-        guac_protocol_send_rect(socket, select_layer,
+        __guac_terminal_display_highlight(context,
 
                 start_col * display->char_width,
                 start_row * display->char_height,
@@ -992,7 +1293,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
                 display->char_height);
 
         /* Middle */
-        guac_protocol_send_rect(socket, select_layer,
+        __guac_terminal_display_highlight(context,
 
                 0,
                 (start_row + 1) * display->char_height,
@@ -1001,7 +1302,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
                 (end_row - start_row - 1) * display->char_height);
 
         /* Last row */
-        guac_protocol_send_rect(socket, select_layer,
+        __guac_terminal_display_highlight(context,
 
                 0,
                 end_row * display->char_height,
@@ -1011,9 +1312,7 @@ void guac_terminal_display_select(guac_terminal_display* display,
 
     }
 
-    /* Draw new selection, erasing old */
-    guac_protocol_send_cfill(socket, GUAC_COMP_SRC, select_layer,
-            0x00, 0x80, 0xFF, 0x60);
+    guac_display_layer_close_raw(display->select_layer, context);
 
 }
 
@@ -1023,12 +1322,12 @@ void guac_terminal_display_clear_select(guac_terminal_display* display) {
     if (!display->text_selected)
         return;
 
-    guac_socket* socket = display->client->socket;
-    guac_layer* select_layer = display->select_layer;
+    guac_display_layer_raw_context* context =
+        guac_display_layer_open_raw(display->select_layer);
+
+    guac_display_layer_raw_context_set(context, &context->bounds, 0x00000000);
 
-    guac_protocol_send_rect(socket, select_layer, 0, 0, 1, 1);
-    guac_protocol_send_cfill(socket, GUAC_COMP_SRC, select_layer,
-            0x00, 0x00, 0x00, 0x00);
+    guac_display_layer_close_raw(display->select_layer, context);
 
     /* Text is no longer selected */
     display->text_selected = false;
@@ -1098,6 +1397,9 @@ int guac_terminal_display_set_font(guac_terminal_display* display,
     display->font_desc = font_desc;
     pango_font_description_free(old_font_desc);
 
+    /* Glyphs rendered with the old font can no longer be used */
+    guac_terminal_glyph_cache_clear(display->glyph_cache);
+
     /* Recalculate dimensions which will fit within current surface */
     int new_width = pixel_width / display->char_width;
     int new_height = pixel_height / display->char_height;
@@ -0,0 +1,238 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal/glyph-cache.h"
+#include "terminal/palette.h"
+
+#include <cairo/cairo.h>
+#include <guacamole/mem.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Returns the given color as a 24-bit RGB value.
+ *
+ * @param color
+ *     The color to convert.
+ *
+ * @return
+ *     The given color as a 24-bit RGB value.
+ */
+static uint32_t guac_terminal_glyph_cache_rgb(const guac_terminal_color* color) {
+    return (color->red << 16) | (color->green << 8) | color->blue;
+}
+
+/**
+ * Returns the index of the hash bucket that should contain the glyph having
+ * the given codepoint and colors.
+ *
+ * @param codepoint
+ *     The codepoint of the glyph.
+ *
+ * @param foreground
+ *     The foreground color of the glyph, as a 24-bit RGB value.
+ *
+ * @param background
+ *     The background color of the glyph, as a 24-bit RGB value.
+ *
+ * @return
+ *     The index of the hash bucket that should contain the glyph.
+ */
+static unsigned int guac_terminal_glyph_cache_hash(int codepoint,
+        uint32_t foreground, uint32_t background) {
+
+    uint32_t hash = (uint32_t) codepoint * 0x9E3779B1;
+    hash ^= foreground * 0x85EBCA77;
+    hash ^= background * 0xC2B2AE3D;
+    hash ^= hash >> 16;
+
+    return hash & (GUAC_TERMINAL_GLYPH_CACHE_BUCKETS - 1);
+
+}
+
+/**
+ * Removes the given glyph from the least-recently-used list of the given
+ * cache. The glyph is NOT removed from its hash bucket.
+ *
+ * @param cache
+ *     The cache containing the glyph.
+ *
+ * @param glyph
+ *     The glyph to remove from the least-recently-used list.
+ */
+static void guac_terminal_glyph_cache_unlink(guac_terminal_glyph_cache* cache,
+        guac_terminal_glyph* glyph) {
+
+    if (glyph->more_recent != NULL)
+        glyph->more_recent->less_recent = glyph->less_recent;
+    else
+        cache->most_recent = glyph->less_recent;
+
+    if (glyph->less_recent != NULL)
+        glyph->less_recent->more_recent = glyph->more_recent;
+    else
+        cache->least_recent = glyph->more_recent;
+
+    glyph->more_recent = glyph->less_recent = NULL;
+
+}
+
+/**
+ * Inserts the given glyph at the head of the least-recently-used list of the
+ * given cache, such that it is the most recently used glyph.
+ *
+ * @param cache
+ *     The cache containing the glyph.
+ *
+ * @param glyph
+ *     The glyph to mark as most recently used.
+ */
+static void guac_terminal_glyph_cache_touch(guac_terminal_glyph_cache* cache,
+        guac_terminal_glyph* glyph) {
+
+    glyph->more_recent = NULL;
+    glyph->less_recent = cache->most_recent;
+
+    if (cache->most_recent != NULL)
+        cache->most_recent->more_recent = glyph;
+    else
+        cache->least_recent = glyph;
+
+    cache->most_recent = glyph;
+
+}
+
+/**
+ * Removes the least recently used glyph from the given cache, freeing all
+ * associated memory. The cache MUST NOT be empty.
+ *
+ * @param cache
+ *     The cache to remove the least recently used glyph from.
+ */
+static void guac_terminal_glyph_cache_evict(guac_terminal_glyph_cache* cache) {
+
+    guac_terminal_glyph* glyph = cache->least_recent;
+    guac_terminal_glyph_cache_unlink(cache, glyph);
+
+    /* Remove from hash bucket */
+    guac_terminal_glyph** current = &cache->buckets[
+        guac_terminal_glyph_cache_hash(glyph->codepoint,
+                glyph->foreground, glyph->background)];
+
+    while (*current != glyph)
+        current = &(*current)->next_in_bucket;
+
+    *current = glyph->next_in_bucket;
+
+    cache->size -= glyph->size;
+    cairo_surface_destroy(glyph->surface);
+    guac_mem_free(glyph);
+
+}
+
+guac_terminal_glyph_cache* guac_terminal_glyph_cache_alloc(size_t max_size) {
+    guac_terminal_glyph_cache* cache = guac_mem_zalloc(sizeof(guac_terminal_glyph_cache));
+    cache->max_size = max_size;
+    return cache;
+}
+
+void guac_terminal_glyph_cache_free(guac_terminal_glyph_cache* cache) {
+    guac_terminal_glyph_cache_clear(cache);
+    guac_mem_free(cache);
+}
+
+void guac_terminal_glyph_cache_clear(guac_terminal_glyph_cache* cache) {
+    while (cache->least_recent != NULL)
+        guac_terminal_glyph_cache_evict(cache);
+}
+
+cairo_surface_t* guac_terminal_glyph_cache_get(guac_terminal_glyph_cache* cache,
+        int codepoint, const guac_terminal_color* foreground,
+        const guac_terminal_color* background) {
+
+    uint32_t fg = guac_terminal_glyph_cache_rgb(foreground);
+    uint32_t bg = guac_terminal_glyph_cache_rgb(background);
+
+    guac_terminal_glyph* glyph = cache->buckets[
+        guac_terminal_glyph_cache_hash(codepoint, fg, bg)];
+
+    /* Search bucket for matching glyph */
+    while (glyph != NULL) {
+
+        if (glyph->codepoint == codepoint
+                && glyph->foreground == fg
+                && glyph->background == bg) {
+
+            /* Glyph is now the most recently used */
+            guac_terminal_glyph_cache_unlink(cache, glyph);
+            guac_terminal_glyph_cache_touch(cache, glyph);
+
+            cache->hits++;
+            return glyph->surface;
+
+        }
+
+        glyph = glyph->next_in_bucket;
+
+    }
+
+    cache->misses++;
+    return NULL;
+
+}
+
+void guac_terminal_glyph_cache_put(guac_terminal_glyph_cache* cache,
+        int codepoint, const guac_terminal_color* foreground,
+        const guac_terminal_color* background, cairo_surface_t* surface) {
+
+    size_t size = sizeof(guac_terminal_glyph)
+        + (size_t) cairo_image_surface_get_stride(surface)
+        * cairo_image_surface_get_height(surface);
+
+    /* Simply drop the glyph if it cannot be cached at all */
+    if (size > cache->max_size) {
+        cairo_surface_destroy(surface);
+        return;
+    }
+
+    /* Evict least recently used glyphs until there is room */
+    while (cache->size + size > cache->max_size)
+        guac_terminal_glyph_cache_evict(cache);
+
+    guac_terminal_glyph* glyph = guac_mem_alloc(sizeof(guac_terminal_glyph));
+    glyph->codepoint = codepoint;
+    glyph->foreground = guac_terminal_glyph_cache_rgb(foreground);
+    glyph->background = guac_terminal_glyph_cache_rgb(background);
+    glyph->surface = surface;
+    glyph->size = size;
+
+    /* Add to hash table */
+    guac_terminal_glyph** bucket = &cache->buckets[
+        guac_terminal_glyph_cache_hash(codepoint,
+                glyph->foreground, glyph->background)];
+
+    glyph->next_in_bucket = *bucket;
+    *bucket = glyph;
+
+    /* New glyph is the most recently used */
+    guac_terminal_glyph_cache_touch(cache, glyph);
+    cache->size += size;
+
+}
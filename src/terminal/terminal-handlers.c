@@ -36,6 +36,13 @@
 #include <stdlib.h>
 #include <wchar.h>
 
+/**
+ * The maximum number of columns of printable characters that
+ * guac_terminal_echo_all() will accumulate before writing them to the
+ * terminal as a single run.
+ */
+#define GUAC_TERMINAL_ECHO_RUN_LENGTH 256
+
 /**
  * Response string sent when identification is requested.
  */
@@ -237,8 +244,8 @@ int guac_terminal_echo(guac_terminal* term, unsigned char c) {
 
     int width;
 
-    static int bytes_remaining = 0;
-    static int codepoint = 0;
+    int bytes_remaining = term->utf8_bytes_remaining;
+    int codepoint = term->utf8_codepoint;
 
     const int* char_mapping = term->char_mapping[term->active_char_set];
 
@@ -296,6 +303,10 @@ int guac_terminal_echo(guac_terminal* term, unsigned char c) {
         bytes_remaining = 0;
     }
 
+    /* Store decoding state for subsequent bytes */
+    term->utf8_bytes_remaining = bytes_remaining;
+    term->utf8_codepoint = codepoint;
+
     /* If we need more bytes, wait for more bytes */
     if (bytes_remaining != 0)
         return 0;
@@ -379,8 +390,15 @@ int guac_terminal_echo(guac_terminal* term, unsigned char c) {
             if (term->cursor_col >= term->term_width) {
 
                 /* New line */
-                term->cursor_col = 0;
-                guac_terminal_linefeed(term, true);
+                if (term->automatic_wrap) {
+                    term->cursor_col = 0;
+                    guac_terminal_linefeed(term, true);
+                }
+
+                /* Overwrite last column if wrapping is disabled */
+                else
+                    term->cursor_col = term->term_width - 1;
+
             }
 
             /* If insert mode, shift other characters right by 1 */
@@ -407,6 +425,172 @@ int guac_terminal_echo(guac_terminal* term, unsigned char c) {
 
 }
 
+/**
+ * Decodes the complete UTF-8 codepoint at the beginning of the given buffer,
+ * if that codepoint is a printable character that guac_terminal_echo() would
+ * simply write to the terminal.
+ *
+ * @param buffer
+ *     The buffer containing the UTF-8 data to decode.
+ *
+ * @param length
+ *     The number of bytes available within the buffer.
+ *
+ * @param codepoint
+ *     Pointer to an int which should receive the decoded codepoint.
+ *
+ * @return
+ *     The number of bytes occupied by the decoded codepoint, or zero if the
+ *     buffer does not begin with a complete, valid UTF-8 sequence for a
+ *     printable character.
+ */
+static int guac_terminal_echo_decode(const unsigned char* buffer, int length,
+        int* codepoint) {
+
+    unsigned char c = buffer[0];
+    int value;
+    int size;
+
+    /* 1-byte UTF-8 codepoint */
+    if ((c & 0x80) == 0x00) {    /* 0xxxxxxx */
+        value = c;
+        size = 1;
+    }
+
+    /* 2-byte UTF-8 codepoint */
+    else if ((c & 0xE0) == 0xC0) { /* 110xxxxx */
+        value = c & 0x1F;
+        size = 2;
+    }
+
+    /* 3-byte UTF-8 codepoint */
+    else if ((c & 0xF0) == 0xE0) { /* 1110xxxx */
+        value = c & 0x0F;
+        size = 3;
+    }
+
+    /* 4-byte UTF-8 codepoint */
+    else if ((c & 0xF8) == 0xF0) { /* 11110xxx */
+        value = c & 0x07;
+        size = 4;
+    }
+
+    /* Leave stray continuation bytes and unrecognized prefixes to
+     * guac_terminal_echo() */
+    else
+        return 0;
+
+    /* Leave incomplete codepoints to guac_terminal_echo() */
+    if (size > length)
+        return 0;
+
+    for (int i = 1; i < size; i++) {
+
+        /* Leave malformed sequences to guac_terminal_echo() */
+        c = buffer[i];
+        if ((c & 0xC0) != 0x80) /* 10xxxxxx */
+            return 0;
+
+        value = (value << 6) | (c & 0x3F);
+
+    }
+
+    /* Leave control characters to guac_terminal_echo() */
+    if (value < 0x20 || value == 0x7F || value == 0x9B)
+        return 0;
+
+    *codepoint = value;
+    return size;
+
+}
+
+int guac_terminal_echo_all(guac_terminal* term, const char* buffer,
+        int length) {
+
+    guac_terminal_char run[GUAC_TERMINAL_ECHO_RUN_LENGTH];
+    int run_length = 0;
+    int run_col = term->cursor_col;
+    int handled = 0;
+
+    /* Only plain, unmapped, non-inserting output may be handled in bulk */
+    if (term->utf8_bytes_remaining != 0
+            || term->pipe_stream != NULL
+            || term->char_mapping[term->active_char_set] != NULL
+            || term->insert_mode)
+        return 0;
+
+    while (handled < length) {
+
+        int codepoint;
+        int size = guac_terminal_echo_decode(
+                (const unsigned char*) buffer + handled,
+                length - handled, &codepoint);
+
+        /* Stop at anything that is not a printable character */
+        if (size == 0)
+            break;
+
+        /* Wrap if necessary */
+        if (term->cursor_col >= term->term_width) {
+
+            /* Leave overwriting of the last column to guac_terminal_echo() if
+             * wrapping is disabled */
+            if (!term->automatic_wrap)
+                break;
+
+            /* Write any characters preceding the wrap */
+            guac_terminal_set_characters(term, term->cursor_row, run_col,
+                    run, run_length);
+            run_length = 0;
+
+            /* New line */
+            term->cursor_col = 0;
+            guac_terminal_linefeed(term, true);
+            run_col = 0;
+
+        }
+
+        int width = wcwidth(codepoint);
+        if (width < 0)
+            width = 1;
+
+        /* Leave characters that would extend past the edge of the terminal
+         * to guac_terminal_echo() */
+        if (term->cursor_col + width > term->term_width)
+            break;
+
+        /* Write accumulated characters if there is no room for more */
+        if (run_length + width > GUAC_TERMINAL_ECHO_RUN_LENGTH) {
+            guac_terminal_set_characters(term, term->cursor_row, run_col,
+                    run, run_length);
+            run_length = 0;
+            run_col = term->cursor_col;
+        }
+
+        /* Store character and any required continuation characters (empty
+         * glyphs are not stored at all) */
+        for (int i = 0; i < width; i++) {
+            run[run_length++] = (guac_terminal_char) {
+                .value      = (i == 0) ? codepoint : GUAC_CHAR_CONTINUATION,
+                .attributes = term->current_attributes,
+                .width      = (i == 0) ? width : 0
+            };
+        }
+
+        /* Advance cursor */
+        term->cursor_col += width;
+        handled += size;
+
+    }
+
+    /* Write any remaining characters */
+    guac_terminal_set_characters(term, term->cursor_row, run_col,
+            run, run_length);
+
+    return handled;
+
+}
+
 int guac_terminal_escape(guac_terminal* term, unsigned char c) {
 
     switch (c) {
@@ -543,6 +727,7 @@ static bool* __guac_terminal_get_flag(guac_terminal* term, int num, char private
     if (private_mode == '?') {
         switch (num) {
             case 1:  return &(term->application_cursor_keys); /* DECCKM */
+            case 7:  return &(term->automatic_wrap); /* DECAWM */
             case 25: return &(term->cursor_visible); /* DECTECM */
         }
     }
@@ -18,7 +18,6 @@
  */
 
 #include "common/clipboard.h"
-#include "common/cursor.h"
 #include "common/iconv.h"
 #include "terminal/buffer.h"
 #include "terminal/color-scheme.h"
@@ -44,6 +43,7 @@
 #include <wchar.h>
 
 #include <guacamole/client.h>
+#include <guacamole/display.h>
 #include <guacamole/error.h>
 #include <guacamole/flag.h>
 #include <guacamole/mem.h>
@@ -120,6 +120,8 @@ void guac_terminal_reset(guac_terminal* term) {
 
     /* Set current state */
     term->char_handler = guac_terminal_echo; 
+    term->utf8_bytes_remaining = 0;
+    term->utf8_codepoint = 0;
     term->active_char_set = 0;
     term->char_mapping[0] =
     term->char_mapping[1] = NULL;
@@ -144,6 +146,7 @@ void guac_terminal_reset(guac_terminal* term) {
     term->selection_committed = false;
     term->application_cursor_keys = false;
     term->automatic_carriage_return = false;
+    term->automatic_wrap = true;
     term->insert_mode = false;
 
     /* Reset tabs */
@@ -172,28 +175,27 @@ void guac_terminal_reset(guac_terminal* term) {
  *
  * @param terminal
  *     The terminal whose background should be painted or repainted.
- *
- * @param socket
- *     The socket over which instructions required to paint / repaint the
- *     terminal background should be send.
  */
-static void guac_terminal_repaint_default_layer(guac_terminal* terminal,
-        guac_socket* socket) {
+static void guac_terminal_repaint_default_layer(guac_terminal* terminal) {
 
-    int width = terminal->width;
-    int height = terminal->height;
     guac_terminal_display* display = terminal->display;
+    guac_display_layer* default_layer =
+        guac_display_default_layer(display->graphical_display);
 
     /* Get background color */
     const guac_terminal_color* color = &display->default_background;
 
     /* Reset size */
-    guac_protocol_send_size(socket, GUAC_DEFAULT_LAYER, width, height);
+    guac_display_layer_resize(default_layer, terminal->width, terminal->height);
 
     /* Paint background color */
-    guac_protocol_send_rect(socket, GUAC_DEFAULT_LAYER, 0, 0, width, height);
-    guac_protocol_send_cfill(socket, GUAC_COMP_OVER, GUAC_DEFAULT_LAYER,
-            color->red, color->green, color->blue, 0xFF);
+    guac_display_layer_raw_context* context = guac_display_layer_open_raw(default_layer);
+    guac_display_layer_raw_context_set(context, &context->bounds,
+            0xFF000000
+            | (color->red   << 16)
+            | (color->green << 8)
+            |  color->blue);
+    guac_display_layer_close_raw(default_layer, context);
 
 }
 
@@ -220,8 +222,17 @@ void* guac_terminal_thread(void* data) {
         if (guac_terminal_render_frame(terminal))
             break;
 
-        /* Signal end of frame */
-        guac_client_end_frame(client);
+        /* Signal end of frame, sending any graphical changes that were
+         * rendered to the display */
+        guac_display_end_frame(terminal->display->graphical_display);
+
+        /* Write a keyframe to the session recording, if due */
+        if (terminal->recording != NULL)
+            guac_recording_keyframe(terminal->recording,
+                    terminal->display->graphical_display);
+
+        /* Flush any non-graphical instructions (such as scrollbar updates)
+         * that were sent outside the display */
         guac_socket_flush(client->socket);
 
     }
@@ -249,6 +260,8 @@ guac_terminal_options* guac_terminal_options_create(
     options->font_size = GUAC_TERMINAL_DEFAULT_FONT_SIZE;
     options->color_scheme = GUAC_TERMINAL_DEFAULT_COLOR_SCHEME;
     options->backspace = GUAC_TERMINAL_DEFAULT_BACKSPACE;
+    options->glyph_cache_size = GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE;
+    options->recording = NULL;
 
     return options;
 }
@@ -405,7 +418,8 @@ guac_terminal* guac_terminal_create(guac_client* client,
             options->font_name, options->font_size, options->dpi,
             &default_char.attributes.foreground,
             &default_char.attributes.background,
-            (guac_terminal_color(*)[256]) default_palette);
+            (guac_terminal_color(*)[256]) default_palette,
+            options->glyph_cache_size > 0 ? options->glyph_cache_size : 0);
 
     /* Fail if display init failed */
     if (term->display == NULL) {
@@ -414,9 +428,6 @@ guac_terminal* guac_terminal_create(guac_client* client,
         return NULL;
     }
 
-    /* Init common cursor */
-    term->cursor = guac_common_cursor_alloc(client);
-
     /* Init terminal state */
     term->current_attributes = default_char.attributes;
     term->default_char = default_char;
@@ -441,6 +452,9 @@ guac_terminal* guac_terminal_create(guac_client* client,
     term->term_height = rows;
     term->term_width  = columns;
 
+    guac_terminal_buffer_set_height(term->normal_buffer, rows);
+    guac_terminal_buffer_set_height(term->alternate_buffer, rows);
+
     /* Set pixel size */
     term->height = adjusted_height;
     term->width = adjusted_width;
@@ -462,11 +476,14 @@ guac_terminal* guac_terminal_create(guac_client* client,
     /* No typescript by default */
     term->typescript = NULL;
 
+    /* Session recording (if any) which should receive keyframes */
+    term->recording = options->recording;
+
     /* Init terminal lock */
     pthread_mutex_init(&(term->lock), NULL);
 
     /* Repaint and resize overall display */
-    guac_terminal_repaint_default_layer(term, term->client->socket);
+    guac_terminal_repaint_default_layer(term);
     guac_terminal_display_resize(term->display,
             term->term_width, term->term_height);
 
@@ -492,7 +509,7 @@ guac_terminal* guac_terminal_create(guac_client* client,
 
     /* Initialize mouse cursor */
     term->current_cursor = GUAC_TERMINAL_CURSOR_BLANK;
-    guac_common_cursor_set_blank(term->cursor);
+    guac_display_set_cursor(term->display->graphical_display, GUAC_DISPLAY_CURSOR_NONE);
 
     /* Start terminal thread */
     if (pthread_create(&(term->thread), NULL,
@@ -752,6 +769,49 @@ int guac_terminal_set(guac_terminal* term, int row, int col, int codepoint) {
 
 }
 
+void guac_terminal_set_characters(guac_terminal* term, int row, int col,
+        guac_terminal_char* characters, int length) {
+
+    if (length <= 0)
+        return;
+
+    /* Draw each character, skipping the continuations of multicolumn
+     * characters */
+    for (int i = 0; i < length; i++) {
+        guac_terminal_char* character = &characters[i];
+        if (character->value != GUAC_CHAR_CONTINUATION)
+            guac_terminal_display_set_columns(term->display,
+                    row + term->scroll_offset, col + i,
+                    col + i + character->width - 1, character);
+    }
+
+    guac_terminal_buffer_set_characters(term->current_buffer, row, col,
+            characters, length);
+
+    /* Clear selection if region is modified */
+    guac_terminal_select_touch(term, row, col, row, col + length - 1);
+
+    /* If visible cursor in modified region, preserve state */
+    int cursor_index = term->visible_cursor_col - col;
+    if (row == term->visible_cursor_row
+            && cursor_index >= 0 && cursor_index < length) {
+
+        /* Locate start of character containing cursor */
+        while (cursor_index > 0
+                && characters[cursor_index].value == GUAC_CHAR_CONTINUATION)
+            cursor_index--;
+
+        /* Create copy of character with cursor attribute set */
+        guac_terminal_char cursor_character = characters[cursor_index];
+        cursor_character.attributes.cursor = true;
+
+        __guac_terminal_set_columns(term, row, term->visible_cursor_col,
+                term->visible_cursor_col, &cursor_character);
+
+    }
+
+}
+
 void guac_terminal_commit_cursor(guac_terminal* term) {
 
     /* If no change, done */
@@ -802,6 +862,25 @@ int guac_terminal_write(guac_terminal* term, const char* buffer, int length) {
     guac_terminal_lock(term);
     for (int written = 0; written < length; written++) {
 
+        /* Handle runs of printable characters in bulk where possible */
+        if (term->char_handler == guac_terminal_echo) {
+
+            int handled = guac_terminal_echo_all(term, buffer, length - written);
+            if (handled > 0) {
+
+                /* Write all handled characters to typescript, if any */
+                if (term->typescript != NULL)
+                    guac_terminal_typescript_write_all(term->typescript, buffer, handled);
+
+                buffer += handled;
+                written += handled;
+                if (written == length)
+                    break;
+
+            }
+
+        }
+
         /* Read and advance to next character */
         char current = *(buffer++);
 
@@ -1315,13 +1394,14 @@ static void __guac_terminal_resize(guac_terminal* term, int width, int height) {
     term->term_width = width;
     term->term_height = height;
 
+    /* Rows now on screen must remain unpacked */
+    guac_terminal_buffer_set_height(term->normal_buffer, height);
+    guac_terminal_buffer_set_height(term->alternate_buffer, height);
+
 }
 
 int guac_terminal_resize(guac_terminal* terminal, int width, int height) {
 
-    guac_terminal_display* display = terminal->display;
-    guac_client* client = display->client;
-
     /* Acquire exclusive access to terminal */
     guac_terminal_lock(terminal);
 
@@ -1344,7 +1424,7 @@ int guac_terminal_resize(guac_terminal* terminal, int width, int height) {
     terminal->width = adjusted_width;
 
     /* Resize default layer to given pixel dimensions */
-    guac_terminal_repaint_default_layer(terminal, client->socket);
+    guac_terminal_repaint_default_layer(terminal);
 
     /* Resize terminal if row/column dimensions have changed */
     if (columns != terminal->term_width || rows != terminal->term_height) {
@@ -1427,7 +1507,8 @@ static int __guac_terminal_send_key(guac_terminal* term, int keysym, int pressed
     /* Hide mouse cursor if not already hidden */
     if (term->current_cursor != GUAC_TERMINAL_CURSOR_BLANK) {
         term->current_cursor = GUAC_TERMINAL_CURSOR_BLANK;
-        guac_common_cursor_set_blank(term->cursor);
+        guac_display_set_cursor(term->display->graphical_display,
+                GUAC_DISPLAY_CURSOR_NONE);
         guac_terminal_notify(term);
     }
 
@@ -1734,7 +1815,8 @@ static int __guac_terminal_send_mouse(guac_terminal* term, guac_user* user,
     int pressed_mask  = ~term->mouse_mask &  mask;
 
     /* Store current mouse location/state */
-    guac_common_cursor_update(term->cursor, user, x, y, mask);
+    guac_display_notify_user_moved_mouse(term->display->graphical_display,
+            user, x, y, mask);
 
     /* Notify scrollbar, do not handle anything handled by scrollbar */
     if (guac_terminal_scrollbar_handle_mouse(term->scrollbar, x, y, mask)) {
@@ -1742,7 +1824,8 @@ static int __guac_terminal_send_mouse(guac_terminal* term, guac_user* user,
         /* Set pointer cursor if mouse is over scrollbar */
         if (term->current_cursor != GUAC_TERMINAL_CURSOR_POINTER) {
             term->current_cursor = GUAC_TERMINAL_CURSOR_POINTER;
-            guac_common_cursor_set_pointer(term->cursor);
+            guac_display_set_cursor(term->display->graphical_display,
+                    GUAC_DISPLAY_CURSOR_POINTER);
             guac_terminal_notify(term);
         }
 
@@ -1760,7 +1843,8 @@ static int __guac_terminal_send_mouse(guac_terminal* term, guac_user* user,
     /* Show mouse cursor if not already shown */
     if (term->current_cursor != GUAC_TERMINAL_CURSOR_IBAR) {
         term->current_cursor = GUAC_TERMINAL_CURSOR_IBAR;
-        guac_common_cursor_set_ibar(term->cursor);
+        guac_display_set_cursor(term->display->graphical_display,
+                GUAC_DISPLAY_CURSOR_IBAR);
         guac_terminal_notify(term);
     }
 
@@ -2071,16 +2155,13 @@ int guac_terminal_create_typescript(guac_terminal* term, const char* path,
 static void __guac_terminal_sync_socket(
         guac_client* client, guac_terminal* term, guac_socket* socket) {
 
-    /* Synchronize display state with new user */
-    guac_terminal_repaint_default_layer(term, socket);
-    guac_terminal_display_dup(term->display, client, socket);
-
-    /* Synchronize mouse cursor */
-    guac_common_cursor_dup(term->cursor, client, socket);
-
     /* Paint scrollbar for joining users */
     guac_terminal_scrollbar_dup(term->scrollbar, client, socket);
 
+    /* Synchronize display state and mouse cursor with new user (this must
+     * happen last, as the display ends the synchronized frame) */
+    guac_terminal_display_dup(term->display, client, socket);
+
 }
 
 void guac_terminal_dup(guac_terminal* term, guac_user* user,
@@ -2218,14 +2299,14 @@ void guac_terminal_clipboard_append(guac_terminal* terminal,
 
 void guac_terminal_remove_user(guac_terminal* terminal, guac_user* user) {
 
-    /* Remove the user from the terminal cursor */
-    guac_common_cursor_remove_user(terminal->cursor, user);
+    /* Remove the user from the terminal display */
+    guac_display_notify_user_left(terminal->display->graphical_display, user);
 }
 
 void guac_terminal_redraw_default_layer(guac_terminal* terminal) {
 
     /* Redraw terminal text and background */
-    guac_terminal_repaint_default_layer(terminal, terminal->client->socket);
+    guac_terminal_repaint_default_layer(terminal);
     __guac_terminal_redraw_rect(terminal, 0, 0,
             terminal->term_height - 1,
             terminal->term_width - 1);
@@ -0,0 +1,214 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_TERMINAL_BUFFER_PRIV_H
+#define GUAC_TERMINAL_BUFFER_PRIV_H
+
+/**
+ * Internal structure and constants of the terminal buffer, exposed only so
+ * that the packing behavior of the buffer can be verified by unit tests.
+ *
+ * @file buffer-priv.h
+ */
+
+#include "buffer.h"
+#include "common.h"
+#include "terminal.h"
+#include "types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * The minimum number of columns to allocate for a buffer row, regardless of
+ * the terminal size. We set a minimum size here to reduce the memory
+ * reallocation overhead for small rows.
+ */
+#define GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE 256
+
+/**
+ * The number of rows at the bottom of the scrollback buffer (immediately above
+ * the top-most row of the terminal display) that are always left unpacked.
+ * Rows further into the scrollback are packed into a compact representation
+ * as they scroll past this point.
+ */
+#define GUAC_TERMINAL_BUFFER_HOT_ROWS 64
+
+/**
+ * The maximum number of packed rows that may be unpacked at any one time due
+ * to being accessed (for example, while viewing or selecting text within the
+ * scrollback buffer). Once this limit is reached, the least-recently unpacked
+ * row is packed again. This is at least the maximum number of rows the
+ * terminal can display such that rendering a screen of scrollback does not
+ * repeatedly pack and unpack the same rows.
+ */
+#define GUAC_TERMINAL_BUFFER_MAX_UNPACKED GUAC_TERMINAL_MAX_ROWS
+
+/**
+ * The maximum number of distinct sets of character attributes that may be
+ * stored within the attribute table of a buffer at any one time. Entries that
+ * are no longer referenced by any packed row are reused. Rows containing
+ * attributes that cannot be added to a full table are left unpacked.
+ */
+#define GUAC_TERMINAL_BUFFER_MAX_ATTRIBUTES 1024
+
+/**
+ * The minimum number of consecutive, identical characters that are stored
+ * as a single repeated character when packing a row.
+ */
+#define GUAC_TERMINAL_BUFFER_MIN_REPEAT 4
+
+/**
+ * A single variable-length row of terminal data.
+ */
+typedef struct guac_terminal_buffer_row {
+
+    /**
+     * Array of guac_terminal_char representing the contents of the row.
+     */
+    guac_terminal_char* characters;
+
+    /**
+     * The length of this row in characters. This is the number of initialized
+     * characters in the buffer, usually equal to the number of characters
+     * in the screen width at the time this row was created.
+     */
+    unsigned int length;
+
+    /**
+     * The number of elements in the characters array. After the length
+     * equals this value, the array must be resized.
+     */
+    unsigned int available;
+
+    /**
+     * True if the current row has been wrapped to avoid going off the screen.
+     * False otherwise.
+     */
+    bool wrapped_row;
+
+    /**
+     * The packed contents of this row, or NULL if the row is not packed. A
+     * packed row has no characters array, its contents instead being stored
+     * as a series of spans of characters sharing the same attributes, with
+     * each span referring to its attributes by index within the attribute
+     * table of the buffer. See guac_terminal_buffer_pack_row().
+     */
+    unsigned char* packed;
+
+    /**
+     * The value of the access counter of the buffer when this row was last
+     * retrieved.
+     */
+    unsigned int last_access;
+
+} guac_terminal_buffer_row;
+
+struct guac_terminal_buffer {
+
+    /**
+     * The character to assign to newly-allocated cells.
+     */
+    guac_terminal_char default_character;
+
+    /**
+     * Array of buffer rows. This array functions as a ring buffer.
+     * When a new row needs to be appended, the top reference is moved down
+     * and the old top row is replaced.
+     */
+    guac_terminal_buffer_row* rows;
+
+    /**
+     * The index of the first row in the buffer (the row which represents row 0
+     * with respect to the terminal display). This is also the index of the row
+     * to replace when insufficient space remains in the buffer to add a new
+     * row.
+     */
+    unsigned int top;
+
+    /**
+     * The number of rows currently stored in the buffer.
+     */
+    unsigned int length;
+
+    /**
+     * The number of rows in the buffer. This is the total capacity
+     * of the buffer.
+     */
+    unsigned int available;
+
+    /**
+     * The number of rows currently visible within the terminal display. Rows
+     * 0 through height - 1 are on screen and are never packed.
+     */
+    unsigned int height;
+
+    /**
+     * All distinct sets of character attributes referenced by packed rows.
+     */
+    guac_terminal_attributes* attributes;
+
+    /**
+     * The number of spans within packed rows that refer to each entry of the
+     * attribute table. Entries having no references may be replaced.
+     */
+    unsigned int* attribute_refs;
+
+    /**
+     * The number of entries of the attribute table that have been used. Only
+     * entries below this index may contain attributes.
+     */
+    int attribute_count;
+
+    /**
+     * The index of the attribute table entry most recently looked up.
+     */
+    int last_attribute;
+
+    /**
+     * The indices of packed rows that have been unpacked due to being
+     * accessed, in the order they were unpacked. This array functions as a
+     * ring buffer of GUAC_TERMINAL_BUFFER_MAX_UNPACKED entries, with unused
+     * entries set to -1.
+     */
+    int* unpacked;
+
+    /**
+     * The index of the next entry within the unpacked array to use.
+     */
+    int next_unpacked;
+
+    /**
+     * The number of times any row has been retrieved from this buffer.
+     */
+    unsigned int accesses;
+
+    /**
+     * Temporary storage for the packed contents of a row as it is packed.
+     */
+    unsigned char* pack_buffer;
+
+    /**
+     * The size of the pack_buffer, in bytes.
+     */
+    size_t pack_buffer_size;
+
+};
+
+#endif
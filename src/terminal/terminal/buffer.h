@@ -116,6 +116,32 @@ void guac_terminal_buffer_scroll_down(guac_terminal_buffer* buffer, int amount);
 void guac_terminal_buffer_set_columns(guac_terminal_buffer* buffer, int row,
         int start_column, int end_column, guac_terminal_char* character);
 
+/**
+ * Copies the given characters into the given row, beginning at the given
+ * column. The characters must include any continuation characters required
+ * by multicolumn characters, such that each element of the array occupies
+ * exactly one column. This is equivalent to invoking
+ * guac_terminal_buffer_set_columns() for each character, but copies the
+ * characters in bulk.
+ *
+ * @param buffer
+ *     The buffer containing the row to modify.
+ *
+ * @param row
+ *     The row to modify.
+ *
+ * @param start_column
+ *     The column at which the first character should be stored.
+ *
+ * @param characters
+ *     The characters to store.
+ *
+ * @param length
+ *     The number of characters (columns) to store.
+ */
+void guac_terminal_buffer_set_characters(guac_terminal_buffer* buffer, int row,
+        int start_column, const guac_terminal_char* characters, int length);
+
 /**
  * Get the char (int ASCII code) at a specific row/col of the display.
  *
@@ -134,6 +160,19 @@ void guac_terminal_buffer_set_columns(guac_terminal_buffer* buffer, int row,
 unsigned int guac_terminal_buffer_get_columns(guac_terminal_buffer* buffer,
         guac_terminal_char** characters, bool* is_wrapped, int row);
 
+/**
+ * Sets the number of rows currently visible within the terminal display
+ * associated with the given buffer. Visible rows are never packed, even if
+ * they have not been accessed recently.
+ *
+ * @param buffer
+ *     The buffer whose visible height should be set.
+ *
+ * @param height
+ *     The number of rows currently visible within the terminal display.
+ */
+void guac_terminal_buffer_set_height(guac_terminal_buffer* buffer, int height);
+
 /**
  * Returns the number of rows actually available for rendering within the given
  * buffer, taking the scrollback size into account. Regardless of the true
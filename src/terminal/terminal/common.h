@@ -48,6 +48,23 @@ int guac_terminal_encode_utf8(int codepoint, char* utf8);
  */
 bool guac_terminal_has_glyph(int codepoint);
 
+/**
+ * Returns whether the given sets of character attributes are identical.
+ * Unlike guac_terminal_colorcmp(), colors are considered identical only if
+ * both their palette indices and RGB components are identical.
+ *
+ * @param a
+ *     The first set of attributes to compare.
+ *
+ * @param b
+ *     The second set of attributes to compare.
+ *
+ * @return
+ *     true if the given attributes are identical, false otherwise.
+ */
+bool guac_terminal_attributes_equal(const guac_terminal_attributes* a,
+        const guac_terminal_attributes* b);
+
 /**
  * Similar to write, but automatically retries the write operation until
  * an error occurs.
@@ -26,15 +26,16 @@
  * @file display.h
  */
 
-#include "common/surface.h"
+#include "glyph-cache.h"
 #include "palette.h"
 #include "types.h"
 
 #include <guacamole/client.h>
-#include <guacamole/layer.h>
+#include <guacamole/display.h>
 #include <pango/pangocairo.h>
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -142,6 +143,12 @@ typedef struct guac_terminal_display {
      */
     PangoFontDescription* font_desc;
 
+    /**
+     * Cache of all glyphs rendered using the current font, such that each
+     * distinct glyph need only be rendered once.
+     */
+    guac_terminal_glyph_cache* glyph_cache;
+
     /**
      * The width of each character, in pixels.
      */
@@ -186,19 +193,20 @@ typedef struct guac_terminal_display {
     guac_terminal_color glyph_background;
 
     /**
-     * The surface containing the actual terminal.
+     * The guac_display responsible for rendering all graphical output of the
+     * terminal, including the mouse cursor.
      */
-    guac_common_surface* display_surface;
+    guac_display* graphical_display;
 
     /**
      * Layer which contains the actual terminal.
      */
-    guac_layer* display_layer;
+    guac_display_layer* display_layer;
 
     /**
      * Sub-layer of display layer which highlights selected text.
      */
-    guac_layer* select_layer;
+    guac_display_layer* select_layer;
 
     /**
      * Whether text is currently selected.
@@ -231,16 +239,38 @@ typedef struct guac_terminal_display {
      */
     bool unflushed_set;
 
+    /**
+     * Bitmap of all rows which may contain pending operations, with one bit
+     * per row (the least-significant bit of the first word representing row
+     * 0). Rows whose bits are not set contain only GUAC_CHAR_NOP operations
+     * and are skipped entirely when flushing.
+     */
+    uint64_t* dirty_rows;
+
+    /**
+     * The leftmost column of each row which may contain a pending operation.
+     * This value is meaningful only for rows marked within dirty_rows.
+     */
+    int* dirty_left;
+
+    /**
+     * The rightmost column of each row which may contain a pending
+     * operation. This value is meaningful only for rows marked within
+     * dirty_rows.
+     */
+    int* dirty_right;
+
 } guac_terminal_display;
 
 /**
  * Allocates a new display having the given default foreground and background
- * colors.
+ * colors. Rendered glyphs are cached, consuming up to the given number of
+ * bytes of memory.
  */
 guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
         const char* font_name, int font_size, int dpi,
         guac_terminal_color* foreground, guac_terminal_color* background,
-        guac_terminal_color (*palette)[256]);
+        guac_terminal_color (*palette)[256], size_t glyph_cache_size);
 
 /**
  * Frees the given display.
@@ -331,8 +361,9 @@ void guac_terminal_display_resize(guac_terminal_display* display, int width, int
 void guac_terminal_display_flush_operations(guac_terminal_display* display);
 
 /**
- * Flushes all pending operations within the given guac_terminal_display,
- * then flushes the display surface.
+ * Flushes all pending operations within the given guac_terminal_display to
+ * the pending frame of its underlying guac_display. The changes will be sent
+ * to connected users when that frame ends.
  *
  * @param display
  *     The terminal display to flush.
@@ -0,0 +1,229 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_TERMINAL_GLYPH_CACHE_H
+#define GUAC_TERMINAL_GLYPH_CACHE_H
+
+/**
+ * Structures and function definitions related to caching of rendered
+ * terminal glyphs.
+ *
+ * @file glyph-cache.h
+ */
+
+#include "palette.h"
+
+#include <cairo/cairo.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The number of hash buckets within each guac_terminal_glyph_cache. This
+ * value MUST be a power of two.
+ */
+#define GUAC_TERMINAL_GLYPH_CACHE_BUCKETS 1024
+
+/**
+ * A single rendered glyph, stored within a guac_terminal_glyph_cache.
+ */
+typedef struct guac_terminal_glyph guac_terminal_glyph;
+
+struct guac_terminal_glyph {
+
+    /**
+     * The Unicode codepoint rendered.
+     */
+    int codepoint;
+
+    /**
+     * The foreground color that the glyph was rendered with, as a 24-bit
+     * RGB value.
+     */
+    uint32_t foreground;
+
+    /**
+     * The background color that the glyph was rendered with, as a 24-bit
+     * RGB value.
+     */
+    uint32_t background;
+
+    /**
+     * The Cairo surface containing the rendered glyph, including its
+     * background.
+     */
+    cairo_surface_t* surface;
+
+    /**
+     * The approximate number of bytes of memory consumed by this glyph.
+     */
+    size_t size;
+
+    /**
+     * The next glyph within the same hash bucket, or NULL if this is the last
+     * glyph in the bucket.
+     */
+    guac_terminal_glyph* next_in_bucket;
+
+    /**
+     * The glyph which was used more recently than this glyph, or NULL if this
+     * glyph is the most recently used.
+     */
+    guac_terminal_glyph* more_recent;
+
+    /**
+     * The glyph which was used less recently than this glyph, or NULL if this
+     * glyph is the least recently used.
+     */
+    guac_terminal_glyph* less_recent;
+
+};
+
+/**
+ * Cache of rendered glyphs, keyed by codepoint and the foreground and
+ * background colors used to render that codepoint. As glyphs are rendered
+ * using the current font of the terminal display, the cache must be cleared
+ * whenever that font changes. Once the memory consumed by cached glyphs
+ * exceeds the configured limit, the least recently used glyphs are evicted.
+ */
+typedef struct guac_terminal_glyph_cache {
+
+    /**
+     * Hash table of all cached glyphs.
+     */
+    guac_terminal_glyph* buckets[GUAC_TERMINAL_GLYPH_CACHE_BUCKETS];
+
+    /**
+     * The most recently used glyph, or NULL if the cache is empty.
+     */
+    guac_terminal_glyph* most_recent;
+
+    /**
+     * The least recently used glyph, or NULL if the cache is empty.
+     */
+    guac_terminal_glyph* least_recent;
+
+    /**
+     * The approximate number of bytes of memory consumed by all glyphs
+     * currently in the cache.
+     */
+    size_t size;
+
+    /**
+     * The maximum number of bytes of memory that may be consumed by glyphs in
+     * the cache. If zero, caching is disabled.
+     */
+    size_t max_size;
+
+    /**
+     * The number of lookups which found a cached glyph.
+     */
+    uint64_t hits;
+
+    /**
+     * The number of lookups which did not find a cached glyph.
+     */
+    uint64_t misses;
+
+} guac_terminal_glyph_cache;
+
+/**
+ * Allocates a new, empty glyph cache which may consume up to the given number
+ * of bytes. The cache must eventually be freed with a call to
+ * guac_terminal_glyph_cache_free().
+ *
+ * @param max_size
+ *     The maximum number of bytes of memory that may be consumed by glyphs in
+ *     the cache, or zero to disable caching entirely.
+ *
+ * @return
+ *     A newly-allocated, empty glyph cache.
+ */
+guac_terminal_glyph_cache* guac_terminal_glyph_cache_alloc(size_t max_size);
+
+/**
+ * Frees the given glyph cache and all glyphs within it.
+ *
+ * @param cache
+ *     The glyph cache to free.
+ */
+void guac_terminal_glyph_cache_free(guac_terminal_glyph_cache* cache);
+
+/**
+ * Removes all glyphs from the given cache. This must be invoked whenever the
+ * font used to render the cached glyphs has changed.
+ *
+ * @param cache
+ *     The glyph cache to clear.
+ */
+void guac_terminal_glyph_cache_clear(guac_terminal_glyph_cache* cache);
+
+/**
+ * Returns the cached rendering of the given codepoint using the given colors,
+ * if any. If found, the glyph becomes the most recently used glyph in the
+ * cache.
+ *
+ * @param cache
+ *     The glyph cache to search.
+ *
+ * @param codepoint
+ *     The codepoint of the glyph.
+ *
+ * @param foreground
+ *     The foreground color of the glyph.
+ *
+ * @param background
+ *     The background color of the glyph.
+ *
+ * @return
+ *     The Cairo surface containing the cached glyph, or NULL if no such glyph
+ *     is cached. The returned surface remains owned by the cache and is valid
+ *     only until the cache is next modified.
+ */
+cairo_surface_t* guac_terminal_glyph_cache_get(guac_terminal_glyph_cache* cache,
+        int codepoint, const guac_terminal_color* foreground,
+        const guac_terminal_color* background);
+
+/**
+ * Adds the given rendering of the given codepoint to the cache, evicting the
+ * least recently used glyphs as necessary to remain within the memory limit
+ * of the cache. Ownership of the surface is transferred to the cache. If the
+ * surface cannot be cached (caching is disabled or the surface alone exceeds
+ * the memory limit), the surface is immediately destroyed.
+ *
+ * @param cache
+ *     The glyph cache to add the glyph to.
+ *
+ * @param codepoint
+ *     The codepoint of the glyph.
+ *
+ * @param foreground
+ *     The foreground color that the glyph was rendered with.
+ *
+ * @param background
+ *     The background color that the glyph was rendered with.
+ *
+ * @param surface
+ *     The Cairo image surface containing the rendered glyph.
+ */
+void guac_terminal_glyph_cache_put(guac_terminal_glyph_cache* cache,
+        int codepoint, const guac_terminal_color* foreground,
+        const guac_terminal_color* background, cairo_surface_t* surface);
+
+#endif
@@ -44,6 +44,35 @@
  */
 int guac_terminal_echo(guac_terminal* term, unsigned char c);
 
+/**
+ * Handles as many bytes as possible from the beginning of the given buffer in
+ * bulk, exactly as guac_terminal_echo() would if invoked for each byte. Only
+ * runs of printable characters are handled. Handling stops at the first
+ * control character, incomplete or malformed UTF-8 sequence, character that
+ * would extend past the right edge of the terminal, character beyond the last
+ * column while wrapping (DECAWM) is disabled, or any other byte requiring the
+ * full logic of guac_terminal_echo(), and no bytes are handled at all if
+ * guac_terminal_echo() is partway through decoding a codepoint, or if output
+ * is being redirected to a pipe stream, translated through a character
+ * mapping, or written in insert mode.
+ *
+ * @param term
+ *     The terminal that received the given data.
+ *
+ * @param buffer
+ *     The data received by the given terminal.
+ *
+ * @param length
+ *     The number of bytes of data within the buffer.
+ *
+ * @return
+ *     The number of bytes from the beginning of the buffer that were
+ *     handled, which may be zero. Any remaining bytes must be passed to
+ *     guac_terminal_echo() individually.
+ */
+int guac_terminal_echo_all(guac_terminal* term, const char* buffer,
+        int length);
+
 /**
  * Handles any characters which follow an ANSI ESC (0x1B) character.
  *
@@ -21,7 +21,6 @@
 #define GUAC_TERMINAL_PRIV_H
 
 #include "common/clipboard.h"
-#include "common/cursor.h"
 #include "buffer.h"
 #include "display.h"
 #include "scrollbar.h"
@@ -152,9 +151,11 @@ struct guac_terminal {
     guac_terminal_typescript* typescript;
 
     /**
-     * Terminal-wide mouse cursor, synchronized across all users.
+     * The in-progress session recording of the connection using this
+     * terminal, or NULL if the connection is not being recorded. Keyframes are
+     * periodically written to this recording by the terminal thread.
      */
-    guac_common_cursor* cursor;
+    guac_recording* recording;
 
     /**
      * Graphical representation of the current scroll state.
@@ -293,6 +294,19 @@ struct guac_terminal {
      */
     guac_terminal_char_handler* char_handler;
 
+    /**
+     * The number of bytes remaining in the UTF-8 codepoint currently being
+     * decoded by guac_terminal_echo(), or zero if no codepoint is partially
+     * decoded.
+     */
+    int utf8_bytes_remaining;
+
+    /**
+     * The portion of the UTF-8 codepoint currently being decoded by
+     * guac_terminal_echo() that has been received thus far.
+     */
+    int utf8_codepoint;
+
     /**
      * The difference between the currently-rendered screen and the current
      * state of the terminal, and the contextual information necessary to
@@ -406,6 +420,12 @@ struct guac_terminal {
      */
     bool automatic_carriage_return;
 
+    /**
+     * Whether characters printed beyond the last column wrap to the next row
+     * (DECAWM). If false, such characters overwrite the last column instead.
+     */
+    bool automatic_wrap;
+
     /**
      * Whether insert mode is enabled (DECIM).
      */
@@ -535,6 +555,32 @@ void guac_terminal_reset(guac_terminal* term);
  */
 int guac_terminal_set(guac_terminal* term, int row, int col, int codepoint);
 
+/**
+ * Sets the given characters within the given row, beginning at the given
+ * column, using the current attributes of each character. The characters
+ * must include any continuation characters required by multicolumn
+ * characters, such that each element of the array occupies exactly one
+ * column. This is equivalent to setting each character individually with
+ * guac_terminal_set_columns(), but updates the terminal buffer in bulk.
+ *
+ * @param term
+ *     The terminal to modify.
+ *
+ * @param row
+ *     The row to modify.
+ *
+ * @param col
+ *     The column at which the first character should be set.
+ *
+ * @param characters
+ *     The characters to set.
+ *
+ * @param length
+ *     The number of characters (columns) to set.
+ */
+void guac_terminal_set_characters(guac_terminal* term, int row, int col,
+        guac_terminal_char* characters, int length);
+
 /**
  * Clears the given region within a single row.
  */
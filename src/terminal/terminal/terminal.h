@@ -31,6 +31,7 @@
 #include <stdbool.h>
 
 #include <guacamole/client.h>
+#include <guacamole/recording.h>
 #include <guacamole/stream.h>
 
 /**
@@ -64,6 +65,12 @@
  */
 #define GUAC_TERMINAL_DEFAULT_DISABLE_COPY false
 
+/**
+ * The default maximum amount of memory that may be consumed by cached,
+ * pre-rendered glyphs, in bytes.
+ */
+#define GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE 8388608
+
 /**
  * The absolute maximum number of rows to allow within the display.
  */
@@ -243,6 +250,22 @@ typedef struct guac_terminal_options {
      */
     int backspace;
 
+    /**
+     * The maximum amount of memory that may be consumed by cached,
+     * pre-rendered glyphs, in bytes. Once this limit is reached, the least
+     * recently used glyphs are discarded. If zero, rendered glyphs are not
+     * cached.
+     */
+    int glyph_cache_size;
+
+    /**
+     * The in-progress session recording of the connection using the terminal,
+     * or NULL if the connection is not being recorded. If the recording is
+     * compressed, keyframes containing the full state of the terminal display
+     * will periodically be written to that recording by the terminal.
+     */
+    guac_recording* recording;
+
 } guac_terminal_options;
 
 /**
@@ -171,6 +171,24 @@ guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
 void guac_terminal_typescript_write(guac_terminal_typescript* typescript,
         char c);
 
+/**
+ * Writes an arbitrary number of bytes of terminal data to the typescript,
+ * flushing and writing new timestamps as necessary. This is equivalent to
+ * invoking guac_terminal_typescript_write() for each byte, but copies the
+ * data in bulk.
+ *
+ * @param typescript
+ *     The typescript that the given raw terminal data should be written to.
+ *
+ * @param buffer
+ *     The raw terminal data to write to the typescript.
+ *
+ * @param length
+ *     The number of bytes of raw terminal data to write.
+ */
+void guac_terminal_typescript_write_all(guac_terminal_typescript* typescript,
+        const char* buffer, int length);
+
 /**
  * Flushes any pending data to the typescript, writing a new timestamp to the
  * timing file if any data was flushed.
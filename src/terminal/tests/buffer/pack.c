@@ -0,0 +1,372 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal/buffer-priv.h"
+#include "terminal/buffer.h"
+#include "terminal/terminal.h"
+#include "terminal/types.h"
+
+#include <CUnit/CUnit.h>
+#include <stdbool.h>
+
+/**
+ * The total number of rows within each test buffer, including scrollback.
+ */
+#define TEST_BUFFER_ROWS 4096
+
+/**
+ * The number of rows visible within the simulated terminal display.
+ */
+#define TEST_HEIGHT 24
+
+/**
+ * The number of columns in each row written to the test buffer.
+ */
+#define TEST_WIDTH 80
+
+/**
+ * The number of rows scrolled into the test buffer by test_buffer_alloc().
+ */
+#define TEST_SCROLLED 3000
+
+/**
+ * The codepoint used for the contents of the first row scrolled into the
+ * test buffer. Each following row uses the next codepoint.
+ */
+#define TEST_FIRST_VALUE 0x100
+
+/**
+ * The number of rows visible within the simulated terminal display used by
+ * test_buffer__tall_display_not_packed(). This is tall enough that rows
+ * GUAC_TERMINAL_BUFFER_HOT_ROWS into the scrollback of a buffer having only
+ * GUAC_TERMINAL_MAX_ROWS rows wrap around to rows on screen.
+ */
+#define TEST_TALL_HEIGHT 1000
+
+/**
+ * The total number of rows within the buffer used by
+ * test_buffer__attributes_reused(), including scrollback. This is small
+ * enough that the rows in the scrollback never have more distinct attributes
+ * than fit within the attribute table at once.
+ */
+#define TEST_SMALL_BUFFER_ROWS 512
+
+/**
+ * The number of rows that the buffer is scrolled down by
+ * test_buffer__visible_not_repacked() to bring packed rows on screen.
+ */
+#define TEST_SCROLL_BACK 1000
+
+/**
+ * Returns the buffer row at the given location without unpacking that row or
+ * otherwise affecting the packing state of the buffer.
+ *
+ * @param buffer
+ *     The buffer to retrieve a row from.
+ *
+ * @param row
+ *     The index of the row to retrieve, where zero is the top-most row and
+ *     negative indices are within the scrollback buffer.
+ *
+ * @return
+ *     The buffer row at the given location.
+ */
+static guac_terminal_buffer_row* test_get_row(guac_terminal_buffer* buffer,
+        int row) {
+    return &buffer->rows[(buffer->top + row + buffer->available) % buffer->available];
+}
+
+/**
+ * Returns the codepoint that every character of the given row should contain
+ * after test_buffer_alloc(), taking into account any rows the buffer has
+ * since been scrolled down by.
+ *
+ * @param row
+ *     The index of the row, where zero is the top-most row.
+ *
+ * @param scrolled_down
+ *     The number of rows the buffer has been scrolled down by since
+ *     test_buffer_alloc().
+ *
+ * @return
+ *     The codepoint expected within the given row.
+ */
+static int test_expected_value(int row, int scrolled_down) {
+    return TEST_FIRST_VALUE + TEST_SCROLLED - TEST_HEIGHT + row - scrolled_down;
+}
+
+/**
+ * Verifies that the given row contains TEST_WIDTH characters having the
+ * given codepoint, unpacking that row if necessary.
+ *
+ * @param buffer
+ *     The buffer containing the row.
+ *
+ * @param row
+ *     The index of the row to verify.
+ *
+ * @param value
+ *     The codepoint expected within every column of the row.
+ */
+static void test_verify_row(guac_terminal_buffer* buffer, int row, int value) {
+
+    guac_terminal_char* characters;
+    unsigned int length = guac_terminal_buffer_get_columns(buffer,
+            &characters, NULL, row);
+
+    CU_ASSERT_EQUAL_FATAL(length, TEST_WIDTH);
+    for (int column = 0; column < TEST_WIDTH; column++) {
+        CU_ASSERT_EQUAL(characters[column].value, value);
+        CU_ASSERT_EQUAL(characters[column].width, 1);
+    }
+
+}
+
+/**
+ * Allocates a new buffer representing a terminal display of TEST_HEIGHT rows,
+ * writing TEST_SCROLLED distinct rows to the bottom of the display and
+ * scrolling each into the scrollback buffer in turn.
+ *
+ * @return
+ *     A newly-allocated buffer that must be freed with
+ *     guac_terminal_buffer_free().
+ */
+static guac_terminal_buffer* test_buffer_alloc() {
+
+    guac_terminal_char default_char = {
+        .value = ' ',
+        .width = 1
+    };
+
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(TEST_BUFFER_ROWS,
+            &default_char);
+    guac_terminal_buffer_set_height(buffer, TEST_HEIGHT);
+
+    for (int i = 0; i < TEST_SCROLLED; i++) {
+
+        guac_terminal_char character = {
+            .value = TEST_FIRST_VALUE + i,
+            .width = 1
+        };
+
+        guac_terminal_buffer_scroll_up(buffer, 1);
+        guac_terminal_buffer_set_columns(buffer, TEST_HEIGHT - 1,
+                0, TEST_WIDTH - 1, &character);
+
+    }
+
+    return buffer;
+
+}
+
+/**
+ * Verifies that rows are packed only once they have scrolled beyond the rows
+ * kept unpacked at the bottom of the scrollback buffer, and that packed rows
+ * are unpacked with their original contents when accessed.
+ */
+void test_buffer__pack() {
+
+    guac_terminal_buffer* buffer = test_buffer_alloc();
+
+    /* Rows on screen and near the display remain unpacked */
+    for (int row = -GUAC_TERMINAL_BUFFER_HOT_ROWS + 1; row < TEST_HEIGHT; row++)
+        CU_ASSERT_PTR_NULL(test_get_row(buffer, row)->packed);
+
+    /* Rows further into the scrollback are packed */
+    int depth = TEST_SCROLLED - TEST_HEIGHT;
+    for (int row = -GUAC_TERMINAL_BUFFER_HOT_ROWS; row > -depth; row--)
+        CU_ASSERT_PTR_NOT_NULL(test_get_row(buffer, row)->packed);
+
+    /* Accessing a packed row unpacks its original contents */
+    test_verify_row(buffer, -500, test_expected_value(-500, 0));
+    CU_ASSERT_PTR_NULL(test_get_row(buffer, -500)->packed);
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
+/**
+ * Verifies that a row unpacked due to being accessed is packed again once
+ * enough other rows have been unpacked, and that its contents survive being
+ * packed, unpacked, and packed again.
+ */
+void test_buffer__repack() {
+
+    guac_terminal_buffer* buffer = test_buffer_alloc();
+
+    test_verify_row(buffer, -500, test_expected_value(-500, 0));
+    CU_ASSERT_PTR_NULL(test_get_row(buffer, -500)->packed);
+
+    /* Unpack enough other rows to force the first to be packed again */
+    for (int i = 1; i <= GUAC_TERMINAL_BUFFER_MAX_UNPACKED; i++)
+        test_verify_row(buffer, -500 - i, test_expected_value(-500 - i, 0));
+
+    CU_ASSERT_PTR_NOT_NULL(test_get_row(buffer, -500)->packed);
+
+    /* Contents must be unchanged after the full cycle */
+    test_verify_row(buffer, -500, test_expected_value(-500, 0));
+    CU_ASSERT_PTR_NULL(test_get_row(buffer, -500)->packed);
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
+/**
+ * Verifies that packed rows which have been unpacked after being brought back
+ * on screen are never packed again while they remain on screen, regardless
+ * of how many other rows are unpacked.
+ */
+void test_buffer__visible_not_repacked() {
+
+    guac_terminal_buffer* buffer = test_buffer_alloc();
+
+    /* Bring packed rows back on screen */
+    guac_terminal_buffer_scroll_down(buffer, TEST_SCROLL_BACK);
+    for (int row = 0; row < TEST_HEIGHT; row++) {
+        CU_ASSERT_PTR_NOT_NULL(test_get_row(buffer, row)->packed);
+        test_verify_row(buffer, row, test_expected_value(row, TEST_SCROLL_BACK));
+    }
+
+    /* Unpack enough scrollback rows to evict every row on screen */
+    int first = -GUAC_TERMINAL_BUFFER_HOT_ROWS - 1;
+    for (int i = 0; i < GUAC_TERMINAL_BUFFER_MAX_UNPACKED; i++)
+        test_verify_row(buffer, first - i,
+                test_expected_value(first - i, TEST_SCROLL_BACK));
+
+    /* Rows on screen must not have been packed again */
+    for (int row = 0; row < TEST_HEIGHT; row++) {
+        CU_ASSERT_PTR_NULL(test_get_row(buffer, row)->packed);
+        test_verify_row(buffer, row, test_expected_value(row, TEST_SCROLL_BACK));
+    }
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
+/**
+ * Verifies that rows on screen are never packed as the buffer scrolls, even
+ * if the display is so tall relative to the size of the buffer that rows
+ * GUAC_TERMINAL_BUFFER_HOT_ROWS into the scrollback are on screen.
+ */
+void test_buffer__tall_display_not_packed() {
+
+    guac_terminal_char default_char = {
+        .value = ' ',
+        .width = 1
+    };
+
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(
+            GUAC_TERMINAL_MAX_ROWS, &default_char);
+    guac_terminal_buffer_set_height(buffer, TEST_TALL_HEIGHT);
+
+    for (int i = 0; i < TEST_SCROLLED; i++) {
+
+        guac_terminal_char character = {
+            .value = TEST_FIRST_VALUE + i,
+            .width = 1
+        };
+
+        guac_terminal_buffer_scroll_up(buffer, 1);
+        guac_terminal_buffer_set_columns(buffer, TEST_TALL_HEIGHT - 1,
+                0, TEST_WIDTH - 1, &character);
+
+    }
+
+    /* No row on screen may have been packed */
+    for (int row = 0; row < TEST_TALL_HEIGHT; row++)
+        CU_ASSERT_PTR_NULL(test_get_row(buffer, row)->packed);
+
+    /* The most recently written row must be intact */
+    test_verify_row(buffer, TEST_TALL_HEIGHT - 1,
+            TEST_FIRST_VALUE + TEST_SCROLLED - 1);
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
+/**
+ * Verifies that entries of the attribute table are released as packed rows
+ * are unpacked, such that rows continue to be packed after far more distinct
+ * attributes than fit within the table have been used (as with truecolor
+ * output), and that resetting the buffer clears the table.
+ */
+void test_buffer__attributes_reused() {
+
+    guac_terminal_char default_char = {
+        .value = ' ',
+        .width = 1
+    };
+
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(
+            TEST_SMALL_BUFFER_ROWS, &default_char);
+    guac_terminal_buffer_set_height(buffer, TEST_HEIGHT);
+
+    /* Give each row its own foreground color */
+    int rows = GUAC_TERMINAL_BUFFER_MAX_ATTRIBUTES * 3;
+    for (int i = 0; i < rows; i++) {
+
+        guac_terminal_char character = {
+            .value = TEST_FIRST_VALUE + i,
+            .attributes.foreground = {
+                .palette_index = -1,
+                .red   = i & 0xFF,
+                .green = (i >> 8) & 0xFF
+            },
+            .width = 1
+        };
+
+        guac_terminal_buffer_scroll_up(buffer, 1);
+        guac_terminal_buffer_set_columns(buffer, TEST_HEIGHT - 1,
+                0, TEST_WIDTH - 1, &character);
+
+    }
+
+    /* Rows that most recently scrolled beyond the rows kept unpacked must
+     * still have been packed */
+    for (int row = -GUAC_TERMINAL_BUFFER_HOT_ROWS; row > -GUAC_TERMINAL_BUFFER_HOT_ROWS - 16; row--)
+        CU_ASSERT_PTR_NOT_NULL(test_get_row(buffer, row)->packed);
+
+    /* Each packed row consists of a single span with its own attributes */
+    unsigned int refs = 0;
+    unsigned int packed = 0;
+    for (int i = 0; i < buffer->attribute_count; i++)
+        refs += buffer->attribute_refs[i];
+    for (int i = 0; i < TEST_SMALL_BUFFER_ROWS; i++)
+        packed += (buffer->rows[i].packed != NULL);
+    CU_ASSERT_EQUAL(refs, packed);
+
+    /* Contents and attributes survive unpacking */
+    guac_terminal_char* characters;
+    int row = -GUAC_TERMINAL_BUFFER_HOT_ROWS - 1;
+    int written = rows - TEST_HEIGHT + row;
+    CU_ASSERT_EQUAL_FATAL(guac_terminal_buffer_get_columns(buffer,
+                &characters, NULL, row), TEST_WIDTH);
+    CU_ASSERT_EQUAL(characters[0].value, TEST_FIRST_VALUE + written);
+    CU_ASSERT_EQUAL(characters[0].attributes.foreground.red, written & 0xFF);
+    CU_ASSERT_EQUAL(characters[0].attributes.foreground.green, (written >> 8) & 0xFF);
+
+    /* Resetting the buffer discards all packed rows and their attributes */
+    guac_terminal_buffer_reset(buffer);
+    CU_ASSERT_EQUAL(buffer->attribute_count, 0);
+    for (int i = 0; i < TEST_SMALL_BUFFER_ROWS; i++)
+        CU_ASSERT_PTR_NULL(buffer->rows[i].packed);
+
+    guac_terminal_buffer_free(buffer);
+
+}
@@ -0,0 +1,244 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal-test.h"
+#include "terminal/terminal.h"
+#include "terminal/terminal-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/mem.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * The number of frames rendered before timing of each workload begins,
+ * allowing the screen to fill and the glyph cache to warm up.
+ */
+#define FRAME_TIME_WARMUP 100
+
+/**
+ * The number of frames timed for each workload.
+ */
+#define FRAME_TIME_FRAMES 1000
+
+/**
+ * The largest number of terminal rows supported by the workloads. This is
+ * far more than fit within a display of TERMINAL_TEST_HEIGHT pixels.
+ */
+#define FRAME_TIME_MAX_ROWS 256
+
+/**
+ * The size of the buffer receiving the output of each frame, in bytes. This
+ * is large enough for any workload to redraw FRAME_TIME_MAX_ROWS rows.
+ */
+#define FRAME_TIME_BUFFER_SIZE 65536
+
+/**
+ * Function which produces the output that a program would write to the
+ * terminal during a single frame.
+ *
+ * @param buffer
+ *     The buffer to write the output to. This buffer is
+ *     FRAME_TIME_BUFFER_SIZE bytes long.
+ *
+ * @param frame
+ *     The number of frames that have already been produced.
+ *
+ * @param rows
+ *     The height of the terminal, in rows.
+ *
+ * @return
+ *     The number of bytes written to the buffer.
+ */
+typedef int frame_time_workload(char* buffer, int frame, int rows);
+
+/**
+ * Produces a single refresh of `top`, which redraws every row of the screen
+ * from the top-left corner, with the values in most rows changing between
+ * refreshes.
+ */
+static int frame_time_top(char* buffer, int frame, int rows) {
+
+    int length = sprintf(buffer, "\x1B[H"
+            "top - 12:%02i:%02i up 3 days,  2:17,  1 user,  "
+            "load average: 0.%02i, 0.%02i, 0.%02i\x1B[K\r\n"
+            "Tasks: %3i total,   1 running, %3i sleeping,   0 stopped,   "
+            "0 zombie\x1B[K\r\n"
+            "%%Cpu(s):  %2i.%i us,  1.2 sy,  0.0 ni,  %2i.%i id,  0.0 wa,  "
+            "0.0 hi,  0.1 si,  0.0 st\x1B[K\r\n"
+            "\x1B[K\r\n"
+            "\x1B[7m    PID USER      PR  NI    VIRT    RES  %%CPU  %%MEM"
+            "     TIME+ COMMAND\x1B[m\x1B[K\r\n",
+            (frame / 60) % 60, frame % 60,
+            frame % 100, (frame / 3) % 100, (frame / 7) % 100,
+            200 + frame % 7, 199 + frame % 7,
+            frame % 50, frame % 10, 99 - frame % 50, 9 - frame % 10);
+
+    static const char* commands[] = {
+        "guacd", "sshd", "bash", "top", "vim", "systemd", "kworker/0:1",
+        "postgres", "java", "tail"
+    };
+
+    for (int row = 5; row < rows; row++) {
+
+        /* Vary the sort order of processes from refresh to refresh */
+        int process = (row * 7 + frame) % 97;
+
+        length += sprintf(buffer + length,
+                "%7i %-8s  20   0 %7i %6i %3i.%i %5i.%i %5i:%02i.%02i "
+                "%s\x1B[K%s",
+                1000 + process, process % 3 ? "root" : "guacd",
+                100000 + process * 1013, 5000 + process * 37,
+                (process + frame) % 100, frame % 10, process % 10, row % 10,
+                process, frame % 60, row, commands[process % 10],
+                row < rows - 1 ? "\r\n" : "");
+
+    }
+
+    return length;
+
+}
+
+/**
+ * Produces a single step of scrolling down through a file in `vim`, which
+ * restricts the scrolling region to all rows but the status line, scrolls
+ * that region by one row, draws the newly-exposed line with its line number
+ * and updates the ruler.
+ */
+static int frame_time_vim(char* buffer, int frame, int rows) {
+
+    int line = frame + rows;
+
+    return sprintf(buffer,
+            "\x1B[1;%ir\x1B[%i;1H\n"
+            "\x1B[33m%4i \x1B[m    if (buffer[%i] == '\\n')"
+            "  /* line %i */\x1B[K"
+            "\x1B[r\x1B[%i;60H%i,5\x1B[K\x1B[%i;76H%i%%"
+            "\x1B[%i;10H",
+            rows - 1, rows - 1,
+            line, line % 128, line,
+            rows, line, rows, (line * 100 / 10000) % 100,
+            rows - 1);
+
+}
+
+/**
+ * Produces the output seen by `tail -f` following a busy log, which appends
+ * a few lines to the bottom of the screen during each frame, scrolling the
+ * whole screen.
+ */
+static int frame_time_tail(char* buffer, int frame, int rows) {
+
+    int length = 0;
+
+    for (int i = 0; i < 1 + frame % 3; i++)
+        length += sprintf(buffer + length,
+                "2026-10-16 12:%02i:%02i,%03i INFO  [worker-%i] "
+                "Request %i completed in %i ms\r\n",
+                (frame / 60) % 60, frame % 60, (frame * 37 + i) % 1000,
+                i, frame * 3 + i, (frame * 13 + i) % 500);
+
+    return length;
+
+}
+
+/**
+ * Comparison function for qsort() which orders frame times from shortest to
+ * longest.
+ */
+static int frame_time_compare(const void* a, const void* b) {
+
+    double time_a = *((const double*) a);
+    double time_b = *((const double*) b);
+
+    return (time_a > time_b) - (time_a < time_b);
+
+}
+
+/**
+ * Renders the frames produced by the given workload within a new terminal,
+ * printing the mean, 99th percentile and maximum time taken to write each
+ * frame to the terminal and flush the terminal display.
+ *
+ * @param name
+ *     The human-readable name of the workload.
+ *
+ * @param workload
+ *     The function producing the output of each frame.
+ */
+static void frame_time_run(const char* name, frame_time_workload* workload) {
+
+    static char buffer[FRAME_TIME_BUFFER_SIZE];
+    double* times = guac_mem_alloc(sizeof(double), FRAME_TIME_FRAMES);
+
+    guac_terminal* term = terminal_test_alloc(
+            GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE);
+
+    int rows = term->term_height;
+    CU_ASSERT_FATAL(rows > 0 && rows <= FRAME_TIME_MAX_ROWS);
+
+    for (int frame = 0; frame < FRAME_TIME_WARMUP; frame++)
+        terminal_test_frame(term, buffer, workload(buffer, frame, rows));
+
+    double total = 0;
+    for (int frame = 0; frame < FRAME_TIME_FRAMES; frame++) {
+
+        int length = workload(buffer, FRAME_TIME_WARMUP + frame, rows);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        terminal_test_frame(term, buffer, length);
+
+        times[frame] = terminal_test_elapsed(&start) * 1000000;
+        total += times[frame];
+
+    }
+
+    terminal_test_free(term);
+
+    qsort(times, FRAME_TIME_FRAMES, sizeof(double), frame_time_compare);
+
+    printf("%-8s | %9.1f | %9.1f | %8.1f\n", name,
+            total / FRAME_TIME_FRAMES,
+            times[FRAME_TIME_FRAMES * 99 / 100],
+            times[FRAME_TIME_FRAMES - 1]);
+
+    guac_mem_free(times);
+
+}
+
+/**
+ * Benchmark measuring the time taken to write and flush each frame of output
+ * from `top`, scrolling in `vim` and `tail -f`, which respectively redraw the
+ * whole screen, scroll part of the screen and scroll the whole screen.
+ */
+void test_display__frame_time() {
+
+    printf("-------- %s() --------\n", __func__);
+    printf("Workload | Mean (us) | 99th (us) | Max (us)\n");
+
+    frame_time_run("top", frame_time_top);
+    frame_time_run("vim", frame_time_vim);
+    frame_time_run("tail -f", frame_time_tail);
+
+}
+
@@ -0,0 +1,187 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal-test.h"
+#include "terminal/display.h"
+#include "terminal/glyph-cache.h"
+#include "terminal/terminal.h"
+#include "terminal/terminal-priv.h"
+
+#include <CUnit/CUnit.h>
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The total number of bytes of output replayed through the terminal by each
+ * run of the benchmark.
+ */
+#define TEST_OUTPUT_LENGTH 262144
+
+/**
+ * The number of bytes passed to each call to guac_terminal_write(), matching
+ * the size of the buffers read by the SSH and telnet protocol support when
+ * relaying output to the terminal.
+ */
+#define TEST_CHUNK_LENGTH 8192
+
+/**
+ * The lines of a C source file that are repeatedly output, as if by `cat`,
+ * during the benchmark. Each line is terminated by CRLF, as a terminal would
+ * receive from a pty with output post-processing enabled.
+ */
+static const char* TEST_SOURCE_LINES[] = {
+    "/*\r\n",
+    " * Licensed to the Apache Software Foundation (ASF) under one\r\n",
+    " * or more contributor license agreements.  See the NOTICE file\r\n",
+    " * distributed with this work for additional information\r\n",
+    " */\r\n",
+    "\r\n",
+    "#include \"config.h\"\r\n",
+    "#include <stdio.h>\r\n",
+    "\r\n",
+    "static int guac_example_count(const char* buffer, int length) {\r\n",
+    "\r\n",
+    "    int count = 0;\r\n",
+    "    for (int i = 0; i < length; i++) {\r\n",
+    "        if (buffer[i] == '\\n')\r\n",
+    "            count++;\r\n",
+    "    }\r\n",
+    "\r\n",
+    "    /* Return total number of lines (0x7F, ~100%) */\r\n",
+    "    return count;\r\n",
+    "\r\n",
+    "}\r\n",
+    "\r\n"
+};
+
+/**
+ * Fills the given buffer with TEST_OUTPUT_LENGTH bytes of output consisting
+ * of repeated lines from TEST_SOURCE_LINES.
+ *
+ * @param output
+ *     The buffer to fill. This buffer must be at least TEST_OUTPUT_LENGTH
+ *     bytes long.
+ */
+static void test_glyph_cache_fill(char* output) {
+
+    int line_count = sizeof(TEST_SOURCE_LINES) / sizeof(TEST_SOURCE_LINES[0]);
+    int length = 0;
+
+    for (int line = 0; length < TEST_OUTPUT_LENGTH; line++) {
+
+        const char* text = TEST_SOURCE_LINES[line % line_count];
+        int text_length = strlen(text);
+
+        if (text_length > TEST_OUTPUT_LENGTH - length)
+            text_length = TEST_OUTPUT_LENGTH - length;
+
+        memcpy(output + length, text, text_length);
+        length += text_length;
+
+    }
+
+}
+
+/**
+ * Replays the given output through a new terminal whose display uses a
+ * glyph cache of the given size, flushing the terminal after each chunk of
+ * output as its render thread would, and returns the number of glyphs
+ * rendered per second. The number of glyph cache hits is stored in the
+ * provided pointer.
+ *
+ * @param output
+ *     The TEST_OUTPUT_LENGTH bytes of output to replay.
+ *
+ * @param glyph_cache_size
+ *     The maximum size of the glyph cache, in bytes, or zero to render every
+ *     glyph from scratch.
+ *
+ * @param hits
+ *     Pointer to a uint64_t that should receive the number of glyphs that
+ *     were copied from the glyph cache rather than rendered.
+ *
+ * @return
+ *     The number of glyphs drawn per second.
+ */
+static double test_glyph_cache_run(const char* output, int glyph_cache_size,
+        uint64_t* hits) {
+
+    guac_terminal* term = terminal_test_alloc(glyph_cache_size);
+
+    guac_terminal_glyph_cache* cache = term->display->glyph_cache;
+    uint64_t initial = cache->hits + cache->misses;
+    uint64_t initial_hits = cache->hits;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int offset = 0; offset < TEST_OUTPUT_LENGTH;
+            offset += TEST_CHUNK_LENGTH)
+        terminal_test_frame(term, output + offset, TEST_CHUNK_LENGTH);
+
+    double elapsed = terminal_test_elapsed(&start);
+    uint64_t glyphs = cache->hits + cache->misses - initial;
+    *hits = cache->hits - initial_hits;
+
+    terminal_test_free(term);
+
+    CU_ASSERT(glyphs > 0);
+    return glyphs / (elapsed > 0 ? elapsed : 1e-9);
+
+}
+
+/**
+ * Benchmark comparing the rate at which glyphs are drawn when the output of
+ * `cat` is replayed through guac_terminal_write() with and without the glyph
+ * cache, verifying that the cache is actually used for repeated glyphs.
+ */
+void test_display__glyph_cache() {
+
+    static char output[TEST_OUTPUT_LENGTH];
+    test_glyph_cache_fill(output);
+
+    uint64_t uncached_hits;
+    double uncached = test_glyph_cache_run(output, 0, &uncached_hits);
+
+    uint64_t cached_hits;
+    double cached = test_glyph_cache_run(output,
+            GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE, &cached_hits);
+
+    printf("-------- %s() --------\n", __func__);
+    printf("Uncached: %.0f glyphs/s\n", uncached);
+    printf("Cached:   %.0f glyphs/s (%" PRIu64 " cache hits)\n",
+            cached, cached_hits);
+
+    /* A zero-sized cache never retains anything */
+    CU_ASSERT_EQUAL(uncached_hits, 0);
+
+    /* Output drawn from a small set of characters should be almost entirely
+     * served from the cache */
+    CU_ASSERT(cached_hits > 0);
+
+    /* Allow for considerable noise in timing, but catch anything that is
+     * clearly a regression */
+    CU_ASSERT(cached * 2 >= uncached);
+
+}
+
@@ -0,0 +1,486 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal-test.h"
+#include "terminal/buffer-priv.h"
+#include "terminal/buffer.h"
+#include "terminal/common.h"
+#include "terminal/terminal.h"
+#include "terminal/terminal-priv.h"
+#include "terminal/types.h"
+#include "terminal/typescript.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/mem.h>
+
+#include <locale.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The size of the buffers receiving the output written by each test, in
+ * bytes.
+ */
+#define ECHO_TEST_BUFFER_SIZE 16384
+
+/**
+ * A double-width character (U+4E2D) encoded in UTF-8.
+ */
+#define ECHO_TEST_WIDE "\xE4\xB8\xAD"
+
+/**
+ * A character (U+0065, "e") followed by a zero-width combining character
+ * (U+0301, COMBINING ACUTE ACCENT) encoded in UTF-8.
+ */
+#define ECHO_TEST_COMBINING "e\xCC\x81"
+
+/**
+ * A character which is encoded in UTF-8 as a 4-byte sequence (U+1F600).
+ */
+#define ECHO_TEST_4_BYTE "\xF0\x9F\x98\x80"
+
+/**
+ * Selects a UTF-8 locale such that wcwidth() reports the widths of
+ * double-width and zero-width characters. If no UTF-8 locale is available,
+ * the tests still verify that bulk and byte-by-byte output are identical, but
+ * every character is then treated as a single column wide.
+ */
+static void echo_test_set_locale() {
+    if (setlocale(LC_CTYPE, "C.UTF-8") == NULL)
+        setlocale(LC_CTYPE, "en_US.UTF-8");
+}
+
+/**
+ * Writes the given data to the given terminal one byte at a time through the
+ * current character handler of the terminal, exactly as guac_terminal_write()
+ * did before runs of printable characters were handled in bulk.
+ *
+ * @param term
+ *     The terminal to write to.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ */
+static void echo_test_write_bytes(guac_terminal* term, const char* data,
+        int length) {
+
+    guac_terminal_lock(term);
+    for (int i = 0; i < length; i++) {
+
+        if (term->typescript != NULL)
+            guac_terminal_typescript_write(term->typescript, data[i]);
+
+        term->char_handler(term, data[i]);
+
+    }
+    guac_terminal_unlock(term);
+
+}
+
+/**
+ * Appends the given number of copies of the given string to the given
+ * buffer.
+ *
+ * @param buffer
+ *     The buffer to append to. This buffer must be ECHO_TEST_BUFFER_SIZE
+ *     bytes long.
+ *
+ * @param length
+ *     The number of bytes currently within the buffer.
+ *
+ * @param str
+ *     The string to append.
+ *
+ * @param count
+ *     The number of copies of the string to append.
+ *
+ * @return
+ *     The number of bytes within the buffer after appending.
+ */
+static int echo_test_append(char* buffer, int length, const char* str,
+        int count) {
+
+    int str_length = strlen(str);
+
+    for (int i = 0; i < count; i++) {
+        CU_ASSERT_FATAL(length + str_length <= ECHO_TEST_BUFFER_SIZE);
+        memcpy(buffer + length, str, str_length);
+        length += str_length;
+    }
+
+    return length;
+
+}
+
+/**
+ * Verifies that the two given terminals have identical cursor positions,
+ * partially-decoded UTF-8 sequences and buffer contents, including any
+ * scrollback.
+ *
+ * @param expected
+ *     The terminal that received its output one byte at a time.
+ *
+ * @param actual
+ *     The terminal that received its output through guac_terminal_write().
+ */
+static void echo_test_assert_equal(guac_terminal* expected,
+        guac_terminal* actual) {
+
+    CU_ASSERT_EQUAL(actual->cursor_row, expected->cursor_row);
+    CU_ASSERT_EQUAL(actual->cursor_col, expected->cursor_col);
+
+    /* Any partially-decoded codepoint must be the same */
+    CU_ASSERT_EQUAL(actual->utf8_bytes_remaining, expected->utf8_bytes_remaining);
+    if (expected->utf8_bytes_remaining != 0)
+        CU_ASSERT_EQUAL(actual->utf8_codepoint, expected->utf8_codepoint);
+
+    guac_terminal_buffer* expected_buffer = expected->current_buffer;
+    guac_terminal_buffer* actual_buffer = actual->current_buffer;
+
+    CU_ASSERT_EQUAL_FATAL(actual_buffer->length, expected_buffer->length);
+
+    int first_row = 0;
+    if (expected_buffer->length > expected_buffer->height)
+        first_row = expected_buffer->height - expected_buffer->length;
+
+    for (int row = first_row; row < expected->term_height; row++) {
+
+        guac_terminal_char* expected_chars;
+        guac_terminal_char* actual_chars;
+        bool expected_wrapped;
+        bool actual_wrapped;
+
+        unsigned int expected_length = guac_terminal_buffer_get_columns(
+                expected_buffer, &expected_chars, &expected_wrapped, row);
+        unsigned int actual_length = guac_terminal_buffer_get_columns(
+                actual_buffer, &actual_chars, &actual_wrapped, row);
+
+        CU_ASSERT_EQUAL_FATAL(actual_length, expected_length);
+        CU_ASSERT_EQUAL(actual_wrapped, expected_wrapped);
+
+        for (unsigned int column = 0; column < expected_length; column++) {
+            CU_ASSERT_EQUAL_FATAL(actual_chars[column].value,
+                    expected_chars[column].value);
+            CU_ASSERT_EQUAL_FATAL(actual_chars[column].width,
+                    expected_chars[column].width);
+            CU_ASSERT_FATAL(guac_terminal_attributes_equal(
+                        &actual_chars[column].attributes,
+                        &expected_chars[column].attributes));
+        }
+
+    }
+
+}
+
+/**
+ * Writes the given data to one new terminal one byte at a time and to
+ * another new terminal through guac_terminal_write(), split into two calls at
+ * the given offset, verifying that both terminals end up in the same state.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ *
+ * @param split
+ *     The number of bytes to write with the first call to
+ *     guac_terminal_write(). The remaining bytes are written with a second
+ *     call.
+ */
+static void echo_test_compare(const char* data, int length, int split) {
+
+    guac_terminal* expected = terminal_test_alloc(
+            GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE);
+    guac_terminal* actual = terminal_test_alloc(
+            GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE);
+
+    echo_test_write_bytes(expected, data, length);
+    guac_terminal_write(actual, data, split);
+    guac_terminal_write(actual, data + split, length - split);
+
+    echo_test_assert_equal(expected, actual);
+
+    terminal_test_free(expected);
+    terminal_test_free(actual);
+
+}
+
+/**
+ * Returns the number of columns within each terminal allocated by
+ * terminal_test_alloc().
+ *
+ * @return
+ *     The number of columns within each test terminal.
+ */
+static int echo_test_columns() {
+
+    guac_terminal* term = terminal_test_alloc(
+            GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE);
+
+    int columns = term->term_width;
+    terminal_test_free(term);
+
+    CU_ASSERT_FATAL(columns > 2);
+    return columns;
+
+}
+
+/**
+ * Produces output that repeatedly fills each row, mixing ASCII, double-width
+ * and combining characters such that characters regularly land exactly at,
+ * and extend past, the last column.
+ *
+ * @param buffer
+ *     The buffer to write the output to. This buffer must be
+ *     ECHO_TEST_BUFFER_SIZE bytes long.
+ *
+ * @param columns
+ *     The number of columns within the terminal.
+ *
+ * @return
+ *     The number of bytes written to the buffer.
+ */
+static int echo_test_long_lines(char* buffer, int columns) {
+
+    int length = 0;
+
+    for (int line = 0; line < 8; line++) {
+        length = echo_test_append(buffer, length, "x", line);
+        length = echo_test_append(buffer, length, ECHO_TEST_WIDE, columns / 2);
+        length = echo_test_append(buffer, length, ECHO_TEST_COMBINING, columns / 3);
+        length = echo_test_append(buffer, length, "abc", columns / 2);
+    }
+
+    return length;
+
+}
+
+/**
+ * Verifies that a double-width character written at the last column of the
+ * terminal is handled identically by bulk and byte-by-byte output, both when
+ * the character is the last of a run and when more characters follow.
+ */
+void test_echo__wide_last_column() {
+
+    echo_test_set_locale();
+    int columns = echo_test_columns();
+
+    char buffer[ECHO_TEST_BUFFER_SIZE];
+    int length = 0;
+
+    /* Double-width character at the last column, followed by more text */
+    length = echo_test_append(buffer, length, "a", columns - 1);
+    length = echo_test_append(buffer, length, ECHO_TEST_WIDE "b", 1);
+    echo_test_compare(buffer, length, length);
+
+    /* Double-width character at the last column, ending the output */
+    length = echo_test_append(buffer, 0, "a", columns - 1);
+    length = echo_test_append(buffer, length, ECHO_TEST_WIDE, 1);
+    echo_test_compare(buffer, length, length);
+
+    /* Double-width character exactly filling the last two columns */
+    length = echo_test_append(buffer, 0, "a", columns - 2);
+    length = echo_test_append(buffer, length, ECHO_TEST_WIDE "b", 1);
+    echo_test_compare(buffer, length, length);
+
+}
+
+/**
+ * Verifies that output wrapping past the last column of the terminal is
+ * handled identically by bulk and byte-by-byte output while automatic
+ * wrapping (DECAWM) is enabled, as it is by default.
+ */
+void test_echo__wrap() {
+
+    echo_test_set_locale();
+    int columns = echo_test_columns();
+
+    char buffer[ECHO_TEST_BUFFER_SIZE];
+    int length = echo_test_long_lines(buffer, columns);
+    echo_test_compare(buffer, length, length);
+
+}
+
+/**
+ * Verifies that output reaching the last column of the terminal is handled
+ * identically by bulk and byte-by-byte output while automatic wrapping
+ * (DECAWM) is disabled, and that such output never wraps.
+ */
+void test_echo__no_wrap() {
+
+    echo_test_set_locale();
+    int columns = echo_test_columns();
+
+    char buffer[ECHO_TEST_BUFFER_SIZE];
+    int length = echo_test_append(buffer, 0, "\x1B[?7l", 1);
+    length += echo_test_long_lines(buffer + length, columns);
+    echo_test_compare(buffer, length, length);
+
+    /* Output overwrites the last column rather than wrapping */
+    guac_terminal* term = terminal_test_alloc(
+            GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE);
+    guac_terminal_write(term, buffer, length);
+    CU_ASSERT_EQUAL(term->cursor_row, 0);
+    terminal_test_free(term);
+
+    /* Output wraps once more after wrapping is re-enabled */
+    length = echo_test_append(buffer, length, "\x1B[?7h", 1);
+    length = echo_test_append(buffer, length, "z", columns + 1);
+    echo_test_compare(buffer, length, length);
+
+}
+
+/**
+ * Verifies that zero-width combining characters are handled identically by
+ * bulk and byte-by-byte output, including where they follow a character at
+ * the last column.
+ */
+void test_echo__combining() {
+
+    echo_test_set_locale();
+    int columns = echo_test_columns();
+
+    char buffer[ECHO_TEST_BUFFER_SIZE];
+    int length = echo_test_append(buffer, 0, ECHO_TEST_COMBINING, columns * 2);
+    length = echo_test_append(buffer, length, "\r\n", 1);
+    length = echo_test_append(buffer, length, "a", columns - 1);
+    length = echo_test_append(buffer, length, ECHO_TEST_COMBINING "\xCC\x81", 1);
+    length = echo_test_append(buffer, length, ECHO_TEST_COMBINING, 3);
+    echo_test_compare(buffer, length, length);
+
+}
+
+/**
+ * Verifies that UTF-8 sequences split across two calls to
+ * guac_terminal_write() are decoded identically to byte-by-byte output,
+ * regardless of where the sequences are split.
+ */
+void test_echo__split_utf8() {
+
+    echo_test_set_locale();
+
+    char buffer[ECHO_TEST_BUFFER_SIZE];
+    int length = echo_test_append(buffer, 0,
+            "ab" ECHO_TEST_WIDE "\xC3\xA9" ECHO_TEST_4_BYTE
+            ECHO_TEST_COMBINING "cd", 1);
+
+    for (int split = 0; split <= length; split++)
+        echo_test_compare(buffer, length, split);
+
+}
+
+/**
+ * Reads the entire contents of the given file.
+ *
+ * @param path
+ *     The path of the file to read.
+ *
+ * @param length
+ *     Pointer to an int which should receive the number of bytes read.
+ *
+ * @return
+ *     A newly-allocated buffer containing the contents of the file, which
+ *     must be freed with guac_mem_free().
+ */
+static char* echo_test_read_file(const char* path, int* length) {
+
+    FILE* file = fopen(path, "rb");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+
+    char* contents = guac_mem_alloc(ECHO_TEST_BUFFER_SIZE * 2);
+    *length = fread(contents, 1, ECHO_TEST_BUFFER_SIZE * 2, file);
+    fclose(file);
+
+    return contents;
+
+}
+
+/**
+ * Verifies that a typescript of output written through guac_terminal_write()
+ * is identical to a typescript of the same output written one byte at a
+ * time.
+ */
+void test_echo__typescript() {
+
+    echo_test_set_locale();
+    int columns = echo_test_columns();
+
+    char buffer[ECHO_TEST_BUFFER_SIZE];
+    int length = echo_test_long_lines(buffer, columns);
+    length = echo_test_append(buffer, length,
+            "\x1B[1;31mred\x1B[0m\r\n\tTab" ECHO_TEST_4_BYTE "\r\n", 4);
+
+    char path[] = "/tmp/guac-echo-test-XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(path));
+
+    guac_terminal* expected = terminal_test_alloc(
+            GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE);
+    guac_terminal* actual = terminal_test_alloc(
+            GUAC_TERMINAL_DEFAULT_GLYPH_CACHE_SIZE);
+
+    CU_ASSERT_FALSE_FATAL(guac_terminal_create_typescript(expected, path,
+                "bytes", 0, 0));
+    CU_ASSERT_FALSE_FATAL(guac_terminal_create_typescript(actual, path,
+                "bulk", 0, 0));
+
+    echo_test_write_bytes(expected, buffer, length);
+    guac_terminal_write(actual, buffer, length);
+
+    echo_test_assert_equal(expected, actual);
+
+    /* Typescripts are completed only once the terminals are freed */
+    char expected_path[GUAC_TERMINAL_TYPESCRIPT_MAX_NAME_LENGTH];
+    char expected_timing[GUAC_TERMINAL_TYPESCRIPT_MAX_NAME_LENGTH];
+    char actual_path[GUAC_TERMINAL_TYPESCRIPT_MAX_NAME_LENGTH];
+    char actual_timing[GUAC_TERMINAL_TYPESCRIPT_MAX_NAME_LENGTH];
+    strcpy(expected_path, expected->typescript->data_filename);
+    strcpy(expected_timing, expected->typescript->timing_filename);
+    strcpy(actual_path, actual->typescript->data_filename);
+    strcpy(actual_timing, actual->typescript->timing_filename);
+
+    terminal_test_free(expected);
+    terminal_test_free(actual);
+
+    int expected_length;
+    int actual_length;
+    char* expected_data = echo_test_read_file(expected_path, &expected_length);
+    char* actual_data = echo_test_read_file(actual_path, &actual_length);
+
+    CU_ASSERT_EQUAL(actual_length, expected_length);
+    CU_ASSERT(memcmp(actual_data, expected_data, expected_length) == 0);
+
+    guac_mem_free(expected_data);
+    guac_mem_free(actual_data);
+
+    /* Clean up typescript data and timing files */
+    unlink(expected_path);
+    unlink(expected_timing);
+    unlink(actual_path);
+    unlink(actual_timing);
+    rmdir(path);
+
+}
+
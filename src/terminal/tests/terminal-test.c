@@ -0,0 +1,79 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal-test.h"
+#include "terminal/terminal.h"
+#include "terminal/terminal-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+
+#include <time.h>
+
+guac_terminal* terminal_test_alloc(int glyph_cache_size) {
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    /* Frames are flushed by the test itself rather than by the terminal
+     * render thread, which exits immediately if the client is not running */
+    guac_client_stop(client);
+
+    guac_terminal_options* options = guac_terminal_options_create(
+            TERMINAL_TEST_WIDTH, TERMINAL_TEST_HEIGHT, TERMINAL_TEST_DPI);
+    options->glyph_cache_size = glyph_cache_size;
+
+    guac_terminal* term = guac_terminal_create(client, options);
+    guac_mem_free(options);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(term);
+
+    return term;
+
+}
+
+void terminal_test_free(guac_terminal* term) {
+
+    guac_client* client = term->client;
+
+    guac_terminal_free(term);
+    guac_client_free(client);
+
+}
+
+void terminal_test_frame(guac_terminal* term, const char* data, int length) {
+
+    guac_terminal_write(term, data, length);
+
+    guac_terminal_lock(term);
+    guac_terminal_flush(term);
+    guac_terminal_unlock(term);
+
+}
+
+double terminal_test_elapsed(const struct timespec* start) {
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start->tv_sec)
+        + (end.tv_nsec - start->tv_nsec) / 1000000000.0;
+
+}
+
@@ -0,0 +1,100 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_TERMINAL_TESTS_TERMINAL_TEST_H
+#define GUAC_TERMINAL_TESTS_TERMINAL_TEST_H
+
+#include "terminal/terminal.h"
+
+#include <time.h>
+
+/**
+ * The width of the display of each terminal allocated with
+ * terminal_test_alloc(), in pixels.
+ */
+#define TERMINAL_TEST_WIDTH 1024
+
+/**
+ * The height of the display of each terminal allocated with
+ * terminal_test_alloc(), in pixels.
+ */
+#define TERMINAL_TEST_HEIGHT 768
+
+/**
+ * The resolution of the display of each terminal allocated with
+ * terminal_test_alloc(), in DPI.
+ */
+#define TERMINAL_TEST_DPI 96
+
+/**
+ * Allocates a new terminal, along with a new guac_client that has no users.
+ * The client is stopped before the terminal is created, such that the render
+ * thread of the terminal exits immediately and the terminal display changes
+ * only when explicitly flushed with terminal_test_frame(). The terminal must
+ * eventually be freed with terminal_test_free().
+ *
+ * @param glyph_cache_size
+ *     The maximum size of the glyph cache of the terminal display, in bytes,
+ *     or zero to render every glyph from scratch.
+ *
+ * @return
+ *     A newly-allocated terminal. If the terminal cannot be allocated, the
+ *     current test fails and is aborted.
+ */
+guac_terminal* terminal_test_alloc(int glyph_cache_size);
+
+/**
+ * Frees the given terminal, which must have been allocated with
+ * terminal_test_alloc(), along with its associated guac_client.
+ *
+ * @param term
+ *     The terminal to free.
+ */
+void terminal_test_free(guac_terminal* term);
+
+/**
+ * Writes the given data to the given terminal, as guac_terminal_write()
+ * would, and then flushes all resulting changes to the terminal display, as
+ * the terminal render thread would at the end of each frame.
+ *
+ * @param term
+ *     The terminal to write to.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ */
+void terminal_test_frame(guac_terminal* term, const char* data, int length);
+
+/**
+ * Returns the number of seconds elapsed since the given time, as read from
+ * CLOCK_MONOTONIC.
+ *
+ * @param start
+ *     The time to measure from, as read from CLOCK_MONOTONIC.
+ *
+ * @return
+ *     The number of seconds elapsed since the given time.
+ */
+double terminal_test_elapsed(const struct timespec* start);
+
+#endif
+